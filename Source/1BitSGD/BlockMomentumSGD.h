@@ -175,6 +175,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                     // 2.2.4 update bookkeeping
                     prevWeight.SetValue(currentWeight);
                 }
+                pNode->BumpEvalTimeStamp();
             }
             //----------------------------------------
             // 3. reset SGD momentum if necessary 
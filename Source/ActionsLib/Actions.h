@@ -52,6 +52,8 @@ template <typename ElemType>
 void DoCrossValidate(const ConfigParameters& config);
 template <typename ElemType>
 void DoWriteOutput(const ConfigParameters& config);
+template <typename ElemType>
+void DoOptimizeForInference(const ConfigParameters& config);
 
 // misc (OtherActions.cpp)
 template <typename ElemType>
@@ -62,6 +64,8 @@ template <typename ElemType>
 void DoWriteWordAndClassInfo(const ConfigParameters& config);
 template <typename ElemType>
 void DoTopologyPlot(const ConfigParameters& config);
+template <typename ElemType>
+void DoBenchmarkReader(const ConfigParameters& config);
 
 // special purpose (SpecialPurposeActions.cpp)
 template <typename ElemType>
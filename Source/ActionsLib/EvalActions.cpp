@@ -21,6 +21,7 @@
 #include "BestGpu.h"
 #include "ScriptableObjects.h"
 #include "BrainScriptEvaluator.h"
+#include "TimerUtility.h"
 
 #include <string>
 #include <chrono>
@@ -259,7 +260,13 @@ void DoWriteOutput(const ConfigParameters& config)
         bool writeSequenceKey = config(L"writeSequenceKey", false);
         WriteFormattingOptions formattingOptions(config);
         bool nodeUnitTest = config(L"nodeUnitTest", "false");
-        writer.WriteOutput(testDataReader, mbSize[0], outputPath, outputNodeNamesVector, formattingOptions, epochSize, nodeUnitTest, writeSequenceKey);
+        size_t numPendingMinibatches = config(L"numPendingOutputMinibatches", (size_t)2); // minibatches queued for formatting in the background while evaluating the next ones; 0 = format synchronously
+        size_t numFormattingThreads = config(L"numOutputFormattingThreads", (size_t)4); // threads that format the queued minibatches; they are still written in order
+        wstring outputFormat = config(L"outputFormat", L"text");
+        if (outputFormat != L"text" && outputFormat != L"binary")
+            InvalidArgument("write command: outputFormat must be 'text' or 'binary' (raw float32 values of each sample)");
+        writer.WriteOutput(testDataReader, mbSize[0], outputPath, outputNodeNamesVector, formattingOptions, epochSize, nodeUnitTest, writeSequenceKey,
+                           numPendingMinibatches, outputFormat == L"binary", numFormattingThreads);
     }
     else
         InvalidArgument("write command: You must specify either 'writer'or 'outputPath'");
@@ -267,3 +274,120 @@ void DoWriteOutput(const ConfigParameters& config)
 
 template void DoWriteOutput<float>(const ConfigParameters& config);
 template void DoWriteOutput<double>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoOptimizeForInference() - implements CNTK "optimizeForInference" command
+// Rewrites 'modelPath' for evaluation (constant folding, BatchNormalization folding, affine+activation fusion)
+// and saves it as 'outputModelPath'. If a 'reader' is given, both models are run over up to 'numSamples' samples;
+// the outputs must agree to within 'parityTolerance' (relative to the largest output magnitude), and the
+// forward-prop time of both is reported.
+// ===========================================================================
+
+// runs a network over the reader in inference mode and calls onMinibatch() with the output nodes after each
+// forward prop; returns the number of minibatches and the seconds spent in ForwardProp() alone
+template <typename ElemType>
+static size_t TimeForwardProp(const ComputationNetworkPtr& net, IDataReader& reader, const vector<wstring>& outputNodeNames,
+                              size_t mbSize, size_t numSamples, double& seconds,
+                              const function<void(size_t, const vector<ComputationNodeBasePtr>&)>& onMinibatch)
+{
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::inferring);
+
+    vector<ComputationNodeBasePtr> outputNodes = net->OutputNodesByName(outputNodeNames);
+    vector<ComputationNodeBasePtr> inputNodes = net->InputNodesForOutputs(outputNodeNames);
+    net->AllocateAllMatrices({}, outputNodes, nullptr);
+
+    StreamMinibatchInputs inputMatrices = DataReaderHelpers::RetrieveInputMatrices(inputNodes);
+    reader.StartMinibatchLoop(mbSize, 0, inputMatrices.GetStreamDescriptions(), numSamples);
+    net->StartEvaluateMinibatchLoop(outputNodes);
+
+    Timer timer;
+    seconds = 0;
+    size_t numMinibatches = 0;
+    size_t actualMBSize;
+    while (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(reader, net, nullptr, false, false, inputMatrices, actualMBSize, nullptr))
+    {
+        ComputationNetwork::BumpEvalTimeStamp(inputNodes);
+        timer.Restart();
+        net->ForwardProp(outputNodes);
+        timer.Stop();
+        seconds += timer.ElapsedSeconds();
+        onMinibatch(numMinibatches++, outputNodes);
+        reader.DataEnd();
+    }
+    return numMinibatches;
+}
+
+template <typename ElemType>
+void DoOptimizeForInference(const ConfigParameters& config)
+{
+    DEVICEID_TYPE deviceId = DeviceFromConfig(config);
+    wstring modelPath = config(L"modelPath");
+    wstring outputModelPath = config(L"outputModelPath");
+    if (modelPath == outputModelPath)
+        InvalidArgument("optimizeForInference: 'outputModelPath' must differ from 'modelPath'.");
+
+    let optimizedNet = ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelPath);
+    optimizedNet->template OptimizeForInference<ElemType>();
+    optimizedNet->Save(outputModelPath);
+    fprintf(stderr, "optimizeForInference: Optimized model saved to '%ls'.\n", outputModelPath.c_str());
+
+    if (!config.Exists("reader"))
+        return;
+
+    // parity and speed check against the unmodified model
+    ConfigParameters readerConfig(config(L"reader"));
+    readerConfig.Insert("randomize", "None");
+    DataReader reader(readerConfig);
+
+    size_t mbSize = config(L"minibatchSize", "256");
+    size_t numSamples = config(L"numSamples", "10000");
+    double parityTolerance = config(L"parityTolerance", "1e-4");
+    ConfigArray outputNodeNamesConfig = config(L"outputNodeNames", "");
+    vector<wstring> outputNodeNames;
+    for (int i = 0; i < outputNodeNamesConfig.size(); ++i)
+        outputNodeNames.push_back(outputNodeNamesConfig[i]);
+
+    let originalNet = ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelPath);
+    vector<vector<shared_ptr<Matrix<ElemType>>>> referenceOutputs; // [minibatch][output]
+    double originalSeconds;
+    size_t numMinibatches = TimeForwardProp<ElemType>(originalNet, reader, outputNodeNames, mbSize, numSamples, originalSeconds,
+        [&](size_t, const vector<ComputationNodeBasePtr>& outputNodes)
+        {
+            referenceOutputs.push_back({});
+            for (let& node : outputNodes)
+                referenceOutputs.back().push_back(make_shared<Matrix<ElemType>>(node->As<ComputationNode<ElemType>>()->Value().DeepClone()));
+        });
+    if (numMinibatches == 0)
+        InvalidArgument("optimizeForInference: The reader did not deliver any data for the parity check.");
+
+    double maxAbsDiff = 0, maxAbsValue = 0, optimizedSeconds;
+    TimeForwardProp<ElemType>(optimizedNet, reader, outputNodeNames, mbSize, numSamples, optimizedSeconds,
+        [&](size_t mb, const vector<ComputationNodeBasePtr>& outputNodes)
+        {
+            for (size_t i = 0; i < outputNodes.size(); i++)
+            {
+                let& value = outputNodes[i]->As<ComputationNode<ElemType>>()->Value();
+                let& reference = *referenceOutputs[mb][i];
+                if (value.GetNumRows() != reference.GetNumRows() || value.GetNumCols() != reference.GetNumCols())
+                    RuntimeError("optimizeForInference: Output '%ls' changed its dimensions from [%d x %d] to [%d x %d].", outputNodes[i]->NodeName().c_str(),
+                                 (int)reference.GetNumRows(), (int)reference.GetNumCols(), (int)value.GetNumRows(), (int)value.GetNumCols());
+                Matrix<ElemType> diff(value.GetDeviceId());
+                diff.AssignDifferenceOf(value, reference);
+                maxAbsDiff = max(maxAbsDiff, (double)diff.MatrixNormInf());
+                maxAbsValue = max(maxAbsValue, (double)reference.MatrixNormInf());
+            }
+        });
+
+    double relativeDiff = maxAbsDiff / max(maxAbsValue, 1.0);
+    fprintf(stderr, "optimizeForInference: Parity over %d minibatches: max abs difference %.6g (relative %.6g, tolerance %.6g).\n",
+            (int)numMinibatches, maxAbsDiff, relativeDiff, parityTolerance);
+    fprintf(stderr, "optimizeForInference: ForwardProp %.3f ms/minibatch original, %.3f ms/minibatch optimized (%.2fx).\n",
+            1000 * originalSeconds / numMinibatches, 1000 * optimizedSeconds / numMinibatches,
+            optimizedSeconds > 0 ? originalSeconds / optimizedSeconds : 0.0);
+    if (relativeDiff > parityTolerance)
+        RuntimeError("optimizeForInference: The optimized model deviates from the original by %.6g (relative), which exceeds 'parityTolerance' %.6g.",
+                     relativeDiff, parityTolerance);
+}
+
+template void DoOptimizeForInference<float>(const ConfigParameters& config);
+template void DoOptimizeForInference<double>(const ConfigParameters& config);
@@ -12,6 +12,10 @@
 #include "ScriptableObjects.h"
 #include "BrainScriptEvaluator.h"
 #include "BrainScriptParser.h"
+#include "File.h"
+#include "fileutil.h"
+#include "MPIWrapper.h"
+#include "ProgressTracing.h"
 
 function<ComputationNetworkPtr(DEVICEID_TYPE)> GetCreateNetworkFn(const ScriptableObjects::IConfigRecord& config)
 {
@@ -34,12 +38,108 @@ function<ComputationNetworkPtr(DEVICEID_TYPE)> GetCreateNetworkFn(const ConfigPa
     NOT_IMPLEMENTED;
 } // old CNTK config does not support lambdas
 
+// ---------------------------------------------------------------------------
+// network cache -- if 'networkCache' names a directory, then networks built by one of the network builders
+// are saved there by the main worker once they have been built and compiled, named by a hash of their description.
+// Later runs with the same description load the network from there instead of evaluating the description again,
+// which for large generated networks takes much longer than reading the model. An entry that cannot be read is
+// rebuilt and replaced. The key covers the description and the source files it refers to, precision, device, and
+// the model version, but not data files that the description reads (e.g. initFromFilePath, or a model loaded with
+// BS.Network.Load()); delete the cache when those change.
+// ---------------------------------------------------------------------------
+
+static void AppendFileToNetworkCacheKey(const wstring& path, wstring& key)
+{
+    key += L"\n### " + path + L"\n";
+    if (!fexists(path)) // (the builder will complain)
+        return;
+    vector<char> buffer;
+    fgetfile(path, buffer);
+    key += ToFixedWStringFromMultiByte(string(buffer.begin(), buffer.end()));
+}
+
+// key of a legacy network builder section: its text, and for NDL, the files with the network description and macros
+static wstring GetNetworkCacheKey(const ConfigParameters& config, const wchar_t* builderName)
+{
+    ConfigValue builderSection = config(builderName);
+    wstring key = ToFixedWStringFromMultiByte(builderSection);
+    if (EqualCI(builderName, L"NDLNetworkBuilder"))
+    {
+        const ConfigParameters builderConfig(builderSection);
+        string networkDescription = builderConfig("networkDescription", "");
+        if (!networkDescription.empty())
+            AppendFileToNetworkCacheKey(ToFixedWStringFromMultiByte(networkDescription), key);
+        string ndlMacros = builderConfig("ndlMacros", "");
+        for (const auto& path : msra::strfun::split(ndlMacros, "+"))
+            AppendFileToNetworkCacheKey(ToFixedWStringFromMultiByte(path), key);
+    }
+    return key;
+}
+
+static wstring GetNetworkCacheKey(const ScriptableObjects::IConfigRecord&, const wchar_t*)
+{
+    return wstring(); // builder sections of BrainScript configs are not text; these are not cached
+}
+
+// wrap a network factory to go through the cache
+template <typename ElemType>
+static function<ComputationNetworkPtr(DEVICEID_TYPE)> CachedNetworkFactory(const function<ComputationNetworkPtr(DEVICEID_TYPE)>& createNetworkFn,
+                                                                          const wstring& cacheDir, wstring key, int traceLevel)
+{
+    if (cacheDir.empty() || key.empty())
+        return createNetworkFn;
+    key += msra::strfun::wstrprintf(L"\n### precision=%ls modelVersion=%d\n", ElemTypeName<ElemType>(), (int)CURRENT_CNTK_MODEL_VERSION);
+    return [createNetworkFn, cacheDir, key, traceLevel](DEVICEID_TYPE deviceId)
+    {
+        let fullKey = key + msra::strfun::wstrprintf(L"deviceId=%d\n", (int)deviceId);
+        let path = msra::strfun::wstrprintf(L"%ls/network.%016llx", cacheDir.c_str(), (unsigned long long)HashOfKey(fullKey));
+        let keyPath = path + L".key"; // full key, to detect hash collisions
+        if (fexists(path) && fexists(keyPath))
+        {
+            try
+            {
+                wstring fileKey;
+                File(keyPath, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead) >> fileKey;
+                if (fileKey == fullKey)
+                {
+                    auto net = make_shared<ComputationNetwork>(deviceId);
+                    net->SetTraceLevel(traceLevel);
+                    net->Read<ElemType>(path);
+                    net->CompileNetwork();
+                    LOGPRINTF(stderr, "Loaded the network from the network cache '%ls'.\n", path.c_str());
+                    return net;
+                }
+            }
+            catch (const exception& e) // e.g. a damaged entry; the network is built instead, and the entry replaced
+            {
+                LOGPRINTF(stderr, "Ignoring the network cache entry '%ls', which cannot be read: %s\n", path.c_str(), e.what());
+            }
+        }
+
+        auto net = createNetworkFn(deviceId); // (all builders return compiled networks)
+        // in parallel training, every worker builds the network, but only the main one writes it
+        let mpi = MPIWrapper::GetInstance();
+        if (mpi != nullptr && !mpi->IsMainNode())
+            return net;
+        // write under temp names, so that sibling jobs never see a partial file; the model goes last, since its presence marks the entry as complete
+        msra::files::make_intermediate_dirs(path);
+        let tmpSuffix = msra::strfun::wstrprintf(L".%d.tmp", (int)GetCurrentProcessId());
+        File(keyPath + tmpSuffix, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite) << fullKey;
+        renameOrDie(keyPath + tmpSuffix, keyPath);
+        net->Save(path + tmpSuffix);
+        renameOrDie(path + tmpSuffix, path);
+        LOGPRINTF(stderr, "Saved the network to the network cache '%ls'.\n", path.c_str());
+        return net;
+    };
+}
+
 template <class ConfigRecordType, typename ElemType>
 bool TryGetNetworkFactory(const ConfigRecordType& config, function<ComputationNetworkPtr(DEVICEID_TYPE)>& createNetworkFn)
 {
     DEVICEID_TYPE deviceId = DeviceFromConfig(config);
 
     int traceLevel = config(L"traceLevel", 0);
+    wstring networkCache = static_cast<wstring>(config(L"networkCache", L""));
     if (config.Exists(L"createNetwork"))
     {
         createNetworkFn = GetCreateNetworkFn(config); // (we need a separate function needed due to template code)
@@ -55,6 +155,7 @@ bool TryGetNetworkFactory(const ConfigRecordType& config, function<ComputationNe
             net->SetTraceLevel(traceLevel);
             return net;
         };
+        createNetworkFn = CachedNetworkFactory<ElemType>(createNetworkFn, networkCache, GetNetworkCacheKey(config, L"SimpleNetworkBuilder"), traceLevel);
         return true;
     }
     // legacy NDL
@@ -68,6 +169,7 @@ bool TryGetNetworkFactory(const ConfigRecordType& config, function<ComputationNe
             net->SetTraceLevel(traceLevel);
             return net;
         };
+        createNetworkFn = CachedNetworkFactory<ElemType>(createNetworkFn, networkCache, GetNetworkCacheKey(config, L"NDLNetworkBuilder"), traceLevel);
         return true;
     }
     // legacy test mode for BrainScript. Will go away once we fully integrate with BS.
@@ -96,7 +198,8 @@ bool TryGetNetworkFactory(const ConfigRecordType& config, function<ComputationNe
             L"precision = '%ls'\n"        // 'float' or 'double'
             L"network = %ls",             // source code of expression that evaluates to a ComputationNetwork
             (int)deviceId, traceLevel, ElemTypeName<ElemType>(), sourceOfNetwork.c_str());
-        let expr = BS::ParseConfigDictFromString(sourceOfBS, L"BrainScriptNetworkBuilder", move(includePaths));
+        vector<wstring> includedFiles;
+        let expr = BS::ParseConfigDictFromString(sourceOfBS, L"BrainScriptNetworkBuilder", move(includePaths), &includedFiles);
 
         // the rest is done in a lambda that is only evaluated when a virgin network is needed
         // Note that evaluating the BrainScript *is* instantiating the network, so the evaluate call must be inside the lambda.
@@ -110,6 +213,10 @@ bool TryGetNetworkFactory(const ConfigRecordType& config, function<ComputationNe
                 LogicError("BuildNetworkFromDescription: ComputationNetwork not what it was meant to be");
             return network;
         };
+        wstring cacheKey = sourceOfBS; // (this already contains deviceId and precision)
+        for (const auto& path : includedFiles)
+            AppendFileToNetworkCacheKey(path, cacheKey);
+        createNetworkFn = CachedNetworkFactory<ElemType>(createNetworkFn, networkCache, cacheKey, traceLevel);
         return true;
     }
     else
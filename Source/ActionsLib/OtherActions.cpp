@@ -16,6 +16,11 @@
 #include "Config.h"
 #include "ScriptableObjects.h"
 #include "BrainScriptEvaluator.h"
+#include "BestGpu.h"
+#include "CPUMatrix.h" // used for SetNumThreads()
+#include "PerformanceProfiler.h"
+#include "TimerUtility.h"
+#include "fileutil.h"
 
 #include <string>
 #include <chrono>
@@ -563,3 +568,166 @@ void DoTopologyPlot(const ConfigParameters& config)
 
 template void DoTopologyPlot<float>(const ConfigParameters& config);
 template void DoTopologyPlot<double>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoBenchmarkReader() - implements CNTK "benchmarkReader" command
+// ===========================================================================
+
+// Reads minibatches from a reader without a network and reports the throughput of the data pipeline,
+// once for each entry of 'numCPUThreadsList'. Example:
+//     benchmark = [
+//         action = "benchmarkReader"
+//         streams = "features:labels"        # reader streams to read
+//         minibatchSize = 256
+//         numMinibatches = 1000              # measured minibatches, after 'numWarmupMinibatches'
+//         numCPUThreadsList = 1:2:4:8        # 0 keeps the current setting
+//         outputPath = "readerBenchmark.json" # optional
+//         reader = [ ... ]
+//     ]
+// Latencies of the reader stages are taken from the performance profiler; unless profiling is enabled
+// already, the profiler is run just for the benchmark, writing its reports to 'profilerDir' if given.
+
+static const struct
+{
+    ProfilerEvents eventId;
+    const char* name;
+} c_readerBenchmarkStages[] =
+{
+    { profilerEvtMainGetMinibatch,  "getMinibatch" },  // as seen by the consumer
+    { profilerEvtPrefetchWait,      "prefetchWait" },  // consumer stalled on the prefetch
+    { profilerEvtPrefetchMinibatch, "prefetch" },      // background thread, sum of the three below
+    { profilerEvtReadSequences,     "readSequences" }, // deserializers, randomizer and transforms
+    { profilerEvtPackMinibatch,     "pack" },
+    { profilerEvtCopyMinibatch,     "copy" },          // into the matrices, possibly to the GPU
+};
+
+static const size_t c_numReaderBenchmarkStages = sizeof(c_readerBenchmarkStages) / sizeof(c_readerBenchmarkStages[0]);
+
+static void GetReaderBenchmarkStatistics(vector<ProfilerEventStatistics>& stages, ProfilerEventStatistics& copyThroughput)
+{
+    stages.resize(c_numReaderBenchmarkStages);
+    for (size_t i = 0; i < c_numReaderBenchmarkStages; i++)
+        ProfilerGetEventStatistics(c_readerBenchmarkStages[i].eventId, stages[i]);
+    ProfilerGetEventStatistics(profilerEvtCopyThroughput, copyThroughput);
+}
+
+template <typename ElemType>
+void DoBenchmarkReader(const ConfigParameters& config)
+{
+    DEVICEID_TYPE deviceId = DeviceFromConfig(config);
+    ConfigParameters readerConfig(config(L"reader"));
+    size_t minibatchSize = config(L"minibatchSize", (size_t)256);
+    size_t numMinibatches = config(L"numMinibatches", (size_t)1000);
+    size_t numWarmupMinibatches = config(L"numWarmupMinibatches", (size_t)10);
+    wstring outputPath = config(L"outputPath", L"");
+    wstring profilerDir = config(L"profilerDir", L"");
+    ConfigArray numCPUThreadsConfig = config(L"numCPUThreadsList", "0");
+    intargvector numCPUThreadsList = numCPUThreadsConfig;
+    ConfigArray streamNames = config(L"streams", "");
+    if (streamNames.size() == 0)
+        InvalidArgument("benchmarkReader: 'streams' must list the reader streams to read, e.g. streams = \"features:labels\".");
+
+    StreamMinibatchInputs inputs;
+    vector<MBLayoutPtr> layouts;
+    for (int i = 0; i < streamNames.size(); i++)
+    {
+        layouts.push_back(make_shared<MBLayout>());
+        inputs.AddInput(streamNames[i], make_shared<Matrix<ElemType>>(deviceId), layouts.back(), TensorShape());
+    }
+
+    ProfilerEventStatistics probe;
+    bool ownProfiler = !ProfilerGetEventStatistics(profilerEvtMainGetMinibatch, probe);
+    int previousNumCPUThreads = CPUMatrix<ElemType>::GetMaxNumThreads();
+
+    FILE* output = outputPath.empty() ? nullptr : fopenOrDie(outputPath, L"wt");
+    if (output)
+        fprintfOrDie(output, "[\n");
+
+    // a profiler that we do not own is left in the state we found it in
+    bool wasProfilerEnabled = ProfilerIsEnabled();
+    auto restoreProfiler = MakeScopeExit([ownProfiler, wasProfilerEnabled]() { if (!ownProfiler) ProfilerEnable(wasProfilerEnabled); });
+
+    for (size_t run = 0; run < numCPUThreadsList.size(); run++)
+    {
+        if (numCPUThreadsList[run] != 0)
+            CPUMatrix<ElemType>::SetNumThreads(numCPUThreadsList[run]);
+        int numCPUThreads = CPUMatrix<ElemType>::GetMaxNumThreads();
+
+        if (ownProfiler)
+            ProfilerInit(profilerDir, 0, L"benchmarkReader" + to_wstring(numCPUThreads), /*syncGpu=*/false);
+        ProfilerEnable(true);
+
+        // a new reader for each run, so that runs do not benefit from data cached by earlier ones
+        auto dataReader = make_unique<DataReader>(readerConfig);
+        dataReader->StartMinibatchLoop(minibatchSize, 0, inputs.GetStreamDescriptions(), minibatchSize * (numWarmupMinibatches + numMinibatches));
+        for (size_t i = 0; i < numWarmupMinibatches; i++)
+            dataReader->GetMinibatch(inputs);
+
+        vector<ProfilerEventStatistics> stagesBefore, stages;
+        ProfilerEventStatistics copyThroughputBefore, copyThroughput;
+        GetReaderBenchmarkStatistics(stagesBefore, copyThroughputBefore);
+
+        size_t numMinibatchesRead = 0, numSamples = 0;
+        Timer timer;
+        timer.Start();
+        for (; numMinibatchesRead < numMinibatches; numMinibatchesRead++)
+        {
+            auto profGetMinibatch = ProfilerTimeBegin();
+            bool dataAvailable = dataReader->GetMinibatch(inputs);
+            ProfilerTimeEnd(profGetMinibatch, profilerEvtMainGetMinibatch);
+            if (!dataAvailable)
+                break;
+
+            size_t numMinibatchSamples = 0; // samples of the longest stream
+            for (const auto& layout : layouts)
+                numMinibatchSamples = max(numMinibatchSamples, layout->GetActualNumSamples());
+            numSamples += numMinibatchSamples;
+        }
+        timer.Stop();
+        double seconds = timer.ElapsedSeconds();
+        dataReader.reset(); // stops the prefetch
+
+        GetReaderBenchmarkStatistics(stages, copyThroughput);
+        for (size_t i = 0; i < c_numReaderBenchmarkStages; i++)
+            stages[i].Subtract(stagesBefore[i]);
+        copyThroughput.Subtract(copyThroughputBefore);
+        const auto& prefetchWait = stages[1]; // profilerEvtPrefetchWait
+
+        fprintf(stderr, "benchmarkReader: %d CPU threads: %d minibatches, %d samples, %.1f MB in %.3f seconds = %.1f samples/s, %.1f MB/s; prefetch stall %.3f seconds (%.1f%%)\n",
+                numCPUThreads, (int)numMinibatchesRead, (int)numSamples, copyThroughput.totalBytes / 1e6, seconds,
+                numSamples / seconds, copyThroughput.totalBytes / 1e6 / seconds, prefetchWait.totalSeconds, 100 * prefetchWait.totalSeconds / seconds);
+        for (size_t i = 0; i < c_numReaderBenchmarkStages; i++)
+        {
+            if (stages[i].count > 0)
+                fprintf(stderr, "    %-14s %6d calls, mean %9.3f ms, p50 %9.3f ms, p90 %9.3f ms, p99 %9.3f ms\n",
+                        c_readerBenchmarkStages[i].name, (int)stages[i].count, 1e3 * stages[i].totalSeconds / stages[i].count,
+                        1e3 * stages[i].Percentile(50), 1e3 * stages[i].Percentile(90), 1e3 * stages[i].Percentile(99));
+        }
+
+        if (output)
+        {
+            fprintfOrDie(output, "%s  {\"numCPUThreads\": %d, \"minibatchSize\": %d, \"minibatches\": %d, \"samples\": %d, \"bytes\": %lld, \"seconds\": %.6f, \"samplesPerSecond\": %.3f, \"bytesPerSecond\": %.3f, \"prefetchStallSeconds\": %.6f, \"stages\": {",
+                         run == 0 ? "" : ",\n", numCPUThreads, (int)minibatchSize, (int)numMinibatchesRead, (int)numSamples, copyThroughput.totalBytes, seconds,
+                         numSamples / seconds, copyThroughput.totalBytes / seconds, prefetchWait.totalSeconds);
+            for (size_t i = 0; i < c_numReaderBenchmarkStages; i++)
+                fprintfOrDie(output, "%s\"%s\": {\"count\": %lld, \"meanSeconds\": %.9f, \"p50Seconds\": %.9f, \"p90Seconds\": %.9f, \"p99Seconds\": %.9f}",
+                             i == 0 ? "" : ", ", c_readerBenchmarkStages[i].name, stages[i].count, stages[i].count > 0 ? stages[i].totalSeconds / stages[i].count : 0.0,
+                             stages[i].Percentile(50), stages[i].Percentile(90), stages[i].Percentile(99));
+            fprintfOrDie(output, "}}");
+        }
+
+        if (ownProfiler)
+            ProfilerClose();
+    }
+
+    CPUMatrix<ElemType>::SetNumThreads(previousNumCPUThreads);
+    if (output)
+    {
+        fprintfOrDie(output, "\n]\n");
+        fcloseOrDie(output);
+        fprintf(stderr, "benchmarkReader: results written to '%ls'\n", outputPath.c_str());
+    }
+}
+
+template void DoBenchmarkReader<float>(const ConfigParameters& config);
+template void DoBenchmarkReader<double>(const ConfigParameters& config);
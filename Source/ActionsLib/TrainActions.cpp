@@ -74,6 +74,60 @@ shared_ptr<C> CreateObject(const ConfigParameters& config, const wchar_t* id)
     return make_shared<C>(objConfig);                           // old CNTK config specifies a dictionary which then must be explicitly instantiated
 }
 
+// text that identifies the training data, used by SGD to key cached precomputed statistics
+static wstring DataConfigKey(const ConfigParameters& config)
+{
+    if (!config.Exists(L"reader"))
+        return wstring();
+    ConfigValue readerConfig = config(L"reader");
+    return ToFixedWStringFromMultiByte(readerConfig);
+}
+static void AppendConfigValueKey(const ScriptableObjects::ConfigValuePtr& value, wstring& key)
+{
+    using namespace ScriptableObjects;
+    if (value.Is<String>())
+        key += L"\"" + (const wstring&)value.AsRef<String>() + L"\"";
+    else if (value.Is<Double>())
+        key += msra::strfun::wstrprintf(L"%.17g", (double)value);
+    else if (value.Is<Bool>())
+        key += (bool)value ? L"true" : L"false";
+    else if (value.Is<ConfigRecord>())
+    {
+        const auto& record = value.AsRef<ConfigRecord>();
+        auto memberIds = record.GetMemberIds();
+        sort(memberIds.begin(), memberIds.end());
+        key += L"[";
+        for (const auto& id : memberIds)
+        {
+            key += id + L"=";
+            AppendConfigValueKey(record[id], key);
+            key += L";";
+        }
+        key += L"]";
+    }
+    else if (value.Is<ScriptableObjects::ConfigArray>())
+    {
+        const auto& arr = value.AsRef<ScriptableObjects::ConfigArray>();
+        let range = arr.GetIndexBeginEnd();
+        key += L"(";
+        for (int i = range.first; i < range.second; i++)
+        {
+            AppendConfigValueKey(arr.At(i, [](const wstring& msg) { RuntimeError("%ls", msg.c_str()); }), key);
+            key += L":";
+        }
+        key += L")";
+    }
+    else
+        key += L"?"; // e.g. lambdas; these do not describe data
+}
+static wstring DataConfigKey(const ScriptableObjects::IConfigRecord& config)
+{
+    wstring key;
+    if (config.Exists(L"reader"))
+        AppendConfigValueKey(config[L"reader"], key);
+    return key;
+}
+
 template <class ConfigRecordType, typename ElemType>
 void DoTrain(const ConfigRecordType& config)
 {
@@ -123,6 +177,7 @@ void DoTrain(const ConfigRecordType& config)
         cvDataReader = CreateObject<DataReader>(config, L"cvReader");
 
     optimizer->InitMPI(MPIWrapper::GetInstance());
+    optimizer->SetDataConfigKey(DataConfigKey(config));
     optimizer->Train(net, deviceId, dataReader.get(), cvDataReader.get(), startEpoch, loadNetworkFromCheckpoint);
 }
 
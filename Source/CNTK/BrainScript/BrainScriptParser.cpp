@@ -286,10 +286,11 @@ class Lexer : public CodeSource
     set<wstring> keywords;
     set<wstring> punctuations;
     vector<wstring> includePaths;
+    vector<wstring>* includedFiles = nullptr; // if not null then we record the path of every file we include here
 
 public:
-    Lexer(vector<wstring>&& includePaths)
-        : CodeSource(), includePaths(includePaths), currentToken(TextLocation())
+    Lexer(vector<wstring>&& includePaths, vector<wstring>* includedFiles = nullptr)
+        : CodeSource(), includePaths(includePaths), includedFiles(includedFiles), currentToken(TextLocation())
     {
         keywords = set<wstring>{
             L"include",
@@ -483,6 +484,8 @@ private:
                 if (nameTok.kind != stringliteral)
                     Fail(L"'include' must be followed by a quoted string", nameTok);
                 let path = FindSourceFile(nameTok.symbol, includePaths);
+                if (includedFiles)
+                    includedFiles->push_back(path);
                 PushSourceFile(SourceFile(path)); // current cursor is right after the pathname; that's where we will pick up later
                 includePaths.insert(includePaths.begin(), File::DirectoryPathOf(path));
                 return NextToken();
@@ -670,8 +673,8 @@ class Parser : public Lexer
     static const int unaryPrecedence = 90;  // for unary "-" and "!". 90 is below x., x[, x(, and x{, but above all others
     // TODO: Would be more direct to fold this into the table below as well.
 public:
-    Parser(SourceFile&& sourceFile, vector<wstring>&& includePaths)
-        : Lexer(move(includePaths))
+    Parser(SourceFile&& sourceFile, vector<wstring>&& includePaths, vector<wstring>* includedFiles = nullptr)
+        : Lexer(move(includePaths), includedFiles)
     {
         infixPrecedence = map<wstring, int>{
             {L".", 99}, {L"[", 99}, {L"(",   99}, {L"{",   99}, // (with LHS) these are also sort-of infix operands...
@@ -988,13 +991,13 @@ public:
 };
 
 // globally exported functions to execute the parser
-static ExpressionPtr Parse(SourceFile&& sourceFile, vector<wstring>&& includePaths)
+static ExpressionPtr Parse(SourceFile&& sourceFile, vector<wstring>&& includePaths, vector<wstring>* includedFiles = nullptr)
 {
-    return Parser(move(sourceFile), move(includePaths)).ParseRecordMembersToDict();
+    return Parser(move(sourceFile), move(includePaths), includedFiles).ParseRecordMembersToDict();
 }
-ExpressionPtr ParseConfigDictFromString(wstring text, wstring location, vector<wstring>&& includePaths)
+ExpressionPtr ParseConfigDictFromString(wstring text, wstring location, vector<wstring>&& includePaths, vector<wstring>* includedFiles)
 {
-    return Parse(SourceFile(location, text), move(includePaths));
+    return Parse(SourceFile(location, text), move(includePaths), includedFiles);
 }
 //ExpressionPtr ParseConfigDictFromFile(wstring path, vector<wstring> includePaths)
 //{
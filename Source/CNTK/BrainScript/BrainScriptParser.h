@@ -139,7 +139,8 @@ struct Expression
 typedef Expression::ExpressionPtr ExpressionPtr; // circumvent some circular definition problem
 
 // access the parser through one of these functions
-ExpressionPtr ParseConfigDictFromString(wstring text, wstring location, vector<wstring>&& includePaths);          // parses a list of dictionary members, returns a dictionary expression
+ExpressionPtr ParseConfigDictFromString(wstring text, wstring location, vector<wstring>&& includePaths,
+                                        vector<wstring>* includedFiles = nullptr); // parses a list of dictionary members, returns a dictionary expression; optionally lists the paths of all included files
 // TODO: These rvalue references are no longer adding value, change to const<>&
 //ExpressionPtr ParseConfigDictFromFile(wstring path, vector<wstring> includePaths);              // likewise, but from a file path
 ExpressionPtr ParseConfigExpression(const wstring& sourceText, vector<wstring>&& includePaths); // parses a single expression from sourceText, which is meant to contain an include statement, hence includePaths
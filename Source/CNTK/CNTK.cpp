@@ -27,6 +27,7 @@
 #include "SGD.h"
 #include "MPIWrapper.h"
 #include "EnvironmentUtil.h"
+#include "NumaPolicy.h"
 #include "Config.h"
 #include "SimpleEvaluator.h"
 #include "SimpleOutputWriter.h"
@@ -79,9 +80,10 @@ void SetupProfiling(ProfilerContext& profilerContext, const ConfigParamType& con
     {
         wstring workDir = config(L"WorkDir", L".");
         profilerContext.Init(workDir + L"/profiler",
-                             config(L"profilerBufferSize", static_cast<uint64_t>(32 * 1024 * 1024)),
+                             config(L"profilerBufferSize", static_cast<uint64_t>(32 * 1024 * 1024)), // allocated for each thread that records events
                              std::to_wstring(nodeRank),
-                             config(L"profilerSyncGpu", true));
+                             config(L"profilerSyncGpu", true),
+                             nodeRank);
     }
 }
 
@@ -203,6 +205,10 @@ bool DispatchThisAction(const string &thisAction, const ConfigParameters &comman
     {
         DoWriteOutput<ElemType>(commandParams);
     }
+    else if (thisAction == "optimizeForInference")
+    {
+        DoOptimizeForInference<ElemType>(commandParams);
+    }
     else if (thisAction == "devtest")
     {
         TestCn<ElemType>(config); // for "devtest" action pass the root config instead
@@ -235,6 +241,10 @@ bool DispatchThisAction(const string &thisAction, const ConfigParameters &comman
     {
         DoParameterSVD<ElemType>(commandParams);
     }
+    else if (thisAction == "benchmarkReader")
+    {
+        DoBenchmarkReader<ElemType>(commandParams);
+    }
     else
     {
         return false;
@@ -274,6 +284,9 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
             LOGPRINTF(stderr, "Using %d CPU threads.\n", numCPUThreads);
         }
     }
+    // bind threads and memory to NUMA nodes; after the thread count is set, as this pins the OpenMP threads
+    wstring numaPolicy = config(L"numaPolicy", L"none");
+    NumaPolicy::Apply(NumaPolicy::ParseMode(numaPolicy), EnvironmentUtil::GetLocalMPINodeRankOnMachine());
 
     bool progressTracing = config(L"progressTracing", false);
 
@@ -497,6 +510,11 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
         Globals::ForceDeterministicAlgorithms();
     if (config(L"forceConstantRandomSeed", false))
         Globals::ForceConstantRandomSeed();
+    if (config(L"cpuConvolutionAutotune", false))
+    {
+        wstring autotuningCacheFile = config(L"cpuConvolutionAutotuneCache", L"");
+        SetCpuConvolutionAutotuning(true, autotuningCacheFile);
+    }
 
 #ifndef CPUONLY
     auto valpp = config.Find(L"deviceId");
@@ -537,6 +555,7 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
 
     Globals::SetShareNodeValueMatrices(config(L"shareNodeValueMatrices", true));
     Globals::SetGradientAccumulationOptimization(config(L"optimizeGradientAccumulation", true));
+    Globals::SetConcurrentTraversalThreads(config(L"concurrentTraversalThreads", (size_t)0));
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
 
@@ -572,6 +591,8 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
         if (numCPUThreads > 0)
             LOGPRINTF(stderr, "Using %d CPU threads.\n", numCPUThreads);
     }
+    wstring numaPolicy = config(L"numaPolicy", L"none");
+    NumaPolicy::Apply(NumaPolicy::ParseMode(numaPolicy), EnvironmentUtil::GetLocalMPINodeRankOnMachine());
 
     bool progressTracing = config(L"progressTracing", false);
     size_t fullTotalMaxEpochs = 1; // BUGBUG: BS does not allow me to read out the max epochs parameters, as that would instantiate and thus execute the objects
@@ -666,6 +687,11 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[])
         Globals::ForceDeterministicAlgorithms();
     if (config(L"forceConstantRandomSeed", false))
         Globals::ForceConstantRandomSeed();
+    if (config(L"cpuConvolutionAutotune", false))
+    {
+        wstring autotuningCacheFile = config(L"cpuConvolutionAutotuneCache", L"");
+        SetCpuConvolutionAutotuning(true, autotuningCacheFile);
+    }
 
     // get the command param set they want
     wstring logpath = config(L"stderr", L"");
@@ -689,6 +715,7 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[])
 
     Globals::SetShareNodeValueMatrices(config(L"shareNodeValueMatrices", true));
     Globals::SetGradientAccumulationOptimization(config(L"optimizeGradientAccumulation", true));
+    Globals::SetConcurrentTraversalThreads(config(L"concurrentTraversalThreads", (size_t)0));
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
 
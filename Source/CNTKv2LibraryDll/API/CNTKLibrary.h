@@ -3244,6 +3244,10 @@ namespace CNTK
         /// Note that the returned BackPropState instance also stores a reference to the supplied 'inputs' Values and generated 'outputs' Values
         /// and the user is responsible for ensuring that the contents of the inputs and outputs are unchanged until after any uses of the BackPropState instance
         /// for backpropagating gradients through this Function.
+        /// Dense argument Values without gaps that already live on 'computeDevice' (and sparse ones in the input's storage format) are not copied:
+        /// the Function reads their storage directly until the next Forward call, and keeps the Value objects alive until then.
+        /// A buffer that such a Value merely wraps (e.g. an NDArrayView created over caller memory) must therefore stay allocated and unchanged
+        /// until the next Forward call; callers that want to reuse it earlier must pass a copy instead.
         ///
         CNTK_API BackPropStatePtr Forward(const std::unordered_map<Variable, ValuePtr>& arguments,
                                           std::unordered_map<Variable, ValuePtr>& outputs,
@@ -5655,6 +5659,18 @@ namespace CNTK
         ///
         CNTK_API void SaveCheckpoint(const std::wstring& filePath, Dictionary externalState = Dictionary());
 
+        ///
+        /// Checkpoint the model and other Trainer state at the specified file location without waiting for the files to be written.
+        /// The model and learner state are snapshotted on the calling thread; serialization, fsync and the final rename happen
+        /// on a background thread. If a previous asynchronous checkpoint is still being written, this call waits for it first.
+        ///
+        CNTK_API void SaveCheckpointAsync(const std::wstring& filePath, Dictionary externalState = Dictionary());
+
+        ///
+        /// Block until the checkpoint started by the last SaveCheckpointAsync call (if any) has been written.
+        ///
+        CNTK_API void WaitForPendingCheckpoint();
+
         ///
         /// Restore the model and trainer state from a previously saved model and checkpoint from the specified file location
         ///
@@ -5730,8 +5746,9 @@ namespace CNTK
         bool TrainLocalMinibatch(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputsToFetch, bool sweepEnd, const DeviceDescriptor& computeDevice);
         bool TrainDistributedMinibatch(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputsToFetch, bool sweepEnd, const DeviceDescriptor& computeDevice);
 
+        void SaveCheckpoint(const std::wstring& modelFilePath, Dictionary externalState, bool async);
         void Save(const std::wstring& modelFilePath, const std::vector<DictionaryValue>& learnerState,
-            const Dictionary& externalState, const Dictionary& distributedState = {});
+            const Dictionary& externalState, const Dictionary& distributedState, bool async);
 
         void UpdateTrainingProgress(size_t numSamples, const ValuePtr& loss, const ValuePtr& evalCriterion, const DeviceDescriptor& computeDevice);
         void AddProgressWriters(const std::vector<ProgressWriterPtr>& progressWriters);
@@ -5755,6 +5772,9 @@ namespace CNTK
         AccumulatorPtr m_aggregatedTrainingEvalCriterionValue;
 
         size_t m_prevDistributedTotalNumSamples;
+
+        // Background write of the last asynchronous checkpoint.
+        std::future<void> m_pendingCheckpoint;
     };
 
     ///
@@ -6132,6 +6152,51 @@ namespace CNTK
         std::unordered_map<StreamInformation, std::pair<NDArrayViewPtr, NDArrayViewPtr>>& computedMeanAndVariances,
         const DeviceDescriptor& device = DeviceDescriptor::CPUDevice());
 
+    ///
+    /// Latency statistics of one stage of the minibatch source pipeline, in seconds.
+    /// Percentiles are estimated from a logarithmic histogram, to within about 10%.
+    ///
+    struct MinibatchSourceStageLatency
+    {
+        size_t count;
+        double meanSeconds;
+        double p50Seconds;
+        double p90Seconds;
+        double p99Seconds;
+    };
+
+    ///
+    /// Result of one run of BenchmarkMinibatchSource().
+    /// 'stageLatencies' is keyed by stage: "getMinibatch" (as seen by the caller), "prefetchWait" (caller stalled on the
+    /// prefetch), "prefetch" (background thread), "readSequences" (deserializers, randomizer and transforms), "pack" and "copy".
+    ///
+    struct MinibatchSourceBenchmarkResult
+    {
+        size_t numCPUThreads;
+        size_t numMinibatches;
+        size_t numSamples;                  // of the stream with the most samples, summed over the minibatches
+        size_t numBytes;                    // of all streams, as copied out of the minibatch source
+        double seconds;
+        double prefetchStallSeconds;
+        std::map<std::wstring, MinibatchSourceStageLatency> stageLatencies;
+
+        double SamplesPerSecond() const { return numSamples / seconds; }
+        double BytesPerSecond() const { return numBytes / seconds; }
+    };
+
+    ///
+    /// Measure the throughput of the data pipeline of a minibatch source without a model: for each of the specified CPU thread
+    /// counts (0 keeps the current setting), create a minibatch source from 'configuration' and read 'numMinibatches' minibatches
+    /// after 'numWarmupMinibatches'. Stage latencies are taken from the performance profiler, which is started for the benchmark
+    /// unless it is already running.
+    ///
+    CNTK_API std::vector<MinibatchSourceBenchmarkResult> BenchmarkMinibatchSource(const MinibatchSourceConfig& configuration,
+        size_t minibatchSizeInSamples,
+        size_t numMinibatches,
+        const std::vector<size_t>& numCPUThreads = { 0 },
+        size_t numWarmupMinibatches = 10,
+        const DeviceDescriptor& device = DeviceDescriptor::CPUDevice());
+
     ///
     /// Set the process-wide setting for maximum number of CPU threads to be used by any individual compute operation
     /// Note that this is a per compute operation limit and if the user performs multiple compute operations concurrently
@@ -6312,19 +6377,23 @@ namespace CNTK
         /// checkpointFrequencyInSamples: frequency in samples when to perform checkpointing.
         /// restoreFromCheckpointIfExists: if flag is set, the training session will try to restore before training.
         /// preserveAllCheckpoints: if flag is set, all checkpoints will be preserved.
+        /// asyncCheckpointing: if flag is set, intermediate checkpoints are written on a background thread,
+        ///                     training only blocks while the model and learner state are snapshotted.
         ///
         CNTK_API CheckpointConfig(
             const std::wstring& checkPointFileName,
             size_t checkpointFrequency = std::numeric_limits<size_t>::max(),
             DataUnit checkpointFrequencyUnit = DataUnit::Sample,
             bool restoreFromCheckpointIfExists = true,
-            bool preserveAllCheckpoints = false);
+            bool preserveAllCheckpoints = false,
+            bool asyncCheckpointing = false);
 
     private:
         friend class TrainingSession;
         const std::wstring m_fileName;
         const bool m_restore;
         const bool m_preserveAll;
+        const bool m_async;
         const size_t m_frequency;
         const DataUnit m_frequencyUnit;
     };
@@ -6493,6 +6562,9 @@ namespace CNTK
         CheckpointConfig m_checkpoint;
         CrossValidationConfig m_cv;
         TestConfig m_test;
+
+        // Total time the training loop was blocked by checkpointing.
+        size_t m_checkpointBlockedMilliseconds;
     };
 
     ///
@@ -6562,6 +6634,14 @@ namespace CNTK
         CNTK_API virtual void OnWriteTestSummary(size_t /*samples*/, size_t /*updates*/, size_t /*summaries*/,
                                                  double /*aggregateMetric*/, size_t /*elapsedMilliseconds*/) {};
 
+        ///
+        /// Actually outputs information about a checkpoint written by the training session. 'blockedMilliseconds' is the
+        /// time training was stalled by this checkpoint, 'totalBlockedMilliseconds' the total since the start of training.
+        /// Overridable in derived classes.
+        ///
+        CNTK_API virtual void OnWriteCheckpointUpdate(size_t /*checkpointIndex*/, size_t /*blockedMilliseconds*/,
+                                                      size_t /*totalBlockedMilliseconds*/) {};
+
         ///
         /// Writes out the string key together with the specified value.
         ///
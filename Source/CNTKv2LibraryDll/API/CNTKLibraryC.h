@@ -235,6 +235,34 @@ CNTK_API CNTK_StatusCode CNTK_EvaluateSequence(CNTK_ModelHandle model,
     /*[in]*/uint32_t numOutputs,
     /*[in/out]*/CNTK_Value** outputValues);
 
+//
+// Options of a batching model, see CNTK_CreateBatchingModel.
+//
+typedef struct CNTK_BatchingOptions
+{
+    uint32_t maxBatchSize;            // Maximum number of requests coalesced into a single minibatch.
+    uint32_t maxLatencyMicroseconds;  // Maximum time the oldest queued request waits for other requests to join its minibatch.
+    uint32_t numReplicas;             // Number of replicas sharing the model parameters that evaluate minibatches concurrently.
+} CNTK_BatchingOptions;
+
+//
+// Creates a batching model on top of the specified model. Concurrent CNTK_EvaluateSequence calls
+// on the returned handle are queued, coalesced into one packed minibatch (each request being a separate sequence)
+// and evaluated on a pool of replicas that share the parameters of the original model.
+// Every call blocks until its own results are available. Because requests from different callers
+// are packed together, each request must start a new sequence, i.e. all its reset flags must be true.
+// The returned handle is released with CNTK_ReleaseModel, the original model can be released independently.
+//
+// Parameters:
+//    model [in]: model to evaluate
+//    options [in]: batching options
+//    batched [out]: the resulting batching model
+//
+CNTK_API CNTK_StatusCode CNTK_CreateBatchingModel(
+    /*[in]*/ CNTK_ModelHandle model,
+    /*[in]*/ const CNTK_BatchingOptions* options,
+    /*[out]*/ CNTK_ModelHandle* batched);
+
 //
 // Auxiliary functions.
 //
@@ -297,6 +297,9 @@ namespace CNTK
         CNTK_API void ForceDeterministicAlgorithms();
         CNTK_API bool ShouldForceDeterministicAlgorithms();
 
+        CNTK_API void SetCPUConvolutionAutotuning(bool enable, const std::wstring& cacheFilePath = L"");
+        CNTK_API bool IsCPUConvolutionAutotuningEnabled();
+
         CNTK_API void EnableSynchronousGPUKernelExecution();
         CNTK_API bool IsSynchronousGPUKernelExecutionEnabled();
 
@@ -315,7 +318,7 @@ namespace CNTK
         CNTK_API void EnableGradientAccumulationOptimization();
         CNTK_API void DisableGradientAccumulationOptimization();
 
-        static const uint64_t DefaultProfilerBufferSize = 32 * 1024 * 1024;
+        static const uint64_t DefaultProfilerBufferSize = 32 * 1024 * 1024; // per thread that records events
         CNTK_API void StartProfiler(const std::wstring& profilerDir = L"profiler", bool profilerSyncGpu = false, size_t profilerBufferSize = DefaultProfilerBufferSize);
         CNTK_API void EnableProfiler();
         CNTK_API void DisableProfiler();
@@ -9,7 +9,12 @@
 #include <boost/noncopyable.hpp>
 #include <memory>
 #include <vector>
+#include <deque>
 #include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 #include <codecvt>
 #include <locale>
 
@@ -102,6 +107,7 @@ namespace CNTK
         virtual void GetModelOutputsInfo(CNTK_Variable** outputs, uint32_t* numOutputs) = 0;
 
         virtual std::unique_ptr<EvaluatorWrapper> Clone(CNTK_ParameterCloningMethod method, bool flatten) = 0;
+        virtual std::unique_ptr<EvaluatorWrapper> CreateBatching(const CNTK_BatchingOptions& options) = 0;
         virtual void EvaluateSequence(
             const CNTK_Variable* inputs,
             const CNTK_Value* inputValues,
@@ -160,6 +166,7 @@ namespace CNTK
         void GetModelOutputsInfo(CNTK_Variable** outputs, uint32_t* numOutputs) override;
 
         std::unique_ptr<EvaluatorWrapper> Clone(CNTK_ParameterCloningMethod method, bool flatten) override;
+        std::unique_ptr<EvaluatorWrapper> CreateBatching(const CNTK_BatchingOptions& options) override;
 
         void EvaluateSequence(
             const CNTK_Variable* inputs,
@@ -176,6 +183,81 @@ namespace CNTK
         std::unordered_map<std::string, Variable> m_arguments;
         std::unordered_map<std::string, Variable> m_outputs;
     };
+
+    //
+    // A wrapper that coalesces concurrent EvaluateSequence calls into packed minibatches.
+    // Requests are queued and picked up by a pool of worker threads, each owning a replica
+    // of the model that shares parameters with the original. A worker takes up to maxBatchSize
+    // compatible requests (same inputs and outputs), waiting at most maxLatencyMicroseconds
+    // after the oldest one arrived, evaluates them as one minibatch with a sequence per request
+    // and splits the results back to the callers. Input shapes are checked before a request is queued,
+    // so that a malformed request fails on its own instead of failing the minibatch it is packed into.
+    //
+    class BatchingEvaluatorWrapper : public EvaluatorWrapper
+    {
+    public:
+        BatchingEvaluatorWrapper(FunctionPtr model, DeviceDescriptor device, const CNTK_BatchingOptions& options);
+        ~BatchingEvaluatorWrapper();
+
+        void GetModelArgumentsInfo(CNTK_Variable** inputs, uint32_t* numInputs) override;
+        void GetModelOutputsInfo(CNTK_Variable** outputs, uint32_t* numOutputs) override;
+
+        std::unique_ptr<EvaluatorWrapper> Clone(CNTK_ParameterCloningMethod method, bool flatten) override;
+        std::unique_ptr<EvaluatorWrapper> CreateBatching(const CNTK_BatchingOptions& options) override;
+
+        void EvaluateSequence(
+            const CNTK_Variable* inputs,
+            const CNTK_Value* inputValues,
+            const bool* inputResetFlags,
+            uint32_t numInputs,
+            const CNTK_Variable* outputs,
+            uint32_t numOutputs,
+            CNTK_Value** outputValues) override;
+
+    private:
+        // A single EvaluateSequence call waiting in the queue.
+        // Input buffers belong to the caller, who is blocked until 'm_done' is set.
+        struct Request
+        {
+            std::vector<std::string> m_inputNames;
+            std::vector<std::string> m_outputNames;
+            std::vector<NDShape> m_sampleShapes; // per input, with the free dimensions of the argument bound
+            const CNTK_Value* m_inputValues;
+            std::chrono::steady_clock::time_point m_arrival;
+
+            // Filled by the worker thread, one entry per output.
+            std::vector<std::vector<float>> m_results;
+            std::vector<NDShape> m_resultShapes;
+            std::exception_ptr m_error;
+            bool m_done;
+        };
+        typedef std::shared_ptr<Request> RequestPtr;
+
+        // A replica of the model owned by a single worker thread.
+        struct Replica
+        {
+            FunctionPtr m_func;
+            std::unordered_map<std::string, Variable> m_arguments;
+            std::unordered_map<std::string, Variable> m_outputs;
+        };
+
+        static NDShape GetSampleShape(const Variable& argument, const char* name, const CNTK_Value& value);
+        void WorkerLoop(Replica& replica);
+        std::vector<RequestPtr> DequeueBatch();
+        void EvaluateBatch(Replica& replica, const std::vector<RequestPtr>& batch);
+
+        FunctionPtr m_func;
+        DeviceDescriptor m_device;
+        CNTK_BatchingOptions m_options;
+        std::vector<std::unique_ptr<Replica>> m_replicas;
+        std::vector<std::thread> m_workers;
+
+        std::mutex m_mutex;
+        std::condition_variable m_queueChanged;
+        std::condition_variable m_requestDone;
+        std::deque<RequestPtr> m_queue;
+        bool m_stopping;
+    };
 }
 
 //#pragma warning(pop)
@@ -187,6 +187,24 @@ CNTK_StatusCode CNTK_EvaluateSequence(CNTK_ModelHandle model,
     });
 }
 
+CNTK_StatusCode CNTK_CreateBatchingModel(CNTK_ModelHandle model, const CNTK_BatchingOptions* options, CNTK_ModelHandle* batched)
+{
+    if (model == CNTK_INVALID_MODEL_HANDLE)
+        return StatusCode(CNTK_INVALID_MODEL_HANDLE, "Invalid model handle");
+
+    if (!options)
+        return StatusCode(CNTK_ERROR_NULL_POINTER, "'options' parameter is not allowed to be null");
+
+    if (!batched)
+        return StatusCode(CNTK_ERROR_NULL_POINTER, "'batched' parameter is not allowed to be null");
+
+    if (options->maxBatchSize == 0 || options->numReplicas == 0)
+        return StatusCode(CNTK_ERROR_INVALID_INPUT, "'maxBatchSize' and 'numReplicas' options must be greater than zero");
+
+    *batched = nullptr;
+    return ExceptionCatcher::Call([&]() { *batched = ((EvaluatorWrapper*)model)->CreateBatching(*options).release(); });
+}
+
 void CNTK_ReleaseArray(void* array)
 {
     // No destructor will be called!
@@ -175,17 +175,20 @@ namespace CNTK
         {
 #ifndef CNTK_UWP
             std::wstring logSuffix = L"";
+            int rank = 0;
             auto mpi = Microsoft::MSR::CNTK::MPIWrapper::GetInstance();
             if (mpi)
             {
-                logSuffix = std::to_wstring(mpi->CurrentNodeRank());
+                rank = (int)mpi->CurrentNodeRank();
+                logSuffix = std::to_wstring(rank);
             }
 
             Microsoft::MSR::CNTK::ProfilerInit(
                 profilerDir,
                 profilerBufferSize,
                 logSuffix,
-                profilerSyncGpu);
+                profilerSyncGpu,
+                rank);
 #endif
         }
 
@@ -598,6 +601,16 @@ namespace CNTK
             return Microsoft::MSR::CNTK::Globals::ShouldForceDeterministicAlgorithms();
         }
 
+        void SetCPUConvolutionAutotuning(bool enable, const std::wstring& cacheFilePath)
+        {
+            Microsoft::MSR::CNTK::SetCpuConvolutionAutotuning(enable, cacheFilePath);
+        }
+
+        bool IsCPUConvolutionAutotuningEnabled()
+        {
+            return Microsoft::MSR::CNTK::IsCpuConvolutionAutotuningEnabled();
+        }
+
         void EnableSynchronousGPUKernelExecution()
         {
             SyncGuard::EnableSync();
@@ -1833,19 +1833,56 @@ namespace CNTK
     }
 
     template <typename ElementType>
-    /*static*/ void CompositeFunction::PopulateComputationNodeValue(const std::pair<Variable, ValuePtr>& variableValue, ComputationNodeBasePtr& computationNode, std::unordered_map<MBLayoutPtr, Variable>& layoutsPopulated)
+    /*static*/ void CompositeFunction::PopulateComputationNodeValue(const std::pair<Variable, ValuePtr>& variableValue, ComputationNodeBasePtr& computationNode, std::unordered_map<MBLayoutPtr, Variable>& layoutsPopulated, InputBinding* binding /*= nullptr*/)
     {
+        auto& nodeValuePtr = computationNode->As<ComputationNode<ElementType>>()->ValuePtrRef();
+
+        std::shared_ptr<Matrix<ElementType>> nodeStorage, gatherIndices;
+        if (binding)
+        {
+            if (binding->m_node != computationNode)
+                *binding = { computationNode, nodeValuePtr, std::make_shared<Matrix<ElementType>>(nodeValuePtr->GetDeviceId()), nullptr };
+            binding->m_aliasedValue = nullptr;
+
+            nodeStorage = std::static_pointer_cast<Matrix<ElementType>>(binding->m_nodeStorage);
+            gatherIndices = std::static_pointer_cast<Matrix<ElementType>>(binding->m_gatherIndices);
+        }
+
+        // The supplied data can be used by the node as is only if it lives on the node's device in the node's matrix format
+        const auto& value = variableValue.second;
+        bool isCompatibleWithNodeStorage = nodeStorage &&
+                                           (AsCNTKImplDeviceId(value->Device()) == nodeStorage->GetDeviceId()) &&
+                                           (value->IsSparse() == (nodeStorage->GetMatrixType() == MatrixType::SPARSE)) &&
+                                           (!value->IsSparse() || (AsCNTKImplMatrixFormat(value->GetStorageFormat()) == nodeStorage->GetFormat()));
+
+        // If the data has to be reshuffled, gather it straight into the node's own storage
         NDShape inferredVariableShape;
-        std::pair<std::shared_ptr<const Matrix<ElementType>>, MBLayoutPtr> CNTKMatrixAndMBLayout = Utils::GetCNTKImplMatrixAndMBLayoutFromValueObject<ElementType>(variableValue.first, variableValue.second, &inferredVariableShape);
+        std::pair<std::shared_ptr<const Matrix<ElementType>>, MBLayoutPtr> CNTKMatrixAndMBLayout = isCompatibleWithNodeStorage ?
+            Utils::GetCNTKImplMatrixAndMBLayoutFromValueObject<ElementType>(variableValue.first, value, &inferredVariableShape, nodeStorage, gatherIndices) :
+            Utils::GetCNTKImplMatrixAndMBLayoutFromValueObject<ElementType>(variableValue.first, value, &inferredVariableShape);
         if (!VariableShapeMatchesNodeShape(inferredVariableShape, computationNode->GetSampleLayout()))
             CNTK::LogicError("CompositeFunction::Forward: Inferred shape '%S' of Variable '%S' does not match the corresponding computation node shape '%s'.",
                              inferredVariableShape.AsString().c_str(), variableValue.first.AsString().c_str(), ((std::string)computationNode->GetSampleLayout()).c_str());
 
-        // Switch the node matrix to the right matrix type
-        auto& nodeData = computationNode->As<ComputationNode<ElementType>>()->Value();
-        nodeData.AssignValuesOf(*CNTKMatrixAndMBLayout.first);
-
         auto layout = CNTKMatrixAndMBLayout.second;
+        if (CNTKMatrixAndMBLayout.first == nodeStorage)
+            nodeValuePtr = nodeStorage;
+        else if (isCompatibleWithNodeStorage && (!layout || !layout->HasGaps()))
+        {
+            // Input nodes never write to their value other than masking gap columns, so gap-free data
+            // is aliased instead of copied. The aliased data must therefore stay unchanged until the next Forward call.
+            nodeValuePtr = std::make_shared<Matrix<ElementType>>(CNTKMatrixAndMBLayout.first->AsReference());
+            binding->m_aliasedValue = value;
+        }
+        else
+        {
+            // Switch the node matrix to the right matrix type
+            if (nodeStorage)
+                nodeValuePtr = nodeStorage;
+
+            nodeValuePtr->AssignValuesOf(*CNTKMatrixAndMBLayout.first);
+        }
+
         auto& nodeLayout = computationNode->GetMBLayout();
         if ((layout == nullptr) != (nodeLayout == nullptr))
             InvalidArgument("The layout of the specified Value for Variable '%S' is incompatible with the layout of the corresponding ComputationNode.", variableValue.first.AsString().c_str());
@@ -1853,7 +1890,10 @@ namespace CNTK
         {
             if (layoutsPopulated.find(nodeLayout) == layoutsPopulated.end())
             {
-                nodeLayout->CopyFrom(layout);
+                // Keep the node's layout, along with its cached column masks, if the sequence structure is unchanged
+                if (*nodeLayout != *layout)
+                    nodeLayout->CopyFrom(layout);
+
                 layoutsPopulated.insert({ nodeLayout, variableValue.first });
             }
             else
@@ -1923,16 +1963,17 @@ namespace CNTK
             inputNodes.push_back(argumentComputationNode);
 
             ValuePtr argumentValue = arguments.at(argument);
+            auto& binding = m_inputBindings[argument];
             switch (argumentValue->GetDataType())
             {
             case DataType::Float:
-                PopulateComputationNodeValue<float>({ argument, argumentValue }, argumentComputationNode, layoutsPopulated);
+                PopulateComputationNodeValue<float>({ argument, argumentValue }, argumentComputationNode, layoutsPopulated, &binding);
                 break;
             case DataType::Double:
-                PopulateComputationNodeValue<double>({ argument, argumentValue }, argumentComputationNode, layoutsPopulated);
+                PopulateComputationNodeValue<double>({ argument, argumentValue }, argumentComputationNode, layoutsPopulated, &binding);
                 break;
             case DataType::Float16:
-                PopulateComputationNodeValue<half>({ argument, argumentValue }, argumentComputationNode, layoutsPopulated);
+                PopulateComputationNodeValue<half>({ argument, argumentValue }, argumentComputationNode, layoutsPopulated, &binding);
                 break;
             default:
                 LogicError("Function '%S' Forward: Unsupported DataType %s.", AsString().c_str(), DataTypeName(argumentValue->GetDataType()));
@@ -1987,6 +2028,44 @@ namespace CNTK
         }
     }
 
+    // Copy a node's matrix straight into a caller supplied dense Value when unpacking would not reorder anything,
+    // i.e. when every parallel sequence spans the entire minibatch in stream order and only one of the
+    // sequence and time-step counts exceeds 1. The Value must have exactly the unpacked shape, so that the
+    // column-major layouts agree. Returns false if the general unpacking path is needed.
+    template <typename ElementType>
+    /*static*/ bool CompositeFunction::TryCopyToUnpackedValue(const Matrix<ElementType>& matrix, const MBLayoutPtr& layout, const NDShape& unpackedShape, const ValuePtr& value)
+    {
+        auto packedValue = dynamic_cast<PackedValue*>(value.get());
+        if ((packedValue && packedValue->IsPacked()) || value->IsSparse() || value->IsReadOnly() || (value->Mask() != nullptr))
+            return false;
+
+        if (value->Shape() != unpackedShape)
+            return false;
+
+        if ((matrix.GetMatrixType() != MatrixType::DENSE) || (AsCNTKImplDeviceId(value->Device()) != matrix.GetDeviceId()))
+            return false;
+
+        if (layout)
+        {
+            if (layout->HasGaps() || ((layout->GetNumParallelSequences() != 1) && (layout->GetNumTimeSteps() != 1)))
+                return false;
+
+            size_t parallelSequenceIdx = 0;
+            for (const auto& sequenceInfo : layout->GetAllSequences())
+            {
+                if ((sequenceInfo.s != parallelSequenceIdx++) || (sequenceInfo.tBegin != 0) || (sequenceInfo.tEnd < layout->GetNumTimeSteps()))
+                    return false;
+            }
+        }
+
+        auto valueMatrix = value->Data()->GetWritableMatrix<ElementType>();
+        if (valueMatrix->GetNumElements() != matrix.GetNumElements())
+            return false;
+
+        valueMatrix->AssignValuesOf(matrix.Reshaped(valueMatrix->GetNumRows(), valueMatrix->GetNumCols()));
+        return true;
+    }
+
     /*static*/ void CompositeFunction::GetNodeOutputOrGradient(Variable var, ValuePtr& varValue, Microsoft::MSR::CNTK::ComputationNodeBasePtr& computationNode, bool getGradient)
     {
         auto varShape = GetVariableShape(var.Shape(), computationNode->GetSampleLayout());
@@ -2008,7 +2087,7 @@ namespace CNTK
             auto& matrix = getGradient ? computationNode->As<ComputationNode<float>>()->Gradient() : computationNode->As<ComputationNode<float>>()->Value();
             if (varValue == nullptr)
                 nodeValue = MakeSharedObject<PackedValue>(varShape, var.DynamicAxes(), std::make_shared<Matrix<float>>(matrix.AsReference()), layout, /*readOnly =*/ false);
-            else
+            else if (!TryCopyToUnpackedValue(matrix, layout, valueShape, varValue))
                 nodeValue = Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout<float>(var, computationNode, matrix, layout);
             break;
         }
@@ -2017,7 +2096,7 @@ namespace CNTK
             auto& matrix = getGradient ? computationNode->As<ComputationNode<double>>()->Gradient() : computationNode->As<ComputationNode<double>>()->Value();
             if (varValue == nullptr)
                 nodeValue = MakeSharedObject<PackedValue>(varShape, var.DynamicAxes(), std::make_shared<Matrix<double>>(matrix.AsReference()), layout, /*readOnly =*/ false);
-            else
+            else if (!TryCopyToUnpackedValue(matrix, layout, valueShape, varValue))
                 nodeValue = Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout<double>(var, computationNode, matrix, layout);
             break;
         }
@@ -2026,7 +2105,7 @@ namespace CNTK
             auto& matrix = getGradient ? computationNode->As<ComputationNode<half>>()->Gradient() : computationNode->As<ComputationNode<half>>()->Value();
             if (varValue == nullptr)
                 nodeValue = MakeSharedObject<PackedValue>(varShape, var.DynamicAxes(), std::make_shared<Matrix<half>>(matrix.AsReference()), layout, /*readOnly =*/ false);
-            else
+            else if (!TryCopyToUnpackedValue(matrix, layout, valueShape, varValue))
                 nodeValue = Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout<half>(var, computationNode, matrix, layout);
             break;
         }
@@ -2037,7 +2116,7 @@ namespace CNTK
 
         if (varValue == nullptr)
             varValue = nodeValue;
-        else
+        else if (nodeValue != nullptr)
             varValue->CopyFrom(*nodeValue);
     }
 
@@ -2193,7 +2272,6 @@ namespace CNTK
             InvalidArgument("Unsupported DataType %s", DataTypeName(dataType));
 
         // Feed data into the arguments of the network
-        // TODO: Avoid copying the data when possible
         PopulateNetworkInputs(requiredArgumentValues);
 
         // Copy all new values for 'dirty' attributes from functions into corresponding network nodes.
@@ -319,14 +319,28 @@ namespace CNTK
                                                                     const std::unordered_set<Variable>& inputsToExcludeGradientsFor,
                                                                     bool useMangledNamesForComputationNodes);
 
+        // Persistent binding of an argument to its input node, registered on the first Forward call.
+        // It holds on to the node's own value matrix, which is swapped back in whenever the argument data
+        // cannot be aliased, and to the scratch matrix used for reshuffling unpacked sequences.
+        // While the argument data is aliased, it also keeps the caller's Value alive until the next Forward call.
+        struct InputBinding
+        {
+            Microsoft::MSR::CNTK::ComputationNodeBasePtr m_node;
+            Microsoft::MSR::CNTK::MatrixBasePtr m_nodeStorage;
+            Microsoft::MSR::CNTK::MatrixBasePtr m_gatherIndices;
+            ValuePtr m_aliasedValue;
+        };
+
         template <typename ElementType>
-        static void PopulateComputationNodeValue(const std::pair<Variable, ValuePtr>& variableValue, Microsoft::MSR::CNTK::ComputationNodeBasePtr& computationNode, std::unordered_map< Microsoft::MSR::CNTK::MBLayoutPtr, Variable>& layoutsPopulated);
+        static void PopulateComputationNodeValue(const std::pair<Variable, ValuePtr>& variableValue, Microsoft::MSR::CNTK::ComputationNodeBasePtr& computationNode, std::unordered_map< Microsoft::MSR::CNTK::MBLayoutPtr, Variable>& layoutsPopulated, InputBinding* binding = nullptr);
         void PopulateNetworkInputs(const std::unordered_map<Variable, ValuePtr>& arguments);
 
         template <typename ElementType>
         static void PopulateComputationNodeGradient(const std::pair<Variable, ValuePtr>& variableGradient, Microsoft::MSR::CNTK::ComputationNodeBasePtr& computationNode);
         void PopulateNetworkGradients(const std::unordered_map<Variable, ValuePtr>& gradients);
 
+        template <typename ElementType>
+        static bool TryCopyToUnpackedValue(const Microsoft::MSR::CNTK::Matrix<ElementType>& matrix, const Microsoft::MSR::CNTK::MBLayoutPtr& layout, const NDShape& unpackedShape, const ValuePtr& value);
         static void GetNodeOutputOrGradient(Variable var, ValuePtr& varValue, Microsoft::MSR::CNTK::ComputationNodeBasePtr& computationNode, bool getGradient);
         void GetNetworkOutputs(std::unordered_map<Variable, ValuePtr>& outputs);
         void GetNetworkGradients(std::unordered_map<Variable, ValuePtr>& gradients);
@@ -355,6 +369,7 @@ namespace CNTK
             m_currentBackpropRoots.clear();
             m_inputsExcludedFromGradientComputation.clear();
             m_variableToNodeMap.clear();
+            m_inputBindings.clear();
             m_currentOutputsToEvaluate.clear();
             m_lastRecordedTimeStamps.clear();
 
@@ -390,6 +405,9 @@ namespace CNTK
         // Map to keep track of any references to network output/gradient storage handed out so far
         std::vector<PackedValueWeakPtr> m_existingNetworkStorageReferences;
 
+        // Input bindings of the arguments fed in Forward calls so far
+        std::unordered_map<Variable, InputBinding> m_inputBindings;
+
         // The backpropRoots specified in the most recent 'Forward' call on 'this' Function.
         // This indicates for which of its roots has 'this' Function retained required intermediate 
         // states from the previos Forward call to be able to backpropagate gradients backwards from in
@@ -154,4 +154,309 @@ namespace CNTK
             cloned = m_func->Clone(ToNative(method));
         return unique_ptr<EvaluatorWrapper>(new CNTKEvaluatorWrapper(cloned, m_device));
     }
+
+    unique_ptr<EvaluatorWrapper> CNTKEvaluatorWrapper::CreateBatching(const CNTK_BatchingOptions& options)
+    {
+        return unique_ptr<EvaluatorWrapper>(new BatchingEvaluatorWrapper(m_func, m_device, options));
+    }
+
+    // Batching evaluator
+    BatchingEvaluatorWrapper::BatchingEvaluatorWrapper(FunctionPtr model, DeviceDescriptor device, const CNTK_BatchingOptions& options)
+        : m_func(model), m_device(device), m_options(options), m_stopping(false)
+    {
+        if (m_options.maxBatchSize == 0 || m_options.numReplicas == 0)
+            InvalidArgument("Batching requires positive maximum batch size and number of replicas.");
+
+        // Each worker evaluates its own replica, the parameters are shared with the original model.
+        for (uint32_t i = 0; i < m_options.numReplicas; ++i)
+        {
+            unique_ptr<Replica> replica(new Replica());
+            replica->m_func = m_func->Clone(ParameterCloningMethod::Share);
+            for (const auto arg : replica->m_func->Arguments())
+                replica->m_arguments.insert(make_pair(WStringToString(arg.Name()), arg));
+            for (const auto arg : replica->m_func->Outputs())
+                replica->m_outputs.insert(make_pair(WStringToString(arg.Name()), arg));
+            m_replicas.push_back(std::move(replica));
+        }
+
+        for (auto& replica : m_replicas)
+            m_workers.push_back(thread(&BatchingEvaluatorWrapper::WorkerLoop, this, std::ref(*replica)));
+    }
+
+    BatchingEvaluatorWrapper::~BatchingEvaluatorWrapper()
+    {
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_queueChanged.notify_all();
+
+        for (auto& worker : m_workers)
+            worker.join();
+    }
+
+    void BatchingEvaluatorWrapper::GetModelArgumentsInfo(CNTK_Variable** inputs, uint32_t* numInputs)
+    {
+        assert(inputs != nullptr);
+        assert(numInputs != nullptr);
+        return GetVariableInfo(m_func->Arguments(), inputs, numInputs);
+    }
+
+    void BatchingEvaluatorWrapper::GetModelOutputsInfo(CNTK_Variable** outputs, uint32_t* numOutputs)
+    {
+        assert(outputs != nullptr);
+        assert(numOutputs != nullptr);
+        return GetVariableInfo(m_func->Outputs(), outputs, numOutputs);
+    }
+
+    unique_ptr<EvaluatorWrapper> BatchingEvaluatorWrapper::Clone(CNTK_ParameterCloningMethod method, bool flatten)
+    {
+        FunctionPtr cloned;
+        if (flatten)
+            cloned = m_func->CloneFlattened(ToNative(method));
+        else
+            cloned = m_func->Clone(ToNative(method));
+        return unique_ptr<EvaluatorWrapper>(new BatchingEvaluatorWrapper(cloned, m_device, m_options));
+    }
+
+    unique_ptr<EvaluatorWrapper> BatchingEvaluatorWrapper::CreateBatching(const CNTK_BatchingOptions& options)
+    {
+        return unique_ptr<EvaluatorWrapper>(new BatchingEvaluatorWrapper(m_func, m_device, options));
+    }
+
+    void BatchingEvaluatorWrapper::EvaluateSequence(
+        const CNTK_Variable* inputs,
+        const CNTK_Value* inputValues,
+        const bool* inputResetFlags,
+        uint32_t numInputs,
+        const CNTK_Variable* outputs,
+        uint32_t numOutputs,
+        CNTK_Value** outputValues)
+    {
+        // All replicas have the same argument and output names, validating against the first one.
+        const auto& replica = *m_replicas.front();
+
+        auto request = make_shared<Request>();
+        for (uint32_t i = 0; i < numInputs; ++i)
+        {
+            auto var = replica.m_arguments.find(inputs[i].name);
+            if (var == replica.m_arguments.end())
+                InvalidArgument("Unexpected argument.");
+
+            // Requests of different callers are packed as separate sequences of one minibatch,
+            // so the state of a previous sequence cannot be carried over.
+            if (!inputResetFlags[i])
+                InvalidArgument("Batching model only supports evaluation of new sequences, reset flag of argument '%s' must be set.", inputs[i].name);
+
+            request->m_inputNames.push_back(inputs[i].name);
+            request->m_sampleShapes.push_back(GetSampleShape(var->second, inputs[i].name, inputValues[i]));
+        }
+
+        for (uint32_t i = 0; i < numOutputs; ++i)
+        {
+            if (replica.m_outputs.find(outputs[i].name) == replica.m_outputs.end())
+                InvalidArgument("Unexpected output.");
+            request->m_outputNames.push_back(outputs[i].name);
+        }
+
+        request->m_inputValues = inputValues;
+        request->m_done = false;
+
+        {
+            unique_lock<mutex> lock(m_mutex);
+            request->m_arrival = chrono::steady_clock::now();
+            m_queue.push_back(request);
+            m_queueChanged.notify_one();
+            m_requestDone.wait(lock, [&request] { return request->m_done; });
+        }
+
+        if (request->m_error)
+            rethrow_exception(request->m_error);
+
+        if (request->m_results.size() != numOutputs)
+            RuntimeError("Number of evaluated outputs '%d' does not match passed value '%d'.",
+                (int)request->m_results.size(), (int)numOutputs);
+
+        if (*outputValues != nullptr) // Buffers have been preallocated.
+        {
+            for (uint32_t i = 0; i < numOutputs; ++i)
+            {
+                auto& buffer = (*outputValues)[i];
+                const auto& result = request->m_results[i];
+                if (ToNDShape(buffer.shape).TotalSize() < result.size())
+                    RuntimeError("Preallocated buffer for output '%s' is too small to hold the result.", outputs[i].name);
+                std::copy(result.begin(), result.end(), buffer.data);
+            }
+            return;
+        }
+
+        // Copy to outputs if none was provided.
+        auto arrayValueCleaner = std::bind(CleanAndDestroyValues, _1, numOutputs);
+        unique_ptr<CNTK_Value, decltype(arrayValueCleaner)> result(new CNTK_Value[numOutputs], arrayValueCleaner);
+        memset(result.get(), 0, sizeof(CNTK_Value) * numOutputs);
+        for (uint32_t i = 0; i < numOutputs; ++i)
+        {
+            // Making sure with cleaners we do not leak anything on exception.
+            CNTK_Value v{ {0, 0}, 0 };
+            unique_ptr<CNTK_Value, decltype(&CNTK_CleanValue)> valCleaner(&v, CNTK_CleanValue);
+            v.shape = FromNDShape(request->m_resultShapes[i]);
+            v.data = new float[request->m_results[i].size()];
+            std::copy(request->m_results[i].begin(), request->m_results[i].end(), v.data);
+            result.get()[i] = v;
+            valCleaner.release();
+        }
+
+        *outputValues = result.release();
+    }
+
+    // The leading axes of the value, which must match the shape of the argument except for its free dimensions,
+    // and whose size must divide the size of the value. Empty sequences are rejected as well.
+    NDShape BatchingEvaluatorWrapper::GetSampleShape(const Variable& argument, const char* name, const CNTK_Value& value)
+    {
+        const auto& argumentShape = argument.Shape();
+        auto valueShape = ToNDShape(value.shape);
+        bool matches = valueShape.Rank() >= argumentShape.Rank();
+        for (size_t k = 0; matches && k < argumentShape.Rank(); ++k)
+            matches = argumentShape[k] == valueShape[k] || argumentShape[k] == NDShape::FreeDimension;
+
+        auto sampleShape = matches ? valueShape.SubShape(0, argumentShape.Rank()) : NDShape();
+        if (!matches || sampleShape.TotalSize() == 0 || valueShape.TotalSize() == 0 || valueShape.TotalSize() % sampleShape.TotalSize() != 0)
+            InvalidArgument("Shape '%S' of the value of argument '%s' does not consist of samples of shape '%S'.",
+                valueShape.AsString().c_str(), name, argumentShape.AsString().c_str());
+        return sampleShape;
+    }
+
+    void BatchingEvaluatorWrapper::WorkerLoop(Replica& replica)
+    {
+        for (;;)
+        {
+            auto batch = DequeueBatch();
+            if (batch.empty())
+                return;
+
+            exception_ptr error;
+            try
+            {
+                EvaluateBatch(replica, batch);
+            }
+            catch (...)
+            {
+                error = current_exception();
+            }
+
+            {
+                lock_guard<mutex> lock(m_mutex);
+                for (auto& request : batch)
+                {
+                    request->m_error = error;
+                    request->m_done = true;
+                }
+            }
+            m_requestDone.notify_all();
+        }
+    }
+
+    vector<BatchingEvaluatorWrapper::RequestPtr> BatchingEvaluatorWrapper::DequeueBatch()
+    {
+        unique_lock<mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_queueChanged.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+            if (m_queue.empty())
+                return {}; // Stopping and nothing left to evaluate.
+
+            // Give other callers a chance to join the minibatch of the oldest request,
+            // unless the minibatch is already full or we are shutting down.
+            auto deadline = m_queue.front()->m_arrival + chrono::microseconds(m_options.maxLatencyMicroseconds);
+            if (!m_stopping && m_queue.size() < m_options.maxBatchSize && chrono::steady_clock::now() < deadline)
+            {
+                m_queueChanged.wait_until(lock, deadline);
+                continue;
+            }
+
+            // Only requests with the same inputs, sample shapes and outputs can be packed together.
+            auto head = m_queue.front();
+            vector<RequestPtr> batch;
+            for (auto it = m_queue.begin(); it != m_queue.end() && batch.size() < m_options.maxBatchSize;)
+            {
+                if ((*it)->m_inputNames == head->m_inputNames && (*it)->m_sampleShapes == head->m_sampleShapes &&
+                    (*it)->m_outputNames == head->m_outputNames)
+                {
+                    batch.push_back(*it);
+                    it = m_queue.erase(it);
+                }
+                else
+                    ++it;
+            }
+
+            // Let another worker pick up what is left.
+            if (!m_queue.empty())
+                m_queueChanged.notify_one();
+            return batch;
+        }
+    }
+
+    void BatchingEvaluatorWrapper::EvaluateBatch(Replica& replica, const vector<RequestPtr>& batch)
+    {
+        const auto& head = *batch.front();
+
+        // Prepare inputs, each request becomes a separate sequence of the minibatch.
+        unordered_map<Variable, ValuePtr> preparedInputs;
+        for (size_t i = 0; i < head.m_inputNames.size(); ++i)
+        {
+            const auto& var = replica.m_arguments.at(head.m_inputNames[i]);
+            const auto& sampleShape = head.m_sampleShapes[i]; // (checked for each request before it was queued)
+
+            vector<NDArrayViewPtr> sequences;
+            sequences.reserve(batch.size());
+            for (const auto& request : batch)
+            {
+                const auto& inputValue = request->m_inputValues[i];
+                auto totalSize = ToNDShape(inputValue.shape).TotalSize();
+                auto sequenceShape = sampleShape.AppendShape({ totalSize / sampleShape.TotalSize() });
+                const float* data = inputValue.data;
+                sequences.push_back(MakeSharedObject<NDArrayView>(DataType::Float, sequenceShape, data, totalSize * sizeof(float), DeviceDescriptor::CPUDevice()));
+            }
+
+            preparedInputs[var] = Value::Create(sampleShape, sequences, vector<bool>(batch.size(), true), m_device, /*readOnly =*/ true);
+        }
+
+        // Prepare outputs.
+        unordered_map<Variable, ValuePtr> preparedOutputs;
+        for (const auto& name : head.m_outputNames)
+            preparedOutputs[replica.m_outputs.at(name)] = nullptr;
+
+        replica.m_func->Evaluate(preparedInputs, preparedOutputs, m_device);
+
+        // Split the results back to the requests.
+        for (auto& request : batch)
+        {
+            request->m_results.resize(head.m_outputNames.size());
+            request->m_resultShapes.resize(head.m_outputNames.size());
+        }
+
+        for (size_t i = 0; i < head.m_outputNames.size(); ++i)
+        {
+            const auto& var = replica.m_outputs.at(head.m_outputNames[i]);
+            auto varToValue = preparedOutputs.find(var);
+            if (varToValue == preparedOutputs.end() || varToValue->second == nullptr)
+                RuntimeError("Could not retrieve ouput for variable '%s'", head.m_outputNames[i].c_str());
+
+            vector<vector<float>> sequences;
+            varToValue->second->CopyVariableValueTo(var, sequences);
+            if (sequences.size() != batch.size())
+                RuntimeError("Number of evaluated sequences '%d' does not match the number of requests '%d'.",
+                    (int)sequences.size(), (int)batch.size());
+
+            // Result shapes follow the unbatched evaluation: sample shape, then sequence length (if any) and a batch of one.
+            auto sampleSize = var.Shape().TotalSize();
+            bool hasSequenceAxis = var.DynamicAxes().size() > 1;
+            for (size_t j = 0; j < batch.size(); ++j)
+            {
+                auto shape = hasSequenceAxis ? var.Shape().AppendShape({ sequences[j].size() / sampleSize, 1 }) : var.Shape().AppendShape({ 1 });
+                batch[j]->m_resultShapes[i] = shape;
+                batch[j]->m_results[i] = std::move(sequences[j]);
+            }
+        }
+    }
 }
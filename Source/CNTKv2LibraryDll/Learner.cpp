@@ -126,6 +126,7 @@ namespace CNTK
             else
                 LogicError("Unsupported DataType %s", DataTypeName(dt));
         }
+        ResetLazyUpdateState();
     }
 
     // Clipping gradients to prevent outliers,
@@ -399,6 +400,10 @@ namespace CNTK
 
     /*virtual*/ Dictionary LearnerBase::CreateCheckpoint() /*override*/
     {
+        // Before checkpointing we need to sync the state so that the lazy updates
+        // for sparse gradients with timestamps are transparent to the user
+        FlushAllLazyUpdateState();
+
         Dictionary checkpoint;
 
         checkpoint[versionKey] = CurrentVersion();
@@ -509,6 +514,91 @@ namespace CNTK
         }
         //TODO: additional options are not deserialized. This was not done when AdditionalOption was introduced.
 
+        // The restored state is up to date, so reset all timestamps and current times of the lazy updates.
+        ResetLazyUpdateState();
+    }
+
+    // We periodically perform some dense work to prevent a) the timestamps overflowing and b) big differences
+    // between the lazy implementation and an equivalent dense implementation due to numerical issues with floating point numbers.
+    // TODO: consider exposing this somehow so that it is easy to test by setting it to small value.
+    /* static */ const int LearnerBase::s_lazyUpdateSyncInterval = 1 << 20;
+
+    // Bounds the memory of the decay history when the rates change often, e.g. with every minibatch size.
+    /* static */ const size_t LearnerBase::s_lazyUpdateMaxDecaySegments = 1 << 14;
+
+    static int* LazyUpdateTimestampsBuffer(const NDArrayViewPtr& lastUpdateTime)
+    {
+        return reinterpret_cast<int*>(const_cast<float*>(lastUpdateTime->DataBuffer<float>()));
+    }
+
+    int* LearnerBase::LazyUpdateTimestamps(const Parameter& parameter, const NDArrayViewPtr& gradientValue,
+                                           const std::vector<double>& decayRates, const LazyDecayHistory*& decayHistory) const
+    {
+        // When the gradient is sparse (block sparse column) we maintain a timestamp for every column
+        // The timestamp is allocated here and initialized to 0, meaning that at time 0 everything was
+        // up to date. When we perform the update, for every non-zero column the kernel first uses the
+        // timestamp and the decay history to apply all decay steps that a dense implementation would have
+        // applied to that column and then updates the timestamp for that column with the current time.
+        auto search = m_lazyUpdateState.find(parameter);
+        if (search == m_lazyUpdateState.end())
+        {
+            // NDArrayView only supports Float and Double and the following assert prevents surprises in non-standard platforms
+            static_assert(sizeof(int) <= sizeof(float), "Buffer for timestamps is not big enough on this platform");
+            const auto numCols = GetMatrixShape(parameter)[1];
+            const auto view = MakeSharedObject<NDArrayView>(float(0.0), NDShape({ numCols }), gradientValue->Device());
+            search = m_lazyUpdateState.emplace(parameter, LazyUpdateState{ view, LazyDecayHistory() }).first;
+        }
+
+        auto& state = search->second;
+        int* timestamps = LazyUpdateTimestampsBuffer(state.m_lastUpdateTime);
+        if (state.m_decayHistory.NumUpdates() >= s_lazyUpdateSyncInterval || state.m_decayHistory.NumSegments() >= s_lazyUpdateMaxDecaySegments)
+        {
+            // Once in a while sync the state and reset the timestamps and the history
+            FlushLazyUpdateState(parameter, state.m_decayHistory, timestamps);
+            state.m_decayHistory.Reset();
+        }
+        state.m_decayHistory.Append(decayRates);
+        decayHistory = &state.m_decayHistory;
+        return timestamps;
+    }
+
+    /*virtual*/ void LearnerBase::FlushLazyUpdateState(const Parameter& parameter, const LazyDecayHistory& decayHistory, int* timestamps) const
+    {
+        const auto numCols = GetMatrixShape(parameter)[1];
+        const auto& smoothedGradientValue = m_smoothedGradientValues.at(parameter);
+        if (parameter.GetDataType() == DataType::Float)
+        {
+            const auto& smoothedGradientMatrix = GetWritableMatrix<float>(smoothedGradientValue);
+            smoothedGradientMatrix->LazyDecayFlushState(numCols, decayHistory, timestamps);
+        }
+        else if (parameter.GetDataType() == DataType::Double)
+        {
+            const auto& smoothedGradientMatrix = GetWritableMatrix<double>(smoothedGradientValue);
+            smoothedGradientMatrix->LazyDecayFlushState(numCols, decayHistory, timestamps);
+        }
+        else
+            LogicError("Unexpected parameter data type");
+    }
+
+    void LearnerBase::FlushAllLazyUpdateState() const
+    {
+        for (auto& entry : m_lazyUpdateState)
+        {
+            auto& state = entry.second;
+            if (state.m_decayHistory.NumUpdates() == 0)
+                continue;
+            FlushLazyUpdateState(entry.first, state.m_decayHistory, LazyUpdateTimestampsBuffer(state.m_lastUpdateTime));
+            state.m_decayHistory.Reset();
+        }
+    }
+
+    void LearnerBase::ResetLazyUpdateState()
+    {
+        for (auto& entry : m_lazyUpdateState)
+        {
+            entry.second.m_decayHistory.Reset();
+            entry.second.m_lastUpdateTime->SetValue(0.0f);
+        }
     }
 
     void LearnerBase::ReportTrainingParameterValue(const TrainingParameterSchedule<double>& schedule, const wstring& name) const
@@ -617,8 +707,16 @@ namespace CNTK
         const auto learningRate = ElementType(LearningRate(trainingSampleCount));
         const auto momentum = ElementType(MomentumValueForMB(trainingSampleCount));
         const auto unitGainFactor = UnitGainFactor<ElementType>(trainingSampleCount);
+
+        // For sparse gradients on the CPU only the rows of the embedding that received a gradient are
+        // touched, and the momentum decay of the other rows is applied lazily through timestamps.
+        int* timestamps = nullptr;
+        const LazyDecayHistory* decayHistory = nullptr;
+        if (momentum != 0 && UseLazyUpdate(gradientValue))
+            timestamps = LazyUpdateTimestamps(parameter, gradientValue, { (double)momentum }, decayHistory);
+
         parameterMatrix->MomentumSGDUpdate(*gradientMatrix, *smoothedGradientMatrix,
-                                           learningRate, momentum, unitGainFactor);
+                                           learningRate, momentum, unitGainFactor, timestamps, decayHistory);
     }
 
     void LearnerMomentumSGD::UpdateHalf(const Parameter& parameter, const NDArrayViewPtr& gradientValue,
@@ -763,12 +861,7 @@ namespace CNTK
     }
 
     // When the gradients are sparse, we update the corresponding internal buffers of adadelta in a sparse way
-    // and we maintain some additional timestamps. We periodically perform some dense work to prevent 
-    // a) the timestamps overflowing and b) big differences between this implementation and an equivalent dense
-    // implementation due to numerical issues with floating point numbers.
-    // TODO: consider exposing this somehow so that it is easy to test by setting it to small value.
-    /* static */ const int LearnerAdaDelta::s_SyncInterval = 1 << 20;
-
+    // and we maintain some additional timestamps, see LearnerBase::LazyUpdateTimestamps().
     template <typename GradType, typename AccumType>
     void LearnerAdaDelta::Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue,
         const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount)
@@ -786,89 +879,33 @@ namespace CNTK
         int currentTimestamp = 0;
         if (gradientValue->IsSparse())
         {
-            // When the gradient is sparse (block sparse column) we maintain a timestamp for every column
-            // The timestamp is allocated here and initialized to 0, meaning that at time 0 everything was
-            // up to date. We also maintain a currentTime variable that is incremented with each update.
-            // When we perform the update, for every non-zero column we first use the timestamp and the 
-            // current time to apply all updates that a dense implementation would have applied to that column
-            // and then update the timestamp for that column with the current time. 
-            const auto numCols = gradientMatrix->GetNumCols();
-            const auto search = m_lastUpdateTime.find(parameter);
-            if (search == m_lastUpdateTime.end())
-            {
-                // create timestamps and current time
-                // NDArrayView only supports Float and Double and the following assert prevents surprises in non-standard platforms
-                static_assert(sizeof(int) <= sizeof(float), "Buffer for timestamps is not big enough on this platform");
-                const auto view = MakeSharedObject<NDArrayView>(float(0.0), NDShape({ numCols }), gradientValue->Device());
-                const auto itBoolPair = m_lastUpdateTime.emplace(make_pair(parameter, view));
-                assert(itBoolPair.second); // insertion took place
-                timestamps = reinterpret_cast<int*>(const_cast<float*>(itBoolPair.first->second->DataBuffer<float>()));
-                m_currentTime[parameter] = 0;
-            }
-            else
-            {
-                // retrieve timestamps and current time
-                timestamps = reinterpret_cast<int*>(const_cast<float*>(search->second->DataBuffer<float>()));
-                currentTimestamp = m_currentTime[parameter];
-            }
-            if (currentTimestamp >= LearnerAdaDelta::s_SyncInterval)
-            {
-                // Once in a while sync the state and reset the timestamps and current time to 0
-                smoothedGradientMatrix->AdaDeltaFlushState(numCols, (AccumType)m_rho, timestamps, currentTimestamp);
-                m_currentTime[parameter] = currentTimestamp = 0;
-            }
-            currentTimestamp += 1;
-            m_currentTime[parameter] = currentTimestamp;
+            const LazyDecayHistory* decayHistory;
+            timestamps = LazyUpdateTimestamps(parameter, gradientValue, { m_rho, m_rho }, decayHistory);
+            currentTimestamp = decayHistory->NumUpdates();
         }
 
         smoothedGradientMatrix->template AdaDeltaUpdate<GradType>(*gradientMatrix, parameterMatrix, (AccumType)learningRate, (AccumType)m_rho, (AccumType)m_epsilon, timestamps, currentTimestamp);
     }
 
-    /*virtual*/ Dictionary LearnerAdaDelta::CreateCheckpoint() /*override*/
+    /*virtual*/ void LearnerAdaDelta::FlushLazyUpdateState(const Parameter& parameter, const LazyDecayHistory& decayHistory, int* timestamps) const /*override*/
     {
-        // Before checkpointing we need to sync the state so that our lazy implementation 
-        // for sparse gradients with timestamps is transparent to the user
-        for (const auto& parameter : Parameters())
+        // Unlike LearnerBase, use the AdaDelta specific flush, which is also implemented on the GPU.
+        // The decay rate m_rho is constant, so only the current time is needed.
+        const int currentTimestamp = decayHistory.NumUpdates();
+        const auto numCols = GetMatrixShape(parameter)[1];
+        const auto& smoothedGradientValue = m_smoothedGradientValues.at(parameter);
+        if (parameter.GetDataType() == DataType::Double)
         {
-            const auto search = m_lastUpdateTime.find(parameter);
-            if (search == m_lastUpdateTime.end())
-                continue;
-            int* timestamps = reinterpret_cast<int*>(const_cast<float*>(search->second->DataBuffer<float>()));
-            int currentTimestamp = m_currentTime[parameter];
-            const auto& smoothedGradientValue = m_smoothedGradientValues.at(parameter);
-            if (parameter.GetDataType() == CNTK::DataType::Float)
-            {
-                const auto numCols = GetMatrix<float>(parameter.Value())->GetNumCols();
-                const auto& smoothedGradientMatrix = GetWritableMatrix<float>(smoothedGradientValue);
-                smoothedGradientMatrix->AdaDeltaFlushState(numCols, (float)m_rho, timestamps, currentTimestamp);
-            }
-            else if (parameter.GetDataType() == CNTK::DataType::Double)
-            {
-                const auto numCols = GetMatrix<double>(parameter.Value())->GetNumCols();
-                const auto& smoothedGradientMatrix = GetWritableMatrix<double>(smoothedGradientValue);
-                smoothedGradientMatrix->AdaDeltaFlushState(numCols, (double)m_rho, timestamps, currentTimestamp);
-            }
-            else
-                LogicError("Unexpected parameter data type");
-
-            m_currentTime[parameter] = 0;
+            const auto& smoothedGradientMatrix = GetWritableMatrix<double>(smoothedGradientValue);
+            smoothedGradientMatrix->AdaDeltaFlushState(numCols, (double)m_rho, timestamps, currentTimestamp);
         }
-        return LearnerBase::CreateCheckpoint();
-    }
-
-    /*virtual*/ void LearnerAdaDelta::RestoreFromCheckpoint(const Dictionary& checkpoint) /*override*/
-    {
-        LearnerBase::RestoreFromCheckpoint(checkpoint);
-        // After restoring from a checkpoint we need to reset all timestamps and the current time for
-        // parameters that have sparse gradients.
-        for (const auto& parameter : Parameters())
+        else if (parameter.GetDataType() == DataType::Float || parameter.GetDataType() == DataType::Float16)
         {
-            const auto search = m_lastUpdateTime.find(parameter);
-            if (search == m_lastUpdateTime.end())
-                continue;
-            m_currentTime[parameter] = 0;
-            search->second->SetValue(0.0f);
+            const auto& smoothedGradientMatrix = GetWritableMatrix<float>(smoothedGradientValue);
+            smoothedGradientMatrix->AdaDeltaFlushState(numCols, (float)m_rho, timestamps, currentTimestamp);
         }
+        else
+            LogicError("Unexpected parameter data type");
     }
 
     /*static*/ const double LearnerFSAdaGrad::s_targetAdagradAvDenom = 1.0;
@@ -936,8 +973,13 @@ namespace CNTK
         const auto varMomentum = VarianceMomentumValueForMB(trainingSampleCount);
         const auto unitGainFactor = UnitGainFactor<ElementType>(trainingSampleCount);
 
+        int* timestamps = nullptr;
+        const LazyDecayHistory* decayHistory = nullptr;
+        if (UseLazyUpdate(gradientValue))
+            timestamps = LazyUpdateTimestamps(parameter, gradientValue, { varMomentum, momentum }, decayHistory);
+
         smoothedGradientMatrix->FSAdagradUpdate(*gradientMatrix, *parameterMatrix, m_targetAdagradAvDenom_x_sqrtAdagradSqrFrames, learningRate,
-                                                momentum, varMomentum, unitGainFactor);
+                                                momentum, varMomentum, unitGainFactor, timestamps, decayHistory);
     }
 
     LearnerAdam::LearnerAdam(const vector<Parameter>& parameters,
@@ -1006,8 +1048,13 @@ namespace CNTK
 
         const auto varMomentum = VarianceMomentumValueForMB(trainingSampleCount);
 
+        int* timestamps = nullptr;
+        const LazyDecayHistory* decayHistory = nullptr;
+        if (UseLazyUpdate(gradientValue))
+            timestamps = LazyUpdateTimestamps(parameter, gradientValue, { varMomentum, momentum }, decayHistory);
+
         smoothedGradientMatrix->AdamUpdate(*gradientMatrix, *parameterMatrix, m_smoothedCount, learningRate,
-                                           momentum, varMomentum, (ElementType)m_epsilon, unitGainFactor, m_adamax);
+                                           momentum, varMomentum, (ElementType)m_epsilon, unitGainFactor, m_adamax, timestamps, decayHistory);
     }
 
     LearnerRMSProp::LearnerRMSProp(const vector<Parameter>& parameters,
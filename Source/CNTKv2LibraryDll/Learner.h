@@ -7,6 +7,7 @@
 
 #include "stdafx.h"
 #include "CNTKLibrary.h"
+#include "CommonMatrix.h"
 #include <numeric>
 #include <functional>
 
@@ -119,6 +120,46 @@ namespace CNTK
         // Retrieves the shape of the matrix corresponding to the parameter value.
         static NDShape GetMatrixShape(const Parameter& parameter);
 
+        // If a gradient is sparse, learners may skip updating the smoothed state of columns with zero gradients.
+        // To that end we maintain a timestamp per column with the last time that column was updated, and
+        // a history of the decay rates of all updates of the parameter. When a column is updated, the kernel
+        // applies the decay of the updates since its timestamp, which may differ from update to update, e.g.
+        // when the momentum depends on the minibatch size. Once every s_lazyUpdateSyncInterval updates (or
+        // s_lazyUpdateMaxDecaySegments changes of the rates, and whenever a checkpoint is taken) all columns
+        // are brought up to date through FlushLazyUpdateState().
+        static const int s_lazyUpdateSyncInterval;
+        static const size_t s_lazyUpdateMaxDecaySegments;
+
+        // Returns true if the smoothed state of the parameter can be updated lazily: the gradient must be
+        // block sparse and live on the CPU (the GPU learner kernels for these formats are dense-equivalent).
+        static bool UseLazyUpdate(const NDArrayViewPtr& gradientValue)
+        {
+            return gradientValue->GetStorageFormat() == StorageFormat::SparseBlockCol &&
+                   gradientValue->Device().Type() == DeviceKind::CPU &&
+                   gradientValue->GetDataType() != DataType::Float16;
+        }
+
+        // Records the decay rates of the current update of the parameter and returns the column timestamps and the
+        // decay history to pass to the update kernels; the state must hold decayRates.size() logical buffers
+        // decaying with the given rates. The current time is decayHistory->NumUpdates().
+        int* LazyUpdateTimestamps(const Parameter& parameter, const NDArrayViewPtr& gradientValue,
+                                  const std::vector<double>& decayRates, const Microsoft::MSR::CNTK::LazyDecayHistory*& decayHistory) const;
+
+        // Applies all delayed decay steps to the smoothed state of the parameter. Derived classes whose
+        // state cannot be flushed by LazyDecayFlushState() (e.g. on the GPU) override this.
+        virtual void FlushLazyUpdateState(const Parameter& parameter, const Microsoft::MSR::CNTK::LazyDecayHistory& decayHistory, int* timestamps) const;
+
+        void FlushAllLazyUpdateState() const;
+        void ResetLazyUpdateState();
+
+        struct LazyUpdateState
+        {
+            NDArrayViewPtr m_lastUpdateTime;
+            Microsoft::MSR::CNTK::LazyDecayHistory m_decayHistory;
+        };
+
+        mutable std::unordered_map<Parameter, LazyUpdateState> m_lazyUpdateState;
+
     private:
         // Templatized update function, it invokes preprocess and postprocess using the provided
         // template parameter and also invokes virtual Update method implemented in one of the subclasses.
@@ -262,26 +303,15 @@ namespace CNTK
             AdditionalLearningOptions additionalOptions);
 
     protected:
-        // If a gradient is sparse, we skip updating columns with zero gradients. This means some 
-        // columns will receive their updates when their gradient is non-zero. The only exception
-        // is that once every s_SyncInterval updates we will make sure all columns are up to date. 
-        static const int s_SyncInterval;
-
         double m_rho;
         double m_epsilon;
-        // If a gradient is sparse, we will maintain a timestamp per column with the last time that column was updated
-        std::unordered_map<Parameter, NDArrayViewPtr> m_lastUpdateTime;
-        // If a gradient is sparse we will use the current time and the timestamp to determine how to apply a bunch of delayed updates for this column.
-        // This allows us to skip updating many columns when the gradients are sparse.
-        std::unordered_map<Parameter, int> m_currentTime;
 
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) override;
 
         template <typename GradType, typename AccumType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount);
 
-        virtual Dictionary CreateCheckpoint() override;
-        virtual void RestoreFromCheckpoint(const Dictionary& checkpoint) override;
+        virtual void FlushLazyUpdateState(const Parameter& parameter, const Microsoft::MSR::CNTK::LazyDecayHistory& decayHistory, int* timestamps) const override;
     };
 
     class LearnerFSAdaGrad : public LearnerMomentumSGD
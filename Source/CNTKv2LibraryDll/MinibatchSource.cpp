@@ -15,6 +15,7 @@
 #include "Value.h"
 #include "MPIWrapper.h"
 #include "PerformanceProfiler.h"
+#include <chrono>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -333,6 +334,110 @@ namespace CNTK
         m_prevMinibatchSize = 0;
     }
 
+#ifndef CNTK_UWP
+    // stages of the pipeline reported by BenchmarkMinibatchSource(), with the profiler events that measure them
+    static const std::pair<ProfilerEvents, const wchar_t*> s_benchmarkStages[] =
+    {
+        { profilerEvtMainGetMinibatch,  L"getMinibatch" },
+        { profilerEvtPrefetchWait,      L"prefetchWait" },
+        { profilerEvtPrefetchMinibatch, L"prefetch" },
+        { profilerEvtReadSequences,     L"readSequences" },
+        { profilerEvtPackMinibatch,     L"pack" },
+        { profilerEvtCopyMinibatch,     L"copy" },
+    };
+#endif
+
+    std::vector<MinibatchSourceBenchmarkResult> BenchmarkMinibatchSource(const MinibatchSourceConfig& configuration,
+        size_t minibatchSizeInSamples,
+        size_t numMinibatches,
+        const std::vector<size_t>& numCPUThreads,
+        size_t numWarmupMinibatches,
+        const DeviceDescriptor& device)
+    {
+#ifdef CNTK_UWP
+        UNUSED(configuration); UNUSED(minibatchSizeInSamples); UNUSED(numMinibatches); UNUSED(numCPUThreads); UNUSED(numWarmupMinibatches); UNUSED(device);
+        RuntimeError("BenchmarkMinibatchSource: the performance profiler is not supported on UWP.");
+#else
+        auto getStatistics = [](std::vector<ProfilerEventStatistics>& stages, ProfilerEventStatistics& copyThroughput)
+        {
+            stages.resize(sizeof(s_benchmarkStages) / sizeof(s_benchmarkStages[0]));
+            for (size_t i = 0; i < stages.size(); i++)
+                ProfilerGetEventStatistics(s_benchmarkStages[i].first, stages[i]);
+            ProfilerGetEventStatistics(profilerEvtCopyThroughput, copyThroughput);
+        };
+
+        ProfilerEventStatistics probe;
+        bool ownProfiler = !ProfilerGetEventStatistics(profilerEvtMainGetMinibatch, probe);
+        size_t previousNumCPUThreads = GetMaxNumCPUThreads();
+
+        // a profiler that we do not own is left in the state we found it in
+        bool wasProfilerEnabled = ProfilerIsEnabled();
+        auto restoreProfiler = MakeScopeExit([ownProfiler, wasProfilerEnabled]() { if (!ownProfiler) ProfilerEnable(wasProfilerEnabled); });
+
+        std::vector<MinibatchSourceBenchmarkResult> results;
+        for (auto threads : numCPUThreads)
+        {
+            if (threads != 0)
+                SetMaxNumCPUThreads(threads);
+
+            if (ownProfiler)
+                ProfilerInit(L"", 0, L"", /*syncGpu=*/false);
+            ProfilerEnable(true);
+
+            MinibatchSourceBenchmarkResult result = {};
+            result.numCPUThreads = GetMaxNumCPUThreads();
+
+            // a new source for each run, so that runs do not benefit from data cached by earlier ones
+            auto source = CreateCompositeMinibatchSource(configuration);
+            for (size_t i = 0; i < numWarmupMinibatches; i++)
+                source->GetNextMinibatch(minibatchSizeInSamples, device);
+
+            std::vector<ProfilerEventStatistics> stagesBefore, stages;
+            ProfilerEventStatistics copyThroughputBefore, copyThroughput;
+            getStatistics(stagesBefore, copyThroughputBefore);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (; result.numMinibatches < numMinibatches; result.numMinibatches++)
+            {
+                const auto& minibatch = source->GetNextMinibatch(minibatchSizeInSamples, device);
+                if (minibatch.empty())
+                    break;
+
+                size_t numSamples = 0;
+                for (const auto& stream : minibatch)
+                    numSamples = std::max(numSamples, stream.second.numberOfSamples);
+                result.numSamples += numSamples;
+            }
+            result.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+            source.reset(); // stops the prefetch
+
+            getStatistics(stages, copyThroughput);
+            copyThroughput.Subtract(copyThroughputBefore);
+            result.numBytes = (size_t)copyThroughput.totalBytes;
+            for (size_t i = 0; i < stages.size(); i++)
+            {
+                auto& stage = stages[i];
+                stage.Subtract(stagesBefore[i]);
+                if (s_benchmarkStages[i].first == profilerEvtPrefetchWait)
+                    result.prefetchStallSeconds = stage.totalSeconds;
+                result.stageLatencies[s_benchmarkStages[i].second] = MinibatchSourceStageLatency
+                {
+                    (size_t)stage.count,
+                    stage.count > 0 ? stage.totalSeconds / stage.count : 0.0,
+                    stage.Percentile(50), stage.Percentile(90), stage.Percentile(99)
+                };
+            }
+            results.push_back(result);
+
+            if (ownProfiler)
+                ProfilerClose();
+        }
+
+        SetMaxNumCPUThreads(previousNumCPUThreads);
+        return results;
+#endif
+    }
+
     /* static */ ImageTransform ReaderCrop(const wchar_t* cropType,
             std::pair<int, int> cropSize, std::pair<float, float> sideRatio, std::pair<float, float> areaRatio,
             std::pair<float, float> aspectRatio, const wchar_t* jitterType)
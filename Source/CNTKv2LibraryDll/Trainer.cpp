@@ -405,12 +405,65 @@ namespace CNTK
         return modelFilePath + checkpointExt;
     }
 
+    // Writes a model/trainer state snapshot next to the target files, flushes them to disk and then
+    // atomically replaces the previous checkpoint. Safe to run off the training thread.
+    static void WriteCheckpoint(const std::wstring& modelFilePath, const Dictionary& model, Dictionary& state)
+    {
+        std::wstring tempModelFile = modelFilePath + L".tmp";
+        {
+            auto stream = GetFstream(tempModelFile, false);
+            *stream << model;
+            stream->flush();
+        }
+
+        std::wstring trainerStateCheckpointFilePath = GetTrainerStateCheckpointFilePath(modelFilePath);
+        std::wstring tempCheckpointFile = trainerStateCheckpointFilePath + L".tmp";
+
+        state.Save(tempCheckpointFile);
+
+        fsyncOrDie(tempModelFile);
+        fsyncOrDie(tempCheckpointFile);
+
+        // The return value is ignored here.
+        _wunlink(modelFilePath.c_str());
+        _wunlink(trainerStateCheckpointFilePath.c_str());
+
+        renameOrDie(tempModelFile, modelFilePath);
+        renameOrDie(tempCheckpointFile, trainerStateCheckpointFilePath);
+    }
+
     void Trainer::SaveCheckpoint(const std::wstring& modelFilePath, Dictionary externalState)
     {
+        SaveCheckpoint(modelFilePath, externalState, /*async=*/false);
+    }
+
+    void Trainer::SaveCheckpointAsync(const std::wstring& modelFilePath, Dictionary externalState)
+    {
+        SaveCheckpoint(modelFilePath, externalState, /*async=*/true);
+    }
+
+    void Trainer::WaitForPendingCheckpoint()
+    {
+        // get() rethrows any error raised by the background write.
+        if (m_pendingCheckpoint.valid())
+            m_pendingCheckpoint.get();
+
+        // Only the main worker writes checkpoints, the others must not proceed
+        // to read them before it is done.
+        if (m_distributed)
+            MPICommunicator()->Barrier();
+    }
+
+    void Trainer::SaveCheckpoint(const std::wstring& modelFilePath, Dictionary externalState, bool async)
+    {
+        // A new snapshot is only taken after the previous one has been written.
+        if (m_pendingCheckpoint.valid())
+            m_pendingCheckpoint.get();
+
         auto learnersState = m_parameterLearners->CreateCheckpoint();
 
         if (!m_distributed)
-            return Save(modelFilePath, learnersState, externalState);
+            return Save(modelFilePath, learnersState, externalState, Dictionary(), async);
 
         auto compositeFunction = dynamic_cast<CompositeFunction*>(m_combinedTrainingFunction.get());
 
@@ -432,38 +485,41 @@ namespace CNTK
         }
 
         if (communicator->CurrentWorker().IsMain())
-            Save(modelFilePath, learnersState, externalState, aggregatedState);
+            Save(modelFilePath, learnersState, externalState, aggregatedState, async);
 
         // all workers need to sync up after saving model to avoid read-after-write hazard
         // i.e. one worker is in the middle of write while another tries to read
-        communicator->Barrier();
+        // In async mode this is deferred to WaitForPendingCheckpoint, which RestoreFromCheckpoint calls.
+        if (!async)
+            communicator->Barrier();
     }
 
-    void Trainer::Save(const std::wstring& modelFilePath, const std::vector<DictionaryValue>& learnerState, const Dictionary& externalState, const Dictionary& distributedState)
+    void Trainer::Save(const std::wstring& modelFilePath, const std::vector<DictionaryValue>& learnerState, const Dictionary& externalState, const Dictionary& distributedState, bool async)
     {
-        std::wstring tempModelFile = modelFilePath + L".tmp";
         Dictionary state;
         state[versionPropertyName] = trainerCheckpointVersion;
         state[learnersPropertyName] = learnerState;
         state[externalStatePropertyName] = externalState;
         state[distributedStatePropertyName] = distributedState;
 
-        m_combinedTrainingFunction->Save(tempModelFile);
-        std::wstring trainerStateCheckpointFilePath = GetTrainerStateCheckpointFilePath(modelFilePath);
-        std::wstring tempCheckpointFile = trainerStateCheckpointFilePath + L".tmp";
+        // Serializing copies all parameter values into CPU memory, so after this point
+        // the snapshot is independent of further training updates.
+        Dictionary model = m_combinedTrainingFunction->Serialize();
 
-        state.Save(tempCheckpointFile);
+        if (!async)
+            return WriteCheckpoint(modelFilePath, model, state);
 
-        // The return value is ignored here.
-        _wunlink(modelFilePath.c_str());
-        _wunlink(trainerStateCheckpointFilePath.c_str());
-
-        renameOrDie(tempModelFile, modelFilePath);
-        renameOrDie(tempCheckpointFile, trainerStateCheckpointFilePath);
+        m_pendingCheckpoint = std::async(std::launch::async, [modelFilePath, model = std::move(model), state = std::move(state)]() mutable
+        {
+            WriteCheckpoint(modelFilePath, model, state);
+        });
     }
 
     Dictionary Trainer::RestoreFromCheckpoint(const std::wstring& modelFilePath)
     {
+        // The checkpoint may still be being written in the background.
+        WaitForPendingCheckpoint();
+
         // Restore the model's parameters
         m_combinedTrainingFunction->Restore(modelFilePath);
 
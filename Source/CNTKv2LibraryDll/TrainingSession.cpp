@@ -5,6 +5,7 @@
 
 #include "stdafx.h"
 #include <boost/algorithm/string/predicate.hpp>
+#include <chrono>
 
 #include "CNTKLibrary.h"
 #include "Utils.h"
@@ -35,8 +36,10 @@ namespace CNTK
         size_t checkpointFrequency,
         DataUnit checkpointFrequencyUnit,
         bool restoreFromCheckpointIfExists,
-        bool preserveAllCheckpoints) :
+        bool preserveAllCheckpoints,
+        bool asyncCheckpointing) :
         m_preserveAll(preserveAllCheckpoints),
+        m_async(asyncCheckpointing),
         m_restore(restoreFromCheckpointIfExists),
         m_fileName(checkPointFileName),
         m_frequency(checkpointFrequency),
@@ -126,7 +129,8 @@ namespace CNTK
         m_workerRank(0),
         m_numberOfWorkers(1),
         m_test(test),
-        m_mbSizeScaleFactor(1)
+        m_mbSizeScaleFactor(1),
+        m_checkpointBlockedMilliseconds(0)
     {
         if (!m_trainer)
             InvalidArgument("Trainer must not be null.");
@@ -252,6 +256,9 @@ namespace CNTK
             }
         }
 
+        // Make sure the last asynchronous checkpoint is on disk before looking for it.
+        Trainer()->WaitForPendingCheckpoint();
+
         // In case of incremental - save final checkpoint.
         // This is required only when we keep all existing checkpoints, otherwise 
         // The checkpoint was already saved with the proper name.
@@ -415,7 +422,20 @@ namespace CNTK
         wstring checkpointFile = m_checkpoint.m_fileName;
         if (m_checkpoint.m_preserveAll)
             checkpointFile += std::to_wstring(currentIndex);
-        Trainer()->SaveCheckpoint(checkpointFile, externalState);
+
+        // In async mode the files may still be being written when OnCheckpointEnd is called,
+        // only the time spent snapshotting (and waiting for the previous checkpoint) blocks training.
+        auto start = std::chrono::steady_clock::now();
+        if (m_checkpoint.m_async)
+            Trainer()->SaveCheckpointAsync(checkpointFile, externalState);
+        else
+            Trainer()->SaveCheckpoint(checkpointFile, externalState);
+        size_t blockedMilliseconds = (size_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        m_checkpointBlockedMilliseconds += blockedMilliseconds;
+
+        for (auto& writer : Trainer()->ProgressWriters())
+            writer->OnWriteCheckpointUpdate(currentIndex, blockedMilliseconds, m_checkpointBlockedMilliseconds);
+
         OnCheckpointEnd(currentIndex);
     }
 
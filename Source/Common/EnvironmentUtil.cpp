@@ -43,6 +43,19 @@ int EnvironmentUtil::GetLocalMPINodeRank()
 
     return (!p) ? 0 : stoi(string(p));
 }
+
+int EnvironmentUtil::GetLocalMPINodeRankOnMachine()
+{
+#if !HAS_MPI
+    const char* p = nullptr;
+#elif WIN32
+    const char* p = getenv("MPI_LOCALRANKID");
+#else
+    const char* p = getenv("OMPI_COMM_WORLD_LOCAL_RANK");
+#endif
+
+    return (!p) ? 0 : stoi(string(p));
+}
 #pragma warning(pop)
 
 }}}
@@ -19,4 +19,5 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     std::atomic<bool> Globals::m_enableNodeTiming(false);
     std::atomic<bool> Globals::m_useV2Aggregator(false);
     std::atomic<std::size_t> Globals::m_mpiPackThresholdInBytes(DEFAULT_PACK_THRESHOLD_SIZE_IN_BYTES);
+    std::atomic<std::size_t> Globals::m_numConcurrentTraversalThreads(0);
 }}}
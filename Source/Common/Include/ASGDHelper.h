@@ -62,6 +62,9 @@ ASGDHelper<ElemType>* NewASGDHelper(
     double adjustCoef = 0.2,                                                 // see in DecayCoefficient()
     size_t adjustPerMinibatches = 600,                                       //
     int traceLevel = 0,                                                      // log level
-    int syncPerfStats = 0);                                                  // shown perf data every syncPerfStats
+    int syncPerfStats = 0,                                                   // shown perf data every syncPerfStats
+    size_t numShards = 16,                                                   // shared-memory server only: number of separately locked parts of the model
+    size_t pushesPerPull = 1,                                                // shared-memory server only: get the global model back every N pushes
+    double delayCompensation = 0);                                           // shared-memory server only: coefficient of the correction of stale deltas, 0 = off; requires pushesPerPull = 1
 
 }}}
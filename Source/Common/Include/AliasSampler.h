@@ -0,0 +1,117 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// AliasSampler.h -- O(1) sampling from a fixed discrete distribution (Walker's alias method)
+//
+
+#pragma once
+
+#include "Basics.h"
+#include <vector>
+#include <algorithm>
+#include <boost/random/uniform_real_distribution.hpp>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// ---------------------------------------------------------------------------
+// AliasSampler -- draws class indices with probability proportional to a vector of
+// non-negative weights. Building the table is O(n), every draw is O(1) and consumes a single
+// uniform random number, independent of the number of classes. This is what makes sampled
+// losses over large vocabularies (RandomSampleNode, NCE noise samples) scale with the number
+// of samples instead of the vocabulary size.
+// ---------------------------------------------------------------------------
+
+class AliasSampler
+{
+public:
+    AliasSampler()
+        : m_totalWeight(0)
+    {
+    }
+
+    explicit AliasSampler(const std::vector<double>& weights)
+    {
+        Build(weights);
+    }
+
+    // (Re-)builds the alias table using Vose's algorithm.
+    void Build(const std::vector<double>& weights)
+    {
+        const size_t n = weights.size();
+        if (n == 0)
+            InvalidArgument("AliasSampler: the weight vector is empty.");
+
+        m_totalWeight = 0;
+        for (auto w : weights)
+        {
+            if (w < 0)
+                InvalidArgument("Sampling weights contain negative number %f.", w);
+            m_totalWeight += w;
+        }
+        if (m_totalWeight <= 0)
+            InvalidArgument("AliasSampler: the sum of the sampling weights must be positive.");
+
+        m_probability.resize(n);
+        m_alias.resize(n);
+
+        // scale the weights so that the average bucket holds 1
+        std::vector<double> scaled(n);
+        std::vector<size_t> small, large;
+        small.reserve(n);
+        large.reserve(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            scaled[i] = weights[i] * n / m_totalWeight;
+            (scaled[i] < 1 ? small : large).push_back(i);
+        }
+
+        // pair every underfull bucket with an overfull one that donates the remainder
+        while (!small.empty() && !large.empty())
+        {
+            size_t s = small.back(); small.pop_back();
+            size_t l = large.back();
+            m_probability[s] = scaled[s];
+            m_alias[s] = l;
+            scaled[l] -= 1 - scaled[s];
+            if (scaled[l] < 1)
+            {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+
+        // whatever is left is full up to rounding errors
+        for (auto i : large)
+        {
+            m_probability[i] = 1;
+            m_alias[i] = i;
+        }
+        for (auto i : small)
+        {
+            m_probability[i] = 1;
+            m_alias[i] = i;
+        }
+    }
+
+    template <typename Engine>
+    size_t Sample(Engine& engine) const
+    {
+        // One uniform number in [0, n) selects the bucket (integer part) and the side of it (fraction).
+        boost::random::uniform_real_distribution<double> r(0, (double)m_probability.size());
+        double x = r(engine);
+        size_t bucket = std::min((size_t)x, m_probability.size() - 1);
+        return (x - bucket) < m_probability[bucket] ? bucket : m_alias[bucket];
+    }
+
+    size_t Size() const { return m_probability.size(); }
+    double TotalWeight() const { return m_totalWeight; }
+    bool IsEmpty() const { return m_probability.empty(); }
+
+private:
+    std::vector<double> m_probability; // probability of keeping the bucket's own index
+    std::vector<size_t> m_alias;       // index returned otherwise
+    double m_totalWeight;
+};
+
+}}}
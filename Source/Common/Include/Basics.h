@@ -490,6 +490,18 @@ struct nocase_compare
     }
 };
 
+// 64-bit FNV-1a of a string, e.g. to name cache files. Unlike std::hash, it is the same across platforms and builds.
+static inline uint64_t HashOfKey(const std::wstring& key)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (auto c : key)
+    {
+        hash ^= (uint64_t)c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
 // ----------------------------------------------------------------------------
 // random collection of stuff we needed at some place
 // ----------------------------------------------------------------------------
@@ -19,6 +19,11 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         // corresponging to the rank of the local MPI node.
         // This function returns 0 if the variable is not present.
         static int GetLocalMPINodeRank();
+
+        // Reads and returns an integer value of an environment variable
+        // corresponding to the rank of the local MPI node among the nodes on the same machine.
+        // This function returns 0 if the variable is not present.
+        static int GetLocalMPINodeRankOnMachine();
     };
     
 }}}
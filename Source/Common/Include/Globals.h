@@ -33,6 +33,10 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         static void SetMPIPackThreshold(std::size_t packThreholdInBytes) { m_mpiPackThresholdInBytes = packThreholdInBytes; }
         static std::size_t GetMPIPackThreshold() { return m_mpiPackThresholdInBytes; }
+
+        // number of threads that execute independent nodes of a CPU network concurrently; 0 or 1 means sequential traversal
+        static void SetConcurrentTraversalThreads(std::size_t numThreads) { m_numConcurrentTraversalThreads = numThreads; }
+        static std::size_t GetConcurrentTraversalThreads() { return m_numConcurrentTraversalThreads; }
     private:
         static std::atomic<bool> m_forceDeterministicAlgorithms;
         // The global flag to enable matrices values in forward and backward prop
@@ -42,5 +46,6 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         static std::atomic<bool> m_enableNodeTiming;
         static std::atomic<bool> m_useV2Aggregator;
         static std::atomic<std::size_t> m_mpiPackThresholdInBytes;
+        static std::atomic<std::size_t> m_numConcurrentTraversalThreads;
     };
 }}}
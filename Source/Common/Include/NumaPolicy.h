@@ -0,0 +1,67 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// NumaPolicy.h -- placement of threads and memory on the NUMA nodes of a machine
+//
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+enum class NumaPolicyMode
+{
+    none,    // leave placement to the OS (default)
+    spread,  // one process per machine: OpenMP threads other than the main thread are pinned in equal teams to the NUMA nodes
+    perRank, // several processes per machine: each process is bound to one node, chosen by its local MPI rank
+};
+
+// -----------------------------------------------------------------------
+// NumaPolicy -- binds threads to NUMA nodes and allocates memory on them.
+// The mode is set once at startup through the 'numaPolicy' config parameter.
+// While it is 'none', all functions but the topology queries fall back to default OS behavior,
+// so that callers do not need to check IsEnabled() themselves.
+// On Linux, this uses the sysfs topology and the raw mbind()/set_mempolicy() system calls, so no libnuma is needed.
+// -----------------------------------------------------------------------
+
+class NumaPolicy
+{
+public:
+    static NumaPolicyMode ParseMode(const std::wstring& s);
+
+    // Bind the process and its OpenMP threads according to 'mode'. Call this from the main thread,
+    // after the number of OpenMP threads has been set. 'localRank' is the rank of this process among those on the same machine.
+    static void Apply(NumaPolicyMode mode, size_t localRank = 0);
+    static NumaPolicyMode GetMode();
+    static bool IsEnabled() { return GetMode() != NumaPolicyMode::none; }
+
+    // topology; a machine without NUMA, or one that cannot be queried, has a single node with all CPUs
+    static size_t NumNodes();
+    static const std::vector<int>& CpusOfNode(size_t node);
+    static size_t CurrentNode(); // node of the CPU the calling thread runs on right now
+
+    // pin the calling thread to the CPUs of 'node'; returns false if that is not possible
+    static bool BindCurrentThreadToNode(size_t node);
+
+    // Helper threads (e.g. reader prefetching) should run on the node of the thread that consumes their
+    // results, so that the memory they first touch is local to it. Call NodeForHelperThread() on the consuming
+    // thread and pass the result to BindHelperThread() on the helper. No-ops while the policy is off.
+    static int NodeForHelperThread();
+    static void BindHelperThread(int node);
+
+    // Memory on a given node, or on the node of the calling thread. Without policy this is plain heap memory.
+    // The result is aligned to 64 bytes. Must be released with Free().
+    static void* Alloc(size_t bytes, size_t node);
+    static void* AllocLocal(size_t bytes);
+    static void Free(void* p);
+
+    // Scratch buffer of at least 'bytes' that belongs to the calling thread and is allocated on its node.
+    // It stays valid until the next call on the same thread.
+    static void* ThreadScratch(size_t bytes);
+};
+
+}}}
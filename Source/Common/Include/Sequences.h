@@ -652,6 +652,9 @@ private:
     static std::mutex s_nameIndiciesMutex;
     static std::map<std::wstring, size_t> s_nameIndices;
 
+    // The mutex to serialize the lazy creation of m_columnsValidityMask in GetColumnsValidityMask().
+    static std::mutex s_columnsValidityMaskMutex;
+
 public:
 
     // special accessor for sequence training  --TODO: must be replaced by a different mechanism
@@ -949,6 +952,8 @@ inline const Matrix<char>& MBLayout::GetColumnsValidityMask(DEVICEID_TYPE device
 {
     CheckIsValid();
     // lazily compute the validity mask
+    // Nodes that share this layout may ask for it concurrently (see Globals::GetConcurrentTraversalThreads()).
+    std::lock_guard<std::mutex> lock(s_columnsValidityMaskMutex);
     if (m_columnsValidityMask.IsEmpty())
     {
         assert(HasGaps() || m_rightSplice != 0); // must only be called if there are gaps
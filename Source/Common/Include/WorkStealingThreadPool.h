@@ -0,0 +1,180 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// WorkStealingThreadPool -- fixed set of worker threads that execute a batch of indexed tasks.
+// ParallelFor() hands each worker a contiguous block of task indices. A worker that runs out of
+// work steals from the back of another worker's block, so uneven task costs are balanced out.
+// The calling thread only waits; all tasks of one batch are run by the workers.
+// Kept in a separate header because it pulls in the threading headers.
+// -----------------------------------------------------------------------
+
+class WorkStealingThreadPool
+{
+public:
+    // 'onThreadStart' is called once on each worker thread before it runs any task, e.g. to set thread-local library state
+    WorkStealingThreadPool(size_t numThreads, const std::function<void()>& onThreadStart = nullptr)
+        : m_queues(numThreads == 0 ? 1 : numThreads), m_task(nullptr), m_numPending(0), m_generation(0), m_stop(false)
+    {
+        for (size_t i = 0; i < m_queues.size(); i++)
+            m_queues[i].reset(new TaskQueue());
+        for (size_t i = 0; i < m_queues.size(); i++)
+            m_threads.emplace_back([this, i, onThreadStart]()
+            {
+                if (onThreadStart)
+                    onThreadStart();
+                WorkerLoop(i);
+            });
+    }
+
+    ~WorkStealingThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_workAvailable.notify_all();
+        for (auto& thread : m_threads)
+            thread.join();
+    }
+
+    size_t NumThreads() const { return m_threads.size(); }
+
+    // run task(i) for all i in [0, numTasks) and wait for all of them to complete
+    // If tasks throw, the exception of the task with the lowest index is rethrown, independent of timing.
+    // Not reentrant: a task must not call ParallelFor() on the same pool.
+    void ParallelFor(size_t numTasks, const std::function<void(size_t)>& task)
+    {
+        if (numTasks == 0)
+            return;
+
+        std::vector<std::exception_ptr> exceptions(numTasks);
+        std::function<void(size_t)> guardedTask = [&](size_t i)
+        {
+            try
+            {
+                task(i);
+            }
+            catch (...)
+            {
+                exceptions[i] = std::current_exception();
+            }
+        };
+        m_task = &guardedTask;
+        m_numPending = numTasks;
+
+        // distribute contiguous blocks, so that neighbouring tasks tend to run on the same thread
+        size_t numQueues = m_queues.size();
+        for (size_t q = 0; q < numQueues; q++)
+        {
+            std::lock_guard<std::mutex> lock(m_queues[q]->mutex);
+            for (size_t i = q * numTasks / numQueues; i < (q + 1) * numTasks / numQueues; i++)
+                m_queues[q]->tasks.push_back(i);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_generation++;
+        }
+        m_workAvailable.notify_all();
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_workDone.wait(lock, [this]() { return m_numPending == 0; });
+        }
+        m_task = nullptr;
+
+        for (const auto& exception : exceptions)
+            if (exception)
+                std::rethrow_exception(exception);
+    }
+
+private:
+    struct TaskQueue
+    {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    // own tasks are taken from the front, stolen ones from the back
+    bool TryGetTask(size_t self, size_t& taskIndex)
+    {
+        for (size_t k = 0; k < m_queues.size(); k++)
+        {
+            auto& queue = *m_queues[(self + k) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty())
+                continue;
+            if (k == 0)
+            {
+                taskIndex = queue.tasks.front();
+                queue.tasks.pop_front();
+            }
+            else
+            {
+                taskIndex = queue.tasks.back();
+                queue.tasks.pop_back();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void WorkerLoop(size_t self)
+    {
+        size_t seenGeneration = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_workAvailable.wait(lock, [&]() { return m_stop || m_generation != seenGeneration; });
+                if (m_stop)
+                    return;
+                seenGeneration = m_generation;
+            }
+
+            size_t taskIndex;
+            while (TryGetTask(self, taskIndex))
+            {
+                (*m_task)(taskIndex);
+                if (--m_numPending == 0)
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_workDone.notify_all();
+                }
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<TaskQueue>> m_queues; // [thread index]
+    std::vector<std::thread> m_threads;
+    const std::function<void(size_t)>* m_task;        // task of the current batch
+    std::atomic<size_t> m_numPending;                 // tasks of the current batch that have not completed yet
+
+    std::mutex m_mutex;                               // guards m_generation and m_stop
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_workDone;
+    size_t m_generation;                              // incremented for each batch
+    bool m_stop;
+
+    WorkStealingThreadPool(const WorkStealingThreadPool&) = delete;
+    WorkStealingThreadPool& operator=(const WorkStealingThreadPool&) = delete;
+};
+
+}}}
@@ -137,6 +137,14 @@ void fprintfOrDie(FILE* f, const char* format, ...);
 
 void fflushOrDie(FILE* f);
 
+// ----------------------------------------------------------------------------
+// fsyncOrDie(): like fsync() but terminate with err msg in case of error
+// The pathname version flushes a file that has already been written and closed.
+// ----------------------------------------------------------------------------
+
+void fsyncOrDie(FILE* f);
+void fsyncOrDie(const std::wstring& pathname);
+
 // ----------------------------------------------------------------------------
 // filesize(): determine size of the file in bytes
 // ----------------------------------------------------------------------------
@@ -0,0 +1,373 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full licence information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
+
+#include "Include/Basics.h"
+#include "Include/NumaPolicy.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+static atomic<NumaPolicyMode> s_mode(NumaPolicyMode::none);
+
+// ---------------------------------------------------------------------------
+// topology
+// ---------------------------------------------------------------------------
+
+struct NumaTopology
+{
+    vector<vector<int>> cpusOfNode; // [node] -> CPU ids
+    vector<int> nodeOfCpu;          // [cpu] -> node
+
+    NumaTopology()
+    {
+#ifdef _WIN32
+        ULONG highestNode = 0;
+        if (GetNumaHighestNodeNumber(&highestNode))
+        {
+            for (ULONG node = 0; node <= highestNode; node++)
+            {
+                ULONGLONG mask = 0; // (only the first 64 processors)
+                vector<int> cpus;
+                if (GetNumaNodeProcessorMask((UCHAR) node, &mask))
+                    for (int cpu = 0; cpu < 64; cpu++)
+                        if (mask & (1ull << cpu))
+                            cpus.push_back(cpu);
+                cpusOfNode.push_back(cpus);
+            }
+        }
+#else
+        for (size_t node = 0;; node++)
+        {
+            FILE* f = fopen(msra::strfun::strprintf("/sys/devices/system/node/node%d/cpulist", (int) node).c_str(), "r");
+            if (!f)
+                break;
+            char buf[4096];
+            vector<int> cpus;
+            if (fgets(buf, sizeof(buf), f))
+                cpus = ParseCpuList(buf);
+            fclose(f);
+            cpusOfNode.push_back(cpus);
+        }
+#endif
+        if (cpusOfNode.empty()) // no NUMA, or we could not tell
+        {
+            cpusOfNode.resize(1);
+            for (int cpu = 0; cpu < (int) thread::hardware_concurrency(); cpu++)
+                cpusOfNode[0].push_back(cpu);
+        }
+        for (size_t node = 0; node < cpusOfNode.size(); node++)
+        {
+            for (int cpu : cpusOfNode[node])
+            {
+                if (cpu >= (int) nodeOfCpu.size())
+                    nodeOfCpu.resize(cpu + 1, 0);
+                nodeOfCpu[cpu] = (int) node;
+            }
+        }
+    }
+
+    // parse a Linux CPU list like "0-5,12-17"
+    static vector<int> ParseCpuList(const char* s)
+    {
+        vector<int> cpus;
+        while (*s)
+        {
+            char* end;
+            long first = strtol(s, &end, 10);
+            if (end == s)
+                break;
+            long last = first;
+            s = end;
+            if (*s == '-')
+            {
+                last = strtol(s + 1, &end, 10);
+                s = end;
+            }
+            for (long cpu = first; cpu <= last; cpu++)
+                cpus.push_back((int) cpu);
+            if (*s != ',')
+                break;
+            s++;
+        }
+        return cpus;
+    }
+};
+
+static const NumaTopology& Topology()
+{
+    static NumaTopology topology;
+    return topology;
+}
+
+size_t NumaPolicy::NumNodes()
+{
+    return Topology().cpusOfNode.size();
+}
+
+const vector<int>& NumaPolicy::CpusOfNode(size_t node)
+{
+    return Topology().cpusOfNode.at(node);
+}
+
+size_t NumaPolicy::CurrentNode()
+{
+    const auto& topology = Topology();
+    if (topology.cpusOfNode.size() == 1)
+        return 0;
+#ifdef _WIN32
+    UCHAR node;
+    if (!GetNumaProcessorNode((UCHAR) GetCurrentProcessorNumber(), &node) || node == 0xff)
+        return 0;
+    return node;
+#else
+    int cpu = sched_getcpu();
+    return (cpu >= 0 && cpu < (int) topology.nodeOfCpu.size()) ? topology.nodeOfCpu[cpu] : 0;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// threads
+// ---------------------------------------------------------------------------
+
+bool NumaPolicy::BindCurrentThreadToNode(size_t node)
+{
+    const auto& cpus = CpusOfNode(node);
+    if (cpus.empty()) // (a node with memory only)
+        return false;
+#ifdef _WIN32
+    DWORD_PTR mask = 0;
+    for (int cpu : cpus)
+        if (cpu < (int) (8 * sizeof(mask)))
+            mask |= (DWORD_PTR) 1 << cpu;
+    return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#else
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+        if (cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+    return sched_setaffinity(0 /*calling thread*/, sizeof(set), &set) == 0;
+#endif
+}
+
+int NumaPolicy::NodeForHelperThread()
+{
+    return IsEnabled() ? (int) CurrentNode() : -1;
+}
+
+void NumaPolicy::BindHelperThread(int node)
+{
+    if (node >= 0)
+        BindCurrentThreadToNode((size_t) node);
+}
+
+#ifndef _WIN32
+// memory policies of the Linux kernel (linux/mempolicy.h), called directly so that we need not link libnuma
+enum { c_mpolPreferred = 1, c_mpolBind = 2 };
+
+static void MakeNodeMask(size_t node, vector<unsigned long>& mask)
+{
+    const size_t bitsPerWord = 8 * sizeof(unsigned long);
+    mask.assign(node / bitsPerWord + 1, 0);
+    mask[node / bitsPerWord] |= 1ul << (node % bitsPerWord);
+}
+#endif
+
+NumaPolicyMode NumaPolicy::ParseMode(const wstring& s)
+{
+    if      (EqualCI(s, L"none") || s.empty()) return NumaPolicyMode::none;
+    else if (EqualCI(s, L"spread"))            return NumaPolicyMode::spread;
+    else if (EqualCI(s, L"perRank"))           return NumaPolicyMode::perRank;
+    else InvalidArgument("numaPolicy: Invalid value '%ls'. Valid values are (none | spread | perRank)", s.c_str());
+}
+
+NumaPolicyMode NumaPolicy::GetMode()
+{
+    return s_mode;
+}
+
+void NumaPolicy::Apply(NumaPolicyMode mode, size_t localRank)
+{
+    s_mode = NumaPolicyMode::none;
+    if (mode == NumaPolicyMode::none)
+        return;
+    const size_t numNodes = NumNodes();
+    if (numNodes < 2)
+    {
+        fprintf(stderr, "numaPolicy: This machine has a single NUMA node; threads and memory will not be bound.\n");
+        return;
+    }
+
+    int numThreads = 1;
+#ifdef _OPENMP
+    numThreads = omp_get_max_threads();
+#endif
+    vector<int> nodeOfThread(numThreads);
+    if (mode == NumaPolicyMode::perRank)
+    {
+        // the whole process lives on one node: threads created later inherit the affinity and the
+        // memory policy of the main thread
+        size_t node = localRank % numNodes;
+        BindCurrentThreadToNode(node);
+#ifndef _WIN32
+        vector<unsigned long> mask;
+        MakeNodeMask(node, mask);
+        if (syscall(SYS_set_mempolicy, c_mpolPreferred, mask.data(), 8 * sizeof(unsigned long) * mask.size() + 1) != 0)
+            fprintf(stderr, "numaPolicy: Could not set the memory policy of the process: %s.\n", strerror(errno));
+#endif
+        for (auto& n : nodeOfThread)
+            n = (int) node;
+    }
+    else
+    {
+        // teams of consecutive OpenMP threads per node; static loop schedules thus give each node a contiguous range of the data
+        for (int t = 0; t < numThreads; t++)
+            nodeOfThread[t] = (int) (t * numNodes / numThreads);
+    }
+
+    // OpenMP runtimes keep their threads across parallel regions, so binding them once sticks.
+    // In the spread mode, the main thread, which is OpenMP thread 0, is left alone: threads created later
+    // (readers, prefetching, thread pools) inherit its affinity and would all end up on node 0.
+    const int firstThreadToBind = mode == NumaPolicyMode::spread ? 1 : 0;
+    int numBound = 0;
+#ifdef _OPENMP
+#pragma omp parallel reduction(+ : numBound)
+    {
+        int t = omp_get_thread_num();
+        if (t >= firstThreadToBind && t < (int) nodeOfThread.size() && BindCurrentThreadToNode(nodeOfThread[t]))
+            numBound++;
+    }
+#else
+    if (firstThreadToBind == 0 && BindCurrentThreadToNode(nodeOfThread[0]))
+        numBound++;
+#endif
+    s_mode = mode;
+    fprintf(stderr, "numaPolicy: %ls, %d NUMA nodes, %d of %d OpenMP threads bound%s.\n",
+            mode == NumaPolicyMode::spread ? L"spread" : L"perRank", (int) numNodes, numBound, numThreads,
+            mode == NumaPolicyMode::perRank ? msra::strfun::strprintf(" to node %d", nodeOfThread[0]).c_str() : " (all but the main thread)");
+}
+
+// ---------------------------------------------------------------------------
+// memory
+// ---------------------------------------------------------------------------
+
+// Each block starts with this header, so that Free() knows how it was allocated.
+// Its size keeps the user pointer aligned to a cache line.
+struct NumaBlockHeader
+{
+    size_t mappedBytes; // 0: from the heap
+    void* base;
+    char padding[64 - sizeof(size_t) - sizeof(void*)];
+};
+
+void* NumaPolicy::Alloc(size_t bytes, size_t node)
+{
+    const size_t totalBytes = bytes + sizeof(NumaBlockHeader);
+    NumaBlockHeader* header = nullptr;
+    if (IsEnabled() && node < NumNodes())
+    {
+#ifdef _WIN32
+        void* base = VirtualAllocExNuma(GetCurrentProcess(), NULL, totalBytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE, (DWORD) node);
+        if (base)
+        {
+            header = (NumaBlockHeader*) base;
+            header->mappedBytes = totalBytes;
+            header->base = base;
+        }
+#else
+        void* base = mmap(nullptr, totalBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base != MAP_FAILED)
+        {
+            // no pages exist yet, so there is nothing to move; if this fails, the memory is merely not bound
+            vector<unsigned long> mask;
+            MakeNodeMask(node, mask);
+            syscall(SYS_mbind, base, totalBytes, c_mpolBind, mask.data(), 8 * sizeof(unsigned long) * mask.size() + 1, 0);
+            header = (NumaBlockHeader*) base;
+            header->mappedBytes = totalBytes;
+            header->base = base;
+        }
+#endif
+    }
+    if (!header)
+    {
+        // heap memory, aligned by hand
+        char* base = (char*) malloc(totalBytes + 63);
+        if (!base)
+            throw bad_alloc();
+        header = (NumaBlockHeader*) (((size_t) base + 63) / 64 * 64);
+        header->mappedBytes = 0;
+        header->base = base;
+    }
+    return header + 1;
+}
+
+void* NumaPolicy::AllocLocal(size_t bytes)
+{
+    return Alloc(bytes, CurrentNode());
+}
+
+void NumaPolicy::Free(void* p)
+{
+    if (!p)
+        return;
+    NumaBlockHeader* header = (NumaBlockHeader*) p - 1;
+    if (header->mappedBytes == 0)
+    {
+        free(header->base);
+        return;
+    }
+#ifdef _WIN32
+    VirtualFree(header, 0, MEM_RELEASE);
+#else
+    munmap(header, header->mappedBytes);
+#endif
+}
+
+void* NumaPolicy::ThreadScratch(size_t bytes)
+{
+    struct Scratch
+    {
+        void* data = nullptr;
+        size_t bytes = 0;
+        ~Scratch() { NumaPolicy::Free(data); }
+    };
+    static thread_local Scratch scratch;
+    if (scratch.bytes < bytes)
+    {
+        NumaPolicy::Free(scratch.data);
+        scratch.data = nullptr; // (in case the allocation throws)
+        scratch.bytes = 0;
+        scratch.data = AllocLocal(bytes);
+        scratch.bytes = bytes;
+    }
+    return scratch.data;
+}
+
+}}}
@@ -458,6 +458,13 @@ void fsyncOrDie(FILE* f)
 #endif
 }
 
+void fsyncOrDie(const std::wstring& pathname)
+{
+    FILE* f = fopenOrDie(pathname, L"r+b");
+    fsyncOrDie(f);
+    fcloseOrDie(f);
+}
+
 // ----------------------------------------------------------------------------
 // fflushOrDie(): like fflush() but terminate with err msg in case of error
 // ----------------------------------------------------------------------------
@@ -21,11 +21,14 @@
 #include "SpecialPurposeNodes.h"
 #include "DeprecatedNodes.h" // (for SaveToDbnFile(), which is also deprecated)
 #include "MPIWrapper.h" // TODO: does not belong here
+#include "TimerUtility.h"
 #include <string>
 #include <vector>
 #include <stack>
 #include <list>
 #include <set>
+#include <map>
+#include <algorithm>
 
 using namespace std;
 
@@ -98,6 +101,151 @@ void ComputationNetwork::PrintNodeTiming()
     }
 }
 
+// -----------------------------------------------------------------------
+// node cost report
+// -----------------------------------------------------------------------
+
+// measure the peak compute rate (a large matrix product) and the memory bandwidth (a large copy) of a device
+// This is done once per device and process; it takes well below a second.
+static void MeasureDevicePeak(DEVICEID_TYPE deviceId, double& peakFlopsPerSecond, double& peakBytesPerSecond)
+{
+    static map<DEVICEID_TYPE, pair<double, double>> s_devicePeaks;
+    auto iter = s_devicePeaks.find(deviceId);
+    if (iter == s_devicePeaks.end())
+    {
+        const size_t numRepetitions = 10;
+        Timer timer;
+
+        const size_t dim = 1024;
+        Matrix<float> a(dim, dim, deviceId), b(dim, dim, deviceId), c(dim, dim, deviceId);
+        a.SetUniformRandomValue(-1, 1, 1);
+        b.SetUniformRandomValue(-1, 1, 2);
+        Matrix<float>::Multiply(a, false, b, false, c); // warm-up
+        c.Get00Element();                               // (waits for the device)
+        timer.Start();
+        for (size_t i = 0; i < numRepetitions; i++)
+            Matrix<float>::Multiply(a, false, b, false, c);
+        c.Get00Element();
+        timer.Stop();
+        double flopsPerSecond = 2.0 * dim * dim * dim * numRepetitions / timer.ElapsedSeconds();
+
+        const size_t numElements = 16 * 1024 * 1024; // well beyond the caches
+        Matrix<float> x(numElements, 1, deviceId), y(numElements, 1, deviceId);
+        x.SetValue(1);
+        y.AssignValuesOf(x); // warm-up
+        y.Get00Element();
+        timer.Restart();
+        for (size_t i = 0; i < numRepetitions; i++)
+            y.AssignValuesOf(x);
+        y.Get00Element();
+        timer.Stop();
+        double bytesPerSecond = 2.0 * numElements * sizeof(float) * numRepetitions / timer.ElapsedSeconds();
+
+        iter = s_devicePeaks.insert(make_pair(deviceId, make_pair(flopsPerSecond, bytesPerSecond))).first;
+    }
+    peakFlopsPerSecond = iter->second.first;
+    peakBytesPerSecond = iter->second.second;
+}
+
+void ComputationNetwork::WriteNodeCostReport(const std::wstring& fileNamePrefix, int epoch)
+{
+    double peakFlopsPerSecond, peakBytesPerSecond;
+    MeasureDevicePeak(m_deviceId, peakFlopsPerSecond, peakBytesPerSecond);
+
+    struct NodeCost
+    {
+        ComputationNodeBasePtr node;
+        const char* phase;
+        ComputationNodeBase::TimingStatistics statistics;
+        double intensity;    // FLOPs per byte
+        bool computeBound;   // whether the roofline at this intensity is the compute peak
+        double idealSeconds; // time at the roofline
+        double wastedSeconds;
+    };
+    vector<NodeCost> costs;
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const auto& node = iter.second;
+        if (node->IsLeaf()) // (timed in backprop, but does no work)
+            continue;
+        for (bool backward : { false, true })
+        {
+            auto statistics = node->GetTimingStatistics(backward);
+            if (statistics.count == 0)
+                continue;
+            NodeCost cost;
+            cost.node = node;
+            cost.phase = backward ? "backward" : "forward";
+            cost.statistics = statistics;
+            cost.intensity = statistics.bytes > 0 ? statistics.flops / statistics.bytes : 0;
+            cost.computeBound = cost.intensity * peakBytesPerSecond >= peakFlopsPerSecond;
+            cost.idealSeconds = max(statistics.flops / peakFlopsPerSecond, statistics.bytes / peakBytesPerSecond);
+            cost.wastedSeconds = max(statistics.seconds - cost.idealSeconds, 0.0);
+            costs.push_back(cost);
+        }
+    }
+    sort(costs.begin(), costs.end(), [](const NodeCost& a, const NodeCost& b) { return a.wastedSeconds > b.wastedSeconds; });
+
+    auto efficiency = [](const NodeCost& cost) { return cost.statistics.seconds > 0 ? cost.idealSeconds / cost.statistics.seconds : 0; };
+
+    auto csvFileName = fileNamePrefix + L".csv";
+    FILE* f = fopenOrDie(csvFileName, L"wt");
+    fprintfOrDie(f, "node,operation,phase,calls,seconds,gflop,gbyte,flopsPerByte,gflopsPerSecond,gbytesPerSecond,bound,idealSeconds,wastedSeconds,efficiency\n");
+    for (const auto& cost : costs)
+    {
+        const auto& statistics = cost.statistics;
+        fprintfOrDie(f, "%ls,%ls,%s,%d,%.6f,%.6f,%.6f,%.3f,%.3f,%.3f,%s,%.6f,%.6f,%.4f\n",
+                     cost.node->NodeName().c_str(), cost.node->OperationName().c_str(), cost.phase, (int)statistics.count, statistics.seconds,
+                     statistics.flops * 1e-9, statistics.bytes * 1e-9, cost.intensity,
+                     statistics.seconds > 0 ? statistics.flops * 1e-9 / statistics.seconds : 0, statistics.seconds > 0 ? statistics.bytes * 1e-9 / statistics.seconds : 0,
+                     cost.computeBound ? "compute" : "memory", cost.idealSeconds, cost.wastedSeconds, efficiency(cost));
+    }
+    fcloseOrDie(f);
+
+    auto jsonString = [](const wstring& s)
+    {
+        string result;
+        for (char c : ToLegacyString(ToUTF8(s)))
+        {
+            if (c == '"' || c == '\\')
+                result += '\\';
+            result += c;
+        }
+        return result;
+    };
+    auto jsonFileName = fileNamePrefix + L".json";
+    f = fopenOrDie(jsonFileName, L"wt");
+    fprintfOrDie(f, "{\n  \"epoch\": %d,\n  \"deviceId\": %d,\n  \"peakGflopsPerSecond\": %.3f,\n  \"peakGbytesPerSecond\": %.3f,\n  \"nodes\": [",
+                 epoch, (int)m_deviceId, peakFlopsPerSecond * 1e-9, peakBytesPerSecond * 1e-9);
+    for (size_t i = 0; i < costs.size(); i++)
+    {
+        const auto& cost = costs[i];
+        const auto& statistics = cost.statistics;
+        fprintfOrDie(f, "%s\n    {\"node\": \"%s\", \"operation\": \"%s\", \"phase\": \"%s\", \"calls\": %d, \"seconds\": %.6f, \"gflop\": %.6f, \"gbyte\": %.6f, "
+                        "\"flopsPerByte\": %.3f, \"bound\": \"%s\", \"idealSeconds\": %.6f, \"wastedSeconds\": %.6f, \"efficiency\": %.4f}",
+                     i == 0 ? "" : ",", jsonString(cost.node->NodeName()).c_str(), jsonString(cost.node->OperationName()).c_str(), cost.phase,
+                     (int)statistics.count, statistics.seconds, statistics.flops * 1e-9, statistics.bytes * 1e-9, cost.intensity,
+                     cost.computeBound ? "compute" : "memory", cost.idealSeconds, cost.wastedSeconds, efficiency(cost));
+    }
+    fprintfOrDie(f, "\n  ]\n}\n");
+    fcloseOrDie(f);
+
+    fprintf(stderr, "WriteNodeCostReport: %d node timings written to %ls.csv/.json (peak %.1f GFLOP/s, %.1f GB/s).\n",
+            (int)costs.size(), fileNamePrefix.c_str(), peakFlopsPerSecond * 1e-9, peakBytesPerSecond * 1e-9);
+    if (!costs.empty())
+        fprintf(stderr, "WriteNodeCostReport: most time lost in %ls %ls operation (%s), %.3fs above its %s-bound minimum.\n",
+                costs.front().node->NodeName().c_str(), costs.front().node->OperationName().c_str(), costs.front().phase,
+                costs.front().wastedSeconds, costs.front().computeBound ? "compute" : "memory");
+
+    ResetNodeTiming();
+}
+
+void ComputationNetwork::ResetNodeTiming()
+{
+    for (auto& iter : m_nameToNodeMap)
+        iter.second->ResetTiming();
+}
+
 // -----------------------------------------------------------------------
 // serialization
 // -----------------------------------------------------------------------
@@ -120,8 +268,31 @@ void ComputationNetwork::Save(const wstring& fileName, const FileOptions fileFor
     renameOrDie(tmpFileName, fileName);
 }
 
+ComputationNetwork::ModelSnapshot ComputationNetwork::SnapshotForSave() const
+{
+    ModelSnapshot snapshot;
+    for (const auto& nodeIter : m_nameToNodeMap)
+    {
+        auto nodeSnapshot = nodeIter.second->SnapshotForSave();
+        if (nodeSnapshot)
+            snapshot[nodeIter.first] = nodeSnapshot;
+    }
+    return snapshot;
+}
+
+void ComputationNetwork::SaveSnapshot(const wstring& fileName, const ModelSnapshot& snapshot, const FileOptions fileFormat) const
+{
+    VerifyIsCompiled("SaveSnapshot");
+    // same temp file and rename as Save(), but also flushed to disk since this is used for checkpoints
+    wstring tmpFileName = fileName + L".tmp";
+    SaveToFileImpl(tmpFileName, fileFormat, &snapshot);
+    fsyncOrDie(tmpFileName);
+    renameOrDie(tmpFileName, fileName);
+}
+
 // TODO: how does the file distinguish float vs double nodes?
-void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptions fileFormat) const
+// If 'snapshot' is given, nodes are saved with SaveSnapshot() from their entry in it instead of their current state.
+void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptions fileFormat, const ModelSnapshot* snapshot) const
 {
     File fstream(fileName, fileFormat | FileOptions::fileOptionsWrite);
     // Buffer writes in memory then flush to filesystem, which reduces number of small writes
@@ -170,7 +341,13 @@ void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptio
         // name
         fstream << nodePtr->NodeName();
         // content
-        nodePtr->Save(fstream);
+        if (snapshot)
+        {
+            auto nodeSnapshot = snapshot->find(nodePtr->NodeName());
+            nodePtr->SaveSnapshot(fstream, nodeSnapshot != snapshot->end() ? nodeSnapshot->second : nullptr);
+        }
+        else
+            nodePtr->Save(fstream);
     }
 
     fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ENodeList");
@@ -302,6 +479,7 @@ void ComputationNetwork::ReadPersistableParameters(size_t modelVersion, File& fs
             AddNodeToNet(node);
         else                      // reloaded existing
         {
+            node->BumpEvalTimeStamp(); // the value changed under nodes that cache data derived from it
             let old = node->GetSampleLayout();
             let changed = ValidateNode(node, /*isFinalValidationPass=*/true);
             if (changed)
@@ -34,6 +34,8 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+class WorkStealingThreadPool;
+
 inline std::wstring ToString(const ComputationNodeBasePtr& node)
 {
     return node->NodeName();
@@ -89,6 +91,12 @@ public:
 
     void PrintNodeTiming();
 
+    // Per-node cost report from the node timing (Globals::SetNodeTiming()): measured time, estimated FLOPs and bytes,
+    // and roofline classification against the measured peak of the device, sorted by the time lost against that peak.
+    // Writes <fileNamePrefix>.csv and <fileNamePrefix>.json, and resets the node timing.
+    void WriteNodeCostReport(const std::wstring& fileNamePrefix, int epoch);
+    void ResetNodeTiming();
+
 protected:
     void ConstructFromRoots(DEVICEID_TYPE deviceId, std::deque<ComputationNodeBasePtr>&& roots, const map<ComputationNodeBasePtr, ComputationNodeBasePtr>& replacements);
     void ProcessSpecialNodes(const ScriptableObjects::IConfigRecord& config, std::deque<ComputationNodeBasePtr>& roots);
@@ -129,9 +137,17 @@ public:
     void Save(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary) const;
     void SaveEdited(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary);
 
+    // asynchronous checkpointing: CPU copies of the state that training changes (parameter values, BatchNormalization run counts,
+    // precomputed statistics), keyed by node name, see ComputationNodeBase::SnapshotForSave().
+    // SnapshotForSave() is called on the training thread; SaveSnapshot() writes a model file from the copies without touching
+    // device memory, and may run on another thread while training continues (the network structure must not be edited meanwhile).
+    typedef std::map<std::wstring, MatrixBasePtr> ModelSnapshot;
+    ModelSnapshot SnapshotForSave() const;
+    void SaveSnapshot(const std::wstring& fileName, const ModelSnapshot& snapshot, const FileOptions fileFormat = FileOptions::fileOptionsBinary) const;
+
 private:
 
-    void SaveToFileImpl(const std::wstring& fileName, const FileOptions fileFormat) const;
+    void SaveToFileImpl(const std::wstring& fileName, const FileOptions fileFormat, const ModelSnapshot* snapshot = nullptr) const;
     
     static size_t GetModelVersion(File& fstream);
 
@@ -183,6 +199,13 @@ public:
     template <class NODESET> // version that takes multiple nodes
     void ForwardProp(const NODESET& nodes)
     {
+        if (IsConcurrentTraversalPlanned())
+        {
+            std::vector<ComputationNodeBasePtr> units;
+            TravserseInSortedGlobalEvalOrder(nodes, [&units](const ComputationNodeBasePtr& node) { units.push_back(node); });
+            ForwardPropConcurrently(units);
+            return;
+        }
         TravserseInSortedGlobalEvalOrder(nodes, [](const ComputationNodeBasePtr& node) {
             PARTraversalFlowControlNode::ForwardProp(node, FrameRange(nullptr));
         });
@@ -268,6 +291,16 @@ private:
 public:
     void AllocateAllMatrices(const std::vector<ComputationNodeBasePtr>& evalRootNodes, const std::vector<ComputationNodeBasePtr>& outValueRootNodes, ComputationNodeBasePtr trainRootNode);
 
+private:
+    // concurrent traversal (see Globals::GetConcurrentTraversalThreads())
+    void PlanConcurrentTraversal();
+    bool IsConcurrentTraversalPlanned() const { return !m_concurrentLevels.empty(); }
+    int GetConcurrentLevel(const ComputationNodeBasePtr& node) const;
+    std::vector<std::vector<ComputationNodeBasePtr>> GetConcurrentForwardWaves(const std::vector<ComputationNodeBasePtr>& nodes) const;
+    std::vector<std::vector<ComputationNodeBasePtr>> GetConcurrentBackwardWaves(const std::vector<ComputationNodeBasePtr>& nodes) const;
+    void ForwardPropConcurrently(const std::vector<ComputationNodeBasePtr>& nodes);
+public:
+
     // From the set of nodes extract all nodes which are used as accumulator nodes.
     std::set<ComputationNodeBasePtr> ExtractNodesWhichAccumulateResult(std::set<ComputationNodeBasePtr> nodes);
 
@@ -341,6 +374,13 @@ public:
             }
         }
 
+        // with concurrent traversal, memory sharing was planned level by level, so every traversal must follow that order
+        if (IsConcurrentTraversalPlanned())
+            std::stable_sort(sortedEvalOrder.begin(), sortedEvalOrder.end(), [this](const ComputationNodeBasePtr& a, const ComputationNodeBasePtr& b)
+            {
+                return GetConcurrentLevel(a) < GetConcurrentLevel(b);
+            });
+
         return sortedEvalOrder;
     }
 
@@ -475,6 +515,22 @@ public:
     //ComputationNodeBasePtr RemoveFeatureNode(ComputationNodeBasePtr featureNode);
     void SetLearnableNodesBelowLearningRateMultiplier(const float learningRateMultiplier, const ComputationNodeBasePtr& rootNode = nullptr);
 
+    // inference graph optimization (constant folding, BatchNormalization folding, Times/Plus/activation fusion)
+    template <class ElemType>
+    void OptimizeForInference();
+
+private:
+    template <class ElemType>
+    size_t FoldConstantSubgraphs();
+    template <class ElemType>
+    size_t FoldBatchNormalization();
+    template <class ElemType>
+    size_t FuseAffineActivations();
+    void SubstituteNode(const ComputationNodeBasePtr& oldNode, const ComputationNodeBasePtr& newNode);
+    void RemoveUnreachableNodes(const std::vector<std::wstring>& rootNames);
+    std::map<ComputationNodeBasePtr, size_t> GetNumConsumersOfNodes();
+public:
+
     // -----------------------------------------------------------------------
     // node access
     // -----------------------------------------------------------------------
@@ -1185,8 +1241,13 @@ protected:
         }
 
         static void ForwardProp(const ComputationNodeBasePtr& node, const FrameRange& fr);
+        static void Backprop(const ComputationNodeBasePtr& node, const FrameRange& fr);
         static void PostForwardAndBackProp(const ComputationNodeBasePtr& node);
 
+        // run each wave on the thread pool; nodes in a wave must be independent of each other
+        static void RunWaves(WorkStealingThreadPool& threadPool, const std::vector<std::vector<ComputationNodeBasePtr>>& waves,
+                             const std::function<void(const ComputationNodeBasePtr&)>& action);
+
         virtual void BeginForwardProp() override {}
         virtual void ForwardProp(const FrameRange&) override;
         virtual void EndForwardProp() override {}
@@ -1212,6 +1273,17 @@ protected:
         // There is currently no other constructor for inner nested PAR-traversed sub-networks, but there will be.
         PARTraversalFlowControlNode(const std::vector<shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const std::list<ComputationNodeBasePtr>& allNodes);
         // Base::m_nestedNodes contains all top-level nodes, in evaluation order
+
+        // switch to concurrent execution of the given waves of m_nestedNodes
+        // Backward waves are optional; without them, Backprop() remains sequential.
+        void SetConcurrentSchedule(const std::shared_ptr<WorkStealingThreadPool>& threadPool,
+                                   std::vector<std::vector<ComputationNodeBasePtr>>&& forwardWaves,
+                                   std::vector<std::vector<ComputationNodeBasePtr>>&& backwardWaves);
+
+    private:
+        std::shared_ptr<WorkStealingThreadPool> m_threadPool;                  // null for sequential execution
+        std::vector<std::vector<ComputationNodeBasePtr>> m_forwardWaves;       // m_nestedNodes grouped into sets of independent nodes, in execution order
+        std::vector<std::vector<ComputationNodeBasePtr>> m_backwardWaves;      // same for Backprop(); nodes in a wave do not share any input
     };
 
 public:
@@ -1286,6 +1358,10 @@ private:
     // TODO: does this apply to anything else besides temporary node-internal intermediate results? What, for example?
     MatrixPool m_matrixPool;
 
+    // concurrent traversal, set up by AllocateAllMatrices() if Globals::GetConcurrentTraversalThreads() > 1 on CPU
+    std::map<ComputationNodeBasePtr, int> m_concurrentLevels;                  // [node] -> longest path from any leaf; nodes of a loop share the level of their loop
+    std::shared_ptr<WorkStealingThreadPool> m_concurrentTraversalThreadPool;
+
     // Implementation of a graph based on ComputationNodes.
     class ExecutionGraph : public ::CNTK::DirectedGraph<ComputationNodeBasePtr>
     {
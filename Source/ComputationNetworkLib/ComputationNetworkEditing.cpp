@@ -9,10 +9,14 @@
 #include "ComputationNode.h"
 #include "ComputationNetwork.h"
 #include "InputAndParamNodes.h"
+#include "LinearAlgebraNodes.h"
+#include "NonlinearityNodes.h"
+#include "ConvolutionalNodes.h"
 #include "TrainingNodes.h"
 #include <string>
 #include <vector>
 #include <list>
+#include <cmath>
 
 using namespace std;
 
@@ -367,4 +371,477 @@ void ComputationNetwork::SetLearnableNodesBelowLearningRateMultiplier(const floa
     }
 }
 
+
+// -----------------------------------------------------------------------
+// inference graph optimization
+// -----------------------------------------------------------------------
+
+// OptimizeForInference() rewrites a trained network into a frozen one that is cheaper to evaluate:
+//  - subgraphs that only depend on parameters are computed once and replaced by a parameter holding the result,
+//  - BatchNormalization following Times or Convolution (with or without bias Plus) is folded into the weights and a bias,
+//  - Times + Plus (+ Sigmoid, Tanh or RectifiedLinear) are replaced by a single FusedAffineNode.
+// A node that replaces a chain takes over the name of the last node of the chain, and node groups are updated,
+// so that readers, writers and 'outputNodeNames' work on the optimized network as before. The result can be saved.
+// The folded parameters can no longer be trained, while the fused nodes pass on gradients like the nodes they replace.
+// This must be called before the network is evaluated.
+template <class ElemType>
+void ComputationNetwork::OptimizeForInference()
+{
+    if (AreMatricesAllocated())
+        LogicError("OptimizeForInference: The network must be optimized before its matrices are allocated for evaluation.");
+    if (!IsCompiled())
+        CompileNetwork();
+
+    NetworkOperationMode previousMode = Environment().SetOperationMode(NetworkOperationMode::inferring);
+
+    size_t numConstantSubgraphs = FoldConstantSubgraphs<ElemType>();
+    size_t numBatchNormalizations = FoldBatchNormalization<ElemType>();
+    size_t numFusedAffines = FuseAffineActivations<ElemType>();
+
+    Environment().SetOperationMode(previousMode);
+
+    fprintf(stderr, "OptimizeForInference: Folded %d constant subgraphs and %d BatchNormalization nodes, fused %d affine operations; %d nodes remain.\n",
+            (int)numConstantSubgraphs, (int)numBatchNormalizations, (int)numFusedAffines, (int)GetTotalNumberOfNodes());
+}
+
+// replace all values that are computed from parameters only by a parameter holding that value
+template <class ElemType>
+size_t ComputationNetwork::FoldConstantSubgraphs()
+{
+    std::vector<std::wstring> rootNames;
+    for (const auto& root : RootNodes())
+        rootNames.push_back(root->NodeName());
+
+    // determine the nodes whose value does not change between minibatches
+    std::set<ComputationNodeBasePtr> constantNodes;
+    std::list<ComputationNodeBasePtr> foldableNodes; // in evaluation order
+    for (const auto& node : GetEvalOrder(nullptr))
+    {
+        if (node->Is<LearnableParameter<ElemType>>())
+        {
+            constantNodes.insert(node);
+            continue;
+        }
+        if (node->GetNumInputs() == 0 || node->HasMBLayout() || node->IsPartOfLoop() ||
+            node->Is<IPreComputeNode>() || node->Is<IRngUser>() || node->Is<IStatefulNode>() ||
+            !node->Is<ComputationNode<ElemType>>() || node->Is<MultiOutputNode<ElemType>>())
+            continue;
+        const auto& inputs = node->GetInputs();
+        if (std::all_of(inputs.begin(), inputs.end(), [&](const ComputationNodeBasePtr& input) { return constantNodes.find(input) != constantNodes.end(); }))
+        {
+            constantNodes.insert(node);
+            foldableNodes.push_back(node);
+        }
+    }
+
+    // fold the largest constant subgraphs, i.e. those that are used by a non-constant node or referenced by a node group
+    std::set<ComputationNodeBasePtr> nodesToFold;
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        if (constantNodes.find(iter.second) != constantNodes.end())
+            continue;
+        for (const auto& input : iter.second->GetInputs())
+            if (input && !input->Is<LearnableParameter<ElemType>>() && constantNodes.find(input) != constantNodes.end())
+                nodesToFold.insert(input);
+    }
+    for (auto groupIter : GetAllNodeGroups())
+        for (const auto& node : *groupIter)
+            if (!node->Is<LearnableParameter<ElemType>>() && constantNodes.find(node) != constantNodes.end())
+                nodesToFold.insert(node);
+    if (nodesToFold.empty())
+        return 0;
+
+    // compute their values once, in evaluation order
+    // Values of these nodes are never shared (see MarkValueNonSharableNodes()), so we only use a private pool for temporaries.
+    std::set<ComputationNodeBasePtr> nodesToEvaluate;
+    std::vector<ComputationNodeBasePtr> stack(nodesToFold.begin(), nodesToFold.end());
+    while (!stack.empty())
+    {
+        auto node = stack.back();
+        stack.pop_back();
+        if (node->Is<LearnableParameter<ElemType>>() || !nodesToEvaluate.insert(node).second)
+            continue;
+        for (const auto& input : node->GetInputs())
+            stack.push_back(input);
+    }
+
+    MatrixPool matrixPool;
+    matrixPool.Reset();
+    for (const auto& node : foldableNodes)
+    {
+        if (nodesToEvaluate.find(node) == nodesToEvaluate.end())
+            continue;
+        node->MarkValueNonSharable();
+        node->RequestMatricesBeforeForwardProp(matrixPool);
+    }
+    matrixPool.OptimizedMemoryAllocation();
+    for (const auto& node : foldableNodes)
+    {
+        if (nodesToEvaluate.find(node) == nodesToEvaluate.end())
+            continue;
+        node->BeginForwardProp();
+        node->ForwardProp(FrameRange(nullptr));
+        node->EndForwardProp();
+    }
+
+    // and replace them by parameters
+    for (const auto& node : nodesToFold)
+    {
+        auto parameter = New<LearnableParameter<ElemType>>(m_deviceId, node->NodeName(), node->GetSampleLayout());
+        parameter->Value().SetValue(node->As<ComputationNode<ElemType>>()->Value());
+        SubstituteNode(node, parameter);
+        GetNodeFromName(node->NodeName())->SetLearningRateMultiplier(0);
+    }
+
+    RemoveUnreachableNodes(rootNames);
+    CompileNetwork();
+    return nodesToFold.size();
+}
+
+template <class ElemType>
+static std::vector<double> GetParameterValues(const ComputationNodeBasePtr& node)
+{
+    const auto& value = node->As<ComputationNode<ElemType>>()->Value();
+    std::unique_ptr<ElemType[]> data(value.CopyToArray());
+    return std::vector<double>(data.get(), data.get() + value.GetNumElements());
+}
+
+template <class ElemType>
+static void SetParameterValues(const ComputationNodeBasePtr& node, const std::vector<double>& values)
+{
+    auto& value = node->As<ComputationNode<ElemType>>()->Value();
+    assert(values.size() == value.GetNumElements());
+    std::vector<ElemType> data(values.begin(), values.end());
+    value.SetValue(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId(), data.data());
+}
+
+// fold BatchNormalization in inference mode into the preceding Times or Convolution:
+//   BN(W * x + b) = s * (W * x + b - mean) + bias = (s * W) * x + (s * (b - mean) + bias),  with s = scale / sqrt(var + epsilon)
+// The BatchNormalization node is replaced by the bias Plus, or by a new one if there was none.
+// The weights (and bias) must not be shared with other nodes.
+template <class ElemType>
+size_t ComputationNetwork::FoldBatchNormalization()
+{
+    std::vector<std::wstring> rootNames;
+    for (const auto& root : RootNodes())
+        rootNames.push_back(root->NodeName());
+
+    auto numConsumers = GetNumConsumersOfNodes();
+    auto isUnsharedParameter = [&](const ComputationNodeBasePtr& node)
+    {
+        return node->Is<LearnableParameter<ElemType>>() && numConsumers[node] == 1;
+    };
+
+    size_t numFolded = 0;
+    std::list<ComputationNodeBasePtr> nodes = GetEvalOrder(nullptr); // (copy, since we modify the network)
+    for (const auto& node : nodes)
+    {
+        auto bn = dynamic_pointer_cast<BatchNormalizationNode<ElemType>>(node);
+        if (!bn || node->IsPartOfLoop() || (bn->Spatial() && bn->ImageLayout() != ImageLayoutKind::CHW))
+            continue;
+
+        // find the pattern Times/Convolution (W, x) [+ b] -> BatchNormalization
+        ComputationNodeBasePtr plus, product, productBias;
+        ComputationNodeBasePtr input = node->Input(0);
+        if (input->OperationName() == OperationNameOf(PlusNode) && numConsumers[input] == 1)
+        {
+            for (size_t i = 0; i < 2; i++)
+            {
+                if (input->Input(i)->Is<LearnableParameter<ElemType>>() && !input->Input(1 - i)->Is<LearnableParameter<ElemType>>())
+                {
+                    plus = input;
+                    productBias = input->Input(i);
+                    product = input->Input(1 - i);
+                }
+            }
+            if (!plus)
+                continue;
+        }
+        else
+            product = input;
+        if (numConsumers[product] != 1 || product->IsPartOfLoop() || !isUnsharedParameter(product->Input(0)))
+            continue;
+
+        const auto& outputLayout = product->GetSampleLayout();
+        size_t outputSize = outputLayout.GetNumElements();
+        auto times = dynamic_pointer_cast<TimesNode<ElemType>>(product);
+        auto convolution = dynamic_pointer_cast<ConvolutionNode<ElemType>>(product);
+        if (times)
+        {
+            // one weight row per output element
+            if (times->OutputRank() != 1 || times->InferInputRankToMap() == TimesNode<ElemType>::ReduceSequenceAxisWithoutInferredInputRank ||
+                product->Input(0)->GetSampleLayout()[0] != outputSize)
+                continue;
+        }
+        else if (convolution)
+        {
+            // one kernel per output channel (the last output dimension); requires per-channel (spatial) normalization
+            const auto& sharing = convolution->Sharing();
+            if (convolution->Transpose() || convolution->ImageLayout() != ImageLayoutKind::CHW || !bn->Spatial() ||
+                !std::all_of(sharing.begin(), sharing.end(), [](bool b) { return b; }))
+                continue;
+        }
+        else
+            continue;
+
+        std::shared_ptr<LearnableParameter<ElemType>> bnParameters[5];
+        bool haveParameters = true;
+        for (size_t i = 1; i < 5; i++)
+            haveParameters &= (bnParameters[i] = dynamic_pointer_cast<LearnableParameter<ElemType>>(node->Input(i))) != nullptr;
+        if (!haveParameters)
+            continue;
+        auto scale    = GetParameterValues<ElemType>(bnParameters[1]);
+        auto bias     = GetParameterValues<ElemType>(bnParameters[2]);
+        auto mean     = GetParameterValues<ElemType>(bnParameters[3]);
+        auto variance = GetParameterValues<ElemType>(bnParameters[4]);
+        size_t numChannels = scale.size();
+        if (numChannels == 0 || bias.size() != numChannels || mean.size() != numChannels || variance.size() != numChannels || outputSize % numChannels != 0 ||
+            (!bn->Spatial() && numChannels != outputSize) || (convolution && outputLayout[outputLayout.GetRank() - 1] != numChannels))
+            continue;
+        size_t spatialSize = outputSize / numChannels; // output element i belongs to channel i / spatialSize
+
+        // an existing bias is either a full tensor or one value per channel
+        bool perChannelBias = false;
+        if (productBias)
+        {
+            const auto& biasLayout = productBias->GetSampleLayout();
+            if (plus->GetSampleLayout() != outputLayout || biasLayout.GetRank() > outputLayout.GetRank())
+                continue;
+            bool fullBias = true;
+            perChannelBias = true;
+            for (size_t k = 0; k < outputLayout.GetRank(); k++)
+            {
+                size_t dim = k < biasLayout.GetRank() ? biasLayout[k] : 1;
+                fullBias &= (dim == outputLayout[k]);
+                perChannelBias &= (dim == (k + 1 == outputLayout.GetRank() ? numChannels : 1));
+            }
+            if (!fullBias && !perChannelBias)
+                continue;
+            perChannelBias = !fullBias;
+        }
+
+        double epsilon = bn->Epsilon();
+        if (!bn->UseCNTKEngine())
+            epsilon = max(epsilon, 1e-5); // cuDNN minimum, see BatchNormalizationNode::Validate()
+        std::vector<double> channelScale(numChannels), channelShift(numChannels);
+        for (size_t c = 0; c < numChannels; c++)
+        {
+            channelScale[c] = scale[c] / sqrt(variance[c] + epsilon);
+            channelShift[c] = bias[c] - mean[c] * channelScale[c];
+        }
+
+        // scale the weights
+        auto weights = GetParameterValues<ElemType>(product->Input(0));
+        if (times)
+        {
+            for (size_t j = 0; j < weights.size(); j++)
+                weights[j] *= channelScale[(j % outputSize) / spatialSize];
+        }
+        else
+        {
+            if (weights.size() % numChannels != 0)
+                continue;
+            size_t kernelSize = weights.size() / numChannels;
+            for (size_t j = 0; j < weights.size(); j++)
+                weights[j] *= channelScale[j / kernelSize];
+        }
+        SetParameterValues<ElemType>(product->Input(0), weights);
+
+        // compute the new bias
+        std::vector<double> newBias;
+        TensorShape newBiasLayout;
+        if (!productBias)
+        {
+            newBias = channelShift;
+            newBiasLayout = outputLayout;
+            if (bn->Spatial()) // one value per channel, broadcast over the image
+            {
+                SmallVector<size_t> dims(outputLayout.GetRank(), 1);
+                dims.back() = numChannels;
+                newBiasLayout = TensorShape(dims);
+            }
+        }
+        else
+        {
+            newBias = GetParameterValues<ElemType>(productBias);
+            newBiasLayout = productBias->GetSampleLayout();
+            for (size_t i = 0; i < newBias.size(); i++)
+            {
+                size_t c = perChannelBias ? i : i / spatialSize;
+                newBias[i] = newBias[i] * channelScale[c] + channelShift[c];
+            }
+        }
+
+        // and rewire: the bias Plus takes the place of the BatchNormalization node
+        if (productBias && isUnsharedParameter(productBias))
+            SetParameterValues<ElemType>(productBias, newBias);
+        else
+        {
+            wstring biasName = bn->NodeName() + L".foldedBias";
+            if (NodeNameExists(biasName))
+                LogicError("FoldBatchNormalization: Node name %ls already exists.", biasName.c_str());
+            auto newBiasParameter = AddNodeToNet(New<LearnableParameter<ElemType>>(m_deviceId, biasName, newBiasLayout));
+            SetParameterValues<ElemType>(newBiasParameter, newBias);
+            newBiasParameter->SetLearningRateMultiplier(0);
+            if (!plus)
+                plus = New<PlusNode<ElemType>>(m_deviceId, bn->NodeName());
+            plus->AttachInputs({ product, newBiasParameter });
+        }
+        SubstituteNode(bn, plus);
+        numFolded++;
+    }
+
+    RemoveUnreachableNodes(rootNames);
+    CompileNetwork();
+    return numFolded;
+}
+
+// replace Times (W, x) + b [-> Sigmoid, Tanh or RectifiedLinear] by a FusedAffineNode
+template <class ElemType>
+size_t ComputationNetwork::FuseAffineActivations()
+{
+    std::vector<std::wstring> rootNames;
+    for (const auto& root : RootNodes())
+        rootNames.push_back(root->NodeName());
+
+    auto numConsumers = GetNumConsumersOfNodes();
+    std::map<ComputationNodeBasePtr, ComputationNodeBasePtr> consumerOf; // for nodes with a single consumer
+    for (const auto& iter : m_nameToNodeMap)
+        for (const auto& input : iter.second->GetInputs())
+            if (input && numConsumers[input] == 1)
+                consumerOf[input] = iter.second;
+
+    size_t numFused = 0;
+    std::list<ComputationNodeBasePtr> nodes = GetEvalOrder(nullptr); // (copy, since we modify the network)
+    for (const auto& node : nodes)
+    {
+        if (node->OperationName() != OperationNameOf(PlusNode) || !node->Is<PlusNode<ElemType>>() || node->IsPartOfLoop())
+            continue;
+        ComputationNodeBasePtr plus = node;
+
+        ComputationNodeBasePtr times, bias;
+        for (size_t i = 0; i < 2; i++)
+        {
+            if (plus->Input(i)->Is<TimesNode<ElemType>>() && numConsumers[plus->Input(i)] == 1 && !plus->Input(1 - i)->HasMBLayout())
+            {
+                times = plus->Input(i);
+                bias = plus->Input(1 - i);
+            }
+        }
+        if (!times || times->IsPartOfLoop() || times->As<TimesNode<ElemType>>()->OutputRank() != 1 ||
+            times->As<TimesNode<ElemType>>()->InferInputRankToMap() == TimesNode<ElemType>::ReduceSequenceAxisWithoutInferredInputRank)
+            continue;
+
+        // W must be a [O x I] matrix, x minibatch data, b a [O] vector, and the result of Plus a [O] vector
+        // (x may be a node fused earlier in this loop, which is not validated yet, so we test its layout on Times)
+        auto weights = times->Input(0);
+        auto input = times->Input(1);
+        const auto& outputLayout = times->GetSampleLayout();
+        const auto& biasLayout = bias->GetSampleLayout();
+        if (weights->HasMBLayout() || !times->HasMBLayout() ||
+            outputLayout.GetRank() != 1 || weights->GetSampleLayout()[0] != outputLayout[0] ||
+            biasLayout.GetRank() == 0 || biasLayout[0] != outputLayout[0] || biasLayout.GetNumElements() != outputLayout[0] ||
+            plus->GetSampleLayout() != outputLayout || plus->GetMBLayout() != times->GetMBLayout())
+            continue;
+
+        // absorb a following activation
+        ComputationNodeBasePtr last = plus;
+        FusedActivationKind activation = FusedActivationKind::None;
+        auto consumer = consumerOf.find(plus);
+        if (consumer != consumerOf.end() && !consumer->second->IsPartOfLoop() && consumer->second->Is<ComputationNode<ElemType>>())
+        {
+            const auto& operationName = consumer->second->OperationName();
+            if (operationName == OperationNameOf(SigmoidNode))
+                activation = FusedActivationKind::Sigmoid;
+            else if (operationName == OperationNameOf(TanhNode))
+                activation = FusedActivationKind::Tanh;
+            else if (operationName == OperationNameOf(RectifiedLinearNode))
+                activation = FusedActivationKind::RectifiedLinear;
+            if (activation != FusedActivationKind::None)
+                last = consumer->second;
+        }
+
+        auto fused = New<FusedAffineNode<ElemType>>(m_deviceId, last->NodeName(), activation);
+        fused->AttachInputs({ weights, input, bias });
+        SubstituteNode(last, fused);
+        numFused++;
+    }
+
+    RemoveUnreachableNodes(rootNames);
+    CompileNetwork();
+    return numFused;
+}
+
+// move all references to oldNode (inputs of other nodes and node groups) to newNode, which takes over the name of oldNode
+// oldNode is removed from the network. Its inputs are left in place; use RemoveUnreachableNodes() to clean up.
+void ComputationNetwork::SubstituteNode(const ComputationNodeBasePtr& oldNode, const ComputationNodeBasePtr& newNode)
+{
+    InvalidateCompiledNetwork();
+
+    ChangeNodeInputs(oldNode, newNode);
+    for (auto groupIter : GetAllNodeGroups())
+        for (auto& node : *groupIter)
+            if (node == oldNode)
+                node = newNode;
+
+    RemoveNodeFromNet(oldNode);
+    if (NodeNameExists(newNode->NodeName()) && GetNodeFromName(newNode->NodeName()) == newNode)
+        RemoveNodeFromNet(newNode);
+    newNode->SetNodeName(oldNode->NodeName());
+    AddNodeToNet(newNode);
+    oldNode->DetachInputs();
+}
+
+// remove all nodes that are neither reachable from the given roots nor from a node group
+// Roots are passed by name since a replaced node passes its name on to its replacement.
+void ComputationNetwork::RemoveUnreachableNodes(const std::vector<std::wstring>& rootNames)
+{
+    InvalidateCompiledNetwork();
+
+    std::vector<ComputationNodeBasePtr> stack;
+    for (const auto& rootName : rootNames)
+        if (NodeNameExists(rootName))
+            stack.push_back(GetNodeFromName(rootName));
+    for (auto groupIter : GetAllNodeGroups())
+        stack.insert(stack.end(), groupIter->begin(), groupIter->end());
+
+    std::set<ComputationNodeBasePtr> reachable;
+    while (!stack.empty())
+    {
+        auto node = stack.back();
+        stack.pop_back();
+        if (!node || !reachable.insert(node).second)
+            continue;
+        for (const auto& input : node->GetInputs())
+            stack.push_back(input);
+    }
+
+    std::vector<ComputationNodeBasePtr> unreachable;
+    for (const auto& iter : m_nameToNodeMap)
+        if (reachable.find(iter.second) == reachable.end())
+            unreachable.push_back(iter.second);
+    for (const auto& node : unreachable)
+    {
+        node->DetachInputs();
+        RemoveNodeFromNet(node);
+    }
+}
+
+// number of references to each node, as input of other nodes or as member of a node group
+std::map<ComputationNodeBasePtr, size_t> ComputationNetwork::GetNumConsumersOfNodes()
+{
+    std::map<ComputationNodeBasePtr, size_t> numConsumers;
+    for (const auto& iter : m_nameToNodeMap)
+        for (const auto& input : iter.second->GetInputs())
+            if (input)
+                numConsumers[input]++;
+    for (auto groupIter : GetAllNodeGroups())
+        for (const auto& node : *groupIter)
+            numConsumers[node]++;
+    return numConsumers;
+}
+
+template void ComputationNetwork::OptimizeForInference<float>();
+template void ComputationNetwork::OptimizeForInference<double>();
+
 }}}
@@ -12,12 +12,17 @@
 #include "InputAndParamNodes.h"
 #include "LinearAlgebraNodes.h"
 #include "SpecialPurposeNodes.h"
+#include "WorkStealingThreadPool.h"
+#include "Globals.h"
 #include <string>
 #include <vector>
 #include <list>
 #include <set>
 #include <algorithm>
 #include <map>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 
@@ -94,7 +99,10 @@ void ComputationNetwork::FormNestedNetwork(const ComputationNodeBasePtr& rootNod
     if (m_nestedNetworks.find(rootNode) != m_nestedNetworks.end())
         fprintf(stderr, "FormNestedNetwork: WARNING: Was called twice for %ls %ls operation\n", rootNode->NodeName().c_str(), rootNode->OperationName().c_str());
 
-    m_nestedNetworks[rootNode] = make_shared<PARTraversalFlowControlNode>(m_allSEQNodes, GetEvalOrder(rootNode));
+    auto nestedNetwork = make_shared<PARTraversalFlowControlNode>(m_allSEQNodes, GetEvalOrder(rootNode));
+    if (IsConcurrentTraversalPlanned()) // network was recompiled after AllocateAllMatrices()
+        nestedNetwork->SetConcurrentSchedule(m_concurrentTraversalThreadPool, GetConcurrentForwardWaves(nestedNetwork->As<FlowControlNode>()->m_nestedNodes), {});
+    m_nestedNetworks[rootNode] = nestedNetwork;
 }
 
 ComputationNodeBasePtr ComputationNetwork::GetNestedNetwork(const ComputationNodeBasePtr& rootNode)
@@ -162,6 +170,11 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::ForwardProp(const FrameRange& fr) /*override*/
 {
+    if (m_threadPool)
+    {
+        RunWaves(*m_threadPool, m_forwardWaves, [&fr](const ComputationNodeBasePtr& node) { ForwardProp(node, fr); });
+        return;
+    }
     for (auto& node : m_nestedNodes)
         ForwardProp(node, fr);
 }
@@ -177,24 +190,30 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
         PostForwardAndBackProp(node);
 }
 
+/*static*/ void ComputationNetwork::PARTraversalFlowControlNode::Backprop(const ComputationNodeBasePtr& node, const FrameRange& fr)
+{
+    node->BeginBackprop();
+    node->BeginTiming(true /*backward*/);
+    node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
+    node->EndTiming(true /*backward*/);
+    node->EndBackprop();
+
+    // Extreme Tracing, part 2/4
+    if (node->HasEnvironmentPtr() && node->Environment().ShouldDumpNode() && node->NeedsGradient())
+        DumpNode(node, /*dumpGradient=*/true);
+}
+
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::Backprop(const FrameRange& fr, bool childrenInThisLoop, bool childrenInOuterLoop) /*override*/
 {
     childrenInThisLoop, childrenInOuterLoop; // TODO: think through what these mean when coming from PAR mode
-    // process nodes in pre-determined order
-    for (auto pnode = m_nestedNodes.rbegin(); pnode != m_nestedNodes.rend(); pnode++) // iterate backwards over evaluation order
+    if (m_threadPool && !m_backwardWaves.empty())
     {
-        auto& node = *pnode;
-
-        node->BeginBackprop();
-        node->BeginTiming(true /*backward*/);
-        node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
-        node->EndTiming(true /*backward*/);
-        node->EndBackprop();
-
-        // Extreme Tracing, part 2/4
-        if (node->HasEnvironmentPtr() && node->Environment().ShouldDumpNode() && node->NeedsGradient())
-            DumpNode(node, /*dumpGradient=*/true);
+        RunWaves(*m_threadPool, m_backwardWaves, [&fr](const ComputationNodeBasePtr& node) { Backprop(node, fr); });
+        return;
     }
+    // process nodes in pre-determined order
+    for (auto pnode = m_nestedNodes.rbegin(); pnode != m_nestedNodes.rend(); pnode++) // iterate backwards over evaluation order
+        Backprop(*pnode, fr);
 }
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) /*override*/
 {
@@ -212,6 +231,207 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 {
 }
 
+void ComputationNetwork::PARTraversalFlowControlNode::SetConcurrentSchedule(const std::shared_ptr<WorkStealingThreadPool>& threadPool,
+                                                                            std::vector<std::vector<ComputationNodeBasePtr>>&& forwardWaves,
+                                                                            std::vector<std::vector<ComputationNodeBasePtr>>&& backwardWaves)
+{
+    m_threadPool = threadPool;
+    m_forwardWaves = move(forwardWaves);
+    m_backwardWaves = move(backwardWaves);
+}
+
+// A wave with a single node (long chains, and nodes that must not run concurrently) runs on the calling thread.
+// Other waves are spread over the pool. Since the nodes of a wave are independent and do not share memory
+// (see MatrixPool::BeginStepGroup()), the result does not depend on which thread runs which node.
+/*static*/ void ComputationNetwork::PARTraversalFlowControlNode::RunWaves(WorkStealingThreadPool& threadPool, const std::vector<std::vector<ComputationNodeBasePtr>>& waves,
+                                                                         const std::function<void(const ComputationNodeBasePtr&)>& action)
+{
+    for (const auto& wave : waves)
+    {
+        if (wave.size() == 1)
+            action(wave.front());
+        else
+            threadPool.ParallelFor(wave.size(), [&](size_t i) { action(wave[i]); });
+    }
+}
+
+// -----------------------------------------------------------------------
+// concurrent traversal
+//
+// On CPU, independent parts of the network (inception branches, towers, multiple
+// criteria) can be computed at the same time. Every top-level node (or loop) gets a
+// level, the length of the longest path from any leaf to it; nodes of equal level do
+// not depend on each other and form a 'wave' that runs on a work-stealing thread pool.
+// AllocateAllMatrices() plans memory sharing wave by wave, so that nodes of one wave
+// never share a matrix. For backprop, nodes that feed gradients into the same input
+// are put into different waves, in their sequential order, which keeps the summation
+// order of gradients, and thus the results, identical to sequential traversal.
+// -----------------------------------------------------------------------
+
+// nodes that call out to user code must not run concurrently with others
+// (UserDefinedV2FunctionNode is matched by name, since it lives in the V2 library.)
+static bool IsConcurrencySafe(const ComputationNodeBasePtr& node)
+{
+    auto isSafe = [](const ComputationNodeBasePtr& n) { return n->OperationName() != L"UserDefinedV2Function"; };
+    if (node->Is<FlowControlNode>())
+    {
+        const auto& nestedNodes = node->As<FlowControlNode>()->m_nestedNodes;
+        return std::all_of(nestedNodes.begin(), nestedNodes.end(), isSafe);
+    }
+    return isSafe(node);
+}
+
+// inputs of a top-level node; for a loop, the inputs of its members from outside the loop
+static std::vector<ComputationNodeBasePtr> GetInputsOfUnit(const ComputationNodeBasePtr& unit)
+{
+    if (!unit->Is<FlowControlNode>())
+        return unit->GetInputs();
+    const auto& nestedNodes = unit->As<FlowControlNode>()->m_nestedNodes;
+    std::vector<ComputationNodeBasePtr> inputs;
+    for (const auto& node : nestedNodes)
+        for (const auto& input : node->GetInputs())
+            if (std::find(nestedNodes.begin(), nestedNodes.end(), input) == nestedNodes.end() && std::find(inputs.begin(), inputs.end(), input) == inputs.end())
+                inputs.push_back(input);
+    return inputs;
+}
+
+// determine the level of every node, and create the thread pool
+// This must be called before any memory is planned, since the memory plan depends on the levels.
+void ComputationNetwork::PlanConcurrentTraversal()
+{
+    size_t numThreads = Globals::GetConcurrentTraversalThreads();
+    if (numThreads <= 1 || m_deviceId != CPUDEVICE)
+        return;
+
+    m_concurrentLevels.clear();
+    for (const auto& node : GetEvalOrder(nullptr)) // (inputs come before their consumers, and members of a loop are consecutive)
+    {
+        if (m_concurrentLevels.find(node) != m_concurrentLevels.end())
+            continue; // member of a loop that was already done
+        ComputationNodeBasePtr unit = node;
+        if (node->IsPartOfLoop())
+            unit = FindInRecurrentLoops(m_allSEQNodes, node);
+        int level = 0;
+        for (const auto& input : GetInputsOfUnit(unit))
+            level = max(level, GetConcurrentLevel(input) + 1);
+        m_concurrentLevels[unit] = level;
+        if (unit != node)
+            for (const auto& loopNode : unit->As<SEQTraversalFlowControlNode>()->m_nestedNodes)
+                m_concurrentLevels[loopNode] = level;
+    }
+
+    // Split the CPU threads among the workers, so that the math library does not oversubscribe the cores.
+    // Each worker uses the same number of threads, so results do not depend on which worker runs a node.
+    int numThreadsPerWorker = 1;
+#ifdef _OPENMP
+    numThreadsPerWorker = max(1, omp_get_max_threads() / (int)numThreads);
+#endif
+    m_concurrentTraversalThreadPool = make_shared<WorkStealingThreadPool>(numThreads, [numThreadsPerWorker]()
+    {
+#ifdef _OPENMP
+        omp_set_num_threads(numThreadsPerWorker);
+#else
+        numThreadsPerWorker;
+#endif
+    });
+
+    if (TraceLevel() > 0)
+    {
+        int maxLevel = 0;
+        for (const auto& iter : m_concurrentLevels)
+            maxLevel = max(maxLevel, iter.second);
+        fprintf(stderr, "Concurrent traversal: %d nodes in %d levels on %d threads (%d CPU threads each).\n",
+                (int)m_concurrentLevels.size(), maxLevel + 1, (int)numThreads, numThreadsPerWorker);
+    }
+}
+
+int ComputationNetwork::GetConcurrentLevel(const ComputationNodeBasePtr& node) const
+{
+    auto iter = m_concurrentLevels.find(node);
+    if (iter == m_concurrentLevels.end())
+        LogicError("GetConcurrentLevel: %ls %ls operation was added to the network after its concurrent traversal was planned.", node->NodeName().c_str(), node->OperationName().c_str());
+    return iter->second;
+}
+
+// group top-level nodes (given in evaluation order) by level
+// Nodes that must not run concurrently are moved into waves of their own, right after the wave of their level.
+std::vector<std::vector<ComputationNodeBasePtr>> ComputationNetwork::GetConcurrentForwardWaves(const std::vector<ComputationNodeBasePtr>& nodes) const
+{
+    std::map<int, std::vector<ComputationNodeBasePtr>> nodesByLevel;
+    for (const auto& node : nodes)
+        nodesByLevel[GetConcurrentLevel(node)].push_back(node);
+
+    std::vector<std::vector<ComputationNodeBasePtr>> waves;
+    for (const auto& iter : nodesByLevel)
+    {
+        std::vector<ComputationNodeBasePtr> wave, exclusiveNodes;
+        for (const auto& node : iter.second)
+            (IsConcurrencySafe(node) ? wave : exclusiveNodes).push_back(node);
+        if (!wave.empty())
+            waves.push_back(move(wave));
+        for (const auto& node : exclusiveNodes)
+            waves.push_back({ node });
+    }
+    return waves;
+}
+
+// group top-level nodes (given in evaluation order) for backprop
+// A node runs in a later wave than all of its consumers, and than all nodes processed before it that share one of its inputs,
+// since those accumulate into the same gradient. Waves thus follow the reverse evaluation order wherever that matters.
+std::vector<std::vector<ComputationNodeBasePtr>> ComputationNetwork::GetConcurrentBackwardWaves(const std::vector<ComputationNodeBasePtr>& nodes) const
+{
+    std::map<ComputationNodeBasePtr, int> lastWaveUsing; // [node] -> last wave that has this node as an input
+    std::vector<std::vector<ComputationNodeBasePtr>> waves;
+    for (auto iter = nodes.rbegin(); iter != nodes.rend(); iter++)
+    {
+        const auto& unit = *iter;
+        auto inputs = GetInputsOfUnit(unit);
+        std::vector<ComputationNodeBasePtr> outputs{ unit };
+        if (unit->Is<FlowControlNode>())
+            outputs = unit->As<FlowControlNode>()->m_nestedNodes;
+
+        int wave = 0;
+        for (const auto& node : outputs)
+        {
+            auto used = lastWaveUsing.find(node);
+            if (used != lastWaveUsing.end())
+                wave = max(wave, used->second + 1);
+        }
+        for (const auto& input : inputs)
+        {
+            auto used = lastWaveUsing.find(input);
+            if (used != lastWaveUsing.end())
+                wave = max(wave, used->second + 1);
+        }
+        if (!IsConcurrencySafe(unit)) // a wave of its own
+        {
+            wave = (int)waves.size();
+            for (const auto& iter2 : lastWaveUsing)
+                wave = max(wave, iter2.second + 1);
+        }
+        else
+        {
+            // do not join a wave that holds a node that must run alone
+            while (wave < (int)waves.size() && waves[wave].size() == 1 && !IsConcurrencySafe(waves[wave].front()))
+                wave++;
+        }
+
+        if (wave >= (int)waves.size())
+            waves.resize(wave + 1);
+        waves[wave].push_back(unit);
+        for (const auto& input : inputs)
+            lastWaveUsing[input] = max(lastWaveUsing[input], wave);
+    }
+    waves.erase(std::remove_if(waves.begin(), waves.end(), [](const std::vector<ComputationNodeBasePtr>& wave) { return wave.empty(); }), waves.end());
+    return waves;
+}
+
+void ComputationNetwork::ForwardPropConcurrently(const std::vector<ComputationNodeBasePtr>& nodes)
+{
+    PARTraversalFlowControlNode::RunWaves(*m_concurrentTraversalThreadPool, GetConcurrentForwardWaves(nodes),
+                                          [](const ComputationNodeBasePtr& node) { PARTraversalFlowControlNode::ForwardProp(node, FrameRange(nullptr)); });
+}
+
 template<typename ElemType>
 bool TypedDumpNode(shared_ptr<ComputationNode<ElemType>> node, bool dumpGradient)
 {
@@ -1074,6 +1294,9 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
 
     VerifyIsCompiled("AllocateAllMatrices");
 
+    // with concurrent traversal, every traversal from here on follows the node levels
+    PlanConcurrentTraversal();
+
     std::vector<ComputationNodeBasePtr> forwardPropRoots;
     forwardPropRoots.insert(forwardPropRoots.end(), evalRootNodes.begin(), evalRootNodes.end());
     forwardPropRoots.insert(forwardPropRoots.end(), outValueRootNodes.begin(), outValueRootNodes.end());
@@ -1158,7 +1381,17 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
 
     m_matrixPool.Reset();
 
-    TravserseInSortedGlobalEvalOrder(forwardPropRoots, [&outputValueNeededDuringBackProp, &parentsMap, this](const ComputationNodeBasePtr& node) {
+    // with concurrent traversal, the nodes of one level share a step of the pool (the traversal is sorted by level)
+    int currentLevel = -1;
+    TravserseInSortedGlobalEvalOrder(forwardPropRoots, [&outputValueNeededDuringBackProp, &parentsMap, &currentLevel, this](const ComputationNodeBasePtr& node) {
+        if (IsConcurrentTraversalPlanned() && GetConcurrentLevel(node) != currentLevel)
+        {
+            if (currentLevel >= 0)
+                m_matrixPool.EndStepGroup();
+            m_matrixPool.BeginStepGroup();
+            currentLevel = GetConcurrentLevel(node);
+        }
+
         if (node->Is<SEQTraversalFlowControlNode>())
         {
             auto seqTraversalFlowControlNode = node->As<SEQTraversalFlowControlNode>();
@@ -1179,7 +1412,10 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
             ReleaseMatricesAfterEvalForChildren(node, parentsMap);
         }
     });
+    if (currentLevel >= 0)
+        m_matrixPool.EndStepGroup();
 
+    std::vector<std::vector<ComputationNodeBasePtr>> backwardWaves;
     if (trainRootNode != nullptr)
     {
         const std::list<ComputationNodeBasePtr>& backPropNodes = GetEvalOrder(trainRootNode);
@@ -1240,9 +1476,8 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         // we need to call it here since we always compute gradients for children and root node is not children of other node
         trainRootNode->RequestMatricesBeforeBackprop(m_matrixPool);
 
-        for (auto iter = backPropNodes.rbegin(); iter != backPropNodes.rend(); iter++) // for gradient computation, traverse in reverse order
+        auto allocateGradientMatrices = [&](const ComputationNodeBasePtr& n)
         {
-            auto n = *iter;
             if (n->IsPartOfLoop())
             {
                 std::vector<ComputationNodeBasePtr> recurrentNodes;
@@ -1265,12 +1500,41 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
                 if ((n != trainRootNode) && n->NeedsGradient())
                     n->ReleaseMatricesAfterBackprop(m_matrixPool);
             }
+        };
+
+        if (IsConcurrentTraversalPlanned())
+        {
+            // same order as PARTraversalFlowControlNode::Backprop(), one pool step per wave
+            backwardWaves = GetConcurrentBackwardWaves(GetNestedNetwork(trainRootNode)->As<FlowControlNode>()->m_nestedNodes);
+            for (const auto& wave : backwardWaves)
+            {
+                m_matrixPool.BeginStepGroup();
+                for (const auto& n : wave)
+                    allocateGradientMatrices(n->Is<SEQTraversalFlowControlNode>() ? n->As<SEQTraversalFlowControlNode>()->m_nestedNodes.front() : n);
+                m_matrixPool.EndStepGroup();
+            }
+        }
+        else
+        {
+            for (auto iter = backPropNodes.rbegin(); iter != backPropNodes.rend(); iter++) // for gradient computation, traverse in reverse order
+                allocateGradientMatrices(*iter);
         }
     }
 
     m_matrixPool.OptimizedMemoryAllocation(); 
     m_areMatricesAllocated = true;
 
+    // from now on, evaluate in the waves that the memory plan assumed
+    if (IsConcurrentTraversalPlanned())
+    {
+        for (auto& iter : m_nestedNetworks)
+        {
+            auto nestedNetwork = iter.second->As<PARTraversalFlowControlNode>();
+            nestedNetwork->SetConcurrentSchedule(m_concurrentTraversalThreadPool, GetConcurrentForwardWaves(nestedNetwork->As<FlowControlNode>()->m_nestedNodes),
+                                                 iter.first == trainRootNode ? move(backwardWaves) : std::vector<std::vector<ComputationNodeBasePtr>>());
+        }
+    }
+
     // TO DO: At the time of AllocateAllMatrices we don't know the minibatch size. In theory one may allocate memory again once we start to receive
     // data from the reader (and the minibatch size is known). For some problems, minibatch size can change constantly, and there needs to be a 
     // tradeoff in deciding how frequent to run optimized memory allocation. For now, we do it only once at the very beginning for speed concerns. 
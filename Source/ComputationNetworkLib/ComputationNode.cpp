@@ -9,9 +9,13 @@
 #include "InputAndParamNodes.h"
 #include "ComputationNetworkBuilder.h" // TODO: We should only pull in NewComputationNodeFromConfig(). Nodes should not know about network at large.
 #include "TensorShape.h"
+#include <cctype>
+#include <cmath>
+#include <cstdarg>
 
 #ifndef  CNTK_UWP
 #include "PerformanceProfiler.h"
+#include "MatrixQuantizerImpl.h"
 #ifdef _WIN32
 #define PERFORMANCE_PROFILER_LIB_NAME "Cntk.PerformanceProfiler-"##CNTK_COMPONENT_VERSION##".lib"
 #pragma comment(lib, PERFORMANCE_PROFILER_LIB_NAME)
@@ -777,10 +781,32 @@ template <class ElemType>
     }
 }
 
+#ifndef  CNTK_UWP
+// GPU kernels are launched asynchronously, so without waiting for the compute stream, a GPU node would be
+// charged with the launch overhead only, and the node that happens to wait for its results with its run time.
+static void SynchronizeForNodeTiming(DEVICEID_TYPE deviceId)
+{
+    if (deviceId == CPUDEVICE)
+        return;
+    // one event per device and thread (nodes may be timed concurrently), recorded anew for each wait;
+    // not freed, since the CUDA runtime may be shut down already when thread-local objects are destroyed
+    static thread_local std::map<DEVICEID_TYPE, MatrixComputeStreamEvent*> computeStreamEvents;
+    auto& computeStreamEvent = computeStreamEvents[deviceId];
+    if (!computeStreamEvent)
+        computeStreamEvent = MatrixComputeStreamEvent::Create(deviceId); // (records the event)
+    else
+        computeStreamEvent->Record();
+    computeStreamEvent->SynchronizeEvent();
+}
+#endif
+
 template <class ElemType>
 /*virtual*/ void ComputationNode<ElemType>::BeginTiming(bool backward)
 {
     if (!Globals::ShouldEnableNodeTiming()) return;
+#ifndef  CNTK_UWP
+    SynchronizeForNodeTiming(m_deviceId);
+#endif
 
     int phase = (backward ? (int)TimingPhase_Backward : (int)TimingPhase_Forward);
     auto& timing = m_timing[phase];
@@ -795,11 +821,25 @@ template <class ElemType>
 /*virtual*/ void ComputationNode<ElemType>::EndTiming(bool backward)
 {
     if (!Globals::ShouldEnableNodeTiming()) return;
+#ifndef  CNTK_UWP
+    SynchronizeForNodeTiming(m_deviceId);
+#endif
 
     int phase = (backward ? (int)TimingPhase_Backward : (int)TimingPhase_Forward);
     auto& timing = m_timing[phase];
     timing.duration += (std::chrono::system_clock::now() - timing.beginTime);
 
+    double flops, bytes;
+    EstimateCost(backward, flops, bytes);
+    if (IsPartOfLoop()) // inside a loop, we are called once per time step, while the estimate is for the whole minibatch
+    {
+        size_t numTimeSteps = GetNumTimeSteps();
+        flops /= numTimeSteps;
+        bytes /= numTimeSteps;
+    }
+    timing.flops += flops;
+    timing.bytes += bytes;
+
 #ifndef  CNTK_UWP
     // the order must match enum
     static const char* postfixes[TimingPhase_Total] =
@@ -810,7 +850,7 @@ template <class ElemType>
 
     if (timing.profilerName.length() != m_nodeName.length() + strlen(postfixes[phase]))
     {
-        static char name[256];
+        char name[256]; // (not static: nodes may be timed concurrently, see Globals::GetConcurrentTraversalThreads())
         sprintf_s(name, _countof(name), "%S%s", m_nodeName.c_str(), postfixes[phase]);
         timing.profilerName = name;
     }
@@ -838,6 +878,48 @@ void ComputationNode<ElemType>::PrintForwardBackwardTime()
         timing.Reset();
 }
 
+template <class ElemType>
+/*virtual*/ ComputationNodeBase::TimingStatistics ComputationNode<ElemType>::GetTimingStatistics(bool backward) const
+{
+    const auto& timing = m_timing[backward ? (int)TimingPhase_Backward : (int)TimingPhase_Forward];
+    TimingStatistics statistics;
+    statistics.count = timing.count;
+    statistics.seconds = timing.duration.count();
+    statistics.flops = timing.flops;
+    statistics.bytes = timing.bytes;
+    return statistics;
+}
+
+template <class ElemType>
+/*virtual*/ void ComputationNode<ElemType>::ResetTiming()
+{
+    for (auto& timing : m_timing)
+        timing.Reset();
+}
+
+template <class ElemType>
+/*virtual*/ void ComputationNode<ElemType>::EstimateCost(bool backward, double& flops, double& bytes) const
+{
+    double outputElements = (double)GetSampleMatrixNumRows() * GetSampleMatrixNumCols();
+    flops = 0;
+    bytes = backward ? 0 : outputElements * sizeof(ElemType);
+    for (const auto& input : GetInputs())
+    {
+        double inputElements = (double)input->GetSampleMatrixNumRows() * input->GetSampleMatrixNumCols();
+        if (!backward)
+        {
+            flops += outputElements;
+            bytes += inputElements * sizeof(ElemType);
+        }
+        else if (input->NeedsGradient())
+        {
+            // read the output gradient and the input value, and update the input gradient
+            flops += 2 * outputElements;
+            bytes += (outputElements + 3 * inputElements) * sizeof(ElemType);
+        }
+    }
+}
+
 template <class ElemType>
 /*virtual*/ void ComputationNode<ElemType>::DumpNodeInfo(const bool /*printValues*/, const bool printMetadata, File& fstream) const
 {
@@ -859,6 +941,113 @@ template <class ElemType>
     }
 }
 
+// append printf()-formatted text to a string
+static void AppendFormatted(string& out, const char* format, ...)
+{
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (len < 0)
+        RuntimeError("write: invalid format string '%s'", format);
+    if ((size_t)len < sizeof(buffer))
+    {
+        out.append(buffer, len);
+        return;
+    }
+    vector<char> largeBuffer(len + 1);
+    va_start(args, format);
+    vsnprintf(largeBuffer.data(), largeBuffer.size(), format, args);
+    va_end(args);
+    out.append(largeBuffer.data(), len);
+}
+
+// Formats values like sprintf() with the value formats produced by WriteFormattingOptions, i.e. "%f" or "%.<n>f" for
+// real numbers and "%u" for category indices, but without going through the C runtime for every single value, which
+// dominates the time of writing large outputs. The result is always identical to sprintf(): a real value is only
+// converted directly if the rounding of its last digit can be decided safely from its double product with 10^n;
+// values close to a rounding tie, huge values, NaN, INF, and all other formats are passed on to sprintf().
+class ValueFormatter
+{
+public:
+    ValueFormatter(const string& format) : m_format(format), m_kind(Kind::printf), m_precision(0)
+    {
+        if (format == "%u")
+            m_kind = Kind::unsignedInteger;
+        else if (format == "%f")
+        {
+            m_kind = Kind::fixed;
+            m_precision = 6;
+        }
+        else if (format.size() == 4 && format[0] == '%' && format[1] == '.' && isdigit((unsigned char)format[2]) && format[3] == 'f')
+        {
+            m_kind = Kind::fixed;
+            m_precision = format[2] - '0';
+        }
+    }
+
+    void AppendReal(string& out, double value) const
+    {
+        if (m_kind == Kind::fixed && AppendFixed(out, value))
+            return;
+        AppendFormatted(out, m_format.c_str(), value);
+    }
+
+    void AppendUnsigned(string& out, unsigned int value) const
+    {
+        if (m_kind == Kind::unsignedInteger)
+            AppendDigits(out, value, 0);
+        else
+            AppendFormatted(out, m_format.c_str(), value);
+    }
+
+private:
+    bool AppendFixed(string& out, double value) const
+    {
+        static const double powersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+        double scaled = fabs(value) * powersOf10[m_precision];
+        if (!(scaled < 4e15)) // NaN, INF, or too large for an exact integer part in a double
+            return false;
+        // 'scaled' is exact up to half an ulp, and so is the fraction computed from it. We can round to the last digit
+        // ourselves as long as the true fraction is on the same side of 1/2 for any error of that size.
+        double integer = floor(scaled);
+        double fraction = scaled - integer;
+        if (fabs(fraction - 0.5) <= scaled * 2.3e-16)
+            return false;
+        if (signbit(value))
+            out.push_back('-');
+        AppendDigits(out, (unsigned long long)integer + (fraction > 0.5 ? 1 : 0), m_precision);
+        return true;
+    }
+
+    // append 'digits' as a decimal number with the last 'precision' digits after the decimal point
+    static void AppendDigits(string& out, unsigned long long digits, size_t precision)
+    {
+        char buffer[32];
+        char* end = buffer + sizeof(buffer);
+        char* p = end;
+        for (size_t k = 0; k < precision; k++)
+        {
+            *--p = (char)('0' + digits % 10);
+            digits /= 10;
+        }
+        if (precision > 0)
+            *--p = '.';
+        do
+        {
+            *--p = (char)('0' + digits % 10);
+            digits /= 10;
+        } while (digits > 0);
+        out.append(p, end - p);
+    }
+
+    enum class Kind { printf, fixed, unsignedInteger };
+    string m_format;
+    Kind m_kind;
+    size_t m_precision;
+};
+
 // write out the content of a node in formatted/readable form
 // 'transpose' means print one row per sample (non-transposed is one column per sample).
 // 'isSparse' will print all non-zero values as one row (non-transposed, which makes sense for one-hot) or column (transposed).
@@ -874,28 +1063,46 @@ void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f,
                                                              bool onlyShowAbsSumForDense,
                                                              std::function<std::string(size_t)> getKeyById) const
 {
-    // get minibatch matrix -> matData, matRows, matStride
+    // get minibatch matrix -> matData, matRows, matCols
     const Matrix<ElemType>& outputValues = outputGradient ? Gradient() : Value();
-    let matRows   = outputValues.GetNumRows();
-    let matStride = matRows; // how to get from one column to the next
     unique_ptr<ElemType[]> matDataPtr(outputValues.CopyToArray());
-    ElemType* matData = matDataPtr.get();
-    let sampleLayout = GetSampleLayout(); // this is currently only used for sparse; dense tensors are linearized
+
+    string out;
+    FormatMinibatch(out, matDataPtr.get(), outputValues.GetNumRows(), outputValues.GetNumCols(), GetMBLayout(), GetSampleLayout(),
+                    fr, onlyUpToRow, onlyUpToT, transpose, isCategoryLabel, isSparse,
+                    labelMapping, sequenceSeparator, sequencePrologue, sequenceEpilogue, elementSeparator, sampleSeparator, valueFormatString,
+                    onlyShowAbsSumForDense, getKeyById);
+    if (!out.empty())
+        fwriteOrDie(out.data(), sizeof(char), out.size(), f);
+    fflushOrDie(f);
+}
+
+template <class ElemType>
+/*static*/ void ComputationNode<ElemType>::FormatMinibatch(string& out, ElemType* matData, size_t matRows, size_t matCols, const MBLayoutPtr& layout, const TensorShape& sampleLayout,
+                                                           const FrameRange& fr,
+                                                           size_t onlyUpToRow, size_t onlyUpToT, bool transpose, bool isCategoryLabel, bool isSparse,
+                                                           const vector<string>& labelMapping, const string& sequenceSeparator,
+                                                           const string& sequencePrologue, const string& sequenceEpilogue,
+                                                           const string& elementSeparator, const string& sampleSeparator,
+                                                           string valueFormatString,
+                                                           bool onlyShowAbsSumForDense,
+                                                           std::function<std::string(size_t)> getKeyById)
+{
+    let matStride = matRows; // how to get from one column to the next
 
     // process all sequences one by one
-    MBLayoutPtr pMBLayout = GetMBLayout();
+    MBLayoutPtr pMBLayout = layout;
     if (!pMBLayout) // no MBLayout: We are printing aggregates (or LearnableParameters?)
     {
         pMBLayout = make_shared<MBLayout>();
-        pMBLayout->Init(1, outputValues.GetNumCols()); // treat this as if we have one single sequence consisting of the columns
-        pMBLayout->AddSequence(0, 0, 0, outputValues.GetNumCols());
+        pMBLayout->Init(1, matCols); // treat this as if we have one single sequence consisting of the columns
+        pMBLayout->AddSequence(0, 0, 0, matCols);
     }
     let& sequences = pMBLayout->GetAllSequences();
     let  width     = pMBLayout->GetNumTimeSteps();
 
-    TensorShape tensorShape = GetSampleLayout();
     stringstream str;
-    let dims = tensorShape.GetDims();
+    let dims = sampleLayout.GetDims();
     for (auto dim : dims)
         str << dim << ' ';
     let shape = str.str(); // BUGBUG: change to string(tensorShape) to make sure we always use the same format
@@ -964,9 +1171,9 @@ void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f,
         }
 
         if (s > 0)
-            fprintfOrDie(f, "%s", sequenceSeparator.c_str());
+            out += sequenceSeparator;
 
-        fprintfOrDie(f, "%s", seqProl.c_str());
+        out += seqProl;
 
         // output it according to our format specification
         auto formatChar = valueFormatString.back();
@@ -974,10 +1181,10 @@ void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f,
         {
             if (formatChar == 's') // verify label dimension
             {
-                if (outputValues.GetNumRows() != labelMapping.size() &&
+                if (matRows != labelMapping.size() &&
                     sampleLayout[0] != labelMapping.size()) // if we match the first dim then use that
                 {
-                    static size_t warnings = 0;
+                    static atomic<size_t> warnings(0); // (atomic since we may be formatting on multiple threads)
                     if (warnings++ < 5)
                         fprintf(stderr, "write: Row dimension %d does not match number of entries %d in labelMappingFile, not using mapping\n", (int)seqRows, (int)labelMapping.size());
                     valueFormatString.back() = 'u'; // this is a fallback
@@ -1004,16 +1211,17 @@ void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f,
             seqRows = 1; // ignore remaining dimensions
         }
         // function to print a value
+        ValueFormatter formatter(valueFormatString);
         auto print = [&](double dval)
         {
             if (formatChar == 'f') // print as real number
             {
                 if (dval == 0) dval = fabs(dval);    // clear the sign of a negative 0, which are produced inconsistently between CPU and GPU
-                fprintfOrDie(f, valueFormatString.c_str(), dval);
+                formatter.AppendReal(out, dval);
             }
             else if (formatChar == 'u') // print category as integer index
             {
-                fprintfOrDie(f, valueFormatString.c_str(), (unsigned int)dval);
+                formatter.AppendUnsigned(out, (unsigned int)dval);
             }
             else if (formatChar == 's') // print category as a label string
             {
@@ -1021,8 +1229,10 @@ void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f,
                 if (!labelMapping.empty())
                     uval %= labelMapping.size();
                 assert(uval < labelMapping.size());
-                const char * sval = labelMapping[uval].c_str();
-                fprintfOrDie(f, valueFormatString.c_str(), sval);
+                if (valueFormatString == "%s")
+                    out += labelMapping[uval];
+                else
+                    AppendFormatted(out, valueFormatString.c_str(), labelMapping[uval].c_str());
             }
         };
         // bounds for printing
@@ -1045,21 +1255,21 @@ void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f,
                     if (dval == 0) // only print non-0 values
                         continue;
                     if (numPrinted++ > 0)
-                        fprintfOrDie(f, "%s", transpose ? sampleSeparator.c_str() : elementSeparator.c_str());
+                        out += transpose ? sampleSeparator : elementSeparator;
                     if (dval != 1.0 || formatChar != 'f') // hack: we assume that we are either one-hot or never precisely hitting 1.0
                         print(dval);
                     size_t row = transpose ? i : j;
                     size_t col = transpose ? j : i;
                     for (size_t k = 0; k < sampleLayout.size(); k++)
                     {
-                        fprintfOrDie(f, "%c%d", k == 0 ? '[' : ',', row % sampleLayout[k]);
+                        AppendFormatted(out, "%c%d", k == 0 ? '[' : ',', (int)(row % sampleLayout[k]));
                         if (sampleLayout[k] == labelMapping.size()) // annotate index with label if dimensions match (which may misfire once in a while)
-                            fprintfOrDie(f, "=%s", labelMapping[row % sampleLayout[k]].c_str());
+                            (out += '=') += labelMapping[row % sampleLayout[k]];
                         row /= sampleLayout[k];
                     }
                     if (seqInfo.GetNumTimeSteps() > 1)
-                        fprintfOrDie(f, ";%d", col);
-                    fprintfOrDie(f, "]");
+                        AppendFormatted(out, ";%d", (int)col);
+                    out += ']';
                 }
             }
         }
@@ -1080,34 +1290,34 @@ void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f,
                     }
                     absSum += absSumLocal;
                 }
-                fprintfOrDie(f, "absSum: %f", absSum);
+                AppendFormatted(out, "absSum: %f", absSum);
             }
             else
             {
                 for (size_t j = 0; j < jend; j++) // loop over output rows     --BUGBUG: row index is 'i'!! Rename these!!
                 {
                     if (j > 0)
-                        fprintfOrDie(f, "%s", sampleSep.c_str());
+                        out += sampleSep;
                     if (j == jstop && jstop < jend - 1) // if jstop == jend-1 we may as well just print the value instead of '...'
                     {
-                        fprintfOrDie(f, "...+%d", (int)(jend - jstop)); // 'nuff said
+                        AppendFormatted(out, "...+%d", (int)(jend - jstop)); // 'nuff said
                         break;
                     }
                     // inject sample tensor index if we are printing row-wise and it's a tensor
                     if (!transpose && sampleLayout.size() > 1 && !isCategoryLabel) // each row is a different sample dimension
                     {
                         for (size_t k = 0; k < sampleLayout.size(); k++)
-                            fprintfOrDie(f, "%c%d", k == 0 ? '[' : ',', (int)((j / sampleLayout.GetStrides()[k])) % sampleLayout[k]);
-                        fprintfOrDie(f, "]\t");
+                            AppendFormatted(out, "%c%d", k == 0 ? '[' : ',', (int)((j / sampleLayout.GetStrides()[k])) % sampleLayout[k]);
+                        out += "]\t";
                     }
                     // print a row of values
                     for (size_t i = 0; i < iend; i++) // loop over elements
                     {
                         if (i > 0)
-                            fprintfOrDie(f, "%s", elementSeparator.c_str());
+                            out += elementSeparator;
                         if (i == istop && istop < iend - 1)
                         {
-                            fprintfOrDie(f, "...+%d", (int)(iend - istop));
+                            AppendFormatted(out, "...+%d", (int)(iend - istop));
                             break;
                         }
                         double dval = seqData[i * istride + j * jstride];
@@ -1116,9 +1326,8 @@ void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f,
                 }
             }
         }
-        fprintfOrDie(f, "%s", sequenceEpilogue.c_str());
+        out += sequenceEpilogue;
     } // end loop over sequences
-    fflushOrDie(f);
 }
 
 /*static*/ string WriteFormattingOptions::Processed(const wstring& nodeName, string fragment, size_t minibatchId)
@@ -1209,6 +1418,9 @@ atomic_ullong TimeStamp::s_timeStampCounter = ATOMIC_VAR_INIT(0);
 template <> map<size_t, map<size_t, shared_ptr<SingleMatrix>>> ComputationNode<float>::s_constOnes{};
 template <> map<size_t, map<size_t, shared_ptr<DoubleMatrix>>> ComputationNode<double>::s_constOnes{};
 template <> map<size_t, map<size_t, shared_ptr<HalfMatrix>>> ComputationNode<half>::s_constOnes{};
+template <> mutex ComputationNode<float>::s_constOnesMutex{};
+template <> mutex ComputationNode<double>::s_constOnesMutex{};
+template <> mutex ComputationNode<half>::s_constOnesMutex{};
 
 // -----------------------------------------------------------------------
 // instantiate the core class templates
@@ -24,6 +24,8 @@
 #include <algorithm>
 #include <assert.h>
 #include <atomic>
+#include <functional>
+#include <mutex>
 
 #define DEFAULT_HIDDEN_ACTIVATION 0.1
 
@@ -372,6 +374,20 @@ public:
         // base class has nothing else to save
     }
 
+    // asynchronous checkpointing: SnapshotForSave() is called on the training thread and returns a CPU copy of the
+    // state that Save() would read from device memory or that training keeps changing, or nullptr if there is none.
+    // SaveSnapshot() then runs on a background thread and writes the same as Save(), but from 'valueSnapshot'.
+    // Nodes that persist their value or other mutable state override both.
+    virtual MatrixBasePtr SnapshotForSave()
+    {
+        return nullptr;
+    }
+
+    virtual void SaveSnapshot(File& fstream, const MatrixBasePtr& /*valueSnapshot*/) const
+    {
+        Save(fstream);
+    }
+
     std::wstring CreateUniqNodeName() const
     {
 #ifdef USE_GUID_AS_NAME
@@ -795,6 +811,25 @@ public:
     virtual void /*IComputationNode::*/ BeginTiming(bool) override {}
     virtual void /*IComputationNode::*/ EndTiming(bool) override {}
 
+    // statistics accumulated by BeginTiming()/EndTiming(), for ComputationNetwork::WriteNodeCostReport()
+    struct TimingStatistics
+    {
+        size_t count = 0;   // number of timed ForwardProp() or Backprop() calls
+        double seconds = 0; // total time of these calls
+        double flops = 0;   // estimated floating-point operations of these calls, see EstimateCost()
+        double bytes = 0;   // estimated bytes read and written by these calls
+    };
+    virtual TimingStatistics GetTimingStatistics(bool /*backward*/) const { return TimingStatistics(); }
+    virtual void ResetTiming() {}
+
+    // cost model: rough estimate of the floating-point operations and of the memory traffic (bytes read and written)
+    // of one ForwardProp() or Backprop() over the current minibatch
+    virtual void EstimateCost(bool /*backward*/, double& flops, double& bytes) const
+    {
+        flops = 0;
+        bytes = 0;
+    }
+
     // check whether a node is out of date w.r.t. its children, for lazy evaluation
     // If this returns true, node must be evaluated to update m_value.
     // This is virtual because it is overridden by traversal nodes, which would check all their nodes' inputs.
@@ -1313,6 +1348,14 @@ public:
         }
     }
 
+    // CPU copy of Value(), for SnapshotForSave() of nodes that persist their value
+    MatrixBasePtr ValueSnapshotOnCPU() const
+    {
+        auto copy = std::make_shared<Matrix<ElemType>>(Value().DeepClone());
+        copy->TransferToDeviceIfNotThere(CPUDEVICE, /*isBeingMoved=*/true);
+        return copy;
+    }
+
     // duplicate a node
     // Create a copy of a ComputationNode object. Inputs will be shared. Values (and gradients if applicable) are copied.
     ComputationNodeBasePtr Duplicate(const std::wstring& newName, const CopyNodeFlags flags) const override
@@ -1790,6 +1833,13 @@ public:
 
     virtual void /*IComputationNode::*/ EndTiming(bool) override;
 
+    virtual TimingStatistics GetTimingStatistics(bool backward) const override;
+    virtual void ResetTiming() override;
+
+    // The default cost model is that of an elementwise operation: one operation per output element and input,
+    // reading all inputs and writing the output once. Backprop reads the output gradient and updates the input gradients.
+    virtual void EstimateCost(bool backward, double& flops, double& bytes) const override;
+
     // this is the entry point from Network; while it will call virtual BackpropTo() into the actual node implementation
     // TODO: move to -Base (or -Network?)
     void Backprop(const FrameRange& fr, bool childrenInThisLoop, bool childrenInOuterLoop) override;
@@ -2003,6 +2053,17 @@ public:
                                       bool outputGradient = false, bool onlyShowAbsSumForDense = false,
                                       std::function<std::string(size_t)> getKeyById = std::function<std::string(size_t)>()) const;
 
+    // formatting part of WriteMinibatchWithFormatting(), appending to 'out' instead of writing to a file
+    // It only operates on a CPU copy of the data and therefore may run on any thread, while the network computes further.
+    // 'matData' is modified in place if 'isCategoryLabel'. A null 'pMBLayout' means all columns form a single sequence.
+    static void FormatMinibatch(std::string& out, ElemType* matData, size_t matRows, size_t matCols, const MBLayoutPtr& pMBLayout, const TensorShape& sampleLayout,
+                                const FrameRange& fr, size_t onlyUpToRow, size_t onlyUpToT, bool transpose, bool isCategoryLabel, bool isSparse,
+                                const std::vector<std::string>& labelMapping, const std::string& sequenceSeparator,
+                                const std::string& sequencePrologue, const std::string& sequenceEpilogue, const std::string& elementSeparator,
+                                const std::string& sampleSeparator, std::string valueFormatString,
+                                bool onlyShowAbsSumForDense = false,
+                                std::function<std::string(size_t)> getKeyById = std::function<std::string(size_t)>());
+
     // simple helper to log the content of a minibatch
     void DebugLogMinibatch(bool outputGradient = false) const
     {
@@ -2142,13 +2203,15 @@ public:
         }
     }
 
-    // NOTE: we should reimplement this to be thread-safe and use a larger than requested initialized memory block
+    // NOTE: we should reimplement this to use a larger than requested initialized memory block
     // we can then just wrap that memory block in a matrix of the correct dimensions since it will be const no one can change it
     // should only need one memory block per device
-    // Thread-safety could be achieved by changing this to a shared_ptr.
     // When using the TensorView interface, one could instead just use a 1x1 matrix with a view that broadcasts its columns (stride 0).
+    // The cache is locked since nodes may run concurrently (see Globals::GetConcurrentTraversalThreads()).
+    // Entries are never removed, so the returned reference stays valid after the lock is released.
     static const Matrix<ElemType>& ConstOnes(const size_t rows, const size_t cols, const DEVICEID_TYPE deviceId)
     {
+        std::lock_guard<std::mutex> lock(s_constOnesMutex);
         if (s_constOnes.find(rows) == s_constOnes.end() ||
             s_constOnes[rows].find(cols) == s_constOnes[rows].end()) // not found
         {
@@ -2172,6 +2235,7 @@ protected:
     shared_ptr<Matrix<ElemType>> m_value, m_gradient;
 
     static std::map<size_t, std::map<size_t, shared_ptr<Matrix<ElemType>>>> s_constOnes;
+    static std::mutex s_constOnesMutex;
 
     MatrixType m_preferredGradientMatrixType = UNDETERMINED;
 
@@ -2189,11 +2253,15 @@ protected:
         std::chrono::duration<float> duration = std::chrono::duration<float>(0);
         long long profilerId;
         std::string profilerName;
+        double flops = 0; // accumulated EstimateCost() of the timed calls
+        double bytes = 0;
 
         void Reset()
         {
             duration = std::chrono::duration<float>(0);
             count = 0;
+            flops = 0;
+            bytes = 0;
         }
     } m_timing[TimingPhase_Total];
 };
@@ -2350,6 +2418,17 @@ struct IRecurrentNode { virtual int GetRecurrenceSteppingDirection() const = 0;
 
 struct IFreezable { virtual void FreezeParameters() { } };
 
+// =======================================================================
+// ITrainingStateNode -- nodes that keep training state outside of their inputs,
+// e.g. running counts, which must be saved and restored along with the parameters
+// =======================================================================
+
+struct ITrainingStateNode
+{
+    virtual std::vector<size_t> GetTrainingState() const = 0;
+    virtual void SetTrainingState(const std::vector<size_t>& state) = 0;
+};
+
 // =======================================================================
 // PreComputedNodeBase -- interface implemented by ComputationNodes that precompute
 // TODO: We can use this interface in more places.
@@ -2364,6 +2443,50 @@ struct IPreComputeNode
     virtual void MarkComputed(const bool hasComputed) = 0;
 };
 
+// precompute nodes whose accumulators can be combined, so that the pass over the data can be split
+// (e.g. over MPI ranks) and the partial results merged before MarkComputed(true)
+// The state is the number of samples and the per-dimension mean and, if used, (biased) variance.
+struct IMergeablePreComputeNode
+{
+    virtual size_t GetAccumulatorState(std::vector<double>& mean, std::vector<double>& var) const = 0;
+    virtual void SetAccumulatorState(size_t numSamples, const std::vector<double>& mean, const std::vector<double>& var) = 0;
+
+    // Combines this worker's accumulators with those of all other workers; sumOverWorkers sums a vector
+    // element-wise over the workers and returns the result to all of them (e.g. MPI AllReduce).
+    // This is the pairwise mean/variance update of Chan et al., done in two reductions for numerical stability:
+    // first the overall mean, then each worker's variance around it, corrected by the distance of its own mean.
+    void MergeAccumulatorState(const std::function<void(std::vector<double>&)>& sumOverWorkers)
+    {
+        std::vector<double> mean, var;
+        size_t numSamples = GetAccumulatorState(mean, var);
+
+        std::vector<double> sums(mean.size() + 1); // [0] = #samples, then #samples * mean
+        sums[0] = (double)numSamples;
+        for (size_t i = 0; i < mean.size(); i++)
+            sums[i + 1] = numSamples * mean[i];
+        sumOverWorkers(sums);
+        double totalNumSamples = sums[0];
+        std::vector<double> totalMean(mean.size(), 0.0);
+        if (totalNumSamples > 0)
+            for (size_t i = 0; i < mean.size(); i++)
+                totalMean[i] = sums[i + 1] / totalNumSamples;
+
+        if (!var.empty())
+        {
+            for (size_t i = 0; i < var.size(); i++)
+            {
+                double delta = mean[i] - totalMean[i];
+                var[i] = numSamples * (var[i] + delta * delta);
+            }
+            sumOverWorkers(var);
+            for (size_t i = 0; i < var.size(); i++)
+                var[i] = totalNumSamples > 0 ? var[i] / totalNumSamples : 0;
+        }
+
+        SetAccumulatorState((size_t)totalNumSamples, totalMean, var);
+    }
+};
+
 // =======================================================================
 // helper macro to ease access to base members in presence of C++ two-phase name lookup
 // =======================================================================
@@ -171,6 +171,33 @@ public:
     PoolKind PoolingKind() const { return m_poolKind; }
     bool CeilOutDim() const { return m_ceilOutDim; }
     bool PoolIncludePad() const { return m_poolIncludePad; }
+    ImageLayoutKind ImageLayout() const { return m_imageLayout; }
+
+    // Each output element of a convolution takes a dot product over the kernel (which includes the input channels).
+    // Backprop computes one such product for the data gradient and one for the kernel gradient. Pooling reduces
+    // over the kernel window. For transposed convolution, the roles of input and output are swapped.
+    virtual void /*ComputationNode::*/ EstimateCost(bool backward, double& flops, double& bytes) const override
+    {
+        Base::EstimateCost(backward, flops, bytes);
+        const auto& data = InputRef(GetNumInputs() - 1);
+        double convolvedElements = m_transpose ? (double)data.GetSampleMatrixNumRows() * data.GetSampleMatrixNumCols()
+                                               : (double)GetSampleMatrixNumRows() * GetSampleMatrixNumCols();
+        double kernelElements = (double)m_kernelShape.GetNumElements();
+        if (m_poolKind != PoolKind::None)
+        {
+            flops = kernelElements * convolvedElements;
+            return;
+        }
+        size_t numProducts = 1;
+        if (backward)
+        {
+            numProducts = 0;
+            for (const auto& input : this->GetInputs())
+                if (input->NeedsGradient())
+                    numProducts++;
+        }
+        flops = 2 * kernelElements * convolvedElements * numProducts;
+    }
 
     // bottomlessly expand shape to filterRank, then expand to inputRank using defaults or given 'from' values
     template<class V, typename T>
@@ -466,13 +466,34 @@ void LearnableParameter<ElemType>::ReviseFromFile(const wstring& reviseFromFileP
 
 template <class ElemType>
 void LearnableParameter<ElemType>::Save(File& fstream) const /*override*/
+{
+    SaveWithValue(fstream, Value());
+}
+
+template <class ElemType>
+MatrixBasePtr LearnableParameter<ElemType>::SnapshotForSave() /*override*/
+{
+    return this->ValueSnapshotOnCPU();
+}
+
+template <class ElemType>
+void LearnableParameter<ElemType>::SaveSnapshot(File& fstream, const MatrixBasePtr& valueSnapshot) const /*override*/
+{
+    auto value = dynamic_pointer_cast<Matrix<ElemType>>(valueSnapshot);
+    if (!value)
+        LogicError("LearnableParameter: Value snapshot has the wrong element type.");
+    SaveWithValue(fstream, *value);
+}
+
+template <class ElemType>
+void LearnableParameter<ElemType>::SaveWithValue(File& fstream, const Matrix<ElemType>& value) const
 {
     if (!m_initString.empty())
         LogicError("LearnableParameter: Cannot Save() before deferred initialization has completed.");
     Base::Save(fstream);
     fstream << m_learningRateMultiplier;
     m_sampleLayout.Save(fstream);
-    fstream << Value();
+    fstream << value;
 }
 
 template <class ElemType>
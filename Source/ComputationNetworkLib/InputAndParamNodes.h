@@ -118,12 +118,17 @@ private:
     // deferred initialization
     void LazyInitParameters();
 
+    // shared by Save() and SaveSnapshot()
+    void SaveWithValue(File& fstream, const Matrix<ElemType>& value) const;
+
 public:
     // reload parameters from file
     // This is called from MEL.
     void ReviseFromFile(const std::wstring& reviseFromFilePath);
 
     virtual void Save(File& fstream) const override;
+    virtual MatrixBasePtr SnapshotForSave() override;
+    virtual void SaveSnapshot(File& fstream, const MatrixBasePtr& valueSnapshot) const override;
     virtual void Load(File& fstream, size_t modelVersion) override;
 
     virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override;
@@ -638,6 +638,22 @@ private:
     }
 
 public:
+    // a matrix product [M x K] * [K x N] takes 2*M*K*N operations, for the forward pass and for each input gradient
+    virtual void /*ComputationNode::*/ EstimateCost(bool backward, double& flops, double& bytes) const override
+    {
+        Base::EstimateCost(backward, flops, bytes);
+        size_t rowsOfProduct = 1; // M: the leading output dimensions, which come from the left operand
+        const auto& outputShape = this->GetSampleLayout();
+        for (size_t i = 0; i < m_outputRank && i < outputShape.GetRank(); i++)
+            rowsOfProduct *= outputShape[i];
+        double innerDim = (double)InputRef(0).GetSampleMatrixNumRows() / max<size_t>(rowsOfProduct, 1); // K
+        double outputElements = (double)this->GetSampleMatrixNumRows() * this->GetSampleMatrixNumCols(); // M*N
+        size_t numProducts = 1;
+        if (backward)
+            numProducts = (InputRef(0).NeedsGradient() ? 1 : 0) + (InputRef(1).NeedsGradient() ? 1 : 0);
+        flops = 2 * innerDim * outputElements * numProducts;
+    }
+
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
         // If argument A is minibatch data, then this must be performed frame-by-frame, sequence-by-sequence, one GEMM call each.
@@ -1241,6 +1257,196 @@ template class QuantizedTimesNode<float>;
 template class QuantizedTimesNode<double>;
 template class QuantizedTimesNode<half>;
 
+// -----------------------------------------------------------------------
+// FusedAffineNode (W, x, b, activation='None')
+// Fusion of Times (W, x), Plus (.., b) and an optional elementwise activation
+// (Sigmoid, Tanh or RectifiedLinear) into one node, as created by
+// ComputationNetwork::OptimizeForInference(). W is a [O x I] matrix, x is minibatch
+// data with I elements per sample, and b is a [O] vector.
+// The bias is broadcast into the output first, so that a single GEMM call with
+// beta=1 accumulates the product onto it; the activation is then applied in place.
+// This saves the intermediate buffers and the separate bias pass of the original nodes.
+// The gradients are those of the original nodes, so that an optimized network can
+// still be checked against (or fine-tuned like) the original one.
+// -----------------------------------------------------------------------
+
+enum class FusedActivationKind : int32_t
+{
+    None = 0,
+    Sigmoid = 1,
+    Tanh = 2,
+    RectifiedLinear = 3
+};
+
+static inline FusedActivationKind FusedActivationKindFrom(const wstring& s)
+{
+    if (s == L"" || EqualCI(s, L"None"))
+        return FusedActivationKind::None;
+    else if (EqualCI(s, L"Sigmoid"))
+        return FusedActivationKind::Sigmoid;
+    else if (EqualCI(s, L"Tanh"))
+        return FusedActivationKind::Tanh;
+    else if (EqualCI(s, L"RectifiedLinear") || EqualCI(s, L"ReLU"))
+        return FusedActivationKind::RectifiedLinear;
+    else
+        InvalidArgument("FusedActivationKindFrom: Unknown activation '%ls'. Must be None, Sigmoid, Tanh or RectifiedLinear.", s.c_str());
+}
+
+template <class ElemType>
+class FusedAffineNode : public ComputationNode<ElemType>, public NumInputs<3>
+{
+    typedef ComputationNode<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"FusedAffine"; }
+
+public:
+    FusedAffineNode(DEVICEID_TYPE deviceId, const wstring& name, FusedActivationKind activation = FusedActivationKind::None)
+        : Base(deviceId, name), m_activation(activation)
+    {
+    }
+    FusedAffineNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : FusedAffineNode(configp->Get(L"deviceId"), L"<placeholder>", FusedActivationKindFrom(configp->Get(L"activation")))
+    {
+        AttachInputsFromConfig(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<FusedAffineNode<ElemType>>(nodeP);
+            node->m_activation = m_activation;
+        }
+    }
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << (int32_t)m_activation;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        int32_t activation;
+        fstream >> activation;
+        m_activation = (FusedActivationKind)activation;
+    }
+
+    virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
+    {
+        size_t outDim = GetSampleLayout().GetNumElements();
+        size_t inDim  = InputRef(0).GetSampleLayout().GetNumElements() / outDim;
+
+        Matrix<ElemType> value  = ValueFor(fr);
+        Matrix<ElemType> input  = InputRef(1).ValueFor(fr);
+        Matrix<ElemType> weight = InputRef(0).Value().Reshaped(outDim, inDim);
+        Matrix<ElemType> bias   = InputRef(2).Value().Reshaped(outDim, 1);
+
+        value.AssignRepeatOf(bias, 1, value.GetNumCols());
+        Matrix<ElemType>::MultiplyAndAdd(weight, false, input, false, value); // value += W * x
+
+        switch (m_activation)
+        {
+        case FusedActivationKind::None:            break;
+        case FusedActivationKind::Sigmoid:         value.InplaceSigmoid(); break;
+        case FusedActivationKind::Tanh:            value.InplaceTanh(); break;
+        case FusedActivationKind::RectifiedLinear: value.InplaceTruncateBottom(0); break;
+        default: LogicError("%ls %ls operation: Unknown activation %d.", NodeName().c_str(), OperationName().c_str(), (int)m_activation);
+        }
+    }
+
+    virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
+    {
+        size_t outDim = GetSampleLayout().GetNumElements();
+        size_t inDim  = InputRef(0).GetSampleLayout().GetNumElements() / outDim;
+
+        if (inputIndex != 1) // W and b are reduced over the minibatch
+            MaskMissingGradientColumnsToZero(fr);
+
+        // gradient with respect to W * x + b; the activation derivatives are computed from the output
+        Matrix<ElemType> value    = ValueFor(fr);
+        Matrix<ElemType> gradient = GradientFor(fr);
+        auto& preActivationGradient = *m_preActivationGradient;
+        switch (m_activation)
+        {
+        case FusedActivationKind::None:            preActivationGradient.SetValue(gradient); break;
+        case FusedActivationKind::Sigmoid:         preActivationGradient.AssignSigmoidDerivativeOf(value); break;
+        case FusedActivationKind::Tanh:            preActivationGradient.AssignElementProductOf(value, value).AssignDifferenceOf((ElemType)1, preActivationGradient); break;
+        case FusedActivationKind::RectifiedLinear: preActivationGradient.AssignLinearRectifierDerivativeOf(value); break;
+        default: LogicError("%ls %ls operation: Unknown activation %d.", NodeName().c_str(), OperationName().c_str(), (int)m_activation);
+        }
+        if (m_activation != FusedActivationKind::None)
+            preActivationGradient.ElementMultiplyWith(gradient);
+
+        if (inputIndex == 0) // W += dz * x'
+        {
+            Input(1)->MaskMissingValueColumnsToZero(fr);
+            Matrix<ElemType> weightGradient = InputRef(0).Gradient().Reshaped(outDim, inDim);
+            Matrix<ElemType>::MultiplyAndAdd(preActivationGradient, false, InputRef(1).ValueFor(fr), true, weightGradient);
+        }
+        else if (inputIndex == 1) // x += W' * dz
+        {
+            Matrix<ElemType> inputGradient = InputRef(1).GradientFor(fr);
+            Matrix<ElemType>::MultiplyAndAdd(InputRef(0).Value().Reshaped(outDim, inDim), true, preActivationGradient, false, inputGradient);
+        }
+        else // b += row sums of dz
+        {
+            Matrix<ElemType> biasGradient = InputRef(2).Gradient().Reshaped(outDim, 1);
+            Matrix<ElemType>::MultiplyAndAdd(preActivationGradient, false, ConstOnes(preActivationGradient.GetNumCols(), 1, biasGradient.GetDeviceId()), false, biasGradient);
+        }
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return m_activation != FusedActivationKind::None; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t childIndex) const override { return childIndex != 2; }
+
+    // request matrices that are needed for gradient computation
+    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeBackprop(matrixPool);
+        RequestMatrixFromPool(m_preActivationGradient, matrixPool, GetSampleLayout().GetNumElements(), true);
+    }
+
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_preActivationGradient, matrixPool);
+    }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        InferMBLayoutFromInputsForStandardCase(isFinalValidationPass);
+
+        const auto& weightLayout = Input(0)->GetSampleLayout();
+        size_t outDim = weightLayout.GetRank() > 0 ? weightLayout[0] : 0;
+        if (isFinalValidationPass)
+        {
+            if (Input(0)->HasMBLayout() || Input(2)->HasMBLayout())
+                InvalidArgument("%ls %ls operation requires the weight and bias inputs to be parameters, not minibatch data.", NodeName().c_str(), OperationName().c_str());
+            if (outDim == 0 || weightLayout.GetNumElements() != outDim * Input(1)->GetSampleLayout().GetNumElements())
+                InvalidArgument("%ls %ls operation: The weight dimensions %s do not match the input dimensions %s.", NodeName().c_str(), OperationName().c_str(),
+                                string(weightLayout).c_str(), string(Input(1)->GetSampleLayout()).c_str());
+            if (Input(2)->GetSampleLayout().GetNumElements() != outDim)
+                InvalidArgument("%ls %ls operation: The bias dimensions %s do not match the output dimension %d.", NodeName().c_str(), OperationName().c_str(),
+                                string(Input(2)->GetSampleLayout()).c_str(), (int)outDim);
+        }
+
+        SetDims(TensorShape(outDim), HasMBLayout());
+    }
+
+    FusedActivationKind Activation() const { return m_activation; }
+
+private:
+    FusedActivationKind m_activation;
+    shared_ptr<Matrix<ElemType>> m_preActivationGradient; // temporary
+};
+
+template class FusedAffineNode<float>;
+template class FusedAffineNode<double>;
+template class FusedAffineNode<half>;
+
 // -----------------------------------------------------------------------
 // SumElementsNode (input)
 // Sums up all elements in the input across all samples into a single scalar.
@@ -1269,6 +1475,13 @@ public:
     {
     }
 
+    // one operation per input element, as for ReduceElementsNode
+    virtual void /*ComputationNode::*/ EstimateCost(bool backward, double& flops, double& bytes) const override
+    {
+        Base::EstimateCost(backward, flops, bytes);
+        flops = (!backward || InputRef(0).NeedsGradient()) ? (double)InputRef(0).GetSampleMatrixNumRows() * InputRef(0).GetSampleMatrixNumCols() : 0;
+    }
+
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         FrameRange fr(InputRef(0).GetMBLayout());
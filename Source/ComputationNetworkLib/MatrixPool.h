@@ -75,6 +75,7 @@ protected:
     vector<MemRequestInfo<half>> m_memRequestInfoHalfVec;
     set<DEVICEID_TYPE> m_deviceIDSet; 
     int m_stepCounter; 
+    bool m_inStepGroup;  // see BeginStepGroup()
 
     template <class ElemType>
     vector<MemRequestInfo<ElemType>>& GetMemRequestInfoVec();
@@ -97,9 +98,15 @@ protected:
 
 public:
 
+    MatrixPool()
+        : m_stepCounter(0), m_inStepGroup(false)
+    {
+    }
+
     void Reset()
     {
         m_stepCounter = 0;
+        m_inStepGroup = false;
         m_aliasGroups.clear();
         m_aliasLookup.clear();
     };
@@ -125,7 +132,27 @@ public:
         {
             memInfo->SetReleaseStep(m_stepCounter);
         }
-        m_stepCounter++; 
+        if (!m_inStepGroup)
+            m_stepCounter++; 
+    }
+
+    // All requests and releases between BeginStepGroup() and EndStepGroup() happen at the same step.
+    // This is used for a group of nodes that are executed concurrently (see Globals::GetConcurrentTraversalThreads()):
+    // since occupancies that touch the same step overlap, no two matrices used within the group share memory,
+    // while matrices released in one group can still be reused by later groups.
+    void BeginStepGroup()
+    {
+        if (m_inStepGroup)
+            LogicError("MatrixPool: Step groups cannot be nested.");
+        m_inStepGroup = true;
+    }
+
+    void EndStepGroup()
+    {
+        if (!m_inStepGroup)
+            LogicError("MatrixPool: EndStepGroup() without BeginStepGroup().");
+        m_inStepGroup = false;
+        m_stepCounter++;
     }
 
     // isWorkSpace is a flag indicating a memory is temporary and will be released very shortly. In the current implementation, all workspace
@@ -141,7 +168,8 @@ public:
         MemRequestInfo<ElemType> memInfo(deviceId, pMatrixPtr, matrixSize, mbScale, isWorkSpace, m_stepCounter);
         memInfoVec.push_back(memInfo); 
         m_deviceIDSet.insert(deviceId); 
-        m_stepCounter++; 
+        if (!m_inStepGroup)
+            m_stepCounter++; 
 
         // assign some temporary pointer, they will be replaced later unless the matrix is sparse
         *pMatrixPtr = make_shared<Matrix<ElemType>>(deviceId);
@@ -61,6 +61,21 @@ public:
         fstream << Value();
     }
 
+    virtual MatrixBasePtr SnapshotForSave() override
+    {
+        return this->ValueSnapshotOnCPU();
+    }
+
+    virtual void SaveSnapshot(File& fstream, const MatrixBasePtr& valueSnapshot) const override
+    {
+        auto value = dynamic_pointer_cast<Matrix<ElemType>>(valueSnapshot);
+        if (!value)
+            LogicError("PreComputedNode: Value snapshot has the wrong element type.");
+        Base::Save(fstream);
+        fstream << m_hasComputed;
+        fstream << *value;
+    }
+
     virtual void Load(File& fstream, size_t modelVersion) override
     {
         Base::Load(fstream, modelVersion);
@@ -115,6 +130,17 @@ public:
         SetDims(TensorShape(value.GetNumRows()), false);
     }
 
+    // restore the result of an earlier precomputation over the same data (SGD's preComputeCache)
+    // Unlike SideLoadFromMatrix(), this keeps the sample layout determined by validation.
+    void SetPreComputedValue(const Matrix<ElemType>& value)
+    {
+        if (value.GetNumCols() != 1 || value.GetNumRows() != GetSampleLayout().GetNumElements())
+            InvalidArgument("%ls %ls operation: Precomputed value has dimensions [%d x %d], expected [%d x 1].", NodeName().c_str(), OperationName().c_str(),
+                            (int)value.GetNumRows(), (int)value.GetNumCols(), (int)GetSampleLayout().GetNumElements());
+        m_value->SetValue(value);
+        m_hasComputed = true;
+    }
+
 public:
     bool m_hasComputed;
 };
@@ -129,7 +155,7 @@ public:
 // -----------------------------------------------------------------------
 
 template <class ElemType>
-class MeanInvStdDevNodeBase : public PreComputedNodeBase<ElemType>, public NumInputs<1>
+class MeanInvStdDevNodeBase : public PreComputedNodeBase<ElemType>, public NumInputs<1>, public IMergeablePreComputeNode
 {
     typedef PreComputedNodeBase<ElemType> Base; UsingPreComputedNodeMembers;
     // static const std::wstring TypeName() { return L"MeanInvStdDev (base)"; }
@@ -190,9 +216,50 @@ public:
         }
     }
 
+    // IMergeablePreComputeNode: the accumulators of a partial pass, as doubles for combining them
+    virtual size_t /*IMergeablePreComputeNode::*/ GetAccumulatorState(std::vector<double>& mean, std::vector<double>& var) const override
+    {
+        if (!IsAccumulating())
+            LogicError("%ls %ls operation: GetAccumulatorState() called while not accumulating.", NodeName().c_str(), OperationName().c_str());
+        CopyToVector(*MeanAccumulator(), mean);
+        var.clear();
+        if (VarAccumulator())
+            CopyToVector(*VarAccumulator(), var);
+        return m_numSamples;
+    }
+
+    virtual void /*IMergeablePreComputeNode::*/ SetAccumulatorState(size_t numSamples, const std::vector<double>& mean, const std::vector<double>& var) override
+    {
+        if (!IsAccumulating())
+            LogicError("%ls %ls operation: SetAccumulatorState() called while not accumulating.", NodeName().c_str(), OperationName().c_str());
+        CopyFromVector(mean, *MeanAccumulator());
+        if (VarAccumulator())
+            CopyFromVector(var, *VarAccumulator());
+        m_numSamples = numSamples;
+    }
+
 protected:
     size_t m_numSamples; // (SIZE_MAX while outside accumulation state)
     bool IsAccumulating() const { return m_numSamples != SIZE_MAX; }
+
+    // the running mean of the samples seen so far, and their running variance if the node needs it
+    virtual shared_ptr<Matrix<ElemType>> MeanAccumulator() const = 0;
+    virtual shared_ptr<Matrix<ElemType>> VarAccumulator() const { return nullptr; }
+
+private:
+    static void CopyToVector(const Matrix<ElemType>& from, std::vector<double>& to)
+    {
+        std::unique_ptr<ElemType[]> data(from.CopyToArray());
+        to.assign(data.get(), data.get() + from.GetNumElements());
+    }
+
+    void CopyFromVector(const std::vector<double>& from, Matrix<ElemType>& to) const
+    {
+        if (from.size() != to.GetNumElements())
+            LogicError("%ls %ls operation: Accumulator state has %d elements, expected %d.", NodeName().c_str(), OperationName().c_str(), (int)from.size(), (int)to.GetNumElements());
+        std::vector<ElemType> data(from.begin(), from.end());
+        to.SetValue(to.GetNumRows(), to.GetNumCols(), to.GetDeviceId(), data.data());
+    }
 };
 
 #define UsingMeanInvStdDevNodeBaseNodeMembers \
@@ -248,6 +315,9 @@ public:
 
         UpdateRunningAverage(InputRef(0), mean, m_numSamples);
     }
+
+protected:
+    virtual shared_ptr<Matrix<ElemType>> MeanAccumulator() const override { return m_value; } // mean is formed directly in our m_value
 };
 
 template class MeanNode<float>;
@@ -360,6 +430,10 @@ public:
         }
     }
 
+protected:
+    virtual shared_ptr<Matrix<ElemType>> MeanAccumulator() const override { return m_mean; }
+    virtual shared_ptr<Matrix<ElemType>> VarAccumulator()  const override { return m_var; }
+
 private:
     shared_ptr<Matrix<ElemType>> m_mean;
     shared_ptr<Matrix<ElemType>> m_var;
@@ -84,6 +84,15 @@ public:
     virtual bool InputUsedInComputingInputNodesGradients(size_t childIndex) const { return 0 == childIndex; }
     RnnAttributes Attributes() const { return m_rnnAttributes; }
 
+    // every weight (of all layers and directions) takes part in one multiply-add per frame;
+    // backprop does that once for the data gradient and once for the weight gradient
+    virtual void /*ComputationNode::*/ EstimateCost(bool backward, double& flops, double& bytes) const override
+    {
+        Base::EstimateCost(backward, flops, bytes);
+        size_t numProducts = !backward ? 1 : (InputRef(0).NeedsGradient() ? 1 : 0) + (InputRef(1).NeedsGradient() ? 1 : 0);
+        flops = 2 * (double)InputRef(0).GetSampleMatrixNumRows() * InputRef(1).GetSampleMatrixNumCols() * numProducts;
+    }
+
 protected:
     bool m_BackwardDataCalledYet;
     TensorShape shapeXT;
@@ -312,6 +312,13 @@ public:
     virtual bool /*ComputationNodeBase::*/ InputUsedInComputingInputNodesGradients(size_t childIndex) const override;
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override;
 
+    // a reduction takes one operation per input element; its backprop broadcasts the gradient back to all of them
+    virtual void /*ComputationNode::*/ EstimateCost(bool backward, double& flops, double& bytes) const override
+    {
+        Base::EstimateCost(backward, flops, bytes);
+        flops = (!backward || InputRef(0).NeedsGradient()) ? (double)InputRef(0).GetSampleMatrixNumRows() * InputRef(0).GetSampleMatrixNumCols() : 0;
+    }
+
     virtual ParentGradientOptimization ImplementsGradientOptimization(const ComputationNodeBase*) const override
     {
         switch (m_reductionOp)
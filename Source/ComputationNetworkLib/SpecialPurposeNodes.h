@@ -69,8 +69,6 @@ private:
     std::vector<std::string> m_labelMapping;
 };
 
-#ifdef COMING_SOON
-
 // -----------------------------------------------------------------------
 // GMMLogLikelihoodNode (unnormedPrior, means, logStdDevs, features) -- GMM log LL over input vector(s)
 // calculates the log likelihood of a feature given parameters of a Gaussian mixture model (GMM) with shared diagonal variance
@@ -79,6 +77,7 @@ private:
 //  - logStdDevs: std deviations, pooled across mix (i.e. same dim as features)
 // UnnormedPrior, means, and logStdDevs can be either a single column or one per sample, e.g.
 // when parameters are computed by other nodes.
+// On the CPU, shared parameters (single column) go through a fused kernel, see ForwardPropFused().
 // -----------------------------------------------------------------------
 
 template <class ElemType>
@@ -96,6 +95,9 @@ public:
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
+        if (m_fusedForward)
+            return BackpropToFused(inputIndex, fr);
+
         // get the right slice
         const size_t colsPrior = Input(0)->GetSampleMatrixNumCols();
 
@@ -131,12 +133,13 @@ public:
         case 2:
         {
             Matrix<ElemType> sliceNormedDeviation = DataFor(*m_normedDeviation, fr);
+            const size_t featureDim = Input(3)->GetSampleMatrixNumRows();
             if (colsPrior == 1)
-                BackpropToLogStddev(Input(2)->Gradient(), sliceGradientValue, sliceNormedDeviation, slicePosterior, *m_temp);
+                BackpropToLogStddev(Input(2)->Gradient(), sliceGradientValue, sliceNormedDeviation, slicePosterior, featureDim, *m_temp);
             else
             {
                 Matrix<ElemType> sliceLotStddevGradient = Input(2)->GradientFor(fr);
-                BackpropToLogStddev(sliceLotStddevGradient, sliceGradientValue, sliceNormedDeviation, slicePosterior, *m_temp);
+                BackpropToLogStddev(sliceLotStddevGradient, sliceGradientValue, sliceNormedDeviation, slicePosterior, featureDim, *m_temp);
             }
         }
         break;
@@ -153,7 +156,7 @@ public:
     }
 
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
-    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t childIndex) const override { return childIndex == 3; } // (the features, in the fused path)
 
     void BackpropToUnnormedPrior(Matrix<ElemType>& unnormedPriorGradientValues, const Matrix<ElemType>& gradientValues,
                                  const Matrix<ElemType>& prior, const Matrix<ElemType>& posterior, Matrix<ElemType>& temp)
@@ -195,12 +198,11 @@ public:
     }
 
     void BackpropToLogStddev(Matrix<ElemType>& logStddevGradientValues, const Matrix<ElemType>& gradientValues, const Matrix<ElemType>& normedDeviation,
-                             const Matrix<ElemType>& posterior, Matrix<ElemType>& temp)
+                             const Matrix<ElemType>& posterior, size_t featureDim, Matrix<ElemType>& temp)
     {
-        size_t numComponent = posterior.GetNumRows();
         size_t numSamples = posterior.GetNumCols();
 
-        temp.AssignDifferenceOf(normedDeviation, (ElemType) numComponent);
+        temp.AssignDifferenceOf(normedDeviation, (ElemType) featureDim); // d/dlogstddev of -||x-u_c||^2/(stddev^2)/2 - featureDim * log(stddev)
         temp.ElementMultiplyWith(posterior);
         temp.RowElementMultiplyWith(gradientValues);
         if (logStddevGradientValues.GetNumCols() == numSamples)
@@ -232,6 +234,86 @@ public:
             featureGradientValues.AddWithRowSliceValuesOf(temp, i * featureSize, featureSize);
     }
 
+    // Backprop of the fused path. With w_ct = gradient_t * posterior_ct, each gradient is a sum over the frames of w_ct times
+    // a term that depends on the frame through x_t only. These sums are formed with GEMMs against the features, so that the
+    // temporaries have the size of the posteriors or of the means, but not of normedDeviationVectors (#components * featureDim x #frames).
+    void BackpropToFused(const size_t inputIndex, const FrameRange& fr)
+    {
+        const size_t numComponents = Input(0)->GetSampleMatrixNumRows();
+        const size_t featureDim = Input(3)->GetSampleMatrixNumRows();
+
+        Matrix<ElemType> sliceGradientValue = DataFor(*m_gradient, fr);
+        Matrix<ElemType> slicePosterior = DataFor(*m_posterior, fr);
+        const size_t numSamples = slicePosterior.GetNumCols();
+        const DEVICEID_TYPE deviceId = slicePosterior.GetDeviceId();
+
+        if (inputIndex == 0)
+            return BackpropToUnnormedPrior(Input(0)->Gradient(), sliceGradientValue, *m_sharedPrior, slicePosterior, *m_temp);
+
+        Matrix<ElemType> sliceFeature = Input(3)->ValueFor(fr);
+        Matrix<ElemType>& weights = *m_temp;
+        weights.SetValue(slicePosterior);
+        weights.RowElementMultiplyWith(sliceGradientValue);
+
+        switch (inputIndex)
+        {
+        case 1:
+        {
+            // d/du_c = sum_t w_ct (x_t-u_c)/(stddev_c^2) = X * (w_c/stddev_c^2)^T - (sum_t w_ct) * scaledMean_c
+            Matrix<ElemType> meanGradient = Input(1)->Gradient().Reshaped(featureDim, numComponents);
+            Matrix<ElemType>::Multiply(ConstOnes(1, numSamples, deviceId), false, weights, true, *m_componentSums);
+            m_fusedTemp->SetValue(*m_scaledMeans);
+            m_fusedTemp->RowElementMultiplyWith(*m_componentSums);
+            meanGradient -= *m_fusedTemp;
+            weights.ColumnElementMultiplyWith(*m_precisions);
+            Matrix<ElemType>::MultiplyAndAdd(sliceFeature, false, weights, true, meanGradient);
+        }
+        break;
+        case 2:
+        {
+            // d/dlogstddev_c = sum_t w_ct (||x_t-u_c||^2/(stddev_c^2) - featureDim)
+            //                = sum_t w_ct ||x_t||^2/(stddev_c^2) - 2 scaledMean_c^T X w_c^T + (||u_c||^2/(stddev_c^2) - featureDim) sum_t w_ct
+            Matrix<ElemType>& logStddevGradient = Input(2)->Gradient();
+            m_frameSums->AssignVectorNorm2Of(sliceFeature, true);
+            *m_frameSums ^= 2;
+            Matrix<ElemType>::Multiply(weights, false, *m_frameSums, true, *m_componentSums);
+            m_componentSums->ElementMultiplyWith(*m_precisions);
+            logStddevGradient += *m_componentSums;
+
+            Matrix<ElemType>::Multiply(weights, false, ConstOnes(numSamples, 1, deviceId), false, *m_componentSums);
+            Matrix<ElemType>::ScaleAndAdd(-(ElemType) featureDim, *m_componentSums, logStddevGradient);
+            m_componentSums->ElementMultiplyWith(*m_scaledMeanNorms);
+            logStddevGradient += *m_componentSums;
+
+            Matrix<ElemType>::Multiply(sliceFeature, false, weights, true, *m_fusedTemp);
+            m_fusedTemp->ElementMultiplyWith(*m_scaledMeans);
+            Matrix<ElemType>::Multiply(*m_fusedTemp, true, ConstOnes(featureDim, 1, deviceId), false, *m_componentSums);
+            Matrix<ElemType>::ScaleAndAdd(-2, *m_componentSums, logStddevGradient);
+        }
+        break;
+        case 3:
+        {
+            // d/dx_t = sum_c w_ct (u_c-x_t)/(stddev_c^2) = scaledMeans * w_t - (sum_c w_ct/(stddev_c^2)) x_t
+            Matrix<ElemType> sliceFeatureGradient = Input(3)->GradientFor(fr);
+            Matrix<ElemType>::MultiplyAndAdd(*m_scaledMeans, false, weights, false, sliceFeatureGradient);
+            weights.ColumnElementMultiplyWith(*m_precisions);
+            Matrix<ElemType>::Multiply(ConstOnes(1, numComponents, deviceId), false, weights, false, *m_frameSums);
+            m_fusedTemp->SetValue(sliceFeature);
+            m_fusedTemp->RowElementMultiplyWith(*m_frameSums);
+            sliceFeatureGradient -= *m_fusedTemp;
+        }
+        break;
+        default:
+            InvalidArgument("GMMLogLikelihoodNode criterion only takes four inputs.");
+        }
+    }
+
+    // the fused kernel only exists on the CPU, and is only a win if all frames share the GMM parameters
+    bool CanUseFusedKernel() const
+    {
+        return m_deviceId == CPUDEVICE && !Input(0)->HasMBLayout() && Input(0)->GetSampleMatrixNumCols() == 1;
+    }
+
     virtual void UpdateFunctionMBSize() override
     {
         Base::UpdateFunctionMBSize();
@@ -241,16 +323,22 @@ public:
         size_t colsPrior = Input(0)->GetSampleMatrixNumCols(); // may be 1
         size_t featureSize = Input(3)->GetSampleMatrixNumRows();
 
+        m_posterior->Resize(numComponents, numCols);
+        if (CanUseFusedKernel())
+            return;
         m_prior->Resize(numComponents, colsPrior);
         m_stddev->Resize(numComponents, colsPrior);
         m_normedDeviation->Resize(numComponents, numCols);
         m_normedDeviationVectors->Resize(numComponents * featureSize, numCols);
-        m_posterior->Resize(numComponents, numCols);
     }
 
     // input0=unnormedPrior, input1=mean, input2=logstddev, input3=feature
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
+        m_fusedForward = CanUseFusedKernel();
+        if (m_fusedForward)
+            return ForwardPropFused(fr);
+
         size_t colsPrior = Input(0)->GetSampleMatrixNumCols();
         size_t numSamples = Input(3)->GetSampleMatrixNumCols();
 
@@ -282,6 +370,64 @@ public:
             RuntimeError("GMMLogLikelihoodNode: UnnormedPrior should either have same number of columns as the features or have only one column.");
     }
 
+    // Fused path: with ||x-u_c||^2/(stddev_c^2) = (||x||^2 - 2 u_c^T x + ||u_c||^2)/(stddev_c^2), the per-component log-likelihoods
+    // of all frames are one GEMM of the features with the precision-scaled means, plus per-component and per-frame terms.
+    // The parts that depend on the parameters only are cached, and recomputed only when one of the parameter inputs has
+    // been updated (SGD and the evaluation of input nodes bump their time stamps).
+    void ForwardPropFused(const FrameRange& fr)
+    {
+        UpdateParameterCache();
+
+        Matrix<ElemType> sliceOutputValue = ValueFor(fr);
+        Matrix<ElemType> slicePosterior = DataFor(*m_posterior, fr);
+        sliceOutputValue.AssignGMMLogLikelihood(Input(3)->ValueFor(fr), *m_scaledMeans, *m_precisions, *m_logNormalizers, slicePosterior);
+    }
+
+    void UpdateParameterCache()
+    {
+        bool isUpToDate = m_scaledMeans != nullptr;
+        for (size_t i = 0; i < 3; i++)
+            isUpToDate = isUpToDate && m_cachedParameterTimeStamps[i] == Input(i)->GetEvalTimeStamp();
+        if (isUpToDate)
+            return;
+
+        const size_t numComponents = Input(0)->GetSampleMatrixNumRows();
+        const size_t featureDim = Input(3)->GetSampleMatrixNumRows();
+        const Matrix<ElemType>& logStddev = Input(2)->Value();
+        CreateMatrixIfNull(m_scaledMeans);
+        CreateMatrixIfNull(m_precisions);
+        CreateMatrixIfNull(m_logNormalizers);
+        CreateMatrixIfNull(m_scaledMeanNorms);
+        CreateMatrixIfNull(m_sharedPrior);
+
+        // log prior, and the prior for the gradient of the unnormed prior
+        m_logNormalizers->AssignLogSoftmaxOf(Input(0)->Value(), true);
+        m_sharedPrior->AssignExpOf(*m_logNormalizers);
+
+        // precisions 1/stddev^2, and ||u_c||^2/(stddev^2)
+        m_precisions->AssignProductOf(-2, logStddev);
+        m_precisions->InplaceExp();
+        m_scaledMeans->SetValue(Input(1)->Value());
+        m_scaledMeans->Reshape(featureDim, numComponents); // each column is one mean
+        m_scaledMeanNorms->AssignVectorNorm2Of(*m_scaledMeans, true);
+        *m_scaledMeanNorms ^= 2;
+        m_scaledMeanNorms->Reshape(numComponents, 1);
+        m_scaledMeanNorms->ElementMultiplyWith(*m_precisions);
+
+        // scaledMeans <-- u_c/(stddev^2)
+        m_precisions->Reshape(1, numComponents);
+        m_scaledMeans->RowElementMultiplyWith(*m_precisions);
+        m_precisions->Reshape(numComponents, 1);
+
+        // logNormalizers <-- log prior - ||u_c||^2/(stddev^2)/2 - featureDim * log(stddev) - featureDim/2 * log(2 pi)
+        Matrix<ElemType>::ScaleAndAdd(-0.5f, *m_scaledMeanNorms, *m_logNormalizers);
+        Matrix<ElemType>::ScaleAndAdd(-(ElemType) featureDim, logStddev, *m_logNormalizers);
+        *m_logNormalizers -= (ElemType)(featureDim / 2.0 * log(TWO_PI));
+
+        for (size_t i = 0; i < 3; i++)
+            m_cachedParameterTimeStamps[i] = Input(i)->GetEvalTimeStamp();
+    }
+
     // input0=unnormedPrior, input1=mean, input2=logstddev, input3=feature
     // If we want to speed up we need to replace following code with a several specialized GPU functions
     /*TODO: merge with call site*/ void ForwardPropS(Matrix<ElemType>& functionValues, const Matrix<ElemType>& unnormedPrior, const Matrix<ElemType>& mean, Matrix<ElemType>& logstddev,
@@ -328,9 +474,9 @@ public:
         // compute per-component likelihood
         posterior.AssignProductOf(-0.5f, normedDeviation); // posterior  <-- -||x-u_c||^2/(stddev^2)/2 and in (1, numSamples* numComponent) dim
         temp.InplaceLog();
-        temp *= ((ElemType) numComponent / 2.0f);                   // temp <-- stddev^c and in (1, numSamples* numComponent) dim
-        posterior -= temp;                                          // posterior  <-- exp[-||x-u_c||^2/(stddev^2)/2]/(stddev^c)
-        posterior -= (ElemType)(numComponent / 2.0f * log(TWO_PI)); // likelihood for each component and sample is now computed and stored in posterior
+        temp *= ((ElemType) featureDim / 2.0f);                     // temp <-- log(stddev^d) and in (1, numSamples* numComponent) dim
+        posterior -= temp;                                          // posterior  <-- exp[-||x-u_c||^2/(stddev^2)/2]/(stddev^d)
+        posterior -= (ElemType)(featureDim / 2.0f * log(TWO_PI));   // likelihood for each component and sample is now computed and stored in posterior
         posterior.InplaceExp();                                     // posterior  <-- exp(-||x-u_c||^2/(stddev^2)/2)
 
         normedDeviation.Reshape(numComponent, numSamples); // reshape back
@@ -390,11 +536,11 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<GMMLogLikelihoodNode<ElemType>>(nodeP);
-            *node->m_prior = *m_prior;
-            *node->m_normedDeviation = *m_normedDeviation;
-            *node->m_normedDeviationVectors = *m_normedDeviationVectors;
-            *node->m_stddev = *m_stddev;
-            *node->m_posterior = *m_posterior;
+            node->m_prior->SetValue(*m_prior);
+            node->m_normedDeviation->SetValue(*m_normedDeviation);
+            node->m_normedDeviationVectors->SetValue(*m_normedDeviationVectors);
+            node->m_stddev->SetValue(*m_stddev);
+            node->m_posterior->SetValue(*m_posterior);
         }
     }
 
@@ -408,6 +554,9 @@ public:
         RequestMatrixFromPool(m_stddev, matrixPool);
         RequestMatrixFromPool(m_posterior, matrixPool);
         RequestMatrixFromPool(m_temp, matrixPool);
+        RequestMatrixFromPool(m_fusedTemp, matrixPool);
+        RequestMatrixFromPool(m_componentSums, matrixPool);
+        RequestMatrixFromPool(m_frameSums, matrixPool);
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
@@ -420,6 +569,9 @@ public:
         ReleaseMatrixToPool(m_stddev, matrixPool);
         ReleaseMatrixToPool(m_posterior, matrixPool);
         ReleaseMatrixToPool(m_temp, matrixPool);
+        ReleaseMatrixToPool(m_fusedTemp, matrixPool);
+        ReleaseMatrixToPool(m_componentSums, matrixPool);
+        ReleaseMatrixToPool(m_frameSums, matrixPool);
     }
 
 protected:
@@ -429,13 +581,24 @@ protected:
     shared_ptr<Matrix<ElemType>> m_stddev;
     shared_ptr<Matrix<ElemType>> m_posterior;
     shared_ptr<Matrix<ElemType>> m_temp;
+
+    // fused path
+    bool m_fusedForward = false;
+    shared_ptr<Matrix<ElemType>> m_fusedTemp;      // (featureDim x #components) or (featureDim x #frames)
+    shared_ptr<Matrix<ElemType>> m_componentSums;
+    shared_ptr<Matrix<ElemType>> m_frameSums;
+    // cached functions of the parameters, kept across minibatches, thus not from the matrix pool
+    shared_ptr<Matrix<ElemType>> m_scaledMeans;     // (featureDim x #components) u_c/(stddev^2)
+    shared_ptr<Matrix<ElemType>> m_precisions;      // 1/(stddev^2)
+    shared_ptr<Matrix<ElemType>> m_logNormalizers;  // all terms of the per-component log-likelihood that do not depend on the frame
+    shared_ptr<Matrix<ElemType>> m_scaledMeanNorms; // ||u_c||^2/(stddev^2)
+    shared_ptr<Matrix<ElemType>> m_sharedPrior;
+    uint64_t m_cachedParameterTimeStamps[3] = { 0, 0, 0 };
 };
 
 template class GMMLogLikelihoodNode<float>;
 template class GMMLogLikelihoodNode<double>;
 
-#endif
-
 // -----------------------------------------------------------------------
 // SequenceWithSoftmaxNode (label, prediction, loglikelihood)
 // word-lattice based sequence training criterion, using a Microsoft-proprietary lattice format
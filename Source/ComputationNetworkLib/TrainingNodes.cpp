@@ -100,20 +100,20 @@ void RandomSampleNodeBase<ElemType>::Load(File& fstream, size_t modelVersion)
 }
 
 template<class ElemType>
-void RandomSampleNodeBase<ElemType>::UpdateWeightsPrefixSum()
+void RandomSampleNodeBase<ElemType>::UpdateSampler()
 {
+    // Fetch the weights in one go (instead of element by element) and only rebuild the alias table
+    // if they changed, so that for fixed weights a minibatch costs O(sizeOfSampledSet) draws.
     const Matrix<ElemType>& samplingWeights = Input(0)->ValueAsMatrix();
-    m_samplingWeightsPrefixSum.clear();
-    double runningWeightsSum = 0;
-    for (int iClass = 0; iClass < samplingWeights.GetNumRows(); iClass++)
-    {
-        ElemType currentWeight = samplingWeights.GetValue(iClass, 0);
-        if (currentWeight < 0)
-            InvalidArgument("Sampling weights contain negative number %f.", (float)currentWeight);
+    std::vector<ElemType> buffer(samplingWeights.GetNumRows());
+    samplingWeights.CopySection(buffer.size(), 1, buffer.data(), buffer.size());
 
-        runningWeightsSum += (double)currentWeight;
-        m_samplingWeightsPrefixSum.push_back(runningWeightsSum);
-    }
+    std::vector<double> weights(buffer.begin(), buffer.end());
+    if (!m_sampler.IsEmpty() && weights == m_samplingWeights)
+        return;
+
+    m_sampler.Build(weights);
+    m_samplingWeights = std::move(weights);
 }
 
 // Runs the sampling returning a vector with the id's of the samples. The parameter nTries is used to return the number of draws that was needed
@@ -121,7 +121,6 @@ void RandomSampleNodeBase<ElemType>::UpdateWeightsPrefixSum()
 template<class ElemType>
 const std::vector<size_t> RandomSampleNodeBase<ElemType>::RunSampling(size_t& nTries)
 {
-    boost::random::uniform_real_distribution<double> r(0, m_samplingWeightsPrefixSum.back());
     std::unordered_set<int> alreadySampled;
     std::vector<size_t> samples;
     CPURNGHandle* cpuRNGHandle = dynamic_cast<CPURNGHandle*>(&GetRNGHandle(CPUDEVICE));
@@ -135,11 +134,8 @@ const std::vector<size_t> RandomSampleNodeBase<ElemType>::RunSampling(size_t& nT
     auto offset = GetRngOffset();
     while (samples.size() < m_sizeOfSampledSet)
     {
-        double randomValue = r(cpuRNGHandle->Generator());
+        int idx = (int)m_sampler.Sample(cpuRNGHandle->Generator());
         offset++;
-        // Find the first index where value[idx] >= randomValue.
-        auto lower = std::lower_bound(m_samplingWeightsPrefixSum.begin(), m_samplingWeightsPrefixSum.end(), randomValue);
-        int idx = (int)(lower - m_samplingWeightsPrefixSum.begin());
 
         if (m_allowDuplicates)
             samples.push_back(idx);
@@ -168,7 +164,7 @@ const std::vector<size_t> RandomSampleNodeBase<ElemType>::RunSampling(size_t& nT
 template<class ElemType>
 void RandomSampleNode<ElemType>::ForwardPropNonLooping()
 {
-    Base::UpdateWeightsPrefixSum();
+    Base::UpdateSampler();
 
     if (ValueAsMatrix().GetMatrixType() != SPARSE)
     {
@@ -268,22 +264,21 @@ double RandomSampleInclusionFrequencyNode<ElemType>::EstimateInSampleFrequency(d
 template<class ElemType>
 void RandomSampleInclusionFrequencyNode<ElemType>::ForwardPropNonLooping()
 {
-    Base::UpdateWeightsPrefixSum();
+    Base::UpdateSampler();
     Matrix<ElemType>& valueMatrix = ValueAsMatrix();
     valueMatrix.TransferToDeviceIfNotThere(CPUDEVICE, /*ismoved =*/ true/*means: BOTH state not ok */, /*emptyTransfer =*/ true, /*updatePreferredDevice =*/ false);
     valueMatrix.SetDevice(CPUDEVICE);
 
     // BUGBUG: matrix type should be configured during validation
     valueMatrix.SwitchToMatrixType(DENSE, matrixFormatDense, false);
-    double sumOfWeights = Base::m_samplingWeightsPrefixSum.back();
-    const Matrix<ElemType>& samplingWeights = Input(0)->ValueAsMatrix();
+    double sumOfWeights = Base::m_sampler.TotalWeight();
 
     double estimatedNumTries = EstimateNumberOfTries();
 
-    for (int i = 0; i < Base::m_samplingWeightsPrefixSum.size(); i++)
+    for (int i = 0; i < Base::m_samplingWeights.size(); i++)
     {
         // Get the sampling probablility for from the weights for i-th class.
-        double samplingProb = samplingWeights.GetValue(i, 0) / sumOfWeights;
+        double samplingProb = Base::m_samplingWeights[i] / sumOfWeights;
         double estimatedCount = EstimateInSampleFrequency(samplingProb, estimatedNumTries);
         valueMatrix.SetValue(i, 0, (ElemType)estimatedCount);
     }
@@ -10,6 +10,7 @@
 #include "RNGHandle.h"
 #include "InputAndParamNodes.h"
 #include "CPURNGHandle.h"
+#include "AliasSampler.h"
 
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
@@ -114,6 +115,8 @@ template class SquareErrorNode<double>;
 // -----------------------------------------------------------------------
 // CrossEntropyWithSoftmaxNode (labels, prediction)
 // calculates: -sum(left_i * log(softmax_i(right)))
+// On the CPU, ForwardProp only keeps the log-sum-exp of each column, and the softmax is recomputed from it in the
+// same pass that accumulates the gradient, so that neither softmax nor log-softmax is materialized for large outputs.
 // -----------------------------------------------------------------------
 
 template <class ElemType>
@@ -141,6 +144,11 @@ public:
             InputRef(0).GradientFor(fr).Print("CrossEntropyWithSoftmaxNode Partial-Left-in");
 #endif
 
+            if (UseFusedKernel()) // (labels rarely need a gradient, so we did not keep the log-softmax)
+            {
+                m_logSoftmaxOfRight->AssignLogSoftmaxOf(InputRef(1).ValueFor(fr), true);
+                MaskMissingColumnsToZero(*m_logSoftmaxOfRight, InputRef(1).GetMBLayout(), fr);
+            }
             auto gradient = InputRef(0).GradientFor(fr);
             Matrix<ElemType>::Multiply1x1AndWeightedAdd(-1.0f, Gradient() /*1x1*/, *m_logSoftmaxOfRight, 1.0f, gradient);
 #if DUMPOUTPUT
@@ -158,7 +166,10 @@ public:
 #endif
 
             auto gradient = InputRef(1).GradientFor(fr);
-            Matrix<ElemType>::AddScaledDifference(Gradient(), *m_softmaxOfRight, InputRef(0).ValueFor(fr), gradient);
+            if (UseFusedKernel())
+                Matrix<ElemType>::AddSoftmaxCrossEntropyGradient(Gradient(), InputRef(1).ValueFor(fr), *m_logSumExpOfRight, InputRef(0).ValueFor(fr), gradient);
+            else
+                Matrix<ElemType>::AddScaledDifference(Gradient(), *m_softmaxOfRight, InputRef(0).ValueFor(fr), gradient);
 #if DUMPOUTPUT
             InputRef(1).GradientFor(fr).Print("CrossEntropyWithSoftmaxNode Partial-Right");
 #endif
@@ -173,8 +184,18 @@ public:
         return false;
     }
 
+    bool UseFusedKernel() const
+    {
+        return m_deviceId == CPUDEVICE;
+    }
+
     virtual void UpdateFunctionMBSize() override
     {
+        if (UseFusedKernel())
+        {
+            m_logSumExpOfRight->Resize(1, Input(1)->Value().GetNumCols());
+            return;
+        }
         m_logSoftmaxOfRight->Resize(Input(1)->Value());
         m_softmaxOfRight->Resize(*m_logSoftmaxOfRight);
     }
@@ -182,6 +203,15 @@ public:
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override // -sum(left_i * log(softmax_i(right)))
     {
         FrameRange fr(InputRef(0).GetMBLayout());
+        if (UseFusedKernel())
+        {
+            // gaps have zero labels, which the kernel skips, so they contribute nothing
+            Value().AssignSoftmaxCrossEntropyOf(InputRef(0).MaskedValueFor(fr), InputRef(1).ValueFor(fr), *m_logSumExpOfRight);
+#if NANCHECK
+            Value().HasNan("CrossEntropyWithSoftmax");
+#endif
+            return;
+        }
         // first compute the softmax (column-wise)
         // Note that we need both log and non-log for gradient computation.
         m_logSoftmaxOfRight->AssignLogSoftmaxOf(InputRef(1).ValueFor(fr), true);
@@ -214,6 +244,7 @@ public:
             auto node = dynamic_pointer_cast<CrossEntropyWithSoftmaxNode<ElemType>>(nodeP);
             node->m_logSoftmaxOfRight->SetValue(*m_logSoftmaxOfRight);
             node->m_softmaxOfRight->SetValue(*m_softmaxOfRight);
+            node->m_logSumExpOfRight->SetValue(*m_logSumExpOfRight);
         }
     }
 
@@ -223,6 +254,7 @@ public:
         Base::RequestMatricesBeforeForwardProp(matrixPool);
         RequestMatrixFromPool(m_logSoftmaxOfRight, matrixPool);
         RequestMatrixFromPool(m_softmaxOfRight, matrixPool);
+        RequestMatrixFromPool(m_logSumExpOfRight, matrixPool);
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
@@ -231,11 +263,13 @@ public:
         Base::ReleaseMatricesAfterBackprop(matrixPool);
         ReleaseMatrixToPool(m_logSoftmaxOfRight, matrixPool);
         ReleaseMatrixToPool(m_softmaxOfRight, matrixPool);
+        ReleaseMatrixToPool(m_logSumExpOfRight, matrixPool);
     }
 
 protected:
-    shared_ptr<Matrix<ElemType>> m_logSoftmaxOfRight;
-    shared_ptr<Matrix<ElemType>> m_softmaxOfRight;
+    shared_ptr<Matrix<ElemType>> m_logSoftmaxOfRight; // (CPU: only for the gradient of the labels)
+    shared_ptr<Matrix<ElemType>> m_softmaxOfRight;    // (not used on the CPU)
+    shared_ptr<Matrix<ElemType>> m_logSumExpOfRight;  // (1 x #columns, CPU only)
 };
 
 template class CrossEntropyWithSoftmaxNode<float>;
@@ -1357,7 +1391,8 @@ public:
 
 protected:
 
-    void UpdateWeightsPrefixSum();
+    // Fetches the sampling weights and rebuilds the alias table if they changed.
+    void UpdateSampler();
 
     // Runs the sampling returning a vector with the id's of the samples. The parameter nTries is used to return the number of draws that was needed
     // to get the expected number of samples.
@@ -1375,7 +1410,8 @@ public:
 protected:
     bool m_allowDuplicates; // The node can create samples allowing for duplicates (sampling with replacement) or not (sampling without replacement).
     size_t m_sizeOfSampledSet; // Requested size of sample in case of run-mode = CREATE_SAMPLES.
-    std::vector<double> m_samplingWeightsPrefixSum;
+    std::vector<double> m_samplingWeights; // the weights the sampler was built from
+    AliasSampler m_sampler;
 };
 
 // ------------------------------------------------------------------------------------------------------------------------------------------------
@@ -1635,40 +1671,69 @@ public:
 
         // accumulate objective
         functionValues.SetValue(0);
-        ForColumnsWithClass([&](size_t s, size_t t, const FrameRange& fr, size_t y_t, size_t c_t, size_t sz, size_t lft_bnd, size_t nbr_wrd)
+        if (m_softMax.GetDeviceId() == CPUDEVICE && InputRef(INPUTDATA).Value().GetMatrixType() == DENSE && InputRef(EMBEDDINGMATRIX).Value().GetMatrixType() == DENSE)
         {
-            // now get views of various arrays that correspond to the index range of words belonging to this class
+            // CPU: score all class members of all frames in a single fused gather-GEMM-logsumexp call
+            // instead of issuing one small GEMM and softmax per frame
+            const size_t nS = Input(LABELDATA)->GetNumParallelSequences();
+            m_hiddenColumns.clear();
+            m_candidates.clear();
+            m_candidateOffsets.assign(1, 0);
+            ForColumnsWithClass([&](size_t s, size_t t, const FrameRange& /*fr*/, size_t /*y_t*/, size_t /*c_t*/, size_t /*sz*/, size_t lft_bnd, size_t nbr_wrd)
+            {
+                m_hiddenColumns.push_back(t * nS + s);
+                for (size_t i = 0; i < nbr_wrd; i++)
+                    m_candidates.push_back(lft_bnd + i);
+                m_candidateOffsets.push_back(m_candidates.size());
+            });
+            m_logSoftmax.AssignSampledLogSoftmax(InputRef(INPUTDATA).Value(), m_hiddenColumns, InputRef(EMBEDDINGMATRIX).ValueAsMatrix(), m_candidates, m_candidateOffsets);
+            m_softMax.AssignExpOf(m_logSoftmax);
 
-            // get hidden vectors for the words in this class
-            Matrix<ElemType> weightForClass = InputRef(EMBEDDINGMATRIX).ValueAsMatrix().ColumnSlice(lft_bnd, nbr_wrd); // [hdSize x nbr_wrd]
+            double objective = 0;
+            ForColumnsWithClass([&](size_t /*s*/, size_t /*t*/, const FrameRange& fr, size_t y_t, size_t c_t, size_t sz, size_t lft_bnd, size_t /*nbr_wrd*/)
+            {
+                auto clsLogSoftmax_t = InputRef(CLASSPROBINDATA).DataFor(m_clsLogSoftmax, fr);
+                objective += (double)m_logSoftmax(0, sz + y_t - lft_bnd) + (double)clsLogSoftmax_t(c_t, 0);
+            });
+            functionValues.SetValue((ElemType)objective);
+        }
+        else
+        {
+            ForColumnsWithClass([&](size_t s, size_t t, const FrameRange& fr, size_t y_t, size_t c_t, size_t sz, size_t lft_bnd, size_t nbr_wrd)
+            {
+                // now get views of various arrays that correspond to the index range of words belonging to this class
 
-            // buffer to hold the class-conditional distribution
-            Matrix<ElemType> softMax_t = m_softMax.ColumnSlice(sz, nbr_wrd); // TODO: declare these outside of the loop to avoid the malloc
-            Matrix<ElemType> logSoftMax_t = m_logSoftmax.ColumnSlice(sz, nbr_wrd);
+                // get hidden vectors for the words in this class
+                Matrix<ElemType> weightForClass = InputRef(EMBEDDINGMATRIX).ValueAsMatrix().ColumnSlice(lft_bnd, nbr_wrd); // [hdSize x nbr_wrd]
 
-            Matrix<ElemType> obs = InputRef(INPUTDATA).ValueFor(fr); // hidden activation vector for current word token
+                // buffer to hold the class-conditional distribution
+                Matrix<ElemType> softMax_t = m_softMax.ColumnSlice(sz, nbr_wrd); // TODO: declare these outside of the loop to avoid the malloc
+                Matrix<ElemType> logSoftMax_t = m_logSoftmax.ColumnSlice(sz, nbr_wrd);
 
-            // multiply hidden activation with weight matrix (the slice of the weight matrix for the range of class members)
-            // TODO: can we use 'true' here instead? Above transposition hack won't work with row slices. 'obs' not used elsewhere
-            obs.Reshape(1, hdSize);                                                                                // transpose it (make it a column vector)
-            logSoftMax_t.AssignProductOf(obs /*(1 x hdSize)*/, false, weightForClass /*hdSize x nbr_wrd*/, false); // -> 1 x nbr_word
+                Matrix<ElemType> obs = InputRef(INPUTDATA).ValueFor(fr); // hidden activation vector for current word token
 
-            // log softmax(W x_t)
-            logSoftMax_t.InplaceLogSoftmax(false);
+                // multiply hidden activation with weight matrix (the slice of the weight matrix for the range of class members)
+                // TODO: can we use 'true' here instead? Above transposition hack won't work with row slices. 'obs' not used elsewhere
+                obs.Reshape(1, hdSize);                                                                                // transpose it (make it a column vector)
+                logSoftMax_t.AssignProductOf(obs /*(1 x hdSize)*/, false, weightForClass /*hdSize x nbr_wrd*/, false); // -> 1 x nbr_word
 
-            // and non-log version
-            softMax_t.SetValue(logSoftMax_t);
-            softMax_t.InplaceExp();
-            // we now have a column vector of class-conditional probabilities over the class members
+                // log softmax(W x_t)
+                logSoftMax_t.InplaceLogSoftmax(false);
 
-            // add  the word's class-conditional log posterior
-            size_t idx_in_class = y_t - lft_bnd;
-            Matrix<ElemType>::AddElementToElement(logSoftMax_t, 0, idx_in_class, functionValues, 0, 0); // (1x1)
+                // and non-log version
+                softMax_t.SetValue(logSoftMax_t);
+                softMax_t.InplaceExp();
+                // we now have a column vector of class-conditional probabilities over the class members
 
-            // add the class log posterior probability (for backprop)
-            auto clsLogSoftmax_t = InputRef(CLASSPROBINDATA).DataFor(m_clsLogSoftmax, fr);
-            Matrix<ElemType>::AddElementToElement(clsLogSoftmax_t, c_t, 0, functionValues, 0, 0); // (1x1)
-        });
+                // add  the word's class-conditional log posterior
+                size_t idx_in_class = y_t - lft_bnd;
+                Matrix<ElemType>::AddElementToElement(logSoftMax_t, 0, idx_in_class, functionValues, 0, 0); // (1x1)
+
+                // add the class log posterior probability (for backprop)
+                auto clsLogSoftmax_t = InputRef(CLASSPROBINDATA).DataFor(m_clsLogSoftmax, fr);
+                Matrix<ElemType>::AddElementToElement(clsLogSoftmax_t, c_t, 0, functionValues, 0, 0); // (1x1)
+            });
+        }
 
         functionValues *= (-1);
 
@@ -1711,6 +1776,11 @@ protected:
     Matrix<ElemType> m_grdToSoftMaxInput;
     bool m_needRecomputeGradientToSoftmaxInput;
 
+    // segment description for the fused CPU forward pass (see AssignSampledLogSoftmax())
+    std::vector<size_t> m_hiddenColumns;
+    std::vector<size_t> m_candidates;
+    std::vector<size_t> m_candidateOffsets;
+
     size_t m_nbrCls;
     size_t m_totalNbrWords;
 };
@@ -2388,7 +2458,7 @@ private:
 // * imageLayout is the image layout. Only cudnn is supported at present.
 // -----------------------------------------------------------------------
 template <class ElemType>
-class BatchNormalizationNode : public ComputationNodeNonLooping<ElemType>, public IFreezable,
+class BatchNormalizationNode : public ComputationNodeNonLooping<ElemType>, public IFreezable, public ITrainingStateNode,
     public IdentityTransformerNodeOnOneInput<0>
 {
     typedef ComputationNodeNonLooping<ElemType> Base; UsingComputationNodeMembersBoilerplate;
@@ -2428,6 +2498,28 @@ public:
     }
 
     void Save(File& fstream) const override
+    {
+        SaveWithRunCount(fstream, RunCount()); // (RunCount() caches m_runCountUntied, so that someone who inspects the file sees something meaningful (as an FYI))
+    }
+
+    // asynchronous checkpointing: the run count lives in a shared Parameter, possibly on the GPU, and changes with every minibatch
+    MatrixBasePtr SnapshotForSave() override
+    {
+        auto runCount = make_shared<Matrix<double>>(1, 1, CPUDEVICE);
+        runCount->SetValue((double)RunCount());
+        return runCount;
+    }
+
+    void SaveSnapshot(File& fstream, const MatrixBasePtr& runCountSnapshot) const override
+    {
+        auto runCount = dynamic_pointer_cast<Matrix<double>>(runCountSnapshot);
+        if (!runCount)
+            LogicError("%ls: Run count snapshot has the wrong type.", NodeDescription().c_str());
+        SaveWithRunCount(fstream, (size_t)runCount->Get00Element());
+    }
+
+private:
+    void SaveWithRunCount(File& fstream, size_t runCount) const
     {
         Base::Save(fstream);
 
@@ -2435,16 +2527,17 @@ public:
         fstream << m_normTimeConst;
         fstream << m_blendTimeConst;
         fstream << (int32_t)m_imageLayoutKind;
-        RunCount();                   // cache m_runCountUntied, so that someone who inspects the file sees something meaningful (as an FYI)
 #if CURRENT_CNTK_MODEL_VERSION == CNTK_MODEL_VERSION_19
-        fstream << (bool)(m_runCountUntied == 0);  // a temp version that saved a flag instead (beta11)
+        fstream << (bool)(runCount == 0);  // a temp version that saved a flag instead (beta11)
 #else
-        fstream << m_runCountUntied;  // this is really saved as a FYI and for optimizing 0-checks; the primary storage for this value is in the shared Parameter
+        fstream << runCount;  // this is really saved as a FYI and for optimizing 0-checks; the primary storage for this value is in the shared Parameter
 #endif
         fstream << m_epsilon;
         fstream << m_useCntkEngine;
     }
 
+public:
+
     void Load(File& fstream, size_t modelVersion) override
     {
         size_t mbCount = 0;
@@ -2963,6 +3056,19 @@ public:
         m_blendTimeConst = std::numeric_limits<double>::infinity();
     }
 
+    // The tied run count lives in an input parameter; this is the untied one (or the cache of the tied one for 0 checks).
+    virtual std::vector<size_t> GetTrainingState() const override // from ITrainingStateNode
+    {
+        return std::vector<size_t>{ m_runCountUntied };
+    }
+
+    virtual void SetTrainingState(const std::vector<size_t>& state) override
+    {
+        if (state.size() != 1)
+            LogicError("%ls: Unexpected training state.", NodeDescription().c_str());
+        m_runCountUntied = state[0];
+    }
+
     // ResetStatisticsState() will set the batch normal statistics into initial state
     // used for re-statistics the mean and variance of BN.
     // In case of multiple BN nodes sharing statistics, this must be called on all.
@@ -2987,6 +3093,7 @@ public:
     double Epsilon() const { return m_epsilon; }
     bool UseCNTKEngine() const { return m_useCntkEngine; }
     bool DisableRegularization() const { return m_disableRegularization; }
+    ImageLayoutKind ImageLayout() const { return m_imageLayoutKind; }
 
 private:
     // Old versioning - do not use. Do not remove until we're sure there are no old models around.
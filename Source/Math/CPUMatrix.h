@@ -115,6 +115,8 @@ public:
 
     void AdaDeltaFlushTimestamps(size_t cols, ElemType rho, int* timestamps, int currentTimestamp);
 
+    void LazyDecayFlushTimestamps(size_t cols, const LazyDecayHistory& decayHistory, int* timestamps);
+
     void Reshape(const size_t numRows, const size_t numCols);
 
 
@@ -325,6 +327,18 @@ public:
 
     CPUMatrix<ElemType>& AssignNCEDerivative(const CPUMatrix<ElemType>& tmp, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, size_t inputIndex, CPUMatrix<ElemType>& c);
 
+    CPUMatrix<ElemType>& AssignSampledLogSoftmax(const CPUMatrix<ElemType>& hidden, const std::vector<size_t>& hiddenColumns, const CPUMatrix<ElemType>& weights,
+                                                 const std::vector<size_t>& candidates, const std::vector<size_t>& offsets);
+
+    CPUMatrix<ElemType>& AssignGMMLogLikelihood(const CPUMatrix<ElemType>& features, const CPUMatrix<ElemType>& scaledMeans, const CPUMatrix<ElemType>& precisions,
+                                                const CPUMatrix<ElemType>& logNormalizers, CPUMatrix<ElemType>& posterior);
+
+    CPUMatrix<ElemType>& AssignLogSumExpOfColumns(const CPUMatrix<ElemType>& a);
+    CPUMatrix<ElemType>& AssignSoftmaxCrossEntropyOf(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& logits, CPUMatrix<ElemType>& logSumExp);
+    static void AddScaledSoftmaxOf(ElemType alpha, const CPUMatrix<ElemType>& logits, const CPUMatrix<ElemType>& logSumExp, CPUMatrix<ElemType>& c);
+    static void AddSoftmaxCrossEntropyGradient(ElemType alpha, const CPUMatrix<ElemType>& logits, const CPUMatrix<ElemType>& logSumExp,
+                                               const CPUMatrix<ElemType>& labels, CPUMatrix<ElemType>& c);
+
     void VectorNormInf(CPUMatrix<ElemType>& c, const bool isColWise) const;
     CPUMatrix<ElemType>& AssignVectorNormInfOf(CPUMatrix<ElemType>& a, const bool isColWise);
 
@@ -1510,6 +1510,37 @@ void CPUMatrix<ElemType>::AdaDeltaFlushTimestamps(size_t cols, ElemType rho, int
     }
 }
 
+template <class ElemType>
+void CPUMatrix<ElemType>::LazyDecayFlushTimestamps(size_t cols, const LazyDecayHistory& decayHistory, int* timestamps)
+{
+    // Generalization of AdaDeltaFlushTimestamps() to learners whose state consists of decayHistory.NumBuffers()
+    // logical buffers of "cols" columns each, the k-th of which decays with its own, possibly changing, rate per update.
+    // Every buffer is scaled by the product of its rates since the timestamp of the column, which makes
+    // it equal to what a dense implementation would hold, and all timestamps are set to 0.
+    auto buffers = decayHistory.NumBuffers();
+    if (GetNumCols() < cols * buffers)
+        LogicError("LazyDecayFlushTimestamps: the matrix does not hold %d buffers of %d columns.", (int)buffers, (int)cols);
+
+    auto rows = GetNumRows();
+    auto currentTimestamp = decayHistory.NumUpdates();
+    auto data = Data();
+#pragma omp parallel for
+    for (long col = 0; col < (long)cols; ++col)
+    {
+        auto from = timestamps[col];
+        timestamps[col] = 0;
+        if (from == currentTimestamp)
+            continue;
+        for (size_t k = 0; k < buffers; ++k)
+        {
+            ElemType decay = (ElemType)decayHistory.Decay(k, from, currentTimestamp);
+            auto offset = (k * cols + col) * rows;
+            for (size_t row = 0; row < rows; ++row)
+                data[offset + row] *= decay;
+        }
+    }
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::Reshape(const size_t numRows, const size_t numCols)
 {
@@ -2428,6 +2459,37 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignAtanhOf(const CPUMatrix<ElemType
     return *this;
 }
 
+// Rows per block of the column-wise softmax kernels: a block of a column stays in L1 between the passes over it
+// (max, then exp), so that each column is streamed from memory only once.
+static const size_t c_softmaxBlockSize = 2048;
+
+// log sum_i exp(z[i]) with a running max, one block at a time. 'visitBlock(begin, end)' is called for each
+// block right after it has been summed, i.e. while it is still in cache.
+template <class ElemType, class BlockVisitor>
+static ElemType LogSumExpOfColumn(const ElemType* z, size_t n, const BlockVisitor& visitBlock)
+{
+    ElemType maxV = z[0];
+    double sum = 0;
+    for (size_t begin = 0; begin < n; begin += c_softmaxBlockSize)
+    {
+        const size_t end = std::min(begin + c_softmaxBlockSize, n);
+        ElemType blockMax = z[begin];
+        for (size_t i = begin + 1; i < end; i++)
+            blockMax = std::max(blockMax, z[i]);
+        if (blockMax > maxV) // rescale what we have summed so far to the new max
+        {
+            sum *= exp((double)(maxV - blockMax));
+            maxV = blockMax;
+        }
+        ElemType blockSum = 0;
+        for (size_t i = begin; i < end; i++)
+            blockSum += exp(z[i] - maxV);
+        sum += (double)blockSum;
+        visitBlock(begin, end);
+    }
+    return maxV + (ElemType)log(sum);
+}
+
 //[this]=softmax([this]) element wise
 template <class ElemType>
 CPUMatrix<ElemType>& CPUMatrix<ElemType>::InplaceLogSoftmax(const bool isColWise)
@@ -2447,20 +2509,13 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignLogSoftmaxOf(const CPUMatrix<Ele
 
     if (isColWise)
     {
+        // one read pass for the normalizer (see LogSumExpOfColumn()), one write pass
 #pragma omp parallel for
         foreach_column (j, a)
         {
-            // we need to extract max before applying exp to avoid overflow
-            ElemType maxV = a(0, j);
-            foreach_row (i, a)
-                maxV = std::max(maxV, a(i, j));
-
-            ElemType sum = 0;
-            foreach_row (i, a)
-                sum += exp(us(i, j) = a(i, j) - maxV);
-            sum = log(sum);
+            const ElemType logSumExp = LogSumExpOfColumn(&a(0, j), a.GetNumRows(), [](size_t, size_t) {});
             foreach_row (i, us)
-                us(i, j) -= sum;
+                us(i, j) = a(i, j) - logSumExp;
         }
     }
     else
@@ -5360,6 +5415,240 @@ void CPUMatrix<ElemType>::AssignNCEUnnormalizedEval(const CPUMatrix<ElemType>& a
     c(0, 0) = -log_likelihood;
 }
 
+// Fused gather-GEMM-logsumexp, see Matrix::AssignSampledLogSoftmax().
+// The cost is O(dim * candidates.size()), independent of the number of columns of weights.
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignSampledLogSoftmax(const CPUMatrix<ElemType>& hidden, const std::vector<size_t>& hiddenColumns, const CPUMatrix<ElemType>& weights,
+                                                                  const std::vector<size_t>& candidates, const std::vector<size_t>& offsets)
+{
+    const size_t dim = hidden.GetNumRows();
+    if (weights.GetNumRows() != dim)
+        InvalidArgument("AssignSampledLogSoftmax: the number of rows of the hidden activations (%d) and of the weights (%d) do not match.", (int)dim, (int)weights.GetNumRows());
+    if (offsets.size() != hiddenColumns.size() + 1 || offsets.front() != 0 || offsets.back() != candidates.size())
+        InvalidArgument("AssignSampledLogSoftmax: the candidate offsets do not match the number of segments.");
+    for (size_t k = 0; k < hiddenColumns.size(); k++)
+    {
+        if (hiddenColumns[k] >= hidden.GetNumCols())
+            InvalidArgument("AssignSampledLogSoftmax: hidden column %d is out of range.", (int)hiddenColumns[k]);
+        if (offsets[k] > offsets[k + 1])
+            InvalidArgument("AssignSampledLogSoftmax: the candidate offsets must be non-decreasing.");
+    }
+    for (auto candidate : candidates)
+        if (candidate >= weights.GetNumCols())
+            InvalidArgument("AssignSampledLogSoftmax: candidate %d is out of range.", (int)candidate);
+
+    RequireSize(1, candidates.size());
+
+    ElemType* us = Data();
+    const ElemType* h = hidden.Data();
+    const ElemType* w = weights.Data();
+    const long numSegments = (long)hiddenColumns.size();
+
+#pragma omp parallel for
+    for (long k = 0; k < numSegments; k++)
+    {
+        const size_t begin = offsets[k];
+        const size_t end = offsets[k + 1];
+        if (begin == end)
+            continue;
+
+        // gather + GEMV: only the candidate columns of the weight matrix are touched
+        const ElemType* ht = h + hiddenColumns[k] * dim;
+        ElemType maxLogit = 0;
+        for (size_t j = begin; j < end; j++)
+        {
+            const ElemType* wj = w + candidates[j] * dim;
+            ElemType logit = 0;
+            for (size_t i = 0; i < dim; i++)
+                logit += wj[i] * ht[i];
+            us[j] = logit;
+            if (j == begin || logit > maxLogit)
+                maxLogit = logit;
+        }
+
+        // log-sum-exp and normalization, in place
+        double sum = 0;
+        for (size_t j = begin; j < end; j++)
+            sum += exp((double)(us[j] - maxLogit));
+        const ElemType logSumExp = maxLogit + (ElemType)log(sum);
+        for (size_t j = begin; j < end; j++)
+            us[j] -= logSumExp;
+    }
+    return *this;
+}
+
+// Fused GMM log-likelihood, see Matrix::AssignGMMLogLikelihood().
+// The cross terms of all components and a block of frames come from one GEMM; the block is small enough
+// for its score tile to still be in cache when the log-sum-exp pass turns it into posteriors.
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignGMMLogLikelihood(const CPUMatrix<ElemType>& features, const CPUMatrix<ElemType>& scaledMeans, const CPUMatrix<ElemType>& precisions,
+                                                                 const CPUMatrix<ElemType>& logNormalizers, CPUMatrix<ElemType>& posterior)
+{
+    const size_t featureDim = features.GetNumRows();
+    const size_t numFrames = features.GetNumCols();
+    const size_t numComponents = scaledMeans.GetNumCols();
+    if (scaledMeans.GetNumRows() != featureDim)
+        InvalidArgument("AssignGMMLogLikelihood: the number of rows of the means (%d) and of the features (%d) do not match.", (int)scaledMeans.GetNumRows(), (int)featureDim);
+    if (numComponents == 0 || precisions.GetNumElements() != numComponents || logNormalizers.GetNumElements() != numComponents)
+        InvalidArgument("AssignGMMLogLikelihood: precisions and log normalizers must have one element per component (%d).", (int)numComponents);
+
+    RequireSize(1, numFrames);
+    posterior.RequireSize(numComponents, numFrames);
+
+    ElemType* us = Data();
+    ElemType* post = posterior.Data();
+    const ElemType* x = features.Data();
+    const ElemType* p = precisions.Data();
+    const ElemType* c = logNormalizers.Data();
+
+    const size_t blockSize = std::max((size_t)16, (size_t)16384 / numComponents);
+    for (size_t begin = 0; begin < numFrames; begin += blockSize)
+    {
+        const size_t end = std::min(begin + blockSize, numFrames);
+        CPUMatrix<ElemType> scores = posterior.ColumnSlice(begin, end - begin);
+        MultiplyAndWeightedAdd(1, scaledMeans, true, features.ColumnSlice(begin, end - begin), false, 0, scores);
+
+#pragma omp parallel for
+        for (long t = (long)begin; t < (long)end; t++)
+        {
+            const ElemType* xt = x + t * featureDim;
+            ElemType* st = post + t * numComponents;
+            ElemType sqNorm = 0;
+            for (size_t i = 0; i < featureDim; i++)
+                sqNorm += xt[i] * xt[i];
+
+            ElemType maxScore = 0;
+            for (size_t k = 0; k < numComponents; k++)
+            {
+                st[k] += c[k] - (ElemType)0.5 * p[k] * sqNorm;
+                if (k == 0 || st[k] > maxScore)
+                    maxScore = st[k];
+            }
+            double sum = 0;
+            for (size_t k = 0; k < numComponents; k++)
+            {
+                const double e = exp((double)(st[k] - maxScore));
+                st[k] = (ElemType)e;
+                sum += e;
+            }
+            const ElemType invSum = (ElemType)(1 / sum);
+            for (size_t k = 0; k < numComponents; k++)
+                st[k] *= invSum;
+            us[t] = maxScore + (ElemType)log(sum);
+        }
+    }
+    return *this;
+}
+
+// [this] = log sum_i exp(a(i, j)), a row vector
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignLogSumExpOfColumns(const CPUMatrix<ElemType>& a)
+{
+    if (a.IsEmpty())
+        LogicError("AssignLogSumExpOfColumns: Matrix a is empty.");
+
+    const size_t numRows = a.GetNumRows();
+    RequireSize(1, a.GetNumCols());
+    ElemType* us = Data();
+    const ElemType* z = a.Data();
+
+#pragma omp parallel for
+    for (long j = 0; j < (long)a.GetNumCols(); j++)
+        us[j] = LogSumExpOfColumn(z + j * numRows, numRows, [](size_t, size_t) {});
+    return *this;
+}
+
+// Fused softmax cross-entropy, see Matrix::AssignSoftmaxCrossEntropyOf().
+// The labels are read in the same pass as the logits, block by block.
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignSoftmaxCrossEntropyOf(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& logits, CPUMatrix<ElemType>& logSumExp)
+{
+    if (labels.IsEmpty() || logits.IsEmpty())
+        LogicError("AssignSoftmaxCrossEntropyOf: one of the input matrices is empty.");
+    if (labels.GetNumRows() != logits.GetNumRows() || labels.GetNumCols() != logits.GetNumCols())
+        InvalidArgument("AssignSoftmaxCrossEntropyOf: labels and logits must have the same dimension.");
+
+    const size_t numRows = logits.GetNumRows();
+    logSumExp.RequireSize(1, logits.GetNumCols());
+    ElemType* lse = logSumExp.Data();
+    const ElemType* z = logits.Data();
+    const ElemType* y = labels.Data();
+
+    double crossEntropy = 0;
+#pragma omp parallel for reduction(+ : crossEntropy)
+    for (long j = 0; j < (long)logits.GetNumCols(); j++)
+    {
+        const ElemType* zj = z + j * numRows;
+        const ElemType* yj = y + j * numRows;
+        double labelSum = 0, labelDotLogits = 0;
+        lse[j] = LogSumExpOfColumn(zj, numRows, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                if (yj[i] != 0) // (also keeps whatever is in the logits of gap columns out)
+                {
+                    labelSum += (double)yj[i];
+                    labelDotLogits += (double)(yj[i] * zj[i]);
+                }
+            }
+        });
+        if (labelSum != 0)
+            crossEntropy += labelSum * (double)lse[j] - labelDotLogits;
+    }
+
+    RequireSize(1, 1);
+    Data()[0] = (ElemType)crossEntropy;
+    return *this;
+}
+
+// c += alpha * exp(logits - logSumExp), i.e. the scaled softmax, with logSumExp from AssignLogSumExpOfColumns()
+template <class ElemType>
+void CPUMatrix<ElemType>::AddScaledSoftmaxOf(ElemType alpha, const CPUMatrix<ElemType>& logits, const CPUMatrix<ElemType>& logSumExp, CPUMatrix<ElemType>& c)
+{
+    if (c.GetNumRows() != logits.GetNumRows() || c.GetNumCols() != logits.GetNumCols() || logSumExp.GetNumElements() != logits.GetNumCols())
+        InvalidArgument("AddScaledSoftmaxOf: The dimensions of the logits, their log-sum-exp, and the result do not match.");
+
+    const size_t numRows = logits.GetNumRows();
+    const ElemType* lse = logSumExp.Data();
+    const ElemType* z = logits.Data();
+    ElemType* us = c.Data();
+
+#pragma omp parallel for
+    for (long j = 0; j < (long)logits.GetNumCols(); j++)
+    {
+        const ElemType* zj = z + j * numRows;
+        ElemType* cj = us + j * numRows;
+        for (size_t i = 0; i < numRows; i++)
+            cj[i] += alpha * exp(zj[i] - lse[j]);
+    }
+}
+
+// c += alpha * (softmax(logits) - labels), the gradient of the softmax cross-entropy w.r.t. the logits, in one pass
+template <class ElemType>
+void CPUMatrix<ElemType>::AddSoftmaxCrossEntropyGradient(ElemType alpha, const CPUMatrix<ElemType>& logits, const CPUMatrix<ElemType>& logSumExp,
+                                                         const CPUMatrix<ElemType>& labels, CPUMatrix<ElemType>& c)
+{
+    if (labels.GetNumRows() != logits.GetNumRows() || labels.GetNumCols() != logits.GetNumCols() ||
+        c.GetNumRows() != logits.GetNumRows() || c.GetNumCols() != logits.GetNumCols() || logSumExp.GetNumElements() != logits.GetNumCols())
+        InvalidArgument("AddSoftmaxCrossEntropyGradient: The dimensions of the labels, logits, their log-sum-exp, and the result do not match.");
+
+    const size_t numRows = logits.GetNumRows();
+    const ElemType* lse = logSumExp.Data();
+    const ElemType* z = logits.Data();
+    const ElemType* y = labels.Data();
+    ElemType* us = c.Data();
+
+#pragma omp parallel for
+    for (long j = 0; j < (long)logits.GetNumCols(); j++)
+    {
+        const ElemType* zj = z + j * numRows;
+        const ElemType* yj = y + j * numRows;
+        ElemType* cj = us + j * numRows;
+        for (size_t i = 0; i < numRows; i++)
+            cj[i] += alpha * (exp(zj[i] - lse[j]) - yj[i]);
+    }
+}
+
 //samples+prob                         gradient           hidden               embedding          embedding/hidden
 //a.m_CPUMatrix->AssignNCEDerivative(*tmp.m_CPUMatrix, *a.m_CPUMatrix, *b.m_CPUMatrix, inputIndex, *c.m_CPUMatrix);
 template <class ElemType>
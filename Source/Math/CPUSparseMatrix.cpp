@@ -17,6 +17,7 @@
 #include <random>
 #include <chrono>
 #include <iostream>
+#include <algorithm>
 #ifdef LEAKDETECT
 #include <vld.h>
 #endif
@@ -83,6 +84,35 @@ enum class MatrixOpSide : char
 
 #pragma endregion Helpful Enum Definitions
 
+// Tiling of the sparse kernels: a product that touches fewer than c_sparseMinWorkPerTile elements runs on a single
+// thread, larger ones are split in at most one tile per thread. Tiles along the compressed dimension of the sparse
+// operand are cut at equal nonzero counts rather than equal column counts, so that a few heavy columns (e.g. frequent
+// words in a one-hot input) don't leave the other threads idle.
+static const size_t c_sparseMinWorkPerTile = 32 * 1024;
+
+static size_t SparseNumTiles(size_t work, size_t maxTiles)
+{
+    size_t numTiles = min((size_t)omp_get_max_threads(), work / c_sparseMinWorkPerTile);
+    return max((size_t)1, min(numTiles, maxTiles));
+}
+
+// Splits the compressed dimension [0, numCompressed) into numTiles ranges with about the same number of nonzeros.
+// Tile t covers [bounds[t], bounds[t + 1]). 'secondaryIndex' is the compressed index of the (slice view of the) matrix.
+static void PartitionByNonzeros(const CPUSPARSE_INDEX_TYPE* secondaryIndex, size_t numCompressed, size_t numTiles, vector<size_t>& bounds)
+{
+    bounds.resize(numTiles + 1);
+    const size_t base = secondaryIndex[0];
+    const size_t nz = secondaryIndex[numCompressed] - base;
+    bounds[0] = 0;
+    for (size_t t = 1; t < numTiles; t++)
+    {
+        auto target = (CPUSPARSE_INDEX_TYPE)(base + nz * t / numTiles);
+        size_t bound = lower_bound(secondaryIndex, secondaryIndex + numCompressed, target) - secondaryIndex;
+        bounds[t] = max(bounds[t - 1], bound);
+    }
+    bounds[numTiles] = numCompressed;
+}
+
 #pragma region Constructors and Destructor
 
 //-------------------------------------------------------------------------
@@ -181,8 +211,7 @@ template <class ElemType>
 void CPUSparseMatrix<ElemType>::SetDiagonalValue(const ElemType v)
 {
     if (NzCount() > 0)
-        //So far only support SetDiagonalValue for zero sparse matrix for now
-        LogicError("Not implemented: SetDiagonalValue is not implemented for non-zero sparse CPU matrices.");
+        return SetDiagonalValueOfNonEmpty(&v, 0);
 
     RequireSizeAndAllocate(GetNumRows(), GetNumCols(), GetDiagSize(), true, false);
     CPUSPARSE_INDEX_TYPE* secondaryIndices = SecondaryIndexLocation();
@@ -202,10 +231,6 @@ void CPUSparseMatrix<ElemType>::SetDiagonalValue(const ElemType v)
 template <class ElemType>
 void CPUSparseMatrix<ElemType>::SetDiagonalValue(const CPUMatrix<ElemType>& vector)
 {
-    if (NzCount() > 0)
-        //So far only support SetDiagonalValue for zero sparse matrix for now
-        NOT_IMPLEMENTED;
-
     if (vector.GetNumRows() != 1 && vector.GetNumCols() != 1)
         LogicError("SetDiagonalValue: input vector must be a vector.");
 
@@ -213,6 +238,8 @@ void CPUSparseMatrix<ElemType>::SetDiagonalValue(const CPUMatrix<ElemType>& vect
         SetDiagonalValue(vector(0, 0));
     else if (vector.GetNumRows() != GetDiagSize() && vector.GetNumCols() != GetDiagSize())
         LogicError("SetDiagonalValue: input vector's dimension does not agree with [this].");
+    else if (NzCount() > 0)
+        SetDiagonalValueOfNonEmpty(vector.Data(), 1);
     else
     {
         RequireSizeAndAllocate(GetNumRows(), GetNumCols(), GetDiagSize(), true, false);
@@ -231,6 +258,61 @@ void CPUSparseMatrix<ElemType>::SetDiagonalValue(const CPUMatrix<ElemType>& vect
     }
 }
 
+// Sets the diagonal of a matrix that already has nonzeros to values[j * stride]. In every column (CSC) or row (CSR)
+// j the diagonal element replaces an existing (j, j) and is otherwise inserted in front of the first larger index.
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::SetDiagonalValueOfNonEmpty(const ElemType* values, size_t stride)
+{
+    VerifyWritable(__func__);
+
+    if (GetFormat() != matrixFormatSparseCSC && GetFormat() != matrixFormatSparseCSR)
+        NOT_IMPLEMENTED;
+    if (m_sliceViewOffset != 0)
+        LogicError("SetDiagonalValue: Cannot insert into a slice view of a sparse matrix.");
+
+    const size_t numLines = (GetFormat() == matrixFormatSparseCSC) ? GetNumCols() : GetNumRows();
+    const size_t diagSize = GetDiagSize();
+    const CPUSPARSE_INDEX_TYPE* secondaryIndex = SecondaryIndexLocation();
+    const CPUSPARSE_INDEX_TYPE* majorIndex = MajorIndexLocation();
+    const ElemType* data = Data();
+    const size_t base = secondaryIndex[0];
+
+    vector<CPUSPARSE_INDEX_TYPE> newSecondaryIndex(numLines + 1, 0);
+    vector<CPUSPARSE_INDEX_TYPE> newMajorIndex;
+    vector<ElemType> newData;
+    newMajorIndex.reserve(NzCount() + diagSize);
+    newData.reserve(NzCount() + diagSize);
+    for (size_t j = 0; j < numLines; j++)
+    {
+        newSecondaryIndex[j] = (CPUSPARSE_INDEX_TYPE)newData.size();
+        bool pending = j < diagSize;
+        for (size_t p = secondaryIndex[j] - base; p < secondaryIndex[j + 1] - base; p++)
+        {
+            if (j < diagSize && majorIndex[p] == j) // replaced by the new diagonal value
+                continue;
+            if (pending && majorIndex[p] > j)
+            {
+                newMajorIndex.push_back((CPUSPARSE_INDEX_TYPE)j);
+                newData.push_back(values[j * stride]);
+                pending = false;
+            }
+            newMajorIndex.push_back(majorIndex[p]);
+            newData.push_back(data[p]);
+        }
+        if (pending)
+        {
+            newMajorIndex.push_back((CPUSPARSE_INDEX_TYPE)j);
+            newData.push_back(values[j * stride]);
+        }
+    }
+    newSecondaryIndex[numLines] = (CPUSPARSE_INDEX_TYPE)newData.size();
+
+    RequireSizeAndAllocate(GetNumRows(), GetNumCols(), newData.size(), true, false);
+    memcpy(GetCompIndex(), newSecondaryIndex.data(), sizeof(CPUSPARSE_INDEX_TYPE) * newSecondaryIndex.size());
+    memcpy(GetUnCompIndex(), newMajorIndex.data(), sizeof(CPUSPARSE_INDEX_TYPE) * newMajorIndex.size());
+    memcpy(Buffer(), newData.data(), sizeof(ElemType) * newData.size());
+}
+
 template <class ElemType>
 CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::AssignOneHot(const CPUMatrix<ElemType>& a, vector<size_t>& shape, size_t axis)
 {
@@ -390,25 +472,52 @@ void CPUSparseMatrix<ElemType>::SetValue(const CPUSparseMatrix<ElemType>& v)
     }
 }
 
-#if 0
+// dense to sparse: a CSR matrix stays CSR, any other format becomes CSC
 template <class ElemType>
-void CPUSparseMatrix<ElemType>::SetValue(const CPUMatrix<ElemType>& /*v*/)
+void CPUSparseMatrix<ElemType>::SetValue(const CPUMatrix<ElemType>& v)
 {
-    NOT_IMPLEMENTED;
-}
+    VerifyWritable(__func__);
 
-template <class ElemType>
-void CPUSparseMatrix<ElemType>::SetValue(const GPUMatrix<ElemType>& /*v*/)
-{
-    NOT_IMPLEMENTED;
-}
+    const MatrixFormat format = (GetFormat() == matrixFormatSparseCSR) ? matrixFormatSparseCSR : matrixFormatSparseCSC;
+    const bool isCSC = (format == matrixFormatSparseCSC);
+    const long numLines = (long)(isCSC ? v.GetNumCols() : v.GetNumRows());
+    const size_t lineLength = isCSC ? v.GetNumRows() : v.GetNumCols();
 
-template <class ElemType>
-void CPUSparseMatrix<ElemType>::SetValue(const GPUSparseMatrix<ElemType>& /*v*/)
-{
-    NOT_IMPLEMENTED;
+    // count the nonzeros of every column (CSC) or row (CSR) first, so that they can then be filled in parallel
+    vector<size_t> lineStart(numLines + 1, 0);
+#pragma omp parallel for
+    for (long j = 0; j < numLines; j++)
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < lineLength; i++)
+            count += ((isCSC ? v(i, j) : v(j, i)) != (ElemType)0) ? 1 : 0;
+        lineStart[j + 1] = count;
+    }
+    for (long j = 0; j < numLines; j++)
+        lineStart[j + 1] += lineStart[j];
+
+    RequireSizeAndAllocate(v.GetNumRows(), v.GetNumCols(), lineStart[numLines], format, true, false);
+
+    CPUSPARSE_INDEX_TYPE* secondaryIndex = GetCompIndex();
+    CPUSPARSE_INDEX_TYPE* majorIndex = GetUnCompIndex();
+    ElemType* data = Buffer();
+#pragma omp parallel for
+    for (long j = 0; j < numLines; j++)
+    {
+        size_t p = lineStart[j];
+        for (size_t i = 0; i < lineLength; i++)
+        {
+            ElemType value = isCSC ? v(i, j) : v(j, i);
+            if (value != (ElemType)0)
+            {
+                majorIndex[p] = (CPUSPARSE_INDEX_TYPE)i;
+                data[p++] = value;
+            }
+        }
+        secondaryIndex[j + 1] = (CPUSPARSE_INDEX_TYPE)lineStart[j + 1];
+    }
+    secondaryIndex[0] = 0;
 }
-#endif
 
 template <class ElemType>
 void CPUSparseMatrix<ElemType>::MaskColumnsValue(const CPUMatrix<char>& columnsMask, ElemType val, size_t numColsPerMaskEntry)
@@ -436,6 +545,15 @@ void CPUSparseMatrix<ElemType>::MaskColumnsValue(const CPUMatrix<char>& columnsM
                 if (maskedCols[j] == 0 && colVector[(j * numColsPerMaskEntry) + k + 1] != colVector[(j * numColsPerMaskEntry) + k])
                     LogicError("CPUSparseMatrix attempted to mask column %d, but it has %d elements in it.", (int)((j * numColsPerMaskEntry) + k), (int)(colVector[(j * numColsPerMaskEntry) + k + 1] - colVector[(j * numColsPerMaskEntry) + k]));
     }
+    else if (GetFormat() == MatrixFormat::matrixFormatSparseCSR)
+    {
+        // If we're CSR, no nonzero may be in a column to be zeroed.
+        char* maskedCols = columnsMask.Data();
+        const GPUSPARSE_INDEX_TYPE* colIndex = MajorIndexLocation();
+        for (size_t p = 0; p < NzCount(); p++)
+            if (maskedCols[colIndex[p] / numColsPerMaskEntry] == 0)
+                LogicError("CPUSparseMatrix attempted to mask column %d, but it has elements in it.", (int)colIndex[p]);
+    }
     else
         NOT_IMPLEMENTED;
 #endif
@@ -453,12 +571,30 @@ CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::DoGatherColumnsOf(ElemType
         InvalidArgument("DoGatherColumnsOf: Map must be a row vector.");
 
     if (beta != 0)
-        NOT_IMPLEMENTED;
+    {
+        // the gathered columns have to be merged into the existing ones
+        if (GetNumRows() != a.GetNumRows() || GetNumCols() != idx.GetNumCols())
+            InvalidArgument("DoGatherColumnsOf: The target matrix must have the dimensions [%d x %d] if beta != 0.", (int)a.GetNumRows(), (int)idx.GetNumCols());
 
-    // Determine the number of non-zero elements
-    size_t numCols = idx.GetNumCols();
-    size_t numNonZeroElements = 0;
-    // TODO: Does it make sense to parallelize this?
+        vector<vector<size_t>> sources(idx.GetNumCols());
+        for (size_t j = 0; j < idx.GetNumCols(); j++)
+        {
+            auto jInF = idx(0, j);
+            if (std::isnan(jInF) || (jInF < 0)) // negative index means gap
+                continue;
+            if ((size_t)jInF >= a.GetNumCols())
+                InvalidArgument("DoGatherColumnsOf: Map out of bounds. %ld >= %ld", (long int)jInF, (long int)a.GetNumCols());
+            sources[j].push_back((size_t)jInF);
+        }
+        AssignWeightedColumnSums(beta, a, sources, alpha, /*keepGaps=*/true);
+        return *this;
+    }
+
+    // Determine the number of non-zero elements of every output column, their prefix sum gives the column offsets,
+    // so that the columns can then be copied in parallel.
+    long numCols = (long)idx.GetNumCols();
+    vector<size_t> colStart(numCols + 1, 0);
+#pragma omp parallel for
     for (long j = 0; j < numCols; j++)
     {
         auto jInF = idx(0, j); // this is the column we need to get
@@ -468,14 +604,17 @@ CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::DoGatherColumnsOf(ElemType
 
         auto start = a.SecondaryIndexLocation()[jIn];
         auto end = a.SecondaryIndexLocation()[jIn + 1];
-        numNonZeroElements += (end - start);
+        colStart[j + 1] = end - start;
     }
+    for (long j = 0; j < numCols; j++)
+        colStart[j + 1] += colStart[j];
+    size_t numNonZeroElements = colStart[numCols];
 
     if (beta == 0)
         RequireSizeAndAllocate(a.GetNumRows(), idx.GetNumCols(), numNonZeroElements); // output has same column format as a, but number of columns comes from idx
 
     size_t offset = SecondaryIndexLocation()[0];
-    // TODO: Does it make sense to parallelize this?
+#pragma omp parallel for if (numNonZeroElements > c_sparseMinWorkPerTile)
     for (long j = 0; j < numCols; j++)
     {
         auto jInF = idx(0, j); // this is the column we need to get
@@ -485,13 +624,14 @@ CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::DoGatherColumnsOf(ElemType
 
             auto start = a.SecondaryIndexLocation()[jIn];
             auto end = a.SecondaryIndexLocation()[jIn + 1];
-            for (auto p = start; p < end; p++, offset++)
+            size_t dst = offset + colStart[j];
+            for (auto p = start; p < end; p++, dst++)
             {
-                GetUnCompIndex()[offset] = a.GetUnCompIndex()[p];
-                Buffer()[offset] = a.Buffer()[p] * alpha;
+                GetUnCompIndex()[dst] = a.GetUnCompIndex()[p];
+                Buffer()[dst] = a.Buffer()[p] * alpha;
             }
         }
-        SecondaryIndexLocation()[j + 1] = CPUSPARSE_INDEX_TYPE(offset);
+        SecondaryIndexLocation()[j + 1] = CPUSPARSE_INDEX_TYPE(offset + colStart[j + 1]);
     }
 
     return *this;
@@ -508,13 +648,35 @@ CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::DoScatterColumnsOf(ElemTyp
 
     if (idx.GetNumRows() != 1) // index is 1-dimensional only
         InvalidArgument("DoScatterColumnsOf: Map must be a row vector.");
+    if (idx.GetNumCols() != a.GetNumCols())
+        InvalidArgument("DoScatterColumnsOf: Map must have width of input vector.");
+    if (a.GetNumRows() != GetNumRows())
+        InvalidArgument("DoScatterColumnsOf: Output must have same height as input vector.");
 
-    if (beta != 0)
-        NOT_IMPLEMENTED;
-
-    if (NzCount() != 0)
+    // With beta == 0, the target is expected to be empty (as it is when it was just allocated), also when columns repeat.
+    if (beta == 0 && NzCount() != 0)
         InvalidArgument("CPUSparseMatrix::DoScatterColumnsOf: The target matrix cannot have pre-existing non-zero values when being scattered into");
 
+    // Several source columns may go to the same target column. Those, and any existing values that are kept
+    // because beta != 0, have to be merged by the general path.
+    vector<vector<size_t>> sources(GetNumCols());
+    bool hasDuplicates = false;
+    for (size_t j = 0; j < idx.GetNumCols(); j++)
+    {
+        auto jOutF = idx(0, j);
+        if (std::isnan(jOutF) || (jOutF < 0)) // negative index means gap
+            continue;
+        if ((size_t)jOutF >= GetNumCols())
+            InvalidArgument("DoScatterColumnsOf: Map out of bounds. %ld >= %ld", (long int)jOutF, (long int)GetNumCols());
+        sources[(size_t)jOutF].push_back(j);
+        hasDuplicates |= (sources[(size_t)jOutF].size() > 1);
+    }
+    if (beta != 0 || hasDuplicates)
+    {
+        AssignWeightedColumnSums(beta, a, sources, alpha, /*keepGaps=*/false);
+        return *this;
+    }
+
     size_t numNonZeroElements = a.NzCount();
 
     if (beta == 0)
@@ -557,6 +719,73 @@ CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::DoScatterColumnsOf(ElemTyp
     return *this;
 }
 
+// Rebuilds this CSC matrix as
+//     this[:, j] = beta * this[:, j] + alpha * sum over s in sources[j] of a[:, s],
+// which covers gathering or scattering into existing values, and scattering several columns into the same one.
+// With keepGaps, a column without sources is left as it is (the gaps of a gather), otherwise it is scaled, too.
+// The columns are merged independently: entries are sorted by row and the duplicates are summed up.
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::AssignWeightedColumnSums(ElemType beta, const CPUSparseMatrix<ElemType>& a, const vector<vector<size_t>>& sources, ElemType alpha, bool keepGaps)
+{
+    typedef pair<CPUSPARSE_INDEX_TYPE, ElemType> Entry;
+
+    const long numCols = (long)sources.size();
+    const bool keepExisting = (beta != 0) && !IsEmpty() && (NzCount() > 0);
+    if (keepExisting && m_sliceViewOffset != 0)
+        LogicError("AssignWeightedColumnSums: Cannot merge into a slice view of a sparse matrix.");
+
+    vector<vector<Entry>> columns(numCols);
+#pragma omp parallel for
+    for (long j = 0; j < numCols; j++)
+    {
+        auto& column = columns[j];
+        if (keepExisting)
+        {
+            const ElemType scale = (keepGaps && sources[j].empty()) ? (ElemType)1 : beta;
+            for (size_t p = SecondaryIndexLocation()[j]; p < SecondaryIndexLocation()[j + 1]; p++)
+                column.emplace_back(GetUnCompIndex()[p], scale * Buffer()[p]);
+        }
+        for (size_t s : sources[j])
+        {
+            for (size_t p = a.SecondaryIndexLocation()[s]; p < a.SecondaryIndexLocation()[s + 1]; p++)
+                column.emplace_back(a.GetUnCompIndex()[p], alpha * a.Buffer()[p]);
+        }
+        if (column.size() > 1 && (keepExisting || sources[j].size() > 1))
+        {
+            sort(column.begin(), column.end(), [](const Entry& x, const Entry& y) { return x.first < y.first; });
+            size_t n = 0;
+            for (size_t k = 0; k < column.size(); k++)
+            {
+                if (n > 0 && column[n - 1].first == column[k].first)
+                    column[n - 1].second += column[k].second;
+                else
+                    column[n++] = column[k];
+            }
+            column.resize(n);
+        }
+    }
+
+    vector<size_t> colStart(numCols + 1, 0);
+    for (long j = 0; j < numCols; j++)
+        colStart[j + 1] = colStart[j] + columns[j].size();
+
+    RequireSizeAndAllocate(a.GetNumRows(), numCols, colStart[numCols], true, false);
+
+    CPUSPARSE_INDEX_TYPE* secondaryIndex = GetCompIndex();
+#pragma omp parallel for if (colStart[numCols] > c_sparseMinWorkPerTile)
+    for (long j = 0; j < numCols; j++)
+    {
+        size_t dst = colStart[j];
+        for (const auto& entry : columns[j])
+        {
+            GetUnCompIndex()[dst] = entry.first;
+            Buffer()[dst++] = entry.second;
+        }
+        secondaryIndex[j + 1] = (CPUSPARSE_INDEX_TYPE)colStart[j + 1];
+    }
+    secondaryIndex[0] = 0;
+}
+
 template <class ElemType>
 void CPUSparseMatrix<ElemType>::Print(const char* matrixName) const
 {
@@ -597,6 +826,8 @@ CPUSparseMatrix<ElemType> CPUSparseMatrix<ElemType>::ColumnSlice(size_t startCol
     if (startColumn + numCols > m_numCols)
         InvalidArgument("The slice (%d+%d) is out of range of the source matrix (%d).", (int) startColumn, (int) numCols, (int) m_numCols);
 
+    if (GetFormat() == MatrixFormat::matrixFormatSparseCSR)
+        LogicError("ColumnSlice: The columns of a CSR matrix are not contiguous, there is no slice view. Use AssignColumnSliceToDense() instead.");
     if (GetFormat() != MatrixFormat::matrixFormatSparseCSC && GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
         NOT_IMPLEMENTED;
 
@@ -659,7 +890,7 @@ void CPUSparseMatrix<ElemType>::AssignColumnSliceToDense(CPUMatrix<ElemType>& sl
     if (startColumn + numCols > m_numCols)
         InvalidArgument("The slice (%d+%d) is out of range of the source matrix (%d).", (int) startColumn, (int) numCols, (int) m_numCols);
 
-    if ((GetFormat() != MatrixFormat::matrixFormatSparseCSC) && (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol))
+    if ((GetFormat() != MatrixFormat::matrixFormatSparseCSC) && (GetFormat() != MatrixFormat::matrixFormatSparseCSR) && (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol))
         NOT_IMPLEMENTED;
 
     // We can either error out or RequireSize. Because RequireSize will error out if it's not allowed, I think this makes more sense.
@@ -683,6 +914,24 @@ void CPUSparseMatrix<ElemType>::AssignColumnSliceToDense(CPUMatrix<ElemType>& sl
             }
         }
     }
+    else if (GetFormat() == MatrixFormat::matrixFormatSparseCSR)
+    {
+        // A CSR matrix can't provide a column slice view, but the rows can be copied in parallel.
+        const CPUSPARSE_INDEX_TYPE* secondaryIndex = SecondaryIndexLocation();
+        const size_t base = secondaryIndex[0];
+        const ElemType* valueBuffer = Buffer() + base;
+        const CPUSPARSE_INDEX_TYPE* colIndexBuffer = MajorIndexLocation();
+#pragma omp parallel for
+        for (long i = 0; i < (long)m_numRows; i++)
+        {
+            for (size_t p = secondaryIndex[i] - base; p < secondaryIndex[i + 1] - base; p++)
+            {
+                size_t j = colIndexBuffer[p];
+                if (j >= startColumn && j < startColumn + numCols)
+                    slice((size_t)i, j - startColumn) = valueBuffer[p];
+            }
+        }
+    }
     else
     {
         CPUSparseMatrix<ElemType> sparseSlice = ColumnSlice(startColumn, numCols);
@@ -717,10 +966,23 @@ CPUMatrix<ElemType> CPUSparseMatrix<ElemType>::DiagonalToDense() const
     if (m_numRows != m_numCols)
         LogicError("DiagonalToDense can be called only for square matrix.");
 
-    if (GetFormat() != MatrixFormat::matrixFormatSparseCSC)
+    CPUMatrix<ElemType> diag(1, m_numCols);
+
+    if (GetFormat() == MatrixFormat::matrixFormatSparseBlockCol)
+    {
+        // every block is a dense column
+        for (size_t j = 0; j < GetBlockSize(); j++)
+        {
+            size_t col = GetBlockIds()[j] - GetBlockIdShift();
+            diag(0, col) = Buffer()[j * m_numRows + col];
+        }
+        return diag;
+    }
+
+    if (GetFormat() != MatrixFormat::matrixFormatSparseCSC && GetFormat() != MatrixFormat::matrixFormatSparseCSR)
         NOT_IMPLEMENTED;
 
-    CPUMatrix<ElemType> diag(1, m_numCols);
+    // The loop below finds the diagonal both in the columns of a CSC and in the rows of a CSR matrix.
 
 #pragma omp parallel for
     for (long j = 0; j < m_numCols; j++)
@@ -947,13 +1209,6 @@ public:
         if (k != l)
             InvalidArgument("CPUSparseMatrix::MultiplyAndWeightedAdd: The inner dimensions of a (= %lu) and b (= %lu) don't match.", k, l);
 
-        // Determine the dimension of the outer index of the dense matrix.
-        size_t outerDimensionDense;
-        if      ( denseTimesSparse && !transposeA) outerDimensionDense = dense.GetNumRows();
-        else if ( denseTimesSparse &&  transposeA) outerDimensionDense = dense.GetNumCols();
-        else if (!denseTimesSparse && !transposeB) outerDimensionDense = dense.GetNumCols();
-        else if (!denseTimesSparse &&  transposeB) outerDimensionDense = dense.GetNumRows();
-
         if (beta == 0)
             c.RequireSize(m, n);
         else
@@ -976,56 +1231,146 @@ public:
         if (sparse.IsEmpty() || dense.IsEmpty())
             return;
 
-        // TODO: Implement CSR as a transposition of b, like we do for GPU.
-        if (sparse.GetFormat() != matrixFormatSparseCSC)
-            NOT_IMPLEMENTED;
-
         // Up to here we have:
         // * checked that the matrices are compatible in size
         // * Initialized the output matrix c
 
-        // Now do the actual multiplication.
-        ElemType* valueBuffer = sparse.Buffer() + *sparse.SecondaryIndexLocation(); // Points to the value buffer of the current view (i.e. buffer containing values of non-zero elements).
-        int* rowIndexBuffer = sparse.MajorIndexLocation();                          // Points to the index buffer of the current view (i.e. buffer containing indices of non-zero elements).
-        size_t iNonzero = 0;                                                           // Number of nonzero elements handled so far for current slice view.
-        int numPreviosNonzero = sparse.SecondaryIndexLocation()[0];                 // Total number of nonzero values handled in previous slices.
+        // Now do the actual multiplication. A CSR matrix is stored exactly like the CSC representation of its transpose,
+        // so it is handled by the CSC kernel with the transposition of the sparse factor flipped.
+        if (sparse.GetFormat() == matrixFormatSparseCSC)
+            Accumulate(alpha, sparse, sparse.GetNumCols(), dense, c);
+        else if (sparse.GetFormat() == matrixFormatSparseCSR)
+            MultiplyDenseAndSparse<ElemType, denseTimesSparse, denseTimesSparse ? transposeA : !transposeA, denseTimesSparse ? !transposeB : transposeB>::Accumulate(alpha, sparse, sparse.GetNumRows(), dense, c);
+        else
+            NOT_IMPLEMENTED;
+    }
 
-        // Loop over columns of the sparse matrix
-        for (size_t colSparse = 0; colSparse < sparse.GetNumCols(); colSparse++)
+    // c += alpha * product, where the sparse factor is read as a CSC matrix with 'numCols' columns.
+    // The output is split into tiles that are owned by one thread each, so no atomics are needed:
+    // * dense * sparse:     tiles of the sparse columns (= columns of c), cut by nonzero count
+    // * dense * sparse^T:   tiles of the rows of c
+    // * sparse * dense:     tiles of the columns of c
+    // * sparse^T * dense:   tiles of the sparse columns (= rows of c), cut by nonzero count
+    // The innermost loops run over contiguous memory wherever the layout permits it, so that the compiler can vectorize them.
+    static void Accumulate(ElemType alpha, const CPUSparseMatrix<ElemType>& sparse, size_t numCols, const CPUMatrix<ElemType>& dense, CPUMatrix<ElemType>& c)
+    {
+        const CPUSPARSE_INDEX_TYPE* secondaryIndex = sparse.SecondaryIndexLocation();
+        const size_t base = secondaryIndex[0];                                      // Total number of nonzero values in previous slices.
+        const ElemType* valueBuffer = sparse.Buffer() + base;                        // Points to the value buffer of the current view.
+        const CPUSPARSE_INDEX_TYPE* rowIndexBuffer = sparse.MajorIndexLocation();   // Points to the index buffer of the current view.
+        const size_t nz = secondaryIndex[numCols] - base;
+
+        const ElemType* denseData = dense.Data();
+        const size_t ldDense = dense.GetNumRows();
+        ElemType* cData = c.Data();
+        const size_t ldC = c.GetNumRows();
+        const size_t m = c.GetNumRows();
+        const size_t n = c.GetNumCols();
+
+        // Below if-statements are evaluated at compile time.
+        if (denseTimesSparse && !transposeB)
+        {
+            // c[:, j] += alpha * sum_p val_p * op(dense)[:, row_p]
+            vector<size_t> bounds;
+            PartitionByNonzeros(secondaryIndex, numCols, SparseNumTiles(nz * m, numCols), bounds);
+#pragma omp parallel for if (bounds.size() > 2)
+            for (long t = 0; t < (long)bounds.size() - 1; t++)
+            {
+                for (size_t j = bounds[t]; j < bounds[t + 1]; j++)
+                {
+                    ElemType* cCol = cData + j * ldC;
+                    for (size_t p = secondaryIndex[j] - base; p < secondaryIndex[j + 1] - base; p++)
+                    {
+                        const ElemType scale = alpha * valueBuffer[p];
+                        const size_t row = rowIndexBuffer[p];
+                        if (!transposeA)
+                        {
+                            const ElemType* denseCol = denseData + row * ldDense;
+                            for (size_t i = 0; i < m; i++)
+                                cCol[i] += scale * denseCol[i];
+                        }
+                        else
+                        {
+                            for (size_t i = 0; i < m; i++)
+                                cCol[i] += scale * denseData[i * ldDense + row];
+                        }
+                    }
+                }
+            }
+        }
+        else if (denseTimesSparse && transposeB)
         {
-            size_t numNonzeroInSparseCol = sparse.SecondaryIndexLocation()[colSparse + 1] - numPreviosNonzero;
-            // Loop over the nonzero rows of the current column of the sparse matrix
-            for (; iNonzero < numNonzeroInSparseCol; iNonzero++)
+            // c[:, row_p] += alpha * val_p * op(dense)[:, j]
+            const size_t numTiles = SparseNumTiles(nz * m, max((size_t)1, m / 16));
+#pragma omp parallel for if (numTiles > 1)
+            for (long t = 0; t < (long)numTiles; t++)
             {
-                size_t rowSparse = rowIndexBuffer[iNonzero]; // RowLocation
-                ElemType sparseVal = valueBuffer[iNonzero];
-
-                // Determine the index of the 'outer' dimension of the sparse matrix and the common inner index.
-                size_t outerIndexSparse;
-                size_t innerIndex;
-                // Below if-statements are evaluated at compile time.
-                if      ( denseTimesSparse && !transposeB) { outerIndexSparse = colSparse; innerIndex = rowSparse; }
-                else if ( denseTimesSparse &&  transposeB) { outerIndexSparse = rowSparse; innerIndex = colSparse; }
-                else if (!denseTimesSparse && !transposeA) { outerIndexSparse = rowSparse; innerIndex = colSparse; }
-                else if (!denseTimesSparse &&  transposeA) { outerIndexSparse = colSparse; innerIndex = rowSparse; }
-
-                // Loop over the outer index of the dense matrix
-                for (size_t outerIndexDense = 0; outerIndexDense < outerDimensionDense; outerIndexDense++)
+                const size_t begin = m * t / numTiles;
+                const size_t end = m * (t + 1) / numTiles;
+                for (size_t j = 0; j < numCols; j++)
                 {
-                    // Determine the row index of the dense input matrix.
-                    // Below if-statements are evaluated at compile time.
-                    ElemType denseVal;
-                    if      ( denseTimesSparse && !transposeA) denseVal = dense(outerIndexDense,      innerIndex);
-                    else if ( denseTimesSparse &&  transposeA) denseVal = dense(     innerIndex, outerIndexDense);
-                    else if (!denseTimesSparse && !transposeB) denseVal = dense(     innerIndex, outerIndexDense);
-                    else if (!denseTimesSparse &&  transposeB) denseVal = dense(outerIndexDense,      innerIndex);
-
-
-                    // Update matrix c.
-                    if (denseTimesSparse)
-                        c(outerIndexDense, outerIndexSparse) += alpha * denseVal * sparseVal;
-                    else /*Sparse times dense */
-                        c(outerIndexSparse, outerIndexDense) += alpha * denseVal * sparseVal;
+                    for (size_t p = secondaryIndex[j] - base; p < secondaryIndex[j + 1] - base; p++)
+                    {
+                        const ElemType scale = alpha * valueBuffer[p];
+                        ElemType* cCol = cData + rowIndexBuffer[p] * ldC;
+                        if (!transposeA)
+                        {
+                            const ElemType* denseCol = denseData + j * ldDense;
+                            for (size_t i = begin; i < end; i++)
+                                cCol[i] += scale * denseCol[i];
+                        }
+                        else
+                        {
+                            for (size_t i = begin; i < end; i++)
+                                cCol[i] += scale * denseData[i * ldDense + j];
+                        }
+                    }
+                }
+            }
+        }
+        else if (!denseTimesSparse && !transposeA)
+        {
+            // c[row_p, :] += alpha * val_p * op(dense)[j, :]
+            const size_t numTiles = SparseNumTiles(nz * n, n);
+#pragma omp parallel for if (numTiles > 1)
+            for (long t = 0; t < (long)numTiles; t++)
+            {
+                for (size_t col = n * t / numTiles; col < n * (t + 1) / numTiles; col++)
+                {
+                    ElemType* cCol = cData + col * ldC;
+                    for (size_t j = 0; j < numCols; j++)
+                    {
+                        const ElemType denseVal = transposeB ? denseData[j * ldDense + col] : denseData[col * ldDense + j];
+                        if (denseVal == 0)
+                            continue;
+                        const ElemType scale = alpha * denseVal;
+                        for (size_t p = secondaryIndex[j] - base; p < secondaryIndex[j + 1] - base; p++)
+                            cCol[rowIndexBuffer[p]] += scale * valueBuffer[p];
+                    }
+                }
+            }
+        }
+        else /* !denseTimesSparse && transposeA */
+        {
+            // c[j, :] += alpha * sum_p val_p * op(dense)[row_p, :]
+            vector<size_t> bounds;
+            PartitionByNonzeros(secondaryIndex, numCols, SparseNumTiles(nz * n, numCols), bounds);
+#pragma omp parallel for if (bounds.size() > 2)
+            for (long t = 0; t < (long)bounds.size() - 1; t++)
+            {
+                for (size_t col = 0; col < n; col++)
+                {
+                    ElemType* cCol = cData + col * ldC;
+                    for (size_t j = bounds[t]; j < bounds[t + 1]; j++)
+                    {
+                        ElemType sum = 0;
+                        for (size_t p = secondaryIndex[j] - base; p < secondaryIndex[j + 1] - base; p++)
+                        {
+                            const size_t row = rowIndexBuffer[p];
+                            sum += valueBuffer[p] * (transposeB ? denseData[row * ldDense + col] : denseData[col * ldDense + row]);
+                        }
+                        cCol[j] += alpha * sum;
+                    }
                 }
             }
         }
@@ -1092,76 +1437,89 @@ void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<E
         InvalidArgument("CPUSparseMatrix::MultiplyAndAdd: The inner dimensions of a (= %lu) and b (= %lu) don't match.", k, l);
     }
 
-    if (!transposeA && !transposeB)
-    {
+    if (rhs.GetFormat() != matrixFormatSparseCSC && rhs.GetFormat() != matrixFormatSparseCSR)
         NOT_IMPLEMENTED;
-    }
-    else if (!transposeA && transposeB)
-    {
-        if (rhs.GetFormat() != matrixFormatSparseCSC)
-            NOT_IMPLEMENTED;
 
-        // allocate enough memory
-        c.SetFormat(matrixFormatSparseBlockCol);
-        size_t blockSizePrev = c.GetBlockSize();
+    // rhs is read as a CSC matrix (a CSR matrix is stored like the CSC representation of its transpose). Its nonzero
+    // in column j and row 'row' adds op(lhs)[:, inner] to the column 'outer' of the result, where (outer, inner) is
+    // (row, j) if the CSC matrix is transposed in the product, and (j, row) otherwise.
+    const bool transposeCSC = (rhs.GetFormat() == matrixFormatSparseCSR) ? !transposeB : transposeB;
+    const size_t numCompressed = (rhs.GetFormat() == matrixFormatSparseCSC) ? rhs.GetNumCols() : rhs.GetNumRows();
+    const CPUSPARSE_INDEX_TYPE* secondaryIndex = rhs.SecondaryIndexLocation();
+    const size_t base = secondaryIndex[0];
+    const ElemType* valueBuffer = rhs.Buffer() + base;
+    const CPUSPARSE_INDEX_TYPE* majorIndex = rhs.MajorIndexLocation();
+    const size_t nz = secondaryIndex[numCompressed] - base;
 
-        if (blockSizePrev == 0)
-        {
-            c.RequireSizeAndAllocate(m, n, 0, true); // allocate for blockIds
-        }
+    // allocate enough memory
+    c.SetFormat(matrixFormatSparseBlockCol);
+    size_t blockSizePrev = c.GetBlockSize();
 
-        map<size_t, size_t> col2BlockId;
-        for (size_t blockId = 0; blockId < blockSizePrev; blockId++)
-        {
-            col2BlockId[c.GetBlockIds()[blockId]] = blockId;
-        }
+    if (blockSizePrev == 0)
+    {
+        c.RequireSizeAndAllocate(m, n, 0, true); // allocate for blockIds
+    }
 
-        size_t blockSizeCurr = blockSizePrev;
-        for (size_t rhsNz = 0; rhsNz < rhs.NzCount(); rhsNz++)
+    vector<size_t> col2BlockId(n, SIZE_MAX);
+    for (size_t blockId = 0; blockId < blockSizePrev; blockId++)
+    {
+        col2BlockId[c.GetBlockIds()[blockId]] = blockId;
+    }
+
+    size_t blockSizeCurr = blockSizePrev;
+    for (size_t j = 0; j < numCompressed; j++)
+    {
+        for (size_t p = secondaryIndex[j] - base; p < secondaryIndex[j + 1] - base; p++)
         {
-            size_t resultCol = rhs.MajorIndexLocation()[rhsNz];
-            if (col2BlockId.find(resultCol) == col2BlockId.end())
+            size_t resultCol = transposeCSC ? majorIndex[p] : j;
+            if (col2BlockId[resultCol] == SIZE_MAX)
             {
                 col2BlockId[resultCol] = blockSizeCurr;
                 c.GetBlockIds()[blockSizeCurr] = resultCol;
-                blockSizeCurr ++;
+                blockSizeCurr++;
             }
         }
+    }
 
-        if (blockSizeCurr > blockSizePrev)
-        {
-            c.RequireSizeAndAllocate(m, n, m * blockSizeCurr, true, true);
-            c.SetBlockSize(blockSizeCurr);
-            memset(c.Data() + m * blockSizePrev, 0, sizeof(ElemType) * m * (blockSizeCurr - blockSizePrev));
-        }
+    if (blockSizeCurr > blockSizePrev)
+    {
+        c.RequireSizeAndAllocate(m, n, m * blockSizeCurr, true, true);
+        c.SetBlockSize(blockSizeCurr);
+        memset(c.Data() + m * blockSizePrev, 0, sizeof(ElemType) * m * (blockSizeCurr - blockSizePrev));
+    }
 
-        for (size_t rhsCol = 0; rhsCol < rhs.GetNumCols(); rhsCol++)
+    // Several nonzeros can update the same block, so every thread owns a range of rows of all blocks.
+    const ElemType* lhsData = lhs.Data();
+    const size_t ldLhs = lhs.GetNumRows();
+    ElemType* resultData = c.Buffer();
+    const size_t numTiles = SparseNumTiles(nz * m, max((size_t)1, m / 16));
+#pragma omp parallel for if (numTiles > 1)
+    for (long t = 0; t < (long)numTiles; t++)
+    {
+        const size_t begin = m * t / numTiles;
+        const size_t end = m * (t + 1) / numTiles;
+        for (size_t j = 0; j < numCompressed; j++)
         {
-            size_t start = rhs.SecondaryIndexLocation()[rhsCol];
-            size_t end = rhs.SecondaryIndexLocation()[rhsCol + 1];
-
-            for (size_t p = start; p < end; p++)
+            for (size_t p = secondaryIndex[j] - base; p < secondaryIndex[j + 1] - base; p++)
             {
-                size_t rhsRow = rhs.MajorIndexLocation()[p];
-                ElemType val = rhs.Buffer()[p];
-
-                ElemType* results = c.Buffer() + col2BlockId[rhsRow] * m;
-                #pragma omp parallel for
-                for (int lhsRow = 0; lhsRow < (int)m; lhsRow++)
+                const size_t resultCol = transposeCSC ? majorIndex[p] : j;
+                const size_t inner = transposeCSC ? j : majorIndex[p];
+                const ElemType scale = alpha * valueBuffer[p];
+                ElemType* results = resultData + col2BlockId[resultCol] * m;
+                if (!transposeA)
+                {
+                    const ElemType* lhsCol = lhsData + inner * ldLhs;
+                    for (size_t i = begin; i < end; i++)
+                        results[i] += scale * lhsCol[i];
+                }
+                else
                 {
-                    results[lhsRow] += alpha * lhs((size_t)lhsRow, rhsCol) * val;
+                    for (size_t i = begin; i < end; i++)
+                        results[i] += scale * lhsData[i * ldLhs + inner];
                 }
             }
         }
     }
-    else if (transposeA && !transposeB)
-    {
-        NOT_IMPLEMENTED;
-    }
-    else
-    {
-        NOT_IMPLEMENTED;
-    }
 }
 
 // c[:,j] = alpha * v[j] * a[:,j] + beta * c[:,j]
@@ -1171,7 +1529,7 @@ void CPUSparseMatrix<ElemType>::ColumnwiseScaleAndWeightedAdd(ElemType alpha, co
     if (v.GetNumRows() != 1 && v.GetNumCols() != 1)
         InvalidArgument("the argument v must be a vector"); // v is a vector
 
-    if (a.GetFormat() != matrixFormatSparseCSC)
+    if (a.GetFormat() != matrixFormatSparseCSC && a.GetFormat() != matrixFormatSparseCSR)
         NOT_IMPLEMENTED;
 
     if (beta == 0)
@@ -1183,17 +1541,22 @@ void CPUSparseMatrix<ElemType>::ColumnwiseScaleAndWeightedAdd(ElemType alpha, co
         c.VerifySize(a.GetNumRows(), a.GetNumCols()); // Can't resize if beta != 0
 
     const ElemType* vd = v.Data();
-
+    const bool isCSC = (a.GetFormat() == matrixFormatSparseCSC);
+    const size_t numCompressed = isCSC ? a.GetNumCols() : a.GetNumRows();
+    const CPUSPARSE_INDEX_TYPE* secondaryIndex = a.SecondaryIndexLocation();
+    const size_t base = secondaryIndex[0];
+    const ElemType* valueBuffer = a.Buffer() + base;
+    const CPUSPARSE_INDEX_TYPE* majorIndex = a.MajorIndexLocation();
+
+    // Every column (CSC) or row (CSR) of a maps to distinct elements of c.
 #pragma omp parallel for
-    for (long col = 0; col < (long)a.GetNumCols(); col++)
+    for (long j = 0; j < (long)numCompressed; j++)
     {
-        auto start = a.SecondaryIndexLocation()[col];
-        auto end = a.SecondaryIndexLocation()[col + 1];
-
-        for (auto p = start; p < end; p++)
+        for (size_t p = secondaryIndex[j] - base; p < secondaryIndex[j + 1] - base; p++)
         {
-            auto row = a.MajorIndexLocation()[p];
-            ElemType val = a.Buffer()[p];
+            size_t row = isCSC ? majorIndex[p] : j;
+            size_t col = isCSC ? j : majorIndex[p];
+            ElemType val = valueBuffer[p];
 
             if (beta == 0) // don't even read the memory if beta is 0
                 c(row, col) = alpha * vd[col] * val;
@@ -1215,19 +1578,24 @@ void CPUSparseMatrix<ElemType>::Scale(const ElemType alpha, CPUSparseMatrix<Elem
     if (rhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC || rhs.GetFormat() == MatrixFormat::matrixFormatSparseCSR)
     {
         size_t col_num = (rhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC) ? rhs.GetNumCols() : rhs.GetNumRows();
-        size_t start = rhs.SecondaryIndexLocation()[0];
-        size_t end = rhs.SecondaryIndexLocation()[col_num];
-        for (size_t p = start; p < end; p++)
+        long start = (long)rhs.SecondaryIndexLocation()[0];
+        long end = (long)rhs.SecondaryIndexLocation()[col_num];
+        ElemType* values = rhs.Buffer();
+#pragma omp parallel for if (end - start > (long)c_sparseMinWorkPerTile)
+        for (long p = start; p < end; p++)
         {
-            rhs.Buffer()[p] *= alpha;
+            values[p] *= alpha;
         }
     }
     else if (rhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockCol || rhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockRow)
     {
         size_t len = (rhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockCol) ? rhs.GetNumRows() : rhs.GetNumCols();
-        for (size_t p = 0; p < rhs.GetBlockSize() * len; p++)
+        long size = (long)(rhs.GetBlockSize() * len);
+        ElemType* values = rhs.Buffer();
+#pragma omp parallel for if (size > (long)c_sparseMinWorkPerTile)
+        for (long p = 0; p < size; p++)
         {
-            rhs.Buffer()[p] *= alpha;
+            values[p] *= alpha;
         }
     }
 }
@@ -1248,24 +1616,31 @@ void CPUSparseMatrix<ElemType>::ScaleAndAdd(const ElemType alpha, const CPUSpars
 
     if (lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC || lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSR)
     {
-        size_t col_num = (lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC) ? lhs.GetNumCols() : lhs.GetNumRows();
-        for (size_t j = 0; j < col_num; j++)
+        const bool isCSC = (lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC);
+        size_t col_num = isCSC ? lhs.GetNumCols() : lhs.GetNumRows();
+        const CPUSPARSE_INDEX_TYPE* secondaryIndex = lhs.SecondaryIndexLocation();
+        const size_t base = secondaryIndex[0];
+        const ElemType* valueBuffer = lhs.Buffer() + base;
+        const CPUSPARSE_INDEX_TYPE* majorIndex = lhs.MajorIndexLocation();
+        // Distinct columns (rows) of a CSC (CSR) matrix update distinct elements.
+#pragma omp parallel for if (secondaryIndex[col_num] - base > c_sparseMinWorkPerTile)
+        for (long j = 0; j < (long)col_num; j++)
         {
-            size_t start = lhs.SecondaryIndexLocation()[j];
-            size_t end = lhs.SecondaryIndexLocation()[j + 1];
-            for (size_t p = start; p < end; p++)
+            for (size_t p = secondaryIndex[j] - base; p < secondaryIndex[j + 1] - base; p++)
             {
-                size_t i = lhs.MajorIndexLocation()[p];
-                ElemType val = lhs.Buffer()[p];
-                size_t r = (lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC) ? i : j;
-                size_t c = (lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC) ? j : i;
+                size_t i = majorIndex[p];
+                ElemType val = valueBuffer[p];
+                size_t r = isCSC ? i : j;
+                size_t c = isCSC ? j : i;
                 rhs(r, c) += alpha * val;
             }
         }
     }
     else if (lhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockCol || lhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockRow)
     {
-        for (size_t j = 0; j < lhs.GetBlockSize(); j++)
+        // Every block maps to a distinct column (row).
+#pragma omp parallel for
+        for (long j = 0; j < (long)lhs.GetBlockSize(); j++)
         {
             size_t i = lhs.GetBlockIds()[j] - lhs.GetBlockIdShift();
             size_t len = (lhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockCol) ? lhs.GetNumRows() : lhs.GetNumCols();
@@ -1326,46 +1701,186 @@ void CPUSparseMatrix<ElemType>::InnerProduct(const CPUSparseMatrix<ElemType>& a,
     if (m != k || n != l)
         InvalidArgument("InnerProduct: Matrices a and b should have same dimension.");
 
+    if (a.GetFormat() != matrixFormatSparseCSC && a.GetFormat() != matrixFormatSparseCSR)
+        NOT_IMPLEMENTED;
+
     if (isColWise) // col-wise
-    {
         c.RequireSize(1, n);
+    else
+        c.RequireSize(m, 1);
+
+    const bool isCSC = (a.GetFormat() == matrixFormatSparseCSC);
+    const size_t numCompressed = isCSC ? n : m;
+    const CPUSPARSE_INDEX_TYPE* secondaryIndex = a.SecondaryIndexLocation();
+    const size_t base = secondaryIndex[0];
+    const ElemType* valueBuffer = a.Buffer() + base;
+    const CPUSPARSE_INDEX_TYPE* majorIndex = a.MajorIndexLocation();
+    ElemType* result = c.Data();
 
+    if (isColWise == isCSC)
+    {
+        // one sum per column (CSC) or row (CSR) of a
 #pragma omp parallel for
-        foreach_column(j, c)
+        for (long j = 0; j < (long)numCompressed; j++)
         {
             ElemType sum = 0;
-            for (CPUSPARSE_INDEX_TYPE iRow = a.ColLocation()[j]; iRow < a.ColLocation()[j+1]; ++iRow)
+            for (size_t p = secondaryIndex[j] - base; p < secondaryIndex[j + 1] - base; p++)
             {
-                size_t row = a.RowLocation()[iRow];
-                sum += a.Data()[iRow] * b(row, j);
+                size_t i = majorIndex[p];
+                sum += valueBuffer[p] * (isCSC ? b(i, j) : b(j, i));
             }
-            c(0, j) = sum;
+            result[j] = sum;
         }
     }
     else
     {
-        c.RequireSize(m, 1);
-
-#pragma omp parallel for
-        foreach_row(i, c)
+        // The sums are over the major index, so every thread owns a range of the results and skips the other nonzeros.
+        const size_t numMajor = isCSC ? m : n;
+        const size_t numTiles = SparseNumTiles(secondaryIndex[numCompressed] - base, numMajor);
+        memset(result, 0, sizeof(ElemType) * numMajor);
+#pragma omp parallel for if (numTiles > 1)
+        for (long t = 0; t < (long)numTiles; t++)
         {
-            ElemType sum = 0;
-            for(CPUSPARSE_INDEX_TYPE j = 0; j < n; ++j)
+            const size_t begin = numMajor * t / numTiles;
+            const size_t end = numMajor * (t + 1) / numTiles;
+            for (size_t j = 0; j < numCompressed; j++)
             {
-                for (CPUSPARSE_INDEX_TYPE iRow = a.ColLocation()[j]; iRow < a.ColLocation()[j + 1]; ++iRow)
+                for (size_t p = secondaryIndex[j] - base; p < secondaryIndex[j + 1] - base; p++)
                 {
-                    if (a.RowLocation()[iRow] == i)
-                    {
-                        sum += a.Data()[iRow] * b(i, j);
-                        break;
-                    }
+                    size_t i = majorIndex[p];
+                    if (i >= begin && i < end)
+                        result[i] += valueBuffer[p] * (isCSC ? b(i, j) : b(j, i));
                 }
             }
-            c(i, 0) = sum;
         }
     }
 }
 
+// sum(vec(a).*vec(b))
+template <class ElemType>
+ElemType CPUSparseMatrix<ElemType>::InnerProductOfMatrices(const CPUSparseMatrix<ElemType>& a, const CPUMatrix<ElemType>& b)
+{
+    if (a.IsEmpty() || b.IsEmpty())
+        LogicError("InnerProductOfMatrices:  one of the input matrices is empty.");
+
+    if (a.GetNumRows() != b.GetNumRows() || a.GetNumCols() != b.GetNumCols())
+        InvalidArgument("InnerProductOfMatrices: Matrices a and b should have same dimension.");
+
+    if (a.GetFormat() != matrixFormatSparseCSC && a.GetFormat() != matrixFormatSparseCSR)
+        NOT_IMPLEMENTED;
+
+    const bool isCSC = (a.GetFormat() == matrixFormatSparseCSC);
+    const size_t numCompressed = isCSC ? a.GetNumCols() : a.GetNumRows();
+    const CPUSPARSE_INDEX_TYPE* secondaryIndex = a.SecondaryIndexLocation();
+    const size_t base = secondaryIndex[0];
+    const ElemType* valueBuffer = a.Buffer() + base;
+    const CPUSPARSE_INDEX_TYPE* majorIndex = a.MajorIndexLocation();
+
+    // accumulate in double, the omp reduction is only supported for built-in types
+    double sum = 0;
+#pragma omp parallel for reduction(+ : sum) if (secondaryIndex[numCompressed] - base > c_sparseMinWorkPerTile)
+    for (long j = 0; j < (long)numCompressed; j++)
+    {
+        for (size_t p = secondaryIndex[j] - base; p < secondaryIndex[j + 1] - base; p++)
+        {
+            size_t i = majorIndex[p];
+            sum += (double)(valueBuffer[p] * (isCSC ? b(i, j) : b(j, i)));
+        }
+    }
+    return (ElemType)sum;
+}
+
+// Softmax cross-entropy with one-hot (or otherwise sparse) labels: the normalizers need a pass over the logits,
+// the cross-entropy itself only touches the logits of the nonzero labels.
+template <class ElemType>
+ElemType CPUSparseMatrix<ElemType>::SoftmaxCrossEntropy(const CPUSparseMatrix<ElemType>& labels, const CPUMatrix<ElemType>& logits, CPUMatrix<ElemType>& logSumExp)
+{
+    if (labels.GetNumRows() != logits.GetNumRows() || labels.GetNumCols() != logits.GetNumCols())
+        InvalidArgument("SoftmaxCrossEntropy: labels and logits must have the same dimension.");
+    if (labels.GetFormat() != matrixFormatSparseCSC && labels.GetFormat() != matrixFormatSparseCSR)
+        NOT_IMPLEMENTED;
+
+    logSumExp.AssignLogSumExpOfColumns(logits);
+    if (labels.IsEmpty())
+        return 0;
+
+    const bool isCSC = (labels.GetFormat() == matrixFormatSparseCSC);
+    const long numLines = (long)(isCSC ? labels.GetNumCols() : labels.GetNumRows());
+    const CPUSPARSE_INDEX_TYPE* secondaryIndex = labels.SecondaryIndexLocation();
+    const size_t base = secondaryIndex[0];
+    const ElemType* valueBuffer = labels.Buffer() + base;
+    const CPUSPARSE_INDEX_TYPE* majorIndex = labels.MajorIndexLocation();
+
+    double crossEntropy = 0;
+#pragma omp parallel for reduction(+ : crossEntropy) if (secondaryIndex[numLines] - base > c_sparseMinWorkPerTile)
+    for (long k = 0; k < numLines; k++)
+    {
+        for (size_t p = secondaryIndex[k] - base; p < secondaryIndex[k + 1] - base; p++)
+        {
+            size_t i = isCSC ? majorIndex[p] : (size_t)k;
+            size_t j = isCSC ? (size_t)k : majorIndex[p];
+            crossEntropy += (double)(valueBuffer[p] * (logSumExp(0, j) - logits(i, j)));
+        }
+    }
+    return (ElemType)crossEntropy;
+}
+
+// c += alpha * (softmax(logits) - labels): the dense softmax, then the labels are scattered into c
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::AddSoftmaxCrossEntropyGradient(ElemType alpha, const CPUMatrix<ElemType>& logits, const CPUMatrix<ElemType>& logSumExp,
+                                                               const CPUSparseMatrix<ElemType>& labels, CPUMatrix<ElemType>& c)
+{
+    if (labels.GetNumRows() != logits.GetNumRows() || labels.GetNumCols() != logits.GetNumCols())
+        InvalidArgument("AddSoftmaxCrossEntropyGradient: labels and logits must have the same dimension.");
+
+    CPUMatrix<ElemType>::AddScaledSoftmaxOf(alpha, logits, logSumExp, c);
+    if (!labels.IsEmpty())
+        ScaleAndAdd(-alpha, labels, c);
+}
+
+// c += alpha * (a - b), with c = alpha * (a - b) if bDefaultZero
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::AddScaledDifference(const ElemType alpha, const CPUSparseMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c,
+                                                    bool bDefaultZero)
+{
+    if (a.GetNumRows() != b.GetNumRows() || a.GetNumCols() != b.GetNumCols())
+        InvalidArgument("AddScaledDifference: a and b must have the same dimension.");
+
+    if (bDefaultZero)
+    {
+        c.RequireSize(b.GetNumRows(), b.GetNumCols());
+        c.SetValue((ElemType)0);
+    }
+    else if (c.GetNumRows() != b.GetNumRows() || c.GetNumCols() != b.GetNumCols())
+        InvalidArgument("AddScaledDifference: c must have the same dimension as a and b.");
+
+    // the dense part first, then the nonzeros of a are scattered into c
+    CPUMatrix<ElemType>::ScaleAndAdd(-alpha, b, c);
+    if (!a.IsEmpty())
+        ScaleAndAdd(alpha, a, c);
+}
+
+// c += alpha * (a - b), with c = alpha * (a - b) if bDefaultZero
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::AddScaledDifference(const ElemType alpha, const CPUMatrix<ElemType>& a, const CPUSparseMatrix<ElemType>& b, CPUMatrix<ElemType>& c,
+                                                    bool bDefaultZero)
+{
+    if (a.GetNumRows() != b.GetNumRows() || a.GetNumCols() != b.GetNumCols())
+        InvalidArgument("AddScaledDifference: a and b must have the same dimension.");
+
+    if (bDefaultZero)
+    {
+        c.RequireSize(a.GetNumRows(), a.GetNumCols());
+        c.SetValue((ElemType)0);
+    }
+    else if (c.GetNumRows() != a.GetNumRows() || c.GetNumCols() != a.GetNumCols())
+        InvalidArgument("AddScaledDifference: c must have the same dimension as a and b.");
+
+    CPUMatrix<ElemType>::ScaleAndAdd(alpha, a, c);
+    if (!b.IsEmpty())
+        ScaleAndAdd(-alpha, b, c);
+}
+
 // A helper method used in MomentumSGDUpdate and NesterovAcceleratedMomentumSGDUpdate.
 // Modifies the smoothed gradients "c", as well as the current gradients "this" on which this method is invoked.
 // Classic momentum (unitGainFactor == 1.0):
@@ -1373,9 +1888,13 @@ void CPUSparseMatrix<ElemType>::InnerProduct(const CPUSparseMatrix<ElemType>& a,
 // Unit-gain momentum (unitGainFactor == 1.0 - momentum):
 // 1) c = momentum * c + (1.0 - momentum) * this
 // 2) this = c
+// If timestamps are given (block column format only), c is updated lazily: this is update T = decayHistory->NumUpdates(),
+// and a column of c that was last touched at timestamps[col] is first decayed by the momentums of the updates
+// timestamps[col] + 1 ... T - 1, i.e. by the decay the dense update would have applied in the meantime, and its
+// timestamp is then set to T.
 // TODO: NormalGrad is a misnomer here. Come up with a better name.
 template <class ElemType>
-void CPUSparseMatrix<ElemType>::NormalGrad(CPUMatrix<ElemType>& c, const ElemType momentum, const ElemType unitGainFactor)
+void CPUSparseMatrix<ElemType>::NormalGrad(CPUMatrix<ElemType>& c, const ElemType momentum, const ElemType unitGainFactor, int* timestamps, const LazyDecayHistory* decayHistory)
 {
     if (c.IsEmpty())
     {
@@ -1387,17 +1906,31 @@ void CPUSparseMatrix<ElemType>::NormalGrad(CPUMatrix<ElemType>& c, const ElemTyp
     if (GetFormat() == MatrixFormat::matrixFormatSparseBlockCol || GetFormat() == MatrixFormat::matrixFormatSparseBlockRow)
     {
         const auto isSparseBlockCol = (GetFormat() == MatrixFormat::matrixFormatSparseBlockCol);
-        for (size_t j = 0; j < GetBlockSize(); j++)
+        if (timestamps && !isSparseBlockCol)
+            LogicError("CPUSparseMatrix::NormalGrad(): timestamps are only supported for the block column format.");
+        if (timestamps && !decayHistory)
+            LogicError("CPUSparseMatrix::NormalGrad(): timestamps require a decay history.");
+        const int currentTimestamp = timestamps ? decayHistory->NumUpdates() : 0;
+
+        const size_t len = (isSparseBlockCol) ? GetNumRows() : GetNumCols();
+        // Every block maps to a distinct column (row), so the blocks can be processed in parallel.
+#pragma omp parallel for
+        for (long j = 0; j < (long)GetBlockSize(); j++)
         {
             size_t i = GetBlockIds()[j] - GetBlockIdShift();
-            size_t len = (isSparseBlockCol) ? GetNumRows() : GetNumCols();
+            ElemType decayedMomentum = momentum;
+            if (timestamps)
+            {
+                decayedMomentum *= (ElemType)decayHistory->Decay(0, timestamps[i], currentTimestamp - 1);
+                timestamps[i] = currentTimestamp;
+            }
             size_t start = j * len;
             for (size_t p = start; p < start + len; p++)
             {
                 ElemType val = Buffer()[p];
                 size_t row = (isSparseBlockCol) ? (p - start) : i;
                 size_t col = (isSparseBlockCol) ? i : (p - start);
-                c(row, col) = unitGainFactor * val + momentum * c(row, col);
+                c(row, col) = unitGainFactor * val + decayedMomentum * c(row, col);
                 Buffer()[p] = c(row, col);
             }
         }
@@ -1450,10 +1983,13 @@ ElemType CPUSparseMatrix<ElemType>::Adagrad(CPUMatrix<ElemType>& c, const bool n
     else if (GetFormat() == MatrixFormat::matrixFormatSparseBlockCol || GetFormat() == MatrixFormat::matrixFormatSparseBlockRow)
     {
         size_t len = (GetFormat() == MatrixFormat::matrixFormatSparseBlockCol) ? GetNumRows() : GetNumCols();
-        size_t p = 0;
-        for (long j = 0; j < GetBlockSize(); j++)
+        // Every block maps to a distinct column (row), so the blocks can be processed in parallel.
+        double blockAveMultiplier = 0;
+#pragma omp parallel for reduction(+ : blockAveMultiplier)
+        for (long j = 0; j < (long)GetBlockSize(); j++)
         {
             size_t colOrRow = GetBlockIds()[j] - GetBlockIdShift();
+            size_t p = j * len;
             for (long i = 0; i < len; i++, p++)
             {
                 ElemType val = Buffer()[p];
@@ -1465,9 +2001,10 @@ ElemType CPUSparseMatrix<ElemType>::Adagrad(CPUMatrix<ElemType>& c, const bool n
                 Buffer()[p] /= a;
 
                 if (needAveMultiplier)
-                    aveMultiplier += 1 / a;
+                    blockAveMultiplier += (double)(1 / a);
             }
         }
+        aveMultiplier = (ElemType)blockAveMultiplier;
     }
 
     size_t nz = NzCount();
@@ -1477,6 +2014,144 @@ ElemType CPUSparseMatrix<ElemType>::Adagrad(CPUMatrix<ElemType>& c, const bool n
         return 1;
 }
 
+// Sparse counterpart of CPUMatrix::FSAdagrad(): only the columns present in the gradient are touched.
+// c holds the two logical buffers smoothAda and smoothMom (buffers 0 and 1 of the decay history); see NormalGrad()
+// for the meaning of the timestamps.
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::FSAdagrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample,
+                                          ElemType momentum, ElemType adaWeight, ElemType adaMul, ElemType unitGainFactor,
+                                          int* timestamps, const LazyDecayHistory* decayHistory)
+{
+    size_t numColsNeeded = 2 * GetNumCols();
+
+    if (c.IsEmpty() || (c.GetNumCols() < numColsNeeded))
+    {
+        c.RequireSize(GetNumRows(), numColsNeeded);
+        c.SetValue(0.0);
+    }
+
+    if (c.GetNumRows() != GetNumRows() || c.GetNumCols() != numColsNeeded)
+        LogicError("The matrix gradients does not have expected dimensions.");
+
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+        LogicError("Unsupported sparse format.");
+
+    size_t n = GetNumElements();
+    ElemType* grad = Data();
+    ElemType* smoothAda = c.Data();
+    ElemType* smoothMom = c.Data() + n;
+    ElemType* val = functionValues.Data();
+    auto rows = GetNumRows();
+    if (timestamps && !decayHistory)
+        LogicError("Timestamps require a decay history.");
+    const int currentTimestamp = timestamps ? decayHistory->NumUpdates() : 0;
+
+#pragma omp parallel for
+    for (long blockid = 0; blockid < (long)GetBlockSize(); ++blockid)
+    {
+        auto col = GetBlockIds()[blockid] - GetBlockIdShift();
+        auto columnOffset = col * rows;
+        auto blockOffset = blockid * rows;
+        ElemType adaDecay = 1, momDecay = 1;
+        if (timestamps)
+        {
+            adaDecay = (ElemType)decayHistory->Decay(0, timestamps[col], currentTimestamp - 1);
+            momDecay = (ElemType)decayHistory->Decay(1, timestamps[col], currentTimestamp - 1);
+            timestamps[col] = currentTimestamp;
+        }
+        for (size_t row = 0; row < rows; ++row)
+        {
+            size_t denseIndex = columnOffset + row;
+            ElemType g = grad[blockOffset + row];
+            ElemType adaSqr = adaWeight * adaDecay * smoothAda[denseIndex] + (1.0f - adaWeight) * g * g;
+            smoothAda[denseIndex] = adaSqr;
+            if (adaSqr != 0.0f)
+            {
+                ElemType ada = sqrt(adaSqr);
+                ElemType w = adaMul * ((ElemType) 1.0 / ada);
+
+                if (w > 10.0f)
+                    w = 10.0f;
+                g *= w;
+            }
+
+            if (momentum > 0.0f)
+            {
+                g = momentum * momDecay * smoothMom[denseIndex] + unitGainFactor * g;
+                smoothMom[denseIndex] = g;
+            }
+
+            g *= learnRatePerSample;
+            val[denseIndex] -= g;
+        }
+    }
+}
+
+// Sparse counterpart of CPUMatrix::Adam(), with the same layout of c as in FSAdagrad() above.
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::Adam(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample,
+                                     ElemType momentum, ElemType adaWeight, ElemType adaMul, ElemType epsilon, ElemType unitGainFactor, bool adamax,
+                                     int* timestamps, const LazyDecayHistory* decayHistory)
+{
+    size_t numColsNeeded = 2 * GetNumCols();
+
+    if (c.IsEmpty() || (c.GetNumCols() < numColsNeeded))
+    {
+        c.RequireSize(GetNumRows(), numColsNeeded);
+        c.SetValue(0.0);
+    }
+
+    if (c.GetNumRows() != GetNumRows() || c.GetNumCols() != numColsNeeded)
+        LogicError("The matrix gradients does not have expected dimensions.");
+
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+        LogicError("Unsupported sparse format.");
+
+    size_t n = GetNumElements();
+    ElemType* grad = Data();
+    ElemType* smoothAda = c.Data();
+    ElemType* smoothMom = c.Data() + n;
+    ElemType* val = functionValues.Data();
+    auto rows = GetNumRows();
+    if (timestamps && !decayHistory)
+        LogicError("Timestamps require a decay history.");
+    const int currentTimestamp = timestamps ? decayHistory->NumUpdates() : 0;
+
+#pragma omp parallel for
+    for (long blockid = 0; blockid < (long)GetBlockSize(); ++blockid)
+    {
+        auto col = GetBlockIds()[blockid] - GetBlockIdShift();
+        auto columnOffset = col * rows;
+        auto blockOffset = blockid * rows;
+        ElemType adaDecay = 1, momDecay = 1;
+        if (timestamps)
+        {
+            adaDecay = (ElemType)decayHistory->Decay(0, timestamps[col], currentTimestamp - 1);
+            momDecay = (ElemType)decayHistory->Decay(1, timestamps[col], currentTimestamp - 1);
+            timestamps[col] = currentTimestamp;
+        }
+        for (size_t row = 0; row < rows; ++row)
+        {
+            size_t denseIndex = columnOffset + row;
+            ElemType g = grad[blockOffset + row];
+            ElemType ada;
+            if (!adamax)
+            {
+                ElemType adaSqr = adaWeight * adaDecay * smoothAda[denseIndex] + (1.0f - adaWeight) * g * g;
+                smoothAda[denseIndex] = adaSqr;
+                ada = sqrt(adaSqr);
+            }
+            else
+                ada = smoothAda[denseIndex] = std::max(adaWeight * adaDecay * smoothAda[denseIndex], (ElemType)fabs((double)g));
+
+            ElemType w = adaMul * (ElemType)(1.0 / (ada + epsilon));
+            g = momentum * momDecay * smoothMom[denseIndex] + unitGainFactor * g;
+            smoothMom[denseIndex] = g;
+            val[denseIndex] -= g * w * learnRatePerSample;
+        }
+    }
+}
+
 template <class ElemType>
 template <class AccumType>
 void CPUSparseMatrix<ElemType>::AdaDelta(CPUMatrix<AccumType>& c, CPUMatrix<AccumType>& functionValues, AccumType learningRate, AccumType rho, AccumType epsilon, int* timestamps, int currentTimestamp)
@@ -1888,7 +2563,7 @@ template CPUSparseMatrix<char>::CPUSparseMatrix(CPUSparseMatrix<char> const&);
 template CPUSparseMatrix<char>::CPUSparseMatrix(CPUSparseMatrix<char>&&);
 template CPUSparseMatrix<char>& CPUSparseMatrix<char>::operator=(CPUSparseMatrix<char>&& moveFrom);
 template void CPUSparseMatrix<char>::SetValue(size_t, size_t, char);
-//template void CPUSparseMatrix<char>::SetValue(CPUMatrix<char> const&);
+template void CPUSparseMatrix<char>::SetValue(CPUMatrix<char> const&);
 //template void CPUSparseMatrix<char>::SetValue(GPUMatrix<char> const&);
 template void CPUSparseMatrix<char>::SetValue(CPUSparseMatrix<char> const&);
 //template void CPUSparseMatrix<char>::SetValue(GPUSparseMatrix<char> const&);
@@ -1913,7 +2588,7 @@ template CPUSparseMatrix<short>::CPUSparseMatrix(CPUSparseMatrix<short> const&);
 template CPUSparseMatrix<short>::CPUSparseMatrix(CPUSparseMatrix<short>&&);
 template CPUSparseMatrix<short>& CPUSparseMatrix<short>::operator=(CPUSparseMatrix<short>&& moveFrom);
 template void CPUSparseMatrix<short>::SetValue(size_t, size_t, short);
-//template void CPUSparseMatrix<short>::SetValue(CPUMatrix<short> const&);
+template void CPUSparseMatrix<short>::SetValue(CPUMatrix<short> const&);
 //template void CPUSparseMatrix<short>::SetValue(GPUMatrix<short> const&);
 template void CPUSparseMatrix<short>::SetValue(CPUSparseMatrix<short> const&);
 //template void CPUSparseMatrix<short>::SetValue(GPUSparseMatrix<short> const&);
@@ -21,6 +21,17 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Sparse matrix on the CPU, in CSC, CSR or block column (SBC) format.
+// CSC is the general purpose format. CSR is supported by the products, the elementwise reductions and the
+// conversions. The block formats are produced as gradients (MultiplyAndAdd) and are consumed only by the learners.
+// Intentionally not supported, and reported as NOT_IMPLEMENTED or LogicError:
+//  - ColumnSlice of a CSR matrix: its columns are not contiguous, so there is no view. Use AssignColumnSliceToDense.
+//  - DoGatherColumnsOf/DoScatterColumnsOf for anything but CSC.
+//  - block formats as a product operand, in InnerProduct(OfMatrices), ColumnwiseScaleAndWeightedAdd,
+//    SoftmaxCrossEntropy and in the file format, and SetValue from a block column slice view.
+//  - SetValue from GPU matrices: the copies across devices live in Matrix::AssignValuesOf(), so that this
+//    class does not depend on the GPU library.
+//  - everything in the block row format except allocation.
 template <class ElemType>
 class MATH_API CPUSparseMatrix : public BaseMatrix<ElemType>
 {
@@ -72,6 +83,8 @@ public:
 private:
     void ZeroInit();
     void CheckInit(const MatrixFormat format);
+    void SetDiagonalValueOfNonEmpty(const ElemType* values, size_t stride);
+    void AssignWeightedColumnSums(ElemType beta, const CPUSparseMatrix<ElemType>& a, const std::vector<std::vector<size_t>>& sources, ElemType alpha, bool keepGaps);
 
 public:
     explicit CPUSparseMatrix(const MatrixFormat format);
@@ -85,10 +98,8 @@ public:
 public:
 
     void SetValue(const size_t row, const size_t col, ElemType val);
-    //void SetValue(const CPUMatrix<ElemType>& /*val*/);
-    //void SetValue(const GPUMatrix<ElemType>& /*val*/);
+    void SetValue(const CPUMatrix<ElemType>& /*val*/); // keeps CSR, everything else becomes CSC
     void SetValue(const CPUSparseMatrix<ElemType>& /*val*/);
-    //void SetValue(const GPUSparseMatrix<ElemType>& /*val*/);
 
     void MaskColumnsValue(const CPUMatrix<char>& columnsMask, ElemType val, size_t numColsPerMaskEntry);
 
@@ -145,23 +156,20 @@ public:
     static bool AreEqual(const CPUSparseMatrix<ElemType>& a, const CPUSparseMatrix<ElemType>& b, const ElemType threshold = 1e-8);
 
     // sum(vec(a).*vec(b))
-    static ElemType InnerProductOfMatrices(const CPUSparseMatrix<ElemType>& /*a*/, const CPUMatrix<ElemType>& /*b*/)
-    {
-        NOT_IMPLEMENTED;
-    }
+    static ElemType InnerProductOfMatrices(const CPUSparseMatrix<ElemType>& a, const CPUMatrix<ElemType>& b);
 
     static void InnerProduct(const CPUSparseMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c, const bool isColWise);
 
-    static void AddScaledDifference(const ElemType /*alpha*/, const CPUSparseMatrix<ElemType>& /*a*/, const CPUMatrix<ElemType>& /*b*/, CPUMatrix<ElemType>& /*c*/,
-                                    bool /*bDefaultZero*/)
-    {
-        NOT_IMPLEMENTED;
-    }
-    static void AddScaledDifference(const ElemType /*alpha*/, const CPUMatrix<ElemType>& /*a*/, const CPUSparseMatrix<ElemType>& /*b*/, CPUMatrix<ElemType>& /*c*/,
-                                    bool /*bDefaultZero*/)
-    {
-        NOT_IMPLEMENTED;
-    }
+    // fused softmax cross-entropy with sparse labels, see Matrix::AssignSoftmaxCrossEntropyOf() and Matrix::AddSoftmaxCrossEntropyGradient()
+    static ElemType SoftmaxCrossEntropy(const CPUSparseMatrix<ElemType>& labels, const CPUMatrix<ElemType>& logits, CPUMatrix<ElemType>& logSumExp);
+    static void AddSoftmaxCrossEntropyGradient(ElemType alpha, const CPUMatrix<ElemType>& logits, const CPUMatrix<ElemType>& logSumExp,
+                                               const CPUSparseMatrix<ElemType>& labels, CPUMatrix<ElemType>& c);
+
+    // c += alpha * (a - b), or c = alpha * (a - b) if bDefaultZero
+    static void AddScaledDifference(const ElemType alpha, const CPUSparseMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c,
+                                    bool bDefaultZero);
+    static void AddScaledDifference(const ElemType alpha, const CPUMatrix<ElemType>& a, const CPUSparseMatrix<ElemType>& b, CPUMatrix<ElemType>& c,
+                                    bool bDefaultZero);
 
     int GetComputeDeviceId() const
     {
@@ -217,6 +225,21 @@ public:
 
             return 0;
         }
+        else if (GetFormat() == MatrixFormat::matrixFormatSparseCSR)
+        {
+            size_t start = SecondaryIndexLocation()[row];
+            size_t end = SecondaryIndexLocation()[row + 1];
+            for (size_t p = start; p < end; p++)
+            {
+                size_t j = MajorIndexLocation()[p];
+                if (j == col)
+                {
+                    return ((ElemType*)Buffer())[p];
+                }
+            }
+
+            return 0;
+        }
         else if (GetFormat() == MatrixFormat::matrixFormatSparseBlockCol)
         {
             for (size_t blockId = 0; blockId < GetBlockSize(); blockId++)
@@ -233,8 +256,16 @@ public:
     }
 
 public:
-    void NormalGrad(CPUMatrix<ElemType>& c, const ElemType momentum, ElemType unitGainFactor);
+    // The optional timestamps (one per column, block column format only) let the learners update the smoothed
+    // state lazily: the decay a dense update would have applied to a column since its last update is caught up
+    // from the decay history when the column is touched again. See CPUMatrix::LazyDecayFlushTimestamps() for
+    // bringing all columns up to date.
+    void NormalGrad(CPUMatrix<ElemType>& c, const ElemType momentum, ElemType unitGainFactor, int* timestamps = nullptr, const LazyDecayHistory* decayHistory = nullptr);
     ElemType Adagrad(CPUMatrix<ElemType>& c, const bool needAveMultiplier);
+    void FSAdagrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul, ElemType unitGainFactor,
+                   int* timestamps = nullptr, const LazyDecayHistory* decayHistory = nullptr);
+    void Adam(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul, ElemType epsilon, ElemType unitGainFactor, bool adamax,
+              int* timestamps = nullptr, const LazyDecayHistory* decayHistory = nullptr);
 
     template<typename AccumType>
     void AdaDelta(CPUMatrix<AccumType>& c, CPUMatrix<AccumType>& functionValues, AccumType learningRate, AccumType rho, AccumType epsilon, int* timestamps, int currentTimestamp);
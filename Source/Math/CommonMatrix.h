@@ -20,6 +20,9 @@
 #include <memory>
 #include <unordered_map>
 #include <map>
+#include <vector>
+#include <algorithm>
+#include <cmath>
 
 #pragma warning( disable: 4251 )
 typedef unsigned char byte;
@@ -51,6 +54,11 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 MATH_API void SetMathLibTraceLevel(int traceLevel);
 MATH_API int GetMathLibTraceLevel();
 
+// Enables timing of all eligible CPU convolution engines on first use (per geometry, minibatch size and thread count)
+// to pick the fastest. If cacheFilePath is not empty, the choices are stored in and reused from that file.
+MATH_API void SetCpuConvolutionAutotuning(bool enable, const std::wstring& cacheFilePath = L"");
+MATH_API bool IsCpuConvolutionAutotuningEnabled();
+
 inline bool IsGpu(DEVICEID_TYPE deviceId)
 {
     return deviceId > CPUDEVICE;
@@ -254,6 +262,93 @@ enum MatrixFlags
     matrixFlagSetValueOnDevice = 1 << bitPosSetValueOnDevice, // SetValue() call has a buffer that is already on the device
 };
 
+// -----------------------------------------------------------------------
+// LazyDecayHistory -- decay rates of a learner state that is updated lazily
+// The state consists of NumBuffers() logical buffers; at update t (t = 1, 2, ...) buffer k decays by
+// a rate r(k, t), e.g. the momentum of that minibatch. A column that was last touched at update 'from'
+// catches up on the decay of the updates it skipped through Decay(k, from, to), the product of r(k, t)
+// for from < t <= to. Rates change rarely, so only runs of equal rates are stored.
+// -----------------------------------------------------------------------
+
+class LazyDecayHistory
+{
+public:
+    LazyDecayHistory() : m_numUpdates(0) {}
+
+    // forgets all updates; the next update is update 1 again
+    void Reset()
+    {
+        m_segments.clear();
+        m_numUpdates = 0;
+    }
+
+    // appends the decay rates of the next update, one per buffer
+    void Append(const std::vector<double>& rates)
+    {
+        if (!m_segments.empty() && m_segments.back().m_rates.size() != rates.size())
+            LogicError("LazyDecayHistory: the number of buffers changed from %d to %d.", (int)m_segments.back().m_rates.size(), (int)rates.size());
+        if (m_segments.empty() || m_segments.back().m_rates != rates)
+        {
+            Segment segment;
+            segment.m_start = m_numUpdates;
+            segment.m_rates = rates;
+            for (size_t k = 0; k < rates.size(); k++)
+            {
+                if (rates[k] < 0)
+                    LogicError("LazyDecayHistory: negative decay rate %f.", rates[k]);
+                segment.m_logRates.push_back(rates[k] > 0 ? log(rates[k]) : 0);
+                segment.m_logSums.push_back(m_segments.empty() ? 0 : LogSum(m_segments.back(), k, m_numUpdates));
+                segment.m_numZeros.push_back(m_segments.empty() ? 0 : NumZeros(m_segments.back(), k, m_numUpdates));
+            }
+            m_segments.push_back(std::move(segment));
+        }
+        m_numUpdates++;
+    }
+
+    int NumUpdates() const { return m_numUpdates; }
+    size_t NumSegments() const { return m_segments.size(); }
+    size_t NumBuffers() const { return m_segments.empty() ? 0 : m_segments.back().m_rates.size(); }
+
+    // product of the decay rates of buffer k over the updates from + 1 ... to
+    double Decay(size_t k, int from, int to) const
+    {
+        if (from >= to)
+            return 1;
+        const auto& last = SegmentOf(to - 1); // the run of rates that update 'to' belongs to
+        if (last.m_start <= from)             // the common case: all updates have the same rate
+            return pow(last.m_rates[k], to - from);
+        const auto& first = SegmentOf(from);
+        if (NumZeros(last, k, to) != NumZeros(first, k, from))
+            return 0;
+        return exp(LogSum(last, k, to) - LogSum(first, k, from));
+    }
+
+private:
+    // a run of updates m_start + 1 ... (start of the next segment) with the same rates
+    struct Segment
+    {
+        int m_start;
+        std::vector<double> m_rates;
+        std::vector<double> m_logRates; // 0 for zero rates, which are counted instead
+        std::vector<double> m_logSums;  // [k] sum of the logs of the nonzero rates of buffer k up to update m_start
+        std::vector<int> m_numZeros;    // [k] number of zero rates of buffer k up to update m_start
+    };
+
+    // the last segment that starts at or before update t
+    const Segment& SegmentOf(int t) const
+    {
+        auto iter = std::upper_bound(m_segments.begin(), m_segments.end(), t, [](int t, const Segment& segment) { return t < segment.m_start; });
+        return *(iter - 1);
+    }
+
+    // sum of the logs of the nonzero rates, and number of zero rates, of buffer k up to update t, with t in the given segment
+    static double LogSum(const Segment& segment, size_t k, int t) { return segment.m_logSums[k] + (t - segment.m_start) * segment.m_logRates[k]; }
+    static int NumZeros(const Segment& segment, size_t k, int t) { return segment.m_numZeros[k] + (segment.m_rates[k] == 0 ? t - segment.m_start : 0); }
+
+    std::vector<Segment> m_segments;
+    int m_numUpdates;
+};
+
 // -----------------------------------------------------------------------
 // BaseMatrixStorage -- base class for all matrix types (CPU, GPU) x (dense, sparse)
 // -----------------------------------------------------------------------
@@ -7,6 +7,14 @@
 #include "ConvolutionEngine.h"
 #include "CuDnnFactories.h"
 #include "MklDnnCommon.h"
+#include "NumaPolicy.h"
+#include <omp.h>
+#include <mutex>
+#include <functional>
+#include <random>
+#ifdef _WIN32
+#include <intrin.h>
+#endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -128,6 +136,341 @@ void ConvolutionEngine<ElemType>::MaxUnpooling(const Mat& out, const Mat& poolIn
     MaxUnpoolingCore(out, poolIn, in);
 }
 
+// Range [begin, end) of output positions o for which the input position o * stride - pad + k lies in [0, inSize).
+static void ValidOutputRange(ptrdiff_t k, ptrdiff_t pad, ptrdiff_t stride, ptrdiff_t inSize, ptrdiff_t outSize, size_t& begin, size_t& end)
+{
+    ptrdiff_t lo = pad - k;
+    ptrdiff_t hi = inSize - 1 + pad - k;
+    ptrdiff_t first = lo > 0 ? (lo + stride - 1) / stride : 0;
+    ptrdiff_t last = hi >= 0 ? std::min(outSize - 1, hi / stride) : -1;
+    begin = (size_t)first;
+    end = (size_t)std::max(first, last + 1);
+}
+
+//------------------------------------------------------------------
+// CPU kernels for 2D pooling (WHC tensors, window and stride 1 along C).
+// Unlike the lookup-based CPUMatrix pooling functions they walk every [W x H] plane directly: planes (samples x channels)
+// are distributed over threads and all loops run along output rows, without branches in the innermost loop so that the
+// compiler vectorizes them over width. Forward passes of the common 2x2 and 3x3 windows with stride 1 or 2 use row
+// kernels with the window width and stride known at compile time.
+// Results match the lookup-based implementation, including which input receives the gradient of a max window with ties.
+//------------------------------------------------------------------
+template <class ElemType>
+class CpuPooling2D
+{
+public:
+    CpuPooling2D(const ConvolveGeometry& g)
+        : m_inW(g.InputShape()[0]), m_inH(g.InputShape()[1]), m_outW(g.OutputShape()[0]), m_outH(g.OutputShape()[1]),
+          m_kW(g.KernelShape()[0]), m_kH(g.KernelShape()[1]), m_strideX(g.GetStride(0)), m_strideY(g.GetStride(1)),
+          m_padX(g.GetLowerPad(0)), m_padY(g.GetLowerPad(1))
+    {
+        // Number of window cells inside the input for every output column and row.
+        m_countX.resize(m_outW);
+        m_countY.resize(m_outH);
+        for (size_t o = 0; o < m_outW; o++)
+            m_countX[o] = CountValid(o, m_strideX, m_padX, m_kW, m_inW);
+        for (size_t o = 0; o < m_outH; o++)
+            m_countY[o] = CountValid(o, m_strideY, m_padY, m_kH, m_inH);
+
+        // Output columns reading input column ox * strideX - padX + kx, and the interior ones whose whole window is inside.
+        m_validX.resize(m_kW);
+        for (size_t kx = 0; kx < m_kW; kx++)
+            ValidOutputRange(kx, m_padX, m_strideX, m_inW, m_outW, m_validX[kx].first, m_validX[kx].second);
+        m_interiorBegin = m_validX[0].first;
+        m_interiorEnd = std::max(m_interiorBegin, m_validX[m_kW - 1].second);
+
+        m_maxRow = SelectRowKernel<true>();
+        m_sumRow = SelectRowKernel<false>();
+    }
+
+    static bool IsSupported(const ConvolveGeometry& g)
+    {
+        const auto& inT = g.InputShape();
+        const auto& kernT = g.KernelShape();
+        if (inT.GetRank() != 3 || kernT[2] != 1 || g.GetStride(2) != 1 || g.OutputShape()[2] != inT[2])
+            return false;
+        for (size_t i = 0; i < inT.GetRank(); i++)
+        {
+            if (g.GetMapCount(i) != 1 || g.GetDilation(i) != 1)
+                return false;
+        }
+        return true;
+    }
+
+    void MaxForward(const ElemType* in, ElemType* out, size_t planes) const
+    {
+#pragma omp parallel for
+        for (long plane = 0; plane < (long)planes; plane++)
+        {
+            const ElemType* src = in + plane * m_inW * m_inH;
+            ElemType* dst = out + plane * m_outW * m_outH;
+            std::fill(dst, dst + m_outW * m_outH, -std::numeric_limits<ElemType>::infinity());
+            ForEachInputRow([&](size_t oy, size_t iy)
+            {
+                PoolRow<true>(m_maxRow, src + iy * m_inW, dst + oy * m_outW);
+            });
+        }
+    }
+
+    // The average is over the cells inside the input, or over the whole window if poolIncludePad is set.
+    void AverageForward(const ElemType* in, ElemType* out, size_t planes, bool poolIncludePad) const
+    {
+#pragma omp parallel for
+        for (long plane = 0; plane < (long)planes; plane++)
+        {
+            const ElemType* src = in + plane * m_inW * m_inH;
+            ElemType* dst = out + plane * m_outW * m_outH;
+            std::fill(dst, dst + m_outW * m_outH, (ElemType)0);
+            ForEachInputRow([&](size_t oy, size_t iy)
+            {
+                PoolRow<false>(m_sumRow, src + iy * m_inW, dst + oy * m_outW);
+            });
+            for (size_t oy = 0; oy < m_outH; oy++)
+            {
+                ElemType* t = dst + oy * m_outW;
+                for (size_t ox = 0; ox < m_outW; ox++)
+                    t[ox] /= (ElemType)(poolIncludePad ? m_kW * m_kH : m_countY[oy] * m_countX[ox]);
+            }
+        }
+    }
+
+    // Every output passes its gradient to the first cell of its window (in kernel order) that holds the maximum.
+    // The cells of a window are visited in kernel order for a whole output row at once, and a flag per output
+    // records whether its gradient is still to be passed on.
+    void MaxBackward(const ElemType* out, const ElemType* srcGrad, const ElemType* in, ElemType* grad, size_t planes, bool accumulateGradient) const
+    {
+#pragma omp parallel for
+        for (long plane = 0; plane < (long)planes; plane++)
+        {
+            const ElemType* o = out + plane * m_outW * m_outH;
+            const ElemType* g = srcGrad + plane * m_outW * m_outH;
+            const ElemType* src = in + plane * m_inW * m_inH;
+            ElemType* dst = grad + plane * m_inW * m_inH;
+            if (!accumulateGradient)
+                std::fill(dst, dst + m_inW * m_inH, (ElemType)0);
+            std::vector<ElemType> pending(m_outW);
+            size_t pendingRow = m_outH;
+            ForEachWindowRow([&](size_t oy, size_t iy, size_t kx, size_t oxBegin, size_t oxEnd)
+            {
+                if (pendingRow != oy)
+                {
+                    std::fill(pending.begin(), pending.end(), (ElemType)1);
+                    pendingRow = oy;
+                }
+                const ElemType* s = src + iy * m_inW + kx - m_padX;
+                ElemType* t = dst + iy * m_inW + kx - m_padX;
+                if (m_strideX == 1)
+                    PassMaxGradient(s, o + oy * m_outW, g + oy * m_outW, t, pending.data(), oxBegin, oxEnd, 1);
+                else
+                    PassMaxGradient(s, o + oy * m_outW, g + oy * m_outW, t, pending.data(), oxBegin, oxEnd, m_strideX);
+            });
+        }
+    }
+
+    void AverageBackward(const ElemType* srcGrad, ElemType* grad, size_t planes, bool poolIncludePad, bool accumulateGradient) const
+    {
+#pragma omp parallel for
+        for (long plane = 0; plane < (long)planes; plane++)
+        {
+            const ElemType* g = srcGrad + plane * m_outW * m_outH;
+            ElemType* dst = grad + plane * m_inW * m_inH;
+            if (!accumulateGradient)
+                std::fill(dst, dst + m_inW * m_inH, (ElemType)0);
+            // Scale a row of output gradients at a time and spread it over the window rows.
+            std::vector<ElemType> scaled(m_outW);
+            size_t scaledRow = m_outH;
+            ForEachWindowRow([&](size_t oy, size_t iy, size_t kx, size_t oxBegin, size_t oxEnd)
+            {
+                if (scaledRow != oy)
+                {
+                    for (size_t ox = 0; ox < m_outW; ox++)
+                        scaled[ox] = g[oy * m_outW + ox] / (ElemType)(poolIncludePad ? m_kW * m_kH : m_countY[oy] * m_countX[ox]);
+                    scaledRow = oy;
+                }
+                ElemType* t = dst + iy * m_inW + kx - m_padX;
+                for (size_t ox = oxBegin; ox < oxEnd; ox++)
+                    t[ox * m_strideX] += scaled[ox];
+            });
+        }
+    }
+
+    // Every output is written to the cell of its window that holds the maximum of poolIn (the first one on ties).
+    // The maxima of a whole output row are searched at once, then the outputs are written in order so that
+    // overlapping windows resolve like in the lookup-based implementation.
+    void MaxUnpooling(const ElemType* out, const ElemType* poolIn, ElemType* in, size_t planes) const
+    {
+#pragma omp parallel for
+        for (long plane = 0; plane < (long)planes; plane++)
+        {
+            const ElemType* o = out + plane * m_outW * m_outH;
+            const ElemType* src = poolIn + plane * m_inW * m_inH;
+            ElemType* dst = in + plane * m_inW * m_inH;
+            std::vector<ElemType> best(m_outW);
+            std::vector<int> bestIndex(m_outW);
+            size_t bestRow = m_outH;
+            auto flush = [&]()
+            {
+                if (bestRow == m_outH)
+                    return;
+                for (size_t ox = 0; ox < m_outW; ox++)
+                {
+                    if (bestIndex[ox] >= 0)
+                        dst[bestIndex[ox]] = o[bestRow * m_outW + ox];
+                }
+            };
+            ForEachWindowRow([&](size_t oy, size_t iy, size_t kx, size_t oxBegin, size_t oxEnd)
+            {
+                if (bestRow != oy)
+                {
+                    flush();
+                    std::fill(bestIndex.begin(), bestIndex.end(), -1);
+                    bestRow = oy;
+                }
+                int offset = (int)(iy * m_inW + kx) - (int)m_padX;
+                if (m_strideX == 1)
+                    FindRowMax(src + offset, offset, best.data(), bestIndex.data(), oxBegin, oxEnd, 1);
+                else
+                    FindRowMax(src + offset, offset, best.data(), bestIndex.data(), oxBegin, oxEnd, m_strideX);
+            });
+            flush();
+        }
+    }
+
+private:
+    // One window cell for the outputs [oxBegin, oxEnd) of a row: passes the gradient of every output whose maximum is at
+    // this cell and that is still pending. Called with a literal stride of 1 so that the loop vectorizes in that case.
+    static void PassMaxGradient(const ElemType* s, const ElemType* o, const ElemType* g, ElemType* t, ElemType* pending,
+                                size_t oxBegin, size_t oxEnd, size_t strideX)
+    {
+        for (size_t ox = oxBegin; ox < oxEnd; ox++)
+        {
+            bool hit = (pending[ox] != 0) & (s[ox * strideX] >= o[ox]);
+            t[ox * strideX] += hit ? g[ox] : (ElemType)0;
+            pending[ox] = hit ? (ElemType)0 : pending[ox];
+        }
+    }
+
+    // One window cell for the outputs [oxBegin, oxEnd) of a row: keeps the first cell holding the maximum seen so far.
+    static void FindRowMax(const ElemType* s, int offset, ElemType* best, int* bestIndex, size_t oxBegin, size_t oxEnd, size_t strideX)
+    {
+        for (size_t ox = oxBegin; ox < oxEnd; ox++)
+        {
+            ElemType v = s[ox * strideX];
+            bool take = (bestIndex[ox] < 0) | (v > best[ox]);
+            best[ox] = take ? v : best[ox];
+            bestIndex[ox] = take ? offset + (int)(ox * strideX) : bestIndex[ox];
+        }
+    }
+
+    // Combines the interior columns [oxBegin, oxEnd) of an output row with one input row, which is passed shifted by -padX.
+    // The trailing arguments are the window width and stride, unused by the kernels that have them as template arguments.
+    typedef void (*RowKernel)(const ElemType* s, ElemType* t, size_t oxBegin, size_t oxEnd, size_t kW, size_t strideX);
+
+    static ElemType Combine(bool isMax, ElemType a, ElemType b)
+    {
+        return isMax ? std::max(a, b) : a + b;
+    }
+
+    template <bool IsMax, size_t KW, size_t StrideX>
+    static void FixedRow(const ElemType* s, ElemType* t, size_t oxBegin, size_t oxEnd, size_t, size_t)
+    {
+        for (size_t ox = oxBegin; ox < oxEnd; ox++)
+        {
+            const ElemType* w = s + ox * StrideX;
+            ElemType v = w[0];
+            for (size_t kx = 1; kx < KW; kx++)
+                v = Combine(IsMax, v, w[kx]);
+            t[ox] = Combine(IsMax, t[ox], v);
+        }
+    }
+
+    template <bool IsMax>
+    static void GenericRow(const ElemType* s, ElemType* t, size_t oxBegin, size_t oxEnd, size_t kW, size_t strideX)
+    {
+        for (size_t kx = 0; kx < kW; kx++)
+        {
+            for (size_t ox = oxBegin; ox < oxEnd; ox++)
+                t[ox] = Combine(IsMax, t[ox], s[ox * strideX + kx]);
+        }
+    }
+
+    template <bool IsMax>
+    RowKernel SelectRowKernel() const
+    {
+        if (m_kW == 2 && m_strideX == 1)
+            return &FixedRow<IsMax, 2, 1>;
+        if (m_kW == 2 && m_strideX == 2)
+            return &FixedRow<IsMax, 2, 2>;
+        if (m_kW == 3 && m_strideX == 1)
+            return &FixedRow<IsMax, 3, 1>;
+        if (m_kW == 3 && m_strideX == 2)
+            return &FixedRow<IsMax, 3, 2>;
+        return &GenericRow<IsMax>;
+    }
+
+    // Combines a whole output row with one input row: the border columns whose window is partially outside the input
+    // cell by cell, the interior through the row kernel.
+    template <bool IsMax>
+    void PoolRow(RowKernel interior, const ElemType* inRow, ElemType* t) const
+    {
+        const ElemType* s = inRow - m_padX;
+        for (size_t kx = 0; kx < m_kW; kx++)
+        {
+            size_t oxBegin = m_validX[kx].first, oxEnd = m_validX[kx].second;
+            for (size_t ox = oxBegin; ox < std::min(oxEnd, m_interiorBegin); ox++)
+                t[ox] = Combine(IsMax, t[ox], s[ox * m_strideX + kx]);
+            for (size_t ox = std::max(oxBegin, m_interiorEnd); ox < oxEnd; ox++)
+                t[ox] = Combine(IsMax, t[ox], s[ox * m_strideX + kx]);
+        }
+        interior(s, t, m_interiorBegin, m_interiorEnd, m_kW, m_strideX);
+    }
+
+    static size_t CountValid(size_t o, size_t stride, ptrdiff_t pad, size_t k, size_t inSize)
+    {
+        ptrdiff_t first = (ptrdiff_t)(o * stride) - pad;
+        ptrdiff_t lo = std::max<ptrdiff_t>(first, 0);
+        ptrdiff_t hi = std::min<ptrdiff_t>(first + (ptrdiff_t)k, (ptrdiff_t)inSize);
+        return hi > lo ? (size_t)(hi - lo) : 0;
+    }
+
+    // Calls f(oy, iy) for every output row and window row inside the input, in kernel order.
+    template <class F>
+    void ForEachInputRow(F f) const
+    {
+        for (size_t oy = 0; oy < m_outH; oy++)
+        {
+            for (size_t ky = 0; ky < m_kH; ky++)
+            {
+                ptrdiff_t iy = (ptrdiff_t)(oy * m_strideY) - m_padY + (ptrdiff_t)ky;
+                if (iy >= 0 && iy < (ptrdiff_t)m_inH)
+                    f(oy, (size_t)iy);
+            }
+        }
+    }
+
+    // Calls f(oy, iy, kx, oxBegin, oxEnd) for every output row and window cell that reads input row iy, in kernel order;
+    // the output columns [oxBegin, oxEnd) read input columns ox * strideX - padX + kx inside the input.
+    template <class F>
+    void ForEachWindowRow(F f) const
+    {
+        ForEachInputRow([&](size_t oy, size_t iy)
+        {
+            for (size_t kx = 0; kx < m_kW; kx++)
+                f(oy, iy, kx, m_validX[kx].first, m_validX[kx].second);
+        });
+    }
+
+private:
+    size_t m_inW, m_inH, m_outW, m_outH;
+    size_t m_kW, m_kH;
+    size_t m_strideX, m_strideY;
+    ptrdiff_t m_padX, m_padY;
+    std::vector<size_t> m_countX, m_countY;
+    std::vector<std::pair<size_t, size_t>> m_validX;
+    size_t m_interiorBegin, m_interiorEnd;
+    RowKernel m_maxRow, m_sumRow;
+};
+
 //------------------------------------------------------------------
 // Reference convolution engine implementation.
 // This engine supports arbitrary convolution geometry but does not provide efficient implementation.
@@ -202,12 +545,36 @@ protected:
                                                            const_cast<int*>(m_geometry->MpRowIndices().data()), m_deviceId, flags);
             m_indices = std::make_unique<Matrix<int>>(m_geometry->Indices().size(), 1,
                                                       const_cast<int*>(m_geometry->Indices().data()), m_deviceId, flags);
+            if (!IsGpu(m_deviceId) && CpuPooling2D<ElemType>::IsSupported(*m_geometry))
+                m_pooling2D = std::make_unique<CpuPooling2D<ElemType>>(*m_geometry);
         }
     }
 
+    // Whether the 2D pooling kernels can run on the given matrices instead of the lookup-based ones.
+    bool UseCpuPooling2D(std::initializer_list<const Mat*> mats) const
+    {
+        if (m_pooling2D == nullptr)
+            return false;
+        for (auto mat : mats)
+        {
+            if (mat->GetMatrixType() != MatrixType::DENSE || mat->GetCurrentMatrixLocation() != CurrentDataLocation::CPU)
+                return false;
+        }
+        return true;
+    }
+
     void ForwardPoolingCore(const Mat& in, Mat& out) override
     {
-        if (m_poolKind == PoolKind::Max)
+        size_t planes = in.GetNumCols() * m_geometry->InputShape()[m_geometry->InputShape().GetRank() - 1];
+        if (m_poolKind == PoolKind::Max && UseCpuPooling2D({ &in, &out }))
+        {
+            m_pooling2D->MaxForward(in.Data(), out.Data(), planes);
+        }
+        else if (m_poolKind == PoolKind::Average && UseCpuPooling2D({ &in, &out }))
+        {
+            m_pooling2D->AverageForward(in.Data(), out.Data(), planes, m_poolIncludePad);
+        }
+        else if (m_poolKind == PoolKind::Max)
         {
             in.MaxPoolingForward(m_mpRowCol, *m_mpRowIndices, *m_indices, out);
         }
@@ -222,7 +589,16 @@ protected:
 
     void BackwardPoolingCore(const Mat& out, const Mat& srcGrad, const Mat& in, Mat& grad, bool accumulateGradient) override
     {
-        if (m_poolKind == PoolKind::Max)
+        size_t planes = in.GetNumCols() * m_geometry->InputShape()[m_geometry->InputShape().GetRank() - 1];
+        if (m_poolKind == PoolKind::Max && UseCpuPooling2D({ &out, &srcGrad, &in, &grad }))
+        {
+            m_pooling2D->MaxBackward(out.Data(), srcGrad.Data(), in.Data(), grad.Data(), planes, accumulateGradient);
+        }
+        else if (m_poolKind == PoolKind::Average && UseCpuPooling2D({ &srcGrad, &grad }))
+        {
+            m_pooling2D->AverageBackward(srcGrad.Data(), grad.Data(), planes, m_poolIncludePad, accumulateGradient);
+        }
+        else if (m_poolKind == PoolKind::Max)
         {
             srcGrad.MaxPoolingBackward(out, in, m_mpRowCol, *m_mpRowIndices, *m_indices, grad, accumulateGradient);
         }
@@ -236,7 +612,10 @@ protected:
 
     void MaxUnpoolingCore(const Mat& out, const Mat& poolIn, Mat& in) override
     {
-        out.MaxUnpooling(m_mpRowCol, *m_mpRowIndices, *m_indices, poolIn, in);
+        if (UseCpuPooling2D({ &out, &poolIn, &in }))
+            m_pooling2D->MaxUnpooling(out.Data(), poolIn.Data(), in.Data(), in.GetNumCols() * m_geometry->InputShape()[m_geometry->InputShape().GetRank() - 1]);
+        else
+            out.MaxUnpooling(m_mpRowCol, *m_mpRowIndices, *m_indices, poolIn, in);
     }
 
 protected:
@@ -253,6 +632,8 @@ protected:
     // Pooling-specific maps.
     IntMatPtr m_mpRowIndices;
     IntMatPtr m_indices;
+    // Direct kernels used instead of the maps for 2D pooling on CPU.
+    std::unique_ptr<CpuPooling2D<ElemType>> m_pooling2D;
 };
 
 //------------------------------------------------------------------
@@ -1151,69 +1532,1405 @@ public:
     }
 };
 
+//------------------------------------------------------------------
+// Direct convolution engine implementation.
+// CPU-only engine that convolves without materializing the unrolled [XYC x NW'H'] input used by the GEMM engine.
+// Stride-1 3x3 kernels use Winograd minimal filtering F(2x2, 3x3) or F(4x4, 3x3) (Lavin & Gray, "Fast Algorithms
+// for Convolutional Neural Networks"): the input is transformed tile by tile into a buffer of roughly 4x (F(2x2, 3x3))
+// or 2.25x (F(4x4, 3x3)) the output size, and the reduction over channels turns into one GEMM per transform coefficient.
+// Depthwise convolutions run on a channel-last copy of the data so that the innermost loop is over contiguous channels,
+// other grouped convolutions unroll the input of every (sample, group) pair and multiply it with the group's kernels
+// as a batch of small GEMMs. All other configurations use cache-blocked direct loops.
+// Supports 2D convolutions (WHC tensors) with full sharing.
+//------------------------------------------------------------------
 template <class ElemType>
-std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId,
-                                                                                 ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind,
-                                                                                 ConvolutionEngineKind enabledEngines, std::wstring logPrefix,
-                                                                                 bool forceDeterministicAlgorithms, bool poolIncludePad,
-                                                                                 bool inputHasFreeDimension)
+class DirectConvolutionEngine : public ReferenceConvolutionEngine<ElemType>
 {
-    if (!logPrefix.empty())
-        logPrefix += L": ";
+public:
+    using Base = ReferenceConvolutionEngine<ElemType>;
+    using typename Base::Mat;
 
-    auto isEnabled = [=](ConvolutionEngineKind eng) { return ((int)enabledEngines & (int)eng) != 0; };
-    // Note: in some cases do not throw exception even if parameters do not match as Create
-    // can be called from places like MEL with default parameters and never be used.
-    // The check will be done later in engine's EnsureCompatible call if the egnine is actually used.
-    auto engStr = (std::string)(*geometry);
-    // Only legacy engine supports HWC layout.
-    if (imageLayout == ImageLayoutKind::HWC)
+public:
+    DirectConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind, bool poolIncludePad)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad)
     {
-        if (!isEnabled(ConvolutionEngineKind::Legacy))
-            RuntimeError("Trying to use Legacy convolution engine when it's disabled.");
+    }
 
-        if (GetMathLibTraceLevel() > 0)
-            fprintf(stderr, "%lsusing legacy convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+protected:
+    using Base::m_geometry;
+    using Base::m_deviceId;
+    using Base::m_imageLayout;
+    using Base::m_maxTempMemSizeInSamples;
 
-        return std::make_unique<LegacyConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad);
+    // Plain 2D view of the geometry. Tensors are column-major: input [W x H x C], output [W' x H' x K],
+    // kernel [X x Y x C/G] per output map, so the weights of map k start at k * XY(C/G). Map k belongs to group
+    // k / (K/G) which reads input channels [g * C/G, (g + 1) * C/G).
+    struct Dims
+    {
+        size_t inW, inH, inC;
+        size_t outW, outH, outK;
+        size_t kW, kH;
+        size_t strideX, strideY;
+        ptrdiff_t padX, padY; // lower padding: output (0, 0) sees input (-padX, -padY) through kernel cell (0, 0)
+        size_t groups;
+        size_t groupC, groupK; // input channels and output maps per group
+    };
+
+    void EnsureCompatible() override
+    {
+        if (m_imageLayout != ImageLayoutKind::CHW)
+            LogicError("Direct convolution engine supports only CHW/cudnn layout.");
+        if (IsGpu(m_deviceId))
+            LogicError("Direct convolution engine supports only CPU device.");
+        if (!IsSupported(m_deviceId, m_geometry))
+            RuntimeError("Direct convolution engine does not support this convolution configuration. Geometry: %s", ((string)*m_geometry).c_str());
     }
 
-    // Check if we can use cuDNN engine. Do not need to validate tensors as ConvolveGeometry has already done that.
-    if (isEnabled(ConvolutionEngineKind::CuDnn) &&
-        CuDnnConvolutionEngineFactory<ElemType>::IsSupported(deviceId, geometry, poolKind))
+    void EnsureConvolutionInitialized() override
     {
-        if (GetMathLibTraceLevel() > 0)
-            fprintf(stderr, "%lsusing cuDNN convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+        // Only the plain geometry is needed, not the index maps of the reference engine.
+        const auto& g = *m_geometry;
+        m_dims = { g.InputShape()[0], g.InputShape()[1], g.InputShape()[2],
+                   g.OutputShape()[0], g.OutputShape()[1], g.GetMapCount(2),
+                   g.KernelShape()[0], g.KernelShape()[1],
+                   g.GetStride(0), g.GetStride(1),
+                   g.GetLowerPad(0), g.GetLowerPad(1),
+                   g.Groups(), g.InputShape()[2] / g.Groups(), g.GetMapCount(2) / g.Groups() };
+    }
 
-        return CuDnnConvolutionEngineFactory<ElemType>::Create(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind,
-                                                               forceDeterministicAlgorithms, poolIncludePad, inputHasFreeDimension);
+    void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace) override
+    {
+        EnsureDense({ &in, &kernel, &out });
+        if (IsWinogradApplicable(m_geometry))
+            WinogradCorrelate(in, kernel, /*backwardData=*/false, out, workspace);
+        else if (IsDepthwise(m_geometry))
+            DepthwiseForward(in, kernel, out, workspace);
+        else if (m_dims.groups > 1)
+            GroupedForward(in, kernel, out, workspace);
+        else
+            DirectForward(m_dims, in.Data(), kernel.Data(), out.Data(), in.GetNumCols());
     }
 
-    if (geometry->Groups() == 1)
+    // Like the reference and GEMM engines, gradients are always accumulated.
+    void BackwardDataCore(const Mat& srcGrad, const Mat& kernel, Mat& grad, bool /*accumulateGradient*/, Mat& workspace) override
     {
-        if (isEnabled(ConvolutionEngineKind::Gemm) && GemmConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
+        EnsureDense({ &srcGrad, &kernel, &grad });
+        if (IsWinogradApplicable(m_geometry))
+            WinogradCorrelate(srcGrad, kernel, /*backwardData=*/true, grad, workspace);
+        else if (IsDepthwise(m_geometry))
+            DepthwiseBackwardData(srcGrad, kernel, grad, workspace);
+        else if (m_dims.groups > 1)
+            GroupedBackwardData(srcGrad, kernel, grad, workspace);
+        else
+            DirectBackwardData(m_dims, srcGrad.Data(), kernel.Data(), grad.Data(), srcGrad.GetNumCols());
+    }
+
+    void BackwardKernelCore(const Mat& srcGrad, const Mat& in, Mat& kernelGrad, bool /*accumulateGradient*/, bool /*allowReuse*/, Mat& workspace) override
+    {
+        EnsureDense({ &srcGrad, &in, &kernelGrad });
+        if (IsDepthwise(m_geometry))
+            DepthwiseBackwardKernel(srcGrad, in, kernelGrad, workspace);
+        else if (m_dims.groups > 1 && m_dims.groups >= (size_t)omp_get_max_threads())
+            GroupedBackwardKernel(srcGrad, in, kernelGrad, workspace);
+        else
+            DirectBackwardKernel(m_dims, srcGrad.Data(), in.Data(), kernelGrad.Data(), in.GetNumCols());
+    }
+
+    static void EnsureDense(std::initializer_list<const Mat*> mats)
+    {
+        for (auto mat : mats)
         {
-            if (GetMathLibTraceLevel() > 0)
-                fprintf(stderr, "%lsusing GEMM convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+            if (mat->GetMatrixType() != MatrixType::DENSE)
+                LogicError("Direct convolution engine supports only dense matrices.");
+        }
+    }
 
-            return std::make_unique<GemmConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad);
+    // Number of output rows processed at once so that the block of every output plane stays in L1 while all
+    // input channels and kernel cells are accumulated into it.
+    static size_t RowBlockSize(size_t rowLength)
+    {
+        const size_t blockElements = 4096;
+        return std::max<size_t>(1, blockElements / std::max<size_t>(1, rowLength));
+    }
+
+    // out[n, k, oy, ox] = sum_{c, ky, kx} in[n, c, oy * strideY - padY + ky, ox * strideX - padX + kx] * w[k, c, ky, kx]
+    static void DirectForward(const Dims& d, const ElemType* in, const ElemType* kernel, ElemType* out, size_t batchSize)
+    {
+        const size_t inPlane = d.inW * d.inH;
+        const size_t outPlane = d.outW * d.outH;
+        const size_t kernPlane = d.kW * d.kH;
+        const size_t rowBlock = RowBlockSize(d.outW);
+
+        // Each work item owns one output plane.
+#pragma omp parallel for
+        for (long item = 0; item < (long)(batchSize * d.outK); item++)
+        {
+            const size_t n = item / d.outK;
+            const size_t k = item % d.outK;
+            const ElemType* src = in + (n * d.inC + k / d.groupK * d.groupC) * inPlane;
+            const ElemType* w = kernel + k * d.groupC * kernPlane;
+            ElemType* dst = out + (n * d.outK + k) * outPlane;
+            std::fill(dst, dst + outPlane, (ElemType)0);
+
+            for (size_t oy0 = 0; oy0 < d.outH; oy0 += rowBlock)
+            {
+                const size_t oy1 = std::min(d.outH, oy0 + rowBlock);
+                for (size_t c = 0; c < d.groupC; c++)
+                {
+                    for (size_t ky = 0; ky < d.kH; ky++)
+                    {
+                        size_t oyBegin, oyEnd;
+                        ValidOutputRange(ky, d.padY, d.strideY, d.inH, d.outH, oyBegin, oyEnd);
+                        oyBegin = std::max(oyBegin, oy0);
+                        oyEnd = std::min(oyEnd, oy1);
+                        for (size_t kx = 0; kx < d.kW; kx++)
+                        {
+                            size_t oxBegin, oxEnd;
+                            ValidOutputRange(kx, d.padX, d.strideX, d.inW, d.outW, oxBegin, oxEnd);
+                            const ElemType wv = w[c * kernPlane + ky * d.kW + kx];
+                            for (size_t oy = oyBegin; oy < oyEnd; oy++)
+                            {
+                                const ElemType* srcRow = src + c * inPlane + (oy * d.strideY - d.padY + ky) * d.inW + kx - d.padX;
+                                ElemType* dstRow = dst + oy * d.outW;
+                                if (d.strideX == 1)
+                                {
+                                    for (size_t ox = oxBegin; ox < oxEnd; ox++)
+                                        dstRow[ox] += wv * srcRow[ox];
+                                }
+                                else
+                                {
+                                    for (size_t ox = oxBegin; ox < oxEnd; ox++)
+                                        dstRow[ox] += wv * srcRow[ox * d.strideX];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
         }
+    }
 
-        if (!isEnabled(ConvolutionEngineKind::Reference))
-            RuntimeError("Reference convolution is disabled and no other engine supports such configuration (or disabled).");
+    // grad[n, c, iy, ix] += sum_{k, ky, kx} srcGrad[n, k, oy, ox] * w[k, c, ky, kx] where iy = oy * strideY - padY + ky, ix = ox * strideX - padX + kx
+    static void DirectBackwardData(const Dims& d, const ElemType* srcGrad, const ElemType* kernel, ElemType* grad, size_t batchSize)
+    {
+        const size_t inPlane = d.inW * d.inH;
+        const size_t outPlane = d.outW * d.outH;
+        const size_t kernPlane = d.kW * d.kH;
+        const size_t rowBlock = RowBlockSize(d.outW);
+
+        // Each work item owns one input gradient plane.
+#pragma omp parallel for
+        for (long item = 0; item < (long)(batchSize * d.inC); item++)
+        {
+            const size_t n = item / d.inC;
+            const size_t g = (item % d.inC) / d.groupC;
+            const size_t c = (item % d.inC) % d.groupC;
+            const ElemType* src = srcGrad + (n * d.outK + g * d.groupK) * outPlane;
+            ElemType* dst = grad + item * inPlane;
 
-        if (GetMathLibTraceLevel() > 0)
-            fprintf(stderr, "%lsusing reference convolution engine for geometry, could be VERY SLOW: %s.\n", logPrefix.c_str(), engStr.c_str());
+            for (size_t oy0 = 0; oy0 < d.outH; oy0 += rowBlock)
+            {
+                const size_t oy1 = std::min(d.outH, oy0 + rowBlock);
+                for (size_t k = 0; k < d.groupK; k++)
+                {
+                    const ElemType* w = kernel + ((g * d.groupK + k) * d.groupC + c) * kernPlane;
+                    for (size_t ky = 0; ky < d.kH; ky++)
+                    {
+                        size_t oyBegin, oyEnd;
+                        ValidOutputRange(ky, d.padY, d.strideY, d.inH, d.outH, oyBegin, oyEnd);
+                        oyBegin = std::max(oyBegin, oy0);
+                        oyEnd = std::min(oyEnd, oy1);
+                        for (size_t kx = 0; kx < d.kW; kx++)
+                        {
+                            size_t oxBegin, oxEnd;
+                            ValidOutputRange(kx, d.padX, d.strideX, d.inW, d.outW, oxBegin, oxEnd);
+                            const ElemType wv = w[ky * d.kW + kx];
+                            for (size_t oy = oyBegin; oy < oyEnd; oy++)
+                            {
+                                const ElemType* srcRow = src + k * outPlane + oy * d.outW;
+                                ElemType* dstRow = dst + (oy * d.strideY - d.padY + ky) * d.inW + kx - d.padX;
+                                for (size_t ox = oxBegin; ox < oxEnd; ox++)
+                                    dstRow[ox * d.strideX] += wv * srcRow[ox];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
 
-        return std::make_unique<ReferenceConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad);
+    // kernelGrad[k, c, ky, kx] += sum_{n, oy, ox} srcGrad[n, k, oy, ox] * in[n, c, oy * strideY - padY + ky, ox * strideX - padX + kx]
+    static void DirectBackwardKernel(const Dims& d, const ElemType* srcGrad, const ElemType* in, ElemType* kernelGrad, size_t batchSize)
+    {
+        const size_t inPlane = d.inW * d.inH;
+        const size_t outPlane = d.outW * d.outH;
+        const size_t kernPlane = d.kW * d.kH;
+
+        // Each work item owns the X x Y kernel cells of one (output map, input channel) pair.
+#pragma omp parallel for
+        for (long item = 0; item < (long)(d.outK * d.groupC); item++)
+        {
+            const size_t k = item / d.groupC;
+            const size_t c = k / d.groupK * d.groupC + item % d.groupC;
+            ElemType* dst = kernelGrad + item * kernPlane;
+            for (size_t ky = 0; ky < d.kH; ky++)
+            {
+                size_t oyBegin, oyEnd;
+                ValidOutputRange(ky, d.padY, d.strideY, d.inH, d.outH, oyBegin, oyEnd);
+                for (size_t kx = 0; kx < d.kW; kx++)
+                {
+                    size_t oxBegin, oxEnd;
+                    ValidOutputRange(kx, d.padX, d.strideX, d.inW, d.outW, oxBegin, oxEnd);
+                    ElemType sum = 0;
+                    for (size_t n = 0; n < batchSize; n++)
+                    {
+                        const ElemType* src = srcGrad + (n * d.outK + k) * outPlane;
+                        const ElemType* inp = in + (n * d.inC + c) * inPlane;
+                        for (size_t oy = oyBegin; oy < oyEnd; oy++)
+                        {
+                            const ElemType* srcRow = src + oy * d.outW;
+                            const ElemType* inRow = inp + (oy * d.strideY - d.padY + ky) * d.inW + kx - d.padX;
+                            for (size_t ox = oxBegin; ox < oxEnd; ox++)
+                                sum += srcRow[ox] * inRow[ox * d.strideX];
+                        }
+                    }
+                    dst[ky * d.kW + kx] += sum;
+                }
+            }
+        }
     }
-    else if (geometry->Groups() > 1)
+
+    // Copies [pixels x channels] planes of count samples into channel-last [channels x pixels] order and back.
+    static void ToChannelLast(const ElemType* src, ElemType* dst, size_t count, size_t channels, size_t pixels)
     {
-        if (!(geometry->InputShape().GetRank() < 4))
+#pragma omp parallel for
+        for (long item = 0; item < (long)(count * pixels); item++)
         {
-            RuntimeError("Group convolution, i.e. groups > 1, for 3-dimensional convolution or higher is not supported on the CPU. Please use GPU, if possible.");
+            const size_t n = item / pixels;
+            const size_t p = item % pixels;
+            const ElemType* s = src + n * channels * pixels + p;
+            ElemType* t = dst + item * channels;
+            for (size_t c = 0; c < channels; c++)
+                t[c] = s[c * pixels];
+        }
+    }
+
+    static void FromChannelLast(const ElemType* src, ElemType* dst, size_t count, size_t channels, size_t pixels, bool accumulate)
+    {
+#pragma omp parallel for
+        for (long item = 0; item < (long)(count * channels); item++)
+        {
+            const size_t n = item / channels;
+            const size_t c = item % channels;
+            const ElemType* s = src + n * pixels * channels + c;
+            ElemType* t = dst + item * pixels;
+            if (accumulate)
+            {
+                for (size_t p = 0; p < pixels; p++)
+                    t[p] += s[p * channels];
+            }
+            else
+            {
+                for (size_t p = 0; p < pixels; p++)
+                    t[p] = s[p * channels];
+            }
+        }
+    }
+
+    size_t GetSubBatchSize(size_t batchSize) const
+    {
+        return m_maxTempMemSizeInSamples == 0 ? batchSize : std::min(batchSize, m_maxTempMemSizeInSamples);
+    }
+
+    // Depthwise convolution (one kernel per input channel). Weights are transposed to [C x XY] so that
+    // every kernel cell is a contiguous vector over channels, matching the channel-last data.
+    void DepthwiseForward(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace)
+    {
+        const auto& d = m_dims;
+        const size_t C = d.inC;
+        const size_t inPix = d.inW * d.inH;
+        const size_t outPix = d.outW * d.outH;
+        const size_t kernPix = d.kW * d.kH;
+        const size_t batchSize = in.GetNumCols();
+        const size_t subBatchSize = GetSubBatchSize(batchSize);
+
+        workspace.Resize(1, kernPix * C + subBatchSize * (inPix + outPix) * C);
+        ElemType* w = workspace.Data();
+        ToChannelLast(kernel.Data(), w, 1, C, kernPix);
+
+        for (size_t start = 0; start < batchSize; start += subBatchSize)
+        {
+            const size_t curBatchSize = std::min(subBatchSize, batchSize - start);
+            ElemType* src = w + kernPix * C;
+            ElemType* dst = src + curBatchSize * inPix * C;
+            ToChannelLast(in.Data() + start * C * inPix, src, curBatchSize, C, inPix);
+
+            // Each work item owns one output row.
+#pragma omp parallel for
+            for (long item = 0; item < (long)(curBatchSize * d.outH); item++)
+            {
+                const size_t n = item / d.outH;
+                const size_t oy = item % d.outH;
+                ElemType* dstRow = dst + (n * outPix + oy * d.outW) * C;
+                std::fill(dstRow, dstRow + d.outW * C, (ElemType)0);
+                for (size_t ky = 0; ky < d.kH; ky++)
+                {
+                    const ptrdiff_t iy = (ptrdiff_t)(oy * d.strideY) - d.padY + (ptrdiff_t)ky;
+                    if (iy < 0 || iy >= (ptrdiff_t)d.inH)
+                        continue;
+                    for (size_t kx = 0; kx < d.kW; kx++)
+                    {
+                        size_t oxBegin, oxEnd;
+                        ValidOutputRange(kx, d.padX, d.strideX, d.inW, d.outW, oxBegin, oxEnd);
+                        const ElemType* wv = w + (ky * d.kW + kx) * C;
+                        for (size_t ox = oxBegin; ox < oxEnd; ox++)
+                        {
+                            const ElemType* s = src + (n * inPix + iy * d.inW + ox * d.strideX - d.padX + kx) * C;
+                            ElemType* t = dstRow + ox * C;
+                            for (size_t c = 0; c < C; c++)
+                                t[c] += s[c] * wv[c];
+                        }
+                    }
+                }
+            }
+
+            FromChannelLast(dst, out.Data() + start * C * outPix, curBatchSize, C, outPix, /*accumulate=*/false);
+        }
+    }
+
+    void DepthwiseBackwardData(const Mat& srcGrad, const Mat& kernel, Mat& grad, Mat& workspace)
+    {
+        const auto& d = m_dims;
+        const size_t C = d.inC;
+        const size_t inPix = d.inW * d.inH;
+        const size_t outPix = d.outW * d.outH;
+        const size_t kernPix = d.kW * d.kH;
+        const size_t batchSize = srcGrad.GetNumCols();
+        const size_t subBatchSize = GetSubBatchSize(batchSize);
+
+        workspace.Resize(1, kernPix * C + subBatchSize * (inPix + outPix) * C);
+        ElemType* w = workspace.Data();
+        ToChannelLast(kernel.Data(), w, 1, C, kernPix);
+
+        for (size_t start = 0; start < batchSize; start += subBatchSize)
+        {
+            const size_t curBatchSize = std::min(subBatchSize, batchSize - start);
+            ElemType* src = w + kernPix * C;
+            ElemType* dst = src + curBatchSize * outPix * C;
+            ToChannelLast(srcGrad.Data() + start * C * outPix, src, curBatchSize, C, outPix);
+
+            // Each work item owns one input gradient row and gathers from the output rows that read it.
+#pragma omp parallel for
+            for (long item = 0; item < (long)(curBatchSize * d.inH); item++)
+            {
+                const size_t n = item / d.inH;
+                const size_t iy = item % d.inH;
+                ElemType* dstRow = dst + (n * inPix + iy * d.inW) * C;
+                std::fill(dstRow, dstRow + d.inW * C, (ElemType)0);
+                for (size_t ky = 0; ky < d.kH; ky++)
+                {
+                    const ptrdiff_t y = (ptrdiff_t)iy + d.padY - (ptrdiff_t)ky;
+                    if (y < 0 || y % (ptrdiff_t)d.strideY != 0 || y / (ptrdiff_t)d.strideY >= (ptrdiff_t)d.outH)
+                        continue;
+                    const size_t oy = y / d.strideY;
+                    for (size_t kx = 0; kx < d.kW; kx++)
+                    {
+                        size_t oxBegin, oxEnd;
+                        ValidOutputRange(kx, d.padX, d.strideX, d.inW, d.outW, oxBegin, oxEnd);
+                        const ElemType* wv = w + (ky * d.kW + kx) * C;
+                        for (size_t ox = oxBegin; ox < oxEnd; ox++)
+                        {
+                            const ElemType* s = src + (n * outPix + oy * d.outW + ox) * C;
+                            ElemType* t = dstRow + (ox * d.strideX - d.padX + kx) * C;
+                            for (size_t c = 0; c < C; c++)
+                                t[c] += s[c] * wv[c];
+                        }
+                    }
+                }
+            }
+
+            FromChannelLast(dst, grad.Data() + start * C * inPix, curBatchSize, C, inPix, /*accumulate=*/true);
+        }
+    }
+
+    void DepthwiseBackwardKernel(const Mat& srcGrad, const Mat& in, Mat& kernelGrad, Mat& workspace)
+    {
+        const auto& d = m_dims;
+        const size_t C = d.inC;
+        const size_t inPix = d.inW * d.inH;
+        const size_t outPix = d.outW * d.outH;
+        const size_t kernPix = d.kW * d.kH;
+        const size_t batchSize = in.GetNumCols();
+        const size_t subBatchSize = GetSubBatchSize(batchSize);
+        // Channels per work item; a multiple of the cache line so that work items do not share lines.
+        const size_t channelBlock = 64;
+        const size_t channelBlocks = (C + channelBlock - 1) / channelBlock;
+
+        workspace.Resize(1, kernPix * C + subBatchSize * (inPix + outPix) * C);
+        ElemType* dw = workspace.Data();
+        std::fill(dw, dw + kernPix * C, (ElemType)0);
+
+        for (size_t start = 0; start < batchSize; start += subBatchSize)
+        {
+            const size_t curBatchSize = std::min(subBatchSize, batchSize - start);
+            ElemType* src = dw + kernPix * C;
+            ElemType* inp = src + curBatchSize * outPix * C;
+            ToChannelLast(srcGrad.Data() + start * C * outPix, src, curBatchSize, C, outPix);
+            ToChannelLast(in.Data() + start * C * inPix, inp, curBatchSize, C, inPix);
+
+            // Each work item owns a block of channels of one kernel cell.
+#pragma omp parallel for
+            for (long item = 0; item < (long)(kernPix * channelBlocks); item++)
+            {
+                const size_t cell = item / channelBlocks;
+                const size_t c0 = (item % channelBlocks) * channelBlock;
+                const size_t c1 = std::min(C, c0 + channelBlock);
+                const size_t ky = cell / d.kW;
+                const size_t kx = cell % d.kW;
+                size_t oyBegin, oyEnd, oxBegin, oxEnd;
+                ValidOutputRange(ky, d.padY, d.strideY, d.inH, d.outH, oyBegin, oyEnd);
+                ValidOutputRange(kx, d.padX, d.strideX, d.inW, d.outW, oxBegin, oxEnd);
+                ElemType* t = dw + cell * C;
+                for (size_t n = 0; n < curBatchSize; n++)
+                {
+                    for (size_t oy = oyBegin; oy < oyEnd; oy++)
+                    {
+                        const size_t iy = oy * d.strideY - d.padY + ky;
+                        for (size_t ox = oxBegin; ox < oxEnd; ox++)
+                        {
+                            const ElemType* s = src + (n * outPix + oy * d.outW + ox) * C;
+                            const ElemType* i = inp + (n * inPix + iy * d.inW + ox * d.strideX - d.padX + kx) * C;
+                            for (size_t c = c0; c < c1; c++)
+                                t[c] += s[c] * i[c];
+                        }
+                    }
+                }
+            }
+        }
+
+        // Kernel gradients are accumulated, like in the other engines.
+        ElemType* kg = kernelGrad.Data();
+#pragma omp parallel for
+        for (long c = 0; c < (long)C; c++)
+        {
+            for (size_t cell = 0; cell < kernPix; cell++)
+                kg[c * kernPix + cell] += dw[cell * C + c];
+        }
+    }
+
+    // Unrolls the C/G input channels of one (sample, group) pair into rows [XY(C/G) x W'H']: row (c * Y + ky) * X + kx holds
+    // the input seen through that kernel cell by every output position, zero where it falls into the padding.
+    void Im2Col(const ElemType* src, ElemType* patch) const
+    {
+        const auto& d = m_dims;
+        const size_t inPix = d.inW * d.inH;
+        const size_t outPix = d.outW * d.outH;
+        for (size_t c = 0; c < d.groupC; c++)
+        {
+            for (size_t ky = 0; ky < d.kH; ky++)
+            {
+                size_t oyBegin, oyEnd;
+                ValidOutputRange(ky, d.padY, d.strideY, d.inH, d.outH, oyBegin, oyEnd);
+                for (size_t kx = 0; kx < d.kW; kx++)
+                {
+                    size_t oxBegin, oxEnd;
+                    ValidOutputRange(kx, d.padX, d.strideX, d.inW, d.outW, oxBegin, oxEnd);
+                    ElemType* row = patch + ((c * d.kH + ky) * d.kW + kx) * outPix;
+                    std::fill(row, row + outPix, (ElemType)0);
+                    for (size_t oy = oyBegin; oy < oyEnd; oy++)
+                    {
+                        const ElemType* s = src + c * inPix + (oy * d.strideY - d.padY + ky) * d.inW + kx - d.padX;
+                        ElemType* t = row + oy * d.outW;
+                        for (size_t ox = oxBegin; ox < oxEnd; ox++)
+                            t[ox] = s[ox * d.strideX];
+                    }
+                }
+            }
+        }
+    }
+
+    // Adds the unrolled rows back to the input positions they were read from (the transpose of Im2Col).
+    void Col2ImAdd(const ElemType* patch, ElemType* dst) const
+    {
+        const auto& d = m_dims;
+        const size_t inPix = d.inW * d.inH;
+        const size_t outPix = d.outW * d.outH;
+        for (size_t c = 0; c < d.groupC; c++)
+        {
+            for (size_t ky = 0; ky < d.kH; ky++)
+            {
+                size_t oyBegin, oyEnd;
+                ValidOutputRange(ky, d.padY, d.strideY, d.inH, d.outH, oyBegin, oyEnd);
+                for (size_t kx = 0; kx < d.kW; kx++)
+                {
+                    size_t oxBegin, oxEnd;
+                    ValidOutputRange(kx, d.padX, d.strideX, d.inW, d.outW, oxBegin, oxEnd);
+                    const ElemType* row = patch + ((c * d.kH + ky) * d.kW + kx) * outPix;
+                    for (size_t oy = oyBegin; oy < oyEnd; oy++)
+                    {
+                        ElemType* t = dst + c * inPix + (oy * d.strideY - d.padY + ky) * d.inW + kx - d.padX;
+                        const ElemType* s = row + oy * d.outW;
+                        for (size_t ox = oxBegin; ox < oxEnd; ox++)
+                            t[ox * d.strideX] += s[ox];
+                    }
+                }
+            }
+        }
+    }
+
+    // unrolling buffer of the calling OpenMP thread: a slice of the workspace, or, with a NUMA policy,
+    // a buffer of the thread itself, so that it lives on the thread's node rather than wherever the workspace was first touched
+    static ElemType* ThreadPatch(ElemType* patches, size_t patchSize)
+    {
+        if (NumaPolicy::IsEnabled())
+            return (ElemType*)NumaPolicy::ThreadScratch(patchSize * sizeof(ElemType));
+        return patches + omp_get_thread_num() * patchSize;
+    }
+
+    // Grouped convolution as a batch of small GEMMs, one per (sample, group) pair:
+    // out_g [K/G x W'H'] = w_g [K/G x XY(C/G)] * unrolled input_g [XY(C/G) x W'H'].
+    // The inner dimension is too small for BLAS to pay off, so each pair is multiplied by one thread
+    // with a loop that streams over contiguous output rows.
+    void GroupedForward(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace)
+    {
+        const auto& d = m_dims;
+        const size_t inPix = d.inW * d.inH;
+        const size_t outPix = d.outW * d.outH;
+        const size_t unrollRows = d.groupC * d.kW * d.kH;
+        const size_t batchSize = in.GetNumCols();
+
+        if (!NumaPolicy::IsEnabled())
+            workspace.Resize(1, omp_get_max_threads() * unrollRows * outPix);
+        ElemType* patches = workspace.Data();
+        const ElemType* w = kernel.Data();
+
+#pragma omp parallel for
+        for (long item = 0; item < (long)(batchSize * d.groups); item++)
+        {
+            const size_t n = item / d.groups;
+            const size_t g = item % d.groups;
+            ElemType* patch = ThreadPatch(patches, unrollRows * outPix);
+            Im2Col(in.Data() + (n * d.inC + g * d.groupC) * inPix, patch);
+            for (size_t k = g * d.groupK; k < (g + 1) * d.groupK; k++)
+            {
+                ElemType* dst = out.Data() + (n * d.outK + k) * outPix;
+                std::fill(dst, dst + outPix, (ElemType)0);
+                for (size_t r = 0; r < unrollRows; r++)
+                {
+                    const ElemType wv = w[k * unrollRows + r];
+                    const ElemType* row = patch + r * outPix;
+                    for (size_t p = 0; p < outPix; p++)
+                        dst[p] += wv * row[p];
+                }
+            }
+        }
+    }
+
+    // grad_g += Col2Im(w_g^T [XY(C/G) x K/G] * srcGrad_g [K/G x W'H']).
+    void GroupedBackwardData(const Mat& srcGrad, const Mat& kernel, Mat& grad, Mat& workspace)
+    {
+        const auto& d = m_dims;
+        const size_t inPix = d.inW * d.inH;
+        const size_t outPix = d.outW * d.outH;
+        const size_t unrollRows = d.groupC * d.kW * d.kH;
+        const size_t batchSize = srcGrad.GetNumCols();
+
+        if (!NumaPolicy::IsEnabled())
+            workspace.Resize(1, omp_get_max_threads() * unrollRows * outPix);
+        ElemType* patches = workspace.Data();
+        const ElemType* w = kernel.Data();
+
+#pragma omp parallel for
+        for (long item = 0; item < (long)(batchSize * d.groups); item++)
+        {
+            const size_t n = item / d.groups;
+            const size_t g = item % d.groups;
+            ElemType* patch = ThreadPatch(patches, unrollRows * outPix);
+            for (size_t r = 0; r < unrollRows; r++)
+            {
+                ElemType* row = patch + r * outPix;
+                std::fill(row, row + outPix, (ElemType)0);
+                for (size_t k = g * d.groupK; k < (g + 1) * d.groupK; k++)
+                {
+                    const ElemType wv = w[k * unrollRows + r];
+                    const ElemType* src = srcGrad.Data() + (n * d.outK + k) * outPix;
+                    for (size_t p = 0; p < outPix; p++)
+                        row[p] += wv * src[p];
+                }
+            }
+            Col2ImAdd(patch, grad.Data() + (n * d.inC + g * d.groupC) * inPix);
+        }
+    }
+
+    // kernelGrad_g += srcGrad_g [K/G x W'H'] * unrolled input_g^T, summed over samples. Work is split by group only,
+    // so this is used when there are at least as many groups as threads.
+    void GroupedBackwardKernel(const Mat& srcGrad, const Mat& in, Mat& kernelGrad, Mat& workspace)
+    {
+        const auto& d = m_dims;
+        const size_t inPix = d.inW * d.inH;
+        const size_t outPix = d.outW * d.outH;
+        const size_t unrollRows = d.groupC * d.kW * d.kH;
+        const size_t batchSize = in.GetNumCols();
+
+        if (!NumaPolicy::IsEnabled())
+            workspace.Resize(1, omp_get_max_threads() * unrollRows * outPix);
+        ElemType* patches = workspace.Data();
+        ElemType* kg = kernelGrad.Data();
+
+#pragma omp parallel for
+        for (long g = 0; g < (long)d.groups; g++)
+        {
+            ElemType* patch = ThreadPatch(patches, unrollRows * outPix);
+            for (size_t n = 0; n < batchSize; n++)
+            {
+                Im2Col(in.Data() + (n * d.inC + g * d.groupC) * inPix, patch);
+                for (size_t k = g * d.groupK; k < (g + 1) * d.groupK; k++)
+                {
+                    const ElemType* src = srcGrad.Data() + (n * d.outK + k) * outPix;
+                    for (size_t r = 0; r < unrollRows; r++)
+                    {
+                        const ElemType* row = patch + r * outPix;
+                        ElemType sum = 0;
+                        for (size_t p = 0; p < outPix; p++)
+                            sum += src[p] * row[p];
+                        kg[k * unrollRows + r] += sum;
+                    }
+                }
+            }
+        }
+    }
+
+    // Transform matrices of F(m x m, 3 x 3), alpha = m + 2:
+    // Y = A^T [(G g G^T) .* (B^T d B)] A for an alpha x alpha input tile d and a 3 x 3 filter g.
+    struct WinogradTransform
+    {
+        size_t m;
+        const double* BT; // alpha x alpha
+        const double* G;  // alpha x 3
+        const double* AT; // m x alpha
+    };
+
+    static const WinogradTransform& GetWinogradTransform(size_t m)
+    {
+        static const double bt2[] = { 1,  0, -1,  0,
+                                      0,  1,  1,  0,
+                                      0, -1,  1,  0,
+                                      0,  1,  0, -1 };
+        static const double g2[] = { 1,    0,   0,
+                                     0.5,  0.5, 0.5,
+                                     0.5, -0.5, 0.5,
+                                     0,    0,   1 };
+        static const double at2[] = { 1, 1,  1,  0,
+                                      0, 1, -1, -1 };
+
+        static const double bt4[] = { 4,  0, -5,  0, 1, 0,
+                                      0, -4, -4,  1, 1, 0,
+                                      0,  4, -4, -1, 1, 0,
+                                      0, -2, -1,  2, 1, 0,
+                                      0,  2, -1, -2, 1, 0,
+                                      0,  4,  0, -5, 0, 1 };
+        static const double g4[] = {  1.0 / 4,   0,          0,
+                                     -1.0 / 6,  -1.0 / 6,   -1.0 / 6,
+                                     -1.0 / 6,   1.0 / 6,   -1.0 / 6,
+                                      1.0 / 24,  1.0 / 12,   1.0 / 6,
+                                      1.0 / 24, -1.0 / 12,   1.0 / 6,
+                                      0,         0,          1 };
+        static const double at4[] = { 1, 1,  1, 1,  1, 0,
+                                      0, 1, -1, 2, -2, 0,
+                                      0, 1,  1, 4,  4, 0,
+                                      0, 1, -1, 8, -8, 1 };
+
+        static const WinogradTransform f2 = { 2, bt2, g2, at2 };
+        static const WinogradTransform f4 = { 4, bt4, g4, at4 };
+        return m == 4 ? f4 : f2;
+    }
+
+    // r[rows x rows] = t * x * t^T for t[rows x inner] and x[inner x inner], all row-major; tmp holds t * x.
+    static void Sandwich(const double* t, const ElemType* x, double* tmp, ElemType* r, size_t rows, size_t inner)
+    {
+        for (size_t i = 0; i < rows; i++)
+            for (size_t j = 0; j < inner; j++)
+            {
+                double sum = 0;
+                for (size_t p = 0; p < inner; p++)
+                    sum += t[i * inner + p] * (double)x[p * inner + j];
+                tmp[i * inner + j] = sum;
+            }
+        for (size_t i = 0; i < rows; i++)
+            for (size_t j = 0; j < rows; j++)
+            {
+                double sum = 0;
+                for (size_t p = 0; p < inner; p++)
+                    sum += tmp[i * inner + p] * t[j * inner + p];
+                r[i * rows + j] = (ElemType)sum;
+            }
+    }
+
+    // Winograd minimal filtering of a stride-1 3x3 correlation:
+    //   forward:       dst[n, j, y, x]  = sum_{i, ky, kx} src[n, i, y - padY + ky, x - padX + kx] * w[j, i, ky, kx]
+    //   backward data: dst[n, j, y, x] += sum_{i, ky, kx} src[n, i, y - (2 - padY) + ky, x - (2 - padX) + kx] * w[i, j, 2 - ky, 2 - kx]
+    // i.e. the backward pass is a forward pass over the output gradients with the kernel rotated by 180 degrees.
+    void WinogradCorrelate(const Mat& src, const Mat& kernel, bool backwardData, Mat& dst, Mat& workspace)
+    {
+        const auto& d = m_dims;
+        const size_t srcC = backwardData ? d.outK : d.inC;
+        const size_t srcW = backwardData ? d.outW : d.inW;
+        const size_t srcH = backwardData ? d.outH : d.inH;
+        const size_t dstC = backwardData ? d.inC : d.outK;
+        const size_t dstW = backwardData ? d.inW : d.outW;
+        const size_t dstH = backwardData ? d.inH : d.outH;
+        const ptrdiff_t padX = backwardData ? 2 - d.padX : d.padX;
+        const ptrdiff_t padY = backwardData ? 2 - d.padY : d.padY;
+
+        // The larger tile saves more multiplications but wastes more of them on the ragged border.
+        const auto& tr = GetWinogradTransform(std::min(dstW, dstH) >= 8 ? 4 : 2);
+        const size_t m = tr.m;
+        const size_t alpha = m + 2;
+        const size_t coefs = alpha * alpha;
+        const size_t tilesX = (dstW + m - 1) / m;
+        const size_t tilesY = (dstH + m - 1) / m;
+        const size_t tilesPerSample = tilesX * tilesY;
+        const size_t srcPlane = srcW * srcH;
+        const size_t dstPlane = dstW * dstH;
+
+        const size_t batchSize = src.GetNumCols();
+        const size_t subBatchSize = m_maxTempMemSizeInSamples == 0 ? batchSize : std::min(batchSize, m_maxTempMemSizeInSamples);
+        const size_t filterSize = coefs * srcC * dstC;
+        const size_t maxTiles = subBatchSize * tilesPerSample;
+
+        // Reserve space for:
+        // 1. Transformed filters U: alpha^2 matrices of [srcC x dstC].
+        // 2. Transformed input tiles V: alpha^2 matrices of [srcC x tiles].
+        // 3. Products M = U^T V: alpha^2 matrices of [dstC x tiles].
+        workspace.Resize(1, filterSize + coefs * (srcC + dstC) * maxTiles);
+
+        // 1. Transform the filters.
+        ElemType* filters = workspace.Data();
+        const ElemType* w = kernel.Data();
+#pragma omp parallel for
+        for (long item = 0; item < (long)(srcC * dstC); item++)
+        {
+            const size_t j = item / srcC;
+            const size_t i = item % srcC;
+            const ElemType* g = backwardData ? w + (i * d.inC + j) * 9 : w + (j * d.inC + i) * 9;
+            ElemType filter[9], u[6 * 6];
+            double tmp[6 * 3];
+            for (size_t p = 0; p < 9; p++)
+                filter[p] = backwardData ? g[8 - p] : g[p];
+            Sandwich(tr.G, filter, tmp, u, alpha, 3);
+            for (size_t xi = 0; xi < coefs; xi++)
+                filters[(xi * dstC + j) * srcC + i] = u[xi];
+        }
+
+        for (size_t start = 0; start < batchSize; start += subBatchSize)
+        {
+            const size_t curBatchSize = std::min(subBatchSize, batchSize - start);
+            const size_t numTiles = curBatchSize * tilesPerSample;
+            ElemType* tiles = workspace.Data() + filterSize;
+            ElemType* products = tiles + coefs * srcC * numTiles;
+            const ElemType* srcData = src.Data() + start * srcC * srcPlane;
+            ElemType* dstData = dst.Data() + start * dstC * dstPlane;
+
+            // 2. Transform the input tiles, zero-padding them at the borders.
+#pragma omp parallel for
+            for (long t = 0; t < (long)numTiles; t++)
+            {
+                const size_t n = t / tilesPerSample;
+                const size_t ty = (t % tilesPerSample) / tilesX;
+                const size_t tx = (t % tilesPerSample) % tilesX;
+                const ptrdiff_t y0 = (ptrdiff_t)(ty * m) - padY;
+                const ptrdiff_t x0 = (ptrdiff_t)(tx * m) - padX;
+                ElemType tile[6 * 6], v[6 * 6];
+                double tmp[6 * 6];
+                for (size_t i = 0; i < srcC; i++)
+                {
+                    const ElemType* plane = srcData + (n * srcC + i) * srcPlane;
+                    for (size_t a = 0; a < alpha; a++)
+                    {
+                        const ptrdiff_t y = y0 + (ptrdiff_t)a;
+                        for (size_t b = 0; b < alpha; b++)
+                        {
+                            const ptrdiff_t x = x0 + (ptrdiff_t)b;
+                            tile[a * alpha + b] = (y >= 0 && y < (ptrdiff_t)srcH && x >= 0 && x < (ptrdiff_t)srcW) ? plane[y * srcW + x] : (ElemType)0;
+                        }
+                    }
+                    Sandwich(tr.BT, tile, tmp, v, alpha, alpha);
+                    for (size_t xi = 0; xi < coefs; xi++)
+                        tiles[(xi * numTiles + t) * srcC + i] = v[xi];
+                }
+            }
+
+            // 3. Reduce over the source channels, one GEMM per transform coefficient: [srcC x dstC]^T * [srcC x tiles] -> [dstC x tiles]
+            for (size_t xi = 0; xi < coefs; xi++)
+            {
+                auto u = workspace.ColumnSlice(xi * srcC * dstC, srcC * dstC);
+                u.Reshape(srcC, dstC);
+                auto v = workspace.ColumnSlice(filterSize + xi * srcC * numTiles, srcC * numTiles);
+                v.Reshape(srcC, numTiles);
+                auto p = workspace.ColumnSlice(filterSize + coefs * srcC * numTiles + xi * dstC * numTiles, dstC * numTiles);
+                p.Reshape(dstC, numTiles);
+                Mat::Multiply(u, true, v, false, p);
+            }
+
+            // 4. Transform the products back and write (forward) or add (backward) the m x m output tiles.
+#pragma omp parallel for
+            for (long t = 0; t < (long)numTiles; t++)
+            {
+                const size_t n = t / tilesPerSample;
+                const size_t ty = (t % tilesPerSample) / tilesX;
+                const size_t tx = (t % tilesPerSample) % tilesX;
+                const size_t rows = std::min(m, dstH - ty * m);
+                const size_t cols = std::min(m, dstW - tx * m);
+                ElemType product[6 * 6], y[4 * 4];
+                double tmp[4 * 6];
+                for (size_t j = 0; j < dstC; j++)
+                {
+                    for (size_t xi = 0; xi < coefs; xi++)
+                        product[xi] = products[(xi * numTiles + t) * dstC + j];
+                    Sandwich(tr.AT, product, tmp, y, m, alpha);
+                    ElemType* plane = dstData + (n * dstC + j) * dstPlane + (ty * m) * dstW + tx * m;
+                    for (size_t a = 0; a < rows; a++)
+                    {
+                        for (size_t b = 0; b < cols; b++)
+                        {
+                            if (backwardData)
+                                plane[a * dstW + b] += y[a * m + b];
+                            else
+                                plane[a * dstW + b] = y[a * m + b];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+public:
+    static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry)
+    {
+        const auto& inT = geometry->InputShape();
+        const auto& kernT = geometry->KernelShape();
+        const size_t groups = geometry->Groups();
+        if (deviceId >= 0 || inT.GetRank() != 3 || groups == 0 || inT[2] % groups != 0 || geometry->GetMapCount(2) % groups != 0)
+            return false;
+        if (find(begin(geometry->Sharing()), end(geometry->Sharing()), false) != end(geometry->Sharing()))
+            return false;
+        for (size_t i = 0; i < inT.GetRank(); i++)
+        {
+            if (geometry->GetDilation(i) != 1)
+                return false;
+        }
+        // The kernel must span all input channels of its group and produce exactly one output per map along the channel axis.
+        return kernT[2] * groups == inT[2] && geometry->OutputShape()[2] == geometry->GetMapCount(2);
+    }
+
+    static bool IsWinogradApplicable(ConvolveGeometryPtr geometry)
+    {
+        const auto& kernT = geometry->KernelShape();
+        return geometry->Groups() == 1 && kernT[0] == 3 && kernT[1] == 3 && geometry->GetStride(0) == 1 && geometry->GetStride(1) == 1;
+    }
+
+    // One input channel and one output map per group.
+    static bool IsDepthwise(ConvolveGeometryPtr geometry)
+    {
+        return geometry->Groups() > 1 && geometry->Groups() == geometry->InputShape()[2] && geometry->Groups() == geometry->GetMapCount(2);
+    }
+
+private:
+    Dims m_dims;
+};
+
+//------------------------------------------------------------------
+// CPU convolution autotuning.
+// Similar to the cuDNN algorithm search, the autotuning engine times every eligible CPU engine on first use
+// for a given pass and minibatch size and then keeps using the fastest one. The choices are shared
+// by all engines in the process and can be persisted in a file so that later runs skip the measurements.
+// Every line of the file holds one choice: <CPU model> TAB <key> TAB <engine>. Entries recorded
+// on a different CPU model are ignored, but kept in the file.
+//------------------------------------------------------------------
+class ConvolutionAutotuningCache
+{
+public:
+    static ConvolutionAutotuningCache& Instance()
+    {
+        static ConvolutionAutotuningCache instance;
+        return instance;
+    }
+
+    void Configure(bool enable, const std::wstring& cacheFilePath)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_enabled = enable;
+        if (m_cacheFilePath != cacheFilePath)
+        {
+            m_cacheFilePath = cacheFilePath;
+            m_choices.clear();
+            m_loaded = false;
+        }
+    }
+
+    bool IsEnabled()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_enabled;
+    }
+
+    bool TryGet(const std::string& key, ConvolutionEngineKind& kind)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        EnsureLoaded();
+        auto it = m_choices.find(key);
+        if (it == m_choices.end())
+            return false;
+        kind = it->second;
+        return true;
+    }
+
+    void Put(const std::string& key, ConvolutionEngineKind kind)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        EnsureLoaded();
+        m_choices[key] = kind;
+        if (!m_cacheFilePath.empty())
+            Save();
+    }
+
+    static const char* EngineKindName(ConvolutionEngineKind kind)
+    {
+        switch (kind)
+        {
+        case ConvolutionEngineKind::Reference: return "Reference";
+        case ConvolutionEngineKind::Gemm:      return "Gemm";
+        case ConvolutionEngineKind::Direct:    return "Direct";
+        default:                               return "None";
+        }
+    }
+
+private:
+    ConvolutionAutotuningCache()
+        : m_enabled(false), m_loaded(false), m_cpuModel(GetCpuModelName())
+    {
+    }
+
+    void EnsureLoaded()
+    {
+        if (m_loaded)
+            return;
+        m_loaded = true;
+        if (m_cacheFilePath.empty())
+            return;
+
+        for (const auto& entry : ReadCacheFile())
+        {
+            if (entry.first.first != m_cpuModel)
+                continue;
+            for (auto kind : { ConvolutionEngineKind::Gemm, ConvolutionEngineKind::Direct })
+            {
+                if (entry.second == EngineKindName(kind))
+                    m_choices[entry.first.second] = kind;
+            }
+        }
+    }
+
+    // (CPU model, key) -> engine name, for all lines of the cache file
+    std::map<std::pair<std::string, std::string>, std::string> ReadCacheFile() const
+    {
+        std::map<std::pair<std::string, std::string>, std::string> entries;
+        FILE* f = _wfopen(m_cacheFilePath.c_str(), L"r");
+        if (f == nullptr)
+            return entries; // nothing tuned yet
+        char line[4096];
+        while (fgets(line, sizeof(line), f) != nullptr)
+        {
+            std::string s(line);
+            while (!s.empty() && (s.back() == '\n' || s.back() == '\r'))
+                s.pop_back();
+            auto first = s.find('\t');
+            auto last = s.rfind('\t');
+            if (first == std::string::npos || first == last)
+                continue;
+            entries[std::make_pair(s.substr(0, first), s.substr(first + 1, last - first - 1))] = s.substr(last + 1);
+        }
+        fclose(f);
+        return entries;
+    }
+
+    // The workers of a parallel job typically share the cache file. Each process therefore writes the whole file to a
+    // file of its own, which then atomically replaces the cache file, so that nobody reads a partially written file.
+    // The entries that other processes have added in the meantime are read right before and kept; only entries written
+    // at the same time can get lost, and are measured again by a later run.
+    void Save()
+    {
+        auto entries = ReadCacheFile();
+        for (const auto& choice : m_choices)
+            entries[std::make_pair(m_cpuModel, choice.first)] = EngineKindName(choice.second);
+
+        std::wstring tempPath = m_cacheFilePath + L"." + std::to_wstring(GetCurrentProcessId()) + L"-" + std::to_wstring(std::random_device()()) + L".tmp";
+        FILE* f = _wfopen(tempPath.c_str(), L"w");
+        bool written = f != nullptr;
+        if (f != nullptr)
+        {
+            for (const auto& entry : entries)
+                written = fprintf(f, "%s\t%s\t%s\n", entry.first.first.c_str(), entry.first.second.c_str(), entry.second.c_str()) >= 0 && written;
+            written = fclose(f) == 0 && written;
+        }
+#ifdef _WIN32
+        written = written && MoveFileExW(tempPath.c_str(), m_cacheFilePath.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+        written = written && rename(msra::strfun::charpath(tempPath).c_str(), msra::strfun::charpath(m_cacheFilePath).c_str()) == 0;
+#endif
+        if (!written)
+        {
+            _wunlink(tempPath.c_str());
+            fprintf(stderr, "WARNING: cannot write convolution autotuning cache file '%ls'.\n", m_cacheFilePath.c_str());
+        }
+    }
+
+    static std::string GetCpuModelName()
+    {
+        std::string model;
+#ifdef _WIN32
+        int regs[12];
+        __cpuid(regs, 0x80000000);
+        if ((unsigned int)regs[0] >= 0x80000004)
+        {
+            __cpuid(regs, 0x80000002);
+            __cpuid(regs + 4, 0x80000003);
+            __cpuid(regs + 8, 0x80000004);
+            model.assign((const char*)regs, sizeof(regs));
+            model = model.c_str();
+        }
+#else
+        FILE* f = fopen("/proc/cpuinfo", "r");
+        if (f != nullptr)
+        {
+            char line[1024];
+            while (fgets(line, sizeof(line), f) != nullptr)
+            {
+                if (strncmp(line, "model name", 10) == 0 && strchr(line, ':') != nullptr)
+                {
+                    model = strchr(line, ':') + 1;
+                    break;
+                }
+            }
+            fclose(f);
+        }
+#endif
+        // Tabs and line breaks would break the cache file format.
+        for (auto& c : model)
+        {
+            if (c == '\t' || c == '\n' || c == '\r')
+                c = ' ';
+        }
+        model.erase(0, model.find_first_not_of(' '));
+        model.erase(model.find_last_not_of(' ') + 1);
+        return model.empty() ? "unknown" : model;
+    }
+
+private:
+    std::mutex m_mutex;
+    bool m_enabled;
+    bool m_loaded;
+    std::wstring m_cacheFilePath;
+    std::string m_cpuModel;
+    std::map<std::string, ConvolutionEngineKind> m_choices;
+};
+
+void SetCpuConvolutionAutotuning(bool enable, const std::wstring& cacheFilePath)
+{
+    ConvolutionAutotuningCache::Instance().Configure(enable, cacheFilePath);
+}
+
+bool IsCpuConvolutionAutotuningEnabled()
+{
+    return ConvolutionAutotuningCache::Instance().IsEnabled();
+}
+
+// Wraps the eligible CPU engines and forwards every pass to the one measured to be the fastest
+// for the current minibatch size.
+template <class ElemType>
+class AutotuningConvolutionEngine : public ConvolutionEngine<ElemType>
+{
+public:
+    using Base = ConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+    using Candidate = std::pair<ConvolutionEngineKind, std::unique_ptr<Base>>;
+
+public:
+    AutotuningConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind, bool poolIncludePad,
+                                std::vector<Candidate>&& candidates, const std::wstring& logPrefix)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad), m_candidates(std::move(candidates)), m_logPrefix(logPrefix)
+    {
+    }
+
+protected:
+    using Base::m_geometry;
+    using Base::m_maxTempMemSizeInSamples;
+
+    enum class Pass
+    {
+        Forward,
+        BackwardData,
+        BackwardKernel
+    };
+
+    void EnsureCompatible() override
+    {
+        if (m_candidates.empty())
+            LogicError("Autotuning convolution engine has no engines to choose from.");
+    }
+
+    void EnsureConvolutionInitialized() override
+    {
+    }
+
+    void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace) override
+    {
+        auto run = [&](Base& eng) { eng.Forward(in, kernel, out, workspace); };
+        Select(Pass::Forward, in.GetNumCols(), run, nullptr).Forward(in, kernel, out, workspace);
+    }
+
+    void BackwardDataCore(const Mat& srcGrad, const Mat& kernel, Mat& grad, bool accumulateGradient, Mat& workspace) override
+    {
+        auto run = [&](Base& eng) { eng.BackwardData(srcGrad, kernel, grad, accumulateGradient, workspace); };
+        Select(Pass::BackwardData, srcGrad.GetNumCols(), run, &grad).BackwardData(srcGrad, kernel, grad, accumulateGradient, workspace);
+    }
+
+    void BackwardKernelCore(const Mat& srcGrad, const Mat& in, Mat& kernelGrad, bool accumulateGradient, bool allowReuse, Mat& workspace) override
+    {
+        auto run = [&](Base& eng) { eng.BackwardKernel(srcGrad, in, kernelGrad, accumulateGradient, allowReuse, workspace); };
+        Select(Pass::BackwardKernel, in.GetNumCols(), run, &kernelGrad).BackwardKernel(srcGrad, in, kernelGrad, accumulateGradient, allowReuse, workspace);
+    }
+
+    void EnsurePoolingInitialized() override
+    {
+        LogicError("Autotuning convolution engine does not support pooling.");
+    }
+
+    void ForwardPoolingCore(const Mat&, Mat&) override
+    {
+        LogicError("Autotuning convolution engine does not support pooling.");
+    }
+
+    void BackwardPoolingCore(const Mat&, const Mat&, const Mat&, Mat&, bool) override
+    {
+        LogicError("Autotuning convolution engine does not support pooling.");
+    }
+
+    void MaxUnpoolingCore(const Mat&, const Mat&, Mat&) override
+    {
+        LogicError("Autotuning convolution engine does not support pooling.");
+    }
+
+    // Returns the engine to use for the pass, measuring all candidates if neither this engine nor the cache has seen
+    // the configuration yet. Passes that accumulate into their output (accumulated) get it restored after every trial.
+    Base& Select(Pass pass, size_t batchSize, const std::function<void(Base&)>& run, Mat* accumulated)
+    {
+        auto choice = m_choices.find(std::make_pair(pass, batchSize));
+        if (choice != m_choices.end())
+            return *m_candidates[choice->second].second;
+
+        auto& cache = ConvolutionAutotuningCache::Instance();
+        std::string key = GetCacheKey(pass, batchSize);
+        ConvolutionEngineKind cachedKind;
+        if (cache.TryGet(key, cachedKind))
+        {
+            for (size_t i = 0; i < m_candidates.size(); i++)
+            {
+                if (m_candidates[i].first == cachedKind)
+                {
+                    m_choices[std::make_pair(pass, batchSize)] = i;
+                    return *m_candidates[i].second;
+                }
+            }
+        }
+
+        std::unique_ptr<Mat> saved;
+        if (accumulated != nullptr)
+            saved = std::make_unique<Mat>(accumulated->DeepClone());
+
+        const int timedRuns = 2;
+        size_t best = m_candidates.size();
+        double bestTime = std::numeric_limits<double>::max();
+        for (size_t i = 0; i < m_candidates.size(); i++)
+        {
+            double time = std::numeric_limits<double>::max();
+            try
+            {
+                // The first run is a warm-up which also initializes the engine.
+                for (int r = 0; r <= timedRuns; r++)
+                {
+                    if (saved)
+                        accumulated->SetValue(*saved);
+                    auto start = std::chrono::high_resolution_clock::now();
+                    run(*m_candidates[i].second);
+                    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+                    if (r > 0)
+                        time = std::min(time, elapsed);
+                }
+            }
+            catch (const std::exception& e)
+            {
+                if (GetMathLibTraceLevel() > 0)
+                    fprintf(stderr, "%lsskipping %s convolution engine in autotuning: %s\n", m_logPrefix.c_str(), ConvolutionAutotuningCache::EngineKindName(m_candidates[i].first), e.what());
+                continue;
+            }
+            if (time < bestTime)
+            {
+                bestTime = time;
+                best = i;
+            }
+        }
+        if (saved)
+            accumulated->SetValue(*saved);
+        if (best == m_candidates.size())
+            RuntimeError("None of the convolution engines supports this configuration. Geometry: %s", ((string)*m_geometry).c_str());
+
+        if (GetMathLibTraceLevel() > 0)
+        {
+            fprintf(stderr, "%lsautotuning selected %s convolution engine (%.3f ms) for %s, minibatch size %d.\n", m_logPrefix.c_str(),
+                    ConvolutionAutotuningCache::EngineKindName(m_candidates[best].first), bestTime, PassName(pass), (int)batchSize);
+        }
+        cache.Put(key, m_candidates[best].first);
+        m_choices[std::make_pair(pass, batchSize)] = best;
+        return *m_candidates[best].second;
+    }
+
+    static const char* PassName(Pass pass)
+    {
+        switch (pass)
+        {
+        case Pass::Forward:      return "forward";
+        case Pass::BackwardData: return "backward data";
+        default:                 return "backward kernel";
+        }
+    }
+
+    // The best engine depends on the geometry, the minibatch size, the available threads and how much temp memory may be used.
+    std::string GetCacheKey(Pass pass, size_t batchSize) const
+    {
+        const auto& g = *m_geometry;
+        std::ostringstream key;
+        key << (std::string)g << ", Dilation: (";
+        for (size_t i = 0; i < g.InputShape().GetRank(); i++)
+            key << (i > 0 ? ", " : "") << g.GetDilation(i);
+        key << "), Groups: " << g.Groups()
+            << ", Precision: " << sizeof(ElemType) * 8
+            << ", Batch: " << batchSize
+            << ", Threads: " << omp_get_max_threads()
+            << ", MaxTempMem: " << m_maxTempMemSizeInSamples
+            << ", Pass: " << PassName(pass);
+        return key.str();
+    }
+
+private:
+    std::vector<Candidate> m_candidates;
+    std::map<std::pair<Pass, size_t>, size_t> m_choices;
+    std::wstring m_logPrefix;
+};
+
+template <class ElemType>
+std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId,
+                                                                                 ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind,
+                                                                                 ConvolutionEngineKind enabledEngines, std::wstring logPrefix,
+                                                                                 bool forceDeterministicAlgorithms, bool poolIncludePad,
+                                                                                 bool inputHasFreeDimension)
+{
+    if (!logPrefix.empty())
+        logPrefix += L": ";
+
+    auto isEnabled = [=](ConvolutionEngineKind eng) { return ((int)enabledEngines & (int)eng) != 0; };
+    // Note: in some cases do not throw exception even if parameters do not match as Create
+    // can be called from places like MEL with default parameters and never be used.
+    // The check will be done later in engine's EnsureCompatible call if the egnine is actually used.
+    auto engStr = (std::string)(*geometry);
+    // Only legacy engine supports HWC layout.
+    if (imageLayout == ImageLayoutKind::HWC)
+    {
+        if (!isEnabled(ConvolutionEngineKind::Legacy))
+            RuntimeError("Trying to use Legacy convolution engine when it's disabled.");
+
+        if (GetMathLibTraceLevel() > 0)
+            fprintf(stderr, "%lsusing legacy convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+
+        return std::make_unique<LegacyConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad);
+    }
+
+    // Check if we can use cuDNN engine. Do not need to validate tensors as ConvolveGeometry has already done that.
+    if (isEnabled(ConvolutionEngineKind::CuDnn) &&
+        CuDnnConvolutionEngineFactory<ElemType>::IsSupported(deviceId, geometry, poolKind))
+    {
+        if (GetMathLibTraceLevel() > 0)
+            fprintf(stderr, "%lsusing cuDNN convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+
+        return CuDnnConvolutionEngineFactory<ElemType>::Create(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind,
+                                                               forceDeterministicAlgorithms, poolIncludePad, inputHasFreeDimension);
+    }
+
+    if (geometry->Groups() == 1)
+    {
+        // With autotuning enabled, let measurements decide between the CPU engines that can run the convolution.
+        // The reference engine is not timed: it is never the fastest, and stays the fallback below.
+        if (poolKind == PoolKind::None && !IsGpu(deviceId) && IsCpuConvolutionAutotuningEnabled())
+        {
+            std::vector<typename AutotuningConvolutionEngine<ElemType>::Candidate> candidates;
+            if (isEnabled(ConvolutionEngineKind::Direct) && DirectConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
+                candidates.emplace_back(ConvolutionEngineKind::Direct, std::make_unique<DirectConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad));
+            if (isEnabled(ConvolutionEngineKind::Gemm) && GemmConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
+                candidates.emplace_back(ConvolutionEngineKind::Gemm, std::make_unique<GemmConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad));
+
+            if (candidates.size() > 1)
+            {
+                if (GetMathLibTraceLevel() > 0)
+                    fprintf(stderr, "%lsusing autotuning convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+
+                return std::make_unique<AutotuningConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad,
+                                                                                std::move(candidates), logPrefix);
+            }
+        }
+
+        // The direct engine rounds differently from unrolling+GEMM (Winograd in particular), so existing models keep the GEMM
+        // engine by default. Direct is used only when GEMM engine is disabled, or when autotuning above measured it to be faster.
+        if (poolKind == PoolKind::None && isEnabled(ConvolutionEngineKind::Direct) && DirectConvolutionEngine<ElemType>::IsSupported(deviceId, geometry) &&
+            !isEnabled(ConvolutionEngineKind::Gemm))
+        {
+            if (GetMathLibTraceLevel() > 0)
+                fprintf(stderr, "%lsusing direct convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+
+            return std::make_unique<DirectConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad);
+        }
+
+        if (isEnabled(ConvolutionEngineKind::Gemm) && GemmConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
+        {
+            if (GetMathLibTraceLevel() > 0)
+                fprintf(stderr, "%lsusing GEMM convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+
+            return std::make_unique<GemmConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad);
+        }
+
+        if (!isEnabled(ConvolutionEngineKind::Reference))
+            RuntimeError("Reference convolution is disabled and no other engine supports such configuration (or disabled).");
+
+        if (GetMathLibTraceLevel() > 0)
+            fprintf(stderr, "%lsusing reference convolution engine for geometry, could be VERY SLOW: %s.\n", logPrefix.c_str(), engStr.c_str());
+
+        return std::make_unique<ReferenceConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad);
+    }
+    else if (geometry->Groups() > 1)
+    {
+        if (!(geometry->InputShape().GetRank() < 4))
+        {
+            RuntimeError("Group convolution, i.e. groups > 1, for 3-dimensional convolution or higher is not supported on the CPU. Please use GPU, if possible.");
+        }
+        // Dedicated depthwise and grouped kernels. Grouped convolutions with several channels per group are left to MKL 2017 when available.
+        if (isEnabled(ConvolutionEngineKind::Direct) && DirectConvolutionEngine<ElemType>::IsSupported(deviceId, geometry) &&
+            (DirectConvolutionEngine<ElemType>::IsDepthwise(geometry) || !GemmConvolutionEngine<ElemType>::IsMklEnabled() || !isEnabled(ConvolutionEngineKind::Gemm)))
+        {
+            if (GetMathLibTraceLevel() > 0)
+                fprintf(stderr, "%lsusing direct convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+
+            return std::make_unique<DirectConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad);
         }
-        // For group convolution, MKL 2017 is required. If it is not enabled, we throw an error.
+        // Otherwise, for group convolution, MKL 2017 is required. If it is not enabled, we throw an error.
         if (GemmConvolutionEngine<ElemType>::IsMklEnabled())
         {
             if (isEnabled(ConvolutionEngineKind::Gemm) && GemmConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
@@ -1296,9 +1296,13 @@ void Matrix<ElemType>::AssignValuesOf(const Matrix<ElemType>& deepCopyFrom)
             // Set CPUSparseMatrix from:
             DISPATCH_MATRIX_ON_FLAG(&deepCopyFrom, nullptr,
                 { auto matrixType = GetMatrixType(); auto matrixFormat = GetFormat(); *this = deepCopyFrom.DeepClone(); SwitchToMatrixType(matrixType, matrixFormat, true); },
-                { LogicError("AssignValuesOf: Assigning a GPUMatrix to a CPUSparseMatrix is not yet implemented."); },//{ m_CPUSparseMatrix->SetValue(*deepCopyFrom.m_GPUMatrix); },
+                {
+                    CPUMatrix<ElemType> tempCPUDenseMatrix(deepCopyFrom.GetNumRows(), deepCopyFrom.GetNumCols());
+                    deepCopyFrom.CopySection(deepCopyFrom.GetNumRows(), deepCopyFrom.GetNumCols(), tempCPUDenseMatrix.Data(), deepCopyFrom.GetNumRows());
+                    m_CPUSparseMatrix->SetValue(tempCPUDenseMatrix);
+                },
                 { m_CPUSparseMatrix->SetValue(*deepCopyFrom.m_CPUSparseMatrix); },
-                { LogicError("AssignValuesOf: Assigning a GPUSparseMatrix to a CPUSparseMatrix is not yet implemented."); });//{ m_CPUSparseMatrix->SetValue(*deepCopyFrom.m_GPUSparseMatrix); });
+                { deepCopyFrom.m_GPUSparseMatrix->CopyToCPUSparseMatrix(*m_CPUSparseMatrix); });
         },
         {
             // Set GPUSparseMatrix from:
@@ -1682,7 +1686,9 @@ void Matrix<ElemType>::MomentumSGDUpdate(Matrix<ElemType>& gradients,
                                          Matrix<ElemType>& smoothedGradients,
                                          ElemType learnRatePerSample,
                                          ElemType momentum,
-                                         ElemType unitGainFactor)
+                                         ElemType unitGainFactor,
+                                         int* timestamps,
+                                         const LazyDecayHistory* decayHistory)
 {
     DecideAndMoveToRightDevice(smoothedGradients, gradients, *this);
 
@@ -1708,9 +1714,11 @@ void Matrix<ElemType>::MomentumSGDUpdate(Matrix<ElemType>& gradients,
             // 1) sg_t = momentum * sg_{t-1} + (1.0 - momentum) * g_{t-1}
             // 2) g'_{t-1} = sg_t
             // 3) w_t = w_{t-1} - learnRatePerSample * g'_{t-1}
+            // Only the columns present in the gradient are updated; with timestamps the smoothed gradients
+            // of these columns are first decayed as if the dense update had been applied all along.
             if (momentum != 0)
             {
-                gradients.m_CPUSparseMatrix->NormalGrad(*smoothedGradients.m_CPUMatrix, momentum, unitGainFactor);
+                gradients.m_CPUSparseMatrix->NormalGrad(*smoothedGradients.m_CPUMatrix, momentum, unitGainFactor, timestamps, decayHistory);
             }
             ScaleAndAdd(-learnRatePerSample, gradients, *this);
         },
@@ -1798,7 +1806,8 @@ ElemType Matrix<ElemType>::Adagrad(Matrix<ElemType>& gradients, const bool needA
 //  - the model itself
 template <class ElemType>
 void Matrix<ElemType>::FSAdagradUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const double targetAdagradAvDenom_x_sqrtAdagradSqrFrames,
-                                       const double learnRatePerSample, const double meanMomentum, const double varMomentum, ElemType unitGainFactor)
+                                       const double learnRatePerSample, const double meanMomentum, const double varMomentum, ElemType unitGainFactor,
+                                       int* timestamps, const LazyDecayHistory* decayHistory)
 {
     DISPATCH_MATRIX_ON_FLAG(&gradients, &gradients,
         {
@@ -1813,7 +1822,12 @@ void Matrix<ElemType>::FSAdagradUpdate(Matrix<ElemType>& gradients, Matrix<ElemT
                                    (ElemType)targetAdagradAvDenom_x_sqrtAdagradSqrFrames, unitGainFactor);
             SetDataLocation(GPU);
         },
-        { NOT_IMPLEMENTED; },
+        {
+            gradients.m_CPUSparseMatrix->FSAdagrad(*m_CPUMatrix, *functionValues.m_CPUMatrix,
+                                                   (ElemType)learnRatePerSample, (ElemType)meanMomentum, (ElemType)varMomentum,
+                                                   (ElemType)targetAdagradAvDenom_x_sqrtAdagradSqrFrames, unitGainFactor, timestamps, decayHistory);
+            SetDataLocation(CPU);
+        },
         {
             gradients.m_GPUSparseMatrix->FSAdagrad(*m_GPUMatrix, *functionValues.m_GPUMatrix,
                                                    (ElemType)learnRatePerSample, (ElemType)meanMomentum, (ElemType)varMomentum,
@@ -1834,7 +1848,8 @@ void Matrix<ElemType>::FSAdagradUpdate(Matrix<ElemType>& gradients, Matrix<ElemT
 // varMomentum - /beta_2
 template <class ElemType>
 void Matrix<ElemType>::AdamUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const double smoothedCount,
-    const double learnRatePerSample, const double meanMomentum, const double varMomentum, const double epsilon, ElemType unitGainFactor, bool adamax)
+    const double learnRatePerSample, const double meanMomentum, const double varMomentum, const double epsilon, ElemType unitGainFactor, bool adamax,
+    int* timestamps, const LazyDecayHistory* decayHistory)
 {
     // Bias correction
     let biasCorrection = adamax? (ElemType)(1. / (1- pow(meanMomentum, smoothedCount))) : (ElemType)(sqrt(1- pow(varMomentum, smoothedCount))/(1- pow(meanMomentum, smoothedCount)));
@@ -1852,7 +1867,12 @@ void Matrix<ElemType>::AdamUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>&
         biasCorrection, (ElemType)epsilon, unitGainFactor, adamax);
         SetDataLocation(GPU);
     },
-    { NOT_IMPLEMENTED; },
+    {
+        gradients.m_CPUSparseMatrix->Adam(*m_CPUMatrix, *functionValues.m_CPUMatrix,
+        (ElemType)learnRatePerSample, (ElemType)meanMomentum, (ElemType)varMomentum,
+        biasCorrection, (ElemType)epsilon, unitGainFactor, adamax, timestamps, decayHistory);
+        SetDataLocation(CPU);
+    },
     { gradients.m_GPUSparseMatrix->Adam(*m_GPUMatrix, *functionValues.m_GPUMatrix,
         (ElemType)learnRatePerSample, (ElemType)meanMomentum,
         (ElemType)varMomentum, biasCorrection, (ElemType)epsilon, unitGainFactor, adamax);
@@ -1909,6 +1929,17 @@ void Matrix<ElemType>::AdaDeltaFlushState(size_t cols, ElemType rho, int* timest
     { NOT_IMPLEMENTED; });
 }
 
+// Brings the state of a learner that was updated lazily through timestamps up to date, see CPUMatrix::LazyDecayFlushTimestamps().
+template <class ElemType>
+void Matrix<ElemType>::LazyDecayFlushState(size_t cols, const LazyDecayHistory& decayHistory, int* timestamps)
+{
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+    { m_CPUMatrix->LazyDecayFlushTimestamps(cols, decayHistory, timestamps); SetDataLocation(CPU); },
+    { NOT_IMPLEMENTED; },
+    { NOT_IMPLEMENTED; },
+    { NOT_IMPLEMENTED; });
+}
+
 template <class ElemType>
 void Matrix<ElemType>::Reshape(const size_t numRows, const size_t numCols)
 {
@@ -4678,6 +4709,72 @@ Matrix<ElemType>& Matrix<ElemType>::AssignNoiseContrastiveEstimation(const Matri
     return *this;
 }
 
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignSampledLogSoftmax(const Matrix<ElemType>& hidden, const std::vector<size_t>& hiddenColumns, const Matrix<ElemType>& weights,
+                                                            const std::vector<size_t>& candidates, const std::vector<size_t>& offsets)
+{
+    if (hidden.IsEmpty() || weights.IsEmpty())
+        LogicError("AssignSampledLogSoftmax: one of the input matrices is empty.");
+
+    DecideAndMoveToRightDevice(hidden, weights, *this);
+    SwitchToMatrixType(hidden.GetMatrixType(), hidden.GetFormat(), false);
+
+    DISPATCH_MATRIX_ON_FLAG(&hidden,
+                            this,
+                            m_CPUMatrix->AssignSampledLogSoftmax(*hidden.m_CPUMatrix, hiddenColumns, *weights.m_CPUMatrix, candidates, offsets),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignGMMLogLikelihood(const Matrix<ElemType>& features, const Matrix<ElemType>& scaledMeans, const Matrix<ElemType>& precisions,
+                                                           const Matrix<ElemType>& logNormalizers, Matrix<ElemType>& posterior)
+{
+    if (features.IsEmpty() || scaledMeans.IsEmpty() || precisions.IsEmpty() || logNormalizers.IsEmpty())
+        LogicError("AssignGMMLogLikelihood: one of the input matrices is empty.");
+
+    DecideAndMoveToRightDevice(features, scaledMeans, *this);
+    if (precisions.GetDeviceId() != GetDeviceId() || logNormalizers.GetDeviceId() != GetDeviceId() || posterior.GetDeviceId() != GetDeviceId())
+        NOT_IMPLEMENTED;
+    SwitchToMatrixType(features.GetMatrixType(), features.GetFormat(), false);
+
+    DISPATCH_MATRIX_ON_FLAG(&features,
+                            this,
+                            m_CPUMatrix->AssignGMMLogLikelihood(*features.m_CPUMatrix, *scaledMeans.m_CPUMatrix, *precisions.m_CPUMatrix, *logNormalizers.m_CPUMatrix, *posterior.m_CPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignSoftmaxCrossEntropyOf(const Matrix<ElemType>& labels, const Matrix<ElemType>& logits, Matrix<ElemType>& logSumExp)
+{
+    if (labels.IsEmpty() || logits.IsEmpty())
+        LogicError("AssignSoftmaxCrossEntropyOf: one of the input matrices is empty.");
+
+    DecideAndMoveToRightDevice(labels, logits, *this);
+    if (logSumExp.GetDeviceId() != GetDeviceId() || logits.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+    SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+
+    // (the labels decide the kernel, the result is dense either way)
+    DISPATCH_MATRIX_ON_FLAG(&labels,
+                            nullptr,
+                            m_CPUMatrix->AssignSoftmaxCrossEntropyOf(*labels.m_CPUMatrix, *logits.m_CPUMatrix, *logSumExp.m_CPUMatrix),
+                            NOT_IMPLEMENTED,
+                            m_CPUMatrix->RequireSize(1, 1); m_CPUMatrix->SetValue(CPUSparseMatrix<ElemType>::SoftmaxCrossEntropy(*labels.m_CPUSparseMatrix, *logits.m_CPUMatrix, *logSumExp.m_CPUMatrix)),
+                            NOT_IMPLEMENTED);
+    SetDataLocation(CurrentDataLocation::CPU, MatrixType::DENSE);
+    logSumExp.SetDataLocation(CurrentDataLocation::CPU, MatrixType::DENSE);
+
+    return *this;
+}
+
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::AssignNCEDerivative(const Matrix<ElemType>& tmp, const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, size_t inputIndex)
 {
@@ -5536,6 +5633,25 @@ void Matrix<ElemType>::AddScaledDifference(const Matrix<ElemType>& alpha, const
                             NOT_IMPLEMENTED);
 }
 
+// c += alpha * (softmax(logits) - labels), see AssignSoftmaxCrossEntropyOf()
+template <class ElemType>
+void Matrix<ElemType>::AddSoftmaxCrossEntropyGradient(const Matrix<ElemType>& alpha, const Matrix<ElemType>& logits, const Matrix<ElemType>& logSumExp,
+                                                      const Matrix<ElemType>& labels, Matrix<ElemType>& c)
+{
+    DecideAndMoveToRightDevice(c, logits, labels);
+    if (logSumExp.GetDeviceId() != c.GetDeviceId() || logits.GetMatrixType() != MatrixType::DENSE || c.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+    const ElemType scale = alpha.Get00Element();
+
+    DISPATCH_MATRIX_ON_FLAG(&labels,
+                            nullptr,
+                            CPUMatrix<ElemType>::AddSoftmaxCrossEntropyGradient(scale, *logits.m_CPUMatrix, *logSumExp.m_CPUMatrix, *labels.m_CPUMatrix, *c.m_CPUMatrix),
+                            NOT_IMPLEMENTED,
+                            CPUSparseMatrix<ElemType>::AddSoftmaxCrossEntropyGradient(scale, *logits.m_CPUMatrix, *logSumExp.m_CPUMatrix, *labels.m_CPUSparseMatrix, *c.m_CPUMatrix),
+                            NOT_IMPLEMENTED);
+    c.SetDataLocation(CurrentDataLocation::CPU, MatrixType::DENSE);
+}
+
 /// <summary> c = alpha * (a-b)</summary>
 /// if a, b, c  must have same dim
 /// <param name="alpha">Scalar</param>
@@ -5736,9 +5852,9 @@ ElemType Matrix<ElemType>::InnerProductOfMatrices(const Matrix<ElemType>& a, con
     {
         DISPATCH_MATRIX_ON_FLAG(&a,
                                 nullptr,
-                                NOT_IMPLEMENTED,
+                                return CPUSparseMatrix<ElemType>::InnerProductOfMatrices(*b.m_CPUSparseMatrix, *a.m_CPUMatrix),
                                 return GPUSparseMatrix<ElemType>::InnerProductOfMatrices(*a.m_GPUMatrix, *b.m_GPUSparseMatrix),
-                                NOT_IMPLEMENTED,
+                                return CPUSparseMatrix<ElemType>::InnerProductOfMatrices(*a.m_CPUSparseMatrix, *b.m_CPUMatrix),
                                 return GPUSparseMatrix<ElemType>::InnerProductOfMatrices(*a.m_GPUSparseMatrix, *b.m_GPUMatrix));
     }
 }
@@ -208,15 +208,19 @@ public:
     void AssignDiagonalValuesTo(Matrix<ElemType>& diag) const;
 
     void SGDUpdate(Matrix<ElemType>& gradients, ElemType learnRatePerSample);
-    void MomentumSGDUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>& smoothedGradients, ElemType learnRatePerSample, ElemType momentum, ElemType unitGainFactor);
+    // The optional timestamps enable lazy updates of the smoothed state for sparse gradients on the CPU, see CPUSparseMatrix::NormalGrad().
+    void MomentumSGDUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>& smoothedGradients, ElemType learnRatePerSample, ElemType momentum, ElemType unitGainFactor,
+                           int* timestamps = nullptr, const LazyDecayHistory* decayHistory = nullptr);
     void NesterovAcceleratedMomentumSGDUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>& smoothedGradients, ElemType learnRatePerSample, ElemType momentum, ElemType unitGainFactor);
 
     ElemType Adagrad(Matrix<ElemType>& gradients, const bool needAveMultiplier);
     void FSAdagradUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const double targetAdagradAvDenom_x_sqrtAdagradSqrFrames,
-                         const double learnRatePerSample, const double meanMomentum, const double varMomentum, ElemType unitGainFactor);
+                         const double learnRatePerSample, const double meanMomentum, const double varMomentum, ElemType unitGainFactor,
+                         int* timestamps = nullptr, const LazyDecayHistory* decayHistory = nullptr);
 
     void AdamUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const double smoothedCount,
-        const double learnRatePerSample, const double meanMomentum, const double varMomentum, const double epsilon, ElemType unitGainFactor, bool adamax = false);
+        const double learnRatePerSample, const double meanMomentum, const double varMomentum, const double epsilon, ElemType unitGainFactor, bool adamax = false,
+        int* timestamps = nullptr, const LazyDecayHistory* decayHistory = nullptr);
 
     ElemType RmsProp(Matrix<ElemType>& gradients, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier, const bool initialized);
 
@@ -224,6 +228,7 @@ public:
     void AdaDeltaUpdate(Matrix<GradType>& gradients, Matrix<ElemType>& functionvalues, ElemType learningRatePerSample, ElemType rho, ElemType epsilon, int* timestamps, int currentTimestamp);
 
     void AdaDeltaFlushState(size_t stride, ElemType rho, int* timestamps, int currentTimestamp);
+    void LazyDecayFlushState(size_t cols, const LazyDecayHistory& decayHistory, int* timestamps);
 
     void Resize(const size_t numRows, const size_t numCols, const size_t numNZElemToReserve = 10000, bool growOnly = true, bool keepValue = false); // by default we only reallocate if need to grow
     void Resize(const Matrix<ElemType>& other) // TODO: Should this carry over numNZElemToReserve for sparse matrices?
@@ -317,6 +322,20 @@ public:
     Matrix<ElemType>& AssignNCEDerivative(const Matrix<ElemType>& tmp, const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, size_t inputIndex);
     Matrix<ElemType>& AssignSoftmaxSum(const Matrix<ElemType>& a, const Matrix<ElemType>& softmax);
     Matrix<ElemType>& AssignNceUnnormalizedEval(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, const Matrix<ElemType>& bias);
+    // Fused gather-GEMM-logsumexp over a subset of the output classes (sampled or class-based softmax).
+    // Segment k consists of the columns candidates[offsets[k] .. offsets[k+1]) of weights and is scored against column hiddenColumns[k] of hidden;
+    // this (1 x candidates.size()) receives the per-segment log-softmax of the logits weights(:, c)^T * hidden(:, hiddenColumns[k]).
+    Matrix<ElemType>& AssignSampledLogSoftmax(const Matrix<ElemType>& hidden, const std::vector<size_t>& hiddenColumns, const Matrix<ElemType>& weights,
+                                              const std::vector<size_t>& candidates, const std::vector<size_t>& offsets);
+    // Fused log-likelihood of a Gaussian mixture with one variance per component, for parameters shared by all frames.
+    // With precisions p_k = 1/stddev_k^2, scaledMeans(:, k) = p_k * mean_k and logNormalizers_k = log prior_k - 0.5 p_k ||mean_k||^2 - dim * log(stddev_k) - dim/2 * log(2 pi),
+    // this (1 x #frames) receives log sum_k exp(logNormalizers_k + scaledMeans(:, k)^T x_t - 0.5 p_k ||x_t||^2), and posterior (#components x #frames) the component posteriors.
+    Matrix<ElemType>& AssignGMMLogLikelihood(const Matrix<ElemType>& features, const Matrix<ElemType>& scaledMeans, const Matrix<ElemType>& precisions,
+                                             const Matrix<ElemType>& logNormalizers, Matrix<ElemType>& posterior);
+    // Fused softmax cross-entropy over the columns of logits: logSumExp (1 x #columns) receives log sum_i exp(logits(i, j)), which takes
+    // a single pass over the logits, in blocks of rows with a running max, and this (1 x 1) receives -sum_ij labels(i, j) (logits(i, j) - logSumExp(j)).
+    // Only nonzero labels are visited, so columns without labels (e.g. gaps masked to zero) contribute 0 whatever their logits. Labels may be sparse (CSC).
+    Matrix<ElemType>& AssignSoftmaxCrossEntropyOf(const Matrix<ElemType>& labels, const Matrix<ElemType>& logits, Matrix<ElemType>& logSumExp);
 
     Matrix<ElemType>& AssignOneHot(const Matrix<ElemType>& a, vector<size_t>& shape, size_t axis, bool is_sparse);
     Matrix<ElemType>& GatherFromTarget(const Matrix<ElemType>& indices, const Matrix<ElemType>& target, size_t row_elements);
@@ -621,6 +640,9 @@ public:
     static void AddScaledDifference(const ElemType alpha, const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c);
     static void AssignScaledDifference(const ElemType alpha, const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c);
     static void AddScaledDifference(const Matrix<ElemType>& alpha, const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c); // c += alpha * (a - b)
+    // c += alpha * (softmax(logits) - labels), with the softmax recomputed from the logSumExp of AssignSoftmaxCrossEntropyOf(); alpha is 1x1
+    static void AddSoftmaxCrossEntropyGradient(const Matrix<ElemType>& alpha, const Matrix<ElemType>& logits, const Matrix<ElemType>& logSumExp,
+                                               const Matrix<ElemType>& labels, Matrix<ElemType>& c);
     static void AssignScaledDifference(const Matrix<ElemType>& alpha, const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c);
 
     static void AddElementToElement(const Matrix<ElemType>& a, const size_t ai, const size_t aj, Matrix<ElemType>& c, const size_t ci, const size_t cj);
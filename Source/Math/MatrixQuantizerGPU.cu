@@ -365,6 +365,11 @@ void GPUMatrixComputeStreamEvent::SynchronizeEvent()
     cudaEventSynchronize(m_mainGPUComputeStreamCUDAEvent) || "cudaEventSynchronize failed";
 }
 
+void GPUMatrixComputeStreamEvent::Record()
+{
+    cudaEventRecord(m_mainGPUComputeStreamCUDAEvent, GetStream()) || "cudaEventRecord failed";
+}
+
 template <typename ElemType>
 void GPUMatrixComputeStreamEvent::SynchronizeQuantizationComputeStreamWithEvent()
 {
@@ -90,6 +90,7 @@ public:
     ~GPUMatrixComputeStreamEvent();
 
     void SynchronizeEvent() override;
+    void Record() override;
 
     template <typename ElemType>
     void SynchronizeQuantizationComputeStreamWithEvent();
@@ -44,6 +44,10 @@ void MatrixComputeStreamEvent::SynchronizeEvent()
 {
 }
 
+void MatrixComputeStreamEvent::Record()
+{
+}
+
 template <typename ElemType>
 void MatrixComputeStreamEvent::SynchronizeQuantizationComputeStreamWithEvent()
 {
@@ -58,6 +58,9 @@ public:
 
     virtual void SynchronizeEvent();
 
+    // record the event again, at the current end of the stream, so that it can be reused for the next wait
+    virtual void Record();
+
     template <typename ElemType>
     void SynchronizeQuantizationComputeStreamWithEvent();
 
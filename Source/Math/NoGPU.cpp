@@ -2440,6 +2440,7 @@ GPUMatrixComputeStreamEvent::GPUMatrixComputeStreamEvent(int deviceId)
 
 GPUMatrixComputeStreamEvent::~GPUMatrixComputeStreamEvent(){};
 void GPUMatrixComputeStreamEvent::SynchronizeEvent(){};
+void GPUMatrixComputeStreamEvent::Record(){};
 template <>
 void GPUMatrixComputeStreamEvent::SynchronizeQuantizationComputeStreamWithEvent<float>(){};
 template <>
@@ -16,9 +16,15 @@
 #include "Basics.h"
 #include "fileutil.h"
 #include "TimerUtility.h"
+#include "Platform.h"
 #include <algorithm>
+#include <atomic>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include <stdio.h>
 #ifndef CPUONLY
 #include <cuda_runtime_api.h>
@@ -67,6 +73,11 @@ static const FixedEventDesc c_fixedEvtDesc[profilerEvtMax] = {
     { "", profilerEvtSeparator, false },                            // profilerSepSpace2
 
     { "Prefetch Minibatch", profilerEvtTime, false },               // profilerEvtPrefetchMinibatch
+    { "_Read Sequences", profilerEvtTime, false },                  // profilerEvtReadSequences
+    { "_Pack Minibatch", profilerEvtTime, false },                  // profilerEvtPackMinibatch
+    { "_Copy Minibatch", profilerEvtTime, false },                  // profilerEvtCopyMinibatch
+    { "_Copy Throughput", profilerEvtThroughput, false },           // profilerEvtCopyThroughput
+    { "Prefetch Wait", profilerEvtTime, false },                    // profilerEvtPrefetchWait
 };
 
 
@@ -78,17 +89,38 @@ struct FixedEventRecord
     long long       min;          // time (ns) or throughput (kB/s)
     long long       max;          // time (ns) or throughput (kB/s)
     long long       totalBytes;   // used only for throughput events
+    long long       histogram[ProfilerEventStatistics::c_numHistogramBuckets]; // used only for time events
 };
 
 //
-// The custom event record is a variable size datastructure in memory:
-// NULL terminated description string, followed by CustomEventRecord struct
+// Event record for the detail file. The description points to a string interned in ProfilerState::descriptions,
+// so that records stay small without truncating long (e.g. node) names.
 //
-struct CustomEventRecord
+struct EventRecord
 {
     long long       beginClock;
     long long       endClock;
-    unsigned int    threadId;
+    long long       minibatchId;    // minibatch iteration during which the event ended
+    const char*     description;
+};
+
+//
+// Events of one thread. Only the owning thread writes to it, so recording an event takes no lock.
+// Events are kept in a ring buffer: when it is full, the oldest events are overwritten.
+//
+struct ThreadEventBuffer
+{
+    ThreadEventBuffer(unsigned int threadId, size_t capacity)
+        : threadId(threadId), fixedEvents(), capacity(capacity), events(new EventRecord[capacity]), numEvents(0)
+    {
+    }
+
+    unsigned int                        threadId;
+    FixedEventRecord                    fixedEvents[profilerEvtMax];    // Profiling data for each fixed event, of this thread
+    size_t                              capacity;                       // Number of records in the ring buffer
+    unique_ptr<EventRecord[]>           events;                         // Ring buffer
+    std::atomic<unsigned long long>     numEvents;                      // Number of events recorded, including overwritten ones
+    std::unordered_map<std::string, const char*> descriptions;          // Descriptions this thread has interned, to look them up without a lock
 };
 
 
@@ -97,26 +129,33 @@ struct CustomEventRecord
 //
 struct ProfilerState
 {
-    bool                    enabled;                     // Profiler enabled (active)
+    std::atomic<bool>       enabled;                     // Profiler enabled (active)
     bool                    syncGpu;                     // Sync GPU per each profiling event
     bool                    cudaSyncEnabled;             // Runtime state of CUDA kernel sync
     std::wstring            profilerDir;                 // Directory where reports/logs are saved
     std::wstring            logSuffix;                   // Suffix to append to report/log file names
-    FixedEventRecord        fixedEvents[profilerEvtMax]; // Profiling data for each fixed event
-    bool                    customEventBufferFull;       // Is custom event buffer full?
-    unsigned long long      customEventBufferBytes;      // Number of bytes allocated for the custom event buffer
-    unsigned long long      customEventOffset;           // Offset to current place in buffer
-    unique_ptr<char[]>      customEventBuffer;           // Pointer to custom event buffer
-    long long               startClock;
+    int                     rank;                        // Rank of this process in distributed training
+    unsigned long long      sessionId;                   // Distinguishes the thread buffers of successive ProfilerInit() calls
+    FixedEventRecord        fixedEvents[profilerEvtMax]; // Profiling data for each fixed event, merged over all threads in ProfilerClose()
+    unsigned long long      customEventBufferBytes;      // Number of bytes allocated for the event buffer of each thread
+    std::vector<unique_ptr<ThreadEventBuffer>> threadBuffers; // Event buffers of all threads that recorded events
+    std::unordered_set<std::string> descriptions;        // Descriptions of all custom events (the elements do not move)
+    std::atomic<long long>  minibatchId;                 // Number of completed minibatch iterations (profilerEvtMainMinibatch)
+    long long               startClock;                  // Time of the first ProfilerEnable(true) call
 };
 
 
 // We support one global instance of the profiler
 static unique_ptr<ProfilerState> g_profilerState;
 
-// Mutex controlling access to g_profilerState
+// Mutex controlling access to g_profilerState->threadBuffers and g_profilerState->descriptions
 static std::mutex g_mutex;
 
+// Event buffer of the current thread, valid if the thread-local session id matches that of g_profilerState
+static unsigned long long g_lastSessionId = 0;
+static THREAD_LOCAL ThreadEventBuffer* t_threadBuffer = nullptr;
+static THREAD_LOCAL unsigned long long t_threadBufferSessionId = 0;
+
 // Forward declarations
 unsigned int GetThreadId();
 
@@ -142,13 +181,14 @@ double TicksSqToSecondsSq(double ticksSq)
 
 //
 // Initialize all resources to enable profiling.
-// profilerDir: Directory where the profiler logs will be saved.
-// customEventBufferBytes: Size of the custom event buffer.
+// profilerDir: Directory where the profiler logs will be saved. If empty, no logs are written.
+// customEventBufferBytes: Size of the event buffer of each thread that records events (the descriptions are stored separately, once each).
 // logSuffix: Suffix string to append to log file names.
 // syncGpu: Wait for GPU to complete processing for each profiling event with syncGpu flag set.
+// rank: Rank of this process in distributed training, used as process id in the detail file.
 //
 void PERF_PROFILER_API ProfilerInit(const std::wstring& profilerDir, const unsigned long long customEventBufferBytes,
-    const std::wstring& logSuffix, const bool syncGpu)
+    const std::wstring& logSuffix, const bool syncGpu, const int rank)
 {
     if (g_profilerState != nullptr)
     {
@@ -158,16 +198,17 @@ void PERF_PROFILER_API ProfilerInit(const std::wstring& profilerDir, const unsig
 
     g_profilerState->profilerDir = profilerDir;
     g_profilerState->logSuffix = logSuffix;
+    g_profilerState->rank = rank;
+    g_profilerState->sessionId = ++g_lastSessionId;
 
-    g_profilerState->customEventBufferFull = false;
     g_profilerState->customEventBufferBytes = customEventBufferBytes;
-    g_profilerState->customEventOffset = 0ull;
-    g_profilerState->customEventBuffer.reset(new char[customEventBufferBytes]);
+    g_profilerState->minibatchId = 0;
+    g_profilerState->startClock = 0;
 
     g_profilerState->syncGpu = syncGpu;
     g_profilerState->enabled = false;
 
-    if (_wmkdir(g_profilerState->profilerDir.c_str()) == -1 && errno != EEXIST)
+    if (!g_profilerState->profilerDir.empty() && _wmkdir(g_profilerState->profilerDir.c_str()) == -1 && errno != EEXIST)
     {
         RuntimeError("Error: ProfilerInit: Cannot create directory <%ls>.\n", g_profilerState->profilerDir.c_str());
     }
@@ -184,67 +225,115 @@ void PERF_PROFILER_API ProfilerEnable(bool enable)
     if (g_profilerState == nullptr)
         return;
 
+    // Timestamps in the detail file are relative to the first time the profiler got enabled.
+    if (enable && g_profilerState->startClock == 0)
+    {
+        g_profilerState->startClock = Clock::GetTimeStamp();
+    }
+
     g_profilerState->enabled = enable;
+}
+
+//
+// Whether profiling is currently enabled.
+//
+bool PERF_PROFILER_API ProfilerIsEnabled()
+{
+    return g_profilerState != nullptr && g_profilerState->enabled;
+}
+
 
-    if (enable)
+//
+// Get the event buffer of the calling thread, creating it on the first event of the thread.
+//
+ThreadEventBuffer* GetThreadEventBuffer()
+{
+    if (t_threadBufferSessionId != g_profilerState->sessionId)
     {
-        g_profilerState->startClock = Clock::GetTimeStamp();
+        size_t capacity = (size_t)(g_profilerState->customEventBufferBytes / sizeof(EventRecord));
+        unique_ptr<ThreadEventBuffer> threadBuffer(new ThreadEventBuffer(GetThreadId(), capacity));
+
+        std::lock_guard<std::mutex> lock(g_mutex);
+        t_threadBuffer = threadBuffer.get();
+        t_threadBufferSessionId = g_profilerState->sessionId;
+        g_profilerState->threadBuffers.push_back(std::move(threadBuffer));
+    }
+    return t_threadBuffer;
+}
+
+
+//
+// Get the interned copy of an event description. Only a description that is new to the calling thread takes the lock.
+//
+const char* InternEventDescription(ThreadEventBuffer* threadBuffer, const char* eventDescription)
+{
+    auto iter = threadBuffer->descriptions.find(eventDescription);
+    if (iter != threadBuffer->descriptions.end())
+        return iter->second;
+
+    const char* description;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        description = g_profilerState->descriptions.insert(eventDescription).first->c_str();
     }
+    threadBuffer->descriptions[eventDescription] = description;
+    return description;
 }
 
 
 //
 // Internal helper functions to record fixed and custom profiling events.
+// These only touch the buffer of the calling thread, and thus need no lock.
 //
-void ProfilerTimeRecordFixedEvent(const int eventId, const long long beginClock, const long long endClock)
+void ProfilerRecordFixedEventValue(const int eventId, const long long value, const long long bytes)
 {
-    std::lock_guard<std::mutex> lock(g_mutex);
+    auto& fixedEvent = GetThreadEventBuffer()->fixedEvents[eventId];
+    if (fixedEvent.cnt == 0)
+    {
+        fixedEvent.min = value;
+        fixedEvent.max = value;
+    }
+    fixedEvent.min = std::min(value, fixedEvent.min);
+    fixedEvent.max = std::max(value, fixedEvent.max);
+    fixedEvent.sum += value;
+    fixedEvent.sumsq += (double)value * (double)value;
+    fixedEvent.totalBytes += bytes;
+    fixedEvent.cnt++;
+}
 
+void ProfilerTimeRecordFixedEvent(const int eventId, const long long beginClock, const long long endClock)
+{
     if (!g_profilerState->enabled)
         return;
 
-    long long delta = endClock - beginClock;
-    if (g_profilerState->fixedEvents[eventId].cnt == 0)
-    {
-        g_profilerState->fixedEvents[eventId].min = delta;
-        g_profilerState->fixedEvents[eventId].max = delta;
-    }
-    g_profilerState->fixedEvents[eventId].min = std::min(delta, g_profilerState->fixedEvents[eventId].min);
-    g_profilerState->fixedEvents[eventId].max = std::max(delta, g_profilerState->fixedEvents[eventId].max);
-    g_profilerState->fixedEvents[eventId].sum += delta;
-    g_profilerState->fixedEvents[eventId].sumsq += (double)delta * (double)delta;
-    g_profilerState->fixedEvents[eventId].cnt++;
+    long long duration = endClock - beginClock;
+    ProfilerRecordFixedEventValue(eventId, duration, 0);
+    GetThreadEventBuffer()->fixedEvents[eventId].histogram[ProfilerEventStatistics::HistogramBucket(TicksToSeconds(duration))]++;
 }
 
 void ProfilerTimeRecordToBuffer(const char* eventDescription, const long long beginClock, const long long endClock)
 {
-    std::lock_guard<std::mutex> lock(g_mutex);
-
     if (!g_profilerState->enabled)
         return;
 
-    auto eventDescriptionBytes = strlen(eventDescription) + 1;
-    auto requiredBufferBytes = eventDescriptionBytes + sizeof(CustomEventRecord);
-    if ((g_profilerState->customEventOffset + requiredBufferBytes) > g_profilerState->customEventBufferBytes)
-    {
-        if (!g_profilerState->customEventBufferFull)
-        {
-            fprintf(stderr, "Warning: Performance Profiler: Buffer is full, no more events will be recorded.\n");
-            g_profilerState->customEventBufferFull = true;
-        }
+    auto threadBuffer = GetThreadEventBuffer();
+    if (threadBuffer->capacity == 0)
         return;
-    }
 
-    strcpy(g_profilerState->customEventBuffer.get() + g_profilerState->customEventOffset, eventDescription);
-    g_profilerState->customEventOffset += eventDescriptionBytes;
+    // The record is published by incrementing numEvents after it is written.
+    auto numEvents = threadBuffer->numEvents.load(std::memory_order_relaxed);
+    if (numEvents == threadBuffer->capacity)
+    {
+        fprintf(stderr, "Warning: Performance Profiler: Buffer of thread %u is full, older events of this thread will be overwritten.\n", threadBuffer->threadId);
+    }
 
-    CustomEventRecord eventRecord;
+    auto& eventRecord = threadBuffer->events[numEvents % threadBuffer->capacity];
     eventRecord.beginClock = beginClock;
     eventRecord.endClock = endClock;
-    eventRecord.threadId = GetThreadId();
+    eventRecord.minibatchId = g_profilerState->minibatchId.load(std::memory_order_relaxed);
+    eventRecord.description = InternEventDescription(threadBuffer, eventDescription);
 
-    memcpy(g_profilerState->customEventBuffer.get() + g_profilerState->customEventOffset, &eventRecord, sizeof(CustomEventRecord));
-    g_profilerState->customEventOffset += sizeof(CustomEventRecord);
+    threadBuffer->numEvents.store(numEvents + 1, std::memory_order_release);
 }
 
 
@@ -271,6 +360,10 @@ void PERF_PROFILER_API ProfilerTimeEnd(const long long stateId, const int eventI
     long long endClock = Clock::GetTimeStamp();
     ProfilerTimeRecordFixedEvent(eventId, stateId, endClock);
     ProfilerTimeRecordToBuffer(c_fixedEvtDesc[eventId].eventDescription, stateId, endClock);
+
+    // Events recorded from now on belong to the next minibatch iteration.
+    if (eventId == profilerEvtMainMinibatch)
+        g_profilerState->minibatchId++;
 }
 
 
@@ -323,8 +416,6 @@ void PERF_PROFILER_API ProfilerThroughputEnd(const long long stateId, const int
     if (g_profilerState == nullptr)
         return;
 
-    std::lock_guard<std::mutex> lock(g_mutex);
-
     if (!g_profilerState->enabled)
         return;
 
@@ -334,22 +425,13 @@ void PERF_PROFILER_API ProfilerThroughputEnd(const long long stateId, const int
 
     // Use kB rather than bytes to prevent overflow
     long long kBytesPerSec = Clock::GetTicksPerSecond() * bytes / 1000 / (endClock - beginClock);
-    if (g_profilerState->fixedEvents[eventId].cnt == 0)
-    {
-        g_profilerState->fixedEvents[eventId].min = kBytesPerSec;
-        g_profilerState->fixedEvents[eventId].max = kBytesPerSec;
-    }
-    g_profilerState->fixedEvents[eventId].min = std::min(kBytesPerSec, g_profilerState->fixedEvents[eventId].min);
-    g_profilerState->fixedEvents[eventId].max = std::max(kBytesPerSec, g_profilerState->fixedEvents[eventId].max);
-    g_profilerState->fixedEvents[eventId].sum += kBytesPerSec;
-    g_profilerState->fixedEvents[eventId].sumsq += (double)kBytesPerSec * (double)kBytesPerSec;
-    g_profilerState->fixedEvents[eventId].totalBytes += bytes;
-    g_profilerState->fixedEvents[eventId].cnt++;
+    ProfilerRecordFixedEventValue(eventId, kBytesPerSec, bytes);
 }
 
 
 //
 // Generate reports and release all resources.
+// Events that other threads record while the reports are generated may be lost.
 //
 void PERF_PROFILER_API ProfilerClose()
 {
@@ -357,6 +439,36 @@ void PERF_PROFILER_API ProfilerClose()
     if (g_profilerState == nullptr)
         return;
 
+    g_profilerState->enabled = false;
+
+    // Merge the fixed events of all threads
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        for (const auto& threadBuffer : g_profilerState->threadBuffers)
+        {
+            for (int evtIdx = 0; evtIdx < profilerEvtMax; evtIdx++)
+            {
+                const auto& threadEvent = threadBuffer->fixedEvents[evtIdx];
+                auto& fixedEvent = g_profilerState->fixedEvents[evtIdx];
+                if (threadEvent.cnt == 0)
+                    continue;
+                fixedEvent.min = fixedEvent.cnt == 0 ? threadEvent.min : std::min(fixedEvent.min, threadEvent.min);
+                fixedEvent.max = fixedEvent.cnt == 0 ? threadEvent.max : std::max(fixedEvent.max, threadEvent.max);
+                fixedEvent.sum += threadEvent.sum;
+                fixedEvent.sumsq += threadEvent.sumsq;
+                fixedEvent.totalBytes += threadEvent.totalBytes;
+                fixedEvent.cnt += threadEvent.cnt;
+            }
+        }
+    }
+
+    // Without a directory, the profiler only served ProfilerGetEventStatistics()
+    if (g_profilerState->profilerDir.empty())
+    {
+        g_profilerState.reset();
+        return;
+    }
+
     // Get current time as yyyy-mm-dd_hh-mm-ss
     time_t currentTime;
     time(&currentTime);
@@ -376,6 +488,31 @@ void PERF_PROFILER_API ProfilerClose()
 }
 
 
+//
+// Get the statistics of a fixed event recorded so far, merged over all threads.
+//
+bool PERF_PROFILER_API ProfilerGetEventStatistics(const int eventId, ProfilerEventStatistics& statistics)
+{
+    // A nullptr state indicates that the profiler is globally disabled, and not initialized
+    if (g_profilerState == nullptr)
+        return false;
+
+    statistics = ProfilerEventStatistics();
+    std::lock_guard<std::mutex> lock(g_mutex);
+    for (const auto& threadBuffer : g_profilerState->threadBuffers)
+    {
+        const auto& threadEvent = threadBuffer->fixedEvents[eventId];
+        statistics.count += threadEvent.cnt;
+        statistics.totalBytes += threadEvent.totalBytes;
+        if (c_fixedEvtDesc[eventId].eventType == profilerEvtTime)
+            statistics.totalSeconds += TicksToSeconds(threadEvent.sum);
+        for (int bucket = 0; bucket < ProfilerEventStatistics::c_numHistogramBuckets; bucket++)
+            statistics.histogram[bucket] += threadEvent.histogram[bucket];
+    }
+    return true;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Utility functions.
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -541,7 +678,25 @@ void FormatBytesStr(char* str, size_t strLen, long long bytes)
 
 
 //
-// Generate detail event file in chrome://tracing format (https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU/preview#heading=h.yr703knxre9f)
+// Write a string as JSON string contents, escaping quotes, backslashes and control characters.
+//
+void FprintfJsonString(FILE* f, const char* str)
+{
+    for (; *str; str++)
+    {
+        unsigned char c = (unsigned char)*str;
+        if (c == '"' || c == '\\')
+            fprintfOrDie(f, "\\%c", c);
+        else if (c < 0x20)
+            fprintfOrDie(f, "\\u%04x", c);
+        else
+            fprintfOrDie(f, "%c", c);
+    }
+}
+
+//
+// Generate detail event file in the trace event format of chrome://tracing and Perfetto (https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU/preview#heading=h.yr703knxre9f)
+// The process id is the rank, so that the files of all ranks can be viewed together. Each event carries the minibatch id.
 //
 void ProfilerGenerateDetailFile(const std::wstring& fileName)
 {
@@ -551,38 +706,40 @@ void ProfilerGenerateDetailFile(const std::wstring& fileName)
         RuntimeError("Error: ProfilerGenerateDetailFile: Cannot create file <%ls>.\n", fileName.c_str());
     }
 
-    fprintfOrDie(f, "[\n");
-
-    char* eventPtr = g_profilerState->customEventBuffer.get();
+    int rank = g_profilerState->rank;
+    fprintfOrDie(f, "{\"traceEvents\": [\n");
+    fprintfOrDie(f, "  {\"pid\":%d, \"name\":\"process_name\", \"ph\":\"M\", \"args\":{\"name\":\"Rank %d (process %u)\"}},\n", rank, rank, GetProcessId());
+    fprintfOrDie(f, "  {\"pid\":%d, \"name\":\"process_sort_index\", \"ph\":\"M\", \"args\":{\"sort_index\":%d}}", rank, rank);
 
-    bool firstRecord = true;
-    unsigned int pid = GetProcessId();
-    while (eventPtr < (g_profilerState->customEventBuffer.get() + g_profilerState->customEventOffset))
+    std::lock_guard<std::mutex> lock(g_mutex);
+    unsigned long long numOverwrittenEvents = 0;
+    for (const auto& threadBuffer : g_profilerState->threadBuffers)
     {
-        char* descriptionStr = eventPtr;
-        eventPtr += strlen(descriptionStr) + 1;
-
-        CustomEventRecord* eventRecord = (CustomEventRecord*)eventPtr;
-        eventPtr += sizeof(CustomEventRecord);
-
-        fprintfOrDie(f, "%s  {\"pid\":%u, \"tid\":%u, \"name\":\"%s\", \"cat\":\"PERF\", \"ph\":\"B\", \"ts\":%llu}",
-            firstRecord ? "" : ",\n",
-            pid,
-            eventRecord->threadId,
-            descriptionStr,
-            (unsigned long long)(1000000.0 * TicksToSeconds(eventRecord->beginClock - g_profilerState->startClock)));
-
-        firstRecord = false;
-        fprintfOrDie(f, ",\n  {\"pid\":%u, \"tid\":%u, \"name\":\"%s\", \"cat\":\"PERF\", \"ph\":\"E\", \"ts\":%llu}",
-            pid,
-            eventRecord->threadId,
-            descriptionStr,
-            (unsigned long long)(1000000.0 * TicksToSeconds(eventRecord->endClock - g_profilerState->startClock)));
+        // Only the last 'capacity' events are still in the ring buffer.
+        unsigned long long numEvents = threadBuffer->numEvents.load(std::memory_order_acquire);
+        unsigned long long firstEvent = numEvents > threadBuffer->capacity ? numEvents - threadBuffer->capacity : 0;
+        numOverwrittenEvents += firstEvent;
+
+        for (unsigned long long i = firstEvent; i < numEvents; i++)
+        {
+            const auto& eventRecord = threadBuffer->events[i % threadBuffer->capacity];
+            fprintfOrDie(f, ",\n  {\"pid\":%d, \"tid\":%u, \"name\":\"", rank, threadBuffer->threadId);
+            FprintfJsonString(f, eventRecord.description);
+            fprintfOrDie(f, "\", \"cat\":\"PERF\", \"ph\":\"X\", \"ts\":%.3f, \"dur\":%.3f, \"args\":{\"minibatch\":%lld}}",
+                1000000.0 * TicksToSeconds(eventRecord.beginClock - g_profilerState->startClock),
+                1000000.0 * TicksToSeconds(eventRecord.endClock - eventRecord.beginClock),
+                eventRecord.minibatchId);
+        }
     }
 
-    fprintfOrDie(f, "\n]\n");
+    fprintfOrDie(f, "\n],\n\"displayTimeUnit\": \"ms\"\n}\n");
 
     fclose(f);
+
+    if (numOverwrittenEvents > 0)
+    {
+        fprintf(stderr, "Warning: Performance Profiler: %llu events were overwritten in full buffers; increase profilerBufferSize to keep them.\n", numOverwrittenEvents);
+    }
 }
 
 
@@ -590,9 +747,9 @@ void ProfilerGenerateDetailFile(const std::wstring& fileName)
 // Scoped helpers.
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void ProfilerContext::Init(const std::wstring& profilerDir, const unsigned long long customEventBufferBytes, const std::wstring& logSuffix, const bool syncGpu)
+void ProfilerContext::Init(const std::wstring& profilerDir, const unsigned long long customEventBufferBytes, const std::wstring& logSuffix, const bool syncGpu, const int rank)
 {
-    ProfilerInit(profilerDir, customEventBufferBytes, logSuffix, syncGpu);
+    ProfilerInit(profilerDir, customEventBufferBytes, logSuffix, syncGpu, rank);
 }
 
 ProfilerContext::~ProfilerContext()
@@ -10,8 +10,12 @@
 //
 // To initialize and tear down the profiler, call ProfilerInit() and ProfilerClose(). The scoped
 // object, ProfilerContext can also be used for managing the lifetime of the profiler. The profiler
-// works by accumulating events in a pre-allocated buffer, up until the buffer is full. At the
-// time when the profiler is torn down, a summary report and a detailed log file is written to disk.
+// works by accumulating events in a buffer per thread, so that recording an event takes no lock.
+// The buffers are ring buffers: when a buffer is full, the oldest events of that thread are
+// overwritten. At the time when the profiler is torn down, a summary report and a detailed log
+// file is written to disk. The detailed log is a trace-event JSON file that can be loaded into
+// chrome://tracing or Perfetto; its events carry the thread id, the rank (as process id) and
+// the minibatch id (the number of completed profilerEvtMainMinibatch events).
 //
 // When profiling code, two types of events can be used - fixed or custom. A fixed event is
 // predefined in the ProfilerEvents enum and by the FixedEventDesc struct. A custom event is
@@ -26,6 +30,10 @@
 // and ProfilerThroughputEnd() calls should be used. The throughput APIs can only be used
 // with fixed events.
 //
+// Durations of fixed time events are also counted in a histogram per event, from which
+// ProfilerGetEventStatistics() provides latency percentiles while the profiler is running,
+// e.g. for benchmarks.
+//
 // CNTK specifics
 //
 // The profiler is turned off during the very first epoch to avoid polluting profile data with
@@ -37,10 +45,12 @@
 #ifdef CNTK_UWP // UWP does not support performance profiler
 
 #define PROFILE_SCOPE(eventId)      /*nothing*/
+#define THROUGHPUT_SCOPE(eventId, bytes)    /*nothing*/
 
 #else
 
 #include <string>
+#include <cmath>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -79,6 +89,11 @@ enum ProfilerEvents
 
     // Data reader events
     profilerEvtPrefetchMinibatch,           // Prefetching the next minibatch in a background thread
+    profilerEvtReadSequences,               // Getting the sequences of a minibatch from the deserializers, randomizer and transforms
+    profilerEvtPackMinibatch,               // Packing the sequences into minibatch buffers
+    profilerEvtCopyMinibatch,               // Copying the packed minibatch into the prefetch matrices
+    profilerEvtCopyThroughput,              // Bytes copied into the prefetch matrices
+    profilerEvtPrefetchWait,                // Time the consumer waits for the prefetch of the next minibatch to complete
 
     profilerEvtMax
 };
@@ -86,13 +101,15 @@ enum ProfilerEvents
 
 //
 // Initialize all resources to enable profiling.
-// profilerDir: Directory where the profiler logs will be saved.
-// customEventBufferBytes: Bytes to allocate for the custom event buffer.
+// profilerDir: Directory where the profiler logs will be saved. If empty, no logs are written.
+// customEventBufferBytes: Bytes to allocate for the event buffer of each thread that records events. The memory
+//                        used is thus a multiple of it; each distinct description is stored once in addition.
 // logSuffix: Suffix string to append to log files.
 // syncGpu: Wait for GPU to complete processing for each profiling event.
+// rank: Rank of this process in distributed training.
 //
 void PERF_PROFILER_API ProfilerInit(const std::wstring& profilerDir, const unsigned long long customEventBufferBytes,
-    const std::wstring& logSuffix, const bool syncGpu);
+    const std::wstring& logSuffix, const bool syncGpu, const int rank = 0);
 
 
 //
@@ -102,6 +119,12 @@ void PERF_PROFILER_API ProfilerInit(const std::wstring& profilerDir, const unsig
 //
 void PERF_PROFILER_API ProfilerEnable(bool enable);
 
+//
+// Whether profiling is currently enabled; false if the profiler is not initialized.
+// Code that enables the profiler temporarily uses this to restore the previous state.
+//
+bool PERF_PROFILER_API ProfilerIsEnabled();
+
 
 //
 // Measure either a fixed or custom event time.
@@ -134,12 +157,66 @@ void PERF_PROFILER_API ProfilerThroughputEnd(const long long stateId, const int
 void PERF_PROFILER_API ProfilerClose();
 
 
+//
+// Statistics of a fixed event, merged over all threads.
+// The durations of time events are counted in buckets of a logarithmic histogram, four buckets per
+// octave starting at 1 us, so that percentiles are estimated to within about 10%.
+// Statistics of a period are obtained by subtracting the statistics taken at its start.
+//
+struct ProfilerEventStatistics
+{
+    static const int c_numHistogramBuckets = 96;
+    static const int c_histogramBucketsPerOctave = 4;
+
+    ProfilerEventStatistics() : count(0), totalSeconds(0), totalBytes(0), histogram() {}
+
+    static int HistogramBucket(double seconds)
+    {
+        double bucket = seconds > 0 ? floor(c_histogramBucketsPerOctave * log2(seconds * 1e6)) : 0;
+        return bucket < 0 ? 0 : bucket >= c_numHistogramBuckets ? c_numHistogramBuckets - 1 : (int)bucket;
+    }
+
+    // estimate of the p-th percentile (0 <= p <= 100) of the durations, in seconds: geometric center of the bucket it falls into
+    double Percentile(double p) const
+    {
+        long long numBelow = 0;
+        for (int bucket = 0; bucket < c_numHistogramBuckets; bucket++)
+        {
+            numBelow += histogram[bucket];
+            if (numBelow > 0 && numBelow >= p / 100 * count)
+                return 1e-6 * pow(2.0, (bucket + 0.5) / c_histogramBucketsPerOctave);
+        }
+        return 0;
+    }
+
+    void Subtract(const ProfilerEventStatistics& earlier)
+    {
+        count -= earlier.count;
+        totalSeconds -= earlier.totalSeconds;
+        totalBytes -= earlier.totalBytes;
+        for (int bucket = 0; bucket < c_numHistogramBuckets; bucket++)
+            histogram[bucket] -= earlier.histogram[bucket];
+    }
+
+    long long   count;
+    double      totalSeconds;                       // time events only
+    long long   totalBytes;                         // throughput events only
+    long long   histogram[c_numHistogramBuckets];   // time events only
+};
+
+//
+// Get the statistics of a fixed event recorded so far. Returns false if the profiler is not initialized.
+// Counts of events that other threads record concurrently may be incomplete.
+//
+bool PERF_PROFILER_API ProfilerGetEventStatistics(const int eventId, ProfilerEventStatistics& statistics);
+
+
 //
 // Scoped profiler instantiation.
 //
 struct PERF_PROFILER_API ProfilerContext
 {
-    void Init(const std::wstring& profilerDir = L"", const unsigned long long customEventBufferBytes = (32 * 1024 * 1024), const std::wstring& logSuffix = L"", const bool syncGpu = false);
+    void Init(const std::wstring& profilerDir = L"", const unsigned long long customEventBufferBytes = (32 * 1024 * 1024), const std::wstring& logSuffix = L"", const bool syncGpu = false, const int rank = 0);
     ~ProfilerContext();
 };
 
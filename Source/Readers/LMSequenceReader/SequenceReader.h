@@ -12,12 +12,12 @@
 #include "Config.h"
 #include "SequenceParser.h"
 #include "RandomOrdering.h"
+#include "AliasSampler.h"
 #include <string>
 #include <map>
 #include <vector>
 #include <random>
 #include <boost/random/uniform_int_distribution.hpp>
-#include <boost/random/piecewise_constant_distribution.hpp>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -54,7 +54,7 @@ class noiseSampler
     double uniform_prob;
     double uniform_log_prob;
 
-    boost::random::piecewise_constant_distribution<double> d;
+    AliasSampler m_sampler; // O(1) per noise sample, independent of the vocabulary size
     std::mt19937 rng;
 
 public:
@@ -67,17 +67,17 @@ public:
         size_t k = counts.size();
         uniform_prob = 1.0 / k;
         uniform_log_prob = std::log(uniform_prob);
-        std::vector<double> vn(counts.size() + 1);
-        for (int i = 0; i < vn.size(); i++)
-            vn[i] = i;
 
-        d = boost::random::piecewise_constant_distribution<double>(vn.begin(), vn.end(), counts.begin());
+        m_sampler.Build(counts);
         unif_int = boost::random::uniform_int_distribution<Count>(0, (long)counts.size() - 1);
 
-        m_prob = d.densities();
-        m_log_prob.resize(m_prob.size());
+        m_prob.resize(k);
+        m_log_prob.resize(k);
         for (int i = 0; i < k; i++)
+        {
+            m_prob[i] = counts[i] / m_sampler.TotalWeight();
             m_log_prob[i] = std::log(m_prob[i]);
+        }
     }
     int size() const
     {
@@ -101,10 +101,9 @@ public:
     template <typename Engine>
     int sample(Engine& eng)
     {
-        int m = unif_int(eng);
         if (uniform_sampling)
-            return m;
-        return (int) d(eng);
+            return unif_int(eng);
+        return (int) m_sampler.Sample(eng);
     }
 
     int sample()
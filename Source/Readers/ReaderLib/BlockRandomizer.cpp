@@ -13,6 +13,7 @@
 
 #include "DataReader.h"
 #include "ExceptionCapture.h"
+#include "NumaPolicy.h"
 
 namespace CNTK {
 
@@ -461,7 +462,14 @@ void BlockRandomizer::Prefetch(ChunkIdType chunkId)
         }
 
         m_prefetchedChunk = chunkId;
-        m_prefetch = std::async(m_launchType, [this, chunkId]() { return m_deserializer->GetChunk(chunkId); });
+        // load the chunk on the NUMA node of the thread that will use it
+        // (without prefetch, the task runs on that thread itself, which must not be bound by it)
+        int numaNode = m_launchType == launch::async ? Microsoft::MSR::CNTK::NumaPolicy::NodeForHelperThread() : -1;
+        m_prefetch = std::async(m_launchType, [this, chunkId, numaNode]()
+        {
+            Microsoft::MSR::CNTK::NumaPolicy::BindHelperThread(numaNode);
+            return m_deserializer->GetChunk(chunkId);
+        });
 
         if (m_verbosity >= Debug)
             fprintf(stderr, "BlockRandomizer::Prefetch: prefetching original chunk: %u\n", chunkId);
@@ -7,6 +7,7 @@
 
 #include <algorithm>
 #include "MemoryProvider.h"
+#include "NumaPolicy.h"
 
 namespace CNTK {
 
@@ -15,15 +16,16 @@ class HeapMemoryProvider : public MemoryProvider
     static const size_t size_of_first_pointer = sizeof(void*);
 
 public:
+    // On the NUMA node of the allocating thread if a NUMA policy is set, which for the
+    // prefetched minibatch buffers is the node of the thread that consumes them.
     virtual void* Alloc(size_t elementSize, size_t numberOfElements) override
     {
-        // Currently not alligned.
-        return ::operator new(elementSize * numberOfElements);
+        return Microsoft::MSR::CNTK::NumaPolicy::AllocLocal(elementSize * numberOfElements);
     }
 
     virtual void Free(void* p) override
     {
-        ::operator delete(p);
+        Microsoft::MSR::CNTK::NumaPolicy::Free(p);
     }
 };
 
@@ -9,6 +9,7 @@
 #include "LocalTimelineRandomizerBase.h"
 #include "DataReader.h"
 #include "ExceptionCapture.h"
+#include "NumaPolicy.h"
 
 namespace CNTK {
 
@@ -58,7 +59,7 @@ void LocalTimelineRandomizerBase::RefillCurrentWindowNow()
     // Make sure there is no outstanding prefetch.
     if (!m_prefetch.valid())
     {
-        m_prefetch = std::async(std::launch::async, [this]() { Prefetch(); });
+        StartPrefetch();
     }
 
     m_prefetch.get();
@@ -86,7 +87,18 @@ void LocalTimelineRandomizerBase::Refill()
     RefillCurrentWindowNow();
 
     // Issue the next prefetch
-    m_prefetch = std::async(std::launch::async, [this]() { Prefetch(); });
+    StartPrefetch();
+}
+
+void LocalTimelineRandomizerBase::StartPrefetch()
+{
+    // load the data on the NUMA node of the thread that will use it
+    int numaNode = Microsoft::MSR::CNTK::NumaPolicy::NodeForHelperThread();
+    m_prefetch = std::async(std::launch::async, [this, numaNode]()
+    {
+        Microsoft::MSR::CNTK::NumaPolicy::BindHelperThread(numaNode);
+        Prefetch();
+    });
 }
 
 void LocalTimelineRandomizerBase::MoveToNextSequence()
@@ -121,6 +121,9 @@ private:
     // Refill and wait for data. Does not issue the next async refill.
     void RefillCurrentWindowNow();
 
+    // Issues an async Prefetch().
+    void StartPrefetch();
+
     // Gets next sequences not exceeding localSampleCount for this worker and globalSampleCount across workers.
     void GetNextSequenceDescriptions(size_t maxSampleCount, Sequences& result);
 
@@ -12,6 +12,7 @@
 #endif
 
 #include <sstream>
+#include <omp.h>
 #include "Basics.h"
 
 #define DATAREADER_EXPORTS // creating the exports here
@@ -19,6 +20,7 @@
 #include "ReaderShim.h"
 #include "DataTransferer.h"
 #include "PerformanceProfiler.h"
+#include "NumaPolicy.h"
 
 namespace CNTK {
 
@@ -219,8 +221,16 @@ void ReaderShim<ElemType>::StartAsyncPrefetching()
     // Starting the prefetch task. There is always a single async read in flight.
     // When the network requests a new minibatch, we wait for the current async to finish, swap the buffers
     // and kick off the new prefetch.
-    m_prefetchTask = std::async(m_launchType, [this, localCurrentDataTransferIndex]()
+    // pack the minibatch on the NUMA node of the thread that will copy it into the network
+    // (without prefetch, the task runs on that thread itself, which must not be bound by it)
+    int numaNode = m_launchType == launch::async ? NumaPolicy::NodeForHelperThread() : -1;
+    // The OpenMP thread count is a per-thread setting, so the parallel loops of the randomizers and
+    // deserializers would not see a count set with SetNumThreads() on the main thread otherwise.
+    int numThreads = omp_get_max_threads();
+    m_prefetchTask = std::async(m_launchType, [this, localCurrentDataTransferIndex, numaNode, numThreads]()
     {
+        NumaPolicy::BindHelperThread(numaNode);
+        omp_set_num_threads(numThreads);
         return PrefetchMinibatch(localCurrentDataTransferIndex);
     });
 }
@@ -269,7 +279,11 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
     if (!m_prefetchTask.valid())
         StartAsyncPrefetching();
 
-    auto result = m_prefetchTask.get();
+    PrefetchResult result;
+    {
+        PROFILE_SCOPE(profilerEvtPrefetchWait);
+        result = m_prefetchTask.get();
+    }
 
     // Ok, prefetch is done.
 
@@ -383,6 +397,19 @@ void FillMatrixFromStream(StorageFormat type, Matrix<ElemType>* matrix, size_t n
         RuntimeError("Storage type %d is not supported.", (int)type);
 }
 
+// Number of bytes of a packed stream minibatch, in the layout that FillMatrixFromStream() expects.
+template <class ElemType>
+size_t GetStreamMinibatchBytes(StorageFormat type, size_t numRows, const StreamMinibatchPtr& stream)
+{
+    size_t numCols = stream->m_layout->GetNumCols();
+    if (type == StorageFormat::SparseCSC)
+    {
+        size_t nnzCount = *reinterpret_cast<size_t*>(stream->m_data);
+        return sizeof(size_t) + nnzCount * (sizeof(ElemType) + sizeof(IndexType)) + (numCols + 1) * sizeof(IndexType);
+    }
+    return numRows * numCols * sizeof(ElemType);
+}
+
 template <class ElemType>
 typename ReaderShim<ElemType>::PrefetchResult ReaderShim<ElemType>::PrefetchMinibatch(size_t currentDataTransferIndex)
 {
@@ -410,19 +437,34 @@ typename ReaderShim<ElemType>::PrefetchResult ReaderShim<ElemType>::PrefetchMini
     for (auto& mx : m_prefetchBuffers)
     {
         size_t streamId = m_nameToStreamId[mx.first];
-        const auto& stream = minibatch.m_data[streamId];
-        mx.second.m_mbLayout = stream->m_layout;
-        mx.second.m_sampleShape = stream->m_sampleShape;
-
         if (m_streams[streamId].m_sampleLayout.IsUnknown())
         {
             // Sample layout can be lazily updated on the first minibatch, so let reread it.
             // In the future we should use NDShape for the sequence instead of sample.
             m_streams = m_reader->GetStreamDescriptions();
         }
+    }
+
+    size_t numBytes = 0;
+    for (const auto& mx : m_prefetchBuffers)
+    {
+        size_t streamId = m_nameToStreamId[mx.first];
+        numBytes += GetStreamMinibatchBytes<ElemType>(m_streams[streamId].m_storageFormat, m_streams[streamId].m_sampleLayout.TotalSize(), minibatch.m_data[streamId]);
+    }
 
-        size_t sampleSize = m_streams[streamId].m_sampleLayout.TotalSize();
-        FillMatrixFromStream(m_streams[streamId].m_storageFormat, mx.second.m_matrix.get(), sampleSize, stream, m_dataTransferers[currentDataTransferIndex].get());
+    {
+        PROFILE_SCOPE(profilerEvtCopyMinibatch);
+        THROUGHPUT_SCOPE(profilerEvtCopyThroughput, (long long)numBytes);
+        for (auto& mx : m_prefetchBuffers)
+        {
+            size_t streamId = m_nameToStreamId[mx.first];
+            const auto& stream = minibatch.m_data[streamId];
+            mx.second.m_mbLayout = stream->m_layout;
+            mx.second.m_sampleShape = stream->m_sampleShape;
+
+            size_t sampleSize = m_streams[streamId].m_sampleLayout.TotalSize();
+            FillMatrixFromStream(m_streams[streamId].m_storageFormat, mx.second.m_matrix.get(), sampleSize, stream, m_dataTransferers[currentDataTransferIndex].get());
+        }
     }
 
     // Let's record that we started the copy, so that the main thread can wait afterwards.
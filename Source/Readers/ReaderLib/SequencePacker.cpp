@@ -11,6 +11,7 @@
 #include <inttypes.h>
 #include "SequencePacker.h"
 #include "ReaderUtil.h"
+#include "PerformanceProfiler.h"
 
 namespace CNTK {
 
@@ -57,13 +58,19 @@ MBLayoutPtr SequencePacker::CreateBinaryMBLayout(const StreamBatch& batch)
 
 Minibatch SequencePacker::ReadMinibatch()
 {
-    auto sequences = m_sequenceEnumerator->GetNextSequences(m_globalMinibatchSizeInSamples, m_localMinibatchSizeInSamples);
+    Sequences sequences;
+    {
+        PROFILE_SCOPE(profilerEvtReadSequences);
+        sequences = m_sequenceEnumerator->GetNextSequences(m_globalMinibatchSizeInSamples, m_localMinibatchSizeInSamples);
+    }
     const auto& batch = sequences.m_data;
 
     Minibatch minibatch(sequences.m_endOfSweep, sequences.m_endOfEpoch);
     if (batch.empty())
         return minibatch;
 
+    PROFILE_SCOPE(profilerEvtPackMinibatch);
+
     auto& currentBuffer = m_streamBuffers[m_currentBufferIndex];
 
     assert(m_outputStreamDescriptions.size() == batch.size());
@@ -8,8 +8,11 @@
 #include <string>
 #include <memory>
 #include <vector>
-#include <map>
-#include <deque>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
 #include "Basics.h"
 
 namespace CNTK {
@@ -17,76 +20,255 @@ namespace CNTK {
 // This class represents a string registry pattern to share strings between different deserializers if needed.
 // It associates a unique key for a given string.
 // Currently it is implemented in-memory, but can be unloaded to external disk if needed.
+//
+// The registry has to hold hundreds of millions of sequence keys for large corpora, so instead of a node based map
+// the strings are interned into per-shard character arenas and looked up through open addressing tables that only
+// store 32 bit local ids. The shard is selected by the hash of the string, every shard has its own reader/writer
+// lock, so lookups proceed concurrently and index builders running in parallel rarely contend when adding keys.
+// Ids are unique and stable but not contiguous: the lower bits hold the shard, the upper bits the position of the
+// string in its shard.
 // TODO: Move this class to Basics.h when it is required by more than one reader.
 template<class TString>
 class TStringToIdMap
 {
+    typedef typename TString::value_type CharType;
+
 public:
     TStringToIdMap()
+        : m_shards(s_numberOfShards)
     {}
 
     // Adds string value to the registry.
     void AddValue(const TString& value)
     {
-        auto iter = m_values.insert(std::make_pair(value, m_indexedValues.size()));
-        m_indexedValues.push_back(&((iter.first)->first));
+        AddIfNotExists(value);
     }
 
     // Tries to get a value by id.
     bool TryGet(const TString& value, size_t& id) const
     {
-        const auto& it = m_values.find(value);
-        if (it == m_values.end())
-        {
+        uint64_t hash = Hash(value);
+        const Shard& shard = m_shards[ShardOf(hash)];
+        std::shared_lock<std::shared_timed_mutex> lock(shard.m_lock);
+        uint32_t localId;
+        if (!shard.Find(value, (uint32_t)hash, localId))
             return false;
-        }
-        else
-        {
-            id = it->second;
-            return true;
-        }
+        id = ToId(ShardOf(hash), localId);
+        return true;
     }
 
     // Get integer id for the string value, adding if not exists.
     size_t AddIfNotExists(const TString& value)
     {
-        const auto& it = m_values.find(value);
-        if (it == m_values.end())
+        uint64_t hash = Hash(value);
+        size_t shardIndex = ShardOf(hash);
+        Shard& shard = m_shards[shardIndex];
+        uint32_t localId;
         {
-            AddValue(value);
-            return m_values[value];
+            std::shared_lock<std::shared_timed_mutex> lock(shard.m_lock);
+            if (shard.Find(value, (uint32_t)hash, localId))
+                return ToId(shardIndex, localId);
         }
-        return it->second;
+
+        // Somebody could have added the value between the two locks, so Insert looks it up again.
+        std::unique_lock<std::shared_timed_mutex> lock(shard.m_lock);
+        localId = shard.Insert(value, (uint32_t)hash);
+        return ToId(shardIndex, localId);
     }
 
     // Get integer id for the string value.
     size_t operator[](const TString& value) const
     {
-        const auto& it = m_values.find(value);
-        assert(it != m_values.end());
-        return it->second;
+        size_t id = 0;
+        bool found = TryGet(value, id);
+        assert(found);
+        UNUSED(found);
+        return id;
     }
 
     // Get string value by its integer id.
-    const TString& operator[](size_t id) const
+    TString operator[](size_t id) const
     {
-        if (id >= m_indexedValues.size())
+        const Shard& shard = m_shards[id % s_numberOfShards];
+        size_t localId = id / s_numberOfShards;
+        std::shared_lock<std::shared_timed_mutex> lock(shard.m_lock);
+        if (localId >= shard.m_entries.size())
             RuntimeError("Unknown id requested");
-        return *m_indexedValues[id];
+        const auto& entry = shard.m_entries[localId];
+        return TString(entry.m_data, entry.m_length);
     }
 
     // Checks whether the value exists.
     bool Contains(const TString& value) const
     {
-        return m_values.find(value) != m_values.end();
+        size_t id;
+        return TryGet(value, id);
+    }
+
+    // Number of registered strings.
+    size_t Size() const
+    {
+        size_t result = 0;
+        for (const auto& shard : m_shards)
+        {
+            std::shared_lock<std::shared_timed_mutex> lock(shard.m_lock);
+            result += shard.m_entries.size();
+        }
+        return result;
+    }
+
+    // Approximate number of bytes allocated by the registry.
+    size_t MemoryUsage() const
+    {
+        size_t result = sizeof(*this);
+        for (const auto& shard : m_shards)
+        {
+            std::shared_lock<std::shared_timed_mutex> lock(shard.m_lock);
+            result += sizeof(Shard) +
+                shard.m_arenaSize * sizeof(CharType) +
+                shard.m_arenas.capacity() * sizeof(shard.m_arenas[0]) +
+                shard.m_entries.capacity() * sizeof(Entry) +
+                shard.m_slots.capacity() * sizeof(uint32_t);
+        }
+        return result;
     }
 
 private:
     // TODO: Move NonCopyable as a separate class to Basics.h
     DISABLE_COPY_AND_MOVE(TStringToIdMap);
 
-    std::map<TString, size_t> m_values;
-    std::deque<const TString*> m_indexedValues;
+    static const size_t s_numberOfShards = 64;
+    static const size_t s_arenaChunkSize = 64 * 1024; // in characters
+
+    // Interned string, the characters live in one of the arenas of the shard.
+    struct Entry
+    {
+        const CharType* m_data;
+        uint32_t m_length;
+        uint32_t m_hash;
+    };
+
+    struct Shard
+    {
+        Shard()
+            : m_arenaUsed(0), m_arenaCapacity(0), m_arenaSize(0)
+        {}
+
+        // Looks up the value in the open addressing table (linear probing). The caller holds the lock.
+        bool Find(const TString& value, uint32_t hash, uint32_t& localId) const
+        {
+            if (m_slots.empty())
+                return false;
+            size_t mask = m_slots.size() - 1;
+            for (size_t i = hash & mask;; i = (i + 1) & mask)
+            {
+                uint32_t slot = m_slots[i];
+                if (slot == 0)
+                    return false;
+                const Entry& entry = m_entries[slot - 1];
+                if (entry.m_hash == hash && entry.m_length == value.size() &&
+                    std::equal(value.begin(), value.end(), entry.m_data))
+                {
+                    localId = slot - 1;
+                    return true;
+                }
+            }
+        }
+
+        // Adds the value unless it is present, returns its local id. The caller holds the lock exclusively.
+        uint32_t Insert(const TString& value, uint32_t hash)
+        {
+            uint32_t localId;
+            if (Find(value, hash, localId))
+                return localId;
+
+            if (m_entries.size() >= std::numeric_limits<uint32_t>::max() - 1 || value.size() > std::numeric_limits<uint32_t>::max())
+                RuntimeError("Too many or too long strings in the string registry.");
+
+            // Keep the load factor under 0.75.
+            if ((m_entries.size() + 1) * 4 > m_slots.size() * 3)
+                Rehash(std::max<size_t>(m_slots.size() * 2, 64));
+
+            Entry entry;
+            entry.m_data = Intern(value);
+            entry.m_length = (uint32_t)value.size();
+            entry.m_hash = hash;
+            localId = (uint32_t)m_entries.size();
+            m_entries.push_back(entry);
+
+            size_t mask = m_slots.size() - 1;
+            size_t i = hash & mask;
+            while (m_slots[i] != 0)
+                i = (i + 1) & mask;
+            m_slots[i] = localId + 1;
+            return localId;
+        }
+
+        mutable std::shared_timed_mutex m_lock;
+        std::vector<std::unique_ptr<CharType[]>> m_arenas;
+        size_t m_arenaUsed;     // characters used in the last arena
+        size_t m_arenaCapacity; // capacity of the last arena
+        size_t m_arenaSize;     // characters allocated in all arenas
+        std::vector<Entry> m_entries;  // indexed by local id
+        std::vector<uint32_t> m_slots; // local id + 1, 0 marks an empty slot
+
+    private:
+        // Copies the characters into the arena, strings never move once interned.
+        const CharType* Intern(const TString& value)
+        {
+            if (m_arenaUsed + value.size() > m_arenaCapacity || m_arenas.empty())
+            {
+                // Arenas grow with the shard up to the chunk size, so small corpora stay small.
+                size_t capacity = std::max(std::min(s_arenaChunkSize, std::max<size_t>(m_arenaSize, 1024)), value.size());
+                m_arenas.emplace_back(new CharType[capacity]);
+                m_arenaUsed = 0;
+                m_arenaCapacity = capacity;
+                m_arenaSize += capacity;
+            }
+            CharType* result = m_arenas.back().get() + m_arenaUsed;
+            std::copy(value.begin(), value.end(), result);
+            m_arenaUsed += value.size();
+            return result;
+        }
+
+        void Rehash(size_t newSize)
+        {
+            std::vector<uint32_t> slots(newSize, 0);
+            size_t mask = newSize - 1;
+            for (uint32_t localId = 0; localId < m_entries.size(); localId++)
+            {
+                size_t i = m_entries[localId].m_hash & mask;
+                while (slots[i] != 0)
+                    i = (i + 1) & mask;
+                slots[i] = localId + 1;
+            }
+            m_slots.swap(slots);
+        }
+    };
+
+    // 64 bit FNV-1a over the characters. The top bits select the shard, the low 32 bits the slot.
+    static uint64_t Hash(const TString& value)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (const auto& c : value)
+        {
+            hash ^= (uint64_t)c;
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    static size_t ShardOf(uint64_t hash)
+    {
+        return (size_t)(hash >> 58) % s_numberOfShards;
+    }
+
+    static size_t ToId(size_t shard, uint32_t localId)
+    {
+        return (size_t)localId * s_numberOfShards + shard;
+    }
+
+    std::vector<Shard> m_shards;
 };
 
 typedef TStringToIdMap<std::wstring> WStringToIdMap;
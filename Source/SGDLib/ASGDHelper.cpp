@@ -2,7 +2,8 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
 //
-// ASGDHelper.cpp : Implements ASGDHelper interface. The implementation is based on Multiverso.
+// ASGDHelper.cpp : Implements ASGDHelper interface. The implementation is based on Multiverso if available,
+//                  otherwise on a parameter server in shared memory.
 //
 
 #define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
@@ -11,6 +12,7 @@
 #include "MPIWrapper.h"
 #include "ComputationNetwork.h"
 #include "TimerUtility.h"
+#include "SharedMemoryParameterServer.h"
 
 #include <functional>
 #include <thread>
@@ -246,6 +248,7 @@ public:
                 mat.SetValue(mat.GetNumRows(), mat.GetNumCols(), mat.GetDeviceId(), py);
                 delete px;
 #endif
+                node->BumpEvalTimeStamp();
             }
             m_reportTimer.Stop();
             if (m_traceLevel > 2)
@@ -407,6 +410,7 @@ public:
 
                 ElemType * px2 = m_cpuAsyncBuffer[0] + m_tableOffsets[i];
                 mat.SetValue(mat.GetNumRows(), mat.GetNumCols(), mat.GetDeviceId(), px2);
+                node->BumpEvalTimeStamp();
             }
             m_reportTimer.Stop();
             if (m_traceLevel > 3)
@@ -595,13 +599,24 @@ private:
 
 #endif 
 
-// A None implementation of ASGDHelper interface which does nothing
-// This is used when CNTK_ENABLE_ASGD = false
+// -----------------------------------------------------------------------
+// SharedMemoryASGDHelper -- ASGD among the worker processes of a single machine, without Multiverso.
+// The global model lives in a SharedMemoryParameterServer that all workers map. On each sync, a worker
+// pushes the change of its local model since its last pull (scaled by DecayCoefficient()) and
+// pulls the current global model back. The pull may be done only every 'pushesPerPull' syncs,
+// in which case the worker continues with its own model in between, saving the copy into the network.
+// Stale updates can be compensated for, see SharedMemoryParameterServer::Push(), if the worker pulls at every sync.
+// This is used when CNTK_ENABLE_ASGD = false.
+// -----------------------------------------------------------------------
+#ifndef ASGD_PARALLEL_SUPPORT
+
 template<class ElemType = float>
-class NoneASGDHelper : public ASGDHelper<ElemType>
+class SharedMemoryASGDHelper : public ASGDHelper<ElemType>
 {
+    typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+
 public:
-    NoneASGDHelper(const std::list<ComputationNodeBasePtr> & learnableNodes,
+    SharedMemoryASGDHelper(const std::list<ComputationNodeBasePtr> & learnableNodes,
         int nodeNumRanks,
         bool useAsyncBuffer = true,
         bool isSimModelAveragingSGD = false,
@@ -610,20 +625,214 @@ public:
         size_t adjustnbmb = 600,
         int traceLevel = 0,
         int syncPerfStats = 0,
-        const MPIWrapperPtr& pMPI = nullptr) { }
+        size_t numShards = 16,
+        size_t pushesPerPull = 1,
+        double delayCompensation = 0) :
+        m_totalClientNumber(nodeNumRanks), m_ModelAveragingSGDSimulating(isSimModelAveragingSGD),
+        m_adjustLearningRateAtBeginningType(adjusttype), m_adjustCoefficient(adjustcoef), m_adjustMBNumber(adjustnbmb),
+        m_traceLevel(traceLevel), m_syncPerfStats(syncPerfStats),
+        m_pushesPerPull(max<size_t>(pushesPerPull, 1)), m_delayCompensation((ElemType)delayCompensation),
+        m_parameterSyncCounter(0), m_sampleSinceLastReport(0), m_secondsInPushAndPullSinceLastReport(0)
+    {
+        m_pMPI = MPIWrapper::GetInstance();
+        if (!m_pMPI)
+            LogicError("SharedMemoryASGDHelper: DataParallelASGD requires MPI.");
+        if (m_pMPI->IsMultiHost())
+            RuntimeError("DataParallelASGD: This version only supports worker processes on a single machine. Build with CNTK_ENABLE_ASGD=true to train across machines.");
+        if (useAsyncBuffer)
+            fprintf(stderr, "DataParallelASGD: UsePipeline is not supported by the shared-memory parameter server and will be ignored.\n");
+        if (m_ModelAveragingSGDSimulating && m_delayCompensation != 0)
+        {
+            fprintf(stderr, "DataParallelASGD: delayCompensation has no effect with SimModelAverage and will be ignored.\n");
+            m_delayCompensation = 0;
+        }
+        // Between pulls, the worker's model and the global one drift apart by more than the other workers' pushes
+        // (its own pushes are scaled and compensated on the server, but not locally), so no model it has is the
+        // right reference for the correction.
+        if (m_delayCompensation != 0 && m_pushesPerPull > 1)
+            InvalidArgument("DataParallelASGD: delayCompensation requires pushesPerPull = 1.");
+
+        for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
+        {
+            m_tableOffsets.push_back(m_totalModelSize);
+            m_tableLength.push_back(dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter)->Value().GetNumElements());
+            m_totalModelSize += m_tableLength.back();
+        }
+        m_localModel.reset(new ElemType[m_totalModelSize]);
+        m_baseModel.reset(new ElemType[m_totalModelSize]);
+        m_deltaArray.reset(new ElemType[m_totalModelSize]);
+
+        // The main node creates the shared memory under a name derived from its process id, which no other live job uses.
+        // The name is removed once all workers have attached, also when attaching fails, and the memory is released when
+        // the last worker exits. Should the main node die in between, the next job with that process id replaces the segment.
+        size_t id = (size_t)GetCurrentProcessId();
+        m_pMPI->Bcast(&id, 1, m_pMPI->MainNodeRank());
+        string name = msra::strfun::strprintf("cntk-asgd-%llu", (unsigned long long)id);
+        bool isMainNode = m_pMPI->IsMainNode();
+        if (isMainNode)
+            m_server.reset(new SharedMemoryParameterServer<ElemType>(name, m_totalModelSize, numShards, /*create=*/true));
+        {
+            auto unlinkName = MakeScopeExit([&]() { if (isMainNode) m_server->Unlink(); });
+            m_pMPI->WaitAll();
+            if (!isMainNode)
+                m_server.reset(new SharedMemoryParameterServer<ElemType>(name, m_totalModelSize, numShards, /*create=*/false));
+            m_pMPI->WaitAll();
+        }
 
-    ~NoneASGDHelper() { }
+        // spread the workers over the shards, so that they rarely wait for each other's locks
+        m_firstShard = m_pMPI->CurrentNodeRank() * m_server->NumShards() / m_pMPI->NumNodesInUse();
+    }
+
+    void InitModel(const std::list<ComputationNodeBasePtr> & learnableNodes) override
+    {
+        CopyFromNodes(learnableNodes, m_baseModel.get());
+        if (m_pMPI->IsMainNode())
+            m_server->SetModel(m_baseModel.get());
+        WaitAll();
+        m_server->Pull(m_baseModel.get(), m_firstShard);
+        CopyToNodes(learnableNodes, m_baseModel.get());
+        WaitAll(); // nobody may push before everybody has pulled the initial model
+
+        fprintf(stderr, "DataParallelASGD: Shared-memory parameter server initialized with %d parameters in %d shards.\n",
+                (int)m_totalModelSize, (int)m_server->NumShards());
+        m_reportTimer.Start();
+    }
+
+    bool PushAndPullModel(const std::list<ComputationNodeBasePtr> & learnableNodes, size_t sampleSinceLastSynced) override
+    {
+        m_parameterSyncCounter++;
+        m_sampleSinceLastReport += sampleSinceLastSynced;
 
-    void InitModel(const std::list<ComputationNodeBasePtr> & learnableNode) override { }
+        Timer timer;
+        timer.Start();
 
-    bool PushAndPullModel(const std::list<ComputationNodeBasePtr> & learnableNodes, size_t sampleSinceLastSynced) override { 
+        // delta = what the worker has learned since its last pull
+        CopyFromNodes(learnableNodes, m_localModel.get());
+        std::transform(m_localModel.get(), m_localModel.get() + m_totalModelSize, m_baseModel.get(), m_deltaArray.get(), std::minus<ElemType>());
+
+        bool pull;
+        if (m_ModelAveragingSGDSimulating)
+        {
+            // all workers push their deltas, then all get the same average model
+            m_server->Push(m_deltaArray.get(), m_baseModel.get(), (ElemType)(1.0 / m_totalClientNumber), 0, nullptr, m_firstShard);
+            WaitAll();
+            m_server->Pull(m_baseModel.get(), m_firstShard);
+            WaitAll();
+            pull = true;
+        }
+        else
+        {
+            pull = m_parameterSyncCounter % m_pushesPerPull == 0;
+            m_server->Push(m_deltaArray.get(), m_baseModel.get(), (ElemType)DecayCoefficient(), m_delayCompensation, pull ? m_baseModel.get() : nullptr, m_firstShard);
+            if (!pull) // continue with the local model; the next delta is relative to it
+                std::swap(m_baseModel, m_localModel);
+        }
+        if (pull)
+            CopyToNodes(learnableNodes, m_baseModel.get());
+
+        timer.Stop();
+        m_secondsInPushAndPullSinceLastReport += timer.ElapsedSeconds();
+        if (m_traceLevel > 3)
+            fprintf(stderr, "\t\t -- pushAndPull%s, %lf seconds\n", pull ? "" : " (push only)", timer.ElapsedSeconds());
+        if (m_traceLevel > 2 && m_syncPerfStats > 0 && m_parameterSyncCounter % m_syncPerfStats == 0)
+            ReportPerfStats();
         return true;
     }
 
-    void WaitAll() override { }
+    void WaitAll() override
+    {
+        m_pMPI->WaitAll();
+    }
 
+    // pushes are synchronous
     void WaitAsyncBuffer() override { }
-};
+
+private:
+    void CopyFromNodes(const std::list<ComputationNodeBasePtr> & learnableNodes, ElemType* model)
+    {
+        int i = 0; // indicate the index of learnable nodes
+        for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, i++)
+        {
+            Matrix<ElemType> &mat = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter)->Value();
+            ElemType* px = model + m_tableOffsets[i];
+            size_t length = m_tableLength[i]; // (large enough, so CopyToArray() does not reallocate)
+            mat.CopyToArray(px, length);
+        }
+    }
+
+    void CopyToNodes(const std::list<ComputationNodeBasePtr> & learnableNodes, ElemType* model)
+    {
+        int i = 0;
+        for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, i++)
+        {
+            Matrix<ElemType> &mat = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter)->Value();
+            mat.SetValue(mat.GetNumRows(), mat.GetNumCols(), mat.GetDeviceId(), model + m_tableOffsets[i]);
+            (*nodeIter)->BumpEvalTimeStamp();
+        }
+    }
+
+    // same schedule as MultiversoHelper
+    float DecayCoefficient()
+    {
+        float f = 1.f;
+        switch (m_adjustLearningRateAtBeginningType)
+        {
+        case AdjustLearningRateAtBeginning::None:
+            break;
+        case AdjustLearningRateAtBeginning::Linearly:
+            f = min(f, max(0.f, (float)(m_adjustCoefficient + (1 - m_adjustCoefficient) / m_adjustMBNumber * m_parameterSyncCounter)));
+            break;
+        case AdjustLearningRateAtBeginning::Staircase:
+            f = min(f, max(0.f, (float)(m_adjustCoefficient * (m_parameterSyncCounter / m_adjustMBNumber + 1))));
+            break;
+        default:
+            break;
+        }
+        return f;
+    }
+
+    void ReportPerfStats()
+    {
+        m_reportTimer.Stop();
+        double secondsSinceLastReport = m_reportTimer.ElapsedSeconds();
+        m_reportTimer.Restart();
+
+        float localThroughput = secondsSinceLastReport > 0 ? (float)m_sampleSinceLastReport / ((float)secondsSinceLastReport * 1000.0f) : 0.0f;
+        fprintf(stderr, "\t\t(shared-memory ASGD stats) %d-th sync: %8.2f seconds since last report ; %d samples processed by me (%.2fk samplesPerSecond) ; %.2f seconds spent in push/pull ; %d pushes by all %d workers so far\n",
+                (int)m_parameterSyncCounter, secondsSinceLastReport, (int)m_sampleSinceLastReport, localThroughput,
+                m_secondsInPushAndPullSinceLastReport, (int)m_server->NumPushes(), (int)m_totalClientNumber);
+        m_sampleSinceLastReport = 0;
+        m_secondsInPushAndPullSinceLastReport = 0;
+    }
+
+    int m_totalClientNumber;
+    bool m_ModelAveragingSGDSimulating;
+    AdjustLearningRateAtBeginning m_adjustLearningRateAtBeginningType;
+    double m_adjustCoefficient;
+    size_t m_adjustMBNumber;
+    int m_traceLevel;
+    int m_syncPerfStats;
+    size_t m_pushesPerPull;
+    ElemType m_delayCompensation;
+
+    size_t m_parameterSyncCounter;
+    size_t m_sampleSinceLastReport;
+    double m_secondsInPushAndPullSinceLastReport;
+    Timer m_reportTimer;
+
+    vector<size_t> m_tableLength;
+    vector<size_t> m_tableOffsets;
+    size_t m_totalModelSize = 0;
+    unique_ptr<ElemType[]> m_localModel; // current model of this worker
+    unique_ptr<ElemType[]> m_baseModel;  // model this worker started from at the last sync
+    unique_ptr<ElemType[]> m_deltaArray;
+
+    unique_ptr<SharedMemoryParameterServer<ElemType>> m_server;
+    size_t m_firstShard;
+    MPIWrapperPtr m_pMPI;
+};  // Class SharedMemoryASGDHelper
+
+#endif
 
 template<class ElemType>
 ASGDHelper<ElemType>* NewASGDHelper(
@@ -635,14 +844,18 @@ ASGDHelper<ElemType>* NewASGDHelper(
     double adjustCoef,
     size_t adjustPerMinibatches,
     int traceLevel,
-    int syncPerfStats) 
+    int syncPerfStats,
+    size_t numShards,
+    size_t pushesPerPull,
+    double delayCompensation)
 {
 #ifdef ASGD_PARALLEL_SUPPORT
     return new MultiversoHelper<ElemType>(learnableNodes, nodeNumRanks, useAsyncBuffer, isSimulatedModelAveragingSGD, 
                                       adjusttype, adjustCoef, adjustPerMinibatches, traceLevel, syncPerfStats);
 #else
-    return new NoneASGDHelper<ElemType>(learnableNodes, nodeNumRanks, useAsyncBuffer, isSimulatedModelAveragingSGD, 
-                                      adjusttype, adjustCoef, adjustPerMinibatches, traceLevel, syncPerfStats); 
+    return new SharedMemoryASGDHelper<ElemType>(learnableNodes, nodeNumRanks, useAsyncBuffer, isSimulatedModelAveragingSGD,
+                                      adjusttype, adjustCoef, adjustPerMinibatches, traceLevel, syncPerfStats,
+                                      numShards, pushesPerPull, delayCompensation);
 #endif
 }
 
@@ -655,7 +868,10 @@ template<> ASGDHelper<half>* NewASGDHelper<half>(
     double adjustCoef,
     size_t adjustPerMinibatches,
     int traceLevel,
-    int syncPerfStats)
+    int syncPerfStats,
+    size_t numShards,
+    size_t pushesPerPull,
+    double delayCompensation)
 {
     RuntimeError("NewASGDHelper - half not supported!");
 }
@@ -669,7 +885,10 @@ template ASGDHelper<float>* NewASGDHelper<float>(
     double adjustCoef,
     size_t adjustPerMinibatches,
     int traceLevel,
-    int syncPerfStats); 
+    int syncPerfStats,
+    size_t numShards,
+    size_t pushesPerPull,
+    double delayCompensation); 
 
 template ASGDHelper<double>* NewASGDHelper<double>(
     const std::list<ComputationNodeBasePtr> & learnableNodes,
@@ -680,6 +899,9 @@ template ASGDHelper<double>* NewASGDHelper<double>(
     double adjustCoef,
     size_t adjustPerMinibatches,
     int traceLevel,
-    int syncPerfStats); 
+    int syncPerfStats,
+    size_t numShards,
+    size_t pushesPerPull,
+    double delayCompensation); 
 
 }}} 
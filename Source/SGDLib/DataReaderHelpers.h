@@ -634,6 +634,239 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             m_netEvaluationAccumulator->SetValue(0);
         }
     };
+
+    // -------------------------------------------------------------------
+    // MinibatchReplayReader -- replays the minibatches of a mini-epoch
+    // The learning rate search trains several times on the same first samples of an epoch. The first
+    // mini-epoch is read from the wrapped reader and recorded in CPU memory (input matrices, layouts and
+    // sample positions); as long as the epoch, minibatch size and epoch size stay the same, following
+    // mini-epochs are served from the recording instead of reading and decoding the data again.
+    // Readers that deliver data through other calls (sequence training, Kaldi2Reader) are not replayed.
+    // -------------------------------------------------------------------
+    template <class ElemType>
+    class MinibatchReplayReader : public IDataReader
+    {
+        struct RecordedInput
+        {
+            MatrixBasePtr matrix;
+            MBLayoutPtr pMBLayout;
+        };
+
+    public:
+        MinibatchReplayReader(IDataReader* reader)
+            : m_reader(reader), m_replaying(false), m_canReplay(true), m_cursor(0),
+              m_mbSize(0), m_epoch(0), m_subsetNum(0), m_numSubsets(0), m_requestedEpochSamples(0)
+        {
+            m_seed = reader->m_seed;
+            mRequestedNumParallelSequences = reader->mRequestedNumParallelSequences;
+        }
+
+        virtual void Init(const ConfigParameters&) override { NOT_IMPLEMENTED; }
+        virtual void Init(const ScriptableObjects::IConfigRecord&) override { NOT_IMPLEMENTED; }
+        virtual void Destroy() override { }
+
+        virtual void StartMinibatchLoop(size_t mbSize, size_t epoch, const std::unordered_set<InputStreamDescription>& requiredStreams, size_t requestedEpochSamples = requestDataSize) override
+        {
+            if (!StartReplay(mbSize, epoch, 0, 1, requestedEpochSamples))
+                m_reader->StartMinibatchLoop(mbSize, epoch, requiredStreams, requestedEpochSamples);
+        }
+
+        virtual void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize) override
+        {
+            if (!StartReplay(mbSize, epoch, 0, 1, requestedEpochSamples))
+                m_reader->StartMinibatchLoop(mbSize, epoch, requestedEpochSamples);
+        }
+
+        virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, const std::unordered_set<InputStreamDescription>& requiredStreams, size_t requestedEpochSamples = requestDataSize) override
+        {
+            if (!StartReplay(mbSize, epoch, subsetNum, numSubsets, requestedEpochSamples))
+                m_reader->StartDistributedMinibatchLoop(mbSize, epoch, subsetNum, numSubsets, requiredStreams, requestedEpochSamples);
+        }
+
+        virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize) override
+        {
+            if (!StartReplay(mbSize, epoch, subsetNum, numSubsets, requestedEpochSamples))
+                m_reader->StartDistributedMinibatchLoop(mbSize, epoch, subsetNum, numSubsets, requestedEpochSamples);
+        }
+
+        virtual bool SupportsDistributedMBRead() const override { return m_reader->SupportsDistributedMBRead(); }
+        virtual bool IsLegacyReader() const override { return m_reader->IsLegacyReader(); }
+        virtual size_t GetNumParallelSequencesForFixingBPTTMode() override { return m_reader->GetNumParallelSequencesForFixingBPTTMode(); }
+
+        virtual size_t GetCurrentSamplePosition() override
+        {
+            if (!m_replaying)
+            {
+                // the mini-epoch decides when to stop from these, so remember them for the replay
+                size_t position = m_reader->GetCurrentSamplePosition();
+                if (m_samplePositions.size() <= m_cursor)
+                    m_samplePositions.resize(m_cursor + 1, SIZE_MAX);
+                m_samplePositions[m_cursor] = position;
+                return position;
+            }
+            if (m_cursor >= m_samplePositions.size() || m_samplePositions[m_cursor] == SIZE_MAX)
+                LogicError("MinibatchReplayReader: Sample position was not recorded.");
+            return m_samplePositions[m_cursor];
+        }
+
+        virtual bool GetMinibatch(StreamMinibatchInputs& matrices) override
+        {
+            if (m_replaying)
+            {
+                if (m_cursor >= m_minibatches.size())
+                    return false;
+                const auto& recorded = m_minibatches[m_cursor++];
+                for (auto& input : matrices)
+                {
+                    auto iter = recorded.find(input.first);
+                    if (iter == recorded.end())
+                        LogicError("MinibatchReplayReader: Input '%ls' was not recorded.", input.first.c_str());
+                    CopyMatrix(*iter->second.matrix, *input.second.matrix);
+                    if (input.second.pMBLayout)
+                        input.second.pMBLayout->CopyFrom(iter->second.pMBLayout, /*keepName=*/true);
+                }
+                return true;
+            }
+
+            if (!m_reader->GetMinibatch(matrices))
+                return false;
+
+            // record; inputs that share a layout share its copy as well
+            map<wstring, RecordedInput> recorded;
+            map<MBLayoutPtr, MBLayoutPtr> layouts;
+            for (auto& input : matrices)
+            {
+                RecordedInput copy;
+                copy.matrix = CloneMatrix(*input.second.matrix);
+                if (input.second.pMBLayout)
+                {
+                    auto& layout = layouts[input.second.pMBLayout];
+                    if (!layout)
+                    {
+                        layout = make_shared<MBLayout>();
+                        layout->CopyFrom(input.second.pMBLayout);
+                    }
+                    copy.pMBLayout = layout;
+                }
+                recorded[input.first] = copy;
+            }
+            m_minibatches.push_back(move(recorded));
+            m_cursor++;
+            return true;
+        }
+
+        virtual bool GetMinibatch4SE(std::vector<shared_ptr<const msra::dbn::latticepair>>& latticeinput, vector<size_t>& uids, vector<size_t>& boundaries, vector<size_t>& extrauttmap) override
+        {
+            if (m_replaying)
+                LogicError("MinibatchReplayReader: Lattices cannot be replayed.");
+            m_canReplay = false;
+            return m_reader->GetMinibatch4SE(latticeinput, uids, boundaries, extrauttmap);
+        }
+
+        virtual bool DataEnd() override
+        {
+            return m_replaying ? true : m_reader->DataEnd();
+        }
+
+        virtual void CopyMBLayoutTo(MBLayoutPtr pMBLayout) override
+        {
+            m_reader->CopyMBLayoutTo(pMBLayout);
+        }
+
+        virtual bool GetMinibatchCopy(std::vector<std::vector<std::pair<wstring, size_t>>>& uttInfo, StreamMinibatchInputs& matrices, MBLayoutPtr pMBLayout) override
+        {
+            if (m_replaying)
+                return false;
+            bool wasDataRead = m_reader->GetMinibatchCopy(uttInfo, matrices, pMBLayout);
+            if (wasDataRead)
+                m_canReplay = false; // the reader feeds the network output back into the data
+            return wasDataRead;
+        }
+
+        virtual bool SetNetOutput(const std::vector<std::vector<std::pair<wstring, size_t>>>& uttInfo, const MatrixBase& outputs, const MBLayoutPtr pMBLayout) override
+        {
+            return m_replaying ? false : m_reader->SetNetOutput(uttInfo, outputs, pMBLayout);
+        }
+
+        bool IsReplaying() const { return m_replaying; }
+
+    private:
+        // inputs are not necessarily of type ElemType (e.g. float labels in half precision training)
+        static MatrixBasePtr CloneMatrix(const MatrixBase& M)
+        {
+            if (auto p = dynamic_cast<const Matrix<float>*>(&M))
+                return CloneToCPU(*p);
+            if (auto p = dynamic_cast<const Matrix<double>*>(&M))
+                return CloneToCPU(*p);
+            if (auto p = dynamic_cast<const Matrix<half>*>(&M))
+                return CloneToCPU(*p);
+            LogicError("MinibatchReplayReader: Unsupported input matrix type.");
+        }
+
+        static void CopyMatrix(const MatrixBase& from, MatrixBase& to)
+        {
+            if (auto p = dynamic_cast<Matrix<float>*>(&to))
+                CopyToDevice(dynamic_cast<const Matrix<float>&>(from), *p);
+            else if (auto p = dynamic_cast<Matrix<double>*>(&to))
+                CopyToDevice(dynamic_cast<const Matrix<double>&>(from), *p);
+            else if (auto p = dynamic_cast<Matrix<half>*>(&to))
+                CopyToDevice(dynamic_cast<const Matrix<half>&>(from), *p);
+            else
+                LogicError("MinibatchReplayReader: Unsupported input matrix type.");
+        }
+
+        // The recording lives in CPU memory: a mini-epoch can be many minibatches, which must not be held on the GPU
+        // next to the model.
+        template <class T>
+        static MatrixBasePtr CloneToCPU(const Matrix<T>& M)
+        {
+            auto copy = make_shared<Matrix<T>>(M.DeepClone());
+            copy->TransferToDeviceIfNotThere(CPUDEVICE, /*isBeingMoved=*/true);
+            return copy;
+        }
+
+        template <class T>
+        static void CopyToDevice(const Matrix<T>& from, Matrix<T>& to)
+        {
+            if (from.GetDeviceId() == to.GetDeviceId())
+            {
+                to.SetValue(from);
+                return;
+            }
+            Matrix<T> copy(from.DeepClone());
+            copy.TransferToDeviceIfNotThere(to.GetDeviceId(), /*isBeingMoved=*/true);
+            to.SetValue(copy);
+        }
+
+        // Returns true if the requested mini-epoch is the recorded one. Otherwise the recording starts over.
+        bool StartReplay(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples)
+        {
+            bool sameLoop = mbSize == m_mbSize && epoch == m_epoch && subsetNum == m_subsetNum &&
+                            numSubsets == m_numSubsets && requestedEpochSamples == m_requestedEpochSamples;
+            m_replaying = sameLoop && m_canReplay && !m_minibatches.empty();
+            m_cursor = 0;
+            if (!m_replaying)
+            {
+                m_minibatches.clear();
+                m_samplePositions.clear();
+                m_canReplay = true;
+                m_mbSize = mbSize;
+                m_epoch = epoch;
+                m_subsetNum = subsetNum;
+                m_numSubsets = numSubsets;
+                m_requestedEpochSamples = requestedEpochSamples;
+            }
+            return m_replaying;
+        }
+
+        IDataReader* m_reader;
+        bool m_replaying;
+        bool m_canReplay;
+        size_t m_cursor;                                        // minibatches read so far in the current mini-epoch
+        std::vector<map<wstring, RecordedInput>> m_minibatches;
+        std::vector<size_t> m_samplePositions;                  // sample position after [i] minibatches, SIZE_MAX if not asked for
+        size_t m_mbSize, m_epoch, m_subsetNum, m_numSubsets, m_requestedEpochSamples;
+    };
 };
 
 }}}
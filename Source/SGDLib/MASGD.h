@@ -41,12 +41,14 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         size_t m_localSamplesProcessedSinceLastReport; 
         double m_accumulatedSecondsOnSyncPointInOneEpoch;
         size_t m_syncPointHitCounterInOneEpoch;
+        double m_secondsOfHiddenCommunicationSinceLastReport; // (overlapped model averaging only)
         Timer  m_Timer; 
 
     public:
         MASGDPerfStats(size_t myRank, size_t numWorkers):
             m_numWorkers(numWorkers), m_myRank(myRank), m_numSyncPerformedInCurrentEpoch(0), m_reportFrequency(1), 
-            m_totalSamplesProcessedSinceLastReport(0), m_localSamplesProcessedSinceLastReport(0)
+            m_totalSamplesProcessedSinceLastReport(0), m_localSamplesProcessedSinceLastReport(0),
+            m_secondsOfHiddenCommunicationSinceLastReport(0)
         {
             m_Timer.Start();
         }
@@ -88,6 +90,14 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                 m_localSamplesProcessedSinceLastReport = 0; 
             }
         }
+        // for model averaging that overlaps with computation: 'secondsInFlight' is the time from starting the
+        // communication until its result was needed, 'secondsWaited' is how long we then still had to wait for it
+        void OnOverlappedCommunication(double secondsInFlight, double secondsWaited)
+        {
+            if (secondsInFlight > secondsWaited)
+                m_secondsOfHiddenCommunicationSinceLastReport += secondsInFlight - secondsWaited;
+        }
+
         void OnArriveAtSyncPoint(double secondOnSyncPoint, bool printMessage)
         {
             if (printMessage)
@@ -117,6 +127,13 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                             "\t\t(model aggregation stats) %d-th sync: totalThroughput = %.2fk samplesPerSecond , throughputPerWorker = %.2fk samplesPerSecond\n";
             fprintf(stderr, prefix.c_str(), (int)m_numSyncPerformedInCurrentEpoch, secondsSinceLastReport, secondOnCommunication, (int)totalSamplesProcessedSinceLastReport, (int)m_numWorkers, (int)localSamplesProcessedSinceLastReport,
                                             (int)m_numSyncPerformedInCurrentEpoch, totalThroughput, throughputPerWorker); 
+            if (m_secondsOfHiddenCommunicationSinceLastReport > 0)
+            {
+                // an upper bound: the communication may have completed before the computation it overlapped with
+                fprintf(stderr, "\t\t(model aggregation stats) %d-th sync: up to %.2f seconds of communication hidden behind computation\n",
+                        (int)m_numSyncPerformedInCurrentEpoch, m_secondsOfHiddenCommunicationSinceLastReport);
+                m_secondsOfHiddenCommunicationSinceLastReport = 0;
+            }
         }
     };
     // base class for MA-SGD algorithm family 
@@ -417,8 +434,161 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                     commTimer.Stop();
                     secondsOnCommunication += (float)commTimer.ElapsedSeconds();
                 }
+                pNode->BumpEvalTimeStamp();
+            }
+        }
+    };
+
+    // Model averaging that overlaps the communication with computation.
+    // At a sync point, the average of the models is not waited for. Instead, each worker takes a snapshot of its model
+    // and starts an asynchronous allreduce of it, then continues with its local updates. At the next sync point, the
+    // average of the snapshots has (most likely) arrived and is merged into the current model by applying the averaging
+    // delta, i.e. model += average(snapshots) - own snapshot, which keeps the local progress made in the meantime.
+    // The averaging is thus applied with a delay of one period. At the end of an epoch, the pending averaging is merged,
+    // and a synchronous averaging makes all workers end the epoch with the same model.
+    // Whether the allreduce progresses while we compute depends on the MPI implementation (asynchronous progress).
+    template<typename ElemType>
+    class OverlappedModelAveragingSGD : public IMASGD<ElemType>
+    {
+        typedef IMASGD<ElemType> Base; 
+        using Base::m_pMPI;
+        using Base::m_nccl;
+        using Base::m_perfReporter;
+        using Base::DownCast;
+        typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+
+        // per learnable parameter: its snapshot and the sum of all workers' sample-weighted snapshots
+        struct PendingParameter
+        {
+            ComputationNodePtr node;
+            shared_ptr<Matrix<ElemType>> snapshot;
+            shared_ptr<Matrix<ElemType>> weightedSum; // on the device; used directly by NCCL
+            unique_ptr<ElemType[]> cpuWeightedSum;    // buffer for MPI
+            MPI_Request request;
+        };
+
+    public:
+        OverlappedModelAveragingSGD(const MPIWrapperPtr& pMPI, size_t reportFreq, DEVICEID_TYPE devID)
+            : Base(pMPI, reportFreq, devID), m_isPending(false), m_synchronous(false), m_totalSamples(0), m_totalSamplesRequest()
+        {
+            fprintf(stderr, "Parallel training (%d workers) using ModelAveraging, overlapping communication with computation\n", (int)m_pMPI->NumNodesInUse());
+        }
+
+        void OnEpochEnd(const std::list<ComputationNodeBasePtr>& learnableNodes,
+                        std::list<MatrixBasePtr>& smoothedGradients,
+                        size_t samplesSinceLastSync) override
+        {
+            // all workers have the same averaging in flight, since it was started at a common sync point
+            MergePendingAveraging();
+            m_synchronous = true;
+            Base::OnEpochEnd(learnableNodes, smoothedGradients, samplesSinceLastSync);
+            m_synchronous = false;
+        }
+
+        void ModelAggregationProcessing(
+            size_t samplesSinceLastSync,                                       /* in */
+            const std::list<ComputationNodeBasePtr>&  learnableNodes,          /* in/out */
+            std::list<MatrixBasePtr>&                 /*smoothedGradients*/,   /* in/out */
+            size_t&                                   totalSamplesProcessed,   /* out */
+            float&                                    secondsOnCommunication   /* out */) override
+        {
+            Timer commTimer;
+            commTimer.Start();
+
+            // 1. merge the averaging started at the previous sync point, if any
+            size_t totalSamplesOfPreviousAveraging = MergePendingAveraging();
+
+            // 2. start averaging the current model
+            m_totalSamples = (int)samplesSinceLastSync;
+            m_pMPI->AllReduceAsync(&m_totalSamples, 1, &m_totalSamplesRequest);
+            m_pendingParameters.clear();
+            for (auto& pBaseNode : learnableNodes)
+            {
+                if (!pBaseNode->IsParameterUpdateRequired())
+                    continue;
+                PendingParameter parameter;
+                parameter.node = DownCast(pBaseNode);
+                const auto& value = parameter.node->Value();
+                parameter.snapshot = make_shared<Matrix<ElemType>>(value.DeepClone());
+                // each worker contributes with the number of samples it processed; we normalize once the total is known
+                parameter.weightedSum = make_shared<Matrix<ElemType>>(value.DeepClone());
+                Matrix<ElemType>::Scale((ElemType)samplesSinceLastSync, *parameter.weightedSum);
+                m_pendingParameters.push_back(std::move(parameter));
+            }
+            for (auto& parameter : m_pendingParameters) // (separate loop, so that all workers issue the collectives in the same order)
+            {
+                auto& weightedSum = *parameter.weightedSum;
+                if (!m_nccl.IsSupported())
+                {
+                    parameter.cpuWeightedSum.reset(weightedSum.CopyToArray());
+                    m_pMPI->AllReduceAsync(parameter.cpuWeightedSum.get(), weightedSum.GetNumElements(), &parameter.request);
+                }
+                else
+                    m_nccl.AllReduce(weightedSum.Data(), weightedSum.Data(), weightedSum.GetNumElements());
             }
+            m_isPending = true;
+            m_startTimer.Restart();
+
+            // at the end of an epoch, wait for the result right away
+            size_t totalSamplesOfThisAveraging = 0;
+            if (m_synchronous)
+                totalSamplesOfThisAveraging = MergePendingAveraging();
+
+            commTimer.Stop();
+            secondsOnCommunication = (float)commTimer.ElapsedSeconds();
+            // what we report is the averaging that completed at this sync point
+            size_t totalSamples = m_synchronous ? totalSamplesOfThisAveraging : totalSamplesOfPreviousAveraging;
+            totalSamplesProcessed = totalSamples > 0 ? totalSamples : samplesSinceLastSync * m_pMPI->NumNodesInUse();
         }
+
+    private:
+        // wait for the pending averaging, and apply it to the current model; returns the total number of samples it covered
+        size_t MergePendingAveraging()
+        {
+            if (!m_isPending)
+                return 0;
+            m_startTimer.Stop();
+            double secondsInFlight = m_startTimer.ElapsedSeconds();
+
+            Timer waitTimer;
+            waitTimer.Start();
+            m_pMPI->Wait(&m_totalSamplesRequest);
+            if (!m_nccl.IsSupported())
+            {
+                for (auto& parameter : m_pendingParameters)
+                    m_pMPI->Wait(&parameter.request);
+            }
+            else
+                m_nccl.Sync();
+            waitTimer.Stop();
+            m_perfReporter.OnOverlappedCommunication(secondsInFlight, waitTimer.ElapsedSeconds());
+
+            // model += average - snapshot
+            // If no worker has processed any samples (or the count overflowed), there is nothing to merge.
+            if (m_totalSamples > 0)
+            {
+                for (auto& parameter : m_pendingParameters)
+                {
+                    auto& weightedSum = *parameter.weightedSum;
+                    if (!m_nccl.IsSupported())
+                        weightedSum.SetValue(weightedSum.GetNumRows(), weightedSum.GetNumCols(), weightedSum.GetDeviceId(), parameter.cpuWeightedSum.get());
+                    auto& value = parameter.node->Value();
+                    Matrix<ElemType>::ScaleAndAdd((ElemType)(1.0 / m_totalSamples), weightedSum, value);
+                    Matrix<ElemType>::ScaleAndAdd((ElemType)-1, *parameter.snapshot, value);
+                    parameter.node->BumpEvalTimeStamp();
+                }
+            }
+            m_pendingParameters.clear();
+            m_isPending = false;
+            return m_totalSamples > 0 ? (size_t)m_totalSamples : 0;
+        }
+
+        bool m_isPending;                                   // an averaging is in flight
+        bool m_synchronous;                                 // (at the end of an epoch) wait for the averaging right away
+        std::vector<PendingParameter> m_pendingParameters;
+        int m_totalSamples;                                 // reduced in place: total samples of the pending averaging
+        MPI_Request m_totalSamplesRequest;
+        Timer m_startTimer;                                 // time since the pending averaging was started
     };
 
 } } }
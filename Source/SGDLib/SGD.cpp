@@ -15,6 +15,7 @@
 #include "DataReaderHelpers.h"
 #include "MatrixQuantizerImpl.h"
 #include "InputAndParamNodes.h"
+#include "PreComputeNodes.h"
 #include "AccumulatorAggregation.h"
 
 #ifdef CNTK_PARALLEL_TRAINING_SUPPORT
@@ -526,7 +527,10 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                                          m_adjustCoefficient,
                                          m_adjustPerMinibatches,
                                          m_traceLevel,
-                                         m_syncStatsTrace));
+                                         m_syncStatsTrace,
+                                         m_numParameterServerShards,
+                                         m_pushesPerPull,
+                                         m_delayCompensation));
         m_pASGDHelper->InitModel(learnableNodes);
     }
 
@@ -537,6 +541,12 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         tensorBoardWriter = make_shared<::CNTK::Internal::TensorBoardFileWriter>(m_tensorBoardLogDir, net);
     }
 
+    // node timing is a global setting; only switch it on for the duration of this training
+    bool wasNodeTimingEnabled = Globals::ShouldEnableNodeTiming();
+    auto restoreNodeTiming = MakeScopeExit([wasNodeTimingEnabled]() { Globals::SetNodeTiming(wasNodeTimingEnabled); });
+    if (!m_nodeCostReport.empty())
+        Globals::SetNodeTiming(true);
+
     // --- MAIN EPOCH LOOP
     for (int i = startEpoch; i < (int) m_maxEpochs; i++) // TODO: why is this an int, and not a size_t?
     {
@@ -673,6 +683,8 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
 
         EpochCriterion epochCriterion; // criterion values are returned in this
         std::vector<EpochCriterion> epochEvalErrors(evaluationNodes.size());
+        if (!m_nodeCostReport.empty())
+            net->ResetNodeTiming(); // (drop the timing of precomputation and of learning-rate/minibatch-size searches)
         totalMBsSeen += TrainOneEpoch(net,
                                       refNet,
                                       refNode,
@@ -706,6 +718,9 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         for (size_t j = 0; j < epochEvalErrors.size(); j++)
             epochEvalErrors[j].LogCriterion(evaluationNodes[j]->NodeName());
         fprintf(stderr, "totalSamplesSeen = %zu; learningRatePerSample = %.8g; epochTime=%.6gs\n", totalTrainingSamplesSeen, learnRatePerSample, epochTime);
+
+        if (!m_nodeCostReport.empty() && (m_mpi == nullptr || m_mpi->IsMainNode()))
+            net->WriteNodeCostReport(msra::strfun::wstrprintf(L"%ls.epoch%d", m_nodeCostReport.c_str(), i + 1), i + 1);
 #if 0
         // TODO: This was only printed if >1 eval criterion. Why? Needed?
         LOGPRINTF(stderr, "Finished Epoch[%2d of %d]:     Criterion Node [%ls] Per Sample = %.8g\n",
@@ -812,6 +827,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                     // roll back
                     auto bestModelPath = GetModelNameForEpoch(i - m_learnRateAdjustInterval);
                     LOGPRINTF(stderr, "Loading (rolling back to) previous model with best training-criterion value: %ls.\n", bestModelPath.c_str());
+                    WaitForPendingCheckpoint();
                     net->RereadPersistableParameters<ElemType>(bestModelPath);
                     LoadCheckPointInfo(i - m_learnRateAdjustInterval,
                                        /*out*/ totalTrainingSamplesSeen,
@@ -916,6 +932,9 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
             }
             else
             {
+                auto modelName = GetModelNameForEpoch(i);
+                if (m_traceLevel > 0)
+                    LOGPRINTF(stderr, "SGD: Saving checkpoint model '%ls'\n", modelName.c_str());
                 SaveCheckPointInfo(
                     i,
                     totalTrainingSamplesSeen,
@@ -923,11 +942,8 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                     smoothedGradients,
                     smoothedCounts,
                     prevCriterion,
-                    chosenMinibatchSize);
-                auto modelName = GetModelNameForEpoch(i);
-                if (m_traceLevel > 0)
-                    LOGPRINTF(stderr, "SGD: Saving checkpoint model '%ls'\n", modelName.c_str());
-                net->Save(modelName);
+                    chosenMinibatchSize,
+                    net);
                 if (!m_keepCheckPointFiles)
                 {
                     // delete previous checkpoint file to save space
@@ -966,6 +982,11 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     }
     // --- END OF MAIN EPOCH LOOP
 
+    // The last checkpoint is also the final model.
+    WaitForPendingCheckpoint();
+    if (m_asyncCheckpointing && m_traceLevel > 0)
+        LOGPRINTF(stderr, "SGD: Training was blocked on checkpoints for %.3f seconds in total.\n", m_checkpointBlockedSeconds);
+
     // Check if we need to save best model per criterion and this is the main node as well.
     if (m_saveBestModelPerCriterion && ((m_mpi == nullptr) || m_mpi->IsMainNode()))
     {
@@ -1780,6 +1801,105 @@ const std::vector<ComputationNodeBasePtr>& SGD<ElemType>::GetEvalCriterionNodes(
         return net->EvaluationNodes();
 }
 
+// combine the precompute accumulators of all workers
+static void AggregatePreComputeAccumulators(const MPIWrapperPtr& mpi, const std::list<ComputationNodeBasePtr>& nodes)
+{
+    for (const auto& node : nodes)
+        dynamic_pointer_cast<IMergeablePreComputeNode>(node)->MergeAccumulatorState([&](vector<double>& v) { mpi->AllReduce(v); });
+}
+
+// The key identifies the data and what is computed from it: the data configuration, the amount of data used,
+// and name, type and dimensions of each precompute node. Results do not depend on the minibatch size or
+// on the number of workers (up to rounding).
+template <class ElemType>
+std::wstring SGD<ElemType>::GetPreComputeCacheKey(const std::list<ComputationNodeBasePtr>& nodes) const
+{
+    if (m_preComputeCache.empty() || m_dataConfigKey.empty())
+        return std::wstring();
+    std::wstring key = m_dataConfigKey;
+    key += msra::strfun::wstrprintf(L"\nelemSize=%d epochSize=%lld\n", (int)sizeof(ElemType), m_useAllDataForPreComputedNode ? -1LL : (long long)m_epochSize);
+    for (const auto& node : nodes)
+        key += node->NodeName() + L"=" + node->OperationName() + L"(" + ToFixedWStringFromMultiByte(string(node->GetSampleLayout())) + L")\n";
+    return key;
+}
+
+template <class ElemType>
+std::wstring SGD<ElemType>::GetPreComputeCachePath(const std::wstring& key) const
+{
+    return msra::strfun::wstrprintf(L"%ls/precompute.%016llx", m_preComputeCache.c_str(), (unsigned long long)HashOfKey(key));
+}
+
+template <class ElemType>
+bool SGD<ElemType>::LoadPreComputeCache(const std::list<ComputationNodeBasePtr>& nodes)
+{
+    let key = GetPreComputeCacheKey(nodes);
+    if (key.empty())
+        return false;
+    let path = GetPreComputeCachePath(key);
+    if (!fexists(path))
+        return false;
+
+    File fstream(path, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BPreComputeCache");
+    std::wstring fileKey;
+    fstream >> fileKey;
+    if (fileKey != key) // hash collision
+        return false;
+
+    size_t numNodes;
+    fstream >> numNodes;
+    if (numNodes != nodes.size())
+        return false;
+    vector<shared_ptr<Matrix<ElemType>>> values;
+    for (const auto& node : nodes)
+    {
+        std::wstring nodeName;
+        fstream >> nodeName;
+        if (nodeName != node->NodeName() || !node->Is<PreComputedNodeBase<ElemType>>())
+            return false;
+        values.push_back(make_shared<Matrix<ElemType>>(node->GetDeviceId()));
+        fstream >> *values.back();
+    }
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EPreComputeCache");
+
+    auto valueIter = values.begin();
+    for (const auto& node : nodes)
+        node->As<PreComputedNodeBase<ElemType>>()->SetPreComputedValue(*(*valueIter++));
+
+    LOGPRINTF(stderr, "Precomputing --> Loaded the values of %d nodes from '%ls'.\n\n", (int)nodes.size(), path.c_str());
+    return true;
+}
+
+template <class ElemType>
+void SGD<ElemType>::SavePreComputeCache(const std::list<ComputationNodeBasePtr>& nodes) const
+{
+    let key = GetPreComputeCacheKey(nodes);
+    if (key.empty() || (m_mpi != nullptr && !m_mpi->IsMainNode()))
+        return;
+    for (const auto& node : nodes)
+        if (!node->Is<PreComputedNodeBase<ElemType>>())
+            return;
+
+    let path = GetPreComputeCachePath(key);
+    msra::files::make_intermediate_dirs(path);
+    // write under a temp name, so that sibling jobs never see a partial file
+    let tmpPath = path + msra::strfun::wstrprintf(L".%d.tmp", (int)GetCurrentProcessId());
+    {
+        File fstream(tmpPath, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BPreComputeCache");
+        fstream << key;
+        fstream << nodes.size();
+        for (const auto& node : nodes)
+        {
+            fstream << node->NodeName();
+            fstream << node->As<PreComputedNodeBase<ElemType>>()->Value();
+        }
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EPreComputeCache");
+    }
+    renameOrDie(tmpPath, path);
+    LOGPRINTF(stderr, "Precomputing --> Saved the values to '%ls'.\n", path.c_str());
+}
+
 // execute PreComputeNodes
 // Returns true if precomputation was executed.
 template <class ElemType>
@@ -1811,14 +1931,37 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
     // compute
     ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::preComputing);
 
+    // An earlier run over the same data may have left the results. All workers must take the same path, since the
+    // parallel pass below communicates, so the cache is only used if every worker could load it.
+    bool loadedFromCache = LoadPreComputeCache(nodes);
+    if (m_mpi != nullptr && m_mpi->NumNodesInUse() > 1)
+    {
+        int numLoaded = loadedFromCache ? 1 : 0;
+        m_mpi->AllReduce(&numLoaded, 1);
+        loadedFromCache = numLoaded == (int)m_mpi->NumNodesInUse();
+    }
+    if (loadedFromCache)
+        return true;
+
+    // With several workers, each accumulates statistics over its share of the data and the accumulators are merged
+    // at the end, instead of every worker running over all data.
+    bool isParallel = m_parallelPreCompute && m_mpi != nullptr && m_mpi->NumNodesInUse() > 1 &&
+                      all_of(nodes.begin(), nodes.end(), [](const ComputationNodeBasePtr& node) { return node->Is<IMergeablePreComputeNode>(); });
+    bool useDistributedMBReading = isParallel && trainSetDataReader->SupportsDistributedMBRead();
+    if (isParallel)
+        LOGPRINTF(stderr, "Precomputing --> Splitting the pass over %d workers (%s).\n",
+                  (int)m_mpi->NumNodesInUse(), useDistributedMBReading ? "distributed reading" : "each worker decimates the minibatches");
+
     // trainSetDataReader->StartMinibatchLoop(m_mbSize[0],  0 , requestDataSize);
     // trainSetDataReader->StartMinibatchLoop(m_mbSize[0],  0 , m_epochSize); // only based on one epoch
     // To support large dataset, we usually partition whole dataset into several epoch's,
     // so we need to use all the data to do precomputing
-    if (m_useAllDataForPreComputedNode) // using all the data
-        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, inputMatrices->GetStreamDescriptions());
-    else // using only one epoch. Note: One epoch is often enough for feature mean/stddev, but not for estimating priors.
-        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, inputMatrices->GetStreamDescriptions(), m_epochSize);
+    // Note: One epoch is often enough for feature mean/stddev, but not for estimating priors.
+    size_t requestedEpochSamples = m_useAllDataForPreComputedNode ? requestDataSize : m_epochSize;
+    if (useDistributedMBReading)
+        trainSetDataReader->StartDistributedMinibatchLoop(m_mbSize[0], 0, m_mpi->CurrentNodeRank(), m_mpi->NumNodesInUse(), inputMatrices->GetStreamDescriptions(), requestedEpochSamples);
+    else
+        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, inputMatrices->GetStreamDescriptions(), requestedEpochSamples);
     net->StartEvaluateMinibatchLoop(nodes);
 
     // initialize
@@ -1828,7 +1971,7 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
     const size_t numIterationsBeforePrintingProgress = 100;
     size_t numItersSinceLastPrintOfProgress = 0;
     size_t actualMBSizeDummy;
-    while (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, nullptr, false, false, *inputMatrices, actualMBSizeDummy, m_mpi))
+    while (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, nullptr, useDistributedMBReading, isParallel, *inputMatrices, actualMBSizeDummy, m_mpi))
     {
         // TODO: move these into GetMinibatchIntoNetwork()  --but those are passed around; necessary? Can't we get them from 'net'?
         ComputationNetwork::BumpEvalTimeStamp(featureNodes);
@@ -1839,10 +1982,15 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
         numItersSinceLastPrintOfProgress = ProgressTracing::TraceFakeProgress(numIterationsBeforePrintingProgress, numItersSinceLastPrintOfProgress);
     }
 
+    if (isParallel)
+        AggregatePreComputeAccumulators(m_mpi, nodes);
+
     // finalize
     for (auto & node : nodes)
         dynamic_pointer_cast<IPreComputeNode>(node)->MarkComputed(true /*done accumulating*/);
 
+    SavePreComputeCache(nodes);
+
     fprintf(stderr, "\n");
     LOGPRINTF(stderr, "Precomputing --> Completed.\n\n");
 
@@ -1885,6 +2033,7 @@ double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
     }
 
     int baseModelEpoch = epochNumber - 1;
+    WaitForPendingCheckpoint();
     net->RereadPersistableParameters<ElemType>(GetModelNameForEpoch(baseModelEpoch));
 
     double learnRate = learnRatePerSample;
@@ -1899,6 +2048,18 @@ double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
                        /*out*/ prevCriterion,
                        /*out*/ dummyMinibatchSize);
 
+    // all trials start from this state; keep it in memory instead of reading the files again after each trial
+    TrainingStateSnapshot snapshot;
+    TakeTrainingStateSnapshot(net, smoothedGradients, snapshot);
+
+    // all trials also read the same samples, so read them only once unless the reader has to see the network output
+    unique_ptr<DataReaderHelpers::MinibatchReplayReader<ElemType>> replayReader;
+    if (m_replaySearchMinibatches && criterionNodes[0]->OperationName() != L"SequenceWithSoftmax")
+    {
+        replayReader.reset(new DataReaderHelpers::MinibatchReplayReader<ElemType>(trainSetDataReader));
+        trainSetDataReader = replayReader.get();
+    }
+
     // if model is not changed this is what we will get
     EpochCriterion baseCriterion;
     vector<EpochCriterion> epochEvalErrors(evaluationNodes.size(), EpochCriterion::Infinity()); // these are ignored in this entire method
@@ -1910,7 +2071,7 @@ double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
                                     smoothedGradients, smoothedCounts,
                                     /*out*/ baseCriterion, /*out*/ epochEvalErrors,
                                     "BaseAdaptiveLearnRateSearch:",
-                                    numFramesToUseInSearch);
+                                    numFramesToUseInSearch, snapshot);
 
     if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::SearchBeforeEpoch)
     {
@@ -1938,7 +2099,7 @@ double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
                                         learnableNodes, smoothedGradients, smoothedCounts,
                                         /*out*/ epochCriterion, /*out*/ epochEvalErrors,
                                         "AdaptiveLearnRateSearch:",
-                                        numFramesToUseInSearch);
+                                        numFramesToUseInSearch, snapshot);
     } while (epochCriterion.IsNan() || (epochCriterion.Average() > baseCriterion.Average() && learnRatePerSample > minLearnRate));
 
     bestLearnRatePerSample = learnRatePerSample;
@@ -1960,7 +2121,7 @@ double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
                                         smoothedGradients, smoothedCounts,
                                         /*out*/ leftCriterion, /*out*/ epochEvalErrors,
                                         "DetailBaseAdaptiveLearnRateSearch:",
-                                        numFramesToUseInSearch);
+                                        numFramesToUseInSearch, snapshot);
 
         while (rightLearnRatePerSample > leftLearnRatePerSample * 1.2)
         {
@@ -1982,7 +2143,7 @@ double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
                                                 /*out*/ rightCriterion,
                                                 /*out*/ epochEvalErrors,
                                                 "DetailRightAdaptiveLearnRateSearch:",
-                                                numFramesToUseInSearch);
+                                                numFramesToUseInSearch, snapshot);
             }
             else
             {
@@ -2002,7 +2163,7 @@ double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
                                                 /*out*/ leftCriterion,
                                                 /*out*/ epochEvalErrors,
                                                 "DetailLeftAdaptiveLearnRateSearch:",
-                                                numFramesToUseInSearch);
+                                                numFramesToUseInSearch, snapshot);
             }
         }
 
@@ -2156,6 +2317,26 @@ size_t SGD<ElemType>::SearchForBestMinibatchSize(ComputationNetworkPtr net,
     LOGPRINTF(stderr, " AdaptiveMinibatchSearch Epoch[%d]: Evaluating minibatchSizes %d..%d\n",
         (int)epochNumber + 1, (int)RoundToMultipleOf64(minMinibatchSize), (int)RoundToMultipleOf64(maxMinibatchSize));
 
+    // all trials start from the model of the previous epoch; read it once and keep it in memory
+    int baseModelEpoch = epochNumber - 1;
+    WaitForPendingCheckpoint();
+    net->RereadPersistableParameters<ElemType>(GetModelNameForEpoch(baseModelEpoch));
+
+    double dummyLearnRate;
+    double dummyPrevCriterion;
+    size_t dummyTotalTrainingSamplesSeen; // (not used)
+    size_t dummyMinibatchSize;
+    LoadCheckPointInfo(baseModelEpoch,
+                       /*out*/ dummyTotalTrainingSamplesSeen,
+                       /*out*/ dummyLearnRate,
+                       smoothedGradients,
+                       smoothedCounts,
+                       /*out*/ dummyPrevCriterion,
+                       /*out*/ dummyMinibatchSize);
+
+    TrainingStateSnapshot snapshot;
+    TakeTrainingStateSnapshot(net, smoothedGradients, snapshot);
+
     size_t lastGoodMinibatchSize = 0;
     EpochCriterion lastGoodEpochCriterion(0);
     for (float trialMinibatchSizeFloat = (float) minMinibatchSize;
@@ -2182,7 +2363,7 @@ size_t SGD<ElemType>::SearchForBestMinibatchSize(ComputationNetworkPtr net,
                                         learnableNodes, smoothedGradients, smoothedCounts,
                                         /*out*/ epochCriterion, /*out*/ epochEvalErrors,
                                         isFirstIteration ? "BaseAdaptiveMinibatchSearch:" : "AdaptiveMinibatchSearch:",
-                                        numFramesToUseInSearch);
+                                        numFramesToUseInSearch, snapshot);
 
         if (isFirstIteration)
         {
@@ -2245,7 +2426,8 @@ void SGD<ElemType>::TrainOneMiniEpochAndReloadModel(ComputationNetworkPtr net,
                                                     /*out*/ EpochCriterion& epochCriterion,
                                                     /*out*/ std::vector<EpochCriterion>& epochEvalErrors,
                                                     std::string prefixMsg,
-                                                    const size_t maxNumOfSamples)
+                                                    const size_t maxNumOfSamples,
+                                                    const TrainingStateSnapshot& snapshot)
 {
     TrainOneEpoch(net, refNet, refNode, epochNumber, epochSize,
                   trainSetDataReader, learnRatePerSample, minibatchSize, featureNodes,
@@ -2261,22 +2443,88 @@ void SGD<ElemType>::TrainOneMiniEpochAndReloadModel(ComputationNetworkPtr net,
     fprintf(stderr, "learningRatePerSample = %.8g; minibatchSize = %d\n", learnRatePerSample, (int)minibatchSize);
 
     // go back to where we came from
-    int baseModelEpoch = epochNumber - 1;
-    let path = GetModelNameForEpoch(baseModelEpoch);
-    //fprintf(stderr, "Reverting parameters back to %ls\n", path.c_str());
-    net->RereadPersistableParameters<ElemType>(path);
+    RestoreTrainingStateSnapshot(net, snapshot, smoothedGradients);
+}
 
-    double dummyLearnRate;
-    double dummyPrevCriterion;
-    size_t dummyTotalTrainingSamplesSeen; // (not used)
-    size_t dummyMinibatchSize;
-    LoadCheckPointInfo(baseModelEpoch,
-                       /*out*/ dummyTotalTrainingSamplesSeen,
-                       /*out*/ dummyLearnRate,
-                       smoothedGradients,
-                       smoothedCounts,
-                       /*out*/ dummyPrevCriterion,
-                       /*out*/ dummyMinibatchSize);
+template <class ElemType>
+static MatrixBasePtr CloneMatrix(const MatrixBasePtr& matrix)
+{
+    auto& M = *dynamic_pointer_cast<Matrix<ElemType>>(matrix);
+    return make_shared<Matrix<ElemType>>(M, M.GetDeviceId()); // deep copy, on the same device
+}
+
+template <class ElemType>
+static void CopyParameterValue(const ComputationNodeBasePtr& node, const MatrixBasePtr& from, /*out*/ MatrixBasePtr* to)
+{
+    auto& value = node->As<ComputationNode<ElemType>>()->Value();
+    if (to)
+        *to = make_shared<Matrix<ElemType>>(value, value.GetDeviceId());
+    else
+    {
+        value.SetValue(*dynamic_pointer_cast<Matrix<ElemType>>(from));
+        node->BumpEvalTimeStamp();
+    }
+}
+
+// copy (to != nullptr) or restore (from != nullptr) the value of a LearnableParameter of any precision
+static void CopyParameterValue(const ComputationNodeBasePtr& node, const MatrixBasePtr& from, /*out*/ MatrixBasePtr* to)
+{
+    if (node->Is<ComputationNode<float>>())
+        CopyParameterValue<float>(node, from, to);
+    else if (node->Is<ComputationNode<double>>())
+        CopyParameterValue<double>(node, from, to);
+    else if (node->Is<ComputationNode<half>>())
+        CopyParameterValue<half>(node, from, to);
+    else
+        LogicError("Unexpected node type.");
+}
+
+template <class ElemType>
+void SGD<ElemType>::TakeTrainingStateSnapshot(ComputationNetworkPtr net, const std::list<MatrixBasePtr>& smoothedGradients, /*out*/ TrainingStateSnapshot& snapshot)
+{
+    snapshot = TrainingStateSnapshot();
+    for (const auto& node : net->GetNodesWithType(OperationNameOf(LearnableParameter)))
+        CopyParameterValue(node, nullptr, &snapshot.m_parameters[node->NodeName()]);
+
+    for (const auto& node : net->GetAllNodes())
+    {
+        if (auto stateNode = dynamic_pointer_cast<ITrainingStateNode>(node))
+            snapshot.m_nodeStates[node->NodeName()] = stateNode->GetTrainingState();
+        if (auto rngUser = dynamic_pointer_cast<RngUser>(node))
+            snapshot.m_rngStates[node->NodeName()] = make_pair(rngUser->GetRngSeed(), rngUser->GetRngOffset());
+    }
+
+    // For half parameters, the smoothed gradients are float
+    for (const auto& smoothedGradient : smoothedGradients)
+    {
+        if (std::is_same<ElemType, half>())
+            snapshot.m_smoothedGradients.push_back(CloneMatrix<float>(smoothedGradient));
+        else
+            snapshot.m_smoothedGradients.push_back(CloneMatrix<ElemType>(smoothedGradient));
+    }
+}
+
+template <class ElemType>
+void SGD<ElemType>::RestoreTrainingStateSnapshot(ComputationNetworkPtr net, const TrainingStateSnapshot& snapshot, std::list<MatrixBasePtr>& smoothedGradients)
+{
+    for (const auto& iter : snapshot.m_parameters)
+        CopyParameterValue(net->GetNodeFromName(iter.first), iter.second, nullptr);
+    for (const auto& iter : snapshot.m_nodeStates)
+        dynamic_pointer_cast<ITrainingStateNode>(net->GetNodeFromName(iter.first))->SetTrainingState(iter.second);
+    for (const auto& iter : snapshot.m_rngStates)
+        dynamic_pointer_cast<RngUser>(net->GetNodeFromName(iter.first))->SetRngState(iter.second.first, iter.second.second);
+
+    if (smoothedGradients.size() != snapshot.m_smoothedGradients.size())
+        LogicError("RestoreTrainingStateSnapshot: Number of smoothed gradients does not match the snapshot.");
+    auto snapshotIter = snapshot.m_smoothedGradients.begin();
+    for (auto& smoothedGradient : smoothedGradients)
+    {
+        if (std::is_same<ElemType, half>())
+            dynamic_pointer_cast<Matrix<float>>(smoothedGradient)->SetValue(*dynamic_pointer_cast<Matrix<float>>(*snapshotIter));
+        else
+            dynamic_pointer_cast<Matrix<ElemType>>(smoothedGradient)->SetValue(*dynamic_pointer_cast<Matrix<ElemType>>(*snapshotIter));
+        ++snapshotIter;
+    }
 }
 
 // Attempts to compute the error signal for the whole utterance, which will
@@ -2373,13 +2621,15 @@ shared_ptr<IMASGD<half>> _GetBlockMomentumSGD<half>(const MPIWrapperPtr& mpi, si
 }
 
 template <class ElemType>
-shared_ptr<IMASGD<ElemType>> _GetBasicModelAveragingSGD(const MPIWrapperPtr& mpi, size_t traceLevel, DEVICEID_TYPE devID)
+shared_ptr<IMASGD<ElemType>> _GetBasicModelAveragingSGD(const MPIWrapperPtr& mpi, size_t traceLevel, DEVICEID_TYPE devID, bool overlapCommunication)
 {
+    if (overlapCommunication)
+        return make_shared<OverlappedModelAveragingSGD<ElemType>>(mpi, traceLevel, devID);
     return make_shared<BasicModelAveragingSGD<ElemType>>(mpi, traceLevel, devID);
 }
 
 template <>
-shared_ptr<IMASGD<half>> _GetBasicModelAveragingSGD<half>(const MPIWrapperPtr& mpi, size_t traceLevel, DEVICEID_TYPE devID)
+shared_ptr<IMASGD<half>> _GetBasicModelAveragingSGD<half>(const MPIWrapperPtr& mpi, size_t traceLevel, DEVICEID_TYPE devID, bool overlapCommunication)
 {
     RuntimeError("SGD - half not supported for modelAveragingSGD");
 }
@@ -2393,7 +2643,7 @@ void SGD<ElemType>::InitModelAggregationHandler(int traceLevel, DEVICEID_TYPE de
     }
     if (GetParallelizationMethod() == ParallelizationMethod::modelAveragingSGD)
     {
-        m_pMASGDHelper = _GetBasicModelAveragingSGD<ElemType>(m_mpi, traceLevel, devID);
+        m_pMASGDHelper = _GetBasicModelAveragingSGD<ElemType>(m_mpi, traceLevel, devID, m_overlapModelAveraging);
     }
     else if (GetParallelizationMethod() == ParallelizationMethod::blockMomentumSGD)
     {
@@ -2622,81 +2872,177 @@ static void LoadSmoothedGradient(File& fstream, MatrixBasePtr& smoothedGradient)
     fstream >> smoothedGradientValues;
 }
 
+// Copies a smoothed gradient to the CPU, so that it can be written while training keeps updating the original.
+template <class ElemType>
+static MatrixBasePtr SnapshotSmoothedGradient(const MatrixBasePtr& smoothedGradient)
+{
+    auto smoothedGradientPtr = dynamic_pointer_cast<Matrix<ElemType>> (smoothedGradient);
+    if (!smoothedGradientPtr)
+        RuntimeError("Failed to cast, type mismatch");
+    auto snapshot = make_shared<Matrix<ElemType>>(smoothedGradientPtr->DeepClone());
+    snapshot->TransferToDeviceIfNotThere(CPUDEVICE, /*isBeingMoved=*/true);
+    return snapshot;
+}
+
 template <class ElemType>
 void SGD<ElemType>::SaveCheckPointInfo(const size_t epoch, const size_t totalSamplesSeen,
                                        const double learnRatePerSample,
                                        const std::list<MatrixBasePtr>& smoothedGradients,
                                        const std::vector<double>& smoothedCounts,
                                        const double prevCriterion,
-                                       const size_t minibatchSize)
+                                       const size_t minibatchSize,
+                                       const ComputationNetworkPtr& net)
 {
     // In case of parallel training only the main node should be saving the checkpoint to prevent
     // the parallel training nodes from colliding to write the same file
-    if ((m_mpi == nullptr) || m_mpi->IsMainNode())
+    if ((m_mpi != nullptr) && !m_mpi->IsMainNode())
+        return;
+
+    wstring checkPointFileName = GetCheckPointFileNameForEpoch(int(epoch));
+    wstring modelName = GetModelNameForEpoch(int(epoch));
+
+    // The model averaging state is written straight from the helper, so it cannot be deferred.
+    if (!m_asyncCheckpointing || m_pMASGDHelper)
     {
-        wstring checkPointFileName = GetCheckPointFileNameForEpoch(int(epoch));
-        // Saving into temporary file and then renaming it to the checkPointFileName
-        // This is a standard trick to avoid havign corrupted checkpoints files if process dies during writing
-        wstring tempFileName = checkPointFileName + L".tmp";
+        WriteCheckPointInfo(checkPointFileName, totalSamplesSeen, learnRatePerSample, smoothedGradients, smoothedCounts,
+                            m_criteriaBestEpoch, prevCriterion, minibatchSize, /*flushToDisk=*/false);
+        if (net)
+            net->Save(modelName);
+        return;
+    }
 
-        {
-            File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
-            // Buffer writes in memory then flush to filesystem, which reduces number of small writes
-            fstream.Setvbuf();
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BVersion"); 
-            fstream << (size_t)CURRENT_CNTK_CHECKPOINT_VERSION; 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EVersion");
+    // A new snapshot is only taken after the previous checkpoint has been written.
+    auto start = std::chrono::steady_clock::now();
+    FinishPendingCheckpoint();
+
+    std::list<MatrixBasePtr> smoothedGradientSnapshots;
+    for (const auto& smoothedGradient : smoothedGradients)
+    {
+        if (std::is_same<ElemType, half>())
+            smoothedGradientSnapshots.push_back(SnapshotSmoothedGradient<float>(smoothedGradient));
+        else
+            smoothedGradientSnapshots.push_back(SnapshotSmoothedGradient<ElemType>(smoothedGradient));
+    }
+    // Everything the background thread writes is copied to the CPU here, so that it neither sees the updates
+    // of the next minibatches nor needs the device.
+    ComputationNetwork::ModelSnapshot modelSnapshot;
+    if (net)
+        modelSnapshot = net->SnapshotForSave();
+
+    auto criteriaBestEpoch = m_criteriaBestEpoch;
+    DEVICEID_TYPE deviceId = net ? net->GetDeviceId() : CPUDEVICE;
+    m_pendingCheckpoint = std::async(std::launch::async,
+        [this, net, deviceId, checkPointFileName, modelName, totalSamplesSeen, learnRatePerSample, smoothedGradientSnapshots,
+         smoothedCounts, criteriaBestEpoch, prevCriterion, minibatchSize, modelSnapshot]()
+        {
+            // (the current device is per thread; any matrix this thread creates must go to the training device)
+            Matrix<ElemType>::SetDevice(deviceId);
+            WriteCheckPointInfo(checkPointFileName, totalSamplesSeen, learnRatePerSample, smoothedGradientSnapshots, smoothedCounts,
+                                criteriaBestEpoch, prevCriterion, minibatchSize, /*flushToDisk=*/true);
+            if (net)
+                net->SaveSnapshot(modelName, modelSnapshot);
+        });
+
+    double blockedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    m_checkpointBlockedSeconds += blockedSeconds;
+    if (m_traceLevel > 0)
+        LOGPRINTF(stderr, "SGD: Checkpoint for epoch %d blocked training for %.3f seconds (%.3f seconds in total).\n",
+                  (int)epoch + 1, blockedSeconds, m_checkpointBlockedSeconds); // report 1 based epoch number
+}
+
+template <class ElemType>
+void SGD<ElemType>::WriteCheckPointInfo(const wstring& checkPointFileName, const size_t totalSamplesSeen,
+                                        const double learnRatePerSample,
+                                        const std::list<MatrixBasePtr>& smoothedGradients,
+                                        const std::vector<double>& smoothedCounts,
+                                        const std::map<std::wstring, BestEpoch>& criteriaBestEpoch,
+                                        const double prevCriterion,
+                                        const size_t minibatchSize,
+                                        bool flushToDisk)
+{
+    // Saving into temporary file and then renaming it to the checkPointFileName
+    // This is a standard trick to avoid havign corrupted checkpoints files if process dies during writing
+    wstring tempFileName = checkPointFileName + L".tmp";
 
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCKP");
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BLearnRate");
-            fstream << totalSamplesSeen << learnRatePerSample << prevCriterion;
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ELearnRate");
+    {
+        File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+        // Buffer writes in memory then flush to filesystem, which reduces number of small writes
+        fstream.Setvbuf();
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BVersion"); 
+        fstream << (size_t)CURRENT_CNTK_CHECKPOINT_VERSION; 
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EVersion");
 
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BMinibatchSize");
-            fstream << minibatchSize;
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EMinibatchSize");
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCKP");
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BLearnRate");
+        fstream << totalSamplesSeen << learnRatePerSample << prevCriterion;
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ELearnRate");
 
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BMinibatchSize");
+        fstream << minibatchSize;
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EMinibatchSize");
 
-            for (auto smoothedGradient : smoothedGradients)
-            {
-                if (std::is_same<ElemType, half>())
-                    SaveSmoothedGradient<float>(fstream, smoothedGradient);
-                else
-                    SaveSmoothedGradient<ElemType>(fstream, smoothedGradient);
-            }
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EGradient");
+        for (auto smoothedGradient : smoothedGradients)
+        {
+            if (std::is_same<ElemType, half>())
+                SaveSmoothedGradient<float>(fstream, smoothedGradient);
+            else
+                SaveSmoothedGradient<ElemType>(fstream, smoothedGradient);
+        }
 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"BCount");
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EGradient");
 
-            for (auto sc : smoothedCounts)
-                fstream << sc;
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"BCount");
 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECount");
+        for (auto sc : smoothedCounts)
+            fstream << sc;
 
-            if (m_saveBestModelPerCriterion)
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECount");
+
+        if (m_saveBestModelPerCriterion)
+        {
+            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCriteria");
+            const int32_t criteriaSize = static_cast<int32_t>(criteriaBestEpoch.size());
+            fstream << criteriaSize;
+            for (const auto& criterion : criteriaBestEpoch)
             {
-                fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCriteria");
-                const int32_t criteriaSize = static_cast<int32_t>(m_criteriaBestEpoch.size());
-                fstream << criteriaSize;
-                for (const auto& criterion : m_criteriaBestEpoch)
-                {
-                    fstream << criterion.second.criterionMinValue << criterion.second.epochIndex;
-                }
-                fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECriteria");
+                fstream << criterion.second.criterionMinValue << criterion.second.epochIndex;
             }
-
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECKP");
-            if (m_pMASGDHelper)
-                m_pMASGDHelper->SaveToCheckPoint(fstream);
-            // Ensuring that data is written
-            fstream.Flush();
+            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECriteria");
         }
 
-        _wunlink(checkPointFileName.c_str());
-        renameOrDie(tempFileName, checkPointFileName);
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECKP");
+        if (m_pMASGDHelper)
+            m_pMASGDHelper->SaveToCheckPoint(fstream);
+        // Ensuring that data is written
+        fstream.Flush();
     }
+
+    if (flushToDisk)
+        fsyncOrDie(tempFileName);
+
+    _wunlink(checkPointFileName.c_str());
+    renameOrDie(tempFileName, checkPointFileName);
+}
+
+template <class ElemType>
+void SGD<ElemType>::FinishPendingCheckpoint()
+{
+    // get() rethrows any error raised by the background write.
+    if (m_pendingCheckpoint.valid())
+        m_pendingCheckpoint.get();
+}
+
+template <class ElemType>
+void SGD<ElemType>::WaitForPendingCheckpoint()
+{
+    if (!m_asyncCheckpointing)
+        return;
+
+    FinishPendingCheckpoint();
+    // other workers must not read the files before the main node has written them
+    SynchronizeWorkers();
 }
 
 template <class ElemType>
@@ -3028,7 +3374,6 @@ static LearningRateSearchAlgorithm ParseLearningRateSearchType(const wstring& s)
     else InvalidArgument("autoAdjustLR: Invalid learning rate search type. Valid values are (none | searchBeforeEpoch | adjustAfterEpoch)");
 }
   
-#ifdef ASGD_PARALLEL_SUPPORT
 static AdjustLearningRateAtBeginning AdjustLearningRateAtBeginningType(const wstring& s)
 {
     if      (EqualCI(s.c_str(), L"") || EqualCI(s.c_str(), L"none")) return AdjustLearningRateAtBeginning::None;
@@ -3036,7 +3381,6 @@ static AdjustLearningRateAtBeginning AdjustLearningRateAtBeginningType(const wst
     else if (EqualCI(s.c_str(), L"staircase"))                       return AdjustLearningRateAtBeginning::Staircase;
     else InvalidArgument("AdjustLearningRateatBeginningType: Invalid Type. Valid values are (None | Linearly | Staircase)");
 }
-#endif
 
 template<class ConfigRecordType>
 SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
@@ -3066,6 +3410,7 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
 
     m_numPrevLearnRates = configAALR(L"numPrevLearnRates", (size_t) 5);
     m_numBestSearchEpoch = configAALR(L"numBestSearchEpoch", (size_t) 1);
+    m_replaySearchMinibatches = configAALR(L"replaySearchMinibatches", true);
     m_loadBestModel = configAALR(L"loadBestModel", true);
     m_useCVSetControlLRIfCVExists = configAALR(L"UseCVSetControlLRIfCVExists", true);
     m_useEvalCriterionControlLR = configAALR(L"UseEvalCriterionControlLR", false);
@@ -3135,6 +3480,10 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     // Setting this to any other value (n) will log average loss/eval metric for each n minibatches.
     m_tensorBoardNumMBsToLogResult = configSGD(L"tensorBoardNumMBsToLogResult", m_numMBsToShowResult);
 
+    // Per-node cost report. If not empty, nodes are timed, and after each epoch <nodeCostReport>.epoch<N>.csv/.json
+    // list the time, estimated FLOPs and bytes of every node, classified against the measured peak of the device.
+    m_nodeCostReport = static_cast<std::wstring>(configSGD(L"nodeCostReport", L""));
+
     m_gradientClippingWithTruncation = configSGD(L"gradientClippingWithTruncation", true);
     m_clippingThresholdPerSample = configSGD(L"clippingThresholdPerSample", numeric_limits<double>::infinity());
 
@@ -3194,6 +3543,8 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     }
 
     m_useAllDataForPreComputedNode = configSGD(L"UseAllDataForPreComputedNode", true);
+    m_parallelPreCompute = configSGD(L"parallelPreCompute", false);
+    m_preComputeCache = static_cast<std::wstring>(configSGD(L"preComputeCache", L""));
 
     // consistency checks
     for (size_t i = 0; i < m_mbSize.size(); i++)
@@ -3299,6 +3650,15 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_enableDistributedMBReading = false;
     m_parallelizationStartEpochNum = 0;
     m_modelAggregationBlockSize = 0; 
+    m_overlapModelAveraging = false;
+    m_isAsyncBufferEnabled = false;
+    m_isSimulateMA = false;
+    m_adjustLearningRateAtBeginning = AdjustLearningRateAtBeginning::None;
+    m_adjustCoefficient = 0.1;
+    m_adjustPerMinibatches = 256;
+    m_numParameterServerShards = 16;
+    m_pushesPerPull = 1;
+    m_delayCompensation = 0;
 
     if (configSGD.Exists(L"ParallelTrain"))
     {
@@ -3355,6 +3715,7 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
             }
             else
                 m_modelAggregationBlockSize = 40000 * numMPIWorkers;    // default value 
+            m_overlapModelAveraging = configMASGD(L"overlapCommunication", false); // average asynchronously, merging the result one block later
 #if 1           // legacy option 
             if (configMASGD.Exists(L"syncFrequencyInFrames"))
             {
@@ -3430,9 +3791,6 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
 
         if (configParallelTrain.Exists(L"DataParallelASGD"))
         {
-#ifndef ASGD_PARALLEL_SUPPORT
-            InvalidArgument("DataParallelASGD is not enabled in this version.\n");
-#else
             const ConfigRecordType & configDataParallelASGD(configParallelTrain(L"DataParallelASGD", ConfigRecordType::Record()));
             m_nSyncSamplesPerWorker = configDataParallelASGD(L"syncPeriodPerWorker", ConfigRecordType::Array(intargvector(vector<int>{256})));
 #if 1       // legacy option
@@ -3453,6 +3811,13 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
                 m_adjustCoefficient = configAdjustLearningRateAtBeginning(L"adjustCoefficient", (double)0.1);
                 m_adjustPerMinibatches = configAdjustLearningRateAtBeginning(L"adjustPerMinibatches", (size_t)256);
             }
+#ifndef ASGD_PARALLEL_SUPPORT
+            // without Multiverso, the model is kept in shared memory by the worker processes of one machine
+            m_numParameterServerShards = configDataParallelASGD(L"numShards", (size_t)16);
+            m_pushesPerPull = configDataParallelASGD(L"pushesPerPull", (size_t)1);     // >1: continue with the local model between pulls
+            m_delayCompensation = configDataParallelASGD(L"delayCompensation", 0.0);  // correct deltas for the model change since their computation (DC-ASGD); needs pushesPerPull = 1
+            if (m_numParameterServerShards == 0 || m_pushesPerPull == 0)
+                InvalidArgument("DataParallelASGD: numShards and pushesPerPull must be at least 1.");
 #endif
         }
         } // if (!pMPI)
@@ -16,6 +16,7 @@
 #include "fileutil.h"
 #include "Config.h"
 #include <chrono>
+#include <future>
 #include <random>
 #include "Profiler.h"
 #include "MASGD.h"
@@ -230,6 +231,7 @@ protected:
 
     intargvector m_numSamples4Search;
     size_t m_numBestSearchEpoch;
+    bool m_replaySearchMinibatches; // LR search: read the search samples once and replay them for each trial
 
     // Threshold size in bytes for single gradient to do packing
     size_t m_packThresholdSizeInBytes;
@@ -280,12 +282,16 @@ protected:
     std::wstring m_tensorBoardLogDir;
     size_t m_tensorBoardNumMBsToLogResult;
 
+    std::wstring m_nodeCostReport; // file name prefix of the per-epoch node cost report; enables node timing
+
     bool m_doGradientCheck;
     double m_gradientCheckSigDigit;
 
     bool m_doUnitTest;
 
     bool m_useAllDataForPreComputedNode;
+    bool m_parallelPreCompute;       // split the precomputation pass over the MPI ranks and merge their accumulators (off by default, results differ in rounding)
+    std::wstring m_preComputeCache;  // directory to keep precomputed node values in, keyed by the data configuration
 
     // Parallel training
     MPIWrapperPtr m_mpi;
@@ -314,6 +320,7 @@ protected:
 
     // Parallel training related with MA / BM
     size_t m_modelAggregationBlockSize;
+    bool   m_overlapModelAveraging;
     bool   m_resetSGDMomentum; 
     bool   m_useNesterovBlockMomentum;
     double m_blockLearningRate; 
@@ -330,6 +337,9 @@ protected:
     AdjustLearningRateAtBeginning m_adjustLearningRateAtBeginning;
     double m_adjustCoefficient;
     size_t m_adjustPerMinibatches;
+    size_t m_numParameterServerShards;   // shared-memory parameter server only
+    size_t m_pushesPerPull;
+    double m_delayCompensation;
 
     // sequence training
     double m_hSmoothingWeight;
@@ -373,6 +383,8 @@ public:
           // TODO: The next few do not belong into SGD any more than the network or reader we operate on. Either move network and reader in here, or move these out.
           m_modelPath((const wstring&) configSGD(L"modelPath")),
           m_keepCheckPointFiles(configSGD(L"keepCheckPointFiles", false)),
+          m_asyncCheckpointing(configSGD(L"asyncCheckpointing", false)),
+          m_checkpointBlockedSeconds(0.0),
           m_saveBestModelPerCriterion(configSGD(L"saveBestModelPerCriterion", false)),
           m_trainCriterionNodeName((const wstring&) configSGD(L"trainCriterionNodeName", L"")),
           m_evalCriterionNodeName ((const wstring&) configSGD(L"evalCriterionNodeName", L"")),
@@ -402,6 +414,12 @@ public:
             m_parallelizationMethod = ParallelizationMethod::none;
         }
 
+    // text that identifies the training data (the reader configuration), for keying m_preComputeCache
+    void SetDataConfigKey(const std::wstring& dataConfigKey)
+    {
+        m_dataConfigKey = dataConfigKey;
+    }
+
     void Train(shared_ptr<ComputationNetwork> net, DEVICEID_TYPE deviceId,
                IDataReader* trainSetDataReader,
                IDataReader* validationSetDataReader, int startEpoch, bool loadNetworkFromCheckpoint);
@@ -431,6 +449,12 @@ protected:
                     const std::vector<ComputationNodeBasePtr>& labelNodes,
                     StreamMinibatchInputs* inputMatrices);
 
+    // precomputed values persisted by PreCompute(), see m_preComputeCache
+    std::wstring GetPreComputeCacheKey(const std::list<ComputationNodeBasePtr>& nodes) const;
+    std::wstring GetPreComputeCachePath(const std::wstring& key) const;
+    bool LoadPreComputeCache(const std::list<ComputationNodeBasePtr>& nodes);
+    void SavePreComputeCache(const std::list<ComputationNodeBasePtr>& nodes) const;
+
     // return a reasonable initial learning rate based on the initial mbsize
     double SearchForBestLearnRate(ComputationNetworkPtr net,
                                   ComputationNetworkPtr refNet,
@@ -447,6 +471,20 @@ protected:
                                   const bool learnRateInitialized,
                                   const double largestPrevLearnRatePerSample);
 
+    // In-memory copy of everything a mini-epoch of the LR/MB-size search changes, so that trials can be undone
+    // without reading the model and checkpoint files again: parameter values, node training state
+    // (e.g. BatchNormalization run counts), RNG states and the smoothed gradients.
+    struct TrainingStateSnapshot
+    {
+        std::map<std::wstring, MatrixBasePtr> m_parameters;
+        std::map<std::wstring, std::vector<size_t>> m_nodeStates;
+        std::map<std::wstring, std::pair<uint64_t, uint64_t>> m_rngStates; // seed, offset
+        std::list<MatrixBasePtr> m_smoothedGradients;
+    };
+
+    void TakeTrainingStateSnapshot(ComputationNetworkPtr net, const std::list<MatrixBasePtr>& smoothedGradients, /*out*/ TrainingStateSnapshot& snapshot);
+    void RestoreTrainingStateSnapshot(ComputationNetworkPtr net, const TrainingStateSnapshot& snapshot, std::list<MatrixBasePtr>& smoothedGradients);
+
     void TrainOneMiniEpochAndReloadModel(ComputationNetworkPtr net,
                                          ComputationNetworkPtr refNet,
                                          const ComputationNodeBasePtr& refNode, const int epochNumber,
@@ -463,7 +501,8 @@ protected:
                                          /*out*/ EpochCriterion& epochCriterion,
                                          /*out*/ std::vector<EpochCriterion>& epochEvalErrors,
                                          std::string prefixMsg,
-                                         const size_t maxNumOfSamples);
+                                         const size_t maxNumOfSamples,
+                                         const TrainingStateSnapshot& snapshot);
 
     size_t AdaptiveMinibatchSizing(ComputationNetworkPtr net,
                                    ComputationNetworkPtr refNet,
@@ -563,12 +602,27 @@ protected:
     template<class ElemType2 = ElemType>
     void ClipGradient(Matrix<ElemType2>& gradient, const size_t actualMBSize) const;
 
+    // If 'net' is given, the model for 'epoch' is saved as well. With asyncCheckpointing both are written on a background thread.
     void SaveCheckPointInfo(const size_t epoch, const size_t totalSamplesSeen, // TODO: combine totalSamplesSeen and prevCriterion into a EpochCriterion type
                             const double learnRatePerSample,
                             const std::list<MatrixBasePtr>& smoothedGradients,
                             const std::vector<double>& smoothedCounts,
                             const double prevCriterion,
-                            const size_t minibatchSize);
+                            const size_t minibatchSize,
+                            const ComputationNetworkPtr& net = nullptr);
+    void WriteCheckPointInfo(const wstring& checkPointFileName, const size_t totalSamplesSeen,
+                             const double learnRatePerSample,
+                             const std::list<MatrixBasePtr>& smoothedGradients,
+                             const std::vector<double>& smoothedCounts,
+                             const std::map<std::wstring, BestEpoch>& criteriaBestEpoch,
+                             const double prevCriterion,
+                             const size_t minibatchSize,
+                             bool flushToDisk);
+
+    // Blocks until the checkpoint being written in the background (if any) is on disk.
+    // The first version only waits locally; the second also synchronizes all workers, so must be called by all of them.
+    void FinishPendingCheckpoint();
+    void WaitForPendingCheckpoint();
 
     bool TryLoadCheckPointInfo(const size_t epochNumber,
                                /*out*/ size_t& totalSamplesSeen,
@@ -606,7 +660,11 @@ public:
 
 protected:
     std::wstring m_modelPath;
+    std::wstring m_dataConfigKey;
     bool m_keepCheckPointFiles;
+    bool m_asyncCheckpointing;
+    std::future<void> m_pendingCheckpoint; // background write of the last checkpoint when m_asyncCheckpointing
+    double m_checkpointBlockedSeconds;     // time the training loop spent blocked on checkpoints
     bool m_saveBestModelPerCriterion;
     // Mapping from criterion to the best epoch on validation data set.
     std::map<std::wstring, BestEpoch> m_criteriaBestEpoch;
@@ -0,0 +1,283 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// SharedMemoryParameterServer.h -- parameter server for asynchronous SGD among the worker processes of one machine
+//
+
+#pragma once
+
+#include "Basics.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "Windows.h"
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// SharedMemorySegment -- named memory region that several processes map at the same time.
+// One process creates it, the others attach to it by name. The memory is zero-initialized.
+// Creating it replaces a leftover segment of the same name, so names should be unique to the creating process.
+// -----------------------------------------------------------------------
+
+class SharedMemorySegment
+{
+    // no-copying
+    SharedMemorySegment(const SharedMemorySegment&);
+    void operator=(const SharedMemorySegment&);
+
+    std::string m_name;
+    size_t m_size;
+    void* m_data;
+#ifdef _WIN32
+    HANDLE m_handle;
+#else
+    std::string m_fileName;
+#endif
+
+public:
+#ifdef _WIN32 // --- Windows version
+
+    SharedMemorySegment(const std::string& name, size_t size, bool create)
+        : m_name("Local\\" + name), m_size(size), m_data(nullptr), m_handle(NULL)
+    {
+        if (create)
+            m_handle = ::CreateFileMappingA(INVALID_HANDLE_VALUE, NULL /*security attr*/, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, m_name.c_str());
+        else
+            m_handle = ::OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE /*bInheritHandle*/, m_name.c_str());
+        if (m_handle == NULL)
+            RuntimeError("SharedMemorySegment: Failed to %s shared memory %s: %d.", create ? "create" : "open", m_name.c_str(), (int)::GetLastError());
+        m_data = ::MapViewOfFile(m_handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+        if (m_data == nullptr)
+        {
+            int error = (int)::GetLastError();
+            ::CloseHandle(m_handle);
+            RuntimeError("SharedMemorySegment: Failed to map shared memory %s: %d.", m_name.c_str(), error);
+        }
+    }
+
+    ~SharedMemorySegment()
+    {
+        ::UnmapViewOfFile(m_data);
+        ::CloseHandle(m_handle);
+    }
+
+    // the mapping disappears with its last handle
+    void Unlink() { }
+
+#else // --- Linux version
+
+    SharedMemorySegment(const std::string& name, size_t size, bool create)
+        : m_name(name), m_size(size), m_data(nullptr), m_fileName("/dev/shm/" + name)
+    {
+        // (a file in the tmpfs rather than shm_open(), so that we do not need librt)
+        int fd = open(m_fileName.c_str(), create ? (O_RDWR | O_CREAT | O_EXCL) : O_RDWR, 0600);
+        if (fd < 0 && create && errno == EEXIST) // left behind by a process that died before Unlink()
+        {
+            unlink(m_fileName.c_str());
+            fd = open(m_fileName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        }
+        if (fd < 0)
+            RuntimeError("SharedMemorySegment: Failed to %s shared memory %s: %s.", create ? "create" : "open", m_fileName.c_str(), strerror(errno));
+        if (create && ftruncate(fd, (off_t)size) != 0)
+        {
+            int error = errno;
+            close(fd);
+            unlink(m_fileName.c_str());
+            RuntimeError("SharedMemorySegment: Failed to allocate %d bytes of shared memory %s: %s.", (int)size, m_fileName.c_str(), strerror(error));
+        }
+        void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        int error = errno;
+        close(fd); // (the mapping stays valid)
+        if (data == MAP_FAILED)
+            RuntimeError("SharedMemorySegment: Failed to map shared memory %s: %s.", m_fileName.c_str(), strerror(error));
+        m_data = data;
+    }
+
+    ~SharedMemorySegment()
+    {
+        munmap(m_data, m_size);
+    }
+
+    // remove the name once all processes have attached; the memory is freed when the last process unmaps it
+    void Unlink()
+    {
+        unlink(m_fileName.c_str());
+    }
+
+#endif
+
+    void* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+};
+
+// -----------------------------------------------------------------------
+// SharedMemoryParameterServer -- the global model of asynchronous SGD, kept in shared memory.
+// Instead of sending the model to server processes, each worker applies its updates directly to the
+// shared model. The model is split into shards, each guarded by its own spin lock that lives in the
+// shared memory as well, so that workers only contend when they update the same shard at the same time.
+// Workers start with different shards to make that unlikely.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class SharedMemoryParameterServer
+{
+    struct Header
+    {
+        uint64_t magic;
+        uint64_t modelSize;
+        uint64_t numShards;
+        std::atomic<uint64_t> numPushes;
+    };
+    struct ShardLock
+    {
+        std::atomic<int> locked;
+        char padding[64 - sizeof(std::atomic<int>)]; // one cache line per lock
+    };
+    static const uint64_t s_magic = 0x31766470534d4853ull; // "SHMSpdv1"
+
+    static size_t Align(size_t offset) { return (offset + 63) / 64 * 64; }
+    static size_t LocksOffset()                          { return Align(sizeof(Header)); }
+    static size_t ModelOffset(size_t numShards)          { return Align(LocksOffset() + numShards * sizeof(ShardLock)); }
+    static size_t SegmentSize(size_t modelSize, size_t numShards) { return ModelOffset(numShards) + modelSize * sizeof(ElemType); }
+
+public:
+    // One process creates the server ('create'), all others attach to it by 'name' after that.
+    SharedMemoryParameterServer(const std::string& name, size_t modelSize, size_t numShards, bool create)
+        : m_modelSize(modelSize),
+          m_numShards(std::max<size_t>(1, std::min(numShards, modelSize))),
+          m_segment(name, SegmentSize(modelSize, m_numShards), create)
+    {
+        char* base = (char*)m_segment.Data();
+        m_header = (Header*)base;
+        m_locks = (ShardLock*)(base + LocksOffset());
+        m_model = (ElemType*)(base + ModelOffset(m_numShards));
+        if (create)
+        {
+            m_header->modelSize = modelSize;
+            m_header->numShards = m_numShards;
+            m_header->magic = s_magic;
+        }
+        else if (m_header->magic != s_magic || m_header->modelSize != modelSize || m_header->numShards != m_numShards)
+            RuntimeError("SharedMemoryParameterServer: Shared memory %s does not hold a model of %d elements in %d shards.", name.c_str(), (int)modelSize, (int)m_numShards);
+    }
+
+    // remove the name of the shared memory, after all workers have attached
+    void Unlink() { m_segment.Unlink(); }
+
+    size_t ModelSize() const { return m_modelSize; }
+    size_t NumShards() const { return m_numShards; }
+    size_t NumPushes() const { return (size_t)m_header->numPushes.load(); }
+
+    // set the model; no worker may push at the same time
+    void SetModel(const ElemType* model)
+    {
+        memcpy(m_model, model, m_modelSize * sizeof(ElemType));
+    }
+
+    void Pull(ElemType* model, size_t firstShard = 0)
+    {
+        ForEachShard(firstShard, [&](size_t begin, size_t end)
+        {
+            memcpy(model + begin, m_model + begin, (end - begin) * sizeof(ElemType));
+        });
+    }
+
+    // Apply an update: model += factor * delta, where 'delta' was computed by a worker starting from the model 'base'.
+    // With delay compensation, the update is corrected for the change of the model since 'base' was pulled
+    // (DC-ASGD): a delta is a scaled negative gradient, so the first-order Taylor correction of the gradient,
+    // g(model) ~= g(base) + lambda g*g*(model - base), becomes delta -= compensation * delta*delta*(model - base),
+    // with compensation = lambda / learning rate.
+    // If 'pulled' is given, the updated model is copied there, shard by shard under the same lock.
+    // 'firstShard' should differ between workers, so that they do not queue up on the same lock.
+    void Push(const ElemType* delta, const ElemType* base, ElemType factor, ElemType compensation, ElemType* pulled, size_t firstShard = 0)
+    {
+        ForEachShard(firstShard, [&](size_t begin, size_t end)
+        {
+            if (compensation != 0)
+            {
+                for (size_t i = begin; i < end; i++)
+                {
+                    ElemType d = delta[i];
+                    m_model[i] += factor * (d - compensation * d * d * (m_model[i] - base[i]));
+                }
+            }
+            else
+            {
+                for (size_t i = begin; i < end; i++)
+                    m_model[i] += factor * delta[i];
+            }
+            if (pulled)
+                memcpy(pulled + begin, m_model + begin, (end - begin) * sizeof(ElemType));
+        });
+        m_header->numPushes++;
+    }
+
+private:
+    template <class F>
+    void ForEachShard(size_t firstShard, const F& f)
+    {
+        for (size_t k = 0; k < m_numShards; k++)
+        {
+            size_t shard = (firstShard + k) % m_numShards;
+            size_t begin = shard * m_modelSize / m_numShards;
+            size_t end = (shard + 1) * m_modelSize / m_numShards;
+            Lock(shard);
+            try
+            {
+                f(begin, end);
+            }
+            catch (...)
+            {
+                Unlock(shard);
+                throw;
+            }
+            Unlock(shard);
+        }
+    }
+
+    // spin locks work across processes, since lock-free atomics do not depend on the address they are mapped to
+    void Lock(size_t shard)
+    {
+        auto& locked = m_locks[shard].locked;
+        for (size_t spins = 0; locked.exchange(1, std::memory_order_acquire) != 0; spins++)
+        {
+            while (locked.load(std::memory_order_relaxed) != 0)
+            {
+                if (++spins > 1000) // the holder may have been descheduled
+                    std::this_thread::yield();
+            }
+        }
+    }
+
+    void Unlock(size_t shard)
+    {
+        m_locks[shard].locked.store(0, std::memory_order_release);
+    }
+
+    size_t m_modelSize;
+    size_t m_numShards;
+    SharedMemorySegment m_segment;
+    Header* m_header;
+    ShardLock* m_locks;
+    ElemType* m_model;
+};
+
+}}}
@@ -16,6 +16,12 @@
 #include <stdexcept>
 #include <fstream>
 #include <cstdio>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
 #include "ProgressTracing.h"
 #include "ComputationNetworkBuilder.h"
 
@@ -23,6 +29,172 @@ using namespace std;
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// -----------------------------------------------------------------------
+// OutputFormattingPipeline -- formats and writes the outputs of the write command on background threads
+// Formatting the values as text is often more expensive than evaluating the network. The outputs of each
+// minibatch are therefore handed to 'numWorkers' worker threads, which format several minibatches at once while
+// the network already evaluates the next ones. Each worker waits for the minibatches submitted before its own
+// to be written before writing it, so that the files are written in the order of submission. Submit() blocks
+// while 'maxPendingMinibatches' minibatches are waiting. With maxPendingMinibatches=0, Submit() formats and writes
+// on the calling thread. An error of a worker is rethrown by the next Submit() or by Finish(), after all
+// minibatches submitted before the failing one have been written.
+// -----------------------------------------------------------------------
+
+class OutputFormattingPipeline
+{
+public:
+    typedef std::vector<std::pair<FILE*, std::function<std::string()>>> Minibatch; // [output] -> (file, function that returns the data to write)
+
+    OutputFormattingPipeline(size_t maxPendingMinibatches, size_t numWorkers = 1)
+        : m_maxPendingMinibatches(maxPendingMinibatches), m_numSubmitted(0), m_numWritten(0), m_stop(false)
+    {
+        if (m_maxPendingMinibatches > 0)
+        {
+            for (size_t i = 0; i < std::max<size_t>(numWorkers, 1); i++)
+                m_workers.emplace_back([this]() { WorkerLoop(); });
+        }
+    }
+
+    // without Finish(), i.e. when unwinding from an error, the minibatches that are still waiting are dropped
+    ~OutputFormattingPipeline()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pendingMinibatches.clear();
+        }
+        Stop();
+    }
+
+    void Submit(Minibatch&& minibatch)
+    {
+        if (m_workers.empty())
+        {
+            Write(minibatch, Format(minibatch));
+            return;
+        }
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_queueChanged.wait(lock, [this]() { return m_pendingMinibatches.size() < m_maxPendingMinibatches || m_error; });
+            if (m_error)
+                std::rethrow_exception(m_error);
+            m_pendingMinibatches.push_back(std::move(minibatch));
+        }
+        m_queueChanged.notify_all();
+    }
+
+    // wait until all submitted minibatches have been written
+    void Finish()
+    {
+        Stop();
+        if (m_error)
+            std::rethrow_exception(m_error);
+    }
+
+private:
+    static std::vector<std::string> Format(Minibatch& minibatch)
+    {
+        std::vector<std::string> data;
+        for (auto& output : minibatch)
+            data.push_back(output.second());
+        return data;
+    }
+
+    static void Write(const Minibatch& minibatch, const std::vector<std::string>& data)
+    {
+        for (size_t i = 0; i < minibatch.size(); i++)
+        {
+            if (!data[i].empty())
+                fwriteOrDie(data[i].data(), sizeof(char), data[i].size(), minibatch[i].first);
+        }
+    }
+
+    void Stop()
+    {
+        if (m_workers.empty())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_queueChanged.notify_all();
+        for (auto& worker : m_workers)
+            worker.join();
+        m_workers.clear();
+    }
+
+    void WorkerLoop()
+    {
+        for (;;)
+        {
+            Minibatch minibatch;
+            size_t index; // position of the minibatch in the order of submission
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_queueChanged.wait(lock, [this]() { return m_stop || m_error || !m_pendingMinibatches.empty(); });
+                if (m_error || m_pendingMinibatches.empty()) // (another worker failed, or m_stop and all is taken)
+                    return;
+                minibatch = std::move(m_pendingMinibatches.front());
+                m_pendingMinibatches.pop_front();
+                index = m_numSubmitted++;
+            }
+            m_queueChanged.notify_all();
+
+            // format concurrently with the other workers
+            std::vector<std::string> data;
+            std::exception_ptr error;
+            try
+            {
+                data = Format(minibatch);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            // wait for the turn of this minibatch; only the worker whose turn it is writes, so the lock is not needed for writing
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_queueChanged.wait(lock, [this, index]() { return m_numWritten == index || m_error; });
+                if (m_error)
+                    return;
+            }
+            if (!error)
+            {
+                try
+                {
+                    Write(minibatch, data);
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (error)
+                {
+                    m_error = error;
+                    m_pendingMinibatches.clear();
+                }
+                else
+                    m_numWritten++;
+            }
+            m_queueChanged.notify_all();
+            if (error)
+                return;
+        }
+    }
+
+    const size_t m_maxPendingMinibatches;
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;                          // guards the members below
+    std::condition_variable m_queueChanged;      // (also signals that a minibatch was written, or that a worker failed)
+    std::deque<Minibatch> m_pendingMinibatches;
+    size_t m_numSubmitted;                       // minibatches taken from m_pendingMinibatches by a worker
+    size_t m_numWritten;
+    std::exception_ptr m_error;                  // (the workers have stopped when Finish() reads it)
+    bool m_stop;
+};
 
 template <class ElemType>
 class SimpleOutputWriter
@@ -115,19 +287,95 @@ public:
         dataWriter.SaveData(0, outputMatrices, 1, 1, 0);
     }
 
-    void WriteMinibatch(FILE* f, ComputationNodePtr node,
-        const WriteFormattingOptions & formattingOptions, char formatChar, std::string valueFormatString, std::vector<std::string>& labelMapping,
-        size_t numMBsRun, bool gradient, std::function<std::string(size_t)>& idToKeyMapping)
+    // output of one node for one minibatch, copied out of the network, so that it can be formatted on the
+    // OutputFormattingPipeline threads while the network already computes the next minibatch
+    struct MinibatchOutput
     {
-        const auto sequenceSeparator = formattingOptions.Processed(node->NodeName(), formattingOptions.sequenceSeparator, numMBsRun);
-        const auto sequencePrologue =  formattingOptions.Processed(node->NodeName(), formattingOptions.sequencePrologue,  numMBsRun);
-        const auto sequenceEpilogue =  formattingOptions.Processed(node->NodeName(), formattingOptions.sequenceEpilogue,  numMBsRun);
-        const auto elementSeparator =  formattingOptions.Processed(node->NodeName(), formattingOptions.elementSeparator,  numMBsRun);
-        const auto sampleSeparator =   formattingOptions.Processed(node->NodeName(), formattingOptions.sampleSeparator,   numMBsRun);
-
-        node->WriteMinibatchWithFormatting(f, FrameRange(), SIZE_MAX, SIZE_MAX, formattingOptions.transpose, formattingOptions.isCategoryLabel, formattingOptions.isSparse, labelMapping,
-            sequenceSeparator, sequencePrologue, sequenceEpilogue, elementSeparator, sampleSeparator,
-            valueFormatString, gradient, false, idToKeyMapping);
+        FILE* file;
+        std::unique_ptr<ElemType[]> values;
+        size_t numRows;
+        size_t numCols;
+        MBLayoutPtr pMBLayout; // a copy, since the network's layout gets overwritten by the next minibatch
+        TensorShape sampleLayout;
+        std::string sequenceSeparator, sequencePrologue, sequenceEpilogue, elementSeparator, sampleSeparator;
+        std::function<std::string(size_t)> getKeyById;
+    };
+
+    std::shared_ptr<MinibatchOutput> CopyMinibatchOutput(FILE* f, ComputationNodePtr node, const WriteFormattingOptions& formattingOptions,
+                                                         size_t numMBsRun, bool gradient, const std::function<std::string(size_t)>& idToKeyMapping)
+    {
+        auto output = make_shared<MinibatchOutput>();
+        const Matrix<ElemType>& matrix = gradient ? node->Gradient() : node->Value();
+        output->file = f;
+        output->values.reset(matrix.CopyToArray());
+        output->numRows = matrix.GetNumRows();
+        output->numCols = matrix.GetNumCols();
+        if (node->HasMBLayout())
+        {
+            output->pMBLayout = make_shared<MBLayout>();
+            output->pMBLayout->CopyFrom(node->GetMBLayout());
+        }
+        output->sampleLayout = node->GetSampleLayout();
+
+        output->sequenceSeparator = formattingOptions.Processed(node->NodeName(), formattingOptions.sequenceSeparator, numMBsRun);
+        output->sequencePrologue =  formattingOptions.Processed(node->NodeName(), formattingOptions.sequencePrologue,  numMBsRun);
+        output->sequenceEpilogue =  formattingOptions.Processed(node->NodeName(), formattingOptions.sequenceEpilogue,  numMBsRun);
+        output->elementSeparator =  formattingOptions.Processed(node->NodeName(), formattingOptions.elementSeparator,  numMBsRun);
+        output->sampleSeparator =   formattingOptions.Processed(node->NodeName(), formattingOptions.sampleSeparator,   numMBsRun);
+
+        // look up the sequence keys right away, since the reader moves on to the next minibatch while we are formatting
+        bool needsKeys = output->sequencePrologue.find("%k") != std::string::npos || output->sampleSeparator.find("%k") != std::string::npos;
+        if (idToKeyMapping && needsKeys && output->pMBLayout)
+        {
+            auto keys = make_shared<std::map<size_t, std::string>>();
+            for (const auto& seq : output->pMBLayout->GetAllSequences())
+                if (seq.seqId != GAP_SEQUENCE_ID)
+                    (*keys)[seq.seqId] = idToKeyMapping(seq.seqId);
+            output->getKeyById = [keys](size_t seqId) { return keys->at(seqId); };
+        }
+        return output;
+    }
+
+    static std::string FormatMinibatchOutput(MinibatchOutput& output, const WriteFormattingOptions& formattingOptions, const std::string& valueFormatString, const std::vector<std::string>& labelMapping)
+    {
+        std::string text;
+        ComputationNode<ElemType>::FormatMinibatch(text, output.values.get(), output.numRows, output.numCols, output.pMBLayout, output.sampleLayout,
+            FrameRange(), SIZE_MAX, SIZE_MAX, formattingOptions.transpose, formattingOptions.isCategoryLabel, formattingOptions.isSparse, labelMapping,
+            output.sequenceSeparator, output.sequencePrologue, output.sequenceEpilogue, output.elementSeparator, output.sampleSeparator,
+            valueFormatString, false, output.getKeyById);
+        return text;
+    }
+
+    // binary output format: the values of each sample as 'numRows' raw floats, in the same sample order as the text format
+    static std::string SerializeMinibatchOutput(const MinibatchOutput& output)
+    {
+        std::vector<float> data;
+        data.reserve(output.numRows * output.numCols);
+        auto appendColumn = [&](size_t col)
+        {
+            const ElemType* column = output.values.get() + col * output.numRows;
+            for (size_t i = 0; i < output.numRows; i++)
+                data.push_back((float)column[i]);
+        };
+        if (!output.pMBLayout)
+        {
+            for (size_t col = 0; col < output.numCols; col++)
+                appendColumn(col);
+        }
+        else
+        {
+            const auto& pMBLayout = output.pMBLayout;
+            for (const auto& seq : pMBLayout->GetAllSequences())
+            {
+                if (seq.seqId == GAP_SEQUENCE_ID)
+                    continue;
+                ptrdiff_t tBegin = max(seq.tBegin, (ptrdiff_t)0);
+                ptrdiff_t tEnd = min((ptrdiff_t)seq.tEnd, (ptrdiff_t)pMBLayout->GetNumTimeSteps());
+                for (ptrdiff_t t = tBegin; t < tEnd; t++)
+                    appendColumn(t * pMBLayout->GetNumParallelSequences() + seq.s);
+            }
+        }
+        return std::string((const char*)data.data(), data.size() * sizeof(float));
     }
 
     void InsertNode(std::vector<ComputationNodeBasePtr>& allNodes, ComputationNodeBasePtr parent, ComputationNodeBasePtr newNode)
@@ -146,7 +394,8 @@ public:
     }
 
     // TODO: Remove code dup with above function by creating a fake Writer object and then calling the other function.
-    void WriteOutput(IDataReader& dataReader, size_t mbSize, std::wstring outputPath, const std::vector<std::wstring>& outputNodeNames, const WriteFormattingOptions& formattingOptions, size_t numOutputSamples = requestDataSize, bool nodeUnitTest = false, bool writeSequenceKey = false)
+    void WriteOutput(IDataReader& dataReader, size_t mbSize, std::wstring outputPath, const std::vector<std::wstring>& outputNodeNames, const WriteFormattingOptions& formattingOptions, size_t numOutputSamples = requestDataSize, bool nodeUnitTest = false, bool writeSequenceKey = false,
+                     size_t numPendingMinibatches = 0, bool binaryOutput = false, size_t numFormattingThreads = 1)
     {
         // In case of unit test, make sure backprop works
         ScopedNetworkOperationMode modeGuard(m_net, nodeUnitTest ? NetworkOperationMode::training : NetworkOperationMode::inferring);
@@ -207,7 +456,7 @@ public:
             std::wstring nodeOutputPath = outputPath;
             if (nodeOutputPath != L"-")
                 nodeOutputPath += L"." + onode->NodeName();
-            auto f = make_shared<File>(nodeOutputPath, fileOptionsWrite | fileOptionsText);
+            auto f = make_shared<File>(nodeOutputPath, fileOptionsWrite | (binaryOutput ? fileOptionsBinary : fileOptionsText));
             outputStreams[onode] = f;
         }
 
@@ -218,10 +467,13 @@ public:
 
         size_t totalEpochSamples = 0;
 
-        for (auto & onode : outputNodes)
+        if (!binaryOutput)
         {
-            FILE* f = *outputStreams[onode];
-            fprintfOrDie(f, "%s", formattingOptions.prologue.c_str());
+            for (auto & onode : outputNodes)
+            {
+                FILE* f = *outputStreams[onode];
+                fprintfOrDie(f, "%s", formattingOptions.prologue.c_str());
+            }
         }
 
         size_t actualMBSize;
@@ -230,19 +482,32 @@ public:
         char formatChar = !formattingOptions.isCategoryLabel ? 'f' : !formattingOptions.labelMappingFile.empty() ? 's' : 'u';
         std::string valueFormatString = "%" + formattingOptions.precisionFormat + formatChar; // format string used in fprintf() for formatting the values
 
+        // the outputs of each minibatch are copied out of the network and formatted in the background while the next ones are evaluated
+        OutputFormattingPipeline pipeline(numPendingMinibatches, numFormattingThreads);
+
         for (size_t numMBsRun = 0; DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(dataReader, m_net, nullptr, false, false, inputMatrices, actualMBSize, nullptr); numMBsRun++)
         {
             ComputationNetwork::BumpEvalTimeStamp(inputNodes);
             m_net->ForwardProp(outputNodes);
 
+            OutputFormattingPipeline::Minibatch minibatchOutputs;
+            auto addOutput = [&](const ComputationNodePtr& node, bool gradient, const std::function<std::string(size_t)>& idToKeyMapping)
+            {
+                auto output = CopyMinibatchOutput(*outputStreams[node], node, formattingOptions, numMBsRun, gradient, idToKeyMapping);
+                auto format = [output, binaryOutput, &formattingOptions, &valueFormatString, &labelMapping]()
+                {
+                    return binaryOutput ? SerializeMinibatchOutput(*output) : FormatMinibatchOutput(*output, formattingOptions, valueFormatString, labelMapping);
+                };
+                minibatchOutputs.emplace_back(output->file, format);
+            };
+
             for (auto & onode : outputNodes)
             {
                 // compute the node value
                 // Note: Intermediate values are memoized, so in case of multiple output nodes, we only compute what has not been computed already.
 
-                FILE* file = *outputStreams[onode];
                 auto getKeyById = writeSequenceKey ? inputMatrices.m_getKeyById : std::function<std::string(size_t)>();
-                WriteMinibatch(file, dynamic_pointer_cast<ComputationNode<ElemType>>(onode), formattingOptions, formatChar, valueFormatString, labelMapping, numMBsRun, /* gradient */ false, getKeyById);
+                addOutput(dynamic_pointer_cast<ComputationNode<ElemType>>(onode), /* gradient */ false, getKeyById);
 
                 if (nodeUnitTest)
                     m_net->Backprop(onode);
@@ -252,7 +517,6 @@ public:
             {
                 for (auto & node : gradientNodes)
                 {
-                    FILE* file = *outputStreams[node];
                     if (!node->GradientPtr())
                     {
                         fprintf(stderr, "Warning: Gradient of node '%s' is empty. Not used in backward pass?", Microsoft::MSR::CNTK::ToLegacyString(Microsoft::MSR::CNTK::ToUTF8(node->NodeName().c_str())).c_str());
@@ -260,15 +524,16 @@ public:
                     else
                     {
                         auto idToKeyMapping = std::function<std::string(size_t)>();
-                        WriteMinibatch(file, node, formattingOptions, formatChar, valueFormatString, labelMapping, numMBsRun, /* gradient */ true, idToKeyMapping);
+                        addOutput(node, /* gradient */ true, idToKeyMapping);
                     }
                 }
             }
             totalEpochSamples += actualMBSize;
 
             fprintf(stderr, "Minibatch[%lu]: ActualMBSize = %lu\n", (unsigned long)numMBsRun, (unsigned long)actualMBSize);
-            if (outputPath == L"-") // if we mush all nodes together on stdout, add some visual separator
-                fprintf(stdout, "\n");
+            if (outputPath == L"-" && !binaryOutput) // if we mush all nodes together on stdout, add some visual separator
+                minibatchOutputs.emplace_back(stdout, []() { return std::string("\n"); });
+            pipeline.Submit(std::move(minibatchOutputs));
 
             numItersSinceLastPrintOfProgress = ProgressTracing::TraceFakeProgress(numIterationsBeforePrintingProgress, numItersSinceLastPrintOfProgress);
 
@@ -277,13 +542,23 @@ public:
             dataReader.DataEnd();
         } // end loop over minibatches
 
-        for (auto & stream : outputStreams)
+        pipeline.Finish();
+
+        if (!binaryOutput)
         {
-            FILE* f = *stream.second;
-            fprintfOrDie(f, "%s", formattingOptions.epilogue.c_str());
+            for (auto & stream : outputStreams)
+            {
+                FILE* f = *stream.second;
+                fprintfOrDie(f, "%s", formattingOptions.epilogue.c_str());
+            }
         }
 
         fprintf(stderr, "Written to %ls*\nTotal Samples Evaluated = %lu\n", outputPath.c_str(), (unsigned long)totalEpochSamples);
+        if (binaryOutput)
+        {
+            for (auto & onode : allOutputNodes)
+                fprintf(stderr, "%ls: %lu float32 values per sample\n", onode->NodeName().c_str(), (unsigned long)onode->GetSampleLayout().GetNumElements());
+        }
 
         // flush all files (where we can catch errors) so that we can then destruct the handle cleanly without error
         for (auto & iter : outputStreams)
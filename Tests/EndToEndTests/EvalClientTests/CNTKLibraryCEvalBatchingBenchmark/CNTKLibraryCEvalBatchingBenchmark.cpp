@@ -0,0 +1,209 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CNTKLibraryCEvalBatchingBenchmark.cpp : Load generator comparing latency and throughput of the C evaluation API
+// with one model clone per caller against a batching model that coalesces concurrent requests.
+//
+// Usage: CNTKLibraryCEvalBatchingBenchmark [modelFile [numClients [requestsPerClient [maxBatchSize [maxLatencyMicroseconds [numReplicas]]]]]]
+// If no model file is given, a feed forward classifier with random parameters is created.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CNTKLibrary.h"
+#include "CNTKLibraryC.h"
+
+using namespace CNTK;
+
+namespace
+{
+    struct BenchmarkResult
+    {
+        double m_seconds;
+        std::vector<double> m_latenciesMs;
+        size_t m_failures;
+    };
+
+    void Check(const CNTK_StatusCode& status)
+    {
+        if (status.value != CNTK_SUCCESS)
+        {
+            fprintf(stderr, "CNTK call failed: %s\n", status.description);
+            exit(1);
+        }
+    }
+
+    std::string CreateSyntheticModel(size_t inputDim, size_t hiddenDim, size_t numHiddenLayers, size_t outputDim)
+    {
+        auto device = DeviceDescriptor::CPUDevice();
+        Variable layer = InputVariable({ inputDim }, DataType::Float, L"features");
+        for (size_t i = 0; i < numHiddenLayers; ++i)
+        {
+            auto inputDimension = layer.Shape()[0];
+            auto times = Parameter(NDArrayView::RandomUniform<float>({ hiddenDim, inputDimension }, -0.05, 0.05, 1, device));
+            auto plus = Parameter({ hiddenDim }, 0.0f, device);
+            layer = Sigmoid(Plus(plus, Times(times, layer)));
+        }
+        auto outputTimes = Parameter(NDArrayView::RandomUniform<float>({ outputDim, hiddenDim }, -0.05, 0.05, 1, device));
+        auto output = Times(outputTimes, layer, L"classifierOutput");
+
+        const std::string modelFile = "batchingBenchmark.model";
+        output->Save(std::wstring(modelFile.begin(), modelFile.end()));
+        return modelFile;
+    }
+
+    // Each client issues its requests back to back against its own handle; returns wall clock time and per-request latencies.
+    BenchmarkResult RunLoad(const std::vector<CNTK_ModelHandle>& handles, CNTK_Variable* arguments, uint32_t numArguments,
+                            CNTK_Variable* outputs, uint32_t numOutputs, size_t requestsPerClient)
+    {
+        const size_t numClients = handles.size();
+        std::vector<std::vector<double>> latencies(numClients);
+        std::vector<size_t> failures(numClients, 0);
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> clients;
+        for (size_t c = 0; c < numClients; ++c)
+        {
+            clients.push_back(std::thread([&, c]()
+            {
+                std::mt19937 generator((unsigned int)c);
+                std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+
+                std::vector<std::vector<float>> data(numArguments);
+                std::vector<std::vector<uint32_t>> dims(numArguments);
+                std::vector<CNTK_Value> inputs(numArguments);
+                std::unique_ptr<bool[]> resetFlags(new bool[numArguments]);
+                for (uint32_t a = 0; a < numArguments; ++a)
+                {
+                    resetFlags[a] = true;
+                    dims[a].assign(arguments[a].shape.value, arguments[a].shape.value + arguments[a].shape.size);
+                    dims[a].push_back(1); // single sample sequence
+                    size_t size = 1;
+                    for (auto d : dims[a])
+                        size *= d;
+                    data[a].resize(size);
+                    for (auto& v : data[a])
+                        v = distribution(generator);
+                    inputs[a].shape.size = (uint32_t)dims[a].size();
+                    inputs[a].shape.value = dims[a].data();
+                    inputs[a].data = data[a].data();
+                }
+
+                for (size_t r = 0; r < requestsPerClient; ++r)
+                {
+                    CNTK_Value* outputValues = nullptr;
+                    auto requestStart = std::chrono::steady_clock::now();
+                    auto status = CNTK_EvaluateSequence(handles[c], arguments, inputs.data(), resetFlags.get(), numArguments, outputs, numOutputs, &outputValues);
+                    auto requestEnd = std::chrono::steady_clock::now();
+                    if (status.value != CNTK_SUCCESS)
+                    {
+                        failures[c]++;
+                        continue;
+                    }
+
+                    latencies[c].push_back(std::chrono::duration<double, std::milli>(requestEnd - requestStart).count());
+                    for (uint32_t o = 0; o < numOutputs; ++o)
+                        CNTK_CleanValue(&outputValues[o]);
+                    CNTK_ReleaseArray(outputValues);
+                }
+            }));
+        }
+
+        for (auto& client : clients)
+            client.join();
+
+        BenchmarkResult result;
+        result.m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.m_failures = 0;
+        for (size_t c = 0; c < numClients; ++c)
+        {
+            result.m_latenciesMs.insert(result.m_latenciesMs.end(), latencies[c].begin(), latencies[c].end());
+            result.m_failures += failures[c];
+        }
+        std::sort(result.m_latenciesMs.begin(), result.m_latenciesMs.end());
+        return result;
+    }
+
+    double Percentile(const std::vector<double>& sorted, double p)
+    {
+        if (sorted.empty())
+            return 0;
+        size_t index = std::min(sorted.size() - 1, (size_t)(p / 100.0 * sorted.size()));
+        return sorted[index];
+    }
+
+    void Report(const char* name, const BenchmarkResult& result)
+    {
+        printf("%-12s requests %8d, failures %4d, throughput %10.1f req/s, latency ms: p50 %8.3f  p90 %8.3f  p99 %8.3f  max %8.3f\n",
+            name, (int)result.m_latenciesMs.size(), (int)result.m_failures,
+            result.m_latenciesMs.size() / result.m_seconds,
+            Percentile(result.m_latenciesMs, 50), Percentile(result.m_latenciesMs, 90),
+            Percentile(result.m_latenciesMs, 99), result.m_latenciesMs.empty() ? 0.0 : result.m_latenciesMs.back());
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::string modelFile = argc > 1 ? argv[1] : CreateSyntheticModel(512, 1024, 3, 1000);
+    const size_t numClients = argc > 2 ? atoi(argv[2]) : 32;
+    const size_t requestsPerClient = argc > 3 ? atoi(argv[3]) : 200;
+
+    CNTK_BatchingOptions options;
+    options.maxBatchSize = argc > 4 ? atoi(argv[4]) : 32;
+    options.maxLatencyMicroseconds = argc > 5 ? atoi(argv[5]) : 1000;
+    options.numReplicas = argc > 6 ? atoi(argv[6]) : 2;
+
+    printf("Model '%s', %d clients x %d single sample requests, batching: max batch %d, max latency %d us, %d replicas\n",
+        modelFile.c_str(), (int)numClients, (int)requestsPerClient,
+        (int)options.maxBatchSize, (int)options.maxLatencyMicroseconds, (int)options.numReplicas);
+
+    CNTK_DeviceDescriptor device{ CNTK_DeviceKind_CPU, 0 };
+    CNTK_ModelHandle model;
+    Check(CNTK_LoadModel(modelFile.c_str(), &device, &model));
+
+    CNTK_Variable* arguments;
+    uint32_t numArguments = 0;
+    Check(CNTK_GetModelArgumentsInfo(model, &arguments, &numArguments));
+
+    CNTK_Variable* outputs;
+    uint32_t numOutputs = 0;
+    Check(CNTK_GetModelOutputsInfo(model, &outputs, &numOutputs));
+
+    // Baseline: every client evaluates its own clone sharing the parameters.
+    {
+        std::vector<CNTK_ModelHandle> clones(numClients);
+        for (auto& clone : clones)
+            Check(CNTK_CloneModel(model, CNTK_ModelParameterShare, false, &clone));
+        Report("unbatched", RunLoad(clones, arguments, numArguments, outputs, numOutputs, requestsPerClient));
+        for (auto clone : clones)
+            CNTK_ReleaseModel(clone);
+    }
+
+    // All clients share one batching model.
+    {
+        CNTK_ModelHandle batched;
+        Check(CNTK_CreateBatchingModel(model, &options, &batched));
+        Report("batched", RunLoad(std::vector<CNTK_ModelHandle>(numClients, batched), arguments, numArguments, outputs, numOutputs, requestsPerClient));
+        CNTK_ReleaseModel(batched);
+    }
+
+    for (uint32_t i = 0; i < numOutputs; i++)
+        CNTK_CleanVariable(&outputs[i]);
+    CNTK_ReleaseArray(outputs);
+
+    for (uint32_t i = 0; i < numArguments; i++)
+        CNTK_CleanVariable(&arguments[i]);
+    CNTK_ReleaseArray(arguments);
+
+    CNTK_ReleaseModel(model);
+    fflush(stdout);
+    return 0;
+}
@@ -10,6 +10,7 @@
 #include "BrainScriptParser.h"
 #include "BrainScriptTestsHelper.h"
 #include "boost/filesystem.hpp"
+#include "boost/filesystem/fstream.hpp"
 #include <boost/algorithm/string.hpp>
 
 #include <utility>
@@ -100,6 +101,24 @@ BOOST_AUTO_TEST_CASE(ParseExpressionsAndCompareTree)
     }
 }
 
+// The parser reports the files it includes, nested ones too; the network cache keys on their contents.
+BOOST_AUTO_TEST_CASE(ParseReportsIncludedFiles)
+{
+    let dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(dir);
+    boost::filesystem::ofstream((dir / "outer.bs")) << "include 'inner.bs'\nouter = inner + 1\n";
+    boost::filesystem::ofstream((dir / "inner.bs")) << "inner = 13\n";
+
+    vector<wstring> includedFiles;
+    let expr = BS::ParseConfigDictFromString(L"include 'outer.bs'\nx = outer", L"Test", vector<wstring>{ dir.generic_wstring() }, &includedFiles);
+    BOOST_REQUIRE(expr);
+    BOOST_REQUIRE_EQUAL(includedFiles.size(), 2);
+    BOOST_CHECK(boost::filesystem::path(includedFiles[0]).filename() == "outer.bs");
+    BOOST_CHECK(boost::filesystem::path(includedFiles[1]).filename() == "inner.bs");
+
+    boost::filesystem::remove_all(dir);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }}}}
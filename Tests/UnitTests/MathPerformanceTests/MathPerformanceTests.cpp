@@ -9,12 +9,18 @@
 //#include "Windows.h"
 #include "Matrix.h"
 #include "CPUMatrix.h"
+#include "CPUSparseMatrix.h"
 #include "TensorView.h"
 #include "Sequences.h"
+#include "ConvolutionEngine.h"
+#include "NumaPolicy.h"
 #include <chrono>
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <functional>
+#include <numeric>
+#include <omp.h>
 
 using namespace Microsoft::MSR::CNTK;
 using namespace std;
@@ -336,6 +342,319 @@ void MandSTest(int count, int devId)
     delete[] data3;
 }
 
+// Compares the per-minibatch cost of the dense learner updates of an embedding with the sparse (block column)
+// ones, which only touch the columns of the words present in the minibatch and apply the decay of the
+// smoothed state of the other columns lazily through timestamps. The dense updates need the full gradient
+// and are skipped if compareWithDense is false (e.g. for vocabularies that do not fit into memory twice).
+template <class ElemType>
+void SparseEmbeddingLearnerTest(size_t vocabSize, size_t embeddingDim, size_t samplesPerMinibatch, int count, bool compareWithDense = true)
+{
+    cout << "Embedding " << embeddingDim << "x" << vocabSize << ", " << samplesPerMinibatch << " samples per minibatch" << endl;
+
+    // one-hot input (vocabSize x samples) and the gradient of the embedded input (embeddingDim x samples)
+    vector<CPUSPARSE_INDEX_TYPE> colStarts(samplesPerMinibatch + 1);
+    vector<CPUSPARSE_INDEX_TYPE> rows(samplesPerMinibatch);
+    vector<ElemType> values(samplesPerMinibatch, 1);
+    for (size_t j = 0; j < samplesPerMinibatch; ++j)
+    {
+        colStarts[j] = (CPUSPARSE_INDEX_TYPE) j;
+        rows[j] = (CPUSPARSE_INDEX_TYPE) (((size_t) rand() * RAND_MAX + rand()) % vocabSize);
+    }
+    colStarts[samplesPerMinibatch] = (CPUSPARSE_INDEX_TYPE) samplesPerMinibatch;
+
+    Matrix<ElemType> input(vocabSize, samplesPerMinibatch, CPUDEVICE, SPARSE, matrixFormatSparseCSC);
+    input.SetMatrixFromCSCFormat(colStarts.data(), rows.data(), values.data(), samplesPerMinibatch, vocabSize, samplesPerMinibatch);
+    Matrix<ElemType> embeddedGradient(embeddingDim, samplesPerMinibatch, CPUDEVICE);
+    randomInitializeMatrix<ElemType>(embeddedGradient, -1, 2);
+
+    Matrix<ElemType> sparseGradient(CPUDEVICE);
+    sparseGradient.SwitchToMatrixType(SPARSE, matrixFormatSparseBlockCol, false);
+    Matrix<ElemType>::MultiplyAndAdd(embeddedGradient, false, input, true, sparseGradient);
+
+    Matrix<ElemType> denseGradient(CPUDEVICE);
+    if (compareWithDense)
+    {
+        denseGradient.Resize(embeddingDim, vocabSize);
+        denseGradient.SetValue(0);
+        for (size_t j = 0; j < samplesPerMinibatch; ++j)
+            for (size_t i = 0; i < embeddingDim; ++i)
+                denseGradient(i, rows[j]) += embeddedGradient(i, j);
+    }
+
+    Matrix<ElemType> parameters(embeddingDim, vocabSize, CPUDEVICE);
+    parameters.SetUniformRandomValue(-0.1f, 0.1f, 1);
+    vector<int> timestamps(vocabSize);
+
+    // runs an update "count" times on a fresh state and reports the wall clock time per minibatch
+    // The history holds the given decay rates of the state buffers for every update.
+    typedef std::function<void(Matrix<ElemType>& gradient, Matrix<ElemType>& state, int* ts, const LazyDecayHistory& history)> UpdateFunction;
+    auto timeUpdate = [&](const char* name, bool sparse, const vector<double>& decayRates, const UpdateFunction& update)
+    {
+        if (!sparse && !compareWithDense)
+            return;
+        Matrix<ElemType> state(CPUDEVICE);
+        Matrix<ElemType> gradient(CPUDEVICE);
+        std::fill(timestamps.begin(), timestamps.end(), 0);
+        LazyDecayHistory history;
+        auto step = [&]()
+        {
+            history.Append(decayRates);
+            if (!sparse)
+                return update(denseGradient, state, nullptr, history);
+            // the sparse updates overwrite the gradient, so the copy is part of their cost
+            gradient.AssignValuesOf(sparseGradient);
+            update(gradient, state, timestamps.data(), history);
+        };
+        step(); // warm up, allocates the state
+
+        auto t_start = chrono::steady_clock::now();
+        for (int i = 0; i < count; ++i)
+            step();
+        auto t_end = chrono::steady_clock::now();
+        cout << name << (sparse ? " sparse: " : " dense:  ") << chrono::duration<double, milli>(t_end - t_start).count() / count << " ms per minibatch" << endl;
+    };
+
+    for (bool sparse : { false, true })
+    {
+        timeUpdate("MomentumSGD", sparse, { 0.9 }, [&](Matrix<ElemType>& gradient, Matrix<ElemType>& state, int* ts, const LazyDecayHistory& history)
+        {
+            if (state.IsEmpty())
+            {
+                state.Resize(embeddingDim, vocabSize);
+                state.SetValue(0);
+            }
+            parameters.MomentumSGDUpdate(gradient, state, (ElemType) 0.01, (ElemType) 0.9, (ElemType) 0.1, ts, &history);
+        });
+    }
+    for (bool sparse : { false, true })
+    {
+        timeUpdate("AdaGrad", sparse, {}, [&](Matrix<ElemType>& gradient, Matrix<ElemType>& state, int*, const LazyDecayHistory&)
+        {
+            state.Adagrad(gradient, false);
+            Matrix<ElemType>::ScaleAndAdd((ElemType) -0.01, gradient, parameters);
+        });
+    }
+    for (bool sparse : { false, true })
+    {
+        timeUpdate("FSAdaGrad", sparse, { 0.999, 0.9 }, [&](Matrix<ElemType>& gradient, Matrix<ElemType>& state, int* ts, const LazyDecayHistory& history)
+        {
+            state.FSAdagradUpdate(gradient, parameters, 1.0, 0.01, 0.9, 0.999, (ElemType) 0.1, ts, &history);
+        });
+    }
+    for (bool sparse : { false, true })
+    {
+        timeUpdate("Adam", sparse, { 0.999, 0.9 }, [&](Matrix<ElemType>& gradient, Matrix<ElemType>& state, int* ts, const LazyDecayHistory& history)
+        {
+            state.AdamUpdate(gradient, parameters, history.NumUpdates(), 0.01, 0.9, 0.999, 1e-8, (ElemType) 0.1, false, ts, &history);
+        });
+    }
+    for (bool sparse : { false, true })
+    {
+        timeUpdate("AdaDelta", sparse, { 0.95, 0.95 }, [&](Matrix<ElemType>& gradient, Matrix<ElemType>& state, int* ts, const LazyDecayHistory& history)
+        {
+            state.AdaDeltaUpdate(gradient, parameters, (ElemType) 1, (ElemType) 0.95, (ElemType) 1e-8, ts, history.NumUpdates());
+        });
+    }
+}
+
+// Times 2D CPU max/average pooling (forward and backward) of the reference engine, which uses the
+// dedicated window kernels for such geometries, against the generic lookup-based implementation.
+template <class ElemType>
+void PoolingTest(size_t width, size_t height, size_t channels, size_t batchSize, size_t window, size_t stride, bool pad, int count)
+{
+    cout << "Pooling " << window << "x" << window << "/" << stride << (pad ? " padded" : "") << " of " << width << "x" << height << "x" << channels << ", " << batchSize << " samples" << endl;
+
+    auto geometry = make_shared<ConvolveGeometry>(TensorShape(width, height, channels), TensorShape(window, window, 1), TensorShape(1), TensorShape(stride, stride, 1),
+                                                  ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{pad, pad, false}, TensorShape(0), TensorShape(0));
+    ConvolveGeometry lookup(geometry->InputShape(), geometry->KernelShape(), geometry->MapCount(), geometry->Stride(),
+                            geometry->Sharing(), geometry->AutoPad(), geometry->LowerPad(), geometry->UpperPad());
+    lookup.ComputeConvGeometryExplicit();
+    Matrix<int> mpRowCol(lookup.MpRowCol().size(), 1, const_cast<int*>(lookup.MpRowCol().data()), CPUDEVICE);
+    Matrix<int> mpRowIndices(lookup.MpRowIndices().size(), 1, const_cast<int*>(lookup.MpRowIndices().data()), CPUDEVICE);
+    Matrix<int> indices(lookup.Indices().size(), 1, const_cast<int*>(lookup.Indices().data()), CPUDEVICE);
+
+    size_t inRows = geometry->InputShape().GetNumElements();
+    size_t outRows = geometry->OutputShape().GetNumElements();
+    Matrix<ElemType> in(inRows, batchSize, CPUDEVICE);
+    randomInitializeMatrix<ElemType>(in);
+    Matrix<ElemType> srcGrad(outRows, batchSize, CPUDEVICE);
+    randomInitializeMatrix<ElemType>(srcGrad);
+    Matrix<ElemType> out(outRows, batchSize, CPUDEVICE);
+    Matrix<ElemType> grad(inRows, batchSize, CPUDEVICE);
+
+    auto time = [&](const char* name, const std::function<void()>& f)
+    {
+        f(); // warm up
+        auto t_start = chrono::steady_clock::now();
+        for (int i = 0; i < count; ++i)
+            f();
+        auto t_end = chrono::steady_clock::now();
+        cout << name << ": " << chrono::duration<double, milli>(t_end - t_start).count() / count << " ms" << endl;
+    };
+
+    for (auto kind : { PoolKind::Max, PoolKind::Average })
+    {
+        const char* kindName = kind == PoolKind::Max ? "max" : "average";
+        auto engine = ConvolutionEngine<ElemType>::Create(geometry, CPUDEVICE, ImageLayoutKind::CHW, 0, kind, ConvolutionEngineKind::Reference);
+
+        cout << kindName << " forward" << endl;
+        time("  engine ", [&] { engine->ForwardPooling(in, out); });
+        if (kind == PoolKind::Max)
+            time("  lookup ", [&] { in.MaxPoolingForward(mpRowCol, mpRowIndices, indices, out); });
+        else
+            time("  lookup ", [&] { in.AveragePoolingForward(mpRowCol, mpRowIndices, indices, out, false); });
+
+        cout << kindName << " backward" << endl;
+        time("  engine ", [&] { engine->BackwardPooling(out, srcGrad, in, grad, false); });
+        if (kind == PoolKind::Max)
+            time("  lookup ", [&] { srcGrad.MaxPoolingBackward(out, in, mpRowCol, mpRowIndices, indices, grad, false); });
+        else
+            time("  lookup ", [&] { srcGrad.AveragePoolingBackward(mpRowCol, mpRowIndices, indices, grad, false, false); });
+    }
+}
+
+// Times the CPU products of a dense m x k matrix with a sparse k x n matrix over a sweep of densities of the
+// sparse factor from 0.01% to 10%, for the CSC and the CSR format, and the transposed product, against the
+// product with the densified sparse factor.
+template <class ElemType>
+void SparseDensitySweepTest(size_t m, size_t k, size_t n, int count)
+{
+    cout << "Dense " << m << "x" << k << " times sparse " << k << "x" << n << endl;
+
+    CPUMatrix<ElemType> dense(m, k);
+    randomInitializeCPUMatrix<ElemType>(dense, -1, 1);
+    CPUMatrix<ElemType> result(m, n);
+    CPUMatrix<ElemType> resultTransposed(n, m);
+
+    auto time = [&](const char* name, const std::function<void()>& f)
+    {
+        f(); // warm up
+        auto t_start = chrono::steady_clock::now();
+        for (int i = 0; i < count; ++i)
+            f();
+        auto t_end = chrono::steady_clock::now();
+        cout << name << ": " << chrono::duration<double, milli>(t_end - t_start).count() / count << " ms" << endl;
+    };
+
+    for (double density : { 0.0001, 0.001, 0.01, 0.03, 0.1 })
+    {
+        // the same nonzeros in CSC and CSR layout, and densified
+        CPUMatrix<ElemType> densified(k, n);
+        densified.SetValue(0);
+        vector<CPUSPARSE_INDEX_TYPE> colStarts(n + 1, 0), rowStarts(k + 1, 0);
+        for (size_t j = 0; j < n; ++j)
+        {
+            for (size_t i = 0; i < k; ++i)
+            {
+                if (rand() < density * RAND_MAX)
+                {
+                    densified(i, j) = (ElemType) rand() / RAND_MAX;
+                    colStarts[j + 1]++;
+                    rowStarts[i + 1]++;
+                }
+            }
+        }
+        std::partial_sum(colStarts.begin(), colStarts.end(), colStarts.begin());
+        std::partial_sum(rowStarts.begin(), rowStarts.end(), rowStarts.begin());
+        size_t nz = colStarts[n];
+        vector<CPUSPARSE_INDEX_TYPE> rows(nz), cols(nz), rowFill(rowStarts.begin(), rowStarts.end() - 1);
+        vector<ElemType> cscValues(nz), csrValues(nz);
+        for (size_t j = 0, p = 0; j < n; ++j)
+        {
+            for (size_t i = 0; i < k; ++i)
+            {
+                if (densified(i, j) != 0)
+                {
+                    rows[p] = (CPUSPARSE_INDEX_TYPE) i;
+                    cscValues[p++] = densified(i, j);
+                    cols[rowFill[i]] = (CPUSPARSE_INDEX_TYPE) j;
+                    csrValues[rowFill[i]++] = densified(i, j);
+                }
+            }
+        }
+
+        CPUSparseMatrix<ElemType> csc(matrixFormatSparseCSC);
+        csc.SetMatrixFromCSCFormat(colStarts.data(), rows.data(), cscValues.data(), nz, k, n);
+        CPUSparseMatrix<ElemType> csr(matrixFormatSparseCSR);
+        csr.RequireSizeAndAllocate(k, n, nz, matrixFormatSparseCSR, true, false);
+        // the compressed index must be set first, the other sizes are derived from it
+        memcpy(csr.SecondaryIndexLocation(), rowStarts.data(), sizeof(CPUSPARSE_INDEX_TYPE) * (k + 1));
+        memcpy(csr.MajorIndexLocation(), cols.data(), sizeof(CPUSPARSE_INDEX_TYPE) * nz);
+        memcpy(csr.Data(), csrValues.data(), sizeof(ElemType) * nz);
+
+        cout << "density " << density * 100 << "%, " << nz << " nonzeros" << endl;
+        time("  dense x CSC      ", [&] { CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(1, dense, false, csc, false, 0, result); });
+        time("  dense x CSR      ", [&] { CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(1, dense, false, csr, false, 0, result); });
+        time("  CSC' x dense'    ", [&] { CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(1, csc, true, dense, true, 0, resultTransposed); });
+        time("  CSR' x dense'    ", [&] { CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(1, csr, true, dense, true, 0, resultTransposed); });
+        time("  dense x densified", [&] { CPUMatrix<ElemType>::MultiplyAndWeightedAdd(1, dense, false, densified, false, 0, result); });
+    }
+}
+
+// The OpenMP teams of the 'spread' NUMA policy sum the data of their node. The buffers come from NumaPolicy::Alloc(),
+// either all on node 0, which is where the OS puts memory that the main thread touches first, or each on the node of
+// its team. In the first case, the reads of all but one node cross sockets.
+void NumaCrossSocketTest(size_t megabytesPerNode, int count)
+{
+    const size_t numNodes = NumaPolicy::NumNodes();
+    const size_t numThreads = omp_get_max_threads();
+    if (numNodes < 2 || numThreads < numNodes)
+    {
+        cout << "single NUMA node or fewer threads than nodes, nothing to compare" << endl;
+        return;
+    }
+    NumaPolicy::Apply(NumaPolicyMode::spread);
+    const size_t elementsPerNode = (megabytesPerNode << 20) / sizeof(double);
+
+    // the part of its node's buffer that the calling OpenMP thread works on, with the teams of NumaPolicy::Apply()
+    auto partOfThread = [&](const vector<double*>& buffers, double*& begin, double*& end)
+    {
+        size_t t = omp_get_thread_num();
+        size_t node = t * numNodes / numThreads;
+        size_t teamBegin = (node * numThreads + numNodes - 1) / numNodes;
+        size_t teamEnd = ((node + 1) * numThreads + numNodes - 1) / numNodes;
+        size_t partSize = (elementsPerNode + teamEnd - teamBegin - 1) / (teamEnd - teamBegin);
+        begin = buffers[node] + min(elementsPerNode, (t - teamBegin) * partSize);
+        end = buffers[node] + min(elementsPerNode, (t - teamBegin + 1) * partSize);
+    };
+
+    for (bool placeOnOwnNode : { false, true })
+    {
+        vector<double*> buffers(numNodes);
+        for (size_t node = 0; node < numNodes; node++)
+            buffers[node] = (double*) NumaPolicy::Alloc(elementsPerNode * sizeof(double), placeOnOwnNode ? node : 0);
+#pragma omp parallel
+        {
+            double *begin, *end;
+            partOfThread(buffers, begin, end);
+            fill(begin, end, 1.0);
+        }
+
+        double sum = 0;
+        auto t_start = chrono::steady_clock::now();
+        for (int i = 0; i < count; i++)
+        {
+#pragma omp parallel reduction(+ : sum)
+            {
+                double *begin, *end;
+                partOfThread(buffers, begin, end);
+                sum += accumulate(begin, end, 0.0);
+            }
+        }
+        auto t_end = chrono::steady_clock::now();
+        if (sum != (double) numNodes * count * elementsPerNode)
+            cout << "wrong sum " << sum << endl;
+
+        for (auto buffer : buffers)
+            NumaPolicy::Free(buffer);
+        double gigabytes = numNodes * count * elementsPerNode * sizeof(double) / 1e9;
+        cout << (placeOnOwnNode ? "node-local buffers" : "buffers on node 0") << ": "
+             << gigabytes / chrono::duration<double>(t_end - t_start).count() << " GB/s, "
+             << (placeOnOwnNode ? 0 : 100 * (numNodes - 1) / numNodes) << "% of the reads cross sockets" << endl;
+    }
+    NumaPolicy::Apply(NumaPolicyMode::none); // (the OpenMP threads stay bound)
+}
+
 int wmain()
 {
     // MandSTest<float>(100, 2);
@@ -353,7 +672,25 @@ int wmain()
     MultiplyAndWeightedAddTest<float>(11,10,12);    
     MultiplyAndWeightedAddTest<float>(110,100,120);    
     MultiplyAndWeightedAddTest<float>(1100,1000,1200);    
-    MultiplyAndWeightedAddTest<float>(11000,10000,12000);*/
+    MultiplyAndWeightedAddTest<float>(11000,10000,12000);
+
+    cout<<endl<<"********************Sparse embedding learner updates TEST********************"<<endl;
+    SparseEmbeddingLearnerTest<float>(1000000, 64, 1024, 20);
+    SparseEmbeddingLearnerTest<float>(10000000, 64, 1024, 10);
+    SparseEmbeddingLearnerTest<float>(50000000, 16, 1024, 10);
+
+    cout<<endl<<"********************CPU pooling TEST********************"<<endl;
+    PoolingTest<float>(112, 112, 64, 32, 2, 2, false, 20);
+    PoolingTest<float>(112, 112, 64, 32, 3, 2, true, 20);
+    PoolingTest<float>(56, 56, 128, 32, 3, 1, true, 20);
+    PoolingTest<float>(28, 28, 256, 32, 2, 2, false, 20);
+
+    cout<<endl<<"********************CPU sparse density sweep TEST********************"<<endl;
+    SparseDensitySweepTest<float>(256, 4096, 1024, 10);
+    SparseDensitySweepTest<float>(32, 100000, 256, 10);
+
+    cout<<endl<<"********************NUMA cross-socket reads TEST********************"<<endl;
+    NumaCrossSocketTest(64, 10);*/
 
     return 0;
 }
@@ -4,6 +4,7 @@
 //
 #include "stdafx.h"
 #include "../../../Source/Math/CPUMatrix.h"
+#include <limits>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -1215,6 +1216,104 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixGatherFromTarget, RandomSeedFixture)
     BOOST_CHECK(m2.IsEqualTo(expect, 1e-6));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixSampledLogSoftmax, RandomSeedFixture)
+{
+    const size_t dim = 5;
+    DMatrix hidden = DMatrix::RandomUniform(dim, 3, -1.0, 1.0, IncrementCounter());
+    DMatrix weights = DMatrix::RandomUniform(dim, 10, -1.0, 1.0, IncrementCounter());
+
+    // three segments, scored against hidden columns 2, 0 and 2, the last one with a repeated candidate
+    std::vector<size_t> hiddenColumns = { 2, 0, 2 };
+    std::vector<size_t> candidates = { 4, 5, 6, 0, 9, 3, 7, 7 };
+    std::vector<size_t> offsets = { 0, 3, 5, 8 };
+
+    DMatrix result;
+    result.AssignSampledLogSoftmax(hidden, hiddenColumns, weights, candidates, offsets);
+    BOOST_CHECK_EQUAL(result.GetNumRows(), 1);
+    BOOST_CHECK_EQUAL(result.GetNumCols(), candidates.size());
+
+    for (size_t k = 0; k < hiddenColumns.size(); k++)
+    {
+        std::vector<double> logits;
+        double sum = 0;
+        for (size_t j = offsets[k]; j < offsets[k + 1]; j++)
+        {
+            double logit = 0;
+            for (size_t i = 0; i < dim; i++)
+                logit += weights(i, candidates[j]) * hidden(i, hiddenColumns[k]);
+            logits.push_back(logit);
+            sum += exp(logit);
+        }
+        for (size_t j = offsets[k]; j < offsets[k + 1]; j++)
+            BOOST_CHECK_CLOSE(result(0, j), logits[j - offsets[k]] - log(sum), 1e-8);
+    }
+
+    // out-of-range candidates are rejected
+    candidates[0] = 10;
+    BOOST_CHECK_THROW(result.AssignSampledLogSoftmax(hidden, hiddenColumns, weights, candidates, offsets), std::invalid_argument);
+}
+
+// The columns are longer than a block of the softmax kernels, and the logits grow along them, so that the running max
+// is raised from block to block and the partial sums must be rescaled.
+BOOST_FIXTURE_TEST_CASE(CPUMatrixSoftmaxCrossEntropy, RandomSeedFixture)
+{
+    const size_t vocabSize = 5000, numCols = 4;
+    DMatrix logits = DMatrix::RandomUniform(vocabSize, numCols, -1.0, 1.0, IncrementCounter());
+    DMatrix labels(vocabSize, numCols);
+    labels.SetValue(0);
+    for (size_t j = 0; j < numCols; j++)
+        for (size_t i = 0; i < vocabSize; i++)
+            logits(i, j) += 20.0 * i / vocabSize;
+    labels(4321, 0) = 1;
+    labels(7, 1) = 1;
+    labels(10, 2) = 0.25; // soft labels
+    labels(4000, 2) = 0.75;
+    // column 3 has no label, like a gap
+
+    std::vector<double> expectedLogSumExp(numCols);
+    double expectedCrossEntropy = 0;
+    for (size_t j = 0; j < numCols; j++)
+    {
+        double maxLogit = logits(0, j), sum = 0;
+        for (size_t i = 0; i < vocabSize; i++)
+            maxLogit = std::max(maxLogit, logits(i, j));
+        for (size_t i = 0; i < vocabSize; i++)
+            sum += exp(logits(i, j) - maxLogit);
+        expectedLogSumExp[j] = maxLogit + log(sum);
+        for (size_t i = 0; i < vocabSize; i++)
+            expectedCrossEntropy -= labels(i, j) * (logits(i, j) - expectedLogSumExp[j]);
+    }
+
+    DMatrix logSoftmax;
+    logSoftmax.AssignLogSoftmaxOf(logits, true);
+    for (size_t j = 0; j < numCols; j++)
+        for (size_t i = 0; i < vocabSize; i += 499)
+            BOOST_CHECK_CLOSE(logSoftmax(i, j), logits(i, j) - expectedLogSumExp[j], 1e-8);
+
+    // the logits of a column without labels do not matter
+    logits(0, 3) = std::numeric_limits<double>::quiet_NaN();
+    DMatrix crossEntropy, logSumExp;
+    crossEntropy.AssignSoftmaxCrossEntropyOf(labels, logits, logSumExp);
+    BOOST_CHECK_EQUAL(logSumExp.GetNumCols(), numCols);
+    for (size_t j = 0; j < 3; j++)
+        BOOST_CHECK_CLOSE(logSumExp(0, j), expectedLogSumExp[j], 1e-10);
+    BOOST_CHECK_CLOSE(crossEntropy(0, 0), expectedCrossEntropy, 1e-8);
+
+    // c += alpha * (softmax - labels)
+    const double alpha = 0.5;
+    DMatrix gradient = DMatrix::RandomUniform(vocabSize, numCols, -1.0, 1.0, IncrementCounter());
+    DMatrix expectedGradient;
+    expectedGradient.SetValue(gradient.ColumnSlice(0, 3));
+    for (size_t j = 0; j < 3; j++)
+        for (size_t i = 0; i < vocabSize; i++)
+            expectedGradient(i, j) += alpha * (exp(logits(i, j) - expectedLogSumExp[j]) - labels(i, j));
+    DMatrix::AddSoftmaxCrossEntropyGradient(alpha, logits, logSumExp, labels, gradient);
+    BOOST_CHECK(gradient.ColumnSlice(0, 3).IsEqualTo(expectedGradient, 1e-12));
+
+    DMatrix wrongSize(vocabSize, numCols - 1);
+    BOOST_CHECK_THROW(crossEntropy.AssignSoftmaxCrossEntropyOf(wrongSize, logits, logSumExp), std::invalid_argument);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
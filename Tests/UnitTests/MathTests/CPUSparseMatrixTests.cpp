@@ -15,6 +15,46 @@ namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
 typedef CPUDoubleSparseMatrix SparseMatrix;
 typedef CPUDoubleMatrix DenseMatrix;
 
+// dense matrix with uniform random values in [0, 1] at about the given fraction of its elements, and zeros elsewhere
+static DenseMatrix RandomSparseDenseMatrix(size_t numRows, size_t numCols, double density, unsigned long seed)
+{
+    DenseMatrix dm(numRows, numCols);
+    dm.SetUniformRandomValue(1 - 1 / density, 1, seed);
+    dm.InplaceTruncateBottom(0);
+    return dm;
+}
+
+// sparse copy of the nonzero elements of a dense matrix
+static SparseMatrix ToSparse(const DenseMatrix& dm, MatrixFormat format)
+{
+    const bool isCSC = (format == MatrixFormat::matrixFormatSparseCSC);
+    const size_t numCompressed = isCSC ? dm.GetNumCols() : dm.GetNumRows();
+    const size_t numMajor = isCSC ? dm.GetNumRows() : dm.GetNumCols();
+    vector<CPUSPARSE_INDEX_TYPE> secondaryIndex(1, 0), majorIndex;
+    vector<double> values;
+    for (size_t j = 0; j < numCompressed; j++)
+    {
+        for (size_t i = 0; i < numMajor; i++)
+        {
+            double value = isCSC ? dm(i, j) : dm(j, i);
+            if (value != 0)
+            {
+                majorIndex.push_back((CPUSPARSE_INDEX_TYPE)i);
+                values.push_back(value);
+            }
+        }
+        secondaryIndex.push_back((CPUSPARSE_INDEX_TYPE)values.size());
+    }
+
+    SparseMatrix sm(format);
+    sm.RequireSizeAndAllocate(dm.GetNumRows(), dm.GetNumCols(), max(values.size(), (size_t)1), format, true, false);
+    // the compressed index must be set first, the number of nonzeros is derived from it
+    memcpy(sm.SecondaryIndexLocation(), secondaryIndex.data(), sizeof(CPUSPARSE_INDEX_TYPE) * secondaryIndex.size());
+    memcpy(sm.MajorIndexLocation(), majorIndex.data(), sizeof(CPUSPARSE_INDEX_TYPE) * majorIndex.size());
+    memcpy(sm.Data(), values.data(), sizeof(double) * values.size());
+    return sm;
+}
+
 BOOST_AUTO_TEST_SUITE(CPUMatrixSuite)
 
 BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixColumnSlice, RandomSeedFixture)
@@ -195,6 +235,264 @@ BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixOneHot, RandomSeedFixture)
     BOOST_CHECK(sm3(4, 3) == 1);
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixMultiplyAndWeightedAdd, RandomSeedFixture)
+{
+    // large enough for the products to be split into several tiles
+    const size_t m = 64;
+    const size_t k = 500;
+    const size_t n = 80;
+
+    for (auto format : {MatrixFormat::matrixFormatSparseCSC, MatrixFormat::matrixFormatSparseCSR})
+    {
+        for (int transposeA = 0; transposeA < 2; transposeA++)
+        {
+            for (int transposeB = 0; transposeB < 2; transposeB++)
+            {
+                DenseMatrix denseA(transposeA ? k : m, transposeA ? m : k);
+                denseA.SetUniformRandomValue(-1, 1, IncrementCounter());
+                DenseMatrix denseB(transposeB ? n : k, transposeB ? k : n);
+                denseB.SetUniformRandomValue(-1, 1, IncrementCounter());
+                DenseMatrix sparseValuesA = RandomSparseDenseMatrix(denseA.GetNumRows(), denseA.GetNumCols(), 0.1, IncrementCounter());
+                DenseMatrix sparseValuesB = RandomSparseDenseMatrix(denseB.GetNumRows(), denseB.GetNumCols(), 0.1, IncrementCounter());
+                SparseMatrix sparseA = ToSparse(sparseValuesA, format);
+                SparseMatrix sparseB = ToSparse(sparseValuesB, format);
+
+                DenseMatrix expected(m, n);
+                expected.SetUniformRandomValue(-1, 1, IncrementCounter());
+                DenseMatrix result(m, n);
+
+                // dense * sparse -> dense
+                result.SetValue(expected);
+                DenseMatrix::MultiplyAndWeightedAdd(0.5, denseA, transposeA != 0, sparseValuesB, transposeB != 0, 0.3, expected);
+                SparseMatrix::MultiplyAndWeightedAdd(0.5, denseA, transposeA != 0, sparseB, transposeB != 0, 0.3, result);
+                BOOST_CHECK(result.IsEqualTo(expected, c_epsilonFloatE4));
+
+                // sparse * dense -> dense
+                result.SetValue(expected);
+                DenseMatrix::MultiplyAndWeightedAdd(0.5, sparseValuesA, transposeA != 0, denseB, transposeB != 0, 1, expected);
+                SparseMatrix::MultiplyAndWeightedAdd(0.5, sparseA, transposeA != 0, denseB, transposeB != 0, 1, result);
+                BOOST_CHECK(result.IsEqualTo(expected, c_epsilonFloatE4));
+            }
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixMultiplyAndAddTransposed, RandomSeedFixture)
+{
+    const size_t m = 100;
+    const size_t k = 300;
+    const size_t n = 50;
+
+    for (auto format : {MatrixFormat::matrixFormatSparseCSC, MatrixFormat::matrixFormatSparseCSR})
+    {
+        for (int transposeA = 0; transposeA < 2; transposeA++)
+        {
+            for (int transposeB = 0; transposeB < 2; transposeB++)
+            {
+                DenseMatrix dm0(transposeA ? k : m, transposeA ? m : k);
+                dm0.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+                DenseMatrix dmMul(m, n);
+                SparseMatrix smMul(MatrixFormat::matrixFormatSparseBlockCol, m, n, 0);
+
+                // the second product adds to the blocks of the first one
+                for (double density : {0.01, 0.05})
+                {
+                    DenseMatrix dm1 = RandomSparseDenseMatrix(transposeB ? n : k, transposeB ? k : n, density, IncrementCounter());
+                    SparseMatrix sm1 = ToSparse(dm1, format);
+
+                    DenseMatrix::MultiplyAndAdd(dm0, transposeA != 0, dm1, transposeB != 0, dmMul);
+                    SparseMatrix::MultiplyAndAdd(1, dm0, transposeA != 0, sm1, transposeB != 0, smMul);
+
+                    foreach_coord (row, col, dmMul)
+                    {
+                        BOOST_CHECK(abs(smMul(row, col) - dmMul(row, col)) < c_epsilonFloatE4);
+                    }
+                }
+            }
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixInnerProduct, RandomSeedFixture)
+{
+    const size_t m = 1000;
+    const size_t n = 400;
+
+    for (auto format : {MatrixFormat::matrixFormatSparseCSC, MatrixFormat::matrixFormatSparseCSR})
+    {
+        DenseMatrix dm0 = RandomSparseDenseMatrix(m, n, 0.2, IncrementCounter());
+        SparseMatrix sm0 = ToSparse(dm0, format);
+        DenseMatrix dm1(m, n);
+        dm1.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+        for (bool isColWise : {true, false})
+        {
+            DenseMatrix expected;
+            DenseMatrix result;
+            DenseMatrix::InnerProduct(dm0, dm1, expected, isColWise);
+            SparseMatrix::InnerProduct(sm0, dm1, result, isColWise);
+            BOOST_CHECK(result.IsEqualTo(expected, c_epsilonFloatE4));
+        }
+
+        double expectedSum = DenseMatrix::InnerProductOfMatrices(dm0, dm1);
+        double sum = SparseMatrix::InnerProductOfMatrices(sm0, dm1);
+        BOOST_CHECK_CLOSE(sum, expectedSum, 1e-8);
+
+        // c += alpha * (a - b)
+        DenseMatrix expected(m, n);
+        expected.SetUniformRandomValue(-1, 1, IncrementCounter());
+        DenseMatrix result(expected);
+        DenseMatrix::AddScaledDifference(0.5, dm0, dm1, expected);
+        SparseMatrix::AddScaledDifference(0.5, sm0, dm1, result, false);
+        BOOST_CHECK(result.IsEqualTo(expected, c_epsilonFloatE4));
+
+        // c = alpha * (a - b)
+        DenseMatrix::AssignScaledDifference(0.5, dm1, dm0, expected);
+        SparseMatrix::AddScaledDifference(0.5, dm1, sm0, result, true);
+        BOOST_CHECK(result.IsEqualTo(expected, c_epsilonFloatE4));
+    }
+}
+
+// one-hot labels: the sparse kernels must agree with the dense ones
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixSoftmaxCrossEntropy, RandomSeedFixture)
+{
+    const size_t vocabSize = 3000, numCols = 50;
+    DenseMatrix logits(vocabSize, numCols);
+    logits.SetUniformRandomValue(-5, 5, IncrementCounter());
+    DenseMatrix labels(vocabSize, numCols);
+    labels.SetValue(0);
+    for (size_t j = 0; j < numCols; j++)
+        labels((j * 997 + 13) % vocabSize, j) = 1;
+    SparseMatrix sparseLabels = ToSparse(labels, MatrixFormat::matrixFormatSparseCSC);
+
+    DenseMatrix expectedCrossEntropy, expectedLogSumExp, logSumExp;
+    expectedCrossEntropy.AssignSoftmaxCrossEntropyOf(labels, logits, expectedLogSumExp);
+    double crossEntropy = SparseMatrix::SoftmaxCrossEntropy(sparseLabels, logits, logSumExp);
+    BOOST_CHECK_CLOSE(crossEntropy, expectedCrossEntropy(0, 0), 1e-8);
+    BOOST_CHECK(logSumExp.IsEqualTo(expectedLogSumExp, 1e-12));
+
+    double crossEntropyCSR = SparseMatrix::SoftmaxCrossEntropy(ToSparse(labels, MatrixFormat::matrixFormatSparseCSR), logits, logSumExp);
+    BOOST_CHECK_CLOSE(crossEntropyCSR, expectedCrossEntropy(0, 0), 1e-8);
+
+    DenseMatrix expectedGradient(vocabSize, numCols);
+    expectedGradient.SetUniformRandomValue(-1, 1, IncrementCounter());
+    DenseMatrix gradient(expectedGradient);
+    DenseMatrix::AddSoftmaxCrossEntropyGradient(0.5, logits, logSumExp, labels, expectedGradient);
+    SparseMatrix::AddSoftmaxCrossEntropyGradient(0.5, logits, logSumExp, sparseLabels, gradient);
+    BOOST_CHECK(gradient.IsEqualTo(expectedGradient, 1e-12));
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixCSRCopyColumnSliceToDense, RandomSeedFixture)
+{
+    const size_t m = 100;
+    DenseMatrix dm0 = RandomSparseDenseMatrix(m, m, 0.1, IncrementCounter());
+    for (size_t i = 0; i < m; i += 3)
+        dm0(i, i) = 1;
+    SparseMatrix sm0 = ToSparse(dm0, MatrixFormat::matrixFormatSparseCSR);
+
+    const size_t start = 10;
+    const size_t numCols = 20;
+    DenseMatrix dm1 = dm0.ColumnSlice(start, numCols);
+    DenseMatrix dm2 = sm0.CopyColumnSliceToDense(start, numCols);
+    BOOST_CHECK(dm1.IsEqualTo(dm2, c_epsilonFloatE4));
+
+    DenseMatrix diag = sm0.DiagonalToDense();
+    foreach_column (i, diag)
+    {
+        BOOST_CHECK_EQUAL(diag(0, i), dm0(i, i));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixSetValueFromDense, RandomSeedFixture)
+{
+    const size_t m = 70, n = 40;
+    DenseMatrix dm = RandomSparseDenseMatrix(m, n, 0.1, IncrementCounter());
+    for (auto format : { MatrixFormat::matrixFormatSparseCSC, MatrixFormat::matrixFormatSparseCSR })
+    {
+        SparseMatrix sm(format);
+        sm.SetValue(dm);
+        BOOST_CHECK(sm.GetFormat() == format);
+        BOOST_CHECK(sm.CopyColumnSliceToDense(0, n).IsEqualTo(dm, 0));
+        foreach_coord (row, col, dm)
+            BOOST_CHECK_EQUAL(sm(row, col), dm(row, col));
+    }
+}
+
+// the diagonal of a matrix with nonzeros is inserted in sorted position, or replaces an existing diagonal element
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixSetDiagonalValueOfNonEmpty, RandomSeedFixture)
+{
+    const size_t m = 60;
+    DenseMatrix dm = RandomSparseDenseMatrix(m, m, 0.1, IncrementCounter());
+    for (size_t i = 0; i < m; i += 4)
+        dm(i, i) = 1;
+    DenseMatrix diag(1, m);
+    diag.SetUniformRandomValue(1, 2, IncrementCounter());
+    DenseMatrix expected(dm);
+    for (size_t i = 0; i < m; i++)
+        expected(i, i) = diag(0, i);
+
+    for (auto format : { MatrixFormat::matrixFormatSparseCSC, MatrixFormat::matrixFormatSparseCSR })
+    {
+        SparseMatrix sm = ToSparse(dm, format);
+        sm.SetDiagonalValue(diag);
+        BOOST_CHECK(sm.CopyColumnSliceToDense(0, m).IsEqualTo(expected, 0));
+        BOOST_CHECK_EQUAL(sm.NzCount(), ToSparse(expected, format).NzCount());
+        for (size_t j = 0; j < m; j++)
+            for (size_t p = sm.SecondaryIndexLocation()[j] + 1; p < sm.SecondaryIndexLocation()[j + 1]; p++)
+                BOOST_CHECK(sm.MajorIndexLocation()[p] > sm.MajorIndexLocation()[p - 1]);
+
+        sm.SetDiagonalValue(3.0);
+        for (size_t i = 0; i < m; i++)
+            expected(i, i) = 3;
+        BOOST_CHECK(sm.CopyColumnSliceToDense(0, m).IsEqualTo(expected, 0));
+        for (size_t i = 0; i < m; i++)
+            expected(i, i) = diag(0, i);
+    }
+}
+
+// gathering and scattering into existing values (beta != 0) and scattering with repeated targets against the dense kernels
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixGatherScatterWithBeta, RandomSeedFixture)
+{
+    const size_t m = 50, n = 30;
+    const double alpha = 0.7, beta = 0.3;
+    DenseMatrix a = RandomSparseDenseMatrix(m, n, 0.2, IncrementCounter());
+    DenseMatrix target = RandomSparseDenseMatrix(m, n, 0.2, IncrementCounter());
+
+    std::vector<double> indexValue(n);
+    for (size_t j = 0; j < n; j++)
+        indexValue[j] = j % 5 ? (double)((j * 7) % n) : -1;
+    DenseMatrix index(1, n, indexValue.data());
+
+    DenseMatrix expected(target);
+    expected.DoGatherColumnsOf(beta, index, a, alpha);
+    SparseMatrix sm = ToSparse(target, MatrixFormat::matrixFormatSparseCSC);
+    sm.DoGatherColumnsOf(beta, index, ToSparse(a, MatrixFormat::matrixFormatSparseCSC), alpha);
+    BOOST_CHECK(sm.CopyColumnSliceToDense(0, n).IsEqualTo(expected, 1e-12));
+
+    // every target column twice
+    for (size_t j = 0; j < n; j++)
+        indexValue[j] = j % 7 ? (double)(j / 2) : -1;
+    DenseMatrix dupIndex(1, n, indexValue.data());
+    DenseMatrix zeros(m, n);
+    zeros.SetValue(0);
+    for (double b : { 0.0, beta })
+    {
+        DenseMatrix expectedScatter(target);
+        expectedScatter.DoScatterColumnsOf(b, dupIndex, a, alpha);
+        SparseMatrix smScatter = ToSparse(b != 0 ? target : zeros, MatrixFormat::matrixFormatSparseCSC); // beta == 0 requires an empty target
+        smScatter.DoScatterColumnsOf(b, dupIndex, ToSparse(a, MatrixFormat::matrixFormatSparseCSC), alpha);
+        BOOST_CHECK(smScatter.CopyColumnSliceToDense(0, n).IsEqualTo(expectedScatter, 1e-12));
+    }
+
+    // with beta == 0, existing values are an error rather than silently dropped, with or without repeated targets
+    for (const auto& scatterIndex : { index, dupIndex })
+    {
+        SparseMatrix smScatter = ToSparse(target, MatrixFormat::matrixFormatSparseCSC);
+        BOOST_CHECK_THROW(smScatter.DoScatterColumnsOf(0, scatterIndex, ToSparse(a, MatrixFormat::matrixFormatSparseCSC), alpha), std::invalid_argument);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
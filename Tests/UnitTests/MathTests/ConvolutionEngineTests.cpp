@@ -174,6 +174,34 @@ std::vector<ConvolveGeometryPtr> GenerateConvTestConfigs()
     return res;
 }
 
+// Geometries supported by the direct engine (2D, full sharing). Besides the common configs this
+// adds larger 3x3 stride-1 convolutions which go through the Winograd F(4x4, 3x3) path.
+std::vector<ConvolveGeometryPtr> GenerateDirectConvTestConfigs()
+{
+    std::vector<ConvolveGeometryPtr> res;
+    for (const auto& g : GenerateConvTestConfigs())
+    {
+        if (g->InputShape().GetRank() == 3)
+            res.push_back(g);
+    }
+    for (size_t inC : {1, 4, 8})
+    {
+        for (bool autoPad : {false, true})
+        {
+            res.push_back(std::make_shared<ConvolveGeometry>(TensorShape(17, 13, inC),
+                TensorShape(3, 3, inC), TensorShape(6), TensorShape(1, 1, inC),
+                ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{autoPad, autoPad, false},
+                TensorShape(0), TensorShape(0)));
+        }
+    }
+    // Even kernel, explicit asymmetric padding.
+    res.push_back(std::make_shared<ConvolveGeometry>(TensorShape(12, 10, 3),
+        TensorShape(4, 2, 3), TensorShape(4), TensorShape(1, 1, 3),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{false},
+        TensorShape(1, 0, 0), TensorShape(2, 1, 0)));
+    return res;
+}
+
 std::vector<ConvolveGeometryPtr> GeneratePoolTestConfigs()
 {
     std::vector<ConvolveGeometryPtr> res;
@@ -421,6 +449,297 @@ BOOST_AUTO_TEST_CASE(ConvolutionBackwardKernel)
     }
 }
 
+// The direct engine is CPU-only, so it is compared against the CPU reference engine rather than cuDNN.
+BOOST_AUTO_TEST_CASE(DirectConvolution)
+{
+    std::mt19937 rng(0);
+    boost::random::uniform_int_distribution<> batchSizeG(1, 8);
+    boost::random::normal_distribution<float> nd;
+
+    auto initMat = [&](SingleMatrix& buf, size_t r, size_t c, vec& data) -> SingleMatrix
+    {
+        data.resize(r * 3 * c);
+        std::fill(begin(data), end(data), std::numeric_limits<float>::quiet_NaN());
+        std::generate(begin(data) + r * c, begin(data) + 2 * r * c, [&] { return nd(rng); });
+        buf.SetValue(r, 3 * c, buf.GetDeviceId(), data.data());
+        // Get center slice.
+        return buf.ColumnSlice(c, c);
+    };
+
+    int deviceId = -1;
+    for (size_t maxTempMem : {0, 1, 3})
+    {
+        for (const auto& g : GenerateDirectConvTestConfigs())
+        {
+            auto baseEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Reference);
+            auto testEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, maxTempMem, PoolKind::None, ConvolutionEngineKind::Direct);
+
+            size_t n = batchSizeG(rng);
+            vec buf;
+            buf.resize(g->InputShape().GetNumElements() * n);
+            std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+            SingleMatrix in(g->InputShape().GetNumElements(), n, buf.data(), deviceId, matrixFlagNormal);
+
+            buf.resize(g->OutputShape().GetNumElements() * n);
+            std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+            SingleMatrix srcGrad(g->OutputShape().GetNumElements(), n, buf.data(), deviceId, matrixFlagNormal);
+
+            size_t mapCount = g->GetMapCount(g->InputShape().GetRank() - 1);
+            buf.resize(g->KernelShape().GetNumElements() * mapCount);
+            std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+            SingleMatrix kernel(mapCount, g->KernelShape().GetNumElements(), buf.data(), deviceId, matrixFlagNormal);
+
+            size_t crowOut = g->OutputShape().GetNumElements();
+            SingleMatrix outBuf(deviceId);
+            SingleMatrix out = initMat(outBuf, crowOut, n, buf);
+            SingleMatrix outB(out.DeepClone(), deviceId);
+
+            size_t crowGrad = g->InputShape().GetNumElements();
+            SingleMatrix gradBuf(deviceId);
+            SingleMatrix grad = initMat(gradBuf, crowGrad, n, buf);
+            SingleMatrix gradB(grad.DeepClone(), deviceId);
+
+            SingleMatrix kernelGradBuf(deviceId);
+            SingleMatrix kernelGrad = initMat(kernelGradBuf, mapCount, g->KernelShape().GetNumElements(), buf);
+            SingleMatrix kernelGradB(kernelGrad.DeepClone(), deviceId);
+
+            SingleMatrix workspace(deviceId);
+            SingleMatrix workspaceB(deviceId);
+
+            testEng->Forward(in, kernel, out, workspace);
+            baseEng->Forward(in, kernel, outB, workspaceB);
+            testEng->BackwardData(srcGrad, kernel, grad, true, workspace);
+            baseEng->BackwardData(srcGrad, kernel, gradB, true, workspaceB);
+            testEng->BackwardKernel(srcGrad, in, kernelGrad, true, false, workspace);
+            baseEng->BackwardKernel(srcGrad, in, kernelGradB, true, false, workspaceB);
+
+            std::stringstream tmsg;
+            tmsg << "Geometry: " << (std::string)(*g) << ", Batch: " << n << ", MaxTempMem: " << maxTempMem;
+            std::string msg = " are not equal, " + tmsg.str();
+            std::string msgNan = " has NaNs, " + tmsg.str();
+            std::string msgNotNan = " has buffer overflow/underflow, " + tmsg.str();
+
+            float relErr = Err<float>::Rel;
+            float absErr = Err<float>::Abs;
+            // Forward and backward data of 3x3 stride-1 convolutions go through Winograd F(4x4, 3x3), whose transforms
+            // amplify rounding errors: up to ~1.5e-4 absolute for 8 channels of unit normal data (about Abs * 1300).
+            bool winograd = g->KernelShape()[0] == 3 && g->KernelShape()[1] == 3 && g->GetStride(0) == 1 && g->GetStride(1) == 1;
+            float dataRelErr = winograd ? relErr * 100 : relErr * 16;
+            float dataAbsErr = winograd ? absErr * 2048 : absErr * 16;
+            std::string emsg;
+
+            BOOST_REQUIRE_MESSAGE(!out.HasNan("out"), "out" << msgNan);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(out, outB, emsg, dataRelErr, dataAbsErr), "out" << msg << ". " << emsg);
+            BOOST_REQUIRE_MESSAGE(CountNans(outBuf) == crowOut * 2 * n, "out" << msgNotNan);
+
+            BOOST_REQUIRE_MESSAGE(!grad.HasNan("grad"), "grad" << msgNan);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(grad, gradB, emsg, dataRelErr, dataAbsErr), "grad" << msg << ". " << emsg);
+            BOOST_REQUIRE_MESSAGE(CountNans(gradBuf) == crowGrad * 2 * n, "grad" << msgNotNan);
+
+            // Kernel gradients sum over the whole minibatch, same tolerance as in ConvolutionBackwardKernel.
+            BOOST_REQUIRE_MESSAGE(!kernelGrad.HasNan("kernelGrad"), "kernelGrad" << msgNan);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(kernelGrad, kernelGradB, emsg, relErr * 192, absErr * 32), "kernelGrad" << msg << ". " << emsg);
+            BOOST_REQUIRE_MESSAGE(CountNans(kernelGradBuf) == kernelGrad.GetNumElements() * 2, "kernelGrad" << msgNotNan);
+        }
+    }
+}
+
+// The reference engine does not support groups, so grouped and depthwise convolutions of the direct engine
+// are compared against one reference convolution per group.
+BOOST_AUTO_TEST_CASE(GroupedDirectConvolution)
+{
+    std::mt19937 rng(0);
+    boost::random::uniform_int_distribution<> batchSizeG(1, 8);
+    boost::random::normal_distribution<float> nd;
+
+    auto randomVec = [&](size_t size) -> vec
+    {
+        vec data(size);
+        std::generate(begin(data), end(data), [&] { return nd(rng); });
+        return data;
+    };
+    // Copies rows [first, first + count) of a column-major [rows x n] buffer.
+    auto sliceRows = [](const vec& data, size_t rows, size_t n, size_t first, size_t count) -> vec
+    {
+        vec res(count * n);
+        for (size_t j = 0; j < n; j++)
+            std::copy(data.begin() + j * rows + first, data.begin() + j * rows + first + count, res.begin() + j * count);
+        return res;
+    };
+
+    int deviceId = -1;
+    // (input channels, output maps, groups, kernel size, stride)
+    std::vector<std::array<size_t, 5>> configs = {
+        {8, 8, 8, 3, 1}, {8, 8, 8, 3, 2}, {6, 6, 6, 5, 1}, // depthwise
+        {4, 6, 2, 3, 1}, {12, 6, 3, 3, 2}, {8, 16, 4, 1, 1}, {6, 12, 6, 3, 1} // grouped
+    };
+    for (const auto& cfg : configs)
+    {
+        size_t inC = cfg[0], mapCount = cfg[1], groups = cfg[2], kW = cfg[3], stride = cfg[4];
+        size_t groupC = inC / groups, groupK = mapCount / groups;
+        for (bool autoPad : {false, true})
+        {
+            auto g = std::make_shared<ConvolveGeometry>(TensorShape(11, 9, inC),
+                TensorShape(kW, kW, groupC), TensorShape(mapCount), TensorShape(stride, stride, inC),
+                ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{autoPad, autoPad, false},
+                TensorShape(0), TensorShape(0), TensorShape(1), false, groups);
+            auto gg = std::make_shared<ConvolveGeometry>(TensorShape(11, 9, groupC),
+                TensorShape(kW, kW, groupC), TensorShape(groupK), TensorShape(stride, stride, groupC),
+                ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{autoPad, autoPad, false},
+                TensorShape(0), TensorShape(0));
+
+            auto testEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Direct);
+            auto baseEng = ConvEng::Create(gg, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Reference);
+
+            size_t n = batchSizeG(rng);
+            size_t inRows = g->InputShape().GetNumElements();
+            size_t outRows = g->OutputShape().GetNumElements();
+            size_t kernelSize = g->KernelShape().GetNumElements();
+            size_t groupInRows = inRows / groups, groupOutRows = outRows / groups;
+
+            vec inData = randomVec(inRows * n);
+            vec kernelData = randomVec(kernelSize * mapCount);
+            vec srcGradData = randomVec(outRows * n);
+            vec gradData = randomVec(inRows * n);
+            vec kernelGradData = randomVec(kernelSize * mapCount);
+
+            SingleMatrix in(inRows, n, inData.data(), deviceId, matrixFlagNormal);
+            SingleMatrix kernel(mapCount, kernelSize, kernelData.data(), deviceId, matrixFlagNormal);
+            SingleMatrix srcGrad(outRows, n, srcGradData.data(), deviceId, matrixFlagNormal);
+            SingleMatrix out(outRows, n, deviceId);
+            SingleMatrix grad(inRows, n, gradData.data(), deviceId, matrixFlagNormal);
+            SingleMatrix kernelGrad(mapCount, kernelSize, kernelGradData.data(), deviceId, matrixFlagNormal);
+            SingleMatrix workspace(deviceId);
+
+            testEng->Forward(in, kernel, out, workspace);
+            testEng->BackwardData(srcGrad, kernel, grad, true, workspace);
+            testEng->BackwardKernel(srcGrad, in, kernelGrad, true, false, workspace);
+
+            vec outExpected(outRows * n), gradExpected(inRows * n), kernelGradExpected(kernelSize * mapCount);
+            for (size_t group = 0; group < groups; group++)
+            {
+                vec inG = sliceRows(inData, inRows, n, group * groupInRows, groupInRows);
+                vec srcGradG = sliceRows(srcGradData, outRows, n, group * groupOutRows, groupOutRows);
+                vec gradG = sliceRows(gradData, inRows, n, group * groupInRows, groupInRows);
+                SingleMatrix inB(groupInRows, n, inG.data(), deviceId, matrixFlagNormal);
+                SingleMatrix kernelB(groupK, kernelSize, kernelData.data() + group * groupK * kernelSize, deviceId, matrixFlagNormal);
+                SingleMatrix srcGradB(groupOutRows, n, srcGradG.data(), deviceId, matrixFlagNormal);
+                SingleMatrix outB(groupOutRows, n, deviceId);
+                SingleMatrix gradB(groupInRows, n, gradG.data(), deviceId, matrixFlagNormal);
+                SingleMatrix kernelGradB(groupK, kernelSize, kernelGradData.data() + group * groupK * kernelSize, deviceId, matrixFlagNormal);
+                SingleMatrix workspaceB(deviceId);
+
+                baseEng->Forward(inB, kernelB, outB, workspaceB);
+                baseEng->BackwardData(srcGradB, kernelB, gradB, true, workspaceB);
+                baseEng->BackwardKernel(srcGradB, inB, kernelGradB, true, false, workspaceB);
+
+                for (size_t j = 0; j < n; j++)
+                {
+                    for (size_t i = 0; i < groupOutRows; i++)
+                        outExpected[j * outRows + group * groupOutRows + i] = outB(i, j);
+                    for (size_t i = 0; i < groupInRows; i++)
+                        gradExpected[j * inRows + group * groupInRows + i] = gradB(i, j);
+                }
+                std::copy(kernelGradB.Data(), kernelGradB.Data() + groupK * kernelSize, kernelGradExpected.begin() + group * groupK * kernelSize);
+            }
+
+            std::stringstream tmsg;
+            tmsg << "Geometry: " << (std::string)(*g) << ", Groups: " << groups << ", Batch: " << n;
+            std::string msg = " are not equal, " + tmsg.str();
+
+            float relErr = Err<float>::Rel * 100;
+            float absErr = Err<float>::Abs * 8192;
+            std::string emsg;
+
+            SingleMatrix outB(outRows, n, outExpected.data(), deviceId, matrixFlagNormal);
+            SingleMatrix gradB(inRows, n, gradExpected.data(), deviceId, matrixFlagNormal);
+            SingleMatrix kernelGradB(mapCount, kernelSize, kernelGradExpected.data(), deviceId, matrixFlagNormal);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(out, outB, emsg, relErr, absErr), "out" << msg << ". " << emsg);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(grad, gradB, emsg, relErr, absErr), "grad" << msg << ". " << emsg);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(kernelGrad, kernelGradB, emsg, relErr, absErr), "kernelGrad" << msg << ". " << emsg);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(AutotunedConvolution)
+{
+    std::mt19937 rng(0);
+    boost::random::normal_distribution<float> nd;
+
+    const std::wstring cacheFile = L"ConvolutionAutotuning.cache";
+    _wunlink(cacheFile.c_str());
+    // an entry of another machine that shares the file, which must survive the rewrites of the file
+    FILE* other = _wfopen(cacheFile.c_str(), L"w");
+    BOOST_REQUIRE(other != nullptr);
+    fprintf(other, "Another CPU\tAnother geometry\tGemm\n");
+    fclose(other);
+    SetCpuConvolutionAutotuning(true, cacheFile);
+
+    int deviceId = -1;
+    size_t n = 4;
+    auto g = std::make_shared<ConvolveGeometry>(TensorShape(12, 10, 3),
+        TensorShape(3, 3, 3), TensorShape(5), TensorShape(1, 1, 3),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false},
+        TensorShape(0), TensorShape(0));
+
+    vec buf(g->InputShape().GetNumElements() * n);
+    std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+    SingleMatrix in(g->InputShape().GetNumElements(), n, buf.data(), deviceId, matrixFlagNormal);
+
+    size_t mapCount = g->GetMapCount(g->InputShape().GetRank() - 1);
+    buf.resize(g->KernelShape().GetNumElements() * mapCount);
+    std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+    SingleMatrix kernel(mapCount, g->KernelShape().GetNumElements(), buf.data(), deviceId, matrixFlagNormal);
+
+    buf.resize(g->OutputShape().GetNumElements() * n);
+    std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+    SingleMatrix srcGrad(g->OutputShape().GetNumElements(), n, buf.data(), deviceId, matrixFlagNormal);
+
+    auto baseEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Reference);
+    SingleMatrix outB(g->OutputShape().GetNumElements(), n, deviceId);
+    SingleMatrix gradB(g->InputShape().GetNumElements(), n, deviceId);
+    gradB.SetValue(1);
+    SingleMatrix workspaceB(deviceId);
+    baseEng->Forward(in, kernel, outB, workspaceB);
+    baseEng->BackwardData(srcGrad, kernel, gradB, true, workspaceB);
+
+    // The first engine measures and stores its choices, the second one finds them in the cache file.
+    for (int i = 0; i < 2; i++)
+    {
+        // Switching cache files drops the choices held in memory, so the second pass has to reload them.
+        if (i == 1)
+            SetCpuConvolutionAutotuning(true, L"");
+        SetCpuConvolutionAutotuning(true, cacheFile);
+
+        auto testEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::All);
+        SingleMatrix out(g->OutputShape().GetNumElements(), n, deviceId);
+        SingleMatrix grad(g->InputShape().GetNumElements(), n, deviceId);
+        grad.SetValue(1);
+        SingleMatrix workspace(deviceId);
+        testEng->Forward(in, kernel, out, workspace);
+        // Trial runs must not leak into the accumulated gradients.
+        testEng->BackwardData(srcGrad, kernel, grad, true, workspace);
+
+        std::string emsg;
+        BOOST_REQUIRE_MESSAGE(CheckEqual(out, outB, emsg, Err<float>::Rel * 100, Err<float>::Abs * 8192), "out are not equal. " << emsg);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(grad, gradB, emsg, Err<float>::Rel * 100, Err<float>::Abs * 8192), "grad are not equal. " << emsg);
+    }
+
+    // One line per tuned pass, besides the entry of the other machine. The reference engine is never chosen.
+    FILE* f = _wfopen(cacheFile.c_str(), L"r");
+    BOOST_REQUIRE(f != nullptr);
+    std::string content;
+    for (int c = fgetc(f); c != EOF; c = fgetc(f))
+        content += (char)c;
+    fclose(f);
+    BOOST_REQUIRE_EQUAL(std::count(content.begin(), content.end(), '\n'), 3);
+    BOOST_CHECK(content.find("Another CPU\tAnother geometry\tGemm\n") != std::string::npos);
+    BOOST_CHECK(content.find("Reference") == std::string::npos);
+
+    SetCpuConvolutionAutotuning(false, L"");
+    _wunlink(cacheFile.c_str());
+}
+
 BOOST_AUTO_TEST_CASE(PoolingForward)
 {
     std::mt19937 rng(0);
@@ -642,6 +961,110 @@ BOOST_AUTO_TEST_CASE(MaxUnpooling)
     }
 }
 
+// The reference engine runs 2D CPU pooling through dedicated window kernels. Compare them with the
+// generic lookup-based implementation, with and without padding and with many ties in the input
+// (values are quantized) since the max pooling gradient and unpooling must pick the same cell.
+BOOST_AUTO_TEST_CASE(CpuPooling2D)
+{
+    using IntMatrix = Matrix<int>;
+
+    std::mt19937 rng(0);
+    boost::random::uniform_int_distribution<> batchSizeG(1, 8);
+    boost::random::uniform_int_distribution<> valueG(-4, 4);
+
+    int deviceId = -1;
+    auto configs = GeneratePoolTestConfigs();
+    for (const auto& g : GeneratePoolTestConfigs())
+    {
+        if (g->KernelShape()[0] > 1 && g->KernelShape()[1] > 1)
+        {
+            // Same windows without padding.
+            configs.push_back(std::make_shared<ConvolveGeometry>(g->InputShape(), g->KernelShape(), g->MapCount(), g->Stride(),
+                ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{false}, TensorShape(0), TensorShape(0)));
+        }
+    }
+    // Wider rows for the 2x2 and 3x3 row kernels, which only handle the columns whose window is inside the input.
+    for (size_t k : {2, 3})
+    {
+        for (size_t stride : {1, 2})
+        {
+            for (bool autoPad : {false, true})
+            {
+                configs.push_back(std::make_shared<ConvolveGeometry>(TensorShape(19, 7, 2), TensorShape(k, k, 1), TensorShape(1), TensorShape(stride, stride, 1),
+                    ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{autoPad, autoPad, false}, TensorShape(0), TensorShape(0)));
+            }
+        }
+    }
+
+    for (const auto& g : configs)
+    {
+        // Separate copy of the geometry for the lookup tables.
+        ConvolveGeometry lookup(g->InputShape(), g->KernelShape(), g->MapCount(), g->Stride(), g->Sharing(), g->AutoPad(), g->LowerPad(), g->UpperPad());
+        lookup.ComputeConvGeometryExplicit();
+        IntMatrix mpRowCol(lookup.MpRowCol().size(), 1, const_cast<int*>(lookup.MpRowCol().data()), deviceId);
+        IntMatrix mpRowIndices(lookup.MpRowIndices().size(), 1, const_cast<int*>(lookup.MpRowIndices().data()), deviceId);
+        IntMatrix indices(lookup.Indices().size(), 1, const_cast<int*>(lookup.Indices().data()), deviceId);
+
+        size_t n = batchSizeG(rng);
+        size_t crowIn = g->InputShape().GetNumElements();
+        size_t crowOut = g->OutputShape().GetNumElements();
+        vec buf(crowIn * n);
+        std::generate(begin(buf), end(buf), [&] { return valueG(rng) * 0.5f; });
+        SingleMatrix in(crowIn, n, buf.data(), deviceId, matrixFlagNormal);
+        buf.resize(crowOut * n);
+        std::generate(begin(buf), end(buf), [&] { return valueG(rng) * 0.5f; });
+        SingleMatrix srcGrad(crowOut, n, buf.data(), deviceId, matrixFlagNormal);
+
+        for (auto kind : {PoolKind::Max, PoolKind::Average})
+        {
+            for (bool includePad : {false, true})
+            {
+                if (kind == PoolKind::Max && includePad)
+                    continue;
+
+                auto eng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, kind, ConvolutionEngineKind::Reference, L"", false, includePad);
+
+                std::stringstream tmsg;
+                tmsg << "Geometry: " << (std::string)(*g) << ", Pool: " << (int)kind << ", IncludePad: " << includePad << ", Batch: " << n;
+                std::string msg = " are not equal, " + tmsg.str();
+                std::string emsg;
+
+                SingleMatrix out(crowOut, n, deviceId);
+                SingleMatrix outB(crowOut, n, deviceId);
+                eng->ForwardPooling(in, out);
+                if (kind == PoolKind::Max)
+                    in.MaxPoolingForward(mpRowCol, mpRowIndices, indices, outB);
+                else
+                    in.AveragePoolingForward(mpRowCol, mpRowIndices, indices, outB, includePad);
+                BOOST_REQUIRE_MESSAGE(CheckEqual(out, outB, emsg, Err<float>::Rel, Err<float>::Abs), "out" << msg << ". " << emsg);
+
+                for (bool accumulate : {false, true})
+                {
+                    SingleMatrix grad(crowIn, n, deviceId);
+                    grad.SetValue(1);
+                    SingleMatrix gradB(grad.DeepClone(), deviceId);
+                    eng->BackwardPooling(out, srcGrad, in, grad, accumulate);
+                    if (kind == PoolKind::Max)
+                        srcGrad.MaxPoolingBackward(outB, in, mpRowCol, mpRowIndices, indices, gradB, accumulate);
+                    else
+                        srcGrad.AveragePoolingBackward(mpRowCol, mpRowIndices, indices, gradB, includePad, accumulate);
+                    BOOST_REQUIRE_MESSAGE(CheckEqual(grad, gradB, emsg, Err<float>::Rel, Err<float>::Abs), "grad" << msg << ". " << emsg);
+                }
+
+                if (kind == PoolKind::Max)
+                {
+                    SingleMatrix inU(crowIn, n, deviceId);
+                    inU.SetValue(0);
+                    SingleMatrix inUB(inU.DeepClone(), deviceId);
+                    eng->MaxUnpooling(out, in, inU);
+                    outB.MaxUnpooling(mpRowCol, mpRowIndices, indices, in, inUB);
+                    BOOST_REQUIRE_MESSAGE(CheckEqual(inU, inUB, emsg, 0.0f, 0.0f), "inU" << msg << ". " << emsg);
+                }
+            }
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE(Half_ConvolutionSuite)
@@ -4,6 +4,7 @@
 //
 #include "stdafx.h"
 #include <math.h>
+#include <algorithm>
 #ifdef _WIN32
 #include <crtdefs.h>
 #endif 
@@ -60,20 +61,73 @@ public:
         timestamps = SingleMatrix::RandomGaussian(1, dim2, c_deviceIdZero, -1.0f, 1.0f, IncrementCounter());
     }
 
+    void MoveToDevice(int deviceId)
+    {
+        matSG.TransferToDeviceIfNotThere(deviceId, true);
+        matSGsparse.TransferToDeviceIfNotThere(deviceId, true);
+        matM.TransferToDeviceIfNotThere(deviceId, true);
+        matMsparse.TransferToDeviceIfNotThere(deviceId, true);
+        matG.TransferToDeviceIfNotThere(deviceId, true);
+        matGsparseBSC.TransferToDeviceIfNotThere(deviceId, true);
+        timestamps.TransferToDeviceIfNotThere(deviceId, true);
+    }
+
     void RunOnDevices(std::function<void()> func)
     {
         for (int deviceId : {-1, 0})
         {
-            matSG.TransferToDeviceIfNotThere(deviceId, true);
-            matSGsparse.TransferToDeviceIfNotThere(deviceId, true);
-            matM.TransferToDeviceIfNotThere(deviceId, true);
-            matMsparse.TransferToDeviceIfNotThere(deviceId, true);
-            matG.TransferToDeviceIfNotThere(deviceId, true);
-            matGsparseBSC.TransferToDeviceIfNotThere(deviceId, true);
-            timestamps.TransferToDeviceIfNotThere(deviceId, true);
+            MoveToDevice(deviceId);
             func();
         }
     }
+
+    // Runs a learner for four minibatches: the dense one sees the gradient in the first and the third and
+    // a zero gradient in the second and the fourth, while the sparse one is only run on the first and the third
+    // with lazy updates through timestamps and then flushed. The smoothed states are compared after
+    // the first step and after the flush; the models only after the first step, since the lazy updates do
+    // not replay the model changes driven by the smoothed state of the skipped minibatches.
+    void RunLazySparseOnCPU(std::function<void(SingleMatrix& gradient, SingleMatrix& state, SingleMatrix& model, int* ts, const LazyDecayHistory* history)> update,
+                            const std::vector<double>& decayRates, float sparseStateScale = 1.0f)
+    {
+        MoveToDevice(CPUDEVICE);
+        matMsparse.AssignValuesOf(matM);
+        SingleMatrix state(CPUDEVICE), stateSparse(CPUDEVICE);
+        SingleMatrix zero(dim1, dim2, CPUDEVICE);
+        zero.SetValue(0.0f);
+        state.AssignValuesOf(zero);
+        stateSparse.AssignValuesOf(zero);
+        std::vector<int> ts(dim2, 0);
+        LazyDecayHistory history;
+
+        auto sparseStep = [&]()
+        {
+            // the momentum update overwrites the gradient, so always work on a copy
+            SingleMatrix gradient(matGsparseBSC.DeepClone());
+            history.Append(decayRates);
+            update(gradient, stateSparse, matMsparse, ts.data(), &history);
+        };
+
+        update(matG, state, matM, nullptr, nullptr);
+        sparseStep();
+
+        SingleMatrix scaledStateSparse(stateSparse.DeepClone());
+        scaledStateSparse *= sparseStateScale;
+        BOOST_CHECK(state.IsEqualTo(scaledStateSparse, c_epsilonFloatE5));
+        BOOST_CHECK(matM.IsEqualTo(matMsparse, c_epsilonFloatE5));
+
+        update(zero, state, matM, nullptr, nullptr);
+        history.Append(decayRates);
+        update(matG, state, matM, nullptr, nullptr);
+        sparseStep();
+        update(zero, state, matM, nullptr, nullptr);
+        history.Append(decayRates);
+        stateSparse.LazyDecayFlushState(dim2, history, ts.data());
+
+        scaledStateSparse = stateSparse.DeepClone();
+        scaledStateSparse *= sparseStateScale;
+        BOOST_CHECK(state.IsEqualTo(scaledStateSparse, c_epsilonFloatE4));
+        BOOST_CHECK(std::all_of(ts.begin(), ts.end(), [](int t) { return t == 0; }));
+    }
 };
 
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
@@ -121,5 +175,43 @@ BOOST_FIXTURE_TEST_CASE(AdaDeltaSparse, MatrixLearnerFixture)
     });
 }
 
+// tests lazy momentum SGD sparse vs. dense on the CPU
+BOOST_FIXTURE_TEST_CASE(MomentumSGDSparseLazy, MatrixLearnerFixture)
+{
+    const float learningRate = 0.1f;
+    const float momentum = 0.9f;
+    RunLazySparseOnCPU([=](SingleMatrix& gradient, SingleMatrix& state, SingleMatrix& model, int* ts, const LazyDecayHistory* history)
+    {
+        model.MomentumSGDUpdate(gradient, state, learningRate, momentum, 1.0f, ts, history);
+    },
+    { momentum },
+    // the sparse update does not scale the smoothed gradient by the learning rate
+    learningRate);
+}
+
+// tests lazy FSAdagrad sparse vs. dense on the CPU
+BOOST_FIXTURE_TEST_CASE(FSAdagradSparseLazy, MatrixLearnerFixture)
+{
+    const double targetAdagradAvDenom_x_sqrtAdagradSqrFrames = 0.5;
+    RunLazySparseOnCPU([=](SingleMatrix& gradient, SingleMatrix& state, SingleMatrix& model, int* ts, const LazyDecayHistory* history)
+    {
+        state.FSAdagradUpdate(gradient, model, targetAdagradAvDenom_x_sqrtAdagradSqrFrames, 0.0001, 0.9, 0.99, 0.1f, ts, history);
+    },
+    { 0.99, 0.9 });
+}
+
+// tests lazy Adam and Adamax sparse vs. dense on the CPU
+BOOST_FIXTURE_TEST_CASE(AdamSparseLazy, MatrixLearnerFixture)
+{
+    for (bool adamax : { false, true })
+    {
+        RunLazySparseOnCPU([=](SingleMatrix& gradient, SingleMatrix& state, SingleMatrix& model, int* ts, const LazyDecayHistory* history)
+        {
+            state.AdamUpdate(gradient, model, 1.0, 0.0001, 0.9, 0.999, 1e-8, 0.1f, adamax, ts, history);
+        },
+        { 0.999, 0.9 });
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }}}}
@@ -0,0 +1,56 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "NumaPolicy.h"
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+BOOST_AUTO_TEST_SUITE(NumaPolicySuite)
+
+BOOST_AUTO_TEST_CASE(NumaPolicyTopology)
+{
+    size_t numCpus = 0;
+    BOOST_REQUIRE_GE(NumaPolicy::NumNodes(), 1);
+    for (size_t node = 0; node < NumaPolicy::NumNodes(); node++)
+        numCpus += NumaPolicy::CpusOfNode(node).size();
+    BOOST_CHECK_GE(numCpus, 1);
+    BOOST_CHECK_LT(NumaPolicy::CurrentNode(), NumaPolicy::NumNodes());
+    BOOST_CHECK(NumaPolicy::ParseMode(L"spread") == NumaPolicyMode::spread);
+    BOOST_CHECK(NumaPolicy::ParseMode(L"PerRank") == NumaPolicyMode::perRank);
+    BOOST_CHECK_THROW(NumaPolicy::ParseMode(L"interleave"), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(NumaPolicyAlloc)
+{
+    for (size_t node = 0; node < NumaPolicy::NumNodes(); node++)
+    {
+        for (size_t bytes : {1, 1000, 1 << 20})
+        {
+            char* p = (char*) NumaPolicy::Alloc(bytes, node);
+            BOOST_REQUIRE(p != nullptr);
+            BOOST_CHECK_EQUAL((size_t) p % 64, 0);
+            memset(p, 0x5a, bytes);
+            NumaPolicy::Free(p);
+        }
+    }
+    NumaPolicy::Free(nullptr);
+
+    // the scratch buffer is per thread, and only grows
+    void* scratch = NumaPolicy::ThreadScratch(1000);
+    BOOST_CHECK_EQUAL(NumaPolicy::ThreadScratch(10), scratch);
+    memset(NumaPolicy::ThreadScratch(100000), 0, 100000);
+    void* otherThreadScratch = nullptr;
+    thread([&]() { otherThreadScratch = NumaPolicy::ThreadScratch(10); }).join();
+    BOOST_CHECK_NE(otherThreadScratch, NumaPolicy::ThreadScratch(10));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
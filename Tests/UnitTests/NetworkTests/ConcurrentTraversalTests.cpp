@@ -0,0 +1,192 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/InputAndParamNodes.h"
+#include "Globals.h"
+#include "TimerUtility.h"
+#include <memory>
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// We perform test on CPU.
+static const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+// network with 'numBranches' independent hidden layers on the same input, whose projections are summed up:
+//   criterion = SquareError(labels, sum_k V_k * ReLU(W_k * features + b_k))
+// Parameters are filled from a fixed seed, so that two networks created with the same arguments are identical.
+template <class ElemType>
+static ComputationNetworkPtr CreateMultiBranchNetwork(size_t numBranches, size_t inputDim, size_t hiddenDim, size_t outputDim)
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+    mt19937 rng(42);
+    uniform_real_distribution<double> uniform(-0.5, 0.5);
+    auto createParameter = [&](const wstring& name, size_t rows, size_t cols)
+    {
+        auto parameter = builder.CreateLearnableParameter(name, rows, cols);
+        vector<ElemType> values(rows * cols);
+        for (auto& value : values)
+            value = (ElemType)uniform(rng);
+        parameter->Value().SetValue(rows, cols, c_deviceId, values.data());
+        return parameter;
+    };
+
+    auto features = builder.CreateInputNode(L"features", inputDim);
+    auto labels = builder.CreateInputNode(L"labels", outputDim);
+    shared_ptr<ComputationNode<ElemType>> output;
+    for (size_t k = 0; k < numBranches; k++)
+    {
+        auto suffix = to_wstring(k);
+        auto hidden = builder.RectifiedLinear(builder.Plus(builder.Times(createParameter(L"W" + suffix, hiddenDim, inputDim), features),
+                                                           createParameter(L"b" + suffix, hiddenDim, 1)));
+        auto projection = builder.Times(createParameter(L"V" + suffix, outputDim, hiddenDim), hidden);
+        output = output ? builder.Plus(output, projection) : projection;
+    }
+    auto criterion = builder.SquareError(labels, output, L"criterion");
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->CompileNetwork();
+    return net;
+}
+
+// set the input values from a fixed seed
+template <class ElemType>
+static void SetMultiBranchNetworkInputs(const ComputationNetworkPtr& net, size_t numSamples)
+{
+    mt19937 rng(7);
+    uniform_real_distribution<double> uniform(-1, 1);
+    net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(numSamples);
+    vector<ComputationNodeBasePtr> inputs;
+    for (const auto& name : {L"features", L"labels"})
+    {
+        auto input = net->GetNodeFromName(name)->template As<ComputationNode<ElemType>>();
+        size_t dim = input->GetSampleLayout().GetNumElements();
+        vector<ElemType> values(dim * numSamples);
+        for (auto& value : values)
+            value = (ElemType)uniform(rng);
+        input->Value().SetValue(dim, numSamples, c_deviceId, values.data());
+        inputs.push_back(net->GetNodeFromName(name));
+    }
+    ComputationNetwork::BumpEvalTimeStamp(inputs);
+}
+
+template <class ElemType>
+static ComputationNetworkPtr CreateAndAllocateMultiBranchNetwork(size_t numConcurrentThreads, size_t numBranches, size_t inputDim, size_t hiddenDim, size_t outputDim)
+{
+    size_t previousNumThreads = Globals::GetConcurrentTraversalThreads();
+    Globals::SetConcurrentTraversalThreads(numConcurrentThreads);
+    auto net = CreateMultiBranchNetwork<ElemType>(numBranches, inputDim, hiddenDim, outputDim);
+    net->AllocateAllMatrices({}, {}, net->GetNodeFromName(L"criterion"));
+    Globals::SetConcurrentTraversalThreads(previousNumThreads);
+    return net;
+}
+
+template <class ElemType>
+static void TrainingStep(const ComputationNetworkPtr& net)
+{
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    auto criterion = net->GetNodeFromName(L"criterion");
+    net->ForwardProp(criterion);
+    net->Backprop(criterion);
+}
+
+template <class ElemType>
+static vector<ElemType> GetValues(const Matrix<ElemType>& matrix)
+{
+    unique_ptr<ElemType[]> data(matrix.CopyToArray());
+    return vector<ElemType>(data.get(), data.get() + matrix.GetNumElements());
+}
+
+template <class ElemType>
+static void CheckNear(const vector<ElemType>& expected, const vector<ElemType>& actual, const wstring& name)
+{
+    BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); i++)
+        BOOST_REQUIRE_MESSAGE(fabs(expected[i] - actual[i]) <= 1e-4 * max<ElemType>(1, fabs(expected[i])),
+                              "value of " << string(name.begin(), name.end()) << " differs at " << i << ": " << expected[i] << " vs. " << actual[i]);
+}
+
+// Concurrent traversal must be deterministic, i.e. produce bit-identical criteria and gradients from run to run,
+// and agree with sequential traversal. (Against sequential traversal, only up to rounding: the concurrently
+// executed nodes use fewer math library threads each, which may change the order of summations inside a node.)
+template <class ElemType>
+static void ConcurrentTraversalMatchesSequentialImpl(size_t numConcurrentThreads)
+{
+    const size_t numBranches = 6, inputDim = 17, hiddenDim = 23, outputDim = 5, numSamples = 11;
+    auto sequentialNet = CreateAndAllocateMultiBranchNetwork<ElemType>(0, numBranches, inputDim, hiddenDim, outputDim);
+    auto concurrentNet1 = CreateAndAllocateMultiBranchNetwork<ElemType>(numConcurrentThreads, numBranches, inputDim, hiddenDim, outputDim);
+    auto concurrentNet2 = CreateAndAllocateMultiBranchNetwork<ElemType>(numConcurrentThreads, numBranches, inputDim, hiddenDim, outputDim);
+
+    for (size_t step = 0; step < 3; step++) // repeat, to exercise reuse of the shared matrices
+    {
+        for (const auto& net : {sequentialNet, concurrentNet1, concurrentNet2})
+        {
+            SetMultiBranchNetworkInputs<ElemType>(net, numSamples + step);
+            TrainingStep<ElemType>(net);
+        }
+
+        vector<ComputationNodeBasePtr> nodesToCompare{sequentialNet->GetNodeFromName(L"criterion")};
+        for (const auto& parameter : sequentialNet->LearnableParameterNodes(nodesToCompare.front()))
+            nodesToCompare.push_back(parameter);
+        for (const auto& node : nodesToCompare)
+        {
+            auto getResult = [&](const ComputationNetworkPtr& net)
+            {
+                auto typedNode = net->GetNodeFromName(node->NodeName())->template As<ComputationNode<ElemType>>();
+                return GetValues(node->NodeName() == L"criterion" ? typedNode->Value() : typedNode->Gradient());
+            };
+            auto concurrentResult = getResult(concurrentNet1);
+            BOOST_REQUIRE_MESSAGE(concurrentResult == getResult(concurrentNet2), "result of " << string(node->NodeName().begin(), node->NodeName().end()) << " is not deterministic");
+            CheckNear(getResult(sequentialNet), concurrentResult, node->NodeName());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(ConcurrentTraversalTestSuite)
+
+BOOST_AUTO_TEST_CASE(ConcurrentTraversalMatchesSequential)
+{
+    for (size_t numConcurrentThreads : {2, 4})
+    {
+        ConcurrentTraversalMatchesSequentialImpl<float>(numConcurrentThreads);
+        ConcurrentTraversalMatchesSequentialImpl<double>(numConcurrentThreads);
+    }
+}
+
+// benchmark of a training step of an inception-like network; only reports the times
+// Disabled by default since it checks nothing; run it explicitly with
+//   --run_test=ConcurrentTraversalTestSuite/ConcurrentTraversalMultiBranchBenchmark --log_level=message
+BOOST_AUTO_TEST_CASE(ConcurrentTraversalMultiBranchBenchmark, *boost::unit_test::disabled())
+{
+    const size_t numBranches = 8, inputDim = 256, hiddenDim = 512, outputDim = 64, numSamples = 64, numSteps = 20;
+    for (size_t numConcurrentThreads : {0, 2, 4, 8})
+    {
+        auto net = CreateAndAllocateMultiBranchNetwork<float>(numConcurrentThreads, numBranches, inputDim, hiddenDim, outputDim);
+        SetMultiBranchNetworkInputs<float>(net, numSamples);
+        TrainingStep<float>(net); // warm up
+
+        const auto& inputNodes = net->InputNodes(net->GetNodeFromName(L"criterion"));
+        vector<ComputationNodeBasePtr> inputs(inputNodes.begin(), inputNodes.end());
+        Timer timer;
+        timer.Start();
+        for (size_t step = 0; step < numSteps; step++)
+        {
+            ComputationNetwork::BumpEvalTimeStamp(inputs);
+            TrainingStep<float>(net);
+        }
+        timer.Stop();
+        BOOST_TEST_MESSAGE("concurrentTraversalThreads=" << numConcurrentThreads << ": " << 1000 * timer.ElapsedSeconds() / numSteps << " ms per training step");
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
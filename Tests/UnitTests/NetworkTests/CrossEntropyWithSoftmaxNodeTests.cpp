@@ -0,0 +1,141 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/TrainingNodes.h"
+#include "TestHelpers.h"
+#include <memory>
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// The fused kernel only exists on the CPU.
+static const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+// (nodes hide the accessors of their base classes)
+template <class ElemType>
+static Matrix<ElemType>& GradientOf(const shared_ptr<ComputationNode<ElemType>>& node)
+{
+    return node->Gradient();
+}
+
+// An input whose minibatch layout can be replaced, here by one with gaps.
+template <class ElemType>
+class SequenceInputNodeTest : public DummyNodeTest<ElemType>
+{
+public:
+    using DummyNodeTest<ElemType>::DummyNodeTest;
+    using ComputationNodeBase::LinkToMBLayout;
+};
+
+// Extends the node to allocate the matrices that otherwise come from the matrix pool.
+template <class ElemType>
+class CrossEntropyWithSoftmaxNodeTest : public CrossEntropyWithSoftmaxNode<ElemType>
+{
+public:
+    CrossEntropyWithSoftmaxNodeTest() : CrossEntropyWithSoftmaxNode<ElemType>(c_deviceId, L"CrossEntropyWithSoftmaxNodeTest") {}
+
+    void AllocMatrices()
+    {
+        for (auto matrix : {&this->m_logSoftmaxOfRight, &this->m_softmaxOfRight, &this->m_logSumExpOfRight})
+            this->CreateMatrixIfNull(*matrix);
+        this->CreateValueMatrixIfNull();
+        this->CreateGradientMatrixIfNull();
+        this->UpdateFunctionMBSize();
+        this->Value().Resize(1, 1);
+        this->Gradient().Resize(1, 1);
+    }
+};
+
+// Two parallel sequences of 3 and 2 frames, so that the last column is a gap. The labels and logits of the gap
+// are set to garbage, which the reader may leave there, and which must not contribute to the criterion.
+template <class ElemType>
+void CrossEntropyWithSoftmaxWithGapsTestImpl(double tolerance)
+{
+    const size_t numClasses = 5, numParallelSequences = 2, numTimeSteps = 3, numCols = numParallelSequences * numTimeSteps;
+    const size_t gapColumn = 2 * numParallelSequences + 1; // (time step 2 of sequence 1)
+    auto pMBLayout = make_shared<MBLayout>();
+    pMBLayout->Init(numParallelSequences, numTimeSteps);
+    pMBLayout->AddSequence(0, 0, 0, 3);
+    pMBLayout->AddSequence(1, 1, 0, 2);
+    pMBLayout->AddGap(1, 2, 3);
+
+    mt19937 rng(7);
+    uniform_real_distribution<double> uniform(-2, 2);
+    vector<ElemType> labelData(numClasses * numCols, 0), logitData(numClasses * numCols);
+    for (size_t j = 0; j < numCols; j++)
+    {
+        labelData[j * numClasses + rng() % numClasses] = 1;
+        for (size_t i = 0; i < numClasses; i++)
+            logitData[j * numClasses + i] = (ElemType)uniform(rng);
+    }
+    for (size_t i = 0; i < numClasses; i++)
+    {
+        labelData[gapColumn * numClasses + i] = 3;
+        logitData[gapColumn * numClasses + i] = 50;
+    }
+
+    auto labels = make_shared<SequenceInputNodeTest<ElemType>>(c_deviceId, numCols, SmallVector<size_t>{numClasses}, labelData);
+    auto logits = make_shared<SequenceInputNodeTest<ElemType>>(c_deviceId, numCols, SmallVector<size_t>{numClasses}, logitData);
+    for (auto input : {labels, logits})
+    {
+        input->LinkToMBLayout(pMBLayout);
+        input->GetGradient().SetValue(0);
+    }
+    labels->Value().SetValue(numClasses, numCols, c_deviceId, labelData.data());
+    logits->Value().SetValue(numClasses, numCols, c_deviceId, logitData.data());
+
+    auto node = make_shared<CrossEntropyWithSoftmaxNodeTest<ElemType>>();
+    node->AttachInputs({labels, logits});
+    node->SetEnvironment(make_shared<ComputationEnvironment>());
+    ComputationNodeBasePtr baseNode = node;
+    baseNode->Validate(true);
+    node->AllocMatrices();
+    BOOST_REQUIRE(node->UseFusedKernel());
+
+    FrameRange fr(pMBLayout);
+    baseNode->BeginForwardProp();
+    baseNode->ForwardProp(fr);
+    baseNode->EndForwardProp();
+
+    // the path of the GPU, with the softmax and log-softmax materialized
+    Matrix<ElemType> logSoftmax(c_deviceId), softmax(c_deviceId), criterion(c_deviceId);
+    logSoftmax.AssignLogSoftmaxOf(logits->Value(), true);
+    softmax.SetValue(logSoftmax);
+    softmax.InplaceExp();
+    ComputationNode<ElemType>::MaskMissingColumnsToZero(logSoftmax, pMBLayout, fr);
+    Matrix<ElemType> maskedLabels = labels->Value().DeepClone();
+    ComputationNode<ElemType>::MaskMissingColumnsToZero(maskedLabels, pMBLayout, fr);
+    criterion.AssignInnerProductOfMatrices(maskedLabels, logSoftmax);
+    criterion *= -1;
+    BOOST_CHECK_SMALL((double)(node->Value()(0, 0) - criterion(0, 0)), tolerance * fabs(criterion(0, 0)));
+
+    const ElemType outputGradient = (ElemType)0.75;
+    GradientOf<ElemType>(node).SetValue(outputGradient);
+    Matrix<ElemType> logitGradient(numClasses, numCols, c_deviceId), labelGradient(numClasses, numCols, c_deviceId);
+    logitGradient.SetValue(0);
+    labelGradient.SetValue(0);
+    Matrix<ElemType>::AddScaledDifference(GradientOf<ElemType>(node), softmax, labels->Value(), logitGradient);
+    Matrix<ElemType>::Multiply1x1AndWeightedAdd(-1.0f, GradientOf<ElemType>(node), logSoftmax, 1.0f, labelGradient);
+    baseNode->BackpropTo(0, fr);
+    baseNode->BackpropTo(1, fr);
+    BOOST_CHECK(logits->GetGradient().IsEqualTo(logitGradient, (ElemType)tolerance));
+    BOOST_CHECK(labels->GetGradient().IsEqualTo(labelGradient, (ElemType)tolerance));
+}
+
+BOOST_AUTO_TEST_SUITE(CrossEntropyWithSoftmaxNodeTestSuite)
+
+BOOST_AUTO_TEST_CASE(CrossEntropyWithSoftmaxWithGapsTest)
+{
+    CrossEntropyWithSoftmaxWithGapsTestImpl<float>(1e-5);
+    CrossEntropyWithSoftmaxWithGapsTestImpl<double>(1e-12);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
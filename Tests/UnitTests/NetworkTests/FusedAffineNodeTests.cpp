@@ -0,0 +1,285 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/LinearAlgebraNodes.h"
+#include "../../../Source/ComputationNetworkLib/InputAndParamNodes.h"
+#include "TestHelpers.h"
+#include <memory>
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// We perform test on CPU.
+static const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+// Evaluates FusedAffine(W, x, b) for W = [2 x 3], b = [2] and two 3-dimensional samples x,
+// and compares against the reference activation(W * x + b).
+template <class ElemType>
+void FusedAffineForwardTestImpl(FusedActivationKind activation)
+{
+    const size_t outDim = 2, inDim = 3, minibatchSize = 2;
+    vector<ElemType> weights{1, -2, 0.5, 1, -1, 3}; // column major
+    vector<ElemType> bias{0.25, -4};
+    vector<ElemType> data{1, 2, 3, -1, 0, 2};
+
+    auto w = make_shared<LearnableParameter<ElemType>>(c_deviceId, L"W", TensorShape(outDim, inDim));
+    auto b = make_shared<LearnableParameter<ElemType>>(c_deviceId, L"b", TensorShape(outDim));
+    w->Value().SetValue(outDim, inDim, c_deviceId, weights.data());
+    b->Value().SetValue(outDim, 1, c_deviceId, bias.data());
+    auto x = make_shared<DummyNodeTest<ElemType>>(c_deviceId, minibatchSize, SmallVector<size_t>{inDim}, data);
+    x->Value().SetValue(inDim, minibatchSize, c_deviceId, data.data());
+
+    auto node = make_shared<FusedAffineNode<ElemType>>(c_deviceId, L"FusedAffineNodeTest", activation);
+    node->AttachInputs({w, x, b});
+    node->SetEnvironment(make_shared<ComputationEnvironment>());
+    ComputationNodeBasePtr baseNode = node;
+    baseNode->Validate(true);
+    BOOST_REQUIRE_EQUAL(baseNode->GetSampleLayout().GetNumElements(), outDim);
+    node->CreateValueMatrixIfNull();
+    node->Value().Resize(outDim, minibatchSize);
+
+    baseNode->BeginForwardProp();
+    baseNode->ForwardProp(FrameRange(baseNode->GetMBLayout()));
+    baseNode->EndForwardProp();
+
+    vector<ElemType> expected(outDim * minibatchSize);
+    for (size_t t = 0; t < minibatchSize; t++)
+    {
+        for (size_t i = 0; i < outDim; i++)
+        {
+            double z = bias[i];
+            for (size_t j = 0; j < inDim; j++)
+                z += weights[j * outDim + i] * data[t * inDim + j];
+            switch (activation)
+            {
+            case FusedActivationKind::Sigmoid:         z = 1 / (1 + exp(-z)); break;
+            case FusedActivationKind::Tanh:            z = tanh(z); break;
+            case FusedActivationKind::RectifiedLinear: z = max(z, 0.0); break;
+            default: break;
+            }
+            expected[t * outDim + i] = (ElemType)z;
+        }
+    }
+    BOOST_REQUIRE(AreEqual(expected.data(), node->Value().Data(), expected.size(), 1e-5f));
+}
+
+// network that exercises all rewrites of OptimizeForInference():
+//   h1        = Sigmoid(W1 * features + b1)                      -> FusedAffine
+//   c         = P * Q                                            -> constant, folded into a parameter
+//   output    = Tanh(BatchNormalization(c * h1 + b2))            -> BatchNormalization folded into c and b2, then FusedAffine
+//   criterion = SquareError(labels, output)
+// Parameters are filled from a fixed seed, so that two networks created with the same arguments are identical.
+static const size_t c_inputDim = 3, c_hiddenDim = 4, c_innerDim = 3, c_outputDim = 2, c_numSamples = 5;
+
+template <class ElemType>
+static ComputationNetworkPtr CreateOptimizableNetwork()
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+    mt19937 rng(42);
+    uniform_real_distribution<double> uniform(-0.5, 0.5);
+    auto createParameter = [&](const wstring& name, size_t rows, size_t cols, double offset)
+    {
+        auto parameter = builder.CreateLearnableParameter(name, cols == 1 ? TensorShape(rows) : TensorShape(rows, cols));
+        vector<ElemType> values(rows * cols);
+        for (auto& value : values)
+            value = (ElemType)(offset + uniform(rng));
+        parameter->Value().SetValue(rows, cols, c_deviceId, values.data());
+        return parameter;
+    };
+
+    auto features = builder.CreateInputNode(L"features", c_inputDim);
+    auto labels = builder.CreateInputNode(L"labels", c_outputDim);
+    auto h1 = builder.Sigmoid(builder.Plus(builder.Times(createParameter(L"W1", c_hiddenDim, c_inputDim, 0), features), createParameter(L"b1", c_hiddenDim, 1, 0)), L"h1");
+    auto c = builder.Times(createParameter(L"P", c_outputDim, c_innerDim, 0), createParameter(L"Q", c_innerDim, c_hiddenDim, 0), 1, L"c");
+    auto z = builder.Plus(builder.Times(c, h1), createParameter(L"b2", c_outputDim, 1, 0));
+    auto bn = builder.BatchNormalization(z, createParameter(L"scale", c_outputDim, 1, 1), createParameter(L"bias", c_outputDim, 1, 0),
+                                         createParameter(L"mean", c_outputDim, 1, 0), createParameter(L"variance", c_outputDim, 1, 1), createParameter(L"count", 1, 1, 100),
+                                         /*spatial=*/false, /*normalizationTimeConstant=*/0, /*blendTimeConstant=*/0, /*epsilon=*/1e-5, /*useCntkEngine=*/true,
+                                         /*disableRegularization=*/false, ImageLayoutKind::CHW, L"bn");
+    auto output = builder.Tanh(bn, L"output");
+    auto criterion = builder.SquareError(labels, output, L"criterion");
+    net->AddToNodeGroup(L"output", output);
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->CompileNetwork();
+    return net;
+}
+
+// set the input values from a fixed seed
+template <class ElemType>
+static void SetOptimizableNetworkInputs(const ComputationNetworkPtr& net)
+{
+    mt19937 rng(7);
+    uniform_real_distribution<double> uniform(-1, 1);
+    net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(c_numSamples);
+    vector<ComputationNodeBasePtr> inputs;
+    for (const auto& name : {L"features", L"labels"})
+    {
+        auto input = net->GetNodeFromName(name)->template As<ComputationNode<ElemType>>();
+        size_t dim = input->GetSampleLayout().GetNumElements();
+        vector<ElemType> values(dim * c_numSamples);
+        for (auto& value : values)
+            value = (ElemType)uniform(rng);
+        input->Value().SetValue(dim, c_numSamples, c_deviceId, values.data());
+        inputs.push_back(net->GetNodeFromName(name));
+    }
+    ComputationNetwork::BumpEvalTimeStamp(inputs);
+}
+
+template <class ElemType>
+static vector<ElemType> GetValues(const Matrix<ElemType>& matrix)
+{
+    unique_ptr<ElemType[]> data(matrix.CopyToArray());
+    return vector<ElemType>(data.get(), data.get() + matrix.GetNumElements());
+}
+
+// derivative of the criterion with respect to each element of a parameter, by central differences
+// All leaves are bumped for each evaluation, since values of nodes that are not recomputed may have been overwritten
+// by nodes that share their memory.
+template <class ElemType>
+static vector<ElemType> GetNumericalGradient(const ComputationNetworkPtr& net, const wstring& parameterName)
+{
+    const ElemType epsilon = (ElemType)1e-6;
+    auto parameter = net->GetNodeFromName(parameterName)->template As<ComputationNode<ElemType>>();
+    auto criterion = net->GetNodeFromName(L"criterion");
+    const auto& parameterNodes = net->LearnableParameterNodes(criterion);
+    const auto& inputNodes = net->InputNodes(criterion);
+    vector<ComputationNodeBasePtr> leaves(parameterNodes.begin(), parameterNodes.end());
+    leaves.insert(leaves.end(), inputNodes.begin(), inputNodes.end());
+    auto evaluate = [&](size_t i, ElemType value)
+    {
+        parameter->Value().SetValue(i % parameter->Value().GetNumRows(), i / parameter->Value().GetNumRows(), value);
+        ComputationNetwork::BumpEvalTimeStamp(leaves);
+        net->ForwardProp(criterion);
+        return criterion->As<ComputationNode<ElemType>>()->Value().Get00Element();
+    };
+    auto values = GetValues(parameter->Value());
+    vector<ElemType> gradient(values.size());
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        ElemType plus = evaluate(i, values[i] + epsilon);
+        ElemType minus = evaluate(i, values[i] - epsilon);
+        evaluate(i, values[i]);
+        gradient[i] = (plus - minus) / (2 * epsilon);
+    }
+    return gradient;
+}
+
+BOOST_AUTO_TEST_SUITE(FusedAffineNodeTestSuite)
+
+BOOST_AUTO_TEST_CASE(FusedAffineForwardTest)
+{
+    for (auto activation : {FusedActivationKind::None, FusedActivationKind::Sigmoid, FusedActivationKind::Tanh, FusedActivationKind::RectifiedLinear})
+    {
+        FusedAffineForwardTestImpl<float>(activation);
+        FusedAffineForwardTestImpl<double>(activation);
+    }
+}
+
+// Backprop of FusedAffine must agree with the chain it replaces, for the weights, the input and the bias.
+BOOST_AUTO_TEST_CASE(FusedAffineBackpropTest)
+{
+    for (auto activation : {FusedActivationKind::None, FusedActivationKind::Sigmoid, FusedActivationKind::Tanh, FusedActivationKind::RectifiedLinear})
+    {
+        auto net = make_shared<ComputationNetwork>(c_deviceId);
+        ComputationNetworkBuilder<double> builder(*net);
+        auto features = builder.CreateInputNode(L"features", c_inputDim);
+        auto labels = builder.CreateInputNode(L"labels", c_outputDim);
+        auto w = builder.CreateLearnableParameter(L"W", TensorShape(c_outputDim, c_inputDim));
+        auto b = builder.CreateLearnableParameter(L"b", TensorShape(c_outputDim));
+        vector<double> weights{0.5, -1, 0.25, 2, -0.75, 1.5}, bias{0.125, -0.25};
+        w->Value().SetValue(c_outputDim, c_inputDim, c_deviceId, weights.data());
+        b->Value().SetValue(c_outputDim, 1, c_deviceId, bias.data());
+        auto fused = net->AddNodeToNetAndAttachInputs(New<FusedAffineNode<double>>(c_deviceId, L"output", activation), {w, features, b});
+        ComputationNodeBasePtr criterion = builder.SquareError(labels, fused, L"criterion");
+        net->AddToNodeGroup(L"criterion", criterion);
+        net->CompileNetwork();
+        net->AllocateAllMatrices({}, {}, criterion);
+        SetOptimizableNetworkInputs<double>(net);
+
+        vector<double> expectedWeightGradient, expectedBiasGradient;
+        {
+            ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::inferring);
+            expectedWeightGradient = GetNumericalGradient<double>(net, L"W");
+            expectedBiasGradient = GetNumericalGradient<double>(net, L"b");
+        }
+        {
+            ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+            net->ForwardProp(criterion);
+            net->Backprop(criterion);
+        }
+        BOOST_REQUIRE(AreEqual(expectedWeightGradient.data(), w->Gradient().Data(), expectedWeightGradient.size(), 1e-6));
+        BOOST_REQUIRE(AreEqual(expectedBiasGradient.data(), b->Gradient().Data(), expectedBiasGradient.size(), 1e-6));
+    }
+}
+
+// OptimizeForInference() folds the constant subgraph and the BatchNormalization node and fuses both affine layers.
+// The rewritten network must keep the names of the replaced nodes, drop the unreachable ones, compute the same
+// output and criterion, and yield the gradients of the original network. The latter are obtained by central
+// differences, since BatchNormalization cannot be differentiated in inference mode.
+BOOST_AUTO_TEST_CASE(OptimizeForInferenceNetworkTest)
+{
+    auto original = CreateOptimizableNetwork<double>();
+    original->AllocateAllMatrices({}, original->OutputNodes(), original->GetNodeFromName(L"criterion"));
+    SetOptimizableNetworkInputs<double>(original);
+    vector<double> expectedOutput, expectedCriterion, expectedWeightGradient, expectedBiasGradient;
+    {
+        ScopedNetworkOperationMode modeGuard(original, NetworkOperationMode::inferring);
+        original->ForwardProp(original->GetNodeFromName(L"criterion"));
+        expectedOutput = GetValues(original->GetNodeFromName(L"output")->As<ComputationNode<double>>()->Value());
+        expectedCriterion = GetValues(original->GetNodeFromName(L"criterion")->As<ComputationNode<double>>()->Value());
+        expectedWeightGradient = GetNumericalGradient<double>(original, L"W1");
+        expectedBiasGradient = GetNumericalGradient<double>(original, L"b1");
+    }
+
+    auto optimized = CreateOptimizableNetwork<double>();
+    optimized->OptimizeForInference<double>();
+
+    // FoldConstantSubgraphs, FoldBatchNormalization and FuseAffineActivations substitute nodes under their original names,
+    // and RemoveUnreachableNodes drops what is no longer used
+    BOOST_REQUIRE(optimized->GetNodeFromName(L"c")->Is<LearnableParameter<double>>());
+    BOOST_REQUIRE(optimized->GetNodeFromName(L"h1")->Is<FusedAffineNode<double>>());
+    BOOST_REQUIRE(optimized->GetNodeFromName(L"output")->Is<FusedAffineNode<double>>());
+    BOOST_REQUIRE(optimized->OutputNodes().size() == 1 && optimized->OutputNodes()[0] == optimized->GetNodeFromName(L"output"));
+    for (const auto& name : {L"P", L"Q", L"bn", L"scale", L"bias", L"mean", L"variance", L"count"})
+        BOOST_REQUIRE(!optimized->NodeNameExists(name));
+    BOOST_REQUIRE_EQUAL(optimized->GetTotalNumberOfNodes(), 9);
+
+    auto criterion = optimized->GetNodeFromName(L"criterion");
+    optimized->AllocateAllMatrices({}, optimized->OutputNodes(), criterion);
+    SetOptimizableNetworkInputs<double>(optimized);
+    {
+        ScopedNetworkOperationMode modeGuard(optimized, NetworkOperationMode::training);
+        optimized->ForwardProp(criterion);
+        optimized->Backprop(criterion);
+    }
+    auto output = GetValues(optimized->GetNodeFromName(L"output")->As<ComputationNode<double>>()->Value());
+    auto criterionValue = GetValues(criterion->As<ComputationNode<double>>()->Value());
+    auto weightGradient = GetValues(optimized->GetNodeFromName(L"W1")->As<ComputationNode<double>>()->Gradient());
+    auto biasGradient = GetValues(optimized->GetNodeFromName(L"b1")->As<ComputationNode<double>>()->Gradient());
+    BOOST_REQUIRE(AreEqual(expectedOutput.data(), output.data(), output.size(), 1e-10));
+    BOOST_REQUIRE(AreEqual(expectedCriterion.data(), criterionValue.data(), criterionValue.size(), 1e-10));
+    BOOST_REQUIRE(AreEqual(expectedWeightGradient.data(), weightGradient.data(), weightGradient.size(), 1e-6));
+    BOOST_REQUIRE(AreEqual(expectedBiasGradient.data(), biasGradient.data(), biasGradient.size(), 1e-6));
+}
+
+BOOST_AUTO_TEST_CASE(FusedActivationKindFromNameTest)
+{
+    BOOST_CHECK(FusedActivationKindFrom(L"none") == FusedActivationKind::None);
+    BOOST_CHECK(FusedActivationKindFrom(L"Sigmoid") == FusedActivationKind::Sigmoid);
+    BOOST_CHECK(FusedActivationKindFrom(L"tanh") == FusedActivationKind::Tanh);
+    BOOST_CHECK(FusedActivationKindFrom(L"RectifiedLinear") == FusedActivationKind::RectifiedLinear);
+    BOOST_CHECK_THROW(FusedActivationKindFrom(L"softmax"), std::exception);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
@@ -0,0 +1,344 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/SpecialPurposeNodes.h"
+#include "../../../Source/ComputationNetworkLib/InputAndParamNodes.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "TestHelpers.h"
+#include "TimerUtility.h"
+#include <algorithm>
+#include <memory>
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// The fused kernel only exists on the CPU.
+static const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+// (nodes hide the accessors of their base classes)
+template <class ElemType>
+static Matrix<ElemType>& GradientOf(const shared_ptr<ComputationNode<ElemType>>& node)
+{
+    return node->Gradient();
+}
+
+// Extends the GMM node to allocate the matrices that otherwise come from the matrix pool.
+template <class ElemType>
+class GMMLogLikelihoodNodeTest : public GMMLogLikelihoodNode<ElemType>
+{
+public:
+    GMMLogLikelihoodNodeTest() : GMMLogLikelihoodNode<ElemType>(c_deviceId, L"GMMLogLikelihoodNodeTest") {}
+
+    void AllocMatrices(size_t numSamples)
+    {
+        for (auto matrix : {&this->m_prior, &this->m_normedDeviation, &this->m_normedDeviationVectors, &this->m_stddev, &this->m_posterior,
+                            &this->m_temp, &this->m_fusedTemp, &this->m_componentSums, &this->m_frameSums})
+            this->CreateMatrixIfNull(*matrix);
+        this->CreateValueMatrixIfNull();
+        this->CreateGradientMatrixIfNull();
+        this->UpdateFunctionMBSize();
+        this->Value().Resize(1, numSamples);
+        this->Gradient().Resize(1, numSamples);
+    }
+
+    bool UsedFusedKernel() const { return this->m_fusedForward; }
+};
+
+// A GMM with parameters shared by all frames, as for acoustic scoring, and a minibatch of features.
+template <class ElemType>
+struct GMMTestSetup
+{
+    size_t numComponents, featureDim, numSamples;
+    vector<ElemType> unnormedPrior, means, logStddevs, features; // means: one column of featureDim per component
+    shared_ptr<LearnableParameter<ElemType>> priorNode, meanNode, logStddevNode;
+    shared_ptr<DummyNodeTest<ElemType>> featureNode;
+    shared_ptr<GMMLogLikelihoodNodeTest<ElemType>> node;
+
+    GMMTestSetup(size_t numComponents, size_t featureDim, size_t numSamples, unsigned int seed)
+        : numComponents(numComponents), featureDim(featureDim), numSamples(numSamples)
+    {
+        mt19937 rng(seed);
+        uniform_real_distribution<double> uniform(-1, 1);
+        for (size_t k = 0; k < numComponents; k++)
+        {
+            unnormedPrior.push_back((ElemType) uniform(rng));
+            logStddevs.push_back((ElemType)(0.2 * uniform(rng)));
+        }
+        for (size_t i = 0; i < featureDim * numComponents; i++)
+            means.push_back((ElemType) uniform(rng));
+        for (size_t i = 0; i < featureDim * numSamples; i++)
+            features.push_back((ElemType) uniform(rng));
+
+        priorNode = MakeParameter(L"prior", numComponents, unnormedPrior);
+        meanNode = MakeParameter(L"mean", featureDim * numComponents, means);
+        logStddevNode = MakeParameter(L"logStddev", numComponents, logStddevs);
+        featureNode = make_shared<DummyNodeTest<ElemType>>(c_deviceId, numSamples, SmallVector<size_t>{featureDim}, features);
+        featureNode->Value().SetValue(featureDim, numSamples, c_deviceId, features.data()); // (one column per frame)
+        featureNode->GetGradient().SetValue(0);
+
+        node = make_shared<GMMLogLikelihoodNodeTest<ElemType>>();
+        node->AttachInputs({priorNode, meanNode, logStddevNode, featureNode});
+        node->SetEnvironment(make_shared<ComputationEnvironment>());
+        ComputationNodeBasePtr baseNode = node;
+        baseNode->Validate(true);
+        node->AllocMatrices(numSamples);
+    }
+
+    static shared_ptr<LearnableParameter<ElemType>> MakeParameter(const wstring& name, size_t dim, vector<ElemType>& values)
+    {
+        auto parameter = make_shared<LearnableParameter<ElemType>>(c_deviceId, name, TensorShape(dim));
+        parameter->Value().SetValue(dim, 1, c_deviceId, values.data());
+        parameter->CreateGradientMatrixIfNull();
+        GradientOf<ElemType>(parameter).Resize(dim, 1);
+        GradientOf<ElemType>(parameter).SetValue(0);
+        return parameter;
+    }
+
+    void ForwardProp()
+    {
+        ComputationNodeBasePtr baseNode = node;
+        baseNode->BeginForwardProp();
+        baseNode->ForwardProp(FrameRange(baseNode->GetMBLayout()));
+        baseNode->EndForwardProp();
+    }
+
+    // reference: log sum_c prior_c N(x_t; u_c, stddev_c^2 I), directly from the definition, in double
+    // (with the constant log(2 pi) of the node, which is computed in float)
+    vector<double> Reference(const vector<double>& unnormedPrior, const vector<double>& means, const vector<double>& logStddevs, const vector<double>& features) const
+    {
+        double maxPrior = *max_element(unnormedPrior.begin(), unnormedPrior.end()), priorSum = 0;
+        for (auto z : unnormedPrior)
+            priorSum += exp(z - maxPrior);
+        vector<double> result(numSamples);
+        for (size_t t = 0; t < numSamples; t++)
+        {
+            vector<double> logLikelihoods(numComponents);
+            for (size_t k = 0; k < numComponents; k++)
+            {
+                double sqDistance = 0;
+                for (size_t i = 0; i < featureDim; i++)
+                {
+                    double d = features[t * featureDim + i] - means[k * featureDim + i];
+                    sqDistance += d * d;
+                }
+                logLikelihoods[k] = unnormedPrior[k] - maxPrior - log(priorSum)
+                                  - 0.5 * sqDistance * exp(-2 * logStddevs[k]) - featureDim * logStddevs[k] - 0.5 * featureDim * log(TWO_PI);
+            }
+            double maxLogLikelihood = *max_element(logLikelihoods.begin(), logLikelihoods.end()), sum = 0;
+            for (auto logLikelihood : logLikelihoods)
+                sum += exp(logLikelihood - maxLogLikelihood);
+            result[t] = maxLogLikelihood + log(sum);
+        }
+        return result;
+    }
+
+    vector<double> Reference() const
+    {
+        return Reference(ToDouble(unnormedPrior), ToDouble(means), ToDouble(logStddevs), ToDouble(features));
+    }
+
+    static vector<double> ToDouble(const vector<ElemType>& v) { return vector<double>(v.begin(), v.end()); }
+};
+
+template <class ElemType>
+void GMMLogLikelihoodForwardTestImpl(double tolerance)
+{
+    GMMTestSetup<ElemType> setup(3, 4, 5, 1);
+    setup.ForwardProp();
+    BOOST_REQUIRE(setup.node->UsedFusedKernel());
+    vector<double> expected = setup.Reference();
+    for (size_t t = 0; t < setup.numSamples; t++)
+        BOOST_CHECK_SMALL(setup.node->Value()(0, t) - expected[t], tolerance);
+
+    // the cached parameter terms are refreshed once the parameter has been updated
+    for (auto& m : setup.means)
+        m *= 2;
+    setup.meanNode->Value().SetValue(setup.means.size(), 1, c_deviceId, setup.means.data());
+    setup.meanNode->BumpEvalTimeStamp();
+    setup.ForwardProp();
+    expected = setup.Reference();
+    for (size_t t = 0; t < setup.numSamples; t++)
+        BOOST_CHECK_SMALL(setup.node->Value()(0, t) - expected[t], tolerance);
+}
+
+BOOST_AUTO_TEST_SUITE(GMMLogLikelihoodNodeTestSuite)
+
+BOOST_AUTO_TEST_CASE(GMMLogLikelihoodForwardTest)
+{
+    GMMLogLikelihoodForwardTestImpl<float>(1e-4);
+    GMMLogLikelihoodForwardTestImpl<double>(1e-10);
+}
+
+// central differences of sum_t g_t * GMMLogLikelihood(x_t) of the reference w.r.t. the given input
+static vector<double> NumericalGradient(const GMMTestSetup<double>& setup, const vector<double>& outputGradient, size_t inputIndex)
+{
+    const vector<vector<double>> inputs{setup.unnormedPrior, setup.means, setup.logStddevs, setup.features};
+    const double epsilon = 1e-5;
+    vector<double> gradient;
+    for (size_t j = 0; j < inputs[inputIndex].size(); j++)
+    {
+        double objective[2];
+        for (int sign : {0, 1})
+        {
+            vector<vector<double>> perturbed = inputs;
+            perturbed[inputIndex][j] += sign ? -epsilon : epsilon;
+            vector<double> logLikelihood = setup.Reference(perturbed[0], perturbed[1], perturbed[2], perturbed[3]);
+            objective[sign] = 0;
+            for (size_t t = 0; t < setup.numSamples; t++)
+                objective[sign] += outputGradient[t] * logLikelihood[t];
+        }
+        gradient.push_back((objective[0] - objective[1]) / (2 * epsilon));
+    }
+    return gradient;
+}
+
+// Compares the gradients of the fused path with central differences of the reference.
+BOOST_AUTO_TEST_CASE(GMMLogLikelihoodBackwardTest)
+{
+    GMMTestSetup<double> setup(3, 4, 5, 2);
+    setup.ForwardProp();
+    vector<double> outputGradient{0.5, -1, 2, 1, -0.25};
+    GradientOf<double>(setup.node).SetValue(1, setup.numSamples, c_deviceId, outputGradient.data());
+    FrameRange fr(ComputationNodeBasePtr(setup.node)->GetMBLayout());
+    for (size_t i = 0; i < 4; i++)
+        setup.node->BackpropTo(i, fr);
+
+    vector<Matrix<double>*> gradients{&GradientOf<double>(setup.priorNode), &GradientOf<double>(setup.meanNode), &GradientOf<double>(setup.logStddevNode), &setup.featureNode->GetGradient()};
+    for (size_t i = 0; i < 4; i++)
+    {
+        vector<double> expected = NumericalGradient(setup, outputGradient, i);
+        for (size_t j = 0; j < expected.size(); j++)
+            BOOST_CHECK_SMALL(gradients[i]->Data()[j] - expected[j], 1e-6);
+    }
+}
+
+// The gradient of the log stddevs of the generic path (ForwardPropS() and BackpropToLogStddev(), as used on the GPU),
+// where featureDim differs from the number of components, which the gradient must not mix up.
+BOOST_AUTO_TEST_CASE(GMMLogLikelihoodGenericLogStddevGradientTest)
+{
+    GMMTestSetup<double> setup(3, 4, 5, 2);
+    const size_t numComponents = setup.numComponents, numSamples = setup.numSamples;
+    Matrix<double> output(c_deviceId), prior(c_deviceId), stddev(c_deviceId), normedDeviationVectors(c_deviceId), normedDeviation(c_deviceId), posterior(c_deviceId), temp(c_deviceId);
+    prior.Resize(numComponents, 1);
+    stddev.Resize(numComponents, 1);
+    normedDeviation.Resize(numComponents, numSamples);
+    normedDeviationVectors.Resize(numComponents * setup.featureDim, numSamples);
+    posterior.Resize(numComponents, numSamples);
+    output.Resize(1, numSamples);
+    setup.node->ForwardPropS(output, setup.priorNode->Value(), setup.meanNode->Value(), setup.logStddevNode->Value(), setup.featureNode->Value(),
+                             prior, stddev, normedDeviationVectors, normedDeviation, posterior, temp);
+
+    vector<double> outputGradient{0.5, -1, 2, 1, -0.25};
+    Matrix<double> outputGradientMatrix(1, numSamples, outputGradient.data(), c_deviceId);
+    Matrix<double> logStddevGradient(numComponents, 1, c_deviceId);
+    logStddevGradient.SetValue(0);
+    setup.node->BackpropToLogStddev(logStddevGradient, outputGradientMatrix, normedDeviation, posterior, setup.featureDim, temp);
+
+    vector<double> expected = NumericalGradient(setup, outputGradient, 2);
+    for (size_t k = 0; k < numComponents; k++)
+        BOOST_CHECK_SMALL(logStddevGradient(k, 0) - expected[k], 1e-6);
+}
+
+// The parameter terms cached by the fused path must follow parameter values that are replaced other than by the
+// parameter update of SGD, here by rereading the model, as when SGD goes back to an earlier model.
+BOOST_AUTO_TEST_CASE(GMMLogLikelihoodRereadParametersTest)
+{
+    const wstring modelPath = L"GMMLogLikelihoodRereadParametersTest.model";
+    GMMTestSetup<double> setup(3, 4, 5, 4);
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<double> builder(*net);
+    auto createParameter = [&](const wstring& name, vector<double>& values)
+    {
+        auto parameter = builder.CreateLearnableParameter(name, TensorShape(values.size()));
+        parameter->Value().SetValue(values.size(), 1, c_deviceId, values.data());
+        return parameter;
+    };
+    auto features = builder.CreateInputNode(L"features", setup.featureDim);
+    auto mean = createParameter(L"mean", setup.means);
+    ComputationNodeBasePtr output = builder.GMMLogLikelihood(createParameter(L"prior", setup.unnormedPrior), mean,
+                                                             createParameter(L"logStddev", setup.logStddevs), features, L"output");
+    net->AddToNodeGroup(L"output", output);
+    net->CompileNetwork();
+    net->AllocateAllMatrices({}, {output}, nullptr);
+    net->Save(modelPath);
+
+    // a new minibatch (of the same features)
+    auto forwardProp = [&]()
+    {
+        net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(setup.numSamples);
+        features->Value().SetValue(setup.featureDim, setup.numSamples, c_deviceId, setup.features.data());
+        ComputationNetwork::BumpEvalTimeStamp({features});
+        net->ForwardProp(output);
+        return output->As<ComputationNode<double>>()->Value().DeepClone();
+    };
+    auto checkValue = [&](const Matrix<double>& value, const vector<double>& expected)
+    {
+        for (size_t t = 0; t < setup.numSamples; t++)
+            BOOST_CHECK_SMALL(value(0, t) - expected[t], 1e-10);
+    };
+    checkValue(forwardProp(), setup.Reference());
+
+    // an update of the means, as by SGD
+    vector<double> updatedMeans = setup.means;
+    for (auto& m : updatedMeans)
+        m += 0.5;
+    mean->Value().SetValue(updatedMeans.size(), 1, c_deviceId, updatedMeans.data());
+    mean->BumpEvalTimeStamp();
+    checkValue(forwardProp(), setup.Reference(GMMTestSetup<double>::ToDouble(setup.unnormedPrior), updatedMeans,
+                                              GMMTestSetup<double>::ToDouble(setup.logStddevs), GMMTestSetup<double>::ToDouble(setup.features)));
+
+    // back to the saved model
+    net->RereadPersistableParameters<double>(modelPath);
+    checkValue(forwardProp(), setup.Reference());
+
+    _wunlink(modelPath.c_str());
+}
+
+// Benchmark: the fused path vs. the generic chain of matrix operations (ForwardPropS()), which materializes the
+// (#components * featureDim x #frames) deviation vectors, at a typical acoustic model size. Only reports the times.
+// Disabled by default since it only measures; run it explicitly with
+//   --run_test=GMMLogLikelihoodNodeTestSuite/GMMLogLikelihoodBenchmark --log_level=message
+BOOST_AUTO_TEST_CASE(GMMLogLikelihoodBenchmark, *boost::unit_test::disabled())
+{
+    const size_t numComponents = 256, featureDim = 40, numSamples = 1024, numRuns = 5;
+    GMMTestSetup<float> setup(numComponents, featureDim, numSamples, 3);
+    auto& node = *setup.node;
+
+    Matrix<float> generic(c_deviceId), prior(c_deviceId), stddev(c_deviceId), normedDeviationVectors(c_deviceId), normedDeviation(c_deviceId), posterior(c_deviceId), temp(c_deviceId);
+    prior.Resize(numComponents, 1);
+    stddev.Resize(numComponents, 1);
+    normedDeviation.Resize(numComponents, numSamples);
+    normedDeviationVectors.Resize(numComponents * featureDim, numSamples);
+    posterior.Resize(numComponents, numSamples);
+    generic.Resize(1, numSamples);
+
+    Timer timer;
+    timer.Start();
+    for (size_t run = 0; run < numRuns; run++)
+        node.ForwardPropS(generic, setup.priorNode->Value(), setup.meanNode->Value(), setup.logStddevNode->Value(), setup.featureNode->Value(),
+                          prior, stddev, normedDeviationVectors, normedDeviation, posterior, temp);
+    timer.Stop();
+    double genericSeconds = timer.ElapsedSeconds() / numRuns;
+
+    timer.Start();
+    for (size_t run = 0; run < numRuns; run++)
+        setup.ForwardProp();
+    timer.Stop();
+    double fusedSeconds = timer.ElapsedSeconds() / numRuns;
+
+    BOOST_REQUIRE(node.UsedFusedKernel());
+    for (size_t t = 0; t < numSamples; t++)
+        BOOST_CHECK_SMALL(node.Value()(0, t) - generic(0, t), 1e-2f);
+    BOOST_TEST_MESSAGE("GMM log-likelihood of " << numSamples << " frames, " << numComponents << " components, dim " << featureDim << ": generic "
+                       << 1000 * genericSeconds << " ms, fused " << 1000 * fusedSeconds << " ms");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
@@ -0,0 +1,151 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/SGDLib/SGD.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "TestHelpers.h"
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// We perform test on CPU.
+static const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+// Stand-in for MPI: this process is rank 0 of 'numWorkers', and the other workers are simulated by the test,
+// which queues their summed contributions to the allreduces in the order in which they are issued.
+// An asynchronous allreduce completes when it is waited for.
+class SimulatedMPIWrapper : public MPIWrapperStub
+{
+public:
+    SimulatedMPIWrapper(size_t numWorkers)
+        : m_numWorkers(numWorkers), m_nextRequest(1)
+    {
+    }
+
+    // sum of the other workers' data for the next allreduce
+    void AddOtherWorkersContribution(const vector<double>& contribution) { m_contributions.push_back(contribution); }
+    size_t NumPendingContributions() const { return m_contributions.size(); }
+
+    size_t NumNodesInUse() const override { return m_numWorkers; }
+
+    void AllReduce(size_t* sendData, size_t numElements, MPI_Op = MPI_SUM) const override { Reduce(sendData, sendData, numElements); }
+    void AllReduce(int* sendData, size_t numElements, MPI_Op = MPI_SUM) const override { Reduce(sendData, sendData, numElements); }
+    void AllReduce(double* sendData, size_t numElements, MPI_Op = MPI_SUM) const override { Reduce(sendData, sendData, numElements); }
+    void AllReduce(float* sendData, size_t numElements, MPI_Op = MPI_SUM) const override { Reduce(sendData, sendData, numElements); }
+
+    void AllReduceAsync(size_t* sendData, size_t numElements, MPI_Request* request, MPI_Op = MPI_SUM) const override { ReduceAsync(sendData, numElements, request); }
+    void AllReduceAsync(int* sendData, size_t numElements, MPI_Request* request, MPI_Op = MPI_SUM) const override { ReduceAsync(sendData, numElements, request); }
+    void AllReduceAsync(double* sendData, size_t numElements, MPI_Request* request, MPI_Op = MPI_SUM) const override { ReduceAsync(sendData, numElements, request); }
+    void AllReduceAsync(float* sendData, size_t numElements, MPI_Request* request, MPI_Op = MPI_SUM) const override { ReduceAsync(sendData, numElements, request); }
+
+    void Wait(MPI_Request* request) override
+    {
+        auto iter = m_pendingRequests.find(*request);
+        if (iter == m_pendingRequests.end())
+            LogicError("SimulatedMPIWrapper: waiting for an unknown request");
+        iter->second();
+        m_pendingRequests.erase(iter);
+    }
+
+private:
+    template <class T>
+    void Reduce(const T* sendData, T* receiveData, size_t numElements) const
+    {
+        if (m_contributions.empty() || m_contributions.front().size() != numElements)
+            LogicError("SimulatedMPIWrapper: no contribution of the other workers queued for an allreduce of %d elements", (int)numElements);
+        for (size_t i = 0; i < numElements; i++)
+            receiveData[i] = (T)(sendData[i] + m_contributions.front()[i]);
+        m_contributions.pop_front();
+    }
+
+    // the contributions are taken in the order of the calls, like MPI matches the collectives of all workers
+    template <class T>
+    void ReduceAsync(T* data, size_t numElements, MPI_Request* request) const
+    {
+        auto result = make_shared<vector<T>>(data, data + numElements);
+        Reduce(result->data(), result->data(), numElements);
+        *request = m_nextRequest++;
+        m_pendingRequests[*request] = [result, data]() { copy(result->begin(), result->end(), data); };
+    }
+
+    size_t m_numWorkers;
+    mutable std::deque<vector<double>> m_contributions;
+    mutable std::map<MPI_Request, std::function<void()>> m_pendingRequests;
+    mutable MPI_Request m_nextRequest;
+};
+
+static vector<double> ToVector(const Matrix<float>& m)
+{
+    unique_ptr<float[]> data(m.CopyToArray());
+    return vector<double>(data.get(), data.get() + m.GetNumElements());
+}
+
+BOOST_AUTO_TEST_SUITE(ModelAveragingTestSuite)
+
+// The averaging started at one sync point is merged at the next one as model += weightedSum/total - snapshot,
+// so that the local updates made in the meantime are kept.
+BOOST_AUTO_TEST_CASE(OverlappedModelAveragingMergesDelta)
+{
+    auto mpi = make_shared<SimulatedMPIWrapper>(2);
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<float> builder(*net);
+    auto weights = builder.CreateLearnableParameter(L"W", 2, 3);
+    list<ComputationNodeBasePtr> learnableNodes = { weights };
+    list<MatrixBasePtr> smoothedGradients;
+
+    const vector<float> snapshot = { 1, 2, 3, 4, 5, 6 };
+    const vector<double> otherModel = { -1, 0, 1, 2, 10, 20 };
+    const size_t mySamples = 30, otherSamples = 10;
+    weights->Value().SetValue(2, 3, c_deviceId, const_cast<float*>(snapshot.data()));
+
+    OverlappedModelAveragingSGD<float> averaging(mpi, /*reportFreq=*/0, c_deviceId);
+    size_t totalSamplesProcessed;
+    float secondsOnCommunication;
+
+    // first sync point: start averaging; nothing has arrived yet, so the model is unchanged
+    mpi->AddOtherWorkersContribution({ (double)otherSamples });
+    vector<double> otherWeightedModel;
+    for (auto value : otherModel)
+        otherWeightedModel.push_back(otherSamples * value);
+    mpi->AddOtherWorkersContribution(otherWeightedModel);
+    averaging.ModelAggregationProcessing(mySamples, learnableNodes, smoothedGradients, totalSamplesProcessed, secondsOnCommunication);
+    BOOST_CHECK_EQUAL(mpi->NumPendingContributions(), 0);
+    BOOST_CHECK_EQUAL(totalSamplesProcessed, mySamples * 2); // (estimate, since no averaging has completed yet)
+    auto value = ToVector(weights->Value());
+    BOOST_CHECK_EQUAL_COLLECTIONS(value.begin(), value.end(), snapshot.begin(), snapshot.end());
+
+    // local progress until the next sync point
+    vector<float> localModel(snapshot.size());
+    for (size_t i = 0; i < snapshot.size(); i++)
+        localModel[i] = snapshot[i] + 0.5f * (float)i;
+    weights->Value().SetValue(2, 3, c_deviceId, localModel.data());
+    weights->BumpEvalTimeStamp();
+    uint64_t timeStamp = weights->GetEvalTimeStamp();
+
+    // second sync point: the first averaging is merged, and the second one is started
+    mpi->AddOtherWorkersContribution({ 0 });
+    mpi->AddOtherWorkersContribution(vector<double>(snapshot.size(), 0));
+    averaging.ModelAggregationProcessing(mySamples, learnableNodes, smoothedGradients, totalSamplesProcessed, secondsOnCommunication);
+    BOOST_CHECK_EQUAL(totalSamplesProcessed, mySamples + otherSamples);
+    BOOST_CHECK(weights->GetEvalTimeStamp() != timeStamp); // (nodes that cache terms of the parameter see the change)
+    value = ToVector(weights->Value());
+    for (size_t i = 0; i < snapshot.size(); i++)
+    {
+        double average = (mySamples * snapshot[i] + otherSamples * otherModel[i]) / (mySamples + otherSamples);
+        BOOST_CHECK_CLOSE(value[i], localModel[i] + average - snapshot[i], 1e-4);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
@@ -0,0 +1,141 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "Actions.h"
+#include "NDLNetworkBuilder.h"
+#include "File.h"
+#include "fileutil.h"
+#include "TestHelpers.h"
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+static const char* c_descriptionPath = "NetworkCacheTest.ndl";
+
+// an NDL description of z = W * features, with all weights set to the given value
+static void WriteDescription(float weight)
+{
+    FILE* f = fopenOrDie(c_descriptionPath, "w");
+    fprintf(f, "run = net\n"
+               "net = [\n"
+               "    features = Input(2)\n"
+               "    W = LearnableParameter(3, 2, init=\"fixedValue\", value=%g)\n"
+               "    z = Times(W, features)\n"
+               "    FeatureNodes = (features)\n"
+               "    OutputNodes = (z)\n"
+               "]\n", weight);
+    fcloseOrDie(f);
+}
+
+// gets the network through the network factory, with the cache in the current directory, and returns its weight
+static float CreateNetworkAndGetWeight()
+{
+    NDLScript<float> ndlScript;
+    ndlScript.ClearGlobal(); // clear global macros between tests
+
+    ConfigParameters config;
+    config.Parse(string("deviceId = -1\n"
+                        "precision = \"float\"\n"
+                        "networkCache = \".\"\n"
+                        "NDLNetworkBuilder = [ networkDescription = \"") + c_descriptionPath + "\" ]\n");
+    auto net = GetNetworkFactory<ConfigParameters, float>(config)(c_deviceId);
+    return net->GetNodeFromName(L"W")->As<ComputationNode<float>>()->Value()(0, 0);
+}
+
+// the model files of the cache entries in the current directory (each one has a .key file next to it)
+static vector<wstring> CacheEntries()
+{
+    vector<wstring> entries;
+    for (const auto& name : msra::files::get_all_files_from_directory(L"."))
+    {
+        if (name.find(L"network.") == 0 && name.find(L'.', wcslen(L"network.")) == wstring::npos)
+            entries.push_back(name);
+    }
+    return entries;
+}
+
+static void RemoveCacheEntries()
+{
+    for (const auto& entry : CacheEntries())
+    {
+        _wunlink(entry.c_str());
+        _wunlink((entry + L".key").c_str());
+    }
+}
+
+// changes the weight stored in a cache entry, so that a network read from the entry can be told from a built one
+static void SetWeightOfEntry(const wstring& path, float weight)
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    net->Load<float>(path);
+    net->GetNodeFromName(L"W")->As<ComputationNode<float>>()->Value().SetValue(weight);
+    net->Save(path);
+}
+
+// stand-in for MPI in a job of two workers, of which this is not the main one
+class SecondWorkerMPIWrapper : public MPIWrapperStub
+{
+public:
+    size_t NumNodesInUse() const override { return 2; }
+    size_t CurrentNodeRank() const override { return 1; }
+};
+
+BOOST_AUTO_TEST_SUITE(NetworkCacheTestSuite)
+
+// A built network is saved to the cache and read from there by later runs with the same description. Damaged
+// entries, entries of another description under the same name, and a changed description file lead to a rebuild.
+BOOST_AUTO_TEST_CASE(NetworkCache)
+{
+    RemoveCacheEntries();
+    WriteDescription(1);
+
+    // miss: built and saved
+    BOOST_CHECK_EQUAL(CreateNetworkAndGetWeight(), 1);
+    auto entries = CacheEntries();
+    BOOST_REQUIRE_EQUAL(entries.size(), 1);
+    const wstring path = entries[0];
+
+    // hit
+    SetWeightOfEntry(path, 2);
+    BOOST_CHECK_EQUAL(CreateNetworkAndGetWeight(), 2);
+
+    // a damaged model file is rebuilt, and the entry is replaced
+    FILE* f = _wfopen(path.c_str(), L"wb");
+    BOOST_REQUIRE(f != nullptr);
+    fputs("not a model", f);
+    fclose(f);
+    BOOST_CHECK_EQUAL(CreateNetworkAndGetWeight(), 1);
+    SetWeightOfEntry(path, 2);
+    BOOST_CHECK_EQUAL(CreateNetworkAndGetWeight(), 2);
+
+    // a hash collision: the full key stored with the entry is that of another description
+    File(path + L".key", FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite) << wstring(L"another description");
+    BOOST_CHECK_EQUAL(CreateNetworkAndGetWeight(), 1);
+
+    // a change of the description file, which the builder section only refers to, makes another entry
+    WriteDescription(3);
+    BOOST_CHECK_EQUAL(CreateNetworkAndGetWeight(), 3);
+    BOOST_CHECK_EQUAL(CacheEntries().size(), 2);
+
+    // in parallel training, only the main worker writes the cache
+    RemoveCacheEntries();
+    {
+        auto previousMPI = MPIWrapper::s_mpi;
+        MPIWrapper::s_mpi = make_shared<SecondWorkerMPIWrapper>();
+        auto restoreMPI = MakeScopeExit([&]() { MPIWrapper::s_mpi = previousMPI; });
+        BOOST_CHECK_EQUAL(CreateNetworkAndGetWeight(), 3);
+    }
+    BOOST_CHECK(CacheEntries().empty());
+
+    remove(c_descriptionPath);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
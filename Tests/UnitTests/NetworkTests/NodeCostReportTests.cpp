@@ -0,0 +1,98 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/LinearAlgebraNodes.h"
+#include "Globals.h"
+#include <fstream>
+#include <cstdio>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// We perform test on CPU.
+static const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+BOOST_AUTO_TEST_SUITE(NodeCostReportTestSuite)
+
+BOOST_AUTO_TEST_CASE(NodeCostReport)
+{
+    const size_t outputDim = 7, inputDim = 5, numSamples = 3;
+
+    // output = Times(W, x) + b, all learnable except the input
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<float> builder(*net);
+    auto weights = builder.CreateLearnableParameter(L"W", outputDim, inputDim);
+    auto bias = builder.CreateLearnableParameter(L"b", outputDim, 1);
+    auto features = builder.CreateInputNode(L"features", inputDim);
+    auto product = builder.Times(weights, features, 1, L"product");
+    auto output = builder.Plus(product, bias, L"output");
+    ComputationNodeBasePtr criterion = net->AddNodeToNetAndAttachInputs(make_shared<SumElementsNode<float>>(c_deviceId, L"criterion"), { output });
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->CompileNetwork();
+    net->AllocateAllMatrices({}, {}, criterion);
+
+    net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(numSamples);
+    vector<float> featureValues(inputDim * numSamples, 1.0f);
+    features->Value().SetValue(inputDim, numSamples, c_deviceId, featureValues.data());
+
+    // cost model: a matrix product takes 2*M*K*N operations, a reduction one per input element
+    double flops, bytes;
+    product->EstimateCost(/*backward=*/false, flops, bytes);
+    BOOST_CHECK_EQUAL(flops, 2.0 * outputDim * inputDim * numSamples);
+    BOOST_CHECK_EQUAL(bytes, (outputDim * inputDim + inputDim * numSamples + outputDim * numSamples) * sizeof(float));
+    product->EstimateCost(/*backward=*/true, flops, bytes);
+    BOOST_CHECK_EQUAL(flops, 2.0 * outputDim * inputDim * numSamples); // only W needs a gradient
+    criterion->EstimateCost(/*backward=*/false, flops, bytes);
+    BOOST_CHECK_EQUAL(flops, (double)outputDim * numSamples);
+
+    bool nodeTiming = Globals::ShouldEnableNodeTiming();
+    Globals::SetNodeTiming(true);
+    const size_t numSteps = 2;
+    for (size_t step = 0; step < numSteps; step++)
+    {
+        ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ features });
+        ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+        net->ForwardProp(criterion);
+        net->Backprop(criterion);
+    }
+    Globals::SetNodeTiming(nodeTiming);
+
+    auto statistics = product->GetTimingStatistics(/*backward=*/false);
+    BOOST_CHECK_EQUAL(statistics.count, numSteps);
+    BOOST_CHECK_EQUAL(statistics.flops, numSteps * 2.0 * outputDim * inputDim * numSamples);
+    BOOST_CHECK_EQUAL(product->GetTimingStatistics(/*backward=*/true).count, numSteps);
+
+    // one line per timed node and phase, plus the header
+    net->WriteNodeCostReport(L"NodeCostReportTest", 1);
+    ifstream csv("NodeCostReportTest.csv");
+    BOOST_REQUIRE(csv.good());
+    string line;
+    size_t numLines = 0;
+    bool productForwardFound = false;
+    while (getline(csv, line))
+    {
+        numLines++;
+        productForwardFound |= line.compare(0, 24, "product,Times,forward,2,") == 0;
+    }
+    csv.close();
+    BOOST_CHECK_EQUAL(numLines, 1 + 6); // product, output and criterion, forward and backward
+    BOOST_CHECK(productForwardFound);
+    BOOST_CHECK(ifstream("NodeCostReportTest.json").good());
+
+    // the report resets the timing
+    BOOST_CHECK_EQUAL(product->GetTimingStatistics(/*backward=*/false).count, 0);
+
+    remove("NodeCostReportTest.csv");
+    remove("NodeCostReportTest.json");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
@@ -0,0 +1,210 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNode.h"
+#include "DataWriter.h"
+#include "../../../Source/SGDLib/SimpleOutputWriter.h"
+#include <random>
+#include <cstdio>
+#include <thread>
+#include <chrono>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// reference formatting of a single sequence with one line per sample, as fprintf() would produce it
+static string FormatWithPrintf(const vector<float>& values, size_t rows, const char* valueFormat)
+{
+    string expected;
+    char buffer[512];
+    for (size_t j = 0; j < values.size() / rows; j++)
+    {
+        if (j > 0)
+            expected += "\n";
+        for (size_t i = 0; i < rows; i++)
+        {
+            if (i > 0)
+                expected += " ";
+            double value = values[i + j * rows];
+            if (value == 0)
+                value = 0; // the writer clears the sign of a negative 0
+            sprintf(buffer, valueFormat, value);
+            expected += buffer;
+        }
+    }
+    return expected + "\n";
+}
+
+static string ReadFile(FILE* f)
+{
+    fflush(f);
+    rewind(f);
+    string content;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+        content.append(buffer, n);
+    return content;
+}
+
+BOOST_AUTO_TEST_SUITE(OutputFormattingTestSuite)
+
+// the fast value formatting must produce exactly what fprintf() does, including rounding of ties and huge values
+BOOST_AUTO_TEST_CASE(FormatMinibatchMatchesPrintf)
+{
+    const size_t rows = 7, cols = 500;
+    mt19937 rng(13);
+    uniform_real_distribution<double> exponent(-12, 40);
+    vector<float> values(rows * cols);
+    for (size_t k = 0; k < values.size(); k++)
+    {
+        switch (k % 4)
+        {
+        case 0: values[k] = (float)exp(exponent(rng)); break;                  // all magnitudes
+        case 1: values[k] = -(float)((int)(rng() % 100000)) / 1024.0f; break;  // exact binary fractions, i.e. rounding ties
+        case 2: values[k] = (float)(rng() % 3) - 1.0f; break;                  // -1, 0, 1
+        default: values[k] = numeric_limits<float>::infinity(); break;
+        }
+    }
+
+    for (const char* valueFormat : {"%f", "%.0f", "%.2f", "%.5f", "%.9f", "%10.3f"})
+    {
+        string text;
+        vector<float> data = values;
+        ComputationNode<float>::FormatMinibatch(text, data.data(), rows, cols, /*pMBLayout=*/nullptr, TensorShape(rows), FrameRange(), SIZE_MAX, SIZE_MAX,
+                                                /*transpose=*/true, /*isCategoryLabel=*/false, /*isSparse=*/false, vector<string>(),
+                                                ""/*sequenceSeparator*/, ""/*sequencePrologue*/, "\n"/*sequenceEpilogue*/, " "/*elementSeparator*/, "\n"/*sampleSeparator*/,
+                                                valueFormat);
+        BOOST_CHECK_MESSAGE(text == FormatWithPrintf(values, rows, valueFormat), "formatting with '" << valueFormat << "' differs from printf()");
+    }
+}
+
+// sequences are written one by one, skipping gaps, with the sequence id substituted into the prologue
+BOOST_AUTO_TEST_CASE(FormatMinibatchSequences)
+{
+    // two parallel sequences: #5 of length 2, #8 of length 1 followed by a gap
+    auto pMBLayout = make_shared<MBLayout>();
+    pMBLayout->Init(2, 2);
+    pMBLayout->AddSequence(5, 0, 0, 2);
+    pMBLayout->AddSequence(8, 1, 0, 1);
+    pMBLayout->AddGap(1, 1, 2);
+
+    // category labels, stored as one-hot columns in time-major order: (s0,t0), (s1,t0), (s0,t1), (s1,t1)
+    vector<float> data = { 0, 1, 0,   0, 0, 1,   1, 0, 0,   0, 0, 0 };
+    string text;
+    ComputationNode<float>::FormatMinibatch(text, data.data(), 3, 4, pMBLayout, TensorShape(3), FrameRange(), SIZE_MAX, SIZE_MAX,
+                                            /*transpose=*/true, /*isCategoryLabel=*/true, /*isSparse=*/false, { "a", "b", "c" },
+                                            "|"/*sequenceSeparator*/, "%d:"/*sequencePrologue*/, ";"/*sequenceEpilogue*/, " "/*elementSeparator*/, ","/*sampleSeparator*/,
+                                            "%s");
+    BOOST_CHECK_EQUAL(text, "5:b,a;|8:c;");
+}
+
+// the outputs are written in the order of submission, no matter how long each one takes to format
+BOOST_AUTO_TEST_CASE(OutputFormattingPipelineKeepsOrder)
+{
+    const size_t numMinibatches = 50;
+    for (auto config : vector<pair<size_t, size_t>>{ { 0, 1 }, { 1, 1 }, { 3, 1 }, { 3, 4 }, { 8, 4 } })
+    {
+        size_t maxPendingMinibatches = config.first, numWorkers = config.second;
+        FILE* f = tmpfile();
+        BOOST_REQUIRE(f != nullptr);
+        string expected;
+        {
+            OutputFormattingPipeline pipeline(maxPendingMinibatches, numWorkers);
+            mt19937 rng(17);
+            for (size_t mb = 0; mb < numMinibatches; mb++)
+            {
+                OutputFormattingPipeline::Minibatch minibatch;
+                for (size_t node = 0; node < 2; node++)
+                {
+                    string text = "mb" + to_string(mb) + "." + to_string(node) + "\n";
+                    int delayMicroseconds = (int)(rng() % 2000);
+                    minibatch.emplace_back(f, [text, delayMicroseconds]()
+                    {
+                        this_thread::sleep_for(chrono::microseconds(delayMicroseconds));
+                        return text;
+                    });
+                    expected += text;
+                }
+                pipeline.Submit(move(minibatch));
+            }
+            pipeline.Finish();
+        }
+        BOOST_CHECK_MESSAGE(ReadFile(f) == expected, "outputs are out of order with maxPendingMinibatches=" << maxPendingMinibatches << " numWorkers=" << numWorkers);
+        fclose(f);
+    }
+}
+
+// a formatting error on a worker thread reaches the caller
+BOOST_AUTO_TEST_CASE(OutputFormattingPipelineRethrowsErrors)
+{
+    auto submitAll = [](FILE* f, size_t numWorkers)
+    {
+        OutputFormattingPipeline pipeline(2, numWorkers);
+        for (size_t mb = 0; mb < 20; mb++)
+        {
+            OutputFormattingPipeline::Minibatch minibatch;
+            minibatch.emplace_back(f, [mb]() -> string
+            {
+                if (mb == 5)
+                    RuntimeError("cannot format minibatch %d", (int)mb);
+                return "x";
+            });
+            pipeline.Submit(move(minibatch));
+        }
+        pipeline.Finish();
+    };
+    for (size_t numWorkers : { 1, 4 })
+    {
+        FILE* f = tmpfile();
+        BOOST_REQUIRE(f != nullptr);
+        BOOST_CHECK_THROW(submitAll(f, numWorkers), std::runtime_error);
+        BOOST_CHECK_EQUAL(ReadFile(f), "xxxxx"); // all minibatches before the failing one, and none after it
+        fclose(f);
+    }
+}
+
+// the binary format holds raw float32 values of each sample, in the sample order of the text format, skipping gaps
+BOOST_AUTO_TEST_CASE(SerializeMinibatchOutputBinary)
+{
+    // same layout as in FormatMinibatchSequences: #5 of length 2, #8 of length 1 followed by a gap
+    auto pMBLayout = make_shared<MBLayout>();
+    pMBLayout->Init(2, 2);
+    pMBLayout->AddSequence(5, 0, 0, 2);
+    pMBLayout->AddSequence(8, 1, 0, 1);
+    pMBLayout->AddGap(1, 1, 2);
+
+    // columns in time-major order: (s0,t0), (s1,t0), (s0,t1), (s1,t1)
+    const double values[] = { 0.1, 0.2,   1.1, 1.2,   2.1, 2.2,   -1, -1 };
+    SimpleOutputWriter<double>::MinibatchOutput output;
+    output.values.reset(new double[8]);
+    copy(values, values + 8, output.values.get());
+    output.numRows = 2;
+    output.numCols = 4;
+    output.pMBLayout = pMBLayout;
+    output.sampleLayout = TensorShape(2);
+
+    string data = SimpleOutputWriter<double>::SerializeMinibatchOutput(output);
+    const float expected[] = { 0.1f, 0.2f,   2.1f, 2.2f,   1.1f, 1.2f };
+    BOOST_REQUIRE_EQUAL(data.size(), sizeof(expected));
+    vector<float> actual(data.size() / sizeof(float));
+    memcpy(actual.data(), data.data(), data.size());
+    BOOST_CHECK_EQUAL_COLLECTIONS(actual.begin(), actual.end(), expected, expected + 6);
+
+    // without a layout, all columns are written in order
+    output.pMBLayout = nullptr;
+    data = SimpleOutputWriter<double>::SerializeMinibatchOutput(output);
+    BOOST_REQUIRE_EQUAL(data.size(), 8 * sizeof(float));
+    memcpy(actual.data(), data.data(), 6 * sizeof(float));
+    BOOST_CHECK_EQUAL(actual[2], 1.1f);
+    BOOST_CHECK_EQUAL(actual[5], 2.2f);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
@@ -0,0 +1,388 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/SGDLib/SharedMemoryParameterServer.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "ASGDHelper.h"
+#include "TimerUtility.h"
+#include "TestHelpers.h"
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// The workers of these tests are threads. Each attaches to the server by name, so that it has its own
+// mapping of the shared memory, like a worker process.
+static string UniqueServerName(const char* test)
+{
+    return msra::strfun::strprintf("cntk-test-%s-%llx", test, (unsigned long long)random_device()());
+}
+
+// least-squares problem y = w*x + noise, whose samples are split among the workers
+struct LeastSquaresProblem
+{
+    size_t dim, numSamples;
+    vector<float> x, y; // x: [numSamples x dim]
+
+    LeastSquaresProblem(size_t dim, size_t numSamples)
+        : dim(dim), numSamples(numSamples), x(dim * numSamples), y(numSamples)
+    {
+        mt19937 rng(42);
+        normal_distribution<float> normal;
+        vector<float> w(dim);
+        for (auto& value : w)
+            value = normal(rng);
+        for (size_t j = 0; j < numSamples; j++)
+        {
+            y[j] = 0.01f * normal(rng);
+            for (size_t i = 0; i < dim; i++)
+            {
+                x[j * dim + i] = normal(rng);
+                y[j] += w[i] * x[j * dim + i];
+            }
+        }
+    }
+
+    // model += -learningRate * gradient of the mean squared error over samples [begin, end)
+    void Step(vector<float>& model, size_t begin, size_t end, float learningRate) const
+    {
+        vector<float> gradient(dim, 0);
+        for (size_t j = begin; j < end; j++)
+        {
+            const float* xj = &x[j * dim];
+            float error = -y[j];
+            for (size_t i = 0; i < dim; i++)
+                error += model[i] * xj[i];
+            for (size_t i = 0; i < dim; i++)
+                gradient[i] += error * xj[i];
+        }
+        for (size_t i = 0; i < dim; i++)
+            model[i] -= learningRate * gradient[i] / (end - begin);
+    }
+
+    double Loss(const vector<float>& model) const
+    {
+        double loss = 0;
+        for (size_t j = 0; j < numSamples; j++)
+        {
+            double error = -y[j];
+            for (size_t i = 0; i < dim; i++)
+                error += model[i] * x[j * dim + i];
+            loss += error * error;
+        }
+        return loss / numSamples;
+    }
+};
+
+class ThreadBarrier
+{
+public:
+    ThreadBarrier(size_t numThreads) : m_numThreads(numThreads), m_numWaiting(0), m_generation(0) { }
+
+    void Wait()
+    {
+        unique_lock<mutex> lock(m_mutex);
+        size_t generation = m_generation;
+        if (++m_numWaiting == m_numThreads)
+        {
+            m_numWaiting = 0;
+            m_generation++;
+            m_allArrived.notify_all();
+        }
+        else
+            m_allArrived.wait(lock, [&]() { return m_generation != generation; });
+    }
+
+private:
+    size_t m_numThreads, m_numWaiting, m_generation;
+    mutex m_mutex;
+    condition_variable m_allArrived;
+};
+
+// Stand-in for the MPI of the worker processes, which are threads here: each thread sets its rank,
+// and WaitAll() and Bcast() synchronize the threads.
+class ThreadMPIWrapper : public MPIWrapperStub
+{
+public:
+    ThreadMPIWrapper(size_t numWorkers) : m_numWorkers(numWorkers), m_barrier(numWorkers) { }
+
+    static void SetRank(size_t rank) { Rank() = rank; }
+
+    size_t NumNodesInUse() const override { return m_numWorkers; }
+    size_t CurrentNodeRank() const override { return Rank(); }
+
+    int WaitAll() override
+    {
+        m_barrier.Wait();
+        return 0;
+    }
+
+    void Bcast(size_t* data, size_t numElements, size_t srcRank) override
+    {
+        if (CurrentNodeRank() == srcRank)
+            m_bcastData.assign(data, data + numElements);
+        m_barrier.Wait();
+        if (CurrentNodeRank() != srcRank)
+            copy(m_bcastData.begin(), m_bcastData.end(), data);
+        m_barrier.Wait();
+    }
+
+private:
+    static size_t& Rank()
+    {
+        static thread_local size_t rank = 0;
+        return rank;
+    }
+
+    size_t m_numWorkers;
+    ThreadBarrier m_barrier;
+    vector<size_t> m_bcastData;
+};
+
+// Runs 'work' on 'numWorkers' threads that train through the shared-memory ASGD helper. Each worker has a model
+// of 4 parameters, which start at 1. Returns what each worker recorded.
+template <class F>
+static vector<vector<float>> RunASGDWorkers(size_t numWorkers, bool simModelAverage, size_t pushesPerPull, const F& work)
+{
+    auto previousMPI = MPIWrapper::s_mpi;
+    MPIWrapper::s_mpi = make_shared<ThreadMPIWrapper>(numWorkers);
+    auto restoreMPI = MakeScopeExit([&]() { MPIWrapper::s_mpi = previousMPI; });
+
+    vector<vector<float>> observed(numWorkers);
+    vector<string> errors(numWorkers);
+    vector<thread> workers;
+    for (size_t w = 0; w < numWorkers; w++)
+        workers.emplace_back([&, w]()
+        {
+            try
+            {
+                ThreadMPIWrapper::SetRank(w);
+                auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+                ComputationNetworkBuilder<float> builder(*net);
+                auto weights = builder.CreateLearnableParameter(L"W", 4, 1);
+                weights->Value().SetValue(1.0f);
+                list<ComputationNodeBasePtr> learnableNodes = { weights };
+                unique_ptr<ASGDHelper<float>> helper(NewASGDHelper<float>(learnableNodes, numWorkers, /*useAsyncBuffered=*/false, simModelAverage,
+                                                                          AdjustLearningRateAtBeginning::None, 0.2, 600, /*traceLevel=*/0, /*syncPerfStats=*/0,
+                                                                          /*numShards=*/2, pushesPerPull, /*delayCompensation=*/0));
+                helper->InitModel(learnableNodes);
+                work(w, *helper, learnableNodes, weights->Value(), observed[w]);
+            }
+            catch (const exception& e)
+            {
+                errors[w] = e.what();
+            }
+        });
+    for (auto& worker : workers)
+        worker.join();
+    for (size_t w = 0; w < numWorkers; w++)
+        BOOST_REQUIRE_MESSAGE(errors[w].empty(), "worker " << w << " failed: " << errors[w]);
+    return observed;
+}
+
+BOOST_AUTO_TEST_SUITE(ParameterServerTestSuite)
+
+// With pushesPerPull, a worker pushes at every sync but gets the global model back only at every N-th one.
+BOOST_AUTO_TEST_CASE(SharedMemoryASGDPushesPerPull)
+{
+    // worker 0 adds 1 per sync and syncs twice, then worker 1 adds 2 per sync and syncs twice
+    auto observed = RunASGDWorkers(2, /*simModelAverage=*/false, /*pushesPerPull=*/2,
+        [](size_t w, ASGDHelper<float>& helper, const list<ComputationNodeBasePtr>& learnableNodes, Matrix<float>& value, vector<float>& observed)
+        {
+            if (w == 1)
+                helper.WaitAll();
+            for (size_t sync = 0; sync < 2; sync++)
+            {
+                value += (float)(w + 1);
+                helper.PushAndPullModel(learnableNodes, /*sampleSinceLastSynced=*/1);
+                observed.push_back(value.Get00Element());
+            }
+            if (w == 0)
+                helper.WaitAll();
+        });
+    // the first sync only pushes, so the worker keeps its own model; the second one pulls the sum of all pushes
+    vector<float> expected0 = { 2, 3 }, expected1 = { 3, 7 };
+    BOOST_CHECK_EQUAL_COLLECTIONS(observed[0].begin(), observed[0].end(), expected0.begin(), expected0.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(observed[1].begin(), observed[1].end(), expected1.begin(), expected1.end());
+}
+
+// Delay compensation needs a worker that gets the global model back at every sync.
+BOOST_AUTO_TEST_CASE(SharedMemoryASGDRejectsDelayCompensationWithPushesPerPull)
+{
+    auto previousMPI = MPIWrapper::s_mpi;
+    MPIWrapper::s_mpi = make_shared<ThreadMPIWrapper>(1);
+    auto restoreMPI = MakeScopeExit([&]() { MPIWrapper::s_mpi = previousMPI; });
+
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    list<ComputationNodeBasePtr> learnableNodes = { builder.CreateLearnableParameter(L"W", 4, 1) };
+    BOOST_CHECK_THROW(NewASGDHelper<float>(learnableNodes, 1, /*useAsyncBuffered=*/false, /*simModelAverage=*/false,
+                                           AdjustLearningRateAtBeginning::None, 0.2, 600, /*traceLevel=*/0, /*syncPerfStats=*/0,
+                                           /*numShards=*/2, /*pushesPerPull=*/2, /*delayCompensation=*/0.1),
+                      std::invalid_argument);
+}
+
+// With SimModelAverage, all workers end each sync with the average of their models.
+BOOST_AUTO_TEST_CASE(SharedMemoryASGDSimModelAverage)
+{
+    auto observed = RunASGDWorkers(3, /*simModelAverage=*/true, /*pushesPerPull=*/1,
+        [](size_t w, ASGDHelper<float>& helper, const list<ComputationNodeBasePtr>& learnableNodes, Matrix<float>& value, vector<float>& observed)
+        {
+            for (size_t sync = 0; sync < 2; sync++)
+            {
+                value += (float)(w + 1);
+                helper.PushAndPullModel(learnableNodes, /*sampleSinceLastSynced=*/1);
+                observed.push_back(value.Get00Element());
+            }
+        });
+    // each sync adds the average change (1 + 2 + 3) / 3
+    for (const auto& workerObserved : observed)
+    {
+        BOOST_REQUIRE_EQUAL(workerObserved.size(), 2);
+        BOOST_CHECK_CLOSE(workerObserved[0], 3.0f, 1e-4);
+        BOOST_CHECK_CLOSE(workerObserved[1], 5.0f, 1e-4);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(SharedMemoryParameterServerConcurrentPushes)
+{
+    const size_t modelSize = 1000, numShards = 7, numWorkers = 4, numPushes = 500;
+    string name = UniqueServerName("pushes");
+    SharedMemoryParameterServer<float> server(name, modelSize, numShards, /*create=*/true);
+    vector<float> initialModel(modelSize, 1.0f);
+    server.SetModel(initialModel.data());
+
+    // every worker adds 1 per push; with working locks, no addition gets lost
+    vector<thread> workers;
+    for (size_t w = 0; w < numWorkers; w++)
+        workers.emplace_back([&, w]()
+        {
+            SharedMemoryParameterServer<float> worker(name, modelSize, numShards, /*create=*/false);
+            vector<float> delta(modelSize, 1.0f), pulled(modelSize);
+            for (size_t k = 0; k < numPushes; k++)
+                worker.Push(delta.data(), nullptr, 1.0f, 0.0f, k % 2 ? pulled.data() : nullptr, w * numShards / numWorkers);
+        });
+    for (auto& worker : workers)
+        worker.join();
+    server.Unlink();
+
+    vector<float> model(modelSize);
+    server.Pull(model.data());
+    for (size_t i = 0; i < modelSize; i++)
+        BOOST_REQUIRE_EQUAL(model[i], 1.0f + numWorkers * numPushes);
+    BOOST_CHECK_EQUAL(server.NumPushes(), numWorkers * numPushes);
+}
+
+BOOST_AUTO_TEST_CASE(SharedMemoryParameterServerDelayCompensation)
+{
+    const size_t modelSize = 3;
+    SharedMemoryParameterServer<float> server(UniqueServerName("dc"), modelSize, 2, /*create=*/true);
+    server.Unlink();
+    vector<float> model{ 1, 2, 3 }, base{ 0, 2, 4 }, delta{ 2, 2, 2 };
+    server.SetModel(model.data());
+
+    // delta - c * delta^2 * (model - base), with c = 0.5
+    server.Push(delta.data(), base.data(), 1.0f, 0.5f, model.data());
+    BOOST_CHECK_EQUAL(model[0], 1.0f + 2 - 2);
+    BOOST_CHECK_EQUAL(model[1], 2.0f + 2);
+    BOOST_CHECK_EQUAL(model[2], 3.0f + 2 + 2);
+}
+
+// Benchmark: asynchronous SGD through the shared-memory server vs. synchronous data-parallel SGD, which
+// averages the models of all workers after every minibatch. Reports the throughput and the reached loss.
+// Disabled by default since it is slow and mostly reports times; run it explicitly with
+//   --run_test=ParameterServerTestSuite/SharedMemoryParameterServerBenchmark --log_level=message
+BOOST_AUTO_TEST_CASE(SharedMemoryParameterServerBenchmark, *boost::unit_test::disabled())
+{
+    const size_t dim = 512, numSamples = 16384, minibatchSize = 32, numWorkers = 4, numEpochs = 4;
+    const float learningRate = 0.01f;
+    LeastSquaresProblem problem(dim, numSamples);
+    const size_t samplesPerWorker = numSamples / numWorkers;
+
+    // synchronous: after each minibatch, wait for all workers and average
+    {
+        vector<float> model(dim, 0);
+        vector<vector<float>> localModels(numWorkers, model);
+        ThreadBarrier barrier(numWorkers);
+        Timer timer;
+        timer.Start();
+        vector<thread> workers;
+        for (size_t w = 0; w < numWorkers; w++)
+            workers.emplace_back([&, w]()
+            {
+                for (size_t epoch = 0; epoch < numEpochs; epoch++)
+                    for (size_t begin = w * samplesPerWorker; begin < (w + 1) * samplesPerWorker; begin += minibatchSize)
+                    {
+                        problem.Step(localModels[w], begin, begin + minibatchSize, learningRate);
+                        barrier.Wait();
+                        if (w == 0)
+                        {
+                            for (size_t i = 0; i < dim; i++)
+                            {
+                                float sum = 0;
+                                for (const auto& localModel : localModels)
+                                    sum += localModel[i];
+                                model[i] = sum / numWorkers;
+                            }
+                        }
+                        barrier.Wait();
+                        localModels[w] = model;
+                    }
+            });
+        for (auto& worker : workers)
+            worker.join();
+        timer.Stop();
+        BOOST_TEST_MESSAGE("synchronous data-parallel SGD: " << numEpochs * numSamples / timer.ElapsedSeconds() << " samples/s, loss " << problem.Loss(model));
+    }
+
+    // asynchronous: push the delta after each 'syncPeriod' minibatches, without waiting for the other workers
+    for (size_t syncPeriod : {1, 4})
+    {
+        string name = UniqueServerName("benchmark");
+        SharedMemoryParameterServer<float> server(name, dim, /*numShards=*/8, /*create=*/true);
+        Timer timer;
+        timer.Start();
+        vector<thread> workers;
+        for (size_t w = 0; w < numWorkers; w++)
+            workers.emplace_back([&, w]()
+            {
+                SharedMemoryParameterServer<float> worker(name, dim, 8, /*create=*/false);
+                vector<float> base(dim, 0), model(dim, 0), delta(dim);
+                size_t numMinibatches = 0;
+                for (size_t epoch = 0; epoch < numEpochs; epoch++)
+                    for (size_t begin = w * samplesPerWorker; begin < (w + 1) * samplesPerWorker; begin += minibatchSize)
+                    {
+                        problem.Step(model, begin, begin + minibatchSize, learningRate);
+                        if (++numMinibatches % syncPeriod != 0)
+                            continue;
+                        for (size_t i = 0; i < dim; i++)
+                            delta[i] = model[i] - base[i];
+                        worker.Push(delta.data(), base.data(), 1.0f / numWorkers, 0.0f, base.data(), w * 8 / numWorkers);
+                        model = base;
+                    }
+            });
+        for (auto& worker : workers)
+            worker.join();
+        timer.Stop();
+        server.Unlink();
+
+        vector<float> model(dim);
+        server.Pull(model.data());
+        BOOST_TEST_MESSAGE("asynchronous SGD, push every " << syncPeriod << " minibatches: " << numEpochs * numSamples / timer.ElapsedSeconds()
+                           << " samples/s, loss " << problem.Loss(model) << " (" << server.NumPushes() << " pushes)");
+        BOOST_CHECK_LT(problem.Loss(model), problem.Loss(vector<float>(dim, 0)));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
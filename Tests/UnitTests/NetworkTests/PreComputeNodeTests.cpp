@@ -0,0 +1,168 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/PreComputeNodes.h"
+#include "TestHelpers.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// We perform test on CPU.
+static const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+// precompute node of type NodeType over a dummy input of 2-dimensional samples
+template <template <class> class NodeType, class ElemType>
+shared_ptr<NodeType<ElemType>> CreatePreComputeNode(const ComputationEnvironmentPtr& environment)
+{
+    auto node = make_shared<NodeType<ElemType>>(c_deviceId, L"PreComputeNodeTest");
+    auto input = make_shared<DummyNodeTest<ElemType>>(c_deviceId, L"Input");
+    node->AttachInputs({input});
+    node->SetEnvironment(environment);
+    return node;
+}
+
+template <template <class> class NodeType, class ElemType>
+void SetInput(const shared_ptr<NodeType<ElemType>>& node, std::vector<ElemType> data)
+{
+    const SmallVector<size_t> sampleDimensions{2};
+    auto input = dynamic_pointer_cast<DummyNodeTest<ElemType>>(node->GetInputs()[0]);
+    input->SetMinibatch(data.size() / 2, sampleDimensions, data);
+    static_pointer_cast<ComputationNodeBase>(node)->Validate(true);
+    node->CreateValueMatrixIfNull();
+}
+
+template <template <class> class NodeType, class ElemType>
+void PreComputeForward(const shared_ptr<NodeType<ElemType>>& node, std::vector<ElemType> data)
+{
+    SetInput<NodeType, ElemType>(node, data);
+    ComputationNodeBasePtr baseNode = node;
+    baseNode->BeginForwardProp();
+    baseNode->ForwardProp(FrameRange());
+    baseNode->EndForwardProp();
+}
+
+// Sums vectors over numWorkers threads like MPI AllReduce does over ranks: each call returns once all workers made it.
+class ThreadAllReduce
+{
+public:
+    explicit ThreadAllReduce(size_t numWorkers)
+        : m_numWorkers(numWorkers), m_numArrived(0), m_generation(0)
+    {
+    }
+
+    void operator()(std::vector<double>& values)
+    {
+        unique_lock<mutex> lock(m_mutex);
+        if (m_numArrived == 0)
+            m_sum.assign(values.size(), 0);
+        for (size_t i = 0; i < values.size(); i++)
+            m_sum[i] += values[i];
+        size_t generation = m_generation;
+        if (++m_numArrived == m_numWorkers)
+        {
+            m_result = m_sum;
+            m_numArrived = 0;
+            m_generation++;
+            m_done.notify_all();
+        }
+        else
+            m_done.wait(lock, [&] { return m_generation != generation; });
+        values = m_result;
+    }
+
+private:
+    size_t m_numWorkers, m_numArrived, m_generation;
+    std::vector<double> m_sum, m_result;
+    mutex m_mutex;
+    condition_variable m_done;
+};
+
+// Feeds the samples to one node in a single pass, and split over two nodes whose accumulators are merged
+// by MergeAccumulatorState() (as SGD does for the workers of a parallel precomputation). All must give the same result.
+template <template <class> class NodeType, class ElemType>
+void PreComputeMergeTestImpl(const std::vector<ElemType>& expectedValue)
+{
+    auto environment = make_shared<ComputationEnvironment>();
+    environment->SetOperationMode(NetworkOperationMode::preComputing);
+
+    const std::vector<ElemType> part1{1, 10, 2, 20, 3, 30, 4, 40};
+    const std::vector<ElemType> part2{5, 50, 9, 90};
+
+    // single pass
+    auto serial = CreatePreComputeNode<NodeType, ElemType>(environment);
+    SetInput<NodeType, ElemType>(serial, part1); // MarkComputed() needs the dimensions
+    serial->MarkComputed(false);
+    PreComputeForward<NodeType, ElemType>(serial, part1);
+    PreComputeForward<NodeType, ElemType>(serial, part2);
+
+    // two partial passes
+    auto node1 = CreatePreComputeNode<NodeType, ElemType>(environment);
+    auto node2 = CreatePreComputeNode<NodeType, ElemType>(environment);
+    SetInput<NodeType, ElemType>(node1, part1);
+    SetInput<NodeType, ElemType>(node2, part2);
+    node1->MarkComputed(false);
+    node2->MarkComputed(false);
+    PreComputeForward<NodeType, ElemType>(node1, part1);
+    PreComputeForward<NodeType, ElemType>(node2, part2);
+
+    std::vector<double> mean, var;
+    BOOST_REQUIRE_EQUAL(node1->GetAccumulatorState(mean, var), 4);
+    BOOST_REQUIRE_EQUAL(node2->GetAccumulatorState(mean, var), 2);
+
+    // each node merges on its own thread, as each MPI rank does in SGD::PreCompute()
+    ThreadAllReduce sumOverWorkers(2);
+    thread worker2([&] { node2->MergeAccumulatorState(std::ref(sumOverWorkers)); });
+    node1->MergeAccumulatorState(std::ref(sumOverWorkers));
+    worker2.join();
+
+    std::vector<double> serialMean, serialVar, mean2, var2;
+    BOOST_REQUIRE_EQUAL(serial->GetAccumulatorState(serialMean, serialVar), 6);
+    BOOST_REQUIRE_EQUAL(node1->GetAccumulatorState(mean, var), 6);
+    BOOST_REQUIRE_EQUAL(node2->GetAccumulatorState(mean2, var2), 6);
+    BOOST_REQUIRE_EQUAL(var.size(), serialVar.size());
+    for (size_t i = 0; i < mean.size(); i++)
+    {
+        BOOST_CHECK_CLOSE(mean[i], serialMean[i], 1e-3);
+        BOOST_CHECK_EQUAL(mean2[i], mean[i]);
+    }
+    for (size_t i = 0; i < var.size(); i++)
+    {
+        BOOST_CHECK_CLOSE(var[i], serialVar[i], 1e-3);
+        BOOST_CHECK_EQUAL(var2[i], var[i]);
+    }
+
+    node1->MarkComputed(true);
+    node2->MarkComputed(true);
+    serial->MarkComputed(true);
+    BOOST_REQUIRE(AreEqual(expectedValue.data(), serial->Value().Data(), expectedValue.size(), 1e-4f));
+    BOOST_REQUIRE(AreEqual(expectedValue.data(), node1->Value().Data(), expectedValue.size(), 1e-4f));
+    BOOST_REQUIRE(AreEqual(expectedValue.data(), node2->Value().Data(), expectedValue.size(), 1e-4f));
+}
+
+BOOST_AUTO_TEST_SUITE(PreComputeNodeTestSuite)
+
+BOOST_AUTO_TEST_CASE(MeanNodeMergeTest)
+{
+    PreComputeMergeTestImpl<MeanNode, float>({4, 40});
+    PreComputeMergeTestImpl<MeanNode, double>({4, 40});
+}
+
+BOOST_AUTO_TEST_CASE(InvStdDevNodeMergeTest)
+{
+    // variance of {1, 2, 3, 4, 5, 9} is 20/3
+    PreComputeMergeTestImpl<InvStdDevNode, float>({(float)(1 / sqrt(20.0 / 3)), (float)(1 / sqrt(2000.0 / 3))});
+    PreComputeMergeTestImpl<InvStdDevNode, double>({1 / sqrt(20.0 / 3), 1 / sqrt(2000.0 / 3)});
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
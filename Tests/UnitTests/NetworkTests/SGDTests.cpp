@@ -0,0 +1,290 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/SGDLib/SGD.h"
+#include "../../../Source/SGDLib/DataReaderHelpers.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/LinearAlgebraNodes.h"
+#include "../../../Source/ComputationNetworkLib/PreComputeNodes.h"
+#include "fileutil.h"
+#include <cstdio>
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// We perform test on CPU.
+static const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+// Exposes the protected parts of SGD that the tests drive directly.
+template <class ElemType>
+class SGDTest : public SGD<ElemType>
+{
+public:
+    SGDTest(const string& config)
+        : SGD<ElemType>(ParseConfig(config))
+    {
+    }
+
+    using SGD<ElemType>::SaveCheckPointInfo;
+    using SGD<ElemType>::FinishPendingCheckpoint;
+    using SGD<ElemType>::TryLoadCheckPointInfo;
+    using SGD<ElemType>::GetCheckPointFileNameForEpoch;
+    using typename SGD<ElemType>::TrainingStateSnapshot;
+    using SGD<ElemType>::TakeTrainingStateSnapshot;
+    using SGD<ElemType>::RestoreTrainingStateSnapshot;
+    using SGD<ElemType>::GetPreComputeCacheKey;
+    using SGD<ElemType>::GetPreComputeCachePath;
+    using SGD<ElemType>::LoadPreComputeCache;
+    using SGD<ElemType>::SavePreComputeCache;
+
+private:
+    static ConfigParameters ParseConfig(const string& config)
+    {
+        ConfigParameters configParameters;
+        configParameters.Parse(config);
+        return configParameters;
+    }
+};
+
+// criterion = SumElements(W * features + b)
+struct AffineNetwork
+{
+    ComputationNetworkPtr net;
+    shared_ptr<ComputationNode<float>> weights, bias, features, criterion;
+
+    AffineNetwork(size_t outputDim, size_t inputDim)
+    {
+        net = make_shared<ComputationNetwork>(c_deviceId);
+        ComputationNetworkBuilder<float> builder(*net);
+        weights = builder.CreateLearnableParameter(L"W", outputDim, inputDim);
+        bias = builder.CreateLearnableParameter(L"b", outputDim, 1);
+        features = builder.CreateInputNode(L"features", inputDim);
+        auto output = builder.Plus(builder.Times(weights, features, 1, L"product"), bias, L"output");
+        criterion = net->AddNodeToNetAndAttachInputs(make_shared<SumElementsNode<float>>(c_deviceId, L"criterion"), { output });
+        net->AddToNodeGroup(L"criterion", criterion);
+        net->CompileNetwork();
+    }
+};
+
+// criterion = SumElements(features - Mean(features))
+struct MeanNetwork
+{
+    ComputationNetworkPtr net;
+    shared_ptr<ComputationNode<float>> mean;
+
+    MeanNetwork(size_t inputDim)
+    {
+        net = make_shared<ComputationNetwork>(c_deviceId);
+        ComputationNetworkBuilder<float> builder(*net);
+        auto features = builder.CreateInputNode(L"features", inputDim);
+        mean = builder.Mean(features, L"featureMean");
+        auto criterion = net->AddNodeToNetAndAttachInputs(make_shared<SumElementsNode<float>>(c_deviceId, L"criterion"), { builder.Minus(features, mean, L"centered") });
+        net->AddToNodeGroup(L"criterion", criterion);
+        net->CompileNetwork();
+    }
+};
+
+static bool AllEqual(const Matrix<float>& m, float value)
+{
+    for (size_t i = 0; i < m.GetNumElements(); i++)
+        if (m.Data()[i] != value)
+            return false;
+    return true;
+}
+
+static bool AllEqual(const Matrix<float>& a, const Matrix<float>& b)
+{
+    if (a.GetNumRows() != b.GetNumRows() || a.GetNumCols() != b.GetNumCols())
+        return false;
+    for (size_t i = 0; i < a.GetNumElements(); i++)
+        if (a.Data()[i] != b.Data()[i])
+            return false;
+    return true;
+}
+
+// Delivers numMinibatches minibatches of mbSize frames of 'features'; all values of the i-th one are i + 1.
+class CountingReader : public IDataReader
+{
+public:
+    CountingReader(size_t numMinibatches, size_t mbSize)
+        : m_numMinibatches(numMinibatches), m_mbSize(mbSize), m_next(0), m_numReads(0)
+    {
+    }
+
+    virtual void Init(const ConfigParameters&) override { }
+    virtual void Init(const ScriptableObjects::IConfigRecord&) override { }
+    virtual void Destroy() override { }
+    virtual void StartMinibatchLoop(size_t, size_t, size_t) override { m_next = 0; }
+    virtual size_t GetNumParallelSequencesForFixingBPTTMode() override { return 1; }
+    virtual size_t GetCurrentSamplePosition() override { return m_next * m_mbSize; }
+
+    virtual bool GetMinibatch(StreamMinibatchInputs& matrices) override
+    {
+        if (m_next >= m_numMinibatches)
+            return false;
+        auto& features = matrices.GetInputMatrix<float>(L"features");
+        features.Resize(features.GetNumRows(), m_mbSize);
+        features.SetValue((float)(m_next + 1));
+        matrices.GetInput(L"features").pMBLayout->InitAsFrameMode(m_mbSize);
+        m_next++;
+        m_numReads++;
+        return true;
+    }
+
+    size_t NumReads() const { return m_numReads; }
+
+private:
+    size_t m_numMinibatches, m_mbSize;
+    size_t m_next, m_numReads;
+};
+
+// Stands in for a trial mini-epoch of the learning rate search: updates the smoothed gradient and the weights
+// from every minibatch. Returns the sample positions the loop saw.
+static vector<size_t> RunSearchTrial(IDataReader& reader, StreamMinibatchInputs& inputs, Matrix<float>& weights, Matrix<float>& smoothedGradient, float learnRate)
+{
+    vector<size_t> positions;
+    reader.StartMinibatchLoop(/*mbSize=*/4, /*epoch=*/0, /*requestedEpochSamples=*/12);
+    for (;;)
+    {
+        positions.push_back(reader.GetCurrentSamplePosition());
+        if (!reader.GetMinibatch(inputs))
+            break;
+        Matrix<float>::Scale(0.5f, smoothedGradient);
+        smoothedGradient += inputs.GetInputMatrix<float>(L"features").SumOfElements();
+        Matrix<float>::ScaleAndAdd(-learnRate, smoothedGradient, weights);
+    }
+    return positions;
+}
+
+BOOST_AUTO_TEST_SUITE(SGDTestSuite)
+
+// With asyncCheckpointing, the model and the checkpoint are written on a background thread while training continues.
+// They must hold the state at the time of the call, not the updates made meanwhile.
+BOOST_AUTO_TEST_CASE(AsyncCheckpointing)
+{
+    SGDTest<float> sgd("modelPath=SGDTestAsyncCheckpoint.model\nmaxEpochs=2\nasyncCheckpointing=true\n");
+    AffineNetwork network(3, 4);
+    network.weights->Value().SetValue(1);
+    network.bias->Value().SetValue(2);
+    auto smoothedGradient = make_shared<Matrix<float>>(3, 4, c_deviceId);
+    smoothedGradient->SetValue(5);
+    list<MatrixBasePtr> smoothedGradients{ smoothedGradient };
+
+    sgd.SaveCheckPointInfo(/*epoch=*/0, /*totalSamplesSeen=*/100, /*learnRatePerSample=*/0.5, smoothedGradients, /*smoothedCounts=*/{ 7 },
+                           /*prevCriterion=*/1.5, /*minibatchSize=*/10, network.net);
+    // the next minibatch
+    network.weights->Value().SetValue(3);
+    smoothedGradient->SetValue(6);
+    sgd.FinishPendingCheckpoint();
+
+    auto loadedNet = ComputationNetwork::CreateFromFile<float>(c_deviceId, sgd.GetModelNameForEpoch(0));
+    BOOST_CHECK(AllEqual(loadedNet->GetNodeFromName(L"W")->As<ComputationNode<float>>()->Value(), 1));
+    BOOST_CHECK(AllEqual(loadedNet->GetNodeFromName(L"b")->As<ComputationNode<float>>()->Value(), 2));
+
+    auto loadedSmoothedGradient = make_shared<Matrix<float>>(c_deviceId);
+    list<MatrixBasePtr> loadedSmoothedGradients{ loadedSmoothedGradient };
+    vector<double> smoothedCounts(1);
+    size_t totalSamplesSeen, minibatchSize;
+    double learnRatePerSample, prevCriterion;
+    BOOST_REQUIRE(sgd.TryLoadCheckPointInfo(0, totalSamplesSeen, learnRatePerSample, loadedSmoothedGradients, smoothedCounts, prevCriterion, minibatchSize));
+    BOOST_CHECK_EQUAL(totalSamplesSeen, 100);
+    BOOST_CHECK_EQUAL(learnRatePerSample, 0.5);
+    BOOST_CHECK_EQUAL(prevCriterion, 1.5);
+    BOOST_CHECK_EQUAL(minibatchSize, 10);
+    BOOST_CHECK_EQUAL(smoothedCounts[0], 7);
+    BOOST_CHECK(AllEqual(*loadedSmoothedGradient, 5));
+
+    _wunlink(sgd.GetModelNameForEpoch(0).c_str());
+    _wunlink(sgd.GetCheckPointFileNameForEpoch(0).c_str());
+}
+
+// The learning rate search restores a snapshot after every trial and replays the recorded minibatches for the next one.
+// A replayed trial must end in the same state as the recorded one, and restoring must undo it completely.
+BOOST_AUTO_TEST_CASE(SearchSnapshotAndReplay)
+{
+    SGDTest<float> sgd("modelPath=SGDTestSnapshot.model\nmaxEpochs=2\n");
+    AffineNetwork network(3, 4);
+    network.weights->Value().SetValue(1);
+    auto smoothedGradient = make_shared<Matrix<float>>(3, 4, c_deviceId);
+    smoothedGradient->SetValue(5);
+    list<MatrixBasePtr> smoothedGradients{ smoothedGradient };
+
+    StreamMinibatchInputs inputs;
+    inputs.AddInput(L"features", network.features->ValuePtr(), make_shared<MBLayout>(), network.features->GetSampleLayout());
+
+    SGDTest<float>::TrainingStateSnapshot snapshot;
+    sgd.TakeTrainingStateSnapshot(network.net, smoothedGradients, snapshot);
+
+    CountingReader reader(/*numMinibatches=*/3, /*mbSize=*/4);
+    DataReaderHelpers::MinibatchReplayReader<float> replayReader(&reader);
+
+    auto& weights = network.weights->Value();
+    auto recordedPositions = RunSearchTrial(replayReader, inputs, weights, *smoothedGradient, 0.01f);
+    BOOST_CHECK(!replayReader.IsReplaying());
+    BOOST_CHECK_EQUAL(reader.NumReads(), 3);
+    Matrix<float> recordedWeights(weights.DeepClone());
+    Matrix<float> recordedSmoothedGradient(smoothedGradient->DeepClone());
+    BOOST_REQUIRE(!AllEqual(weights, 1));
+
+    sgd.RestoreTrainingStateSnapshot(network.net, snapshot, smoothedGradients);
+    BOOST_CHECK(AllEqual(weights, 1));
+    BOOST_CHECK(AllEqual(*smoothedGradient, 5));
+
+    auto replayedPositions = RunSearchTrial(replayReader, inputs, weights, *smoothedGradient, 0.01f);
+    BOOST_CHECK(replayReader.IsReplaying());
+    BOOST_CHECK_EQUAL(reader.NumReads(), 3);
+    BOOST_CHECK_EQUAL_COLLECTIONS(replayedPositions.begin(), replayedPositions.end(), recordedPositions.begin(), recordedPositions.end());
+    BOOST_CHECK(AllEqual(weights, recordedWeights));
+    BOOST_CHECK(AllEqual(*smoothedGradient, recordedSmoothedGradient));
+
+    sgd.RestoreTrainingStateSnapshot(network.net, snapshot, smoothedGradients);
+    BOOST_CHECK(AllEqual(weights, 1));
+    BOOST_CHECK(AllEqual(*smoothedGradient, 5));
+}
+
+// Precomputed values are saved under a key made of the data configuration and the precompute nodes, and loaded
+// by later runs with the same key instead of running the precomputation again.
+BOOST_AUTO_TEST_CASE(PreComputeCache)
+{
+    const string config = "modelPath=SGDTestPreCompute.model\nmaxEpochs=1\npreComputeCache=.\n";
+    SGDTest<float> sgd(config);
+    sgd.SetDataConfigKey(L"reader=A");
+
+    MeanNetwork network(4);
+    auto nodes = network.net->GetNodesRequiringPreComputation();
+    BOOST_REQUIRE_EQUAL(nodes.size(), 1);
+    auto path = sgd.GetPreComputeCachePath(sgd.GetPreComputeCacheKey(nodes));
+    _wunlink(path.c_str());
+    BOOST_CHECK(!sgd.LoadPreComputeCache(nodes));
+
+    vector<float> values{ 1, 2, 3, 4 };
+    Matrix<float> value(4, 1, values.data(), c_deviceId);
+    network.mean->As<PreComputedNodeBase<float>>()->SetPreComputedValue(value);
+    sgd.SavePreComputeCache(nodes);
+    BOOST_REQUIRE(fexists(path));
+
+    // a new run over the same data
+    MeanNetwork loadedNetwork(4);
+    auto loadedNodes = loadedNetwork.net->GetNodesRequiringPreComputation();
+    BOOST_REQUIRE(sgd.LoadPreComputeCache(loadedNodes));
+    BOOST_CHECK(loadedNetwork.net->GetNodesRequiringPreComputation().empty());
+    BOOST_CHECK(AllEqual(loadedNetwork.mean->Value(), value));
+
+    // other data
+    SGDTest<float> otherSgd(config);
+    otherSgd.SetDataConfigKey(L"reader=B");
+    MeanNetwork otherNetwork(4);
+    BOOST_CHECK(!otherSgd.LoadPreComputeCache(otherNetwork.net->GetNodesRequiringPreComputation()));
+
+    _wunlink(path.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
@@ -0,0 +1,48 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "AliasSampler.h"
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+BOOST_AUTO_TEST_SUITE(SamplingTests)
+
+BOOST_AUTO_TEST_CASE(AliasSamplerFrequencies)
+{
+    std::vector<double> weights = { 1, 0, 3, 6, 0.5, 9.5 };
+    AliasSampler sampler(weights);
+    BOOST_REQUIRE_EQUAL(sampler.Size(), weights.size());
+    BOOST_CHECK_CLOSE(sampler.TotalWeight(), 20.0, 1e-10);
+
+    std::mt19937_64 engine(1234);
+    const size_t numSamples = 1000000;
+    std::vector<size_t> counts(weights.size(), 0);
+    for (size_t i = 0; i < numSamples; i++)
+        counts[sampler.Sample(engine)]++;
+
+    for (size_t i = 0; i < weights.size(); i++)
+    {
+        double expected = weights[i] / sampler.TotalWeight();
+        double observed = (double)counts[i] / numSamples;
+        if (expected == 0)
+            BOOST_CHECK_EQUAL(counts[i], 0);
+        else
+            BOOST_CHECK_SMALL(observed - expected, 0.005);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(AliasSamplerInvalidWeights)
+{
+    AliasSampler sampler;
+    BOOST_CHECK(sampler.IsEmpty());
+    BOOST_CHECK_THROW(sampler.Build({}), std::invalid_argument);
+    BOOST_CHECK_THROW(sampler.Build({ 0, 0 }), std::invalid_argument);
+    BOOST_CHECK_THROW(sampler.Build({ 1, -1 }), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}}}}
@@ -6,6 +6,7 @@
 #pragma once
 
 #include "ComputationNode.h"
+#include "MPIWrapper.h"
 #include <vector>
 
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
@@ -41,4 +42,91 @@ public:
 
     void SetMinibatch(size_t minibatchSize, SmallVector<size_t> sampleDimensions, std::vector<ElemType>& data);
 };
+
+// Base of the stand-ins for MPI in tests of parallel training: a single worker, and every data exchange fails,
+// so that a test only implements what the code under test uses.
+class MPIWrapperStub : public MPIWrapper
+{
+public:
+    size_t NumNodesInUse() const override { return 1; }
+    size_t CurrentNodeRank() const override { return 0; }
+    bool IsMainNode() const override { return CurrentNodeRank() == MainNodeRank(); }
+    std::wstring CurrentNodeName() const override { return L"test"; }
+    bool IsIdle() const override { return false; }
+    bool UsingAllNodes() const override { return true; }
+    size_t MainNodeRank() const override { return 0; }
+    bool IsMultiHost() const override { return false; }
+    bool UseGpuGdr() override { return false; }
+
+    int Finalize(void) override { return 0; }
+    int Wait(MPI_Request*, MPI_Status*) override { NotSimulated(); }
+    int Waitany(int, MPI_Request[], int*, MPI_Status*) override { NotSimulated(); }
+    int Waitall(int, MPI_Request[], MPI_Status[]) override { NotSimulated(); }
+    int Isend(const void*, int, MPI_Datatype, int, int, MPI_Request*) override { NotSimulated(); }
+    int Recv(void*, int, MPI_Datatype, int, int, MPI_Status*) override { NotSimulated(); }
+    int Irecv(void*, int, MPI_Datatype, int, int, MPI_Request*) override { NotSimulated(); }
+    int Iallreduce(const void*, void*, int, MPI_Datatype, MPI_Op, MPI_Request*) override { NotSimulated(); }
+    int Abort(int) override { NotSimulated(); }
+    int Error_string(int, char*, int*) override { NotSimulated(); }
+
+    void AllReduce(std::vector<size_t>&) const override { NotSimulated(); }
+    void AllReduce(std::vector<int>&) const override { NotSimulated(); }
+    void AllReduce(std::vector<double>&) const override { NotSimulated(); }
+    void AllReduce(std::vector<float>&) const override { NotSimulated(); }
+
+    void AllReduce(size_t*, size_t, MPI_Op = MPI_SUM) const override { NotSimulated(); }
+    void AllReduce(int*, size_t, MPI_Op = MPI_SUM) const override { NotSimulated(); }
+    void AllReduce(double*, size_t, MPI_Op = MPI_SUM) const override { NotSimulated(); }
+    void AllReduce(float*, size_t, MPI_Op = MPI_SUM) const override { NotSimulated(); }
+
+    void AllReduce(size_t*, size_t*, size_t, MPI_Op = MPI_SUM) const override { NotSimulated(); }
+    void AllReduce(int*, int*, size_t, MPI_Op = MPI_SUM) const override { NotSimulated(); }
+    void AllReduce(double*, double*, size_t, MPI_Op = MPI_SUM) const override { NotSimulated(); }
+    void AllReduce(float*, float*, size_t, MPI_Op = MPI_SUM) const override { NotSimulated(); }
+
+    void AllReduceAsync(size_t*, size_t, MPI_Request*, MPI_Op = MPI_SUM) const override { NotSimulated(); }
+    void AllReduceAsync(int*, size_t, MPI_Request*, MPI_Op = MPI_SUM) const override { NotSimulated(); }
+    void AllReduceAsync(double*, size_t, MPI_Request*, MPI_Op = MPI_SUM) const override { NotSimulated(); }
+    void AllReduceAsync(float*, size_t, MPI_Request*, MPI_Op = MPI_SUM) const override { NotSimulated(); }
+
+    void AllReduceAsync(size_t*, size_t*, size_t, MPI_Request*, MPI_Op = MPI_SUM) const override { NotSimulated(); }
+    void AllReduceAsync(int*, int*, size_t, MPI_Request*, MPI_Op = MPI_SUM) const override { NotSimulated(); }
+    void AllReduceAsync(double*, double*, size_t, MPI_Request*, MPI_Op = MPI_SUM) const override { NotSimulated(); }
+    void AllReduceAsync(float*, float*, size_t, MPI_Request*, MPI_Op = MPI_SUM) const override { NotSimulated(); }
+
+    void Bcast(size_t*, size_t, size_t) override { NotSimulated(); }
+    void Bcast(double*, size_t, size_t) override { NotSimulated(); }
+    void Bcast(float*, size_t, size_t) override { NotSimulated(); }
+    void Bcast(void*, int, MPI_Datatype, int) override { NotSimulated(); }
+
+    void AllGatherAsync(const size_t*, size_t, size_t*, size_t, MPI_Request*) const override { NotSimulated(); }
+    void AllGatherAsync(const int*, size_t, int*, size_t, MPI_Request*) const override { NotSimulated(); }
+    void AllGatherAsync(const float*, size_t, float*, size_t, MPI_Request*) const override { NotSimulated(); }
+    void AllGatherAsync(const double*, size_t, double*, size_t, MPI_Request*) const override { NotSimulated(); }
+    void Allgather(const void*, int, MPI_Datatype, void*, int, MPI_Datatype) const override { NotSimulated(); }
+
+    void AllGather(const size_t*, size_t, size_t*, size_t) const override { NotSimulated(); }
+    void AllGather(const int*, size_t, int*, size_t) const override { NotSimulated(); }
+    void AllGather(const float*, size_t, float*, size_t) const override { NotSimulated(); }
+    void AllGather(const double*, size_t, double*, size_t) const override { NotSimulated(); }
+
+    void Gather(const size_t*, size_t, size_t*, size_t, size_t) const override { NotSimulated(); }
+    void Gather(const int*, size_t, int*, size_t, size_t) const override { NotSimulated(); }
+    void Gather(const float*, size_t, float*, size_t, size_t) const override { NotSimulated(); }
+    void Gather(const double*, size_t, double*, size_t, size_t) const override { NotSimulated(); }
+
+    void Gatherv(const size_t*, size_t, size_t*, int[], int[], size_t) const override { NotSimulated(); }
+    void Gatherv(const char*, size_t, char*, int[], int[], size_t) const override { NotSimulated(); }
+    void Gatherv(const int*, size_t, int*, int[], int[], size_t) const override { NotSimulated(); }
+    void Gatherv(const float*, size_t, float*, int[], int[], size_t) const override { NotSimulated(); }
+    void Gatherv(const double*, size_t, double*, int[], int[], size_t) const override { NotSimulated(); }
+
+    int WaitAll() override { NotSimulated(); }
+    void WaitAny(MPI_Request*, int, int*) override { NotSimulated(); }
+    void Wait(MPI_Request*) override { NotSimulated(); }
+    int WaitAll(std::vector<MPI_Request>&) override { NotSimulated(); }
+
+protected:
+    __declspec_noreturn static void NotSimulated() { LogicError("MPIWrapperStub: operation is not simulated by this test"); }
+};
 } } } }
\ No newline at end of file
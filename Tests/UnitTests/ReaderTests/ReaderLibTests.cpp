@@ -18,6 +18,8 @@
 #include "CudaMemoryProvider.h"
 #include "HeapMemoryProvider.h"
 #include "BufferedFileReader.h"
+#include "ReaderShim.h"
+#include <omp.h>
 
 #pragma warning(push)
 // disable warning about possible mod 0 operation in uniform_int_distribution
@@ -1305,6 +1307,43 @@ BOOST_AUTO_TEST_CASE(CheckNoDegenerateMinibatches)
     }
 }
 
+// A reader without data that records the OpenMP thread count of the thread that reads its minibatches.
+class ThreadCountRecordingReader : public Reader
+{
+public:
+    int m_numThreads = 0;
+
+    void StartEpoch(const EpochConfiguration&, const std::map<std::wstring, int>&) override {}
+    void SetConfiguration(const ReaderConfiguration&, const std::map<std::wstring, int>&) override {}
+    std::vector<StreamInformation> GetStreamDescriptions() override { return {}; }
+    std::map<std::wstring, size_t> GetState() override { return {}; }
+    void SetState(const std::map<std::wstring, size_t>&) override {}
+
+    Minibatch ReadMinibatch() override
+    {
+        m_numThreads = omp_get_max_threads();
+        return Minibatch(/*endOfSweep=*/true, /*endOfEpoch=*/true);
+    }
+};
+
+BOOST_AUTO_TEST_CASE(PrefetchUsesNumThreadsOfMainThread)
+{
+    int previousNumThreads = omp_get_max_threads();
+    auto reader = make_shared<ThreadCountRecordingReader>();
+    ReaderShim<float> shim(reader);
+    shim.Init(ConfigParameters()); // prefetches on a thread of its own
+
+    for (int numThreads : { 1, 2, 3 })
+    {
+        omp_set_num_threads(numThreads);
+        shim.StartMinibatchLoop(1, 0, unordered_set<InputStreamDescription>());
+        StreamMinibatchInputs matrices;
+        BOOST_TEST(!shim.GetMinibatch(matrices));
+        BOOST_TEST(reader->m_numThreads == numThreads);
+    }
+    omp_set_num_threads(previousNumThreads);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE(PackerTests)
@@ -11,9 +11,15 @@
 #include "Platform.h"
 #include "IndexBuilder.h"
 #include "ReaderUtil.h"
+#include "StringToIdMap.h"
+#include "CorpusDescriptor.h"
 #include "Common/ReaderTestHelper.h"
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string.hpp>
+#include <thread>
+#include <map>
+#include <deque>
+#include <set>
 
 using namespace std;
 
@@ -873,4 +879,152 @@ BOOST_AUTO_TEST_CASE(Index_1GB_with_caching_check_perf)
 
 BOOST_AUTO_TEST_SUITE_END()
 
+BOOST_AUTO_TEST_SUITE(StringToIdMapTests)
+
+static std::string UtteranceKey(size_t i)
+{
+    return "speaker" + std::to_string(i % 997) + "/session" + std::to_string(i / 997) + "_utt" + std::to_string(i);
+}
+
+BOOST_AUTO_TEST_CASE(StringToIdMap_add_and_get)
+{
+    StringToIdMap map;
+    std::vector<size_t> ids;
+    for (size_t i = 0; i < 10000; i++)
+        ids.push_back(map.AddIfNotExists(UtteranceKey(i)));
+
+    BOOST_REQUIRE_EQUAL(map.Size(), 10000u);
+    BOOST_REQUIRE_EQUAL(std::set<size_t>(ids.begin(), ids.end()).size(), 10000u);
+    for (size_t i = 0; i < 10000; i++)
+    {
+        size_t id = SIZE_MAX;
+        BOOST_REQUIRE(map.TryGet(UtteranceKey(i), id));
+        BOOST_REQUIRE_EQUAL(id, ids[i]);
+        BOOST_REQUIRE_EQUAL(map[UtteranceKey(i)], ids[i]);
+        BOOST_REQUIRE_EQUAL(map[ids[i]], UtteranceKey(i));
+        BOOST_REQUIRE_EQUAL(map.AddIfNotExists(UtteranceKey(i)), ids[i]);
+    }
+
+    size_t id;
+    BOOST_REQUIRE(!map.TryGet("unknown", id));
+    BOOST_REQUIRE(!map.Contains(""));
+    map.AddValue("");
+    BOOST_REQUIRE(map.Contains(""));
+    BOOST_REQUIRE_EQUAL(map[map[""]], "");
+    BOOST_REQUIRE_EXCEPTION(map[SIZE_MAX / 2], std::runtime_error, [](const std::runtime_error&) { return true; });
+
+    WStringToIdMap wmap;
+    auto wid = wmap.AddIfNotExists(L"\u00e4\u00f6\u00fc");
+    BOOST_REQUIRE(wmap[wid] == L"\u00e4\u00f6\u00fc");
+}
+
+BOOST_AUTO_TEST_CASE(StringToIdMap_concurrent_interning)
+{
+    // Several builders intern overlapping key ranges, every key has to end up with exactly one id.
+    const size_t numberOfThreads = 8, numberOfKeys = 50000, keysPerThread = 40000;
+    StringToIdMap map;
+    std::vector<std::vector<size_t>> ids(numberOfThreads, std::vector<size_t>(keysPerThread));
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < numberOfThreads; t++)
+    {
+        threads.emplace_back([&, t]()
+        {
+            for (size_t i = 0; i < keysPerThread; i++)
+                ids[t][i] = map.AddIfNotExists(UtteranceKey((i * 7 + t * 1031) % numberOfKeys));
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    BOOST_REQUIRE_EQUAL(map.Size(), std::min(numberOfKeys, numberOfThreads * keysPerThread));
+    for (size_t t = 0; t < numberOfThreads; t++)
+    {
+        for (size_t i = 0; i < keysPerThread; i++)
+        {
+            auto key = UtteranceKey((i * 7 + t * 1031) % numberOfKeys);
+            BOOST_REQUIRE_EQUAL(map[key], ids[t][i]);
+            BOOST_REQUIRE_EQUAL(map[ids[t][i]], key);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(CorpusDescriptor_non_numeric_keys)
+{
+    CorpusDescriptor corpus(false);
+    auto a = corpus.KeyToId("a");
+    auto b = corpus.KeyToId("b");
+    BOOST_REQUIRE_NE(a, b);
+    BOOST_REQUIRE_EQUAL(corpus.KeyToId("a"), a);
+    BOOST_REQUIRE_EQUAL(corpus.IdToKey(b), "b");
+}
+
+BOOST_AUTO_TEST_CASE(StringToIdMap_memory_and_throughput_check_perf)
+{
+    if (true)
+        // This test is intended to be executed manually as a reference point for the memory
+        // footprint and the interning throughput compared to a std::map based registry.
+        return;
+
+    const size_t numberOfKeys = 20000000;
+    const size_t numberOfThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Registry as it was implemented before: a map from the key to the id and the keys by id.
+    size_t mapTime, mapMemory;
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::map<std::string, size_t> values;
+        std::deque<const std::string*> indexedValues;
+        size_t heapCharacters = 0;
+        for (size_t i = 0; i < numberOfKeys; i++)
+        {
+            auto key = UtteranceKey(i);
+            auto it = values.find(key);
+            if (it == values.end())
+            {
+                it = values.insert(std::make_pair(key, indexedValues.size())).first;
+                indexedValues.push_back(&it->first);
+                if (it->first.capacity() > std::string().capacity())
+                    heapCharacters += it->first.capacity() + 1;
+            }
+        }
+        mapTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        // Tree node (three pointers and the color) plus the pair, and the deque entry.
+        mapMemory = values.size() * (4 * sizeof(void*) + sizeof(std::pair<const std::string, size_t>) + sizeof(void*)) + heapCharacters;
+    }
+
+    size_t internTime, internMemory, concurrentInternTime;
+    {
+        StringToIdMap map;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < numberOfKeys; i++)
+            map.AddIfNotExists(UtteranceKey(i));
+        internTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        internMemory = map.MemoryUsage();
+    }
+    {
+        StringToIdMap map;
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < numberOfThreads; t++)
+        {
+            threads.emplace_back([&, t]()
+            {
+                for (size_t i = t; i < numberOfKeys; i += numberOfThreads)
+                    map.AddIfNotExists(UtteranceKey(i));
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        concurrentInternTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        BOOST_REQUIRE_EQUAL(map.Size(), numberOfKeys);
+    }
+
+    fprintf(stderr, "%" PRIu64 " keys: std::map %" PRIu64 " ms, ~%" PRIu64 " MB; StringToIdMap %" PRIu64 " ms, %" PRIu64 " MB, %" PRIu64 " ms with %" PRIu64 " threads\n",
+            (uint64_t)numberOfKeys, (uint64_t)mapTime, (uint64_t)(mapMemory >> 20), (uint64_t)internTime, (uint64_t)(internMemory >> 20),
+            (uint64_t)concurrentInternTime, (uint64_t)numberOfThreads);
+    BOOST_REQUIRE(internMemory < mapMemory);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
 } } } }
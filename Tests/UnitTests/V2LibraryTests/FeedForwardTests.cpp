@@ -5,7 +5,9 @@
 #include "stdafx.h"
 #include "CNTKLibrary.h"
 #include <functional>
+#include <thread>
 #include "Common.h"
+#include "CNTKLibraryC.h"
 
 using namespace CNTK;
 
@@ -450,6 +452,154 @@ void TestTimesReduceSequenceAxis(
     }
 }
 
+void TestBatchingEvaluation(const DeviceDescriptor& device, CNTK_DeviceDescriptor cdevice)
+{
+    using namespace std::placeholders;
+
+    const size_t inputDim = 37;
+    const size_t numOutputClasses = 11;
+    const size_t numHiddenLayers = 2;
+    const size_t hiddenLayersDim = 64;
+    const size_t numRequests = 24;
+
+    auto features = InputVariable({ inputDim }, DataType::Float, L"features");
+    auto classifier = FullyConnectedFeedForwardClassifierNet(features, numOutputClasses, hiddenLayersDim, numHiddenLayers, device, std::bind(Sigmoid, _1, L""), L"classifierOutput");
+
+    const std::wstring tempModelPath = L"batching.model";
+    if ((_wunlink(tempModelPath.c_str()) != 0) && (errno != ENOENT))
+        BOOST_ERROR("Error deleting temp model file 'batching.model'");
+    classifier->Save(tempModelPath);
+
+    CNTK_ModelHandle model;
+    auto rc = CNTK_LoadModel("batching.model", &cdevice, &model);
+    BOOST_REQUIRE_EQUAL(rc.value, CNTK_SUCCESS);
+    if (_wunlink(tempModelPath.c_str()) != 0)
+        BOOST_ERROR("Error deleting temp model file 'batching.model'");
+
+    CNTK_BatchingOptions options{ 8, 2000, 2 };
+    CNTK_ModelHandle batched;
+    rc = CNTK_CreateBatchingModel(model, &options, &batched);
+    BOOST_REQUIRE_EQUAL(rc.value, CNTK_SUCCESS);
+
+    CNTK_Variable* outputInfos;
+    uint32_t numOutputs = 0;
+    rc = CNTK_GetModelOutputsInfo(batched, &outputInfos, &numOutputs);
+    BOOST_REQUIRE_EQUAL(rc.value, CNTK_SUCCESS);
+    BOOST_REQUIRE_EQUAL(numOutputs, 1u);
+
+    CNTK_Variable* argumentInfos;
+    uint32_t numArguments = 0;
+    rc = CNTK_GetModelArgumentsInfo(batched, &argumentInfos, &numArguments);
+    BOOST_REQUIRE_EQUAL(rc.value, CNTK_SUCCESS);
+    BOOST_REQUIRE_EQUAL(numArguments, 1u);
+
+    // Requests of different sequence lengths.
+    std::mt19937_64 generator(17);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    std::vector<std::vector<float>> inputData(numRequests);
+    std::vector<std::vector<uint32_t>> inputShapes(numRequests);
+    for (size_t i = 0; i < numRequests; ++i)
+    {
+        auto numberOfFrames = 1 + i % 5;
+        inputShapes[i] = { (uint32_t)inputDim, (uint32_t)numberOfFrames };
+        for (size_t j = 0; j < inputDim * numberOfFrames; ++j)
+            inputData[i].push_back(distribution(generator));
+    }
+
+    auto evaluate = [&](CNTK_ModelHandle handle, size_t i, std::vector<float>& result, CNTK_StatusCode& status)
+    {
+        CNTK_Value input;
+        input.shape.size = 2;
+        input.shape.value = inputShapes[i].data();
+        input.data = inputData[i].data();
+
+        bool sequenceFlags[]{ true };
+        CNTK_Value* outputValues = nullptr;
+        status = CNTK_EvaluateSequence(handle, argumentInfos, &input, sequenceFlags, numArguments, outputInfos, numOutputs, &outputValues);
+        if (status.value != CNTK_SUCCESS)
+            return;
+
+        NDShape outputShape(std::vector<size_t>(outputValues[0].shape.value, outputValues[0].shape.value + outputValues[0].shape.size));
+        result.assign(outputValues[0].data, outputValues[0].data + outputShape.TotalSize());
+        for (uint32_t k = 0; k < numOutputs; k++)
+            CNTK_CleanValue(&outputValues[k]);
+        CNTK_ReleaseArray(outputValues);
+    };
+
+    // Unbatched baseline.
+    std::vector<std::vector<float>> expected(numRequests);
+    for (size_t i = 0; i < numRequests; ++i)
+    {
+        CNTK_StatusCode status;
+        evaluate(model, i, expected[i], status);
+        BOOST_REQUIRE_EQUAL(status.value, CNTK_SUCCESS);
+    }
+
+    // Concurrent callers coalesced by the batching model.
+    std::vector<std::vector<float>> actual(numRequests);
+    std::vector<CNTK_StatusCode> statuses(numRequests);
+    std::vector<std::thread> callers;
+    for (size_t i = 0; i < numRequests; ++i)
+        callers.push_back(std::thread([&, i]() { evaluate(batched, i, actual[i], statuses[i]); }));
+    for (auto& caller : callers)
+        caller.join();
+
+    for (size_t i = 0; i < numRequests; ++i)
+    {
+        BOOST_REQUIRE_EQUAL(statuses[i].value, CNTK_SUCCESS);
+        BOOST_REQUIRE_EQUAL(actual[i].size(), expected[i].size());
+        RequireClose(expected[i], actual[i], 0.00001f, 0.0001f);
+    }
+
+    // Continuing a sequence is not possible once requests of different callers are packed together.
+    {
+        CNTK_Value input;
+        input.shape.size = 2;
+        input.shape.value = inputShapes[0].data();
+        input.data = inputData[0].data();
+
+        bool sequenceFlags[]{ false };
+        CNTK_Value* outputValues = nullptr;
+        rc = CNTK_EvaluateSequence(batched, argumentInfos, &input, sequenceFlags, numArguments, outputInfos, numOutputs, &outputValues);
+        BOOST_REQUIRE_NE(rc.value, CNTK_SUCCESS);
+    }
+
+    // A request whose shape does not match the argument fails on its own,
+    // without failing the valid requests it would have been packed with.
+    for (size_t i = 0; i < numRequests; i += 4)
+    {
+        inputShapes[i][0] = (uint32_t)inputDim + 1;
+        inputData[i].resize((inputDim + 1) * inputShapes[i][1]);
+    }
+    callers.clear();
+    for (size_t i = 0; i < numRequests; ++i)
+        callers.push_back(std::thread([&, i]() { evaluate(batched, i, actual[i], statuses[i]); }));
+    for (auto& caller : callers)
+        caller.join();
+
+    for (size_t i = 0; i < numRequests; ++i)
+    {
+        if (i % 4 == 0)
+        {
+            BOOST_REQUIRE_NE(statuses[i].value, CNTK_SUCCESS);
+            continue;
+        }
+        BOOST_REQUIRE_EQUAL(statuses[i].value, CNTK_SUCCESS);
+        RequireClose(expected[i], actual[i], 0.00001f, 0.0001f);
+    }
+
+    for (uint32_t i = 0; i < numOutputs; i++)
+        CNTK_CleanVariable(&outputInfos[i]);
+    CNTK_ReleaseArray(outputInfos);
+
+    for (uint32_t i = 0; i < numArguments; i++)
+        CNTK_CleanVariable(&argumentInfos[i]);
+    CNTK_ReleaseArray(argumentInfos);
+
+    CNTK_ReleaseModel(batched);
+    CNTK_ReleaseModel(model);
+}
+
 BOOST_AUTO_TEST_SUITE(FeedForwardSuite)
 
 BOOST_AUTO_TEST_CASE(FFTimesAndPlusInCPU)
@@ -510,6 +660,12 @@ BOOST_AUTO_TEST_CASE(FFNetworkCreationInCPU)
     }
 }
 
+BOOST_AUTO_TEST_CASE(FFBatchingEvaluationInCPU)
+{
+    if (ShouldRunOnCpu())
+        TestBatchingEvaluation(DeviceDescriptor::CPUDevice(), CNTK_DeviceDescriptor{ CNTK_DeviceKind_CPU, 0 });
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }}
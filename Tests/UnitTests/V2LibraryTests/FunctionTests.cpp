@@ -1200,6 +1200,63 @@ void TestMatMul(const DeviceDescriptor& device)
     }
 }
 
+template <typename ElementType>
+void TestRepeatedForwardWithBoundBuffers(const DeviceDescriptor& device)
+{
+    const size_t dim = 3;
+    const size_t numSamples = 4;
+    auto input = InputVariable({ dim }, AsDataType<ElementType>(), L"input");
+    auto doubled = Plus(input, input);
+
+    // The same input and output buffers are bound across calls; the input data may be aliased by the network
+    // and the output is written in place, so every call has to pick up the current buffer contents.
+    std::vector<ElementType> inputData(dim * numSamples);
+    std::vector<ElementType> outputData(dim * numSamples);
+    auto inputValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(NDShape({ dim, 1, numSamples }), inputData, false));
+    auto outputValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(NDShape({ dim, 1, numSamples }), outputData, false));
+
+    for (size_t iteration = 0; iteration < 3; ++iteration)
+    {
+        for (size_t i = 0; i < inputData.size(); ++i)
+            inputData[i] = (ElementType)((iteration + 1) * i);
+
+        // Buffers wrapping host memory can only be bound on the CPU
+        auto boundInputValue = inputValue;
+        if (device != DeviceDescriptor::CPUDevice())
+        {
+            boundInputValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(NDShape({ dim, 1, numSamples }), inputData, false)->DeepClone(device));
+            outputValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), NDShape({ dim, 1, numSamples }), device));
+        }
+
+        std::unordered_map<Variable, ValuePtr> outputs = { { doubled->Output(), outputValue } };
+        doubled->Forward({ { input, boundInputValue } }, outputs, device);
+
+        std::vector<std::vector<ElementType>> result;
+        outputs[doubled->Output()]->CopyVariableValueTo(doubled->Output(), result);
+        BOOST_TEST(result.size() == numSamples);
+        for (size_t s = 0; s < numSamples; ++s)
+            for (size_t i = 0; i < dim; ++i)
+                FloatingPointCompare<ElementType>(result[s][i], 2 * inputData[(s * dim) + i], "Function output does not match the expected value.");
+
+        // Interleave sequences of different lengths, which need to be reshuffled rather than aliased
+        std::vector<std::vector<ElementType>> sequences = { std::vector<ElementType>(dim * 3), std::vector<ElementType>(dim * 1) };
+        for (auto& sequence : sequences)
+            for (size_t i = 0; i < sequence.size(); ++i)
+                sequence[i] = (ElementType)(iteration + i);
+
+        std::unordered_map<Variable, ValuePtr> sequenceOutputs = { { doubled->Output(), nullptr } };
+        doubled->Forward({ { input, Value::Create(NDShape({ dim }), sequences, device) } }, sequenceOutputs, device);
+        sequenceOutputs[doubled->Output()]->CopyVariableValueTo(doubled->Output(), result);
+        BOOST_TEST(result.size() == sequences.size());
+        for (size_t s = 0; s < sequences.size(); ++s)
+        {
+            BOOST_TEST(result[s].size() == sequences[s].size());
+            for (size_t i = 0; i < sequences[s].size(); ++i)
+                FloatingPointCompare<ElementType>(result[s][i], 2 * sequences[s][i], "Function output does not match the expected value.");
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE(FunctionSuite)
 
 BOOST_AUTO_TEST_CASE(FindNameInCPU)
@@ -1334,6 +1391,21 @@ BOOST_AUTO_TEST_CASE(MatMul)
         TestMatMul(DeviceDescriptor::GPUDevice(0));
 }
 
+BOOST_AUTO_TEST_CASE(RepeatedForwardWithBoundBuffersInCPU)
+{
+    if (ShouldRunOnCpu())
+    {
+        TestRepeatedForwardWithBoundBuffers<float>(DeviceDescriptor::CPUDevice());
+        TestRepeatedForwardWithBoundBuffers<double>(DeviceDescriptor::CPUDevice());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(RepeatedForwardWithBoundBuffersInGPU)
+{
+    if (ShouldRunOnGpu())
+        TestRepeatedForwardWithBoundBuffers<float>(DeviceDescriptor::GPUDevice(0));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }}
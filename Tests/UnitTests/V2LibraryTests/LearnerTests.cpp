@@ -141,6 +141,66 @@ void TestUniversalLearner(size_t numParameters, size_t numMinibatches, const Dev
 
 }
 
+// Trains two copies of an embedding with the same kind of learner on the CPU: one gets the sparse block column
+// gradients of Times(embedding, oneHotInput), whose smoothed state the learner updates lazily for the columns that are
+// present, the other the same gradients in dense format. The minibatch size, and with it the per-minibatch momentum,
+// changes from update to update. Checkpoints bring the lazy state up to date, so the smoothed gradients must match.
+template <typename ElementType>
+void TestLazySparseUpdate(const std::function<LearnerPtr(const Parameter&)>& createLearner)
+{
+    const size_t vocabSize = 20;
+    const size_t embeddingDim = 4;
+    auto device = DeviceDescriptor::CPUDevice();
+    auto initialValue = NDArrayView::RandomUniform<ElementType>({ embeddingDim, vocabSize }, -1.0, 1.0, 1, device);
+    Parameter sparseEmbedding(initialValue->DeepClone(), L"sparseEmbedding");
+    Parameter denseEmbedding(initialValue->DeepClone(), L"denseEmbedding");
+    auto sparseLearner = createLearner(sparseEmbedding);
+    auto denseLearner = createLearner(denseEmbedding);
+
+    auto input = InputVariable({ vocabSize }, /*isSparse=*/ true, AsDataType<ElementType>(), L"input");
+    auto embedding = Times(sparseEmbedding, input);
+
+    for (size_t minibatchSize : { 3, 1, 6, 2, 9, 1, 4 })
+    {
+        vector<size_t> indices(minibatchSize);
+        for (auto& index : indices)
+            index = rng() % vocabSize;
+        auto inputValue = Value::CreateBatch<ElementType>(vocabSize, indices, device);
+
+        unordered_map<Variable, ValuePtr> outputs = { { embedding->Output(), nullptr } };
+        auto backpropState = embedding->Forward({ { input, inputValue } }, outputs, device, { embedding->Output() });
+
+        vector<ElementType> rootGradientData(embeddingDim * minibatchSize);
+        for (auto& value : rootGradientData)
+            value = (ElementType)(rng() % 1000) / 1000 - (ElementType)0.5;
+        auto rootGradientValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(NDShape({ embeddingDim, 1, minibatchSize }), rootGradientData.data(), rootGradientData.size(), device, true));
+
+        unordered_map<Variable, ValuePtr> gradients = { { sparseEmbedding, nullptr } };
+        embedding->Backward(backpropState, { { embedding->Output(), rootGradientValue } }, gradients);
+        auto sparseGradient = gradients[sparseEmbedding]->Data();
+        BOOST_REQUIRE(sparseGradient->GetStorageFormat() == StorageFormat::SparseBlockCol);
+
+        // column i of the dense gradient sums the root gradients of the samples with index i
+        vector<ElementType> denseGradientData(embeddingDim * vocabSize, 0);
+        for (size_t j = 0; j < minibatchSize; j++)
+            for (size_t i = 0; i < embeddingDim; i++)
+                denseGradientData[indices[j] * embeddingDim + i] += rootGradientData[j * embeddingDim + i];
+        auto denseGradient = MakeSharedObject<NDArrayView>(denseEmbedding.Shape(), denseGradientData.data(), denseGradientData.size(), device);
+
+        unordered_map<Parameter, NDArrayViewPtr> sparseGradientValues = { { sparseEmbedding, sparseGradient } };
+        unordered_map<Parameter, NDArrayViewPtr> denseGradientValues = { { denseEmbedding, denseGradient } };
+        sparseLearner->Update(sparseGradientValues, minibatchSize, false);
+        denseLearner->Update(denseGradientValues, minibatchSize, false);
+    }
+
+    auto smoothedGradient = [](const LearnerPtr& learner)
+    {
+        auto checkpoint = learner->CreateCheckpoint();
+        return checkpoint[L"smoothed_gradients"].Value<vector<DictionaryValue>>()[0].Value<NDArrayView>().DeepClone();
+    };
+    BOOST_TEST(Internal::AreEqual(*smoothedGradient(sparseLearner), *smoothedGradient(denseLearner), relativeTolerance, absoluteTolerance));
+}
+
 void TestTrainingParametersSchedule()
 {
     LearningRateSchedule schedule1(0.5, 1);
@@ -477,6 +537,20 @@ BOOST_AUTO_TEST_CASE(CreateAndUpdateAdamaxLearner)
     }
 }
 
+BOOST_AUTO_TEST_CASE(LazySparseUpdateWithVaryingMinibatchSize)
+{
+    if (!ShouldRunOnCpu())
+        return;
+
+    // a per-sample learning rate of 1, since the dense momentum SGD (unlike the sparse one) scales its state by it
+    auto learningRate = TrainingParameterPerSampleSchedule(1.0);
+    auto momentum = MomentumAsTimeConstantSchedule(10);
+    TestLazySparseUpdate<double>([&](const Parameter& parameter) { return MomentumSGDLearner({ parameter }, learningRate, momentum, /*unitGain=*/ false); });
+    TestLazySparseUpdate<double>([&](const Parameter& parameter) { return FSAdaGradLearner({ parameter }, learningRate, momentum, /*unitGain=*/ true, MomentumAsTimeConstantSchedule(50)); });
+    TestLazySparseUpdate<double>([&](const Parameter& parameter) { return AdamLearner({ parameter }, learningRate, momentum, /*unitGain=*/ true, MomentumAsTimeConstantSchedule(50)); });
+    TestLazySparseUpdate<float>([&](const Parameter& parameter) { return AdamLearner({ parameter }, learningRate, momentum, /*unitGain=*/ true, MomentumAsTimeConstantSchedule(50), 1e-8, /*adamax=*/ true); });
+}
+
 BOOST_AUTO_TEST_CASE(TestResettingLearningRate)
 {
     NDShape shape = { 1 };
@@ -356,6 +356,38 @@ void CompareCBFAndCTFDeserializers(size_t maxSamples, size_t mbSize, bool random
     }
 }
 
+void TestBenchmarkMinibatchSource()
+{
+    const size_t sweepSize = 603, mbSize = 50, numWarmupMinibatches = 2;
+    std::vector<StreamConfiguration> streamConfig{ { L"features", 2 } };
+    MinibatchSourceConfig config({ CTFDeserializer(L"SimpleDataTest_cntk_text.txt", streamConfig) }, /*randomize=*/false);
+    config.maxSweeps = 1;
+
+    // asks for more minibatches than the sweep has
+    auto results = BenchmarkMinibatchSource(config, mbSize, 100, { 1, 2 }, numWarmupMinibatches);
+    BOOST_REQUIRE_EQUAL(results.size(), 2);
+    for (const auto& result : results)
+    {
+        size_t expectedNumSamples = sweepSize - numWarmupMinibatches * mbSize;
+        BOOST_TEST(result.numSamples == expectedNumSamples);
+        BOOST_TEST(result.numMinibatches == (expectedNumSamples + mbSize - 1) / mbSize);
+        BOOST_TEST(result.seconds > 0);
+
+        // the background stages may have processed the first measured minibatch already during the warm-up
+        BOOST_TEST(result.numBytes >= (expectedNumSamples - mbSize) * 2 * sizeof(float));
+        BOOST_TEST(result.stageLatencies.at(L"getMinibatch").count >= result.numMinibatches);
+        BOOST_TEST(result.stageLatencies.at(L"prefetchWait").count >= result.numMinibatches);
+        for (const auto& stage : { L"getMinibatch", L"prefetchWait", L"prefetch", L"readSequences", L"pack", L"copy" })
+        {
+            const auto& latency = result.stageLatencies.at(stage);
+            BOOST_TEST(latency.count >= result.numMinibatches - 1);
+            BOOST_TEST(latency.p50Seconds <= latency.p90Seconds);
+            BOOST_TEST(latency.p90Seconds <= latency.p99Seconds);
+        }
+    }
+    BOOST_TEST(results[0].numCPUThreads == 1);
+}
+
 BOOST_AUTO_TEST_SUITE(MinibatchSourceSuite)
 
 BOOST_AUTO_TEST_CASE(TestThatEndOfSweepFlagIsSetCorrectly)
@@ -423,6 +455,12 @@ BOOST_AUTO_TEST_CASE(CBFDeserializer)
 }
 
 
+BOOST_AUTO_TEST_CASE(BenchmarkMinibatchSourceReportsPipelineStatistics)
+{
+    TestBenchmarkMinibatchSource();
+}
+
+
 BOOST_AUTO_TEST_CASE(CompareDeserializers)
 {
     for (auto randomize : { true, false }) 
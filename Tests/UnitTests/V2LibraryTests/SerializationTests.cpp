@@ -855,6 +855,54 @@ void TestCheckpointingWithStatefulNodes(const DeviceDescriptor& device)
     }
 }
 
+void TestAsyncCheckpointing(const DeviceDescriptor& device)
+{
+    auto featureStreamName = L"features";
+    auto labelsStreamName = L"labels";
+
+    size_t inputDim = 784;
+    size_t numOutputClasses = 10;
+    auto features = InputVariable({ inputDim }, false /*isSparse*/, DataType::Float, featureStreamName);
+    auto labels = InputVariable({ numOutputClasses }, DataType::Float, labelsStreamName);
+    auto net = BuildFFClassifierNet(features, numOutputClasses, device, 1);
+
+    auto trainer = BuildTrainer(net, labels);
+
+    const size_t minibatchSize = 50;
+    const size_t epochSize = 150;
+    auto minibatchSource = TextFormatMinibatchSource(L"Train-28x28_cntk_text.txt", { { featureStreamName, inputDim }, { labelsStreamName, numOutputClasses } },  epochSize, false);
+    auto minibatchData = minibatchSource->GetNextMinibatch(minibatchSize, device);
+    auto featureStreamInfo = minibatchSource->StreamInfo(features);
+    auto labelStreamInfo = minibatchSource->StreamInfo(labels);
+
+    trainer->TrainMinibatch({ { features, minibatchData[featureStreamInfo] }, { labels, minibatchData[labelStreamInfo] } }, device);
+
+    // Training continues while the checkpoints are written, so they must hold the state at the time of the call.
+    vector<double> expectedLoss;
+    for (int i = 0; i < epochSize / minibatchSize; i++)
+    {
+        trainer->SaveCheckpointAsync(L"async_checkpoint.model" + std::to_wstring(i));
+        trainer->TrainMinibatch({ { features, minibatchData[featureStreamInfo] }, { labels, minibatchData[labelStreamInfo] } }, device);
+        expectedLoss.push_back(trainer->PreviousMinibatchLossAverage());
+    }
+    trainer->WaitForPendingCheckpoint();
+
+    for (int i = 0; i < epochSize / minibatchSize; i++)
+    {
+        trainer->RestoreFromCheckpoint(L"async_checkpoint.model" + std::to_wstring(i));
+        trainer->TrainMinibatch({ { features, minibatchData[featureStreamInfo] }, { labels, minibatchData[labelStreamInfo] } }, device);
+        double loss = trainer->PreviousMinibatchLossAverage();
+        FloatingPointCompare(loss, expectedLoss[i], "Post async checkpoint restoration training loss does not match expectation");
+    }
+
+    for (int i = 0; i < epochSize / minibatchSize; i++)
+    {
+        auto modelFile = L"async_checkpoint.model" + std::to_wstring(i);
+        for (const auto& file : { modelFile, modelFile + L".ckp" })
+            if (_wunlink(file.c_str()) != 0)
+                BOOST_ERROR("Error deleting async checkpoint file.");
+    }
+}
 
 void TestCheckpointingWithStatefulNodesAndExplicitSeeds(const DeviceDescriptor& device)
 {
@@ -1044,6 +1092,11 @@ BOOST_AUTO_TEST_CASE(CheckpointingWithStatefulNodesInCPU)
     TestCheckpointingWithStatefulNodes(DeviceDescriptor::CPUDevice());
 }
 
+BOOST_AUTO_TEST_CASE(AsyncCheckpointingInCPU)
+{
+    TestAsyncCheckpointing(DeviceDescriptor::CPUDevice());
+}
+
 BOOST_AUTO_TEST_CASE(LearnerSerializationInGPU)
 {
     if (ShouldRunOnGpu())
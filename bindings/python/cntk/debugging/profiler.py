@@ -15,7 +15,8 @@ def start_profiler(dir='profiler', sync_gpu=True, reserve_mem=cntk_py.default_pr
     Args:
         dir: directory for profiler output
         sync_gpu: whether profiler syncs CPU with GPU when timing
-        reserve_mem: size in byte for profiler memory reserved
+        reserve_mem: size in bytes of the event buffer of the profiler, which
+         is allocated for each thread that records events
     '''
     cntk_py.start_profiler(dir, sync_gpu, reserve_mem)
 